@@ -11,6 +11,7 @@
 #endif
 
 #include "MapFace.h"
+#include "SolidFromPlanes.h"
 
 #define	ON_PLANE_EPSILON			0.5f		// Vertices must be within this many units of the plane to be considered on the plane.
 #define	MIN_EDGE_LENGTH_EPSILON		0.1f		// Edges shorter than this are considered degenerate.
@@ -26,4 +27,7 @@ winding_t *CreateWindingFromPlane(PLANE *pPlane);
 size_t WindingSize(int points);
 void RemoveDuplicateWindingPoints(winding_t *pWinding, float fMinDist = 0);
 
+// Starts a clipper from the huge quadrilateral CreateWindingFromPlane makes.
+void InitWindingClipper(CWindingClipper &Clipper, const PLANE *pPlane);
+
 #endif // BRUSHOPS_H
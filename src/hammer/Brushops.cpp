@@ -143,7 +143,6 @@ Frees the input winding.
 ==================
 */
 // YWB ADDED SPLIT EPS to match qcsg splitting
-#define	SPLIT_EPSILON	0.01
 winding_t *ClipWinding (winding_t *in, PLANE *split)
 {
 	float	dists[MAX_POINTS_ON_WINDING];
@@ -309,6 +308,71 @@ winding_t *CreateWindingFromPlane(PLANE *pPlane)
 	return w;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Starts the clipper from the huge quadrilateral that
+//			CreateWindingFromPlane makes for the plane, using the same math.
+//-----------------------------------------------------------------------------
+void InitWindingClipper(CWindingClipper &Clipper, const PLANE *pPlane)
+{
+	int		i, x;
+	float	max, v;
+	Vector	org, vright, vup;
+
+	// find the major axis
+	max = -BOGUS_RANGE;
+	x = -1;
+	for (i=0 ; i<3; i++)
+	{
+		v = fabs(pPlane->normal[i]);
+		if (v > max)
+		{
+			x = i;
+			max = v;
+		}
+	}
+	if (x==-1)
+		Error ("BasePolyForPlane: no axis found");
+
+	vup = vec3_origin;
+	switch (x)
+	{
+		case 0:
+		case 1:
+			vup[2] = 1;
+			break;
+		case 2:
+			vup[0] = 1;
+			break;
+	}
+
+	v = DotProduct (vup, pPlane->normal);
+	VectorMA (vup, -v, pPlane->normal, vup);
+	VectorNormalize (vup);
+
+	org = pPlane->normal * pPlane->dist;
+
+	CrossProduct (vup, pPlane->normal, vright);
+
+	vup = vup * MAX_TRACE_LENGTH;
+	vright = vright * MAX_TRACE_LENGTH;
+
+	Vector p[4];
+
+	VectorSubtract (org, vright, p[0]);
+	VectorAdd (p[0], vup, p[0]);
+
+	VectorAdd (org, vright, p[1]);
+	VectorAdd (p[1], vup, p[1]);
+
+	VectorAdd (org, vright, p[2]);
+	VectorSubtract (p[2], vup, p[2]);
+
+	VectorSubtract (org, vright, p[3]);
+	VectorSubtract (p[3], vup, p[3]);
+
+	Clipper.Init(p, 4);
+}
+
 static CArray<error3d, error3d&> Errors;
 static int nErrors;
 
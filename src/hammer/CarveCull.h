@@ -0,0 +1,101 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The test Subtract Selection uses to skip world solids that a
+//			carving solid cannot change. Kept free of editor dependencies so
+//			it can be checked against carving every solid in the world:
+//
+//			g++ -O2 CarveCull_test.cpp -o CarveCull_test && ./CarveCull_test
+//
+//			The types used with it provide:
+//
+//			VECTOR	- x, y and z, and operator[]
+//			SOLID	- GetRender2DBox( VECTOR &, VECTOR & ), IsValid(),
+//					  int GetFaceCount() and FACE *GetFace( int )
+//			FACE	- a plane with a normal VECTOR and a dist,
+//					  int GetPointCount() and GetPoint( VECTOR &, int )
+//
+//=============================================================================//
+
+#ifndef CARVECULL_H
+#define CARVECULL_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <math.h>
+
+#define CARVE_SEPARATION_EPSILON		1.0f		// Distance in front of a carving plane beyond which CarveCull_MayIntersect rejects; well over the clipping epsilon.
+
+//-----------------------------------------------------------------------------
+// Purpose: Cheap test for whether CMapSolid::Carve could find a solid
+//			intersecting the carver. Returns false only where Carve would
+//			return false: the bounds don't overlap, or every point of the solid
+//			is well in front of one of the carver's faces, so clipping by that
+//			face leaves no back piece. Reads only, so it is safe to call on
+//			worker threads.
+// Input  : pSolid - The solid that would be carved.
+//			pCarver - The solid that would be subtracted from it.
+//-----------------------------------------------------------------------------
+template <class VECTOR, class SOLID>
+bool CarveCull_MayIntersect( SOLID *pSolid, SOLID *pCarver )
+{
+	VECTOR bmins, bmaxs;
+	VECTOR carvemins, carvemaxs;
+
+	pSolid->GetRender2DBox( bmins, bmaxs );
+	pCarver->GetRender2DBox( carvemins, carvemaxs );
+
+	// Same test Carve starts with.
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( ( bmins[i] >= carvemaxs[i] ) || ( bmaxs[i] <= carvemins[i] ) )
+			return false;
+	}
+
+	// Our points may not match our planes; let Carve decide.
+	if ( !pSolid->IsValid() )
+		return true;
+
+	int nFaces = pSolid->GetFaceCount();
+	for ( int i = 0; i < pCarver->GetFaceCount(); i++ )
+	{
+		const VECTOR &Normal = pCarver->GetFace( i )->plane.normal;
+		float flDist = pCarver->GetFace( i )->plane.dist;
+
+		// CreateFromPlanes ignores zero normals and drops our faces that
+		// duplicate the new plane, so those clips don't behave like a plane test.
+		if ( ( Normal.x == 0 ) && ( Normal.y == 0 ) && ( Normal.z == 0 ) )
+			continue;
+
+		bool bSeparated = true;
+		for ( int j = 0; ( j < nFaces ) && bSeparated; j++ )
+		{
+			const VECTOR &FaceNormal = pSolid->GetFace( j )->plane.normal;
+			float flDot = FaceNormal.x * Normal.x + FaceNormal.y * Normal.y + FaceNormal.z * Normal.z;
+			if ( ( flDot > 0.999 ) && ( fabs( pSolid->GetFace( j )->plane.dist - flDist ) < 0.01 ) )
+			{
+				bSeparated = false;
+				break;
+			}
+
+			int nPoints = pSolid->GetFace( j )->GetPointCount();
+			for ( int k = 0; k < nPoints; k++ )
+			{
+				VECTOR Point;
+				pSolid->GetFace( j )->GetPoint( Point, k );
+				if ( Point.x * Normal.x + Point.y * Normal.y + Point.z * Normal.z - flDist <= CARVE_SEPARATION_EPSILON )
+				{
+					bSeparated = false;
+					break;
+				}
+			}
+		}
+
+		if ( bSeparated )
+			return false;
+	}
+
+	return true;
+}
+
+#endif // CARVECULL_H
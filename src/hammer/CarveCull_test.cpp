@@ -0,0 +1,787 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test for CarveCull.h. Models CMapSolid::Carve on the
+//			SolidFromPlanes.h builder that CreateFromPlanes uses, then runs
+//			Subtract Selection on random worlds two ways:
+//
+//			- as it was, carving every solid in the world;
+//			- as it is now, carving only the solids under root objects whose
+//			  bounds touch the carvers and which CarveCull_MayIntersect
+//			  passes.
+//
+//			The resulting worlds must match point for point. It also checks
+//			directly that every solid CarveCull_MayIntersect rejects is one
+//			Carve reports as not intersecting, then times both on a world of
+//			10,000 solids:
+//
+//			g++ -O2 CarveCull_test.cpp -o CarveCull_test && ./CarveCull_test
+//
+//			The model keeps each face's plane as given, where the editor
+//			recalculates it from the face's points after building.
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "CarveCull.h"
+#include "SolidFromPlanes.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( RandomInt( 0, 1 << 20 ) / (float)( 1 << 20 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+#define MAX_COORD_INTEGER			16384
+#define COORD_NOTINIT				( (float)( 99999.0 ) )
+#define MAX_TRACE_LENGTH			( 1.732050807569 * 2 * MAX_COORD_INTEGER )
+#define MIN_EDGE_LENGTH_EPSILON		0.1f
+#define ROUND_VERTEX_EPSILON		0.01f
+#define MAX_FACES					512
+
+struct Vector_t
+{
+	float x, y, z;
+
+	float &operator[]( int i ) { return ( &x )[i]; }
+	float operator[]( int i ) const { return ( &x )[i]; }
+};
+
+static inline float DotProduct( const Vector_t &a, const Vector_t &b )
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+struct Plane_t
+{
+	Vector_t normal;
+	float dist;
+};
+
+//
+// Stands in for CMapFace.
+//
+struct Face_t
+{
+	Plane_t plane;
+	std::vector<Vector_t> m_Points;
+
+	int GetPointCount( void ) { return (int)m_Points.size(); }
+	void GetPoint( Vector_t &Point, int nPoint ) { Point = m_Points[nPoint]; }
+};
+
+//
+// Stands in for CMapSolid.
+//
+struct Solid_t
+{
+	std::vector<Face_t> m_Faces;
+	bool m_bValid;
+	Vector_t m_Mins;
+	Vector_t m_Maxs;
+
+	int GetFaceCount( void ) { return (int)m_Faces.size(); }
+	Face_t *GetFace( int i ) { return &m_Faces[i]; }
+	bool IsValid( void ) { return m_bValid; }
+
+	void GetRender2DBox( Vector_t &Mins, Vector_t &Maxs )
+	{
+		Mins = m_Mins;
+		Maxs = m_Maxs;
+	}
+
+	void CreateFromPlanes( void );
+	bool AddPlane( const Plane_t &Plane );
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: The huge quadrilateral that CreateWindingFromPlane makes.
+//-----------------------------------------------------------------------------
+static void BasePoints( const Plane_t *pPlane, Vector_t *p )
+{
+	int x = 0;
+	float max = -1;
+	for ( int i = 0; i < 3; i++ )
+	{
+		float v = fabs( pPlane->normal[i] );
+		if ( v > max )
+		{
+			x = i;
+			max = v;
+		}
+	}
+
+	Vector_t vup = { 0, 0, 0 };
+	if ( x == 2 )
+	{
+		vup.x = 1;
+	}
+	else
+	{
+		vup.z = 1;
+	}
+
+	float v = DotProduct( vup, pPlane->normal );
+	for ( int i = 0; i < 3; i++ )
+	{
+		vup[i] -= v * pPlane->normal[i];
+	}
+	float flLength = sqrtf( DotProduct( vup, vup ) );
+	if ( flLength != 0 )
+	{
+		for ( int i = 0; i < 3; i++ )
+		{
+			vup[i] /= flLength;
+		}
+	}
+
+	Vector_t vright;
+	vright.x = vup.y * pPlane->normal.z - vup.z * pPlane->normal.y;
+	vright.y = vup.z * pPlane->normal.x - vup.x * pPlane->normal.z;
+	vright.z = vup.x * pPlane->normal.y - vup.y * pPlane->normal.x;
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		float org = pPlane->normal[i] * pPlane->dist;
+		float up = vup[i] * MAX_TRACE_LENGTH;
+		float right = vright[i] * MAX_TRACE_LENGTH;
+		p[0][i] = org - right + up;
+		p[1][i] = org + right + up;
+		p[2][i] = org + right - up;
+		p[3][i] = org - right - up;
+	}
+}
+
+static void RemoveDuplicatePoints( std::vector<Vector_t> &Points, float fMinDist )
+{
+	for ( size_t i = 0; i < Points.size(); i++ )
+	{
+		for ( size_t j = i + 1; j < Points.size(); j++ )
+		{
+			Vector_t Edge = { Points[i].x - Points[j].x, Points[i].y - Points[j].y, Points[i].z - Points[j].z };
+			if ( sqrtf( DotProduct( Edge, Edge ) ) < fMinDist )
+			{
+				Points.erase( Points.begin() + j );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CMapSolid::CreateFromPlanes, building the face points and bounds.
+//-----------------------------------------------------------------------------
+void Solid_t::CreateFromPlanes( void )
+{
+	m_Mins.x = m_Mins.y = m_Mins.z = COORD_NOTINIT;
+	m_Maxs.x = m_Maxs.y = m_Maxs.z = -COORD_NOTINIT;
+	m_bValid = true;
+
+	int nFaces = GetFaceCount();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		m_Faces[i].m_Points.clear();
+	}
+
+	bool useplane[MAX_FACES];
+	SolidFromPlanesDist_t sorted[MAX_FACES];
+	int rank[MAX_FACES];
+	SolidFromPlanes_ChoosePlanes( this, useplane, sorted, rank );
+
+	bool bGotFaces = false;
+	CWindingClipper Clipper;
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		if ( !useplane[i] )
+			continue;
+
+		Vector_t Base[4];
+		BasePoints( &m_Faces[i].plane, Base );
+		Clipper.Init( Base, 4 );
+
+		bool bClippedAway = false;
+		for ( int j = 0; j < nFaces && !bClippedAway; j++ )
+		{
+			if ( j != i )
+			{
+				const Plane_t &Clip = m_Faces[j].plane;
+				Plane_t plane = { { 0 - Clip.normal.x, 0 - Clip.normal.y, 0 - Clip.normal.z }, -Clip.dist };
+				bClippedAway = !Clipper.Clip( &plane );
+			}
+		}
+
+		if ( bClippedAway )
+			continue;
+
+		std::vector<Vector_t> &Points = m_Faces[i].m_Points;
+		Points.resize( Clipper.GetPointCount() );
+		Clipper.GetPoints( Points.data() );
+
+		for ( size_t j = 0; j < Points.size(); j++ )
+		{
+			for ( int k = 0; k < 3; k++ )
+			{
+				float v = Points[j][k];
+				float v1 = rintf( v );
+				if ( ( v != v1 ) && ( fabs( v - v1 ) < ROUND_VERTEX_EPSILON ) )
+				{
+					Points[j][k] = v1;
+				}
+			}
+		}
+
+		RemoveDuplicatePoints( Points, MIN_EDGE_LENGTH_EPSILON );
+		bGotFaces = true;
+
+		for ( size_t j = 0; j < Points.size(); j++ )
+		{
+			for ( int k = 0; k < 3; k++ )
+			{
+				m_Mins[k] = ( Points[j][k] < m_Mins[k] ) ? Points[j][k] : m_Mins[k];
+				m_Maxs[k] = ( Points[j][k] > m_Maxs[k] ) ? Points[j][k] : m_Maxs[k];
+			}
+		}
+	}
+
+	if ( !bGotFaces )
+	{
+		m_bValid = false;
+		m_Mins.x = m_Mins.y = m_Mins.z = 0;
+		m_Maxs = m_Mins;
+	}
+
+	// Remove faces that don't contribute to this solid.
+	for ( int i = nFaces - 1; i >= 0; i-- )
+	{
+		if ( !useplane[i] || m_Faces[i].m_Points.empty() )
+		{
+			m_Faces.erase( m_Faces.begin() + i );
+		}
+	}
+
+	for ( size_t i = 0; i < m_Faces.size(); i++ )
+	{
+		if ( m_Faces[i].m_Points.size() < 3 )
+		{
+			m_bValid = false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CMapSolid::AddPlane.
+//-----------------------------------------------------------------------------
+bool Solid_t::AddPlane( const Plane_t &Plane )
+{
+	Face_t Face;
+	Face.plane = Plane;
+	m_Faces.push_back( Face );
+	CreateFromPlanes();
+	m_bValid = true;
+	return GetFaceCount() >= 4;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CMapSolid::Carve with no inside list. ClipByFace's back piece keeps
+//			what is behind the carver's face, its front piece what is in front.
+//-----------------------------------------------------------------------------
+static bool Carve( Solid_t &Solid, std::vector<Solid_t> &Outside, Solid_t &Carver )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( ( Solid.m_Mins[i] >= Carver.m_Maxs[i] ) || ( Solid.m_Maxs[i] <= Carver.m_Mins[i] ) )
+		{
+			Outside.push_back( Solid );
+			return false;
+		}
+	}
+
+	Solid_t CarveFrom = Solid;
+
+	for ( int i = 0; i < Carver.GetFaceCount(); i++ )
+	{
+		const Plane_t &Plane = Carver.GetFace( i )->plane;
+		Plane_t Flipped = { { 0 - Plane.normal.x, 0 - Plane.normal.y, 0 - Plane.normal.z }, -Plane.dist };
+
+		Solid_t Front = CarveFrom;
+		if ( Front.AddPlane( Flipped ) )
+		{
+			Outside.push_back( Front );
+		}
+
+		Solid_t Back = CarveFrom;
+		if ( !Back.AddPlane( Plane ) )
+			return false;
+
+		CarveFrom = Back;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CMapSolid::Subtract with no inside list.
+//-----------------------------------------------------------------------------
+static bool Subtract( Solid_t &Solid, std::vector<Solid_t> &Outside, std::vector<Solid_t> &Carvers )
+{
+	bool bIntersected = false;
+	for ( size_t i = 0; i < Carvers.size(); i++ )
+	{
+		bIntersected |= Carve( Solid, Outside, Carvers[i] );
+	}
+	return bIntersected;
+}
+
+//
+// A root level object in the world: a solid, or a group of solids.
+//
+struct Root_t
+{
+	std::vector<Solid_t> m_Solids;
+	Vector_t m_Mins;
+	Vector_t m_Maxs;
+};
+
+struct World_t
+{
+	std::vector<Root_t> m_Roots;
+};
+
+//
+// A world solid after Subtract Selection: the solid itself if it was left
+// alone, or the pieces that replaced it.
+//
+struct Result_t
+{
+	bool bCarved;
+	std::vector<Solid_t> Pieces;
+};
+
+// Subtract Selection as it was: every solid in the world.
+static void SubtractFromAll( World_t &World, std::vector<Solid_t> &Carvers, std::vector<Result_t> &Results )
+{
+	Results.clear();
+	for ( size_t i = 0; i < World.m_Roots.size(); i++ )
+	{
+		for ( size_t j = 0; j < World.m_Roots[i].m_Solids.size(); j++ )
+		{
+			Result_t Result;
+			Result.bCarved = Subtract( World.m_Roots[i].m_Solids[j], Result.Pieces, Carvers );
+			if ( !Result.bCarved )
+			{
+				Result.Pieces.clear();
+			}
+			Results.push_back( Result );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Subtract Selection as it is now. Root objects stand in for what
+//			CullTree_GetObjectsInBox finds; the test is inclusive, as the
+//			cull tree's is.
+//-----------------------------------------------------------------------------
+static void SubtractFromNear( World_t &World, std::vector<Solid_t> &Carvers, std::vector<Result_t> &Results, int *pnTested )
+{
+	Vector_t CarveMins = Carvers[0].m_Mins;
+	Vector_t CarveMaxs = Carvers[0].m_Maxs;
+	for ( size_t i = 1; i < Carvers.size(); i++ )
+	{
+		for ( int k = 0; k < 3; k++ )
+		{
+			CarveMins[k] = ( Carvers[i].m_Mins[k] < CarveMins[k] ) ? Carvers[i].m_Mins[k] : CarveMins[k];
+			CarveMaxs[k] = ( Carvers[i].m_Maxs[k] > CarveMaxs[k] ) ? Carvers[i].m_Maxs[k] : CarveMaxs[k];
+		}
+	}
+
+	Results.clear();
+	*pnTested = 0;
+	for ( size_t i = 0; i < World.m_Roots.size(); i++ )
+	{
+		Root_t &Root = World.m_Roots[i];
+
+		bool bNear = true;
+		for ( int k = 0; k < 3; k++ )
+		{
+			if ( ( Root.m_Mins[k] > CarveMaxs[k] ) || ( Root.m_Maxs[k] < CarveMins[k] ) )
+			{
+				bNear = false;
+			}
+		}
+
+		for ( size_t j = 0; j < Root.m_Solids.size(); j++ )
+		{
+			Solid_t &Solid = Root.m_Solids[j];
+
+			bool bMayIntersect = false;
+			for ( size_t c = 0; bNear && ( c < Carvers.size() ) && !bMayIntersect; c++ )
+			{
+				bMayIntersect = CarveCull_MayIntersect<Vector_t>( &Solid, &Carvers[c] );
+			}
+
+			Result_t Result;
+			Result.bCarved = false;
+			if ( bMayIntersect )
+			{
+				( *pnTested )++;
+				Result.bCarved = Subtract( Solid, Result.Pieces, Carvers );
+				if ( !Result.bCarved )
+				{
+					Result.Pieces.clear();
+				}
+			}
+			Results.push_back( Result );
+		}
+	}
+}
+
+static bool SameSolid( Solid_t &Solid1, Solid_t &Solid2 )
+{
+	if ( ( Solid1.GetFaceCount() != Solid2.GetFaceCount() ) || ( Solid1.m_bValid != Solid2.m_bValid ) )
+		return false;
+
+	for ( int i = 0; i < Solid1.GetFaceCount(); i++ )
+	{
+		Face_t *pFace1 = Solid1.GetFace( i );
+		Face_t *pFace2 = Solid2.GetFace( i );
+		if ( memcmp( &pFace1->plane, &pFace2->plane, sizeof( Plane_t ) ) || ( pFace1->m_Points.size() != pFace2->m_Points.size() ) )
+			return false;
+
+		if ( !pFace1->m_Points.empty() && memcmp( &pFace1->m_Points[0], &pFace2->m_Points[0], pFace1->m_Points.size() * sizeof( Vector_t ) ) )
+			return false;
+	}
+
+	return true;
+}
+
+static bool SameResults( std::vector<Result_t> &Results1, std::vector<Result_t> &Results2 )
+{
+	if ( Results1.size() != Results2.size() )
+		return false;
+
+	for ( size_t i = 0; i < Results1.size(); i++ )
+	{
+		if ( ( Results1[i].bCarved != Results2[i].bCarved ) || ( Results1[i].Pieces.size() != Results2[i].Pieces.size() ) )
+			return false;
+
+		for ( size_t j = 0; j < Results1[i].Pieces.size(); j++ )
+		{
+			if ( !SameSolid( Results1[i].Pieces[j], Results2[i].Pieces[j] ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Random worlds.
+//-----------------------------------------------------------------------------
+static void AddPlane( Solid_t &Solid, float x, float y, float z, float flDist )
+{
+	Face_t Face;
+	Face.plane.normal.x = x;
+	Face.plane.normal.y = y;
+	Face.plane.normal.z = z;
+	Face.plane.dist = flDist;
+	Solid.m_Faces.push_back( Face );
+}
+
+// An axial box on a coarse grid, so that neighbors share planes.
+static void MakeBox( Solid_t &Solid, int nRange )
+{
+	Solid.m_Faces.clear();
+	int nMins[3];
+	int nMaxs[3];
+	for ( int k = 0; k < 3; k++ )
+	{
+		nMins[k] = RandomInt( -nRange, nRange ) * 32;
+		nMaxs[k] = nMins[k] + RandomInt( 1, 6 ) * 32;
+	}
+
+	AddPlane( Solid, 1, 0, 0, (float)nMaxs[0] );
+	AddPlane( Solid, -1, 0, 0, (float)-nMins[0] );
+	AddPlane( Solid, 0, 1, 0, (float)nMaxs[1] );
+	AddPlane( Solid, 0, -1, 0, (float)-nMins[1] );
+	AddPlane( Solid, 0, 0, 1, (float)nMaxs[2] );
+	AddPlane( Solid, 0, 0, -1, (float)-nMins[2] );
+}
+
+// Cuts a corner off with an angled plane through the box's center or near it.
+static void CutCorner( Solid_t &Solid )
+{
+	Vector_t Center = { 0, 0, 0 };
+	for ( int k = 0; k < 3; k++ )
+	{
+		Center[k] = ( Solid.m_Faces[k * 2].plane.dist - Solid.m_Faces[k * 2 + 1].plane.dist ) * 0.5f;
+	}
+
+	Vector_t Normal = { RandomFloat( -1, 1 ), RandomFloat( -1, 1 ), RandomFloat( -1, 1 ) };
+	float flLength = sqrtf( DotProduct( Normal, Normal ) );
+	if ( flLength < 0.1f )
+		return;
+
+	for ( int k = 0; k < 3; k++ )
+	{
+		Normal[k] /= flLength;
+	}
+	AddPlane( Solid, Normal.x, Normal.y, Normal.z, DotProduct( Normal, Center ) + RandomFloat( 0, 48 ) );
+}
+
+static void MakeSolid( Solid_t &Solid, int nRange, int nCuts )
+{
+	MakeBox( Solid, nRange );
+	for ( int i = nCuts; i > 0; i-- )
+	{
+		CutCorner( Solid );
+	}
+	Solid.CreateFromPlanes();
+
+	// Now and then a solid whose points don't match its planes. Carve
+	// rebuilds from the planes, so only its bounds may be trusted.
+	if ( RandomInt( 0, 30 ) == 0 )
+	{
+		Solid.m_bValid = false;
+
+		Vector_t Offset = { RandomInt( -4, 4 ) * 16.0f, RandomInt( -4, 4 ) * 16.0f, RandomInt( -4, 4 ) * 16.0f };
+		for ( int i = 0; i < Solid.GetFaceCount(); i++ )
+		{
+			for ( size_t j = 0; j < Solid.m_Faces[i].m_Points.size(); j++ )
+			{
+				for ( int k = 0; k < 3; k++ )
+				{
+					Solid.m_Faces[i].m_Points[j][k] += Offset[k];
+				}
+			}
+		}
+	}
+}
+
+static void MakeWorld( World_t &World, int nSolids, int nRange )
+{
+	World.m_Roots.clear();
+	while ( nSolids > 0 )
+	{
+		Root_t Root;
+		int nInRoot = ( RandomInt( 0, 3 ) == 0 ) ? RandomInt( 2, 5 ) : 1;
+		for ( int i = 0; ( i < nInRoot ) && ( nSolids > 0 ); i++, nSolids-- )
+		{
+			Solid_t Solid;
+			MakeSolid( Solid, nRange, RandomInt( -2, 2 ) );
+			if ( Solid.GetFaceCount() >= 4 )
+			{
+				Root.m_Solids.push_back( Solid );
+			}
+		}
+
+		if ( Root.m_Solids.empty() )
+			continue;
+
+		Root.m_Mins = Root.m_Solids[0].m_Mins;
+		Root.m_Maxs = Root.m_Solids[0].m_Maxs;
+		for ( size_t i = 1; i < Root.m_Solids.size(); i++ )
+		{
+			for ( int k = 0; k < 3; k++ )
+			{
+				Root.m_Mins[k] = ( Root.m_Solids[i].m_Mins[k] < Root.m_Mins[k] ) ? Root.m_Solids[i].m_Mins[k] : Root.m_Mins[k];
+				Root.m_Maxs[k] = ( Root.m_Solids[i].m_Maxs[k] > Root.m_Maxs[k] ) ? Root.m_Solids[i].m_Maxs[k] : Root.m_Maxs[k];
+			}
+		}
+		World.m_Roots.push_back( Root );
+	}
+}
+
+static void MakeCarvers( std::vector<Solid_t> &Carvers, int nRange )
+{
+	Carvers.clear();
+	for ( int i = RandomInt( 1, 3 ); i > 0; i-- )
+	{
+		Solid_t Carver;
+		MakeSolid( Carver, nRange, RandomInt( -2, 2 ) );
+		Carver.CreateFromPlanes();
+		if ( Carver.GetFaceCount() >= 4 )
+		{
+			Carvers.push_back( Carver );
+		}
+	}
+
+	if ( Carvers.empty() )
+	{
+		MakeCarvers( Carvers, nRange );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Tests.
+//-----------------------------------------------------------------------------
+static void TestMayIntersect( void )
+{
+	int nRejected = 0;
+	int nRejectedByPlane = 0;
+	int nWrong = 0;
+
+	for ( int n = 0; n < 20000; n++ )
+	{
+		Solid_t Solid;
+		Solid_t Carver;
+		MakeSolid( Solid, 1, RandomInt( -2, 2 ) );
+		MakeSolid( Carver, 1, RandomInt( 1, 3 ) );
+		Carver.CreateFromPlanes();
+		if ( ( Solid.GetFaceCount() < 4 ) || ( Carver.GetFaceCount() < 4 ) )
+			continue;
+
+		if ( CarveCull_MayIntersect<Vector_t>( &Solid, &Carver ) )
+			continue;
+
+		nRejected++;
+
+		bool bBoxesApart = false;
+		for ( int k = 0; k < 3; k++ )
+		{
+			bBoxesApart |= ( Solid.m_Mins[k] >= Carver.m_Maxs[k] ) || ( Solid.m_Maxs[k] <= Carver.m_Mins[k] );
+		}
+		nRejectedByPlane += !bBoxesApart;
+
+		// Rejected solids must be ones Carve leaves alone.
+		std::vector<Solid_t> Outside;
+		if ( Carve( Solid, Outside, Carver ) )
+		{
+			nWrong++;
+		}
+	}
+
+	CHECK( nWrong == 0 );
+	CHECK( nRejected > 1000 );
+	CHECK( nRejectedByPlane > 200 );
+}
+
+static void TestSharedPlane( void )
+{
+	// A carver inside the box sharing five of its planes. Carve drops the
+	// duplicates, so the only outside piece is the part of the box the
+	// sixth plane cuts off.
+	Solid_t Solid;
+	AddPlane( Solid, 1, 0, 0, 64 );
+	AddPlane( Solid, -1, 0, 0, 0 );
+	AddPlane( Solid, 0, 1, 0, 64 );
+	AddPlane( Solid, 0, -1, 0, 0 );
+	AddPlane( Solid, 0, 0, 1, 64 );
+	AddPlane( Solid, 0, 0, -1, 0 );
+	Solid.CreateFromPlanes();
+
+	Solid_t Carver = Solid;
+	Carver.m_Faces[1].plane.dist = -32;
+	Carver.CreateFromPlanes();
+
+	CHECK( CarveCull_MayIntersect<Vector_t>( &Solid, &Carver ) );
+
+	std::vector<Solid_t> Outside;
+	CHECK( Carve( Solid, Outside, Carver ) );
+	CHECK( Outside.size() == 1 );
+	CHECK( ( Outside.size() == 1 ) && ( Outside[0].m_Maxs.x == 32 ) );
+}
+
+static void TestRandomWorlds( void )
+{
+	int nDifferences = 0;
+	int nCarved = 0;
+
+	for ( int n = 0; n < 300; n++ )
+	{
+		World_t World;
+		MakeWorld( World, RandomInt( 1, 60 ), 6 );
+
+		std::vector<Solid_t> Carvers;
+		MakeCarvers( Carvers, 6 );
+
+		std::vector<Result_t> All;
+		std::vector<Result_t> Near;
+		int nTested;
+		SubtractFromAll( World, Carvers, All );
+		SubtractFromNear( World, Carvers, Near, &nTested );
+
+		if ( !SameResults( All, Near ) )
+		{
+			nDifferences++;
+		}
+
+		for ( size_t i = 0; i < All.size(); i++ )
+		{
+			nCarved += All[i].bCarved;
+		}
+	}
+
+	CHECK( nDifferences == 0 );
+	CHECK( nCarved > 100 );
+}
+
+static void Benchmark( void )
+{
+	World_t World;
+	MakeWorld( World, 10000, 24 );
+
+	std::vector<Solid_t> Carvers;
+	MakeCarvers( Carvers, 4 );
+
+	std::vector<Result_t> All;
+	std::vector<Result_t> Near;
+	int nTested;
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	SubtractFromAll( World, Carvers, All );
+	double flAllMS = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	SubtractFromNear( World, Carvers, Near, &nTested );
+	double flNearMS = MS( Start );
+
+	CHECK( SameResults( All, Near ) );
+
+	int nCarved = 0;
+	for ( size_t i = 0; i < All.size(); i++ )
+	{
+		nCarved += All[i].bCarved;
+	}
+
+	printf( "Subtracting %d carvers from %d solids, %d carved:\n", (int)Carvers.size(), (int)All.size(), nCarved );
+	printf( "  every solid:         %8.1f ms\n", flAllMS );
+	printf( "  near and may carve:  %8.1f ms (%d subtracted from)\n", flNearMS, nTested );
+}
+
+int main( void )
+{
+	TestSharedPlane();
+	TestMayIntersect();
+	TestRandomWorlds();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All carve cull tests passed\n" );
+
+	Benchmark();
+	return ( g_nFailures != 0 ) ? 1 : 0;
+}
@@ -251,3 +251,70 @@ void CCullTreeNode::UpdateAllCullTreeObjectsRecurse(void)
 		}
 	}
 }
+
+//-----------------------------------------------------------------------------
+// Purpose: Gathers every object in this branch whose cull box intersects the
+//			given box. Objects that straddle several leaves are returned once,
+//			in the order they are first reached.
+// Input  : vecMins, vecMaxs - Box to query.
+//			Objects - Receives the objects. Not cleared first.
+//-----------------------------------------------------------------------------
+void CCullTreeNode::GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects)
+{
+	CUtlHashtable<CMapClass *> Visited;
+	GetObjectsInBoxRecurse(vecMins, vecMaxs, &Objects, Visited);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same as above, for callers that query every frame and keep the set
+//			of visited objects around rather than allocating one per query.
+// Input  : vecMins, vecMaxs - Box to query.
+//			Objects - Receives the objects. Not cleared first.
+//			Visited - Objects not to add again. Receives the objects as well.
+//-----------------------------------------------------------------------------
+void CCullTreeNode::GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects, CUtlHashtable<CMapClass *> &Visited)
+{
+	GetObjectsInBoxRecurse(vecMins, vecMaxs, &Objects, Visited);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CCullTreeNode::GetObjectsInBoxRecurse(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList *pObjects, CUtlHashtable<CMapClass *> &Visited)
+{
+	if (!BoxesIntersect(vecMins, vecMaxs, bmins, bmaxs))
+	{
+		return;
+	}
+
+	int nChildCount = GetChildCount();
+	for (int nChild = 0; nChild < nChildCount; nChild++)
+	{
+		CCullTreeNode *pChild = GetCullTreeChild(nChild);
+		if ((pChild->GetChildCount() != 0) || (pChild->GetObjectCount() != 0))
+		{
+			pChild->GetObjectsInBoxRecurse(vecMins, vecMaxs, pObjects, Visited);
+		}
+	}
+
+	int nObjectCount = GetObjectCount();
+	for (int nObject = 0; nObject < nObjectCount; nObject++)
+	{
+		CMapClass *pObject = GetCullTreeObject(nObject);
+
+		Vector ObjMins;
+		Vector ObjMaxs;
+		pObject->GetCullBox(ObjMins, ObjMaxs);
+		if (!BoxesIntersect(vecMins, vecMaxs, ObjMins, ObjMaxs))
+		{
+			continue;
+		}
+
+		int nVisited = Visited.Count();
+		Visited.Insert(pObject);
+		if ((pObjects != NULL) && (Visited.Count() != nVisited))
+		{
+			pObjects->AddToTail(pObject);
+		}
+	}
+}
@@ -15,6 +15,7 @@
 
 #include "BoundBox.h"
 #include "MapClass.h"
+#include "tier1/utlhashtable.h"
 
 class CCullTreeNode;
 
@@ -55,7 +56,15 @@ class CCullTreeNode : public BoundBox
 		void UpdateCullTreeObject(CMapClass *pObject);
 		void UpdateCullTreeObjectRecurse(CMapClass *pObject);
 
+		//
+		// Queries.
+		//
+		void GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects);
+		void GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects, CUtlHashtable<CMapClass *> &Visited);
+
 	protected:
+		void GetObjectsInBoxRecurse(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList *pObjects, CUtlHashtable<CMapClass *> &Visited);
+
 		CUtlVector<CCullTreeNode*> m_Children;	// The child nodes. This is an octree.
 		CMapObjectList m_Objects;		// The objects contained in this node.
 };
@@ -18,6 +18,7 @@
 #include "utilmatlib.h"
 #include "mathlib/VMatrix.h"
 #include "vstdlib/random.h"
+#include "vstdlib/jobthread.h"
 #include "builddisp.h"
 #include "tier1/utlbuffer.h"
 #include "IEditorTexture.h"
@@ -414,10 +415,36 @@ void DetailObjects::LoadEmitDetailObjectDictionary( const char* pGameDir )
 	values->deleteThis();
 }
 
+//-----------------------------------------------------------------------------
+// Seeds both sequences, like srand( nSeed ) and RandomSeed( nSeed ) did.
+//-----------------------------------------------------------------------------
+void DetailObjects::CDetailRandom::Seed( int nSeed )
+{
+	m_nHoldRand = (unsigned int)nSeed;
+	m_UniformStream.SetSeed( nSeed );
+	m_GaussianStream.AttachToStream( &m_UniformStream );
+}
+
+//-----------------------------------------------------------------------------
+// The CRT's rand(), kept per face so faces can be placed on any thread.
+//-----------------------------------------------------------------------------
+int DetailObjects::CDetailRandom::Rand( void )
+{
+	m_nHoldRand = m_nHoldRand * 214013 + 2531011;
+	return ( m_nHoldRand >> 16 ) & VALVE_RAND_MAX;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+float DetailObjects::CDetailRandom::RandomGaussian( float flMean, float flStdDev )
+{
+	return m_GaussianStream.RandomFloat( flMean, flStdDev );
+}
+
 //-----------------------------------------------------------------------------
 // Selects a detail group
 //-----------------------------------------------------------------------------
-int DetailObjects::SelectGroup( const DetailObject_t& detail, float alpha )
+int DetailObjects::SelectGroup( CDetailRandom &random, const DetailObject_t& detail, float alpha )
 {
 	// Find the two groups whose alpha we're between...
 	int start, end;
@@ -443,7 +470,7 @@ int DetailObjects::SelectGroup( const DetailObject_t& detail, float alpha )
 	}
 
 	// Pick a number, any number...
-	float flR = rand() / (float)VALVE_RAND_MAX;
+	float flR = random.Rand() / (float)VALVE_RAND_MAX;
 
 	// When dist == 0, we *always* want start.
 	// When dist == 1, we *always* want end
@@ -455,10 +482,10 @@ int DetailObjects::SelectGroup( const DetailObject_t& detail, float alpha )
 //-----------------------------------------------------------------------------
 // Selects a detail object
 //-----------------------------------------------------------------------------
-int DetailObjects::SelectDetail( DetailObjectGroup_t const& group )
+int DetailObjects::SelectDetail( CDetailRandom &random, DetailObjectGroup_t const& group )
 {
 	// Pick a number, any number...
-	float flR = rand() / (float)VALVE_RAND_MAX;
+	float flR = random.Rand() / (float)VALVE_RAND_MAX;
 
 	// Look through the list of models + pick the one associated with this number
 	for ( int i = 0; i < group.m_Models.Count(); ++i )
@@ -514,8 +541,10 @@ void DetailObjects::AddDetailSpriteToFace( const Vector &vecOrigin, const QAngle
 // (only when not in the debugger?)
 // Printing the values of normal at the bottom of the function fixes it as does
 // disabling global optimizations.
-void DetailObjects::PlaceDetail( DetailModel_t const& model, const Vector& pt, const Vector& normal )
+void DetailObjects::PlaceDetail( CDetailRandom &random, DetailFaceJob_t &job, int nGroup, int nModel, const Vector& pt, const Vector& normal )
 {
+	DetailModel_t const& model = s_DetailObjectDict[job.m_nDetail].m_Groups[nGroup].m_Models[nModel];
+
 	// But only place it on the surface if it meets the angle constraints...
 	float cosAngle = normal.z;
 
@@ -530,7 +559,7 @@ void DetailObjects::PlaceDetail( DetailModel_t const& model, const Vector& pt, c
 		float probability = (cosAngle - model.m_MaxCosAngle) / 
 			(model.m_MinCosAngle - model.m_MaxCosAngle);
 
-		float t = rand() / (float)VALVE_RAND_MAX;
+		float t = random.Rand() / (float)VALVE_RAND_MAX;
 		if ( t > probability )
 		{
 			return;
@@ -542,7 +571,7 @@ void DetailObjects::PlaceDetail( DetailModel_t const& model, const Vector& pt, c
 	if (model.m_Flags & MODELFLAG_UPRIGHT)
 	{
 		// If it's upright, we just select a random yaw
-		angles.Init( 0, 360.0f * rand() / (float)VALVE_RAND_MAX, 0.0f );
+		angles.Init( 0, 360.0f * random.Rand() / (float)VALVE_RAND_MAX, 0.0f );
 	}
 	else
 	{
@@ -566,7 +595,7 @@ void DetailObjects::PlaceDetail( DetailModel_t const& model, const Vector& pt, c
 		matrix.SetBasisVectors( xaxis, yaxis, zaxis );
 		matrix.SetTranslation( vec3_origin );
 
-		float rotAngle = 360.0f * rand() / (float)VALVE_RAND_MAX;
+		float rotAngle = 360.0f * random.Rand() / (float)VALVE_RAND_MAX;
 		VMatrix rot = SetupMatrixAxisRot( Vector( 0, 0, 1 ), rotAngle );
 		matrix = matrix * rot;
 
@@ -575,34 +604,50 @@ void DetailObjects::PlaceDetail( DetailModel_t const& model, const Vector& pt, c
 
 	// FIXME: We may also want a purely random rotation too
 
-	// Insert an element into the object dictionary if it aint there...
-	switch ( model.m_Type )
+	// Sprites and procedural models made from sprites can be scaled
+	float flScale = 1.0f;
+	if ( ( model.m_Type != DETAIL_PROP_TYPE_MODEL ) && ( model.m_flRandomScaleStdDev != 0.0f ) )
 	{
-	case DETAIL_PROP_TYPE_MODEL:
-		AddDetailModelToFace( model.m_ModelName.String(), pt, angles, model.m_Orientation );
-		break;
+		flScale = fabs( random.RandomGaussian( 1.0f, model.m_flRandomScaleStdDev ) );
+	}
 
-	// Sprites and procedural models made from sprites
-	case DETAIL_PROP_TYPE_SPRITE:
-	default:
-		{
-			float flScale = 1.0f;
-			if ( model.m_flRandomScaleStdDev != 0.0f ) 
-			{
-				flScale = fabs( RandomGaussianFloat( 1.0f, model.m_flRandomScaleStdDev ) );
-			}
+	// The model or sprite is made on the main thread.
+	int i = job.m_Placements.AddToTail();
+	DetailPlacement_t &placement = job.m_Placements[i];
+	placement.m_nGroup = nGroup;
+	placement.m_nModel = nModel;
+	placement.m_vecOrigin = pt;
+	placement.m_vecAngles = angles;
+	placement.m_flScale = flScale;
+}
 
-			AddDetailSpriteToFace( pt, angles, model, flScale );
-		}
-		break;
+//-----------------------------------------------------------------------------
+// Is the point inside a func_detail_blocker?
+//-----------------------------------------------------------------------------
+bool DetailObjects::IsDetailBlocked( DetailFaceJob_t &job, const Vector &pt )
+{
+#ifdef SLE //// SLE NEW - block detailsprites with detail blockers
+	if ( !job.m_pBlockers )
+		return false;
+
+	for ( int b=0; b<job.m_pBlockers->Count(); ++b )
+	{
+		CMapEntity *blocker = job.m_pBlockers->Element( b );
+		if ( blocker->ContainsPoint( pt ) )
+			return true;
 	}
+#endif
+	return false;
 }
 
 //-----------------------------------------------------------------------------
 // Places Detail Objects on a face
 //-----------------------------------------------------------------------------
-void DetailObjects::EmitDetailObjectsOnFace(CMapFace *pMapFace, DetailObject_t& detail)
+void DetailObjects::EmitDetailObjectsOnFace( CDetailRandom &random, DetailFaceJob_t &job )
 {
+	CMapFace *pMapFace = job.m_pMapFace;
+	DetailObject_t& detail = s_DetailObjectDict[job.m_nDetail];
+
 	// See how many points define this particular face
 	int	nPoints = pMapFace->GetPointCount();
 
@@ -610,11 +655,6 @@ void DetailObjects::EmitDetailObjectsOnFace(CMapFace *pMapFace, DetailObject_t&
 	if ( nPoints < 3 )
 		return;
 
-#ifdef SLE //// SLE NEW - block detailsprites with detail blockers
-	CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
-	CMapEntityList detailBlockers;
-	pDoc->FindEntitiesByClassName(detailBlockers, "func_detail_blocker", false);
-#endif
 	// Get the first point of the face
 	Vector	p0;
 	pMapFace->GetPoint(p0,0);
@@ -643,8 +683,8 @@ void DetailObjects::EmitDetailObjectsOnFace(CMapFace *pMapFace, DetailObject_t&
 		for (int j = 0; j < numSamples; ++j )
 		{
 			// Create a random sample location...
-			float u = rand() / (float)VALVE_RAND_MAX;
-			float v = rand() / (float)VALVE_RAND_MAX;
+			float u = random.Rand() / (float)VALVE_RAND_MAX;
+			float v = random.Rand() / (float)VALVE_RAND_MAX;
 
 			// Make sure the u,v coordinate stay within the triangle boundaries (ie they NOT in the far half of the parallelogram)
 			if (v > 1.0f - u)
@@ -659,10 +699,10 @@ void DetailObjects::EmitDetailObjectsOnFace(CMapFace *pMapFace, DetailObject_t&
 			float alpha = 1.0f;
 
 			// Select a group based on the alpha value
-			int group = SelectGroup( detail, alpha );
+			int group = SelectGroup( random, detail, alpha );
 
 			// Now that we've got a group, choose a detail
-			int model = SelectDetail( detail.m_Groups[group] );
+			int model = SelectDetail( random, detail.m_Groups[group] );
 			if ( model < 0 )
 			{
 				continue;
@@ -672,24 +712,11 @@ void DetailObjects::EmitDetailObjectsOnFace(CMapFace *pMapFace, DetailObject_t&
 			VectorMA( p0, u, e1, pt );
 			VectorMA( pt, v, e2, pt );
 			VectorDivide( areaVec, -normalLength, normal );
-			
-#ifdef SLE //// SLE NEW - block detailsprites with detail blockers
-			bool blocked = false;
-			for ( int b=0; b<detailBlockers.Count(); ++b )
-			{
-				CMapEntity *blocker = detailBlockers[b];
-				if ( blocker->ContainsPoint( pt ) )
-				{
-					blocked = true;
-					break;
-				}
-			}
 
-			if ( blocked )
+			if ( IsDetailBlocked( job, pt ) )
 				continue;
-#endif		////
 
-			PlaceDetail( detail.m_Groups[group].m_Models[model], pt, normal );
+			PlaceDetail( random, job, group, model, pt, normal );
 		}
 	}
 }
@@ -722,16 +749,12 @@ float DetailObjects::ComputeDisplacementFaceArea( CMapFace *pMapFace )
 //-----------------------------------------------------------------------------
 // Places Detail Objects on a face
 //-----------------------------------------------------------------------------
-void DetailObjects::EmitDetailObjectsOnDisplacementFace( CMapFace *pMapFace, 
-						DetailObject_t& detail )
+void DetailObjects::EmitDetailObjectsOnDisplacementFace( CDetailRandom &random, DetailFaceJob_t &job )
 {
-	assert(pMapFace->GetPointCount() == 4);
+	CMapFace *pMapFace = job.m_pMapFace;
+	DetailObject_t& detail = s_DetailObjectDict[job.m_nDetail];
 
-#ifdef SLE //// SLE NEW - block detailsprites with detail blockers
-	CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
-	CMapEntityList detailBlockers;
-	pDoc->FindEntitiesByClassName(detailBlockers, "func_detail_blocker", false);
-#endif	////
+	assert(pMapFace->GetPointCount() == 4);
 
 	// We're going to pick a bunch of random points, and then probabilistically
 	// decide whether or not to plant a detail object there.
@@ -742,16 +765,14 @@ void DetailObjects::EmitDetailObjectsOnDisplacementFace( CMapFace *pMapFace,
 	// Compute the number of samples to take
 	int numSamples = area * detail.m_Density * 0.000001;
 
-	EditDispHandle_t	editdisphandle = pMapFace->GetDisp();
-	CMapDisp			*pMapDisp = EditDispMgr()->GetDisp(editdisphandle);
-	CCoreDispInfo		*pCoreDispInfo = pMapDisp->GetCoreDispInfo();
+	CCoreDispInfo		*pCoreDispInfo = job.m_pCoreDispInfo;
 
 	// Now take a sample, and randomly place an object there
 	for (int i = 0; i < numSamples; ++i )
 	{
 		// Create a random sample...
-		float u = rand() / (float)VALVE_RAND_MAX;
-		float v = rand() / (float)VALVE_RAND_MAX;
+		float u = random.Rand() / (float)VALVE_RAND_MAX;
+		float v = random.Rand() / (float)VALVE_RAND_MAX;
 
 		// Compute alpha
 		float alpha;
@@ -759,32 +780,19 @@ void DetailObjects::EmitDetailObjectsOnDisplacementFace( CMapFace *pMapFace,
 		pCoreDispInfo->GetPositionOnSurface( u, v, pt, &normal, &alpha );
 		alpha /= 255.0f;
 
-#ifdef SLE	//// SLE NEW - block detailsprites with detail blockers
-		bool blocked = false;
-		for (int b = 0; b<detailBlockers.Count(); ++b)
-		{
-			CMapEntity *blocker = detailBlockers[b];
-			if (blocker->ContainsPoint(pt))
-			{
-				blocked = true;
-				break;
-			}
-		}
-
-		if (blocked)
+		if ( IsDetailBlocked( job, pt ) )
 			continue;
-#endif	////
 
 		// Select a group based on the alpha value
-		int group = SelectGroup( detail, alpha );
+		int group = SelectGroup( random, detail, alpha );
 
 		// Now that we've got a group, choose a detail
-		int model = SelectDetail( detail.m_Groups[group] );
+		int model = SelectDetail( random, detail.m_Groups[group] );
 		if (model < 0)
 			continue;
 
 		// Got a detail! Place it on the surface...
-		PlaceDetail( detail.m_Groups[group].m_Models[model], pt, normal );
+		PlaceDetail( random, job, group, model, pt, normal );
 	}
 }
 
@@ -800,104 +808,223 @@ bool	DetailObjects::ShouldRenderLast(void)
 // Builds Detail Objects for a particular face
 //-----------------------------------------------------------------------------
 void	DetailObjects::BuildAnyDetailObjects(CMapFace *pMapFace)
+{
+	BuildDetailObjects( &pMapFace, 1 );
+}
+
+//-----------------------------------------------------------------------------
+// Builds Detail Objects for many faces. The details are placed on worker
+// threads, each face with its own random numbers, so they come out the same
+// as placing the faces one at a time.
+//-----------------------------------------------------------------------------
+void DetailObjects::BuildDetailObjects( CMapFace **ppMapFaces, int nMapFaces )
 {
 	// Ignore this call while loading the VMF or else we'll generate a lot of redundant ones.
 	if ( !s_bBuildDetailObjects )
 		return;
-		
-	if ( pMapFace->IsCordonFace() )
+
+	CUtlVector<DetailFaceJob_t> jobs;
+	for ( int i = 0; i < nMapFaces; i++ )
+	{
+		int iJob = jobs.AddToTail();
+		if ( !BeginDetailFaceJob( ppMapFaces[i], jobs[iJob] ) )
+		{
+			jobs.Remove( iJob );
+		}
+	}
+
+	if ( jobs.Count() == 0 )
 		return;
+
+#ifdef SLE //// SLE NEW - block detailsprites with detail blockers
+	CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
+	CMapEntityList detailBlockers;
+	pDoc->FindEntitiesByClassName(detailBlockers, "func_detail_blocker", false);
+
+	for ( int iJob = 0; iJob < jobs.Count(); iJob++ )
+	{
+		jobs[iJob].m_pBlockers = &detailBlockers;
+	}
+#endif
+
+	if ( jobs.Count() > 1 )
+	{
+		ParallelProcess( "DetailObjects::RunDetailFaceJob", jobs.Base(), jobs.Count(), &DetailObjects::RunDetailFaceJob );
+	}
+	else
+	{
+		RunDetailFaceJob( jobs[0] );
+	}
+
+	for ( int iJob = 0; iJob < jobs.Count(); iJob++ )
+	{
+		FinishDetailFaceJob( jobs[iJob] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Clears the face's details and sets up the job that places new ones.
+// Returns false if the face has no details to place, or the details it has
+// would be placed again exactly as they are.
+//-----------------------------------------------------------------------------
+bool DetailObjects::BeginDetailFaceJob( CMapFace *pMapFace, DetailFaceJob_t &job )
+{
+	if ( pMapFace->IsCordonFace() )
+		return false;
 	
 	// Try to get at the material
 	bool found;
 
 	IEditorTexture *pEditorTexture = pMapFace->GetTexture();
 	if ( !pEditorTexture )
-		return;
+		return false;
 
 	IMaterial *pMaterial = pEditorTexture->GetMaterial();
 	if ( !pMaterial )
-		return;
+		return false;
 
 	IMaterialVar *pMaterialVar = pMaterial->FindVar("%detailtype", &found, false );
 	if ( !found || !pMaterialVar )
-		return;
+		return false;
 
 	const char* pDetailType = pMaterialVar->GetStringValue();
 	if ( !pDetailType )
-		return;
+		return false;
 
 	// Get the detail type...
 	DetailObject_t search;
 	search.m_Name = pDetailType;
+	int objectType = s_DetailObjectDict.Find(search);
+
+	// Initialize the Random Number generators for detail prop placement based on the origFace num.
+	int	detailpropseed = pMapFace->GetFaceID();
 
+	// Same geometry, type and seed, same details. Sculpting a displacement
+	// leaves its face alone, so displacements are always placed again.
 	DetailObjects	*pDetails = pMapFace->m_pDetailObjects;
+	if ( pDetails && ( objectType >= 0 ) && !pMapFace->HasDisp() &&
+		 ( pDetails->m_nBuiltDetail == objectType ) && ( pDetails->m_nBuiltSeed == detailpropseed ) &&
+		 ( pDetails->m_nBuiltRevision == pMapFace->GetRevision() ) )
+	{
+		return false;
+	}
+
 	if ( pMapFace->m_pDetailObjects )
 	{
 		pDetails->m_DetailModels.PurgeAndDeleteElements();
 		pDetails->m_DetailSprites.PurgeAndDeleteElements(); 
+		pDetails->m_nBuiltDetail = -1;
 	}
 	else
 	{
 		pMapFace->m_pDetailObjects = pDetails = new DetailObjects;
 	}
 
-	if ( pDetails )
+	if ( !pDetails )
 	{
-		// Set the center the "detailobjects" to be the average of the face points
-		int	nPoints = pMapFace->GetPointCount();
+		Warning("Could not allocate DetailObject for CMapFace!\n");
+		return false;
+	}
+
+	// Set the center the "detailobjects" to be the average of the face points
+	int	nPoints = pMapFace->GetPointCount();
 #ifdef SLE
-		if (nPoints == 0) return; // 0 happens when using the clipping tool...
+	if (nPoints == 0) return false; // 0 happens when using the clipping tool...
 #endif
-		Vector	faceCenter, faceCorner;
-		faceCenter.Init();
-		for ( int point=0; point < nPoints; point++ )
-		{
-			pMapFace->GetPoint(faceCorner,point);
-			faceCenter += faceCorner;
-		}
+	Vector	faceCenter, faceCorner;
+	faceCenter.Init();
+	for ( int point=0; point < nPoints; point++ )
+	{
+		pMapFace->GetPoint(faceCorner,point);
+		faceCenter += faceCorner;
+	}
 #ifdef SLE
-		Assert(nPoints != 0); // just checked it...
+	Assert(nPoints != 0); // just checked it...
 #endif
-		faceCenter /= nPoints;
-
-		pDetails->SetOrigin( faceCenter );
+	faceCenter /= nPoints;
 
-		int objectType = s_DetailObjectDict.Find(search);
-		if (objectType < 0)
-		{
-			char	szTextureName[MAX_PATH];
-			pMapFace->GetTextureName(szTextureName);
-			Warning("Material %s uses unknown detail object type %s!\n", szTextureName, pDetailType);
-			return;
-		}
+	pDetails->SetOrigin( faceCenter );
 
-		// Emit objects on a particular face
-		DetailObject_t& detail = s_DetailObjectDict[objectType];
+	if (objectType < 0)
+	{
+		char	szTextureName[MAX_PATH];
+		pMapFace->GetTextureName(szTextureName);
+		Warning("Material %s uses unknown detail object type %s!\n", szTextureName, pDetailType);
+		return false;
+	}
 
-		// Initialize the Random Number generators for detail prop placement based on the origFace num.
-		int	detailpropseed = pMapFace->GetFaceID();
 #ifdef WARNSEEDNUMBER
-		Warning("[%d]\n",detailpropseed);
+	Warning("[%d]\n",detailpropseed);
 #endif
-		srand( detailpropseed );
-		RandomSeed( detailpropseed );
 
-		if ( pMapFace->HasDisp() )
-		{
-			pDetails->EmitDetailObjectsOnDisplacementFace( pMapFace, detail );
-		}
-		else
-		{
-			pDetails->EmitDetailObjectsOnFace( pMapFace, detail );
-		}
+	job.m_pMapFace = pMapFace;
+	job.m_pCoreDispInfo = NULL;
+	job.m_nDetail = objectType;
+	job.m_nSeed = detailpropseed;
+	job.m_pBlockers = NULL;
+
+	if ( pMapFace->HasDisp() )
+	{
+		EditDispHandle_t	editdisphandle = pMapFace->GetDisp();
+		CMapDisp			*pMapDisp = EditDispMgr()->GetDisp(editdisphandle);
+		job.m_pCoreDispInfo = pMapDisp->GetCoreDispInfo();
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Places the details of one face. Called on worker threads; only reads the
+// face and the detail dictionary.
+//-----------------------------------------------------------------------------
+void DetailObjects::RunDetailFaceJob( DetailFaceJob_t &job )
+{
+	CDetailRandom random;
+	random.Seed( job.m_nSeed );
+
+	if ( job.m_pCoreDispInfo )
+	{
+		EmitDetailObjectsOnDisplacementFace( random, job );
 	}
 	else
 	{
-		Warning("Could not allocate DetailObject for CMapFace!\n");
+		EmitDetailObjectsOnFace( random, job );
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Makes the models and sprites for the details a job placed.
+//-----------------------------------------------------------------------------
+void DetailObjects::FinishDetailFaceJob( DetailFaceJob_t &job )
+{
+	DetailObjects *pDetails = job.m_pMapFace->m_pDetailObjects;
+	DetailObject_t& detail = s_DetailObjectDict[job.m_nDetail];
+
+	for ( int i = 0; i < job.m_Placements.Count(); i++ )
+	{
+		DetailPlacement_t &placement = job.m_Placements[i];
+		DetailModel_t const& model = detail.m_Groups[placement.m_nGroup].m_Models[placement.m_nModel];
+
+		// Insert an element into the object dictionary if it aint there...
+		switch ( model.m_Type )
+		{
+		case DETAIL_PROP_TYPE_MODEL:
+			pDetails->AddDetailModelToFace( model.m_ModelName.String(), placement.m_vecOrigin, placement.m_vecAngles, model.m_Orientation );
+			break;
+
+		// Sprites and procedural models made from sprites
+		case DETAIL_PROP_TYPE_SPRITE:
+		default:
+			pDetails->AddDetailSpriteToFace( placement.m_vecOrigin, placement.m_vecAngles, model, placement.m_flScale );
+			break;
+		}
+	}
+
+	pDetails->m_nBuiltRevision = job.m_pMapFace->GetRevision();
+	pDetails->m_nBuiltDetail = job.m_nDetail;
+	pDetails->m_nBuiltSeed = job.m_nSeed;
+}
+
 void DetailObjects::EnableBuildDetailObjects( bool bEnable )
 {
 	s_bBuildDetailObjects = bEnable;
@@ -17,9 +17,12 @@
 #include "mapface.h"
 #include "mapdisp.h"
 #include "utlsymbol.h"
+#include "vstdlib/random.h"
 #include "sprite.h"
 #include "studiomodel.h"
 
+class CMapEntity;
+
 //=============================================================================
 // DetailObjects:: class
 //=============================================================================
@@ -46,7 +49,7 @@ class DetailObjects : public CMapPoint
 // Contructors / Destructors
 //-----------------------------------------------------------------------------
 public:
-	DetailObjects() {}
+	DetailObjects() : m_nBuiltRevision( 0 ), m_nBuiltDetail( -1 ), m_nBuiltSeed( 0 ) {}
 	~DetailObjects();
 //-----------------------------------------------------------------------------
 // Internal Constants & Data Structures
@@ -113,6 +116,43 @@ protected:
 			return src.m_Name == m_Name;
 		}
 	};
+
+	// Random numbers for the details of one face. Produces the same sequences
+	// srand/rand and RandomSeed/RandomGaussianFloat did, without sharing any
+	// state with other faces or threads.
+	class CDetailRandom
+	{
+	public:
+		void	Seed( int nSeed );
+		int		Rand( void );				// Same sequence as rand() after srand.
+		float	RandomGaussian( float flMean, float flStdDev );
+
+	private:
+		unsigned int			m_nHoldRand;
+		CUniformRandomStream	m_UniformStream;
+		CGaussianRandomStream	m_GaussianStream;
+	};
+
+	// A detail worked out on a worker thread, made into a model or sprite later.
+	struct DetailPlacement_t
+	{
+		int		m_nGroup;
+		int		m_nModel;
+		Vector	m_vecOrigin;
+		QAngle	m_vecAngles;
+		float	m_flScale;
+	};
+
+	// The details of one face.
+	struct DetailFaceJob_t
+	{
+		CMapFace							*m_pMapFace;
+		CCoreDispInfo						*m_pCoreDispInfo;	// NULL unless the face has a displacement.
+		int									m_nDetail;			// Index into s_DetailObjectDict.
+		int									m_nSeed;
+		const CUtlVector<CMapEntity *>		*m_pBlockers;		// func_detail_blockers, SLE only.
+		CUtlVector<DetailPlacement_t>		m_Placements;
+	};
 	
 //-----------------------------------------------------------------------------
 // Publically callable interfaces
@@ -120,6 +160,7 @@ protected:
 public:
 	static void	LoadEmitDetailObjectDictionary( char const* pGameDir );
 	static void	BuildAnyDetailObjects(CMapFace *);
+	static void	BuildDetailObjects( CMapFace **ppMapFaces, int nMapFaces );	// Places the details of many faces in parallel.
 	static void EnableBuildDetailObjects( bool bBuild );	// This is used to delay building detail objects until the
 															// end of the map load. Prevents it from generating the
 															// detail objects 3x more often than necessary.
@@ -136,12 +177,17 @@ protected:
 	static void	ParseDetailGroup( int detailId, KeyValues* pGroupKeyValues );
 
 	bool	LoadStudioModel( char const* pFileName, char const* pEntityType, CUtlBuffer& buf );
-	float	ComputeDisplacementFaceArea( CMapFace *pMapFace );
-	int		SelectGroup( const DetailObject_t& detail, float alpha );
-	int		SelectDetail( DetailObjectGroup_t const& group );
-	void	PlaceDetail( DetailModel_t const& model, const Vector& pt, const Vector& normal );
-	void	EmitDetailObjectsOnFace( CMapFace *pMapFace, DetailObject_t& detail );
-	void	EmitDetailObjectsOnDisplacementFace( CMapFace *pMapFace, DetailObject_t& detail );
+	static float	ComputeDisplacementFaceArea( CMapFace *pMapFace );
+	static int		SelectGroup( CDetailRandom &random, const DetailObject_t& detail, float alpha );
+	static int		SelectDetail( CDetailRandom &random, DetailObjectGroup_t const& group );
+	static void		PlaceDetail( CDetailRandom &random, DetailFaceJob_t &job, int nGroup, int nModel, const Vector& pt, const Vector& normal );
+	static bool		IsDetailBlocked( DetailFaceJob_t &job, const Vector &pt );
+	static void		EmitDetailObjectsOnFace( CDetailRandom &random, DetailFaceJob_t &job );
+	static void		EmitDetailObjectsOnDisplacementFace( CDetailRandom &random, DetailFaceJob_t &job );
+
+	static bool		BeginDetailFaceJob( CMapFace *pMapFace, DetailFaceJob_t &job );
+	static void		RunDetailFaceJob( DetailFaceJob_t &job );
+	static void		FinishDetailFaceJob( DetailFaceJob_t &job );
 
 	void	AddDetailSpriteToFace( const Vector &vecOrigin, const QAngle &vecAngles, DetailModel_t const& model, float flScale );
 	void	AddDetailModelToFace( const char* pModelName, const Vector& pt, const QAngle& angles, int nOrientation );
@@ -155,6 +201,12 @@ protected:
 
 	CUtlVector<CSpriteModel *>	m_DetailSprites;
 	CUtlVector<StudioModel *>	m_DetailModels;
+
+	// What the details were last placed for. Placing them again for the same
+	// face geometry, detail type and seed would give the same details.
+	unsigned int				m_nBuiltRevision;
+	int							m_nBuiltDetail;
+	int							m_nBuiltSeed;
 };
 
 #endif // DETAILOBJECTS_H
@@ -14,6 +14,7 @@
 #include "GlobalFunctions.h"
 #include "History.h"
 #include "DispSew.h"
+#include "EditorProfiler.h"
 #ifdef SLE
 #include <mmsystem.h>
 #include "mapview3d.h"
@@ -117,6 +118,8 @@ bool CDispPaintMgr::PostPaint( bool bAutoSew )
 //-----------------------------------------------------------------------------
 bool CDispPaintMgr::DoPaint( SpatialPaintData_t &spatialData )
 {
+	EDITOR_PROFILE_SCOPE( "CDispPaintMgr::DoPaint" );
+
 	// Get the displacement manager from the active map document.
 	IWorldEditDispMgr *pDispMgr = GetActiveWorldEditDispManager();
 	if( !pDispMgr )
@@ -18,6 +18,9 @@
 #include "collisionutils.h"
 #include "TextureSystem.h"
 #include "mapoverlay.h"
+#include "worldsize.h"
+#include "tier1/utlhashtable.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -29,6 +32,10 @@ IMPLEMENT_MAPCLASS( CMapOverlayTransition )
 #define DISPSHORE_VECTOR_EPS		0.1f
 #define	DISPSHORE_SURF_LENGTH		120.0f
 
+#define DISPSHORE_GRID_MAX_CELLS	64			// Water face grid cells per axis, at most.
+#define DISPSHORE_GRID_MARGIN		1.0f		// Water face boxes are grown by this much, so touching boxes share a cell.
+#define DISPSHORE_ENDPOINT_CELL		1.0f		// Size of the endpoint hash cells.
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -114,6 +121,387 @@ void Shoreline_t::AddSegment( Vector &vecPoint0, Vector &vecPoint1,
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Sorts face and segment indices in ascending order.
+//-----------------------------------------------------------------------------
+static int __cdecl CompareShoreIndices( const int *pIndex1, const int *pIndex2 )
+{
+	return *pIndex1 - *pIndex2;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sorts (water face, face) index pairs, water face first.
+//-----------------------------------------------------------------------------
+static int __cdecl CompareShorePairs( const void *pPair1, const void *pPair2 )
+{
+	const int *pIndices1 = ( const int * )pPair1;
+	const int *pIndices2 = ( const int * )pPair2;
+	if ( pIndices1[0] != pIndices2[0] )
+		return pIndices1[0] - pIndices2[0];
+
+	return pIndices1[1] - pIndices2[1];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sorts a list of indices and removes the repeats.
+//-----------------------------------------------------------------------------
+static void SortUniqueShoreIndices( CUtlVector<int> &aIndices )
+{
+	aIndices.Sort( CompareShoreIndices );
+
+	int nUnique = 0;
+	for ( int i = 0; i < aIndices.Count(); ++i )
+	{
+		if ( ( nUnique == 0 ) || ( aIndices[nUnique-1] != aIndices[i] ) )
+		{
+			aIndices[nUnique++] = aIndices[i];
+		}
+	}
+	aIndices.SetCountNonDestructively( nUnique );
+}
+
+//=============================================================================
+//
+// CShoreWaterGrid
+//
+// Buckets the water faces by the XY extents of their solids, so the faces
+// near a point or box can be found without testing every water face.
+// Results are face indices in ascending order, so callers visit them in the
+// same order as a loop over every face would.
+//
+class CShoreWaterGrid
+{
+public:
+	void Build( CUtlVector<CMapFace*> &aWaterFaces );
+	void FindFaces( const Vector &vecMin, const Vector &vecMax, CUtlVector<int> &aFaces ) const;
+
+	int			GetFaceCount( void ) const		{ return m_pWaterFaces->Count(); }
+	CMapFace	*GetFace( int iFace ) const		{ return m_pWaterFaces->Element( iFace ); }
+
+private:
+	void GetCellRange( const Vector &vecMin, const Vector &vecMax, int *pCellMin, int *pCellMax ) const;
+
+	CUtlVector<CMapFace*>	*m_pWaterFaces;
+	Vector2D				m_vecOrigin;
+	float					m_flOOCellSize;
+	int						m_nCells[2];
+	CUtlVector<int>			m_aCellStart;		// Start of each cell's faces in m_aCellFaces, plus an end.
+	CUtlVector<int>			m_aCellFaces;
+	CUtlVector<int>			m_aUnbucketedFaces;	// Faces too large or too irregular to bucket; always returned.
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: The solid's cull box is what CMapDisp::CreateShoreOverlays tests
+//			against, and it holds every point of the face.
+//-----------------------------------------------------------------------------
+static bool GetWaterFaceBox( CMapFace *pWaterFace, Vector &vecMin, Vector &vecMax )
+{
+	// Displaced water surfaces may leave their solid's box.
+	if ( pWaterFace->HasDisp() )
+		return false;
+
+	CMapSolid *pSolid = static_cast<CMapSolid*>( pWaterFace->GetParent() );
+	pSolid->GetCullBox( vecMin, vecMax );
+
+	for ( int iAxis = 0; iAxis < 2; ++iAxis )
+	{
+		if ( ( vecMax[iAxis] - vecMin[iAxis] ) >= MAX_COORD_INTEGER )
+			return false;
+
+		vecMin[iAxis] -= DISPSHORE_GRID_MARGIN;
+		vecMax[iAxis] += DISPSHORE_GRID_MARGIN;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CShoreWaterGrid::Build( CUtlVector<CMapFace*> &aWaterFaces )
+{
+	m_pWaterFaces = &aWaterFaces;
+	m_aCellStart.Purge();
+	m_aCellFaces.Purge();
+	m_aUnbucketedFaces.Purge();
+
+	// Find the extents of the faces that can be bucketed.
+	int nWaterFaceCount = aWaterFaces.Count();
+	CUtlVector<Vector> aBoxes;
+	aBoxes.SetSize( nWaterFaceCount * 2 );
+
+	Vector vecGridMin( FLT_MAX, FLT_MAX, 0.0f );
+	Vector vecGridMax( -FLT_MAX, -FLT_MAX, 0.0f );
+	int nBucketed = 0;
+	for ( int iWaterFace = 0; iWaterFace < nWaterFaceCount; ++iWaterFace )
+	{
+		CMapFace *pWaterFace = aWaterFaces[iWaterFace];
+		if ( !pWaterFace )
+		{
+			aBoxes[iWaterFace*2].Init( 1.0f, 0.0f, 0.0f );	// Empty; never found.
+			aBoxes[iWaterFace*2+1].Init( -1.0f, 0.0f, 0.0f );
+			continue;
+		}
+
+		if ( !GetWaterFaceBox( pWaterFace, aBoxes[iWaterFace*2], aBoxes[iWaterFace*2+1] ) )
+		{
+			aBoxes[iWaterFace*2].Init( 1.0f, 0.0f, 0.0f );
+			aBoxes[iWaterFace*2+1].Init( -1.0f, 0.0f, 0.0f );
+			m_aUnbucketedFaces.AddToTail( iWaterFace );
+			continue;
+		}
+
+		for ( int iAxis = 0; iAxis < 2; ++iAxis )
+		{
+			vecGridMin[iAxis] = MIN( vecGridMin[iAxis], aBoxes[iWaterFace*2][iAxis] );
+			vecGridMax[iAxis] = MAX( vecGridMax[iAxis], aBoxes[iWaterFace*2+1][iAxis] );
+		}
+		++nBucketed;
+	}
+
+	if ( nBucketed == 0 )
+	{
+		m_vecOrigin.Init();
+		m_flOOCellSize = 0.0f;
+		m_nCells[0] = m_nCells[1] = 1;
+		m_aCellStart.AddToTail( 0 );
+		m_aCellStart.AddToTail( 0 );
+		return;
+	}
+
+	// Roughly one face per cell, in square cells.
+	float flExtent = MAX( vecGridMax.x - vecGridMin.x, vecGridMax.y - vecGridMin.y );
+	int nCellsPerAxis = clamp( ( int )sqrtf( ( float )nBucketed ), 1, DISPSHORE_GRID_MAX_CELLS );
+	float flCellSize = MAX( flExtent / ( float )nCellsPerAxis, 1.0f );
+
+	m_vecOrigin.Init( vecGridMin.x, vecGridMin.y );
+	m_flOOCellSize = 1.0f / flCellSize;
+	for ( int iAxis = 0; iAxis < 2; ++iAxis )
+	{
+		m_nCells[iAxis] = clamp( ( int )( ( vecGridMax[iAxis] - vecGridMin[iAxis] ) * m_flOOCellSize ) + 1, 1, DISPSHORE_GRID_MAX_CELLS );
+	}
+
+	// Count the faces in each cell, then fill the cells.
+	int nCellCount = m_nCells[0] * m_nCells[1];
+	m_aCellStart.SetSize( nCellCount + 1 );
+	memset( m_aCellStart.Base(), 0, m_aCellStart.Count() * sizeof( int ) );
+
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		for ( int iWaterFace = 0; iWaterFace < nWaterFaceCount; ++iWaterFace )
+		{
+			const Vector &vecMin = aBoxes[iWaterFace*2];
+			const Vector &vecMax = aBoxes[iWaterFace*2+1];
+			if ( vecMin.x > vecMax.x )
+				continue;
+
+			int nCellMin[2], nCellMax[2];
+			GetCellRange( vecMin, vecMax, nCellMin, nCellMax );
+			for ( int y = nCellMin[1]; y <= nCellMax[1]; ++y )
+			{
+				for ( int x = nCellMin[0]; x <= nCellMax[0]; ++x )
+				{
+					int iCell = y * m_nCells[0] + x;
+					if ( nPass == 0 )
+					{
+						m_aCellStart[iCell+1]++;
+					}
+					else
+					{
+						// m_aCellStart[iCell] is used as the fill position, see below.
+						m_aCellFaces[m_aCellStart[iCell]++] = iWaterFace;
+					}
+				}
+			}
+		}
+
+		if ( nPass == 0 )
+		{
+			for ( int iCell = 0; iCell < nCellCount; ++iCell )
+			{
+				m_aCellStart[iCell+1] += m_aCellStart[iCell];
+			}
+			m_aCellFaces.SetSize( m_aCellStart[nCellCount] );
+		}
+		else
+		{
+			// Filling moved every start to the next cell's start; move them back.
+			for ( int iCell = nCellCount; iCell > 0; --iCell )
+			{
+				m_aCellStart[iCell] = m_aCellStart[iCell-1];
+			}
+			m_aCellStart[0] = 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CShoreWaterGrid::GetCellRange( const Vector &vecMin, const Vector &vecMax, int *pCellMin, int *pCellMax ) const
+{
+	for ( int iAxis = 0; iAxis < 2; ++iAxis )
+	{
+		float flMin = ( vecMin[iAxis] - m_vecOrigin[iAxis] ) * m_flOOCellSize;
+		float flMax = ( vecMax[iAxis] - m_vecOrigin[iAxis] ) * m_flOOCellSize;
+		pCellMin[iAxis] = ( flMin <= 0.0f ) ? 0 : ( int )MIN( flMin, ( float )( m_nCells[iAxis] - 1 ) );
+		pCellMax[iAxis] = ( flMax <= 0.0f ) ? 0 : ( int )MIN( flMax, ( float )( m_nCells[iAxis] - 1 ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds the water faces whose solids' XY extents may overlap the box.
+//			Faces outside the returned list certainly do not.
+//-----------------------------------------------------------------------------
+void CShoreWaterGrid::FindFaces( const Vector &vecMin, const Vector &vecMax, CUtlVector<int> &aFaces ) const
+{
+	aFaces.RemoveAll();
+	aFaces.AddVectorToTail( m_aUnbucketedFaces );
+
+	int nCellMin[2], nCellMax[2];
+	GetCellRange( vecMin, vecMax, nCellMin, nCellMax );
+	for ( int y = nCellMin[1]; y <= nCellMax[1]; ++y )
+	{
+		for ( int x = nCellMin[0]; x <= nCellMax[0]; ++x )
+		{
+			int iCell = y * m_nCells[0] + x;
+			for ( int iFace = m_aCellStart[iCell]; iFace < m_aCellStart[iCell+1]; ++iFace )
+			{
+				aFaces.AddToTail( m_aCellFaces[iFace] );
+			}
+		}
+	}
+
+	// Faces that span several cells were added more than once.
+	SortUniqueShoreIndices( aFaces );
+}
+
+//=============================================================================
+//
+// CShoreEndpointHash
+//
+// Hashes the endpoints of the shoreline segments by position, so the
+// segments touching a segment can be found without testing every segment.
+//
+class CShoreEndpointHash
+{
+public:
+	void Build( Shoreline_t *pShoreline );
+	void FindSegmentsNear( Shoreline_t *pShoreline, int iSegment, CUtlVector<int> &aSegments ) const;
+
+private:
+	struct EndpointNode_t
+	{
+		int		m_iSegment;
+		int		m_nNext;			// Next endpoint whose cell has the same hash, or -1.
+	};
+
+	static unsigned int CellHash( int x, int y, int z );
+	static int CellCoord( float flValue )	{ return ( int )floorf( flValue * ( 1.0f / DISPSHORE_ENDPOINT_CELL ) ); }
+
+	CUtlVector<EndpointNode_t>			m_aNodes;
+	CUtlHashtable<unsigned int, int>	m_Heads;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+unsigned int CShoreEndpointHash::CellHash( int x, int y, int z )
+{
+	return ( ( unsigned int )x * 73856093u ) ^ ( ( unsigned int )y * 19349663u ) ^ ( ( unsigned int )z * 83492791u );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CShoreEndpointHash::Build( Shoreline_t *pShoreline )
+{
+	m_aNodes.Purge();
+	m_Heads.RemoveAll();
+
+	int nSegmentCount = pShoreline->m_aSegments.Count();
+	for ( int iSegment = 0; iSegment < nSegmentCount; ++iSegment )
+	{
+		for ( int iPoint = 0; iPoint < 2; ++iPoint )
+		{
+			const Vector &vecPoint = pShoreline->m_aSegments[iSegment].m_vecPoints[iPoint];
+			unsigned int nHash = CellHash( CellCoord( vecPoint.x ), CellCoord( vecPoint.y ), CellCoord( vecPoint.z ) );
+
+			int iNode = m_aNodes.AddToTail();
+			m_aNodes[iNode].m_iSegment = iSegment;
+			m_aNodes[iNode].m_nNext = -1;
+
+			UtlHashHandle_t hHead = m_Heads.Find( nHash );
+			if ( hHead == m_Heads.InvalidHandle() )
+			{
+				m_Heads.Insert( nHash, iNode );
+			}
+			else
+			{
+				m_aNodes[iNode].m_nNext = m_Heads[hHead];
+				m_Heads[hHead] = iNode;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds the other segments that may have an endpoint within
+//			DISPSHORE_VECTOR_EPS of one of the segment's endpoints, in
+//			ascending order. Segments outside the list certainly do not.
+//-----------------------------------------------------------------------------
+void CShoreEndpointHash::FindSegmentsNear( Shoreline_t *pShoreline, int iSegment, CUtlVector<int> &aSegments ) const
+{
+	aSegments.RemoveAll();
+
+	// Search twice the tolerance so rounding cannot hide a neighbor cell.
+	const float flReach = DISPSHORE_VECTOR_EPS * 2.0f;
+
+	for ( int iPoint = 0; iPoint < 2; ++iPoint )
+	{
+		const Vector &vecPoint = pShoreline->m_aSegments[iSegment].m_vecPoints[iPoint];
+		int nMin[3], nMax[3];
+		for ( int iAxis = 0; iAxis < 3; ++iAxis )
+		{
+			nMin[iAxis] = CellCoord( vecPoint[iAxis] - flReach );
+			nMax[iAxis] = CellCoord( vecPoint[iAxis] + flReach );
+		}
+
+		for ( int z = nMin[2]; z <= nMax[2]; ++z )
+		{
+			for ( int y = nMin[1]; y <= nMax[1]; ++y )
+			{
+				for ( int x = nMin[0]; x <= nMax[0]; ++x )
+				{
+					UtlHashHandle_t hHead = m_Heads.Find( CellHash( x, y, z ) );
+					if ( hHead == m_Heads.InvalidHandle() )
+						continue;
+
+					for ( int iNode = m_Heads[hHead]; iNode != -1; iNode = m_aNodes[iNode].m_nNext )
+					{
+						if ( m_aNodes[iNode].m_iSegment != iSegment )
+						{
+							aSegments.AddToTail( m_aNodes[iNode].m_iSegment );
+						}
+					}
+				}
+			}
+		}
+	}
+
+	SortUniqueShoreIndices( aSegments );
+}
+
+class CDispShoreManager;
+
+struct ShoreOverlayPointJob_t
+{
+	CDispShoreManager		*m_pManager;
+	Shoreline_t				*m_pShoreline;
+	int						m_iSegment;
+	const CShoreWaterGrid	*m_pWaterGrid;
+};
+
 //=============================================================================
 //
 // CDispShoreManager
@@ -138,10 +526,11 @@ public:
 	void		DebugDraw( CRender3D *pRender );
 
 private:
-	void BuildShorelineSegments( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aFaces, CUtlVector<CMapFace*> &aWaterFaces );
+	void BuildShorelineSegments( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aFaces, const CShoreWaterGrid &waterGrid );
 	void AverageShorelineNormals( Shoreline_t *pShoreline );
-	void BuildShorelineOverlayPoints( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aWaterFaces );
-	void BuildShorelineOverlayPoint( Shoreline_t *pShoreline, int iSegment, CUtlVector<CMapFace*> &aWaterFaces );
+	void BuildShorelineOverlayPoints( Shoreline_t *pShoreline, const CShoreWaterGrid &waterGrid );
+	void BuildShorelineOverlayPoint( Shoreline_t *pShoreline, int iSegment, const CShoreWaterGrid &waterGrid );
+	static void BuildShorelineOverlayPointJob( ShoreOverlayPointJob_t &job );
 	bool TexcoordShoreline( Shoreline_t *pShoreline );
 	void ShorelineLength( Shoreline_t *pShoreline );
 	void GenerateTexCoord( Shoreline_t *pShoreline, int iSegment, float flLengthToSegment, bool bEnd );
@@ -153,7 +542,7 @@ private:
 	void DrawShorelineOverlayPoints( CRender3D *pRender, int iShoreline );
 
 	bool ConnectShorelineSegments( Shoreline_t *pShoreline );
-	int	 FindShorelineStart( Shoreline_t *pShoreline );
+	int	 FindShorelineStart( Shoreline_t *pShoreline, const CShoreEndpointHash &endpointHash );
 
 	bool IsTouched( Shoreline_t *pShoreline, int iSegment )		{ return pShoreline->m_aSegments[iSegment].m_bTouch; }
 
@@ -269,44 +658,62 @@ void CDispShoreManager::BuildShoreline( int nShorelineId, CUtlVector<CMapFace*>
 	Shoreline_t *pShoreline = GetShoreline( nShorelineId );
 	if ( pShoreline )
 	{
-		BuildShorelineSegments( pShoreline, aFaces, aWaterFaces );
+		CShoreWaterGrid waterGrid;
+		waterGrid.Build( aWaterFaces );
+
+		BuildShorelineSegments( pShoreline, aFaces, waterGrid );
 		AverageShorelineNormals( pShoreline );
-		BuildShorelineOverlayPoints( pShoreline, aWaterFaces );
+		BuildShorelineOverlayPoints( pShoreline, waterGrid );
 		TexcoordShoreline( pShoreline );
 		BuildShorelineOverlays( pShoreline );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Purpose:
+// Purpose: Intersects the displacements with the water faces near them. The
+//			pairs are visited water face first, as if every pair were tested,
+//			since the order the segments are added in shapes the shoreline.
 //-----------------------------------------------------------------------------
-void CDispShoreManager::BuildShorelineSegments( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aFaces, CUtlVector<CMapFace*> &aWaterFaces )
+void CDispShoreManager::BuildShorelineSegments( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aFaces, const CShoreWaterGrid &waterGrid )
 {
-	int nWaterFaceCount = aWaterFaces.Count();
-	for ( int iWaterFace = 0; iWaterFace < nWaterFaceCount; ++iWaterFace )
-	{
-		int nFaceCount = aFaces.Count();
-		for ( int iFace = 0; iFace < nFaceCount; ++iFace )
-		{	
-			CMapFace *pFace = aFaces.Element( iFace );
-			if ( pFace )
-			{
-				if ( !pFace->HasDisp() )
-				{
-					// Ignore for now!
-				}
-				else
-				{
-					// Displacement.
-					CMapDisp *pDisp = EditDispMgr()->GetDisp( pFace->GetDisp() );
-					if ( pDisp )
-					{
-						pDisp->CreateShoreOverlays( aWaterFaces[iWaterFace], pShoreline );
-					}
-				}
-			}
+	// Pair each displacement with the water faces whose solids it may touch.
+	// CMapDisp::CreateShoreOverlays ignores the other pairs.
+	CUtlVector<int> aPairs;				// Water face index, face index.
+	CUtlVector<int> aWaterFaces;
+	int nFaceCount = aFaces.Count();
+	for ( int iFace = 0; iFace < nFaceCount; ++iFace )
+	{	
+		CMapFace *pFace = aFaces.Element( iFace );
+		if ( !pFace || !pFace->HasDisp() )
+			continue;
+
+		CMapDisp *pDisp = EditDispMgr()->GetDisp( pFace->GetDisp() );
+		if ( !pDisp )
+			continue;
+
+		Vector vecDispMin, vecDispMax;
+		pDisp->GetBoundingBox( vecDispMin, vecDispMax );
+		waterGrid.FindFaces( vecDispMin, vecDispMax, aWaterFaces );
+		for ( int i = 0; i < aWaterFaces.Count(); ++i )
+		{
+			aPairs.AddToTail( aWaterFaces[i] );
+			aPairs.AddToTail( iFace );
 		}
 	}
+
+	// Water face major, face minor.
+	int nPairCount = aPairs.Count() / 2;
+	qsort( aPairs.Base(), nPairCount, sizeof( int ) * 2, CompareShorePairs );
+
+	for ( int iPair = 0; iPair < nPairCount; ++iPair )
+	{
+		CMapFace *pWaterFace = waterGrid.GetFace( aPairs[iPair*2] );
+		CMapFace *pFace = aFaces.Element( aPairs[iPair*2+1] );
+
+		// Displacement.
+		CMapDisp *pDisp = EditDispMgr()->GetDisp( pFace->GetDisp() );
+		pDisp->CreateShoreOverlays( pWaterFace, pShoreline );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -366,24 +773,40 @@ void CDispShoreManager::AverageShorelineNormals( Shoreline_t *pShoreline )
 }
 
 //-----------------------------------------------------------------------------
-// Purpose:
+// Purpose: Each segment's points only depend on the segment and the world,
+//			so the segments are projected in parallel.
 //-----------------------------------------------------------------------------
-void CDispShoreManager::BuildShorelineOverlayPoints( Shoreline_t *pShoreline, CUtlVector<CMapFace*> &aWaterFaces )
+void CDispShoreManager::BuildShorelineOverlayPoints( Shoreline_t *pShoreline, const CShoreWaterGrid &waterGrid )
 {
 	int nSegmentCount = pShoreline->m_aSegments.Count();
 	if ( nSegmentCount == 0 )
 		return;
 
+	CUtlVector<ShoreOverlayPointJob_t> aJobs;
+	aJobs.SetSize( nSegmentCount );
 	for ( int iSegment = 0; iSegment < nSegmentCount; ++iSegment )
 	{
-		BuildShorelineOverlayPoint( pShoreline, iSegment, aWaterFaces );
+		aJobs[iSegment].m_pManager = this;
+		aJobs[iSegment].m_pShoreline = pShoreline;
+		aJobs[iSegment].m_iSegment = iSegment;
+		aJobs[iSegment].m_pWaterGrid = &waterGrid;
 	}
+
+	ParallelProcess( "CDispShoreManager::BuildShorelineOverlayPointJob", aJobs.Base(), aJobs.Count(), &CDispShoreManager::BuildShorelineOverlayPointJob );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called on worker threads. Only writes the job's segment.
+//-----------------------------------------------------------------------------
+void CDispShoreManager::BuildShorelineOverlayPointJob( ShoreOverlayPointJob_t &job )
+{
+	job.m_pManager->BuildShorelineOverlayPoint( job.m_pShoreline, job.m_iSegment, *job.m_pWaterGrid );
 }
 
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-void CDispShoreManager::BuildShorelineOverlayPoint( Shoreline_t *pShoreline, int iSegment, CUtlVector<CMapFace*> &aWaterFaces )
+void CDispShoreManager::BuildShorelineOverlayPoint( Shoreline_t *pShoreline, int iSegment, const CShoreWaterGrid &waterGrid )
 {
 	// Get the displacement manager and segment displacement.
 	CMapDisp *pDisp = EditDispMgr()->GetDisp( pShoreline->m_aSegments[iSegment].m_hDisp );
@@ -516,21 +939,21 @@ void CDispShoreManager::BuildShorelineOverlayPoint( Shoreline_t *pShoreline, int
 	pShoreline->m_aSegments[iSegment].m_WaterFace.m_vecPoints[1] = pShoreline->m_aSegments[iSegment].m_vecPoints[0];
 	pShoreline->m_aSegments[iSegment].m_WaterFace.m_vecPoints[2] = pShoreline->m_aSegments[iSegment].m_vecPoints[1];
 	pShoreline->m_aSegments[iSegment].m_WaterFace.m_vecPoints[3] = pShoreline->m_aSegments[iSegment].m_vecPoints[1] + ( pShoreline->m_aSegments[iSegment].m_vecNormals[1] * -pShoreline->m_ShoreData.m_flWidths[1] );
-	int nWaterFaceCount = aWaterFaces.Count();
-	for ( int iWaterFace = 0; iWaterFace < nWaterFaceCount; ++iWaterFace )
+	// Each point takes the last water face (in list order) above or below it.
+	CUtlVector<int> aWaterFaces;
+	for ( int iWaterPoint = 0; iWaterPoint < 4; ++iWaterPoint )
 	{
-		CMapFace *pWaterFace = aWaterFaces.Element( iWaterFace );
-		if ( pWaterFace )
+		vecPoint = pShoreline->m_aSegments[iSegment].m_WaterFace.m_vecPoints[iWaterPoint];
+		vecStart.Init( vecPoint.x, vecPoint.y, vecPoint.z + 150.0f );
+		vecEnd.Init( vecPoint.x, vecPoint.y, vecPoint.z - 150.0f );
+
+		waterGrid.FindFaces( vecPoint, vecPoint, aWaterFaces );
+		for ( int iWaterFace = 0; iWaterFace < aWaterFaces.Count(); ++iWaterFace )
 		{
-			for ( int iWaterPoint = 0; iWaterPoint < 4; ++iWaterPoint )
+			CMapFace *pWaterFace = waterGrid.GetFace( aWaterFaces[iWaterFace] );
+			if ( pWaterFace && pWaterFace->TraceLineInside( vecHit, vecHitNormal, vecStart, vecEnd ) )
 			{
-				vecPoint = pShoreline->m_aSegments[iSegment].m_WaterFace.m_vecPoints[iWaterPoint];
-				vecStart.Init( vecPoint.x, vecPoint.y, vecPoint.z + 150.0f );
-				vecEnd.Init( vecPoint.x, vecPoint.y, vecPoint.z - 150.0f );
-				if ( pWaterFace->TraceLineInside( vecHit, vecHitNormal, vecStart, vecEnd ) )
-				{
-					pShoreline->m_aSegments[iSegment].m_WaterFace.m_pFaces[iWaterPoint] = pWaterFace;
-				}
+				pShoreline->m_aSegments[iSegment].m_WaterFace.m_pFaces[iWaterPoint] = pWaterFace;
 			}
 		}
 	}
@@ -650,20 +1073,25 @@ bool CDispShoreManager::ConnectShorelineSegments( Shoreline_t *pShoreline )
 	// Reset/recreate the shoreline sorted segment list.
 	pShoreline->m_aSortedSegments.Purge();
 
-	int iSegment = FindShorelineStart( pShoreline );
+	CShoreEndpointHash endpointHash;
+	endpointHash.Build( pShoreline );
+
+	int iSegment = FindShorelineStart( pShoreline, endpointHash );
 	if ( iSegment == -1 )
 	{
 		iSegment = 0;
 	}
 
-	int nSegmentCount = pShoreline->m_aSegments.Count();
+	// Only segments near this one can touch it; they are tested in index order.
+	CUtlVector<int> aNearSegments;
 	while ( iSegment != -1 )
 	{
-		int iSegment2;
-		for ( iSegment2 = 0; iSegment2 < nSegmentCount; ++iSegment2 )
+		endpointHash.FindSegmentsNear( pShoreline, iSegment, aNearSegments );
+
+		int iNext = -1;
+		for ( int iNear = 0; iNear < aNearSegments.Count(); ++iNear )
 		{
-			if ( iSegment2 == iSegment )
-				continue;
+			int iSegment2 = aNearSegments[iNear];
 
 			bool bIsTouching0 = false;
 			if ( VectorsAreEqual( pShoreline->m_aSegments[iSegment].m_vecPoints[0], pShoreline->m_aSegments[iSegment2].m_vecPoints[0], DISPSHORE_VECTOR_EPS ) ) { bIsTouching0 = true; }
@@ -682,18 +1110,12 @@ bool CDispShoreManager::ConnectShorelineSegments( Shoreline_t *pShoreline )
 
 				pShoreline->m_aSortedSegments.AddToTail( iSegment2 );
 				pShoreline->m_aSegments[iSegment2].m_bTouch = true;
+				iNext = iSegment2;
 				break;
 			}
 		}
 
-		if ( iSegment2 != nSegmentCount )
-		{
-			iSegment = iSegment2;
-		}
-		else
-		{
-			iSegment = -1;
-		}
+		iSegment = iNext;
 	}
 
 	return true;
@@ -702,18 +1124,20 @@ bool CDispShoreManager::ConnectShorelineSegments( Shoreline_t *pShoreline )
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-int CDispShoreManager::FindShorelineStart( Shoreline_t *pShoreline )
+int CDispShoreManager::FindShorelineStart( Shoreline_t *pShoreline, const CShoreEndpointHash &endpointHash )
 {
 	// Find a segment that doesn't have any (fewest) matching point data.
+	CUtlVector<int> aNearSegments;
 	int nSegmentCount = pShoreline->m_aSegments.Count();
 	for ( int iSegment = 0; iSegment < nSegmentCount; ++iSegment )
 	{
+		endpointHash.FindSegmentsNear( pShoreline, iSegment, aNearSegments );
+
 		int nTouchCount = 0;
 		int iStartPoint = -1;
-		for ( int iSegment2 = 0; iSegment2 < nSegmentCount; ++iSegment2 )
+		for ( int iNear = 0; iNear < aNearSegments.Count(); ++iNear )
 		{
-			if ( iSegment == iSegment2 )
-				continue;
+			int iSegment2 = aNearSegments[iNear];
 
 			if ( VectorsAreEqual( pShoreline->m_aSegments[iSegment].m_vecPoints[0], pShoreline->m_aSegments[iSegment2].m_vecPoints[0], DISPSHORE_VECTOR_EPS ) ) 
 			{ 
@@ -19,6 +19,7 @@
 #include "fgdlib/GameData.h"
 #include "GameConfig.h"
 #include "EditGameClass.h"
+#include "EntityConnectionGraph.h"
 #include "MapEntity.h"
 #include "mathlib/Mathlib.h"
 
@@ -63,7 +64,10 @@ void CEditGameClass::Connections_Add(CEntityConnection *pConnection)
 //// SLE REMOVED: used to have Ep2 specific hardcoded
 //// debug function for a particular entity.
 	if ( m_Connections.Find(pConnection) == -1 )
+	{
 		m_Connections.AddToTail(pConnection);
+		CEntityConnectionGraph::OnEntityChanged( dynamic_cast<CMapEntity *>( this ) );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -77,6 +81,7 @@ bool CEditGameClass::Connections_Remove(CEntityConnection *pConnection)
 	if (nIndex != -1)
 	{
 		m_Connections.Remove(nIndex);
+		CEntityConnectionGraph::OnEntityChanged( dynamic_cast<CMapEntity *>( this ) );
 		return(true);
 	}
 
@@ -112,6 +117,7 @@ void CEditGameClass::Connections_RemoveAll()
 	}
 
 	m_Connections.RemoveAll();
+	CEntityConnectionGraph::OnEntityChanged( dynamic_cast<CMapEntity *>( this ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -248,6 +254,7 @@ CEditGameClass *CEditGameClass::CopyFrom(CEditGameClass *pFrom)
 	{
 		m_KeyValues.SetValue(pFrom->GetKey(i), pFrom->GetKeyValue(i));
 	}
+	CEntityConnectionGraph::OnEntityChanged( dynamic_cast<CMapEntity *>( this ) );
 
 	//
 	// Copy all the connections objects
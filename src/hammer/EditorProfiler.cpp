@@ -0,0 +1,148 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Scoped timing zones for the editor's hot paths.
+//
+//			Every thread gets its own ring buffer the first time it records a
+//			zone, so recording takes no lock. Buffers are found by thread id
+//			with a short scan instead of thread local storage. The rings and
+//			the trace output are in EditorProfilerTrace.h.
+//
+//			Needs only tier0, so it's built without the precompiled header.
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include "EditorProfiler.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+COMPILE_TIME_ASSERT( ( PROFILER_EVENTS_PER_THREAD & ( PROFILER_EVENTS_PER_THREAD - 1 ) ) == 0 );
+
+CEditorProfiler g_EditorProfiler;
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+//-----------------------------------------------------------------------------
+CEditorProfiler::CEditorProfiler( void )
+{
+	m_bEnabled = false;
+	m_nStartTime = CCycleCount::GetTimestamp();
+	m_nThreads = 0;
+	memset( m_pThreads, 0, sizeof( m_pThreads ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CEditorProfiler::~CEditorProfiler( void )
+{
+	Purge();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees every thread's buffer. Don't call while threads are recording.
+//-----------------------------------------------------------------------------
+void CEditorProfiler::Purge( void )
+{
+	m_bEnabled = false;
+
+	for ( int i = 0; i < m_nThreads; i++ )
+	{
+		delete m_pThreads[i];
+		m_pThreads[i] = NULL;
+	}
+
+	m_nThreads = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the calling thread's buffer, adding one the first time the
+//			thread records a zone. Returns NULL once every slot is taken.
+//-----------------------------------------------------------------------------
+ProfilerThread_t *CEditorProfiler::GetThread( void )
+{
+	uint nThreadId = ThreadGetCurrentId();
+
+	int nThreads = m_nThreads;
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		if ( m_pThreads[i]->m_nThreadId == nThreadId )
+			return m_pThreads[i];
+	}
+
+	AUTO_LOCK( m_Mutex );
+
+	// Another thread may have added buffers since the scan above, but none
+	// of them can be ours.
+	if ( m_nThreads >= PROFILER_MAX_THREADS )
+		return NULL;
+
+	ProfilerThread_t *pThread = new ProfilerThread_t;
+	pThread->m_nThreadId = nThreadId;
+	pThread->m_nWritten = 0;
+
+	// Publish the buffer before the count so scans never see an empty slot.
+	m_pThreads[m_nThreads] = pThread;
+	ThreadMemoryBarrier();
+	m_nThreads = m_nThreads + 1;
+
+	return pThread;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Records a completed zone on the calling thread.
+// Input  : pszName - Zone name; must outlive the profiler.
+//			nStart, nEnd - CCycleCount timestamps.
+//-----------------------------------------------------------------------------
+void CEditorProfiler::AddEvent( const char *pszName, uint64 nStart, uint64 nEnd )
+{
+	ProfilerThread_t *pThread = GetThread();
+	if ( !pThread )
+		return;
+
+	ProfilerThread_AddEvent( pThread, pszName, nStart, nEnd );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Forgets every recorded zone and restarts the trace clock. The
+//			thread buffers are kept for reuse.
+//-----------------------------------------------------------------------------
+void CEditorProfiler::Clear( void )
+{
+	for ( int i = 0; i < m_nThreads; i++ )
+	{
+		m_pThreads[i]->m_nWritten = 0;
+	}
+
+	m_nStartTime = CCycleCount::GetTimestamp();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the recorded zones as complete ("X") events of the Chrome
+//			trace event format, one track per thread.
+// Output : Returns false if the file couldn't be written.
+//-----------------------------------------------------------------------------
+bool CEditorProfiler::WriteChromeTrace( const char *pszFileName )
+{
+	FILE *fp = fopen( pszFileName, "wt" );
+	if ( !fp )
+		return false;
+
+	ProfilerTrace_Begin( fp );
+
+	bool bFirst = true;
+	int nThreads = m_nThreads;
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		ProfilerTrace_WriteThread( fp, m_pThreads[i], m_nStartTime, g_ClockSpeedMicrosecondsMultiplier, bFirst );
+	}
+
+	ProfilerTrace_End( fp );
+
+	bool bOK = !ferror( fp );
+	fclose( fp );
+
+	return bOK;
+}
@@ -0,0 +1,98 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Scoped timing zones for the editor's hot paths. Each thread
+//			records the zones it completes into its own ring buffer, and the
+//			buffers can be written out in the Chrome trace event format for
+//			chrome://tracing or Perfetto. When profiling is off a zone costs
+//			one test of a flag.
+//
+//=============================================================================//
+
+#ifndef EDITORPROFILER_H
+#define EDITORPROFILER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/fasttimer.h"
+#include "tier0/threadtools.h"
+#include "EditorProfilerTrace.h"
+
+//
+// Most threads that can record zones at once. Threads beyond this are not
+// recorded.
+//
+#define PROFILER_MAX_THREADS		64
+
+class CEditorProfiler
+{
+public:
+
+	CEditorProfiler( void );
+	~CEditorProfiler( void );
+
+	inline void SetEnabled( bool bEnabled ) { m_bEnabled = bEnabled; }
+	inline bool IsEnabled( void ) const { return m_bEnabled; }
+
+	// Records a zone on the calling thread.
+	void AddEvent( const char *pszName, uint64 nStart, uint64 nEnd );
+
+	// Forgets every recorded zone. Don't call while other threads are recording.
+	void Clear( void );
+
+	// Writes every recorded zone as a Chrome trace JSON file. Zones being
+	// recorded by other threads at the time may be left out.
+	bool WriteChromeTrace( const char *pszFileName );
+
+	void Purge( void );
+
+private:
+
+	ProfilerThread_t *GetThread( void );
+
+	bool m_bEnabled;
+	uint64 m_nStartTime;				// Timestamps are written relative to this.
+
+	ProfilerThread_t *m_pThreads[PROFILER_MAX_THREADS];
+	volatile int m_nThreads;
+	CThreadFastMutex m_Mutex;			// Held while a thread adds its buffer.
+};
+
+extern CEditorProfiler g_EditorProfiler;
+
+//
+// Times the block it's declared in as a zone with the given name.
+//
+class CProfilerScope
+{
+public:
+
+	inline CProfilerScope( const char *pszName )
+	{
+		m_pszName = NULL;
+		if ( g_EditorProfiler.IsEnabled() )
+		{
+			m_pszName = pszName;
+			m_nStart = CCycleCount::GetTimestamp();
+		}
+	}
+
+	inline ~CProfilerScope( void )
+	{
+		if ( m_pszName )
+		{
+			g_EditorProfiler.AddEvent( m_pszName, m_nStart, CCycleCount::GetTimestamp() );
+		}
+	}
+
+private:
+
+	const char *m_pszName;
+	uint64 m_nStart;
+};
+
+#define EDITOR_PROFILE_SCOPE_NAME2( line )	_profilerScope##line
+#define EDITOR_PROFILE_SCOPE_NAME( line )	EDITOR_PROFILE_SCOPE_NAME2( line )
+#define EDITOR_PROFILE_SCOPE( name )		CProfilerScope EDITOR_PROFILE_SCOPE_NAME( __LINE__ )( name )
+
+#endif // EDITORPROFILER_H
@@ -0,0 +1,151 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The per-thread zone rings of the editor profiler and their
+//			Chrome trace event output. Kept free of editor and tier0
+//			dependencies so it can be tested standalone:
+//
+//			g++ -O2 EditorProfilerTrace_test.cpp -o EditorProfilerTrace_test && ./EditorProfilerTrace_test
+//
+//=============================================================================//
+
+#ifndef EDITORPROFILERTRACE_H
+#define EDITORPROFILERTRACE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma intrinsic( _ReadWriteBarrier )
+#endif
+
+//
+// Zones kept per thread; older ones are overwritten. Must be a power of two.
+//
+#define PROFILER_EVENTS_PER_THREAD	32768
+
+//
+// Keeps the compiler from moving a zone's stores past the count that
+// publishes it. x86 itself keeps stores in order.
+//
+#ifdef _MSC_VER
+#define PROFILER_WRITE_BARRIER()	_ReadWriteBarrier()
+#else
+#define PROFILER_WRITE_BARRIER()	__asm__ __volatile__( "" ::: "memory" )
+#endif
+
+//
+// One completed zone. The name must be a string that outlives the profiler,
+// which in practice means a literal.
+//
+struct ProfilerEvent_t
+{
+	const char *m_pszName;
+	unsigned long long m_nStart;	// CCycleCount timestamps.
+	unsigned long long m_nEnd;
+};
+
+//
+// The zones recorded by one thread. Only that thread writes to it.
+//
+struct ProfilerThread_t
+{
+	unsigned int m_nThreadId;
+	volatile unsigned int m_nWritten;	// Total zones recorded; the ring index is this modulo the size.
+	ProfilerEvent_t m_Events[PROFILER_EVENTS_PER_THREAD];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Records a zone in a thread's ring, overwriting the oldest once the
+//			ring is full. Called only by the thread that owns the ring.
+//-----------------------------------------------------------------------------
+inline void ProfilerThread_AddEvent( ProfilerThread_t *pThread, const char *pszName, unsigned long long nStart, unsigned long long nEnd )
+{
+	ProfilerEvent_t &Event = pThread->m_Events[pThread->m_nWritten & ( PROFILER_EVENTS_PER_THREAD - 1 )];
+	Event.m_pszName = pszName;
+	Event.m_nStart = nStart;
+	Event.m_nEnd = nEnd;
+
+	PROFILER_WRITE_BARRIER();
+	pThread->m_nWritten = pThread->m_nWritten + 1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the count of the oldest zone still in a thread's ring.
+//-----------------------------------------------------------------------------
+inline unsigned int ProfilerThread_GetFirst( unsigned int nWritten )
+{
+	return ( nWritten > PROFILER_EVENTS_PER_THREAD ) ? nWritten - PROFILER_EVENTS_PER_THREAD : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes a zone name as a JSON string.
+//-----------------------------------------------------------------------------
+inline void ProfilerTrace_WriteString( FILE *fp, const char *pszString )
+{
+	fputc( '"', fp );
+
+	for ( const char *pch = pszString; *pch; pch++ )
+	{
+		if ( *pch == '"' || *pch == '\\' )
+		{
+			fputc( '\\', fp );
+			fputc( *pch, fp );
+		}
+		else if ( (unsigned char)*pch < ' ' )
+		{
+			fprintf( fp, "\\u%04x", (unsigned char)*pch );
+		}
+		else
+		{
+			fputc( *pch, fp );
+		}
+	}
+
+	fputc( '"', fp );
+}
+
+inline void ProfilerTrace_Begin( FILE *fp )
+{
+	fprintf( fp, "{\"traceEvents\":[\n" );
+}
+
+inline void ProfilerTrace_End( FILE *fp )
+{
+	fprintf( fp, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the zones in one thread's ring, oldest first, as complete
+//			("X") events of the Chrome trace event format.
+// Input  : nStartTime - Timestamp the trace starts at; older zones are left out.
+//			flMicrosecondsPerTick - Converts timestamps to microseconds.
+//			bFirst - True until an event has been written, so commas go
+//				between events.
+//-----------------------------------------------------------------------------
+inline void ProfilerTrace_WriteThread( FILE *fp, const ProfilerThread_t *pThread, unsigned long long nStartTime, double flMicrosecondsPerTick, bool &bFirst )
+{
+	unsigned int nWritten = pThread->m_nWritten;
+
+	for ( unsigned int n = ProfilerThread_GetFirst( nWritten ); n < nWritten; n++ )
+	{
+		const ProfilerEvent_t &Event = pThread->m_Events[n & ( PROFILER_EVENTS_PER_THREAD - 1 )];
+
+		// Skip zones from before the last clear, and any the thread is
+		// overwriting while we read.
+		if ( !Event.m_pszName || Event.m_nStart < nStartTime || Event.m_nEnd < Event.m_nStart )
+			continue;
+
+		double flStart = ( Event.m_nStart - nStartTime ) * flMicrosecondsPerTick;
+		double flDuration = ( Event.m_nEnd - Event.m_nStart ) * flMicrosecondsPerTick;
+
+		fprintf( fp, bFirst ? "{\"name\":" : ",\n{\"name\":" );
+		ProfilerTrace_WriteString( fp, Event.m_pszName );
+		fprintf( fp, ",\"cat\":\"hammer\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}", flStart, flDuration, pThread->m_nThreadId );
+		bFirst = false;
+	}
+}
+
+#endif // EDITORPROFILERTRACE_H
@@ -0,0 +1,387 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the editor profiler's zone rings and Chrome
+//			trace output. Fills rings short of, up to and well past their
+//			size, then parses the trace back and checks that it's valid JSON
+//			holding exactly the newest zones of each ring, oldest first:
+//
+//			g++ -O2 EditorProfilerTrace_test.cpp -o EditorProfilerTrace_test && ./EditorProfilerTrace_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "EditorProfilerTrace.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+//
+// One event read back from a trace.
+//
+struct ParsedEvent_t
+{
+	std::string m_Name;
+	std::string m_Cat;
+	std::string m_Ph;
+	double m_flTs;
+	double m_flDur;
+	int m_nPid;
+	unsigned int m_nTid;
+};
+
+//-----------------------------------------------------------------------------
+// A strict parser for the JSON the trace writer produces. Fails on anything
+// that isn't valid JSON.
+//-----------------------------------------------------------------------------
+class CTraceParser
+{
+public:
+
+	CTraceParser( const std::string &Text ) : m_Text( Text ), m_nPos( 0 ), m_bOK( true ) {}
+
+	bool Parse( std::vector<ParsedEvent_t> &Events, std::string &TimeUnit )
+	{
+		Expect( '{' );
+		bool bFirstKey = true;
+		while ( m_bOK && Peek() != '}' )
+		{
+			if ( !bFirstKey )
+			{
+				Expect( ',' );
+			}
+			bFirstKey = false;
+
+			std::string Key = ParseString();
+			Expect( ':' );
+			if ( Key == "traceEvents" )
+			{
+				ParseEvents( Events );
+			}
+			else if ( Key == "displayTimeUnit" )
+			{
+				TimeUnit = ParseString();
+			}
+			else
+			{
+				m_bOK = false;
+			}
+		}
+		Expect( '}' );
+		SkipSpace();
+		return m_bOK && ( m_nPos == m_Text.size() );
+	}
+
+private:
+
+	void SkipSpace( void )
+	{
+		while ( m_nPos < m_Text.size() && strchr( " \t\r\n", m_Text[m_nPos] ) )
+		{
+			m_nPos++;
+		}
+	}
+
+	char Peek( void )
+	{
+		SkipSpace();
+		return ( m_nPos < m_Text.size() ) ? m_Text[m_nPos] : 0;
+	}
+
+	void Expect( char ch )
+	{
+		if ( Peek() != ch )
+		{
+			m_bOK = false;
+			return;
+		}
+		m_nPos++;
+	}
+
+	std::string ParseString( void )
+	{
+		std::string Value;
+		Expect( '"' );
+		while ( m_bOK )
+		{
+			if ( m_nPos >= m_Text.size() || (unsigned char)m_Text[m_nPos] < ' ' )
+			{
+				m_bOK = false;
+				break;
+			}
+
+			char ch = m_Text[m_nPos++];
+			if ( ch == '"' )
+				break;
+
+			if ( ch != '\\' )
+			{
+				Value += ch;
+				continue;
+			}
+
+			char chEscape = ( m_nPos < m_Text.size() ) ? m_Text[m_nPos++] : 0;
+			if ( chEscape == '"' || chEscape == '\\' || chEscape == '/' )
+			{
+				Value += chEscape;
+			}
+			else if ( chEscape == 'u' && m_nPos + 4 <= m_Text.size() )
+			{
+				Value += (char)strtol( m_Text.substr( m_nPos, 4 ).c_str(), NULL, 16 );
+				m_nPos += 4;
+			}
+			else
+			{
+				m_bOK = false;
+			}
+		}
+		return Value;
+	}
+
+	double ParseNumber( void )
+	{
+		SkipSpace();
+		const char *pszStart = m_Text.c_str() + m_nPos;
+		char *pszEnd;
+		double flValue = strtod( pszStart, &pszEnd );
+		if ( pszEnd == pszStart )
+		{
+			m_bOK = false;
+		}
+		m_nPos += pszEnd - pszStart;
+		return flValue;
+	}
+
+	void ParseEvents( std::vector<ParsedEvent_t> &Events )
+	{
+		Expect( '[' );
+		while ( m_bOK && Peek() != ']' )
+		{
+			if ( !Events.empty() )
+			{
+				Expect( ',' );
+			}
+
+			ParsedEvent_t Event;
+			Expect( '{' );
+			for ( int nKey = 0; m_bOK && Peek() != '}'; nKey++ )
+			{
+				if ( nKey > 0 )
+				{
+					Expect( ',' );
+				}
+
+				std::string Key = ParseString();
+				Expect( ':' );
+				if ( Key == "name" )
+					Event.m_Name = ParseString();
+				else if ( Key == "cat" )
+					Event.m_Cat = ParseString();
+				else if ( Key == "ph" )
+					Event.m_Ph = ParseString();
+				else if ( Key == "ts" )
+					Event.m_flTs = ParseNumber();
+				else if ( Key == "dur" )
+					Event.m_flDur = ParseNumber();
+				else if ( Key == "pid" )
+					Event.m_nPid = (int)ParseNumber();
+				else if ( Key == "tid" )
+					Event.m_nTid = (unsigned int)ParseNumber();
+				else
+					m_bOK = false;
+			}
+			Expect( '}' );
+			Events.push_back( Event );
+		}
+		Expect( ']' );
+	}
+
+	const std::string &m_Text;
+	size_t m_nPos;
+	bool m_bOK;
+};
+
+//-----------------------------------------------------------------------------
+// Writes a trace of the given rings and reads it back.
+//-----------------------------------------------------------------------------
+static bool WriteAndParse( ProfilerThread_t **ppThreads, int nThreads, unsigned long long nStartTime, double flMicrosecondsPerTick, std::vector<ParsedEvent_t> &Events )
+{
+	FILE *fp = tmpfile();
+	if ( !fp )
+		return false;
+
+	ProfilerTrace_Begin( fp );
+	bool bFirst = true;
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		ProfilerTrace_WriteThread( fp, ppThreads[i], nStartTime, flMicrosecondsPerTick, bFirst );
+	}
+	ProfilerTrace_End( fp );
+
+	std::string Text;
+	rewind( fp );
+	char szBuffer[4096];
+	size_t nRead;
+	while ( ( nRead = fread( szBuffer, 1, sizeof( szBuffer ), fp ) ) > 0 )
+	{
+		Text.append( szBuffer, nRead );
+	}
+	fclose( fp );
+
+	std::string TimeUnit;
+	CTraceParser Parser( Text );
+	bool bOK = Parser.Parse( Events, TimeUnit );
+	CHECK( TimeUnit == "ms" );
+	return bOK;
+}
+
+static ProfilerThread_t *NewThread( unsigned int nThreadId )
+{
+	ProfilerThread_t *pThread = new ProfilerThread_t;
+	pThread->m_nThreadId = nThreadId;
+	pThread->m_nWritten = 0;
+	return pThread;
+}
+
+//
+// Names that need escaping, cycled through so each lands in every ring slot.
+//
+static const char *s_pszNames[] = { "CMapDoc::LoadVMF", "quote\"d", "back\\slash", "tab\tand\nnewline", "\x01" };
+#define NUM_NAMES ( sizeof( s_pszNames ) / sizeof( s_pszNames[0] ) )
+
+//-----------------------------------------------------------------------------
+// A ring filled with nZones zones holds the newest PROFILER_EVENTS_PER_THREAD
+// of them, and the trace lists them oldest first with their timings.
+//-----------------------------------------------------------------------------
+static void TestWraparound( unsigned int nZones )
+{
+	ProfilerThread_t *pThread = NewThread( 1234 );
+
+	// zone n starts at 1000 + 10n and lasts n % 7 ticks
+	for ( unsigned int n = 0; n < nZones; n++ )
+	{
+		ProfilerThread_AddEvent( pThread, s_pszNames[n % NUM_NAMES], 1000 + 10ull * n, 1000 + 10ull * n + n % 7 );
+	}
+	CHECK( pThread->m_nWritten == nZones );
+
+	unsigned int nFirst = ProfilerThread_GetFirst( nZones );
+	unsigned int nKept = nZones - nFirst;
+	CHECK( nKept == ( ( nZones < PROFILER_EVENTS_PER_THREAD ) ? nZones : PROFILER_EVENTS_PER_THREAD ) );
+
+	std::vector<ParsedEvent_t> Events;
+	CHECK( WriteAndParse( &pThread, 1, 1000, 0.5, Events ) );
+	CHECK( Events.size() == nKept );
+
+	for ( size_t i = 0; i < Events.size() && i < nKept; i++ )
+	{
+		unsigned int n = nFirst + (unsigned int)i;
+		const ParsedEvent_t &Event = Events[i];
+		if ( Event.m_Name != s_pszNames[n % NUM_NAMES] || Event.m_flTs != 5.0 * n || Event.m_flDur != 0.5 * ( n % 7 ) )
+		{
+			printf( "FAIL: %u zones, event %u: \"%s\" ts %.3f dur %.3f\n", nZones, n, Event.m_Name.c_str(), Event.m_flTs, Event.m_flDur );
+			g_nFailures++;
+			break;
+		}
+
+		CHECK( Event.m_Cat == "hammer" && Event.m_Ph == "X" && Event.m_nPid == 1 && Event.m_nTid == 1234 );
+	}
+
+	delete pThread;
+}
+
+//-----------------------------------------------------------------------------
+// Zones from before the trace start, torn zones, empty rings and several
+// threads in one trace.
+//-----------------------------------------------------------------------------
+static void TestThreads( void )
+{
+	ProfilerThread_t *pThreads[3] = { NewThread( 1 ), NewThread( 2 ), NewThread( 3 ) };
+
+	// thread 1: one zone from before the last clear, one torn, two good
+	ProfilerThread_AddEvent( pThreads[0], "old", 100, 200 );
+	ProfilerThread_AddEvent( pThreads[0], "torn", 600, 550 );
+	ProfilerThread_AddEvent( pThreads[0], "a", 500, 520 );
+	ProfilerThread_AddEvent( pThreads[0], "b", 530, 531 );
+
+	// thread 2 records nothing; thread 3 wraps
+	for ( unsigned int n = 0; n < PROFILER_EVENTS_PER_THREAD + 3; n++ )
+	{
+		ProfilerThread_AddEvent( pThreads[2], "c", 500 + n, 500 + n );
+	}
+
+	std::vector<ParsedEvent_t> Events;
+	CHECK( WriteAndParse( pThreads, 3, 500, 1.0, Events ) );
+	CHECK( Events.size() == 2 + PROFILER_EVENTS_PER_THREAD );
+	if ( Events.size() == 2 + PROFILER_EVENTS_PER_THREAD )
+	{
+		CHECK( Events[0].m_Name == "a" && Events[0].m_flTs == 0 && Events[0].m_flDur == 20 && Events[0].m_nTid == 1 );
+		CHECK( Events[1].m_Name == "b" && Events[1].m_flTs == 30 && Events[1].m_nTid == 1 );
+		CHECK( Events[2].m_Name == "c" && Events[2].m_flTs == 3 && Events[2].m_nTid == 3 );
+		CHECK( Events.back().m_flTs == PROFILER_EVENTS_PER_THREAD + 2 );
+	}
+
+	// nothing recorded at all is still a valid trace
+	ProfilerThread_t *pEmpty = pThreads[1];
+	Events.clear();
+	CHECK( WriteAndParse( &pEmpty, 1, 0, 1.0, Events ) );
+	CHECK( Events.empty() );
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		delete pThreads[i];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The ring count itself wrapping past 2^32 zones.
+//-----------------------------------------------------------------------------
+static void TestCountWrap( void )
+{
+	ProfilerThread_t *pThread = NewThread( 7 );
+	pThread->m_nWritten = 0xffffffffu - 2;
+	for ( unsigned int n = 0; n < PROFILER_EVENTS_PER_THREAD; n++ )
+	{
+		ProfilerThread_AddEvent( pThread, "z", 10 + n, 11 + n );
+	}
+
+	// zones recorded before the count wrapped are left out, but what is
+	// written is valid and in order
+	std::vector<ParsedEvent_t> Events;
+	CHECK( WriteAndParse( &pThread, 1, 0, 1.0, Events ) );
+	CHECK( Events.size() == pThread->m_nWritten );
+	for ( size_t i = 1; i < Events.size(); i++ )
+	{
+		CHECK( Events[i].m_flTs == Events[i - 1].m_flTs + 1 );
+	}
+
+	delete pThread;
+}
+
+int main( void )
+{
+	static const unsigned int s_Counts[] =
+	{
+		0, 1, 5, PROFILER_EVENTS_PER_THREAD - 1, PROFILER_EVENTS_PER_THREAD, PROFILER_EVENTS_PER_THREAD + 1,
+		PROFILER_EVENTS_PER_THREAD + 5, 3 * PROFILER_EVENTS_PER_THREAD + 7
+	};
+	for ( size_t i = 0; i < sizeof( s_Counts ) / sizeof( s_Counts[0] ); i++ )
+	{
+		TestWraparound( s_Counts[i] );
+	}
+
+	TestThreads();
+	TestCountWrap();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All profiler trace tests passed\n" );
+	return 0;
+}
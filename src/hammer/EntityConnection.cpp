@@ -16,6 +16,7 @@
 
 #include "stdafx.h"
 #include "EntityConnection.h"
+#include "EntityConnectionGraph.h"
 #include "MapEntity.h"
 #include "MapDoc.h"
 #include "MapWorld.h"
@@ -80,6 +81,7 @@ CEntityConnection &CEntityConnection::operator =(const CEntityConnection &Other)
 {
 	strcpy(m_szSourceEntity, Other.m_szSourceEntity);
 	strcpy(m_szTargetEntity, Other.m_szTargetEntity);
+	CEntityConnectionGraph::OnConnectionChanged( this );
 	strcpy(m_szOutput, Other.m_szOutput);
 	strcpy(m_szInput, Other.m_szInput);
 	strcpy(m_szParam, Other.m_szParam);
@@ -112,6 +114,7 @@ void CEntityConnection::SetTargetName(const char *pszName)
 {
 	// Save the name of the entity(ies)
 	lstrcpyn(m_szTargetEntity, pszName ? pszName : "<<null>>", sizeof(m_szTargetEntity));
+	CEntityConnectionGraph::OnConnectionChanged( this );
 
 	// Update the target entity list
 	LinkTargetEntities();
@@ -271,6 +274,19 @@ bool CEntityConnection::ValidateOutput(const CMapEntityList *pEntityList, const
 	return true;
 }
 
+//------------------------------------------------------------------------------
+// Purpose: Returns true if the target is one of the procedural names that are
+//			always assumed to exist.
+//------------------------------------------------------------------------------
+static bool IsProceduralTarget(const char *pszTarget)
+{
+#ifdef SLE //// SLE CHANGE - allow any names whatsoever that start with !. A single check.
+	return !strncmp(pszTarget, "!", 1);
+#else
+	return (!stricmp(pszTarget, "!activator") || !stricmp(pszTarget, "!caller") || !stricmp(pszTarget, "!player") || !stricmp(pszTarget, "!self"));
+#endif
+}
+
 //------------------------------------------------------------------------------
 // Purpose: Returns true if the given entity list contains an entity of the
 //			given target name
@@ -281,14 +297,9 @@ bool CEntityConnection::ValidateTarget( const CMapEntityList *pEntityList, bool
 		return false;
 
 	// These procedural names are always assumed to exist.
-#ifdef SLE //// SLE CHANGE - allow any names whatsoever that start with !. A single check.
-	if ( !strncmp(pszTarget, "!", 1) )
-	{
+	if (IsProceduralTarget(pszTarget))
 		return true;
-	}
-#else
-	if (!stricmp(pszTarget, "!activator") || !stricmp(pszTarget, "!caller") || !stricmp(pszTarget, "!player") || !stricmp(pszTarget, "!self"))
-#endif
+
 	FOR_EACH_OBJ( *pEntityList, pos )
 	{
 		CMapEntity *pEntity = pEntityList->Element(pos);
@@ -302,6 +313,22 @@ bool CEntityConnection::ValidateTarget( const CMapEntityList *pEntityList, bool
 	return false;
 }
 
+//------------------------------------------------------------------------------
+// Purpose: Returns true if the world indexed by the given graph contains an
+//			entity of the given target name
+//------------------------------------------------------------------------------
+bool CEntityConnection::ValidateTarget( CEntityConnectionGraph *pGraph, bool bVisibilityCheck, const char *pszTarget)
+{
+	if (!pGraph || !pszTarget)
+		return false;
+
+	// These procedural names are always assumed to exist.
+	if (IsProceduralTarget(pszTarget))
+		return true;
+
+	return pGraph->HasEntityNamed(pszTarget, bVisibilityCheck);
+}
+
 //------------------------------------------------------------------------------
 // Purpose: Returns true if all entities with the given target name
 //			have an input of the given input name
@@ -370,15 +397,15 @@ void CEntityConnection::FindBadConnections(CMapEntity *pEntity, bool bVisibility
 		return;
 	}
 
-	// Get a list of all the entities in the world
-	const CMapEntityList *pAllWorldEntities = NULL;
+	// Get the index of all the entities in the world
+	CEntityConnectionGraph *pGraph = NULL;
 	CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
 	if (pDoc)
 	{
 		CMapWorld *pWorld = pDoc->GetMapWorld();
 		if (pWorld)
 		{
-			pAllWorldEntities = pWorld->EntityList_GetList();
+			pGraph = pWorld->GetConnectionGraph();
 		}
 	}
 
@@ -407,7 +434,7 @@ void CEntityConnection::FindBadConnections(CMapEntity *pEntity, bool bVisibility
 				if ( CheckAllDocuments == false )
 				{
 					// Check validity of target entity (is it in the map?)
-					if ( CEntityConnection::ValidateTarget(pAllWorldEntities, bVisibilityCheck, pConnection->GetTargetName()) == true )
+					if ( CEntityConnection::ValidateTarget(pGraph, bVisibilityCheck, pConnection->GetTargetName()) == true )
 					{
 						if ( CEntityConnection::ValidateInput(pConnection->GetTargetName(), pConnection->GetInputName(), true) == true )
 						{
@@ -426,7 +453,7 @@ void CEntityConnection::FindBadConnections(CMapEntity *pEntity, bool bVisibility
 						if ( pMapDoc )
 						{
 							// Check validity of target entity (is it in the map?)
-							if ( CEntityConnection::ValidateTarget(pMapDoc->GetMapWorld()->EntityList_GetList(), bVisibilityCheck, pConnection->GetTargetName()) == true )
+							if ( CEntityConnection::ValidateTarget(pMapDoc->GetMapWorld()->GetConnectionGraph(), bVisibilityCheck, pConnection->GetTargetName()) == true )
 							{
 								// Check validity of input
 								if ( CEntityConnection::ValidateInput(pConnection->GetTargetName(), pConnection->GetInputName(), true, pMapDoc) == true )
@@ -446,7 +473,7 @@ void CEntityConnection::FindBadConnections(CMapEntity *pEntity, bool bVisibility
 			}
 #else
 			// Check validity of target entity (is it in the map?)
-			else if (!CEntityConnection::ValidateTarget(pAllWorldEntities, bVisibilityCheck, pConnection->GetTargetName()))
+			else if (!CEntityConnection::ValidateTarget(pGraph, bVisibilityCheck, pConnection->GetTargetName()))
 			{
 				BadConnectionList.AddToTail(pConnection);
 			}
@@ -564,56 +591,40 @@ int CEntityConnection::ValidateInputConnections(CMapEntity *pEntity, bool bVisib
 		return CONNECTION_NONE;
 	}
 
-	// Get a list of all the entities in the world
-	const CMapEntityList *pAllWorldEntities = NULL;
+	// Get the index of all the entities in the world
 	CMapDoc	*pDoc = CMapDoc::GetActiveMapDoc();
-	if (pDoc)
+	CMapWorld *pWorld = pDoc ? pDoc->GetMapWorld() : NULL;
+	if (!pWorld)
 	{
-		CMapWorld *pWorld = pDoc->GetMapWorld();
-		if (pWorld)
-		{
-			pAllWorldEntities = pWorld->EntityList_GetList();
-		}
+		return CONNECTION_NONE;
 	}
 
-	// Look at outputs from each entity in the world
-	
+	// Look at the outputs that target me
+	CUtlVector<EntityConnectionEdge_t> Edges;
+	pWorld->GetConnectionGraph()->FindConnectionsTo(pEntity, bVisibilityCheck, Edges);
+
 	bool bHaveConnection = false;
-	FOR_EACH_OBJ( *pAllWorldEntities, pos )
+	FOR_EACH_VEC( Edges, i )
 	{
-		CMapEntity *pTestEntity = pAllWorldEntities->Element(pos);
-		if (pTestEntity == NULL)
-			continue;
-
-		if ( bVisibilityCheck && !pTestEntity->IsVisible() )
-			continue;
+		CMapEntity *pTestEntity = Edges[i].m_pSource;
+		CEntityConnection *pConnection = Edges[i].m_pConnection;
 
-		int nConnCount = pTestEntity->Connections_GetCount();
-		for (int i = 0; i < nConnCount; i++)
+		// Validate output
+		if (!ValidateOutput(pTestEntity, pConnection->GetOutputName()))
 		{
-			// If the connection targets me
-			CEntityConnection *pConnection = pTestEntity->Connections_Get(i);
-			if ( pConnection && pEntity->NameMatches( pConnection->GetTargetName() ) )
-			{
-				// Validate output
-				if (!ValidateOutput(pTestEntity, pConnection->GetOutputName()))
-				{
-					return CONNECTION_BAD;
-				}
+			return CONNECTION_BAD;
+		}
 
-				// Validate input
-				if (pClass->FindInput(pConnection->GetInputName()) == NULL)
-				{
-					return CONNECTION_BAD;
-				}
+		// Validate input
+		if (pClass->FindInput(pConnection->GetInputName()) == NULL)
+		{
+			return CONNECTION_BAD;
+		}
 
 	// FIXME -- Validate the upstream connections the target entities.
-				bHaveConnection = true;
-			}
-		}
+		bHaveConnection = true;
 	}
 
-
 	if (bHaveConnection)
 	{
 		return CONNECTION_GOOD;
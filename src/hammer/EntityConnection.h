@@ -39,6 +39,7 @@ enum
 };
 
 class CMapEntity;
+class CEntityConnectionGraph;
 typedef CUtlVector<CMapEntity*> CMapEntityList;
 #ifdef SLE //// ported from 2015
 class CMapDoc;
@@ -95,6 +96,7 @@ public:
 	static bool ValidateOutput(CMapEntity *pEntity, const char* pszOutput);
 	static bool ValidateOutput(const CMapEntityList *pEntityList, const char* pszOutput);
 	static bool ValidateTarget(const CMapEntityList *pEntityList, bool bVisibilityCheck, const char* pszTarget);
+	static bool ValidateTarget(CEntityConnectionGraph *pGraph, bool bVisibilityCheck, const char* pszTarget);
 #ifdef SLE //// ported from 2015
 	static bool ValidateInput(const char *pszTarget, const char *pszInput, bool bVisiblesOnly, CMapDoc *pDoc = NULL);
 	static int  ValidateOutputConnections(CMapEntity *pEntity, 
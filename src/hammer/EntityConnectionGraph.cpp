@@ -0,0 +1,138 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Index of the entity I/O in a world: named entities by targetname
+//			and connections by the name they target.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "EntityConnectionGraph.h"
+#include "EntityConnection.h"
+#include "MapEntity.h"
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+CEntityConnectionGraph *CEntityConnectionGraph::s_pFirstGraph = NULL;
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+//-----------------------------------------------------------------------------
+CEntityConnectionGraph::CEntityConnectionGraph( void )
+{
+	m_pNextGraph = s_pFirstGraph;
+	s_pFirstGraph = this;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CEntityConnectionGraph::~CEntityConnectionGraph( void )
+{
+	for ( CEntityConnectionGraph **ppGraph = &s_pFirstGraph; *ppGraph; ppGraph = &( *ppGraph )->m_pNextGraph )
+	{
+		if ( *ppGraph == this )
+		{
+			*ppGraph = m_pNextGraph;
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Marks an entity for indexing again in every graph that holds it.
+//			Entities and connections change one at a time, so the next update
+//			costs only as much as what changed.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::OnEntityChanged( CMapEntity *pEntity )
+{
+	if ( !pEntity )
+		return;
+
+	for ( CEntityConnectionGraph *pGraph = s_pFirstGraph; pGraph; pGraph = pGraph->m_pNextGraph )
+	{
+		pGraph->m_Index.OnEntityChanged( pEntity );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Marks the entity a connection belongs to for indexing again.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::OnConnectionChanged( CEntityConnection *pConnection )
+{
+	for ( CEntityConnectionGraph *pGraph = s_pFirstGraph; pGraph; pGraph = pGraph->m_pNextGraph )
+	{
+		pGraph->m_Index.OnConnectionChanged( pConnection );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds an entity to the graph. It is indexed on the next update.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::AddEntity( CMapEntity *pEntity )
+{
+	m_Index.AddEntity( pEntity );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes an entity from the graph. Its connections may already
+//			have been deleted.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::RemoveEntity( CMapEntity *pEntity )
+{
+	m_Index.RemoveEntity( pEntity );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds the graph on first use, then keeps it up to date.
+// Input  : pEntityList - Every entity in the world.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::Update( const CMapEntityList *pEntityList )
+{
+	if ( !m_Index.IsBuilt() )
+	{
+		if ( pEntityList )
+		{
+			m_Index.Build( pEntityList->Base(), pEntityList->Count() );
+		}
+		return;
+	}
+
+	m_Index.Update();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if any entity's targetname matches the given name,
+//			considering wildcards on either side.
+//-----------------------------------------------------------------------------
+bool CEntityConnectionGraph::HasEntityNamed( const char *pszName, bool bVisiblesOnly )
+{
+	return m_Index.HasEntityNamed( pszName, bVisiblesOnly );
+}
+
+//
+// Adds each connection the index finds to a list of edges.
+//
+struct AddConnectionEdge_t
+{
+	CUtlVector<EntityConnectionEdge_t> *pEdges;
+
+	void operator()( CMapEntity *pSource, CEntityConnection *pConnection )
+	{
+		EntityConnectionEdge_t &Edge = pEdges->Element( pEdges->AddToTail() );
+		Edge.m_pSource = pSource;
+		Edge.m_pConnection = pConnection;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds the connections that target the given entity.
+// Input  : pEntity - Target entity. Entities without a targetname have none.
+//			bVisiblesOnly - Skip connections from hidden entities.
+//			Edges - Receives the connections and the entities they belong to.
+//-----------------------------------------------------------------------------
+void CEntityConnectionGraph::FindConnectionsTo( CMapEntity *pEntity, bool bVisiblesOnly, CUtlVector<EntityConnectionEdge_t> &Edges )
+{
+	AddConnectionEdge_t AddEdge;
+	AddEdge.pEdges = &Edges;
+	m_Index.FindConnectionsTo( pEntity, bVisiblesOnly, AddEdge );
+}
@@ -0,0 +1,68 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Index of the entity I/O in a world: named entities by targetname
+//			and connections by the name they target. Lets the connection
+//			validators answer "does anything have this name" and "what
+//			targets this entity" without scanning every entity.
+//
+//=============================================================================//
+
+#ifndef ENTITYCONNECTIONGRAPH_H
+#define ENTITYCONNECTIONGRAPH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "EntityConnectionIndex.h"
+
+class CMapEntity;
+class CEntityConnection;
+typedef CUtlVector<CMapEntity*> CMapEntityList;
+
+//
+// A connection and the entity it belongs to.
+//
+struct EntityConnectionEdge_t
+{
+	CMapEntity *m_pSource;
+	CEntityConnection *m_pConnection;
+};
+
+class CEntityConnectionGraph
+{
+public:
+
+	CEntityConnectionGraph( void );
+	~CEntityConnectionGraph( void );
+
+	// Called when an entity's targetname or connections change, or when a
+	// connection's target changes. Every graph holding the entity indexes it
+	// again on its next update.
+	static void OnEntityChanged( CMapEntity *pEntity );
+	static void OnConnectionChanged( CEntityConnection *pConnection );
+
+	// Called when an entity enters or leaves this graph's world.
+	void AddEntity( CMapEntity *pEntity );
+	void RemoveEntity( CMapEntity *pEntity );
+
+	// Builds the graph from the given entity list the first time. After that,
+	// indexes only the entities that changed since the last update.
+	void Update( const CMapEntityList *pEntityList );
+
+	// Same answer as testing NameMatches on every entity in the list.
+	bool HasEntityNamed( const char *pszName, bool bVisiblesOnly );
+
+	// Adds every connection whose target name matches pEntity's targetname.
+	// With bVisiblesOnly, connections from hidden entities are skipped.
+	void FindConnectionsTo( CMapEntity *pEntity, bool bVisiblesOnly, CUtlVector<EntityConnectionEdge_t> &Edges );
+
+private:
+
+	CEntityConnectionIndex<CMapEntity, CEntityConnection> m_Index;
+
+	CEntityConnectionGraph *m_pNextGraph;	// In the list of every graph.
+	static CEntityConnectionGraph *s_pFirstGraph;
+};
+
+#endif // ENTITYCONNECTIONGRAPH_H
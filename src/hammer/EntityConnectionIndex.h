@@ -0,0 +1,712 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The index behind CEntityConnectionGraph: the named entities of a
+//			world by targetname, and their connections by the name they
+//			target. After the first build, an entity whose name or
+//			connections change is indexed again on its own, rather than the
+//			whole world.
+//
+//			This file only needs the C runtime, so the index can be checked
+//			against the linear validators without the editor:
+//
+//			g++ -O2 EntityConnectionIndex_test.cpp -o EntityConnectionIndex_test && ./EntityConnectionIndex_test
+//
+//			The index is a template over the entity and connection types,
+//			which must provide:
+//
+//			ENTITY		- const char *GetKeyValue( const char * ),
+//						  int Connections_GetCount(), CONNECTION *Connections_Get( int ),
+//						  bool NameMatches( const char * ) and IsVisible()
+//			CONNECTION	- const char *GetTargetName()
+//
+//=============================================================================//
+
+#ifndef ENTITYCONNECTIONINDEX_H
+#define ENTITYCONNECTIONINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: Hashes a name without regard to case, so that names that stricmp
+//			finds equal hash the same.
+//-----------------------------------------------------------------------------
+inline unsigned int EntityConnectionIndex_HashName( const char *pszName )
+{
+	unsigned int nHash = 2166136261u;
+	for ( const unsigned char *p = (const unsigned char *)pszName; *p; p++ )
+	{
+		unsigned char ch = *p;
+		if ( ( ch >= 'A' ) && ( ch <= 'Z' ) )
+		{
+			ch += 'a' - 'A';
+		}
+		nHash = ( nHash ^ ch ) * 16777619u;
+	}
+	return nHash;
+}
+
+//-----------------------------------------------------------------------------
+// Maps integer or pointer keys to ints, with open addressing.
+//-----------------------------------------------------------------------------
+class CEntityConnectionKeyMap
+{
+public:
+
+	CEntityConnectionKeyMap( void ) : m_pSlots( 0 ), m_nCapacity( 0 ), m_nUsed( 0 ), m_nDeleted( 0 ) {}
+	~CEntityConnectionKeyMap( void ) { delete [] m_pSlots; }
+
+	inline int Count( void ) const { return m_nUsed; }
+
+	void RemoveAll( void )
+	{
+		for ( int i = 0; i < m_nCapacity; i++ )
+		{
+			m_pSlots[i].m_nState = SLOT_EMPTY;
+		}
+		m_nUsed = 0;
+		m_nDeleted = 0;
+	}
+
+	// Returns the value stored for the key, or -1.
+	int Find( size_t nKey ) const
+	{
+		int nSlot = FindSlot( nKey );
+		return ( nSlot != -1 ) ? m_pSlots[nSlot].m_nValue : -1;
+	}
+
+	void Set( size_t nKey, int nValue )
+	{
+		int nSlot = FindSlot( nKey );
+		if ( nSlot != -1 )
+		{
+			m_pSlots[nSlot].m_nValue = nValue;
+			return;
+		}
+
+		if ( ( m_nUsed + m_nDeleted + 1 ) * 4 > m_nCapacity * 3 )
+		{
+			int nCapacity = 16;
+			while ( nCapacity < ( m_nUsed + 1 ) * 2 )
+			{
+				nCapacity *= 2;
+			}
+			Rehash( nCapacity );
+		}
+
+		int nMask = m_nCapacity - 1;
+		for ( nSlot = Mix( nKey ) & nMask; m_pSlots[nSlot].m_nState == SLOT_USED; nSlot = ( nSlot + 1 ) & nMask )
+		{
+		}
+
+		if ( m_pSlots[nSlot].m_nState == SLOT_DELETED )
+		{
+			m_nDeleted--;
+		}
+		m_pSlots[nSlot].m_nKey = nKey;
+		m_pSlots[nSlot].m_nValue = nValue;
+		m_pSlots[nSlot].m_nState = SLOT_USED;
+		m_nUsed++;
+	}
+
+	void Remove( size_t nKey )
+	{
+		int nSlot = FindSlot( nKey );
+		if ( nSlot != -1 )
+		{
+			m_pSlots[nSlot].m_nState = SLOT_DELETED;
+			m_nUsed--;
+			m_nDeleted++;
+		}
+	}
+
+private:
+
+	enum
+	{
+		SLOT_EMPTY = 0,
+		SLOT_USED,
+		SLOT_DELETED,
+	};
+
+	struct Slot_t
+	{
+		size_t m_nKey;
+		int m_nValue;
+		int m_nState;
+	};
+
+	static inline int Mix( size_t nKey )
+	{
+		unsigned long long nMixed = (unsigned long long)nKey * 0x9E3779B97F4A7C15ull;
+		return (int)( nMixed >> 33 );
+	}
+
+	int FindSlot( size_t nKey ) const
+	{
+		if ( m_nCapacity == 0 )
+			return -1;
+
+		int nMask = m_nCapacity - 1;
+		for ( int nSlot = Mix( nKey ) & nMask; m_pSlots[nSlot].m_nState != SLOT_EMPTY; nSlot = ( nSlot + 1 ) & nMask )
+		{
+			if ( ( m_pSlots[nSlot].m_nState == SLOT_USED ) && ( m_pSlots[nSlot].m_nKey == nKey ) )
+				return nSlot;
+		}
+		return -1;
+	}
+
+	void Rehash( int nCapacity )
+	{
+		Slot_t *pOldSlots = m_pSlots;
+		int nOldCapacity = m_nCapacity;
+
+		m_pSlots = new Slot_t[ nCapacity ];
+		m_nCapacity = nCapacity;
+		m_nUsed = 0;
+		m_nDeleted = 0;
+		for ( int i = 0; i < nCapacity; i++ )
+		{
+			m_pSlots[i].m_nState = SLOT_EMPTY;
+		}
+
+		for ( int i = 0; i < nOldCapacity; i++ )
+		{
+			if ( pOldSlots[i].m_nState == SLOT_USED )
+			{
+				Set( pOldSlots[i].m_nKey, pOldSlots[i].m_nValue );
+			}
+		}
+		delete [] pOldSlots;
+	}
+
+	CEntityConnectionKeyMap( const CEntityConnectionKeyMap & );
+	CEntityConnectionKeyMap &operator=( const CEntityConnectionKeyMap & );
+
+	Slot_t *m_pSlots;
+	int m_nCapacity;		// Zero or a power of two.
+	int m_nUsed;
+	int m_nDeleted;
+};
+
+//-----------------------------------------------------------------------------
+// Names and connection targets without wildcards are chained by hash. Names
+// containing '*' can match many names, so they have chains of their own that
+// every query tests.
+//-----------------------------------------------------------------------------
+template <class ENTITY, class CONNECTION>
+class CEntityConnectionIndex
+{
+public:
+
+	CEntityConnectionIndex( void ) :
+		m_bBuilt( false ),
+		m_pEntities( 0 ), m_nEntityCount( 0 ), m_nEntityCapacity( 0 ), m_nFreeEntity( -1 ),
+		m_pNames( 0 ), m_nNameCount( 0 ), m_nNameCapacity( 0 ), m_nFreeName( -1 ), m_nWildcardNames( -1 ),
+		m_pEdges( 0 ), m_nEdgeCount( 0 ), m_nEdgeCapacity( 0 ), m_nFreeEdge( -1 ), m_nWildcardEdges( -1 ),
+		m_pDirty( 0 ), m_nDirtyCount( 0 ), m_nDirtyCapacity( 0 ) {}
+
+	~CEntityConnectionIndex( void )
+	{
+		delete [] m_pEntities;
+		delete [] m_pNames;
+		delete [] m_pEdges;
+		delete [] m_pDirty;
+	}
+
+	inline bool IsBuilt( void ) const { return m_bBuilt; }
+	inline int GetDirtyCount( void ) const { return m_nDirtyCount; }
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Forgets everything. Changes are ignored until the next Build.
+	//-----------------------------------------------------------------------------
+	void Purge( void )
+	{
+		m_bBuilt = false;
+		m_nEntityCount = 0;
+		m_nFreeEntity = -1;
+		m_nNameCount = 0;
+		m_nFreeName = -1;
+		m_nWildcardNames = -1;
+		m_nEdgeCount = 0;
+		m_nFreeEdge = -1;
+		m_nWildcardEdges = -1;
+		m_nDirtyCount = 0;
+		m_EntityMap.RemoveAll();
+		m_NameHeads.RemoveAll();
+		m_EdgeHeads.RemoveAll();
+		m_ConnectionMap.RemoveAll();
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Indexes every entity in a list, replacing whatever was indexed.
+	//			Linear in the number of entities plus connections.
+	//-----------------------------------------------------------------------------
+	void Build( ENTITY *const *ppEntities, int nCount )
+	{
+		Purge();
+		m_bBuilt = true;
+
+		for ( int i = 0; i < nCount; i++ )
+		{
+			if ( ppEntities[i] && ( m_EntityMap.Find( (size_t)ppEntities[i] ) == -1 ) )
+			{
+				IndexEntity( NewEntity( ppEntities[i] ) );
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Adds an entity. It is indexed on the next Update.
+	//-----------------------------------------------------------------------------
+	void AddEntity( ENTITY *pEntity )
+	{
+		if ( !m_bBuilt || !pEntity )
+			return;
+
+		int nEntity = m_EntityMap.Find( (size_t)pEntity );
+		if ( nEntity == -1 )
+		{
+			nEntity = NewEntity( pEntity );
+		}
+		MarkDirty( nEntity );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Removes an entity at once. Only what the index stored about the
+	//			entity is used, so its connections may already be gone.
+	//-----------------------------------------------------------------------------
+	void RemoveEntity( ENTITY *pEntity )
+	{
+		if ( !m_bBuilt )
+			return;
+
+		int nEntity = m_EntityMap.Find( (size_t)pEntity );
+		if ( nEntity == -1 )
+			return;
+
+		UnindexEntity( nEntity );
+		m_EntityMap.Remove( (size_t)pEntity );
+
+		Entity_t &Entity = m_pEntities[nEntity];
+		Entity.m_pEntity = 0;
+		Entity.m_bDirty = false;
+		Entity.m_nNextFree = m_nFreeEntity;
+		m_nFreeEntity = nEntity;
+	}
+
+	inline bool ContainsEntity( ENTITY *pEntity ) const
+	{
+		return m_EntityMap.Find( (size_t)pEntity ) != -1;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Call when an entity's targetname or list of connections changes.
+	//-----------------------------------------------------------------------------
+	void OnEntityChanged( ENTITY *pEntity )
+	{
+		int nEntity = m_EntityMap.Find( (size_t)pEntity );
+		if ( nEntity != -1 )
+		{
+			MarkDirty( nEntity );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Call when a connection's target changes. The connection must be
+	//			one that was indexed, or one whose entity was marked changed.
+	//-----------------------------------------------------------------------------
+	void OnConnectionChanged( CONNECTION *pConnection )
+	{
+		int nEdge = m_ConnectionMap.Find( (size_t)pConnection );
+		if ( nEdge != -1 )
+		{
+			MarkDirty( m_pEdges[nEdge].m_nSource );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Indexes the entities that changed since the last update again.
+	//			All of them are unindexed before any is indexed, so a connection
+	//			that was freed and reallocated in between is never indexed twice.
+	//-----------------------------------------------------------------------------
+	void Update( void )
+	{
+		for ( int i = 0; i < m_nDirtyCount; i++ )
+		{
+			if ( m_pEntities[m_pDirty[i]].m_bDirty )
+			{
+				UnindexEntity( m_pDirty[i] );
+			}
+		}
+
+		for ( int i = 0; i < m_nDirtyCount; i++ )
+		{
+			Entity_t &Entity = m_pEntities[m_pDirty[i]];
+			if ( Entity.m_bDirty )
+			{
+				Entity.m_bDirty = false;
+				IndexEntity( m_pDirty[i] );
+			}
+		}
+
+		m_nDirtyCount = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns true if any entity's targetname matches the given name,
+	//			as NameMatches does. Call Update first.
+	//-----------------------------------------------------------------------------
+	bool HasEntityNamed( const char *pszName, bool bVisiblesOnly )
+	{
+		if ( !pszName )
+			return false;
+
+		// A wildcard query can match any name; test them all.
+		if ( strchr( pszName, '*' ) )
+		{
+			for ( int i = 0; i < m_nNameCount; i++ )
+			{
+				if ( ( m_pNames[i].m_nEntity != -1 ) && EntityNameMatches( m_pNames[i].m_nEntity, pszName, bVisiblesOnly ) )
+					return true;
+			}
+			return false;
+		}
+
+		for ( int i = m_NameHeads.Find( EntityConnectionIndex_HashName( pszName ) ); i != -1; i = m_pNames[i].m_nNext )
+		{
+			if ( EntityNameMatches( m_pNames[i].m_nEntity, pszName, bVisiblesOnly ) )
+				return true;
+		}
+
+		for ( int i = m_nWildcardNames; i != -1; i = m_pNames[i].m_nNext )
+		{
+			if ( EntityNameMatches( m_pNames[i].m_nEntity, pszName, bVisiblesOnly ) )
+				return true;
+		}
+
+		return false;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Finds the connections whose target matches an entity's
+	//			targetname. Call Update first.
+	// Input  : bVisiblesOnly - Skip connections from hidden entities.
+	//			Report - Called as Report( pSource, pConnection ).
+	//-----------------------------------------------------------------------------
+	template <class REPORT>
+	void FindConnectionsTo( ENTITY *pEntity, bool bVisiblesOnly, REPORT &Report )
+	{
+		const char *pszName = pEntity ? pEntity->GetKeyValue( "targetname" ) : 0;
+		if ( !pszName )
+			return;
+
+		// A wildcard name can be targeted by any name; test every connection.
+		if ( strchr( pszName, '*' ) )
+		{
+			for ( int i = 0; i < m_nEdgeCount; i++ )
+			{
+				if ( m_pEdges[i].m_nSource != -1 )
+				{
+					ReportIfTargets( i, pEntity, bVisiblesOnly, Report );
+				}
+			}
+			return;
+		}
+
+		for ( int i = m_EdgeHeads.Find( EntityConnectionIndex_HashName( pszName ) ); i != -1; i = m_pEdges[i].m_nNext )
+		{
+			ReportIfTargets( i, pEntity, bVisiblesOnly, Report );
+		}
+
+		for ( int i = m_nWildcardEdges; i != -1; i = m_pEdges[i].m_nNext )
+		{
+			ReportIfTargets( i, pEntity, bVisiblesOnly, Report );
+		}
+	}
+
+private:
+
+	struct Entity_t
+	{
+		ENTITY *m_pEntity;			// NULL if free.
+		int m_nName;				// Name node, or -1.
+		int m_nFirstEdge;			// Chained through EdgeNode_t::m_nNextOfSource.
+		bool m_bDirty;
+		int m_nNextFree;
+	};
+
+	struct NameNode_t
+	{
+		int m_nEntity;				// -1 if free.
+		unsigned int m_nHash;
+		bool m_bWildcard;
+		int m_nPrev;				// -1 at the head of a chain.
+		int m_nNext;				// Next in the chain, or in the free list.
+	};
+
+	struct EdgeNode_t
+	{
+		int m_nSource;				// Entity the connection belongs to, or -1 if free.
+		CONNECTION *m_pConnection;
+		unsigned int m_nHash;
+		bool m_bWildcard;
+		int m_nPrev;				// -1 at the head of a chain.
+		int m_nNext;				// Next in the chain, or in the free list.
+		int m_nNextOfSource;
+	};
+
+	template <class T>
+	static void Reserve( T *&pData, int &nCapacity, int nCount, int nNeeded )
+	{
+		if ( nNeeded <= nCapacity )
+			return;
+
+		int nNewCapacity = nCapacity ? nCapacity * 2 : 64;
+		while ( nNewCapacity < nNeeded )
+		{
+			nNewCapacity *= 2;
+		}
+
+		T *pNewData = new T[ nNewCapacity ];
+		for ( int i = 0; i < nCount; i++ )
+		{
+			pNewData[i] = pData[i];
+		}
+
+		delete [] pData;
+		pData = pNewData;
+		nCapacity = nNewCapacity;
+	}
+
+	int NewEntity( ENTITY *pEntity )
+	{
+		int nEntity = m_nFreeEntity;
+		if ( nEntity != -1 )
+		{
+			m_nFreeEntity = m_pEntities[nEntity].m_nNextFree;
+		}
+		else
+		{
+			Reserve( m_pEntities, m_nEntityCapacity, m_nEntityCount, m_nEntityCount + 1 );
+			nEntity = m_nEntityCount++;
+		}
+
+		Entity_t &Entity = m_pEntities[nEntity];
+		Entity.m_pEntity = pEntity;
+		Entity.m_nName = -1;
+		Entity.m_nFirstEdge = -1;
+		Entity.m_bDirty = false;
+		Entity.m_nNextFree = -1;
+
+		m_EntityMap.Set( (size_t)pEntity, nEntity );
+		return nEntity;
+	}
+
+	void MarkDirty( int nEntity )
+	{
+		if ( m_pEntities[nEntity].m_bDirty )
+			return;
+
+		m_pEntities[nEntity].m_bDirty = true;
+		Reserve( m_pDirty, m_nDirtyCapacity, m_nDirtyCount, m_nDirtyCount + 1 );
+		m_pDirty[m_nDirtyCount++] = nEntity;
+	}
+
+	// Links a node at the head of the chain for its hash.
+	template <class NODE>
+	static void LinkNode( NODE *pNodes, int nNode, CEntityConnectionKeyMap &Heads, int &nWildcardHead )
+	{
+		NODE &Node = pNodes[nNode];
+		int nHead = Node.m_bWildcard ? nWildcardHead : Heads.Find( Node.m_nHash );
+
+		Node.m_nPrev = -1;
+		Node.m_nNext = nHead;
+		if ( nHead != -1 )
+		{
+			pNodes[nHead].m_nPrev = nNode;
+		}
+
+		if ( Node.m_bWildcard )
+		{
+			nWildcardHead = nNode;
+		}
+		else
+		{
+			Heads.Set( Node.m_nHash, nNode );
+		}
+	}
+
+	template <class NODE>
+	static void UnlinkNode( NODE *pNodes, int nNode, CEntityConnectionKeyMap &Heads, int &nWildcardHead )
+	{
+		NODE &Node = pNodes[nNode];
+		if ( Node.m_nNext != -1 )
+		{
+			pNodes[Node.m_nNext].m_nPrev = Node.m_nPrev;
+		}
+
+		if ( Node.m_nPrev != -1 )
+		{
+			pNodes[Node.m_nPrev].m_nNext = Node.m_nNext;
+		}
+		else if ( Node.m_bWildcard )
+		{
+			nWildcardHead = Node.m_nNext;
+		}
+		else if ( Node.m_nNext != -1 )
+		{
+			Heads.Set( Node.m_nHash, Node.m_nNext );
+		}
+		else
+		{
+			Heads.Remove( Node.m_nHash );
+		}
+	}
+
+	void IndexEntity( int nEntity )
+	{
+		ENTITY *pEntity = m_pEntities[nEntity].m_pEntity;
+
+		const char *pszName = pEntity->GetKeyValue( "targetname" );
+		if ( pszName )
+		{
+			int nName = m_nFreeName;
+			if ( nName != -1 )
+			{
+				m_nFreeName = m_pNames[nName].m_nNext;
+			}
+			else
+			{
+				Reserve( m_pNames, m_nNameCapacity, m_nNameCount, m_nNameCount + 1 );
+				nName = m_nNameCount++;
+			}
+
+			NameNode_t &Name = m_pNames[nName];
+			Name.m_nEntity = nEntity;
+			Name.m_bWildcard = ( strchr( pszName, '*' ) != 0 );
+			Name.m_nHash = Name.m_bWildcard ? 0 : EntityConnectionIndex_HashName( pszName );
+			LinkNode( m_pNames, nName, m_NameHeads, m_nWildcardNames );
+			m_pEntities[nEntity].m_nName = nName;
+		}
+
+		int nConnCount = pEntity->Connections_GetCount();
+		for ( int i = 0; i < nConnCount; i++ )
+		{
+			CONNECTION *pConnection = pEntity->Connections_Get( i );
+			if ( !pConnection )
+				continue;
+
+			int nEdge = m_nFreeEdge;
+			if ( nEdge != -1 )
+			{
+				m_nFreeEdge = m_pEdges[nEdge].m_nNext;
+			}
+			else
+			{
+				Reserve( m_pEdges, m_nEdgeCapacity, m_nEdgeCount, m_nEdgeCount + 1 );
+				nEdge = m_nEdgeCount++;
+			}
+
+			const char *pszTarget = pConnection->GetTargetName();
+
+			EdgeNode_t &Edge = m_pEdges[nEdge];
+			Edge.m_nSource = nEntity;
+			Edge.m_pConnection = pConnection;
+			Edge.m_bWildcard = ( strchr( pszTarget, '*' ) != 0 );
+			Edge.m_nHash = Edge.m_bWildcard ? 0 : EntityConnectionIndex_HashName( pszTarget );
+			LinkNode( m_pEdges, nEdge, m_EdgeHeads, m_nWildcardEdges );
+
+			Edge.m_nNextOfSource = m_pEntities[nEntity].m_nFirstEdge;
+			m_pEntities[nEntity].m_nFirstEdge = nEdge;
+			m_ConnectionMap.Set( (size_t)pConnection, nEdge );
+		}
+	}
+
+	void UnindexEntity( int nEntity )
+	{
+		Entity_t &Entity = m_pEntities[nEntity];
+
+		if ( Entity.m_nName != -1 )
+		{
+			UnlinkNode( m_pNames, Entity.m_nName, m_NameHeads, m_nWildcardNames );
+			m_pNames[Entity.m_nName].m_nEntity = -1;
+			m_pNames[Entity.m_nName].m_nNext = m_nFreeName;
+			m_nFreeName = Entity.m_nName;
+			Entity.m_nName = -1;
+		}
+
+		int nEdge = Entity.m_nFirstEdge;
+		while ( nEdge != -1 )
+		{
+			EdgeNode_t &Edge = m_pEdges[nEdge];
+			int nNextOfSource = Edge.m_nNextOfSource;
+
+			UnlinkNode( m_pEdges, nEdge, m_EdgeHeads, m_nWildcardEdges );
+			if ( m_ConnectionMap.Find( (size_t)Edge.m_pConnection ) == nEdge )
+			{
+				m_ConnectionMap.Remove( (size_t)Edge.m_pConnection );
+			}
+
+			Edge.m_nSource = -1;
+			Edge.m_pConnection = 0;
+			Edge.m_nNext = m_nFreeEdge;
+			m_nFreeEdge = nEdge;
+
+			nEdge = nNextOfSource;
+		}
+		Entity.m_nFirstEdge = -1;
+	}
+
+	inline bool EntityNameMatches( int nEntity, const char *pszName, bool bVisiblesOnly )
+	{
+		ENTITY *pEntity = m_pEntities[nEntity].m_pEntity;
+		return ( !bVisiblesOnly || pEntity->IsVisible() ) && pEntity->NameMatches( pszName );
+	}
+
+	template <class REPORT>
+	inline void ReportIfTargets( int nEdge, ENTITY *pTarget, bool bVisiblesOnly, REPORT &Report )
+	{
+		ENTITY *pSource = m_pEntities[m_pEdges[nEdge].m_nSource].m_pEntity;
+		CONNECTION *pConnection = m_pEdges[nEdge].m_pConnection;
+		if ( ( !bVisiblesOnly || pSource->IsVisible() ) && pTarget->NameMatches( pConnection->GetTargetName() ) )
+		{
+			Report( pSource, pConnection );
+		}
+	}
+
+	CEntityConnectionIndex( const CEntityConnectionIndex & );
+	CEntityConnectionIndex &operator=( const CEntityConnectionIndex & );
+
+	bool m_bBuilt;
+
+	Entity_t *m_pEntities;
+	int m_nEntityCount;
+	int m_nEntityCapacity;
+	int m_nFreeEntity;
+	CEntityConnectionKeyMap m_EntityMap;		// ENTITY * -> m_pEntities index.
+
+	NameNode_t *m_pNames;
+	int m_nNameCount;
+	int m_nNameCapacity;
+	int m_nFreeName;
+	CEntityConnectionKeyMap m_NameHeads;		// Name hash -> first name node.
+	int m_nWildcardNames;
+
+	EdgeNode_t *m_pEdges;
+	int m_nEdgeCount;
+	int m_nEdgeCapacity;
+	int m_nFreeEdge;
+	CEntityConnectionKeyMap m_EdgeHeads;		// Target hash -> first edge node.
+	int m_nWildcardEdges;
+	CEntityConnectionKeyMap m_ConnectionMap;	// CONNECTION * -> edge node.
+
+	int *m_pDirty;								// m_pEntities indices.
+	int m_nDirtyCount;
+	int m_nDirtyCapacity;
+};
+
+#endif // ENTITYCONNECTIONINDEX_H
@@ -0,0 +1,695 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test for EntityConnectionIndex.h. Models entities and
+//			their connections, edits them at random the way the editor does,
+//			telling the index as CMapWorld, CEditGameClass and
+//			CEntityConnection do, and after each batch of edits compares
+//			every query with the linear validators the index replaced.
+//			Then times both on a world with 50,000 connections, along with a
+//			single edit against rebuilding the whole index:
+//
+//			g++ -O2 EntityConnectionIndex_test.cpp -o EntityConnectionIndex_test && ./EntityConnectionIndex_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "EntityConnectionIndex.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Copy of CompareEntityNames from MapEntity.cpp.
+//-----------------------------------------------------------------------------
+static int CompareEntityNames( const char *szName1, const char *szName2 )
+{
+	int nCompareLen = -1;
+
+	const char *pszWildcard1 = strchr( szName1, '*' );
+	if ( pszWildcard1 )
+	{
+		nCompareLen = pszWildcard1 - szName1;
+	}
+
+	const char *pszWildcard2 = strchr( szName2, '*' );
+	if ( pszWildcard2 )
+	{
+		if ( nCompareLen == -1 )
+		{
+			nCompareLen = pszWildcard2 - szName2;
+		}
+		else
+		{
+			nCompareLen = std::min( nCompareLen, (int)( pszWildcard2 - szName2 ) );
+		}
+	}
+
+	if ( nCompareLen != -1 )
+	{
+		if ( nCompareLen > 0 )
+		{
+			return strncasecmp( szName1, szName2, nCompareLen );
+		}
+		return 0;
+	}
+
+	return strcasecmp( szName1, szName2 );
+}
+
+//
+// Stands in for CEntityConnection. Output and input names are "OutN" and
+// "InN"; a class numbered C has outputs and inputs 0 through C.
+//
+struct Connection_t
+{
+	char m_szTarget[64];
+	char m_szOutput[16];
+	char m_szInput[16];
+
+	const char *GetTargetName( void ) { return m_szTarget; }
+};
+
+//
+// Stands in for CMapEntity.
+//
+struct Entity_t
+{
+	bool m_bHasName;
+	std::string m_Name;
+	bool m_bVisible;
+	int m_nClass;
+	std::vector<Connection_t *> m_Connections;
+
+	const char *GetKeyValue( const char *pszKey ) { return ( !strcmp( pszKey, "targetname" ) && m_bHasName ) ? m_Name.c_str() : NULL; }
+	int Connections_GetCount( void ) { return (int)m_Connections.size(); }
+	Connection_t *Connections_Get( int i ) { return m_Connections[i]; }
+	bool NameMatches( const char *pszName ) { return m_bHasName && !CompareEntityNames( m_Name.c_str(), pszName ); }
+	bool IsVisible( void ) { return m_bVisible; }
+};
+
+typedef CEntityConnectionIndex<Entity_t, Connection_t> Index_t;
+typedef std::pair<Entity_t *, Connection_t *> Edge_t;
+
+enum
+{
+	CONNECTION_NONE = 0,
+	CONNECTION_GOOD,
+	CONNECTION_BAD,
+};
+
+static const char *s_pszNames[] =
+{
+	"door", "Door", "DOOR", "door1", "door2", "door_*", "door*", "*", "relay", "relay_a", "RELAY_A", "relay_*",
+	"light", "light_spot", "l*", "", "trigger", "trigger_once", "!self", "!player",
+};
+static const int s_nNames = sizeof( s_pszNames ) / sizeof( s_pszNames[0] );
+
+static bool ValidOutput( Entity_t *pEntity, const char *pszOutput )
+{
+	return atoi( pszOutput + 3 ) <= pEntity->m_nClass;
+}
+
+static bool ValidInput( Entity_t *pEntity, const char *pszInput )
+{
+	return atoi( pszInput + 2 ) <= pEntity->m_nClass;
+}
+
+//-----------------------------------------------------------------------------
+// The validators as they were before the index: a scan of every entity.
+//-----------------------------------------------------------------------------
+static bool LinearHasEntityNamed( std::vector<Entity_t *> &World, const char *pszName, bool bVisiblesOnly )
+{
+	for ( size_t i = 0; i < World.size(); i++ )
+	{
+		if ( ( !bVisiblesOnly || World[i]->IsVisible() ) && World[i]->NameMatches( pszName ) )
+			return true;
+	}
+	return false;
+}
+
+static void LinearConnectionsTo( std::vector<Entity_t *> &World, Entity_t *pEntity, bool bVisiblesOnly, std::vector<Edge_t> &Edges )
+{
+	if ( !pEntity->GetKeyValue( "targetname" ) )
+		return;
+
+	for ( size_t i = 0; i < World.size(); i++ )
+	{
+		Entity_t *pSource = World[i];
+		if ( bVisiblesOnly && !pSource->IsVisible() )
+			continue;
+
+		for ( size_t j = 0; j < pSource->m_Connections.size(); j++ )
+		{
+			if ( pEntity->NameMatches( pSource->m_Connections[j]->GetTargetName() ) )
+			{
+				Edges.push_back( Edge_t( pSource, pSource->m_Connections[j] ) );
+			}
+		}
+	}
+}
+
+struct AddEdge_t
+{
+	std::vector<Edge_t> *pEdges;
+
+	void operator()( Entity_t *pSource, Connection_t *pConnection ) { pEdges->push_back( Edge_t( pSource, pConnection ) ); }
+};
+
+static int ValidateInputConnections( Entity_t *pEntity, const std::vector<Edge_t> &Edges )
+{
+	if ( !pEntity->GetKeyValue( "targetname" ) )
+		return CONNECTION_NONE;
+
+	for ( size_t i = 0; i < Edges.size(); i++ )
+	{
+		if ( !ValidOutput( Edges[i].first, Edges[i].second->m_szOutput ) || !ValidInput( pEntity, Edges[i].second->m_szInput ) )
+			return CONNECTION_BAD;
+	}
+
+	return Edges.empty() ? CONNECTION_NONE : CONNECTION_GOOD;
+}
+
+//
+// A world of entities, and the index kept up to date the way the editor
+// keeps it.
+//
+struct World_t
+{
+	std::vector<Entity_t *> m_Entities;		// Like CMapWorld::m_EntityList.
+	std::vector<Entity_t *> m_Detached;		// Removed from the world but not deleted, as by undo.
+	Index_t m_Index;
+
+	~World_t( void )
+	{
+		for ( size_t i = 0; i < m_Entities.size(); i++ )
+		{
+			DeleteEntity( m_Entities[i] );
+		}
+		for ( size_t i = 0; i < m_Detached.size(); i++ )
+		{
+			DeleteEntity( m_Detached[i] );
+		}
+	}
+
+	static void DeleteEntity( Entity_t *pEntity )
+	{
+		for ( size_t i = 0; i < pEntity->m_Connections.size(); i++ )
+		{
+			delete pEntity->m_Connections[i];
+		}
+		delete pEntity;
+	}
+
+	static Connection_t *NewConnection( void )
+	{
+		Connection_t *pConnection = new Connection_t;
+		strcpy( pConnection->m_szTarget, s_pszNames[RandomInt( 0, s_nNames - 1 )] );
+		sprintf( pConnection->m_szOutput, "Out%d", RandomInt( 0, 3 ) );
+		sprintf( pConnection->m_szInput, "In%d", RandomInt( 0, 3 ) );
+		return pConnection;
+	}
+
+	static Entity_t *NewEntity( void )
+	{
+		Entity_t *pEntity = new Entity_t;
+		pEntity->m_bHasName = ( RandomInt( 0, 3 ) != 0 );
+		pEntity->m_Name = s_pszNames[RandomInt( 0, s_nNames - 1 )];
+		pEntity->m_bVisible = ( RandomInt( 0, 4 ) != 0 );
+		pEntity->m_nClass = RandomInt( 0, 3 );
+		for ( int i = RandomInt( 0, 3 ); i > 0; i-- )
+		{
+			pEntity->m_Connections.push_back( NewConnection() );
+		}
+		return pEntity;
+	}
+
+	// CMapWorld::AddEntity.
+	void AddEntity( Entity_t *pEntity )
+	{
+		m_Entities.push_back( pEntity );
+		m_Index.AddEntity( pEntity );
+	}
+
+	// CMapWorld::EntityList_Remove, with FastRemove.
+	Entity_t *RemoveEntity( int nIndex )
+	{
+		Entity_t *pEntity = m_Entities[nIndex];
+		m_Entities[nIndex] = m_Entities.back();
+		m_Entities.pop_back();
+		m_Index.RemoveEntity( pEntity );
+		return pEntity;
+	}
+
+	Entity_t *RandomEntity( void )
+	{
+		if ( !m_Detached.empty() && ( RandomInt( 0, 4 ) == 0 ) )
+			return m_Detached[RandomInt( 0, (int)m_Detached.size() - 1 )];
+
+		return m_Entities.empty() ? NULL : m_Entities[RandomInt( 0, (int)m_Entities.size() - 1 )];
+	}
+
+	void RandomEdit( void )
+	{
+		Entity_t *pEntity = RandomEntity();
+
+		switch ( RandomInt( 0, 9 ) )
+		{
+			// Rename, as OnKeyValueChanged does.
+			case 0:
+			{
+				if ( pEntity )
+				{
+					pEntity->m_bHasName = ( RandomInt( 0, 5 ) != 0 );
+					pEntity->m_Name = s_pszNames[RandomInt( 0, s_nNames - 1 )];
+					m_Index.OnEntityChanged( pEntity );
+				}
+				break;
+			}
+
+			// Connections_Add.
+			case 1:
+			{
+				if ( pEntity )
+				{
+					pEntity->m_Connections.push_back( NewConnection() );
+					m_Index.OnEntityChanged( pEntity );
+				}
+				break;
+			}
+
+			// Connections_Remove and delete, so the address may be reused.
+			case 2:
+			{
+				if ( pEntity && !pEntity->m_Connections.empty() )
+				{
+					int nConnection = RandomInt( 0, (int)pEntity->m_Connections.size() - 1 );
+					delete pEntity->m_Connections[nConnection];
+					pEntity->m_Connections.erase( pEntity->m_Connections.begin() + nConnection );
+					m_Index.OnEntityChanged( pEntity );
+				}
+				break;
+			}
+
+			// Connections_RemoveAll.
+			case 3:
+			{
+				if ( pEntity && ( RandomInt( 0, 2 ) == 0 ) )
+				{
+					for ( size_t i = 0; i < pEntity->m_Connections.size(); i++ )
+					{
+						delete pEntity->m_Connections[i];
+					}
+					pEntity->m_Connections.clear();
+					m_Index.OnEntityChanged( pEntity );
+				}
+				break;
+			}
+
+			// SetTargetName, or operator= from another connection.
+			case 4:
+			{
+				if ( pEntity && !pEntity->m_Connections.empty() )
+				{
+					Connection_t *pConnection = pEntity->m_Connections[RandomInt( 0, (int)pEntity->m_Connections.size() - 1 )];
+					Entity_t *pOther = RandomEntity();
+					if ( pOther && !pOther->m_Connections.empty() && ( RandomInt( 0, 1 ) == 0 ) )
+					{
+						*pConnection = *pOther->m_Connections[RandomInt( 0, (int)pOther->m_Connections.size() - 1 )];
+					}
+					else
+					{
+						strcpy( pConnection->m_szTarget, s_pszNames[RandomInt( 0, s_nNames - 1 )] );
+					}
+					m_Index.OnConnectionChanged( pConnection );
+				}
+				break;
+			}
+
+			// Hide or show. The index reads visibility when queried.
+			case 5:
+			{
+				if ( pEntity )
+				{
+					pEntity->m_bVisible = !pEntity->m_bVisible;
+				}
+				break;
+			}
+
+			// A new entity.
+			case 6:
+			{
+				AddEntity( NewEntity() );
+				break;
+			}
+
+			// Delete an entity.
+			case 7:
+			{
+				if ( !m_Entities.empty() )
+				{
+					DeleteEntity( RemoveEntity( RandomInt( 0, (int)m_Entities.size() - 1 ) ) );
+				}
+				break;
+			}
+
+			// Detach an entity, as deleting with undo does.
+			case 8:
+			{
+				if ( !m_Entities.empty() )
+				{
+					m_Detached.push_back( RemoveEntity( RandomInt( 0, (int)m_Entities.size() - 1 ) ) );
+				}
+				break;
+			}
+
+			// Bring a detached entity back, as undo does.
+			case 9:
+			{
+				if ( !m_Detached.empty() )
+				{
+					int nIndex = RandomInt( 0, (int)m_Detached.size() - 1 );
+					Entity_t *pDetached = m_Detached[nIndex];
+					m_Detached.erase( m_Detached.begin() + nIndex );
+					AddEntity( pDetached );
+				}
+				break;
+			}
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Compares every query the index answers with the linear validators.
+//			Returns the number of differences.
+//-----------------------------------------------------------------------------
+static int CompareWithLinear( World_t &World, Index_t &Index )
+{
+	int nDifferences = 0;
+
+	for ( int nVisible = 0; nVisible < 2; nVisible++ )
+	{
+		bool bVisiblesOnly = ( nVisible != 0 );
+
+		for ( int i = 0; i < s_nNames; i++ )
+		{
+			if ( Index.HasEntityNamed( s_pszNames[i], bVisiblesOnly ) != LinearHasEntityNamed( World.m_Entities, s_pszNames[i], bVisiblesOnly ) )
+			{
+				nDifferences++;
+			}
+		}
+
+		for ( size_t i = 0; i < World.m_Entities.size(); i++ )
+		{
+			Entity_t *pEntity = World.m_Entities[i];
+
+			std::vector<Edge_t> Linear;
+			LinearConnectionsTo( World.m_Entities, pEntity, bVisiblesOnly, Linear );
+
+			std::vector<Edge_t> Indexed;
+			AddEdge_t AddEdge;
+			AddEdge.pEdges = &Indexed;
+			Index.FindConnectionsTo( pEntity, bVisiblesOnly, AddEdge );
+
+			if ( ValidateInputConnections( pEntity, Linear ) != ValidateInputConnections( pEntity, Indexed ) )
+			{
+				nDifferences++;
+			}
+
+			std::sort( Linear.begin(), Linear.end() );
+			std::sort( Indexed.begin(), Indexed.end() );
+			if ( Linear != Indexed )
+			{
+				nDifferences++;
+			}
+		}
+	}
+
+	return nDifferences;
+}
+
+static void TestHashName( void )
+{
+	CHECK( EntityConnectionIndex_HashName( "Door_1" ) == EntityConnectionIndex_HashName( "dOOR_1" ) );
+	CHECK( EntityConnectionIndex_HashName( "door_1" ) != EntityConnectionIndex_HashName( "door_2" ) );
+	CHECK( EntityConnectionIndex_HashName( "" ) != EntityConnectionIndex_HashName( "a" ) );
+}
+
+static void TestKeyMap( void )
+{
+	CEntityConnectionKeyMap Map;
+	std::vector<int> Reference( 5000, -1 );
+
+	CHECK( Map.Find( 7 ) == -1 );
+
+	for ( int nStep = 0; nStep < 200000; nStep++ )
+	{
+		int nKey = RandomInt( 0, 4999 );
+		if ( RandomInt( 0, 2 ) == 0 )
+		{
+			Map.Remove( nKey * 16 );
+			Reference[nKey] = -1;
+		}
+		else
+		{
+			Map.Set( nKey * 16, nStep );
+			Reference[nKey] = nStep;
+		}
+	}
+
+	int nCount = 0;
+	for ( int i = 0; i < 5000; i++ )
+	{
+		CHECK( Map.Find( i * 16 ) == Reference[i] );
+		nCount += ( Reference[i] != -1 );
+	}
+	CHECK( Map.Count() == nCount );
+
+	Map.RemoveAll();
+	CHECK( Map.Count() == 0 );
+	CHECK( Map.Find( 16 ) == -1 );
+}
+
+static void TestRandomEdits( void )
+{
+	int nDifferences = 0;
+
+	for ( int nWorld = 0; nWorld < 20; nWorld++ )
+	{
+		World_t World;
+		for ( int i = RandomInt( 0, 60 ); i > 0; i-- )
+		{
+			World.m_Entities.push_back( World_t::NewEntity() );
+		}
+
+		// Edits before the first build are picked up by it.
+		for ( int i = 0; i < 10; i++ )
+		{
+			World.RandomEdit();
+		}
+
+		World.m_Index.Build( &World.m_Entities[0], (int)World.m_Entities.size() );
+		nDifferences += CompareWithLinear( World, World.m_Index );
+
+		for ( int nBatch = 0; nBatch < 100; nBatch++ )
+		{
+			for ( int i = RandomInt( 1, 20 ); i > 0; i-- )
+			{
+				World.RandomEdit();
+			}
+
+			World.m_Index.Update();
+			CHECK( World.m_Index.GetDirtyCount() == 0 );
+			nDifferences += CompareWithLinear( World, World.m_Index );
+		}
+
+		// A fresh build answers the same as the updated index.
+		Index_t Rebuilt;
+		Rebuilt.Build( World.m_Entities.empty() ? NULL : &World.m_Entities[0], (int)World.m_Entities.size() );
+		nDifferences += CompareWithLinear( World, Rebuilt );
+	}
+
+	CHECK( nDifferences == 0 );
+}
+
+static void TestUnbuilt( void )
+{
+	Entity_t Entity;
+	Entity.m_bHasName = true;
+	Entity.m_Name = "door";
+	Entity.m_bVisible = true;
+	Entity.m_nClass = 0;
+
+	// An index that was never built ignores changes.
+	Index_t Index;
+	Index.AddEntity( &Entity );
+	Index.OnEntityChanged( &Entity );
+	CHECK( !Index.ContainsEntity( &Entity ) );
+	CHECK( Index.GetDirtyCount() == 0 );
+	CHECK( !Index.HasEntityNamed( "door", false ) );
+
+	Entity_t *pEntities[] = { &Entity };
+	Index.Build( pEntities, 1 );
+	CHECK( Index.ContainsEntity( &Entity ) );
+	CHECK( Index.HasEntityNamed( "DOOR", false ) );
+	CHECK( Index.HasEntityNamed( "d*", false ) );
+	CHECK( !Index.HasEntityNamed( "door1", false ) );
+
+	// A rename is seen after the update.
+	Entity.m_Name = "door1";
+	Index.OnEntityChanged( &Entity );
+	CHECK( Index.GetDirtyCount() == 1 );
+	Index.Update();
+	CHECK( Index.HasEntityNamed( "door1", false ) );
+	CHECK( !Index.HasEntityNamed( "door", false ) );
+
+	Index.Purge();
+	CHECK( !Index.IsBuilt() );
+	CHECK( !Index.HasEntityNamed( "door1", false ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds a world of 25,000 entities with two connections each. One
+//			entity in a hundred has a wildcard name or target.
+//-----------------------------------------------------------------------------
+static void BuildBenchmarkWorld( World_t &World )
+{
+	for ( int i = 0; i < 25000; i++ )
+	{
+		Entity_t *pEntity = new Entity_t;
+		char szName[64];
+		sprintf( szName, ( i % 100 ) ? "ent_%d" : "ent_%d*", i / 2 );
+		pEntity->m_bHasName = true;
+		pEntity->m_Name = szName;
+		pEntity->m_bVisible = true;
+		pEntity->m_nClass = 3;
+
+		for ( int j = 0; j < 2; j++ )
+		{
+			Connection_t *pConnection = new Connection_t;
+			sprintf( pConnection->m_szTarget, ( RandomInt( 0, 99 ) != 0 ) ? "ent_%d" : "ent_%d*", RandomInt( 0, 12499 ) );
+			strcpy( pConnection->m_szOutput, "Out0" );
+			strcpy( pConnection->m_szInput, "In0" );
+			pEntity->m_Connections.push_back( pConnection );
+		}
+
+		World.m_Entities.push_back( pEntity );
+	}
+}
+
+static void Benchmark( void )
+{
+	World_t World;
+	BuildBenchmarkWorld( World );
+	int nEntities = (int)World.m_Entities.size();
+
+	//
+	// Validating the inputs of every entity, as the Entity Report does. The
+	// linear validator scans every connection per entity, so time a tenth of
+	// the entities and scale up.
+	//
+	int nLinearEntities = nEntities / 10;
+	int nLinearResults = 0;
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nLinearEntities; i++ )
+	{
+		std::vector<Edge_t> Edges;
+		LinearConnectionsTo( World.m_Entities, World.m_Entities[i], true, Edges );
+		nLinearResults += ValidateInputConnections( World.m_Entities[i], Edges );
+	}
+	double flLinearMS = MS( Start ) * nEntities / nLinearEntities;
+
+	Start = std::chrono::steady_clock::now();
+	World.m_Index.Build( &World.m_Entities[0], nEntities );
+	double flBuildMS = MS( Start );
+
+	int nIndexedResults = 0;
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nEntities; i++ )
+	{
+		std::vector<Edge_t> Edges;
+		AddEdge_t AddEdge;
+		AddEdge.pEdges = &Edges;
+		World.m_Index.FindConnectionsTo( World.m_Entities[i], true, AddEdge );
+		int nResult = ValidateInputConnections( World.m_Entities[i], Edges );
+		if ( i < nLinearEntities )
+		{
+			nIndexedResults += nResult;
+		}
+	}
+	double flIndexedMS = MS( Start );
+	CHECK( nIndexedResults == nLinearResults );
+
+	//
+	// One edit at a time, each followed by the update the next validation
+	// does: retargeting a connection, then renaming an entity.
+	//
+	const int nEdits = 10000;
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nEdits; i++ )
+	{
+		Entity_t *pEntity = World.m_Entities[RandomInt( 0, nEntities - 1 )];
+		Connection_t *pConnection = pEntity->m_Connections[i & 1];
+		sprintf( pConnection->m_szTarget, "ent_%d", RandomInt( 0, 12499 ) );
+		World.m_Index.OnConnectionChanged( pConnection );
+		World.m_Index.Update();
+
+		pEntity = World.m_Entities[RandomInt( 0, nEntities - 1 )];
+		char szName[64];
+		sprintf( szName, "ent_%d", RandomInt( 0, 12499 ) );
+		pEntity->m_Name = szName;
+		World.m_Index.OnEntityChanged( pEntity );
+		World.m_Index.Update();
+	}
+	double flEditMS = MS( Start ) / ( nEdits * 2 );
+
+	Start = std::chrono::steady_clock::now();
+	World.m_Index.Build( &World.m_Entities[0], nEntities );
+	double flRebuildMS = MS( Start );
+
+	printf( "%d entities, %d connections:\n", nEntities, nEntities * 2 );
+	printf( "  validate every entity's inputs, linear:  %9.1f ms (scaled from %d entities)\n", flLinearMS, nLinearEntities );
+	printf( "  validate every entity's inputs, indexed: %9.1f ms, plus %.1f ms to build\n", flIndexedMS, flBuildMS );
+	printf( "  one edit, then update:                   %9.4f ms\n", flEditMS );
+	printf( "  rebuilding the whole index:              %9.4f ms\n", flRebuildMS );
+}
+
+int main( void )
+{
+	TestHashName();
+	TestKeyMap();
+	TestUnbuilt();
+	TestRandomEdits();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All entity connection index tests passed\n" );
+
+	Benchmark();
+	return ( g_nFailures != 0 ) ? 1 : 0;
+}
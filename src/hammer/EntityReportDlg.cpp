@@ -573,7 +573,7 @@ void CEntityReportDlg::UpdateEntityList(void)
 
 	// add items to list
 	CMapWorld *pWorld = m_pDoc->GetMapWorld();
-	pWorld->EnumChildren(ENUMMAPCHILDRENPROC(AddEntityToList), DWORD(this), MAPCLASS_TYPE(CMapEntity));
+	pWorld->EnumObjectsOfType(AddEntityToList, this);
 
 	m_cEntities.SetRedraw(TRUE);
 	m_cEntities.Invalidate();
@@ -0,0 +1,484 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The CPU side of brush face meshes. The dynamic path and the
+//			static face mesh cache both write faces through the templates
+//			here, and CFaceMeshChunk keeps the vertices and indices of one
+//			cached static mesh.
+//
+//			This file has no includes, so the chunk contents can be checked
+//			against the dynamic path without the editor:
+//
+//			g++ FaceMeshBuilder_test.cpp -o FaceMeshBuilder_test && ./FaceMeshBuilder_test
+//
+//=============================================================================//
+
+#ifndef FACEMESHBUILDER_H
+#define FACEMESHBUILDER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+//
+// Limits for one chunk. A chunk is rebuilt and uploaded whole when any of its
+// faces change, so they are kept well below what a static mesh can hold.
+//
+#define FACEMESH_CHUNK_MAX_VERTS		8192
+#define FACEMESH_CHUNK_MAX_INDICES		( FACEMESH_CHUNK_MAX_VERTS * 3 )
+#define FACEMESH_CHUNK_MAX_FACES		2048
+
+//
+// Everything about a face that ends up in its vertices. The arrays are laid
+// out like Vector, Vector2D and CMapFace::TangentSpaceAxes_t.
+//
+struct FaceMeshFace_t
+{
+	int m_nPoints;
+	const float *m_pPoints;				// 3 floats per point.
+	const float *m_pNormal;				// 3 floats.
+	const unsigned char *m_pColor;		// RGBA.
+	const float *m_pTexCoords;			// 2 floats per point.
+	const float *m_pLightmapCoords;		// 2 floats per point.
+	const float *m_pTangentAxes;		// Tangent then binormal, 6 floats per point.
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns how many indices a face with the given point count adds.
+//-----------------------------------------------------------------------------
+inline int FaceMesh_IndexCount( int nPoints, bool bWireframe )
+{
+	return bWireframe ? nPoints * 2 : ( nPoints - 2 ) * 3;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the vertices of a face. BUILDER is a CMeshBuilder or a
+//			CFaceMeshArrayBuilder.
+//-----------------------------------------------------------------------------
+template < class BUILDER >
+inline void FaceMesh_AddVertices( BUILDER &builder, const FaceMeshFace_t &face )
+{
+	for ( int nPoint = 0; nPoint < face.m_nPoints; nPoint++ )
+	{
+		builder.Position3fv( &face.m_pPoints[ nPoint * 3 ] );
+		builder.Normal3fv( face.m_pNormal );
+		builder.Color4ubv( face.m_pColor );
+
+		builder.TexCoord2fv( 0, &face.m_pTexCoords[ nPoint * 2 ] );
+		builder.TexCoord2fv( 1, &face.m_pLightmapCoords[ nPoint * 2 ] );
+		builder.TangentS3fv( &face.m_pTangentAxes[ nPoint * 6 ] );
+		builder.TangentT3fv( &face.m_pTangentAxes[ nPoint * 6 + 3 ] );
+
+		builder.AdvanceVertex();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the triangle fan, or the outline in wireframe, of a face
+//			whose vertices start at nFirstVertex.
+//-----------------------------------------------------------------------------
+template < class BUILDER >
+inline void FaceMesh_AddIndices( BUILDER &builder, int nFirstVertex, int nPoints, bool bWireframe )
+{
+	if ( bWireframe )
+	{
+		builder.FastIndex( nFirstVertex );
+		for ( int j = 1; j < nPoints; ++j )
+		{
+			builder.FastIndex( nFirstVertex + j );
+			builder.FastIndex( nFirstVertex + j );
+		}
+		builder.FastIndex( nFirstVertex );
+	}
+	else
+	{
+		for ( int j = 2; j < nPoints; ++j )
+		{
+			builder.FastIndex( nFirstVertex );
+			builder.FastIndex( nFirstVertex + j - 1 );
+			builder.FastIndex( nFirstVertex + j );
+		}
+	}
+}
+
+//
+// One vertex as FaceMesh_AddVertices writes it.
+//
+struct FaceMeshVertex_t
+{
+	float m_Position[3];
+	float m_Normal[3];
+	unsigned char m_Color[4];
+	float m_TexCoord[2];
+	float m_LightmapCoord[2];
+	float m_TangentS[3];
+	float m_TangentT[3];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Receives FaceMesh_AddVertices and FaceMesh_AddIndices into plain
+//			arrays, which must be large enough.
+//-----------------------------------------------------------------------------
+class CFaceMeshArrayBuilder
+{
+public:
+
+	CFaceMeshArrayBuilder( FaceMeshVertex_t *pVertices, unsigned short *pIndices ) : m_pVertex( pVertices ), m_pIndex( pIndices ) {}
+
+	void Position3fv( const float *v ) { Copy( m_pVertex->m_Position, v, 3 ); }
+	void Normal3fv( const float *n ) { Copy( m_pVertex->m_Normal, n, 3 ); }
+	void Color4ubv( const unsigned char *rgba ) { for ( int i = 0; i < 4; i++ ) m_pVertex->m_Color[i] = rgba[i]; }
+	void TexCoord2fv( int nStage, const float *st ) { Copy( nStage ? m_pVertex->m_LightmapCoord : m_pVertex->m_TexCoord, st, 2 ); }
+	void TangentS3fv( const float *s ) { Copy( m_pVertex->m_TangentS, s, 3 ); }
+	void TangentT3fv( const float *t ) { Copy( m_pVertex->m_TangentT, t, 3 ); }
+	void AdvanceVertex( void ) { m_pVertex++; }
+	void FastIndex( unsigned short nIndex ) { *m_pIndex++ = nIndex; }
+
+	FaceMeshVertex_t *GetVertex( void ) const { return m_pVertex; }
+	unsigned short *GetIndex( void ) const { return m_pIndex; }
+
+private:
+
+	static void Copy( float *pDest, const float *pSrc, int nCount ) { for ( int i = 0; i < nCount; i++ ) pDest[i] = pSrc[i]; }
+
+	FaceMeshVertex_t *m_pVertex;
+	unsigned short *m_pIndex;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes stored vertices to a CMeshBuilder.
+//-----------------------------------------------------------------------------
+template < class BUILDER >
+inline void FaceMesh_CopyVertices( BUILDER &builder, const FaceMeshVertex_t *pVertices, int nCount )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		const FaceMeshVertex_t &v = pVertices[i];
+
+		builder.Position3fv( v.m_Position );
+		builder.Normal3fv( v.m_Normal );
+		builder.Color4ubv( v.m_Color );
+		builder.TexCoord2fv( 0, v.m_TexCoord );
+		builder.TexCoord2fv( 1, v.m_LightmapCoord );
+		builder.TangentS3fv( v.m_TangentS );
+		builder.TangentT3fv( v.m_TangentT );
+		builder.AdvanceVertex();
+	}
+}
+
+//
+// A face stored in a chunk. Free slots have no key and keep their space
+// until the chunk is compacted.
+//
+struct FaceMeshSlot_t
+{
+	const void *m_pKey;					// The face, only ever compared.
+	unsigned int m_nRevision;
+	unsigned int m_nColor;
+	int m_nFirstVertex;
+	int m_nVertexCount;
+	int m_nFirstIndex;
+	int m_nIndexCount;
+	unsigned int m_nQueuedBatch;		// Last batch the face was drawn in.
+	unsigned int m_nLastUsedPass;
+};
+
+//
+// A run of indices to draw, as in CPrimList.
+//
+struct FaceMeshRange_t
+{
+	int m_nFirstIndex;
+	int m_nIndexCount;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: The faces of one material batch that share a static mesh. Faces
+//			are appended; a face whose point count changes moves to the end.
+//			Any change marks the chunk dirty so it is uploaded again.
+//-----------------------------------------------------------------------------
+class CFaceMeshChunk
+{
+public:
+
+	explicit CFaceMeshChunk( bool bWireframe ) :
+		m_bWireframe( bWireframe ), m_bDirty( true ),
+		m_pVertices( 0 ), m_nVertexCount( 0 ), m_nVertexCapacity( 0 ),
+		m_pIndices( 0 ), m_nIndexCount( 0 ), m_nIndexCapacity( 0 ),
+		m_pSlots( 0 ), m_nSlotCount( 0 ), m_nSlotCapacity( 0 ),
+		m_nFaceCount( 0 ), m_nFreeVertices( 0 ) {}
+
+	~CFaceMeshChunk( void )
+	{
+		delete [] m_pVertices;
+		delete [] m_pIndices;
+		delete [] m_pSlots;
+	}
+
+	bool IsWireframe( void ) const { return m_bWireframe; }
+	bool IsDirty( void ) const { return m_bDirty; }
+	void ClearDirty( void ) { m_bDirty = false; }
+
+	int GetFaceCount( void ) const { return m_nFaceCount; }
+	int GetSlotCount( void ) const { return m_nSlotCount; }
+	const FaceMeshSlot_t &GetSlot( int nSlot ) const { return m_pSlots[nSlot]; }
+
+	int GetVertexCount( void ) const { return m_nVertexCount; }
+	int GetIndexCount( void ) const { return m_nIndexCount; }
+	const FaceMeshVertex_t *GetVertices( void ) const { return m_pVertices; }
+	const unsigned short *GetIndices( void ) const { return m_pIndices; }
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns true if a face can be appended without compacting.
+	//-----------------------------------------------------------------------------
+	bool HasRoomFor( int nPoints ) const
+	{
+		return ( m_nSlotCount < FACEMESH_CHUNK_MAX_FACES ) &&
+			   ( m_nVertexCount + nPoints <= FACEMESH_CHUNK_MAX_VERTS ) &&
+			   ( m_nIndexCount + FaceMesh_IndexCount( nPoints, m_bWireframe ) <= FACEMESH_CHUNK_MAX_INDICES );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns true if compacting would free at least half the chunk.
+	//-----------------------------------------------------------------------------
+	bool ShouldCompact( void ) const
+	{
+		return ( m_nFreeVertices * 2 > m_nVertexCount ) || ( ( m_nSlotCount - m_nFaceCount ) * 2 > m_nSlotCount );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Appends a face.
+	// Output : Returns the slot, or -1 if there is no room.
+	//-----------------------------------------------------------------------------
+	int AddFace( const void *pKey, unsigned int nRevision, const FaceMeshFace_t &face )
+	{
+		if ( ( face.m_nPoints < 3 ) || !HasRoomFor( face.m_nPoints ) )
+			return -1;
+
+		int nIndices = FaceMesh_IndexCount( face.m_nPoints, m_bWireframe );
+		Reserve( m_pVertices, m_nVertexCapacity, m_nVertexCount, m_nVertexCount + face.m_nPoints );
+		Reserve( m_pIndices, m_nIndexCapacity, m_nIndexCount, m_nIndexCount + nIndices );
+		Reserve( m_pSlots, m_nSlotCapacity, m_nSlotCount, m_nSlotCount + 1 );
+
+		int nSlot = m_nSlotCount++;
+		FaceMeshSlot_t &slot = m_pSlots[nSlot];
+		slot.m_pKey = pKey;
+		slot.m_nRevision = nRevision;
+		slot.m_nColor = PackColor( face.m_pColor );
+		slot.m_nFirstVertex = m_nVertexCount;
+		slot.m_nVertexCount = face.m_nPoints;
+		slot.m_nFirstIndex = m_nIndexCount;
+		slot.m_nIndexCount = nIndices;
+		slot.m_nQueuedBatch = 0;
+		slot.m_nLastUsedPass = 0;
+
+		CFaceMeshArrayBuilder builder( &m_pVertices[ m_nVertexCount ], &m_pIndices[ m_nIndexCount ] );
+		FaceMesh_AddVertices( builder, face );
+		FaceMesh_AddIndices( builder, m_nVertexCount, face.m_nPoints, m_bWireframe );
+
+		m_nVertexCount += face.m_nPoints;
+		m_nIndexCount += nIndices;
+		m_nFaceCount++;
+		m_bDirty = true;
+
+		return nSlot;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Rewrites the vertices of a face in place.
+	// Output : Returns false if the point count changed, in which case the face
+	//			has to be removed and added again.
+	//-----------------------------------------------------------------------------
+	bool UpdateFace( int nSlot, unsigned int nRevision, const FaceMeshFace_t &face )
+	{
+		FaceMeshSlot_t &slot = m_pSlots[nSlot];
+		if ( slot.m_nVertexCount != face.m_nPoints )
+			return false;
+
+		CFaceMeshArrayBuilder builder( &m_pVertices[ slot.m_nFirstVertex ], NULL );
+		FaceMesh_AddVertices( builder, face );
+
+		slot.m_nRevision = nRevision;
+		slot.m_nColor = PackColor( face.m_pColor );
+		m_bDirty = true;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Changes only the color of a face, as selection does.
+	//-----------------------------------------------------------------------------
+	void UpdateColor( int nSlot, const unsigned char *pColor )
+	{
+		FaceMeshSlot_t &slot = m_pSlots[nSlot];
+		for ( int i = 0; i < slot.m_nVertexCount; i++ )
+		{
+			unsigned char *pDest = m_pVertices[ slot.m_nFirstVertex + i ].m_Color;
+			pDest[0] = pColor[0];
+			pDest[1] = pColor[1];
+			pDest[2] = pColor[2];
+			pDest[3] = pColor[3];
+		}
+
+		slot.m_nColor = PackColor( pColor );
+		m_bDirty = true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Frees a slot. Its space is reclaimed by Compact.
+	//-----------------------------------------------------------------------------
+	void RemoveFace( int nSlot )
+	{
+		FaceMeshSlot_t &slot = m_pSlots[nSlot];
+		if ( !slot.m_pKey )
+			return;
+
+		slot.m_pKey = 0;
+		m_nFreeVertices += slot.m_nVertexCount;
+		m_nFaceCount--;
+		m_bDirty = true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Marks a face to be drawn in the given batch.
+	//-----------------------------------------------------------------------------
+	void QueueFace( int nSlot, unsigned int nBatch, unsigned int nPass )
+	{
+		m_pSlots[nSlot].m_nQueuedBatch = nBatch;
+		m_pSlots[nSlot].m_nLastUsedPass = nPass;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns true if the slot holds this face at this revision and color.
+	//-----------------------------------------------------------------------------
+	bool IsCurrent( int nSlot, unsigned int nRevision, const unsigned char *pColor ) const
+	{
+		return ( m_pSlots[nSlot].m_nRevision == nRevision ) && ( m_pSlots[nSlot].m_nColor == PackColor( pColor ) );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Packs the faces queued in a batch into as few index runs as
+	//			possible. pRanges must have room for GetSlotCount() runs.
+	// Output : Returns the number of runs.
+	//-----------------------------------------------------------------------------
+	int GetDrawRanges( unsigned int nBatch, FaceMeshRange_t *pRanges ) const
+	{
+		int nRanges = 0;
+		bool bInRange = false;
+
+		for ( int i = 0; i < m_nSlotCount; i++ )
+		{
+			const FaceMeshSlot_t &slot = m_pSlots[i];
+			if ( !slot.m_pKey || ( slot.m_nQueuedBatch != nBatch ) )
+			{
+				bInRange = false;
+				continue;
+			}
+
+			if ( bInRange && ( pRanges[ nRanges - 1 ].m_nFirstIndex + pRanges[ nRanges - 1 ].m_nIndexCount == slot.m_nFirstIndex ) )
+			{
+				pRanges[ nRanges - 1 ].m_nIndexCount += slot.m_nIndexCount;
+			}
+			else
+			{
+				pRanges[ nRanges ].m_nFirstIndex = slot.m_nFirstIndex;
+				pRanges[ nRanges ].m_nIndexCount = slot.m_nIndexCount;
+				nRanges++;
+				bInRange = true;
+			}
+		}
+
+		return nRanges;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Drops free slots and the space they held. Faces keep their order
+	//			but move to new slots, so the caller must look them up again.
+	//-----------------------------------------------------------------------------
+	void Compact( void )
+	{
+		int nVertex = 0;
+		int nIndex = 0;
+		int nSlots = 0;
+
+		for ( int i = 0; i < m_nSlotCount; i++ )
+		{
+			FaceMeshSlot_t slot = m_pSlots[i];
+			if ( !slot.m_pKey )
+				continue;
+
+			int nShift = slot.m_nFirstVertex - nVertex;
+			for ( int j = 0; j < slot.m_nVertexCount; j++ )
+			{
+				m_pVertices[ nVertex + j ] = m_pVertices[ slot.m_nFirstVertex + j ];
+			}
+			for ( int j = 0; j < slot.m_nIndexCount; j++ )
+			{
+				m_pIndices[ nIndex + j ] = (unsigned short)( m_pIndices[ slot.m_nFirstIndex + j ] - nShift );
+			}
+
+			slot.m_nFirstVertex = nVertex;
+			slot.m_nFirstIndex = nIndex;
+			m_pSlots[ nSlots++ ] = slot;
+
+			nVertex += slot.m_nVertexCount;
+			nIndex += slot.m_nIndexCount;
+		}
+
+		m_nVertexCount = nVertex;
+		m_nIndexCount = nIndex;
+		m_nSlotCount = nSlots;
+		m_nFreeVertices = 0;
+		m_bDirty = true;
+	}
+
+private:
+
+	static unsigned int PackColor( const unsigned char *pColor )
+	{
+		return pColor[0] | ( pColor[1] << 8 ) | ( pColor[2] << 16 ) | ( (unsigned int)pColor[3] << 24 );
+	}
+
+	template < class T >
+	static void Reserve( T *&pData, int &nCapacity, int nCount, int nNeeded )
+	{
+		if ( nNeeded <= nCapacity )
+			return;
+
+		int nNewCapacity = nCapacity ? nCapacity * 2 : 64;
+		while ( nNewCapacity < nNeeded )
+		{
+			nNewCapacity *= 2;
+		}
+
+		T *pNewData = new T[ nNewCapacity ];
+		for ( int i = 0; i < nCount; i++ )
+		{
+			pNewData[i] = pData[i];
+		}
+
+		delete [] pData;
+		pData = pNewData;
+		nCapacity = nNewCapacity;
+	}
+
+	CFaceMeshChunk( const CFaceMeshChunk & );
+	CFaceMeshChunk &operator=( const CFaceMeshChunk & );
+
+	bool m_bWireframe;
+	bool m_bDirty;
+
+	FaceMeshVertex_t *m_pVertices;
+	int m_nVertexCount;
+	int m_nVertexCapacity;
+
+	unsigned short *m_pIndices;
+	int m_nIndexCount;
+	int m_nIndexCapacity;
+
+	FaceMeshSlot_t *m_pSlots;
+	int m_nSlotCount;
+	int m_nSlotCapacity;
+
+	int m_nFaceCount;
+	int m_nFreeVertices;
+};
+
+#endif // FACEMESHBUILDER_H
@@ -0,0 +1,506 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the static face mesh chunks. Faces are drawn
+//			through chunks over many frames while they change, and what the
+//			chunks draw is checked against what RenderFacesBatch emits for
+//			the same faces. Needs nothing but a C++ compiler:
+//
+//			g++ -O2 FaceMeshBuilder_test.cpp -o FaceMeshBuilder_test && ./FaceMeshBuilder_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "FaceMeshBuilder.h"
+
+#define TEST_FACES			600
+#define TEST_FRAMES			300
+#define TEST_EVICT_PASSES	8
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int g_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	g_nSeed = g_nSeed * 1664525 + 1013904223;
+	return nMin + (int)( ( g_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( void )
+{
+	return RandomInt( -100000, 100000 ) / 64.0f;
+}
+
+//
+// A face as CMapFace stores it.
+//
+struct TestFace_t
+{
+	unsigned int m_nRevision;
+	unsigned char m_Color[4];
+	float m_Normal[3];
+	std::vector<float> m_Points;
+	std::vector<float> m_TexCoords;
+	std::vector<float> m_LightmapCoords;
+	std::vector<float> m_TangentAxes;
+
+	void Randomize( int nPoints )
+	{
+		m_Points.resize( nPoints * 3 );
+		m_TexCoords.resize( nPoints * 2 );
+		m_LightmapCoords.resize( nPoints * 2 );
+		m_TangentAxes.resize( nPoints * 6 );
+
+		for ( size_t i = 0; i < m_Points.size(); i++ ) m_Points[i] = RandomFloat();
+		for ( size_t i = 0; i < m_TexCoords.size(); i++ ) m_TexCoords[i] = RandomFloat();
+		for ( size_t i = 0; i < m_LightmapCoords.size(); i++ ) m_LightmapCoords[i] = RandomFloat();
+		for ( size_t i = 0; i < m_TangentAxes.size(); i++ ) m_TangentAxes[i] = RandomFloat();
+		for ( int i = 0; i < 3; i++ ) m_Normal[i] = RandomFloat();
+	}
+
+	void RandomizeColor( void )
+	{
+		for ( int i = 0; i < 4; i++ ) m_Color[i] = (unsigned char)RandomInt( 0, 255 );
+	}
+
+	FaceMeshFace_t GetMeshFace( void ) const
+	{
+		FaceMeshFace_t face;
+		face.m_nPoints = (int)m_Points.size() / 3;
+		face.m_pPoints = &m_Points[0];
+		face.m_pNormal = m_Normal;
+		face.m_pColor = m_Color;
+		face.m_pTexCoords = &m_TexCoords[0];
+		face.m_pLightmapCoords = &m_LightmapCoords[0];
+		face.m_pTangentAxes = &m_TangentAxes[0];
+		return face;
+	}
+};
+
+//
+// The material level of CFaceMeshCache, with the same chunk selection,
+// update and eviction rules, minus the material system.
+//
+struct TestSlotRef_t
+{
+	CFaceMeshChunk *m_pChunk;
+	int m_nSlot;
+};
+
+class CTestMaterial
+{
+public:
+
+	CTestMaterial( bool bWireframe ) : m_bWireframe( bWireframe ) {}
+	~CTestMaterial( void ) { for ( size_t i = 0; i < m_Chunks.size(); i++ ) delete m_Chunks[i]; }
+
+	void CompactChunk( CFaceMeshChunk *pChunk )
+	{
+		pChunk->Compact();
+		for ( int i = 0; i < pChunk->GetSlotCount(); i++ )
+		{
+			m_Faces[ pChunk->GetSlot( i ).m_pKey ].m_nSlot = i;
+		}
+	}
+
+	CFaceMeshChunk *FindChunkWithRoom( int nPoints )
+	{
+		if ( !m_Chunks.empty() && m_Chunks.back()->HasRoomFor( nPoints ) )
+			return m_Chunks.back();
+
+		for ( size_t i = 0; i < m_Chunks.size(); i++ )
+		{
+			if ( !m_Chunks[i]->HasRoomFor( nPoints ) && m_Chunks[i]->ShouldCompact() )
+			{
+				CompactChunk( m_Chunks[i] );
+			}
+			if ( m_Chunks[i]->HasRoomFor( nPoints ) )
+				return m_Chunks[i];
+		}
+
+		m_Chunks.push_back( new CFaceMeshChunk( m_bWireframe ) );
+		return m_Chunks.back();
+	}
+
+	void AddFace( const TestFace_t *pFace, unsigned int nBatch, unsigned int nPass )
+	{
+		FaceMeshFace_t face = pFace->GetMeshFace();
+		CFaceMeshChunk *pChunk = NULL;
+		int nSlot = -1;
+
+		std::map<const void *, TestSlotRef_t>::iterator it = m_Faces.find( pFace );
+		if ( it != m_Faces.end() )
+		{
+			pChunk = it->second.m_pChunk;
+			nSlot = it->second.m_nSlot;
+
+			if ( !pChunk->IsCurrent( nSlot, pFace->m_nRevision, pFace->m_Color ) )
+			{
+				if ( pChunk->GetSlot( nSlot ).m_nRevision == pFace->m_nRevision )
+				{
+					pChunk->UpdateColor( nSlot, pFace->m_Color );
+				}
+				else if ( !pChunk->UpdateFace( nSlot, pFace->m_nRevision, face ) )
+				{
+					pChunk->RemoveFace( nSlot );
+					m_Faces.erase( it );
+					pChunk = NULL;
+				}
+			}
+		}
+
+		if ( pChunk == NULL )
+		{
+			pChunk = FindChunkWithRoom( face.m_nPoints );
+			nSlot = pChunk->AddFace( pFace, pFace->m_nRevision, face );
+			CHECK( nSlot >= 0 );
+
+			TestSlotRef_t ref = { pChunk, nSlot };
+			m_Faces[ pFace ] = ref;
+		}
+
+		pChunk->QueueFace( nSlot, nBatch, nPass );
+	}
+
+	void Evict( unsigned int nPass )
+	{
+		for ( int i = (int)m_Chunks.size() - 1; i >= 0; i-- )
+		{
+			CFaceMeshChunk *pChunk = m_Chunks[i];
+			for ( int nSlot = 0; nSlot < pChunk->GetSlotCount(); nSlot++ )
+			{
+				const FaceMeshSlot_t &slot = pChunk->GetSlot( nSlot );
+				if ( slot.m_pKey && ( nPass - slot.m_nLastUsedPass > TEST_EVICT_PASSES ) )
+				{
+					m_Faces.erase( slot.m_pKey );
+					pChunk->RemoveFace( nSlot );
+				}
+			}
+
+			if ( pChunk->GetFaceCount() == 0 )
+			{
+				delete pChunk;
+				m_Chunks.erase( m_Chunks.begin() + i );
+			}
+			else if ( pChunk->ShouldCompact() )
+			{
+				CompactChunk( pChunk );
+			}
+		}
+	}
+
+	bool m_bWireframe;
+	std::vector<CFaceMeshChunk *> m_Chunks;
+	std::map<const void *, TestSlotRef_t> m_Faces;
+};
+
+//
+// Index and vertex streams, as RenderFacesBatch writes them into a
+// CMeshBuilder.
+//
+struct TestStream_t
+{
+	std::vector<FaceMeshVertex_t> m_Vertices;
+	std::vector<unsigned short> m_Indices;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: The loop of RenderFacesBatch.
+//-----------------------------------------------------------------------------
+static void EmitDynamic( TestStream_t &stream, const std::vector<const TestFace_t *> &faces, bool bWireframe )
+{
+	int nVertices = 0;
+	int nIndices = 0;
+	for ( size_t i = 0; i < faces.size(); i++ )
+	{
+		int nPoints = (int)faces[i]->m_Points.size() / 3;
+		nVertices += nPoints;
+		nIndices += FaceMesh_IndexCount( nPoints, bWireframe );
+	}
+
+	stream.m_Vertices.resize( nVertices );
+	stream.m_Indices.resize( nIndices );
+
+	CFaceMeshArrayBuilder meshBuilder( &stream.m_Vertices[0], &stream.m_Indices[0] );
+	int nFirstVertex = 0;
+
+	for ( size_t i = 0; i < faces.size(); i++ )
+	{
+		FaceMeshFace_t face = faces[i]->GetMeshFace();
+		FaceMesh_AddVertices( meshBuilder, face );
+
+		FaceMesh_AddIndices( meshBuilder, nFirstVertex, face.m_nPoints, bWireframe );
+		nFirstVertex += face.m_nPoints;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the cache over changing faces and compares every frame.
+//-----------------------------------------------------------------------------
+static void TestFrames( bool bWireframe )
+{
+	std::vector<TestFace_t> faces( TEST_FACES );
+	unsigned int nNextRevision = 1;
+
+	for ( size_t i = 0; i < faces.size(); i++ )
+	{
+		// A few faces are large enough to fill most of a chunk.
+		int nPoints = ( i % 97 == 0 ) ? RandomInt( FACEMESH_CHUNK_MAX_VERTS / 4, FACEMESH_CHUNK_MAX_VERTS / 2 ) : RandomInt( 3, 12 );
+		faces[i].Randomize( nPoints );
+		faces[i].RandomizeColor();
+		faces[i].m_nRevision = nNextRevision++;
+	}
+
+	CTestMaterial material( bWireframe );
+	unsigned int nBatch = 0;
+	int nStaticFrames = 0;
+
+	for ( unsigned int nPass = 1; nPass <= TEST_FRAMES; nPass++ )
+	{
+		// Every fourth frame nothing changes and the view doesn't move, like
+		// an idle editor redrawing.
+		bool bStatic = ( nPass % 4 ) == 0;
+
+		if ( !bStatic )
+		{
+			for ( size_t i = 0; i < faces.size(); i++ )
+			{
+				int nChange = RandomInt( 0, 99 );
+				if ( nChange < 3 )
+				{
+					faces[i].Randomize( (int)faces[i].m_Points.size() / 3 );
+					faces[i].m_nRevision = nNextRevision++;
+				}
+				else if ( nChange < 5 )
+				{
+					faces[i].Randomize( RandomInt( 3, 12 ) );
+					faces[i].m_nRevision = nNextRevision++;
+				}
+				else if ( nChange < 8 )
+				{
+					faces[i].RandomizeColor();
+				}
+			}
+		}
+
+		if ( ( nPass % TEST_EVICT_PASSES ) == 0 )
+		{
+			material.Evict( nPass );
+		}
+
+		// A visible subset in the order the face queue would hand it over. Some
+		// faces stay hidden long enough to be evicted.
+		static std::vector<const TestFace_t *> visible;
+		if ( !bStatic )
+		{
+			visible.clear();
+			for ( size_t i = 0; i < faces.size(); i++ )
+			{
+				int nHidden = ( i % 5 == 0 ) ? 80 : 30;
+				if ( RandomInt( 0, 99 ) >= nHidden )
+				{
+					visible.push_back( &faces[i] );
+				}
+			}
+			for ( size_t i = visible.size(); i > 1; i-- )
+			{
+				size_t j = RandomInt( 0, (int)i - 1 );
+				const TestFace_t *pTemp = visible[i - 1];
+				visible[i - 1] = visible[j];
+				visible[j] = pTemp;
+			}
+		}
+
+		nBatch++;
+		for ( size_t i = 0; i < visible.size(); i++ )
+		{
+			material.AddFace( visible[i], nBatch, nPass );
+		}
+
+		// What the chunks draw, resolved to vertices, and the queued faces in
+		// the order the chunks draw them.
+		std::vector<FaceMeshVertex_t> drawn;
+		std::vector<const TestFace_t *> order;
+		int nDirty = 0;
+
+		for ( size_t c = 0; c < material.m_Chunks.size(); c++ )
+		{
+			CFaceMeshChunk *pChunk = material.m_Chunks[c];
+
+			std::vector<FaceMeshRange_t> ranges( pChunk->GetSlotCount() + 1 );
+			int nRanges = pChunk->GetDrawRanges( nBatch, &ranges[0] );
+			if ( nRanges == 0 )
+				continue;
+
+			if ( pChunk->IsDirty() )
+			{
+				nDirty++;
+				pChunk->ClearDirty();
+			}
+
+			for ( int r = 0; r < nRanges; r++ )
+			{
+				for ( int j = 0; j < ranges[r].m_nIndexCount; j++ )
+				{
+					int nIndex = ranges[r].m_nFirstIndex + j;
+					CHECK( nIndex < pChunk->GetIndexCount() );
+					CHECK( pChunk->GetIndices()[nIndex] < pChunk->GetVertexCount() );
+					drawn.push_back( pChunk->GetVertices()[ pChunk->GetIndices()[nIndex] ] );
+				}
+			}
+
+			for ( int nSlot = 0; nSlot < pChunk->GetSlotCount(); nSlot++ )
+			{
+				const FaceMeshSlot_t &slot = pChunk->GetSlot( nSlot );
+				if ( slot.m_pKey && ( slot.m_nQueuedBatch == nBatch ) )
+				{
+					order.push_back( (const TestFace_t *)slot.m_pKey );
+				}
+			}
+		}
+
+		// Every visible face is drawn once.
+		CHECK( order.size() == visible.size() );
+		std::map<const TestFace_t *, int> seen;
+		for ( size_t i = 0; i < order.size(); i++ )
+		{
+			CHECK( ++seen[ order[i] ] == 1 );
+		}
+		for ( size_t i = 0; i < visible.size(); i++ )
+		{
+			CHECK( seen.count( visible[i] ) == 1 );
+		}
+
+		// The same faces through the dynamic path give the same primitives.
+		TestStream_t dynamic;
+		EmitDynamic( dynamic, order, bWireframe );
+
+		CHECK( drawn.size() == dynamic.m_Indices.size() );
+		if ( drawn.size() == dynamic.m_Indices.size() )
+		{
+			for ( size_t i = 0; i < drawn.size(); i++ )
+			{
+				if ( memcmp( &drawn[i], &dynamic.m_Vertices[ dynamic.m_Indices[i] ], sizeof( FaceMeshVertex_t ) ) )
+				{
+					printf( "FAIL: frame %u index %u differs from the dynamic path\n", nPass, (unsigned int)i );
+					g_nFailures++;
+					break;
+				}
+			}
+		}
+
+		// A frame with no changes uploads nothing.
+		if ( bStatic && ( ( nPass % TEST_EVICT_PASSES ) != 0 ) )
+		{
+			CHECK( nDirty == 0 );
+			nStaticFrames++;
+		}
+	}
+
+	CHECK( nStaticFrames > 0 );
+	printf( "%s: %d chunks, %d faces cached\n", bWireframe ? "wireframe" : "solid", (int)material.m_Chunks.size(), (int)material.m_Faces.size() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compacting keeps faces, their order and their indices intact.
+//-----------------------------------------------------------------------------
+static void TestCompact( void )
+{
+	TestFace_t faces[6];
+	CFaceMeshChunk chunk( false );
+
+	for ( int i = 0; i < 6; i++ )
+	{
+		faces[i].Randomize( 3 + i );
+		faces[i].RandomizeColor();
+		faces[i].m_nRevision = i + 1;
+		CHECK( chunk.AddFace( &faces[i], faces[i].m_nRevision, faces[i].GetMeshFace() ) == i );
+	}
+
+	chunk.RemoveFace( 0 );
+	chunk.RemoveFace( 2 );
+	chunk.RemoveFace( 3 );
+	CHECK( chunk.GetFaceCount() == 3 );
+
+	chunk.Compact();
+	CHECK( chunk.GetSlotCount() == 3 );
+	CHECK( chunk.GetSlot( 0 ).m_pKey == &faces[1] );
+	CHECK( chunk.GetSlot( 1 ).m_pKey == &faces[4] );
+	CHECK( chunk.GetSlot( 2 ).m_pKey == &faces[5] );
+	CHECK( chunk.GetVertexCount() == 4 + 7 + 8 );
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		chunk.QueueFace( i, 1, 1 );
+	}
+
+	FaceMeshRange_t ranges[4];
+	CHECK( chunk.GetDrawRanges( 1, ranges ) == 1 );
+	CHECK( ranges[0].m_nFirstIndex == 0 && ranges[0].m_nIndexCount == chunk.GetIndexCount() );
+
+	std::vector<const TestFace_t *> order;
+	order.push_back( &faces[1] );
+	order.push_back( &faces[4] );
+	order.push_back( &faces[5] );
+
+	TestStream_t dynamic;
+	EmitDynamic( dynamic, order, false );
+	CHECK( (int)dynamic.m_Indices.size() == chunk.GetIndexCount() );
+	CHECK( !memcmp( &dynamic.m_Indices[0], chunk.GetIndices(), dynamic.m_Indices.size() * sizeof( unsigned short ) ) );
+	CHECK( !memcmp( &dynamic.m_Vertices[0], chunk.GetVertices(), dynamic.m_Vertices.size() * sizeof( FaceMeshVertex_t ) ) );
+
+	// A hidden face in the middle splits the draw into two runs.
+	chunk.QueueFace( 1, 0, 1 );
+	CHECK( chunk.GetDrawRanges( 1, ranges ) == 2 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: A chunk never grows past its limits.
+//-----------------------------------------------------------------------------
+static void TestLimits( void )
+{
+	TestFace_t face;
+	face.Randomize( 4 );
+	face.RandomizeColor();
+	face.m_nRevision = 1;
+
+	CFaceMeshChunk chunk( true );
+	int nAdded = 0;
+	while ( chunk.AddFace( &face, 1, face.GetMeshFace() ) >= 0 )
+	{
+		nAdded++;
+	}
+
+	CHECK( nAdded == FACEMESH_CHUNK_MAX_FACES );
+	CHECK( chunk.GetVertexCount() <= FACEMESH_CHUNK_MAX_VERTS );
+	CHECK( chunk.GetIndexCount() <= FACEMESH_CHUNK_MAX_INDICES );
+
+	TestFace_t degenerate;
+	degenerate.Randomize( 2 );
+	degenerate.RandomizeColor();
+	CFaceMeshChunk empty( false );
+	CHECK( empty.AddFace( &degenerate, 1, degenerate.GetMeshFace() ) == -1 );
+}
+
+int main( void )
+{
+	TestCompact();
+	TestLimits();
+	TestFrames( false );
+	TestFrames( true );
+
+	if ( g_nFailures )
+	{
+		printf( "%d failures\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All face mesh tests passed.\n" );
+	return 0;
+}
@@ -0,0 +1,507 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent static meshes for brush faces.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "FaceMeshCache.h"
+#include "MapFace.h"
+#include "IEditorTexture.h"
+#include "materialsystem/imesh.h"
+#include "materialsystem/imaterial.h"
+#include "materialsystem/imaterialsystem.h"
+#include "tier1/generichash.h"
+#include "hammer.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+CFaceMeshCache g_FaceMeshCache;
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CFaceMeshCache::CFaceMeshCache( void )
+{
+	m_bEnabled = true;
+	m_nPass = 0;
+	m_nBatch = 0;
+	m_nChunkCount = 0;
+
+	m_pBatchMaterial = NULL;
+	m_pBatchRenderMaterial = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CFaceMeshCache::~CFaceMeshCache( void )
+{
+	// The material system is gone by the time static destructors run, so
+	// meshes must have been released by Purge() in CHammer::Shutdown.
+	Assert( m_nChunkCount == 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Enables or disables the cache. Disabling frees everything.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::SetEnabled( bool bEnabled )
+{
+	if ( !bEnabled )
+	{
+		Purge();
+	}
+
+	m_bEnabled = bEnabled;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts a new RenderOpaqueFaces pass, evicting stale faces.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::BeginPass( void )
+{
+	m_nPass++;
+
+	if ( ( m_nPass % FACEMESH_EVICT_PASSES ) == 0 )
+	{
+		EvictUnusedFaces();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Hashes the identity of a material batch.
+//-----------------------------------------------------------------------------
+unsigned int CFaceMeshCache::ComputeKey( IEditorTexture *pTexture, int nRenderMode, bool bWireframe )
+{
+	unsigned int nHash = HashItem( pTexture );
+	nHash = ( nHash * 31 ) ^ ( nRenderMode * 0x9E3779B9 );
+	return bWireframe ? ~nHash : nHash;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Looks up the faces cached for a material and render mode.
+//-----------------------------------------------------------------------------
+FaceMeshMaterial_t *CFaceMeshCache::FindMaterial( IEditorTexture *pTexture, int nRenderMode, bool bWireframe )
+{
+	UtlHashHandle_t h = m_Materials.Find( ComputeKey( pTexture, nRenderMode, bWireframe ) );
+	if ( h == m_Materials.InvalidHandle() )
+		return NULL;
+
+	for ( FaceMeshMaterial_t *pMaterial = m_Materials[h]; pMaterial != NULL; pMaterial = pMaterial->m_pNext )
+	{
+		if ( ( pMaterial->m_pTexture == pTexture ) && ( pMaterial->m_nRenderMode == nRenderMode ) && ( pMaterial->m_bWireframe == bWireframe ) )
+			return pMaterial;
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::AddMaterial( FaceMeshMaterial_t *pMaterial )
+{
+	UtlHashHandle_t h = m_Materials.Find( pMaterial->m_nKey );
+	if ( h == m_Materials.InvalidHandle() )
+	{
+		pMaterial->m_pNext = NULL;
+		m_Materials.Insert( pMaterial->m_nKey, pMaterial );
+	}
+	else
+	{
+		pMaterial->m_pNext = m_Materials[h];
+		m_Materials[h] = pMaterial;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Unlinks a material from the table without freeing it.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::RemoveMaterial( FaceMeshMaterial_t *pMaterial )
+{
+	UtlHashHandle_t h = m_Materials.Find( pMaterial->m_nKey );
+	if ( h == m_Materials.InvalidHandle() )
+		return;
+
+	FaceMeshMaterial_t **ppLink = &m_Materials[h];
+	while ( *ppLink != NULL )
+	{
+		if ( *ppLink == pMaterial )
+		{
+			*ppLink = pMaterial->m_pNext;
+			break;
+		}
+
+		ppLink = &( *ppLink )->m_pNext;
+	}
+
+	if ( m_Materials[h] == NULL )
+	{
+		m_Materials.Remove( pMaterial->m_nKey );
+	}
+
+	pMaterial->m_pNext = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees a material's chunks and the material.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::DestroyMaterial( FaceMeshMaterial_t *pMaterial )
+{
+	for ( int i = 0; i < pMaterial->m_Chunks.Count(); i++ )
+	{
+		DestroyChunk( pMaterial->m_Chunks[i] );
+	}
+
+	delete pMaterial;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Releases the static mesh of a chunk and deletes it.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::DestroyChunk( FaceMeshStaticChunk_t *pChunk )
+{
+	if ( pChunk->m_pMesh && MaterialSystemInterface() )
+	{
+		CMatRenderContextPtr pRenderContext( MaterialSystemInterface() );
+		pRenderContext->DestroyStaticMesh( pChunk->m_pMesh );
+	}
+
+	delete pChunk;
+	m_nChunkCount--;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compacts a chunk and points the faces in it at their new slots.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::CompactChunk( FaceMeshMaterial_t *pMaterial, FaceMeshStaticChunk_t *pChunk )
+{
+	pChunk->m_Chunk.Compact();
+
+	for ( int i = 0; i < pChunk->m_Chunk.GetSlotCount(); i++ )
+	{
+		UtlHashHandle_t h = pMaterial->m_Faces.Find( (CMapFace *)pChunk->m_Chunk.GetSlot( i ).m_pKey );
+		Assert( h != pMaterial->m_Faces.InvalidHandle() );
+		pMaterial->m_Faces[h].m_nSlot = i;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a chunk of the material that a face of the given size can
+//			be appended to, compacting or adding a chunk if needed.
+//-----------------------------------------------------------------------------
+FaceMeshStaticChunk_t *CFaceMeshCache::FindChunkWithRoom( FaceMeshMaterial_t *pMaterial, int nPoints )
+{
+	int nChunks = pMaterial->m_Chunks.Count();
+	if ( nChunks && pMaterial->m_Chunks[ nChunks - 1 ]->m_Chunk.HasRoomFor( nPoints ) )
+		return pMaterial->m_Chunks[ nChunks - 1 ];
+
+	for ( int i = 0; i < nChunks; i++ )
+	{
+		FaceMeshStaticChunk_t *pChunk = pMaterial->m_Chunks[i];
+		if ( !pChunk->m_Chunk.HasRoomFor( nPoints ) && pChunk->m_Chunk.ShouldCompact() )
+		{
+			CompactChunk( pMaterial, pChunk );
+		}
+
+		if ( pChunk->m_Chunk.HasRoomFor( nPoints ) )
+			return pChunk;
+	}
+
+	FaceMeshStaticChunk_t *pChunk = new FaceMeshStaticChunk_t( pMaterial->m_bWireframe );
+	pMaterial->m_Chunks.AddToTail( pChunk );
+	m_nChunkCount++;
+	return pChunk;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drops faces that have not been drawn recently, such as those of
+//			deleted or long hidden solids, and frees what they leave empty.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::EvictUnusedFaces( void )
+{
+	CUtlVector<FaceMeshMaterial_t *> stale;
+
+	FOR_EACH_HASHTABLE( m_Materials, h )
+	{
+		for ( FaceMeshMaterial_t *pMaterial = m_Materials[h]; pMaterial != NULL; pMaterial = pMaterial->m_pNext )
+		{
+			for ( int i = pMaterial->m_Chunks.Count() - 1; i >= 0; i-- )
+			{
+				FaceMeshStaticChunk_t *pChunk = pMaterial->m_Chunks[i];
+				CFaceMeshChunk &chunk = pChunk->m_Chunk;
+
+				for ( int nSlot = 0; nSlot < chunk.GetSlotCount(); nSlot++ )
+				{
+					const FaceMeshSlot_t &slot = chunk.GetSlot( nSlot );
+					if ( slot.m_pKey && ( m_nPass - slot.m_nLastUsedPass > FACEMESH_EVICT_PASSES ) )
+					{
+						pMaterial->m_Faces.Remove( (CMapFace *)slot.m_pKey );
+						chunk.RemoveFace( nSlot );
+					}
+				}
+
+				if ( chunk.GetFaceCount() == 0 )
+				{
+					DestroyChunk( pChunk );
+					pMaterial->m_Chunks.Remove( i );
+				}
+				else if ( chunk.ShouldCompact() )
+				{
+					CompactChunk( pMaterial, pChunk );
+				}
+			}
+
+			if ( pMaterial->m_Chunks.Count() == 0 )
+			{
+				stale.AddToTail( pMaterial );
+			}
+		}
+	}
+
+	for ( int i = 0; i < stale.Count(); i++ )
+	{
+		RemoveMaterial( stale[i] );
+		DestroyMaterial( stale[i] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts a batch of faces sharing a material and render mode.
+// Output : Returns false if there is no material bound to build meshes for.
+//-----------------------------------------------------------------------------
+bool CFaceMeshCache::BeginBatch( IEditorTexture *pTexture, int nRenderMode, bool bWireframe )
+{
+	if ( !m_bEnabled )
+		return false;
+
+	CMatRenderContextPtr pRenderContext( MaterialSystemInterface() );
+	m_pBatchRenderMaterial = pRenderContext->GetCurrentMaterial();
+	if ( !m_pBatchRenderMaterial )
+		return false;
+
+	FaceMeshMaterial_t *pMaterial = FindMaterial( pTexture, nRenderMode, bWireframe );
+	if ( pMaterial == NULL )
+	{
+		pMaterial = new FaceMeshMaterial_t;
+		pMaterial->m_pTexture = pTexture;
+		pMaterial->m_nRenderMode = nRenderMode;
+		pMaterial->m_bWireframe = bWireframe;
+		pMaterial->m_nKey = ComputeKey( pTexture, nRenderMode, bWireframe );
+		AddMaterial( pMaterial );
+	}
+
+	pMaterial->m_nLastUsedPass = m_nPass;
+
+	m_nBatch++;
+	m_pBatchMaterial = pMaterial;
+	m_BatchChunks.RemoveAll();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Queues a face, first bringing its copy in the chunks up to date.
+// Output : Returns false if the face is too large for a chunk.
+//-----------------------------------------------------------------------------
+bool CFaceMeshCache::AddFace( CMapFace *pFace, const Color &color )
+{
+	int nPoints = pFace->GetPointCount();
+	if ( ( nPoints < 3 ) || ( nPoints > FACEMESH_CHUNK_MAX_VERTS ) || ( FaceMesh_IndexCount( nPoints, m_pBatchMaterial->m_bWireframe ) > FACEMESH_CHUNK_MAX_INDICES ) )
+		return false;
+
+	FaceMeshMaterial_t *pMaterial = m_pBatchMaterial;
+	unsigned int nRevision = pFace->GetRevision();
+	const unsigned char *pColor = (const unsigned char *)&color;
+
+	FaceMeshStaticChunk_t *pChunk = NULL;
+	int nSlot = -1;
+
+	UtlHashHandle_t h = pMaterial->m_Faces.Find( pFace );
+	if ( h != pMaterial->m_Faces.InvalidHandle() )
+	{
+		pChunk = pMaterial->m_Faces[h].m_pChunk;
+		nSlot = pMaterial->m_Faces[h].m_nSlot;
+
+		if ( !pChunk->m_Chunk.IsCurrent( nSlot, nRevision, pColor ) )
+		{
+			if ( pChunk->m_Chunk.GetSlot( nSlot ).m_nRevision == nRevision )
+			{
+				pChunk->m_Chunk.UpdateColor( nSlot, pColor );
+			}
+			else
+			{
+				FaceMeshFace_t face;
+				pFace->GetMeshFace( face, color );
+
+				if ( !pChunk->m_Chunk.UpdateFace( nSlot, nRevision, face ) )
+				{
+					// The point count changed, so the face moves to the end.
+					pChunk->m_Chunk.RemoveFace( nSlot );
+					pMaterial->m_Faces.Remove( pFace );
+					pChunk = NULL;
+				}
+			}
+		}
+	}
+
+	if ( pChunk == NULL )
+	{
+		FaceMeshFace_t face;
+		pFace->GetMeshFace( face, color );
+
+		pChunk = FindChunkWithRoom( pMaterial, nPoints );
+		nSlot = pChunk->m_Chunk.AddFace( pFace, nRevision, face );
+		Assert( nSlot >= 0 );
+
+		FaceMeshSlotRef_t ref;
+		ref.m_pChunk = pChunk;
+		ref.m_nSlot = nSlot;
+		pMaterial->m_Faces.Insert( pFace, ref );
+	}
+
+	pChunk->m_Chunk.QueueFace( nSlot, m_nBatch, m_nPass );
+
+	if ( pChunk->m_nQueuedBatch != m_nBatch )
+	{
+		pChunk->m_nQueuedBatch = m_nBatch;
+		m_BatchChunks.AddToTail( pChunk );
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the whole chunk into a new static mesh.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::UploadChunk( FaceMeshStaticChunk_t *pChunk )
+{
+	CMatRenderContextPtr pRenderContext( MaterialSystemInterface() );
+
+	if ( pChunk->m_pMesh )
+	{
+		pRenderContext->DestroyStaticMesh( pChunk->m_pMesh );
+		pChunk->m_pMesh = NULL;
+	}
+
+	const CFaceMeshChunk &chunk = pChunk->m_Chunk;
+
+	VertexFormat_t fmt = m_pBatchRenderMaterial->GetVertexFormat() & ~VERTEX_FORMAT_COMPRESSED;
+	pChunk->m_pMesh = pRenderContext->CreateStaticMesh( fmt, TEXTURE_GROUP_STATIC_VERTEX_BUFFER_WORLD, m_pBatchRenderMaterial );
+	pChunk->m_pMaterial = m_pBatchRenderMaterial;
+	if ( !pChunk->m_pMesh )
+		return;
+
+	CMeshBuilder meshBuilder;
+	meshBuilder.Begin( pChunk->m_pMesh, chunk.IsWireframe() ? MATERIAL_LINES : MATERIAL_TRIANGLES, chunk.GetVertexCount(), chunk.GetIndexCount() );
+
+	FaceMesh_CopyVertices( meshBuilder, chunk.GetVertices(), chunk.GetVertexCount() );
+
+	const unsigned short *pIndices = chunk.GetIndices();
+	for ( int i = 0; i < chunk.GetIndexCount(); i++ )
+	{
+		meshBuilder.FastIndex( pIndices[i] );
+	}
+
+	meshBuilder.End();
+
+	pChunk->m_Chunk.ClearDirty();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Draws the faces of a chunk that were queued in this batch,
+//			uploading the chunk first if any of its faces changed.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::DrawChunk( FaceMeshStaticChunk_t *pChunk )
+{
+	const CFaceMeshChunk &chunk = pChunk->m_Chunk;
+
+	m_Ranges.EnsureCount( chunk.GetSlotCount() );
+	int nRanges = chunk.GetDrawRanges( m_nBatch, m_Ranges.Base() );
+	if ( nRanges == 0 )
+		return;
+
+	if ( chunk.IsDirty() || ( pChunk->m_pMesh == NULL ) || ( pChunk->m_pMaterial != m_pBatchRenderMaterial ) )
+	{
+		UploadChunk( pChunk );
+	}
+
+	if ( pChunk->m_pMesh )
+	{
+		CPrimList *pLists = (CPrimList *)_alloca( nRanges * sizeof( CPrimList ) );
+		for ( int i = 0; i < nRanges; i++ )
+		{
+			pLists[i].m_FirstIndex = m_Ranges[i].m_nFirstIndex;
+			pLists[i].m_NumIndices = m_Ranges[i].m_nIndexCount;
+		}
+
+		pChunk->m_pMesh->Draw( pLists, nRanges );
+		return;
+	}
+
+	// Couldn't create the static mesh; draw this frame through the dynamic
+	// one and try again next time.
+	int nIndexCount = 0;
+	for ( int i = 0; i < nRanges; i++ )
+	{
+		nIndexCount += m_Ranges[i].m_nIndexCount;
+	}
+
+	CMatRenderContextPtr pRenderContext( MaterialSystemInterface() );
+	IMesh *pMesh = pRenderContext->GetDynamicMesh();
+
+	CMeshBuilder meshBuilder;
+	meshBuilder.Begin( pMesh, chunk.IsWireframe() ? MATERIAL_LINES : MATERIAL_TRIANGLES, chunk.GetVertexCount(), nIndexCount );
+
+	FaceMesh_CopyVertices( meshBuilder, chunk.GetVertices(), chunk.GetVertexCount() );
+
+	const unsigned short *pIndices = chunk.GetIndices();
+	for ( int i = 0; i < nRanges; i++ )
+	{
+		for ( int j = 0; j < m_Ranges[i].m_nIndexCount; j++ )
+		{
+			meshBuilder.FastIndex( pIndices[ m_Ranges[i].m_nFirstIndex + j ] );
+		}
+	}
+
+	meshBuilder.End();
+	pMesh->Draw();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Draws every chunk queued into since BeginBatch.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::EndBatch( void )
+{
+	for ( int i = 0; i < m_BatchChunks.Count(); i++ )
+	{
+		DrawChunk( m_BatchChunks[i] );
+	}
+
+	m_BatchChunks.RemoveAll();
+	m_pBatchMaterial = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees everything.
+//-----------------------------------------------------------------------------
+void CFaceMeshCache::Purge( void )
+{
+	FOR_EACH_HASHTABLE( m_Materials, h )
+	{
+		FaceMeshMaterial_t *pMaterial = m_Materials[h];
+		while ( pMaterial != NULL )
+		{
+			FaceMeshMaterial_t *pNext = pMaterial->m_pNext;
+			DestroyMaterial( pMaterial );
+			pMaterial = pNext;
+		}
+	}
+
+	m_Materials.Purge();
+	m_BatchChunks.Purge();
+	m_Ranges.Purge();
+	m_pBatchMaterial = NULL;
+	Assert( m_nChunkCount == 0 );
+}
@@ -0,0 +1,135 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent static meshes for brush faces. Every face drawn with a
+//			material and render mode is kept in one of a few bounded chunks
+//			belonging to that material. A chunk is rebuilt only when one of its
+//			faces changes, and each batch draws the faces queued into it as
+//			index runs of the chunk's static mesh.
+//
+//=============================================================================//
+
+#ifndef FACEMESHCACHE_H
+#define FACEMESHCACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "tier1/utlhashtable.h"
+#include "FaceMeshBuilder.h"
+#include "Color.h"
+
+class CMapFace;
+class IMesh;
+class IMaterial;
+class IEditorTexture;
+
+//
+// Faces that have not been drawn for this many render passes are dropped
+// from their chunks.
+//
+#define FACEMESH_EVICT_PASSES			128
+
+//
+// A chunk of a material and the static mesh it was last uploaded to.
+//
+struct FaceMeshStaticChunk_t
+{
+	explicit FaceMeshStaticChunk_t( bool bWireframe ) : m_Chunk( bWireframe ), m_pMesh( NULL ), m_pMaterial( NULL ), m_nQueuedBatch( 0 ) {}
+
+	CFaceMeshChunk m_Chunk;
+	IMesh *m_pMesh;
+	IMaterial *m_pMaterial;			// Material the mesh was created for.
+	unsigned int m_nQueuedBatch;	// Last batch a face was queued into this chunk.
+};
+
+//
+// Where a face is stored.
+//
+struct FaceMeshSlotRef_t
+{
+	FaceMeshStaticChunk_t *m_pChunk;
+	int m_nSlot;
+};
+
+//
+// Every cached face drawn with one material and render mode.
+//
+struct FaceMeshMaterial_t
+{
+	FaceMeshMaterial_t() : m_pTexture( NULL ), m_nRenderMode( 0 ), m_bWireframe( false ), m_nKey( 0 ), m_nLastUsedPass( 0 ), m_pNext( NULL ) {}
+
+	IEditorTexture *m_pTexture;
+	int m_nRenderMode;
+	bool m_bWireframe;
+	unsigned int m_nKey;
+	unsigned int m_nLastUsedPass;
+
+	CUtlVector<FaceMeshStaticChunk_t *> m_Chunks;
+	CUtlHashtable<CMapFace *, FaceMeshSlotRef_t> m_Faces;
+
+	FaceMeshMaterial_t *m_pNext;	// Next material with the same key.
+};
+
+class CFaceMeshCache
+{
+public:
+
+	CFaceMeshCache( void );
+	~CFaceMeshCache( void );
+
+	void SetEnabled( bool bEnabled );
+	inline bool IsEnabled( void ) const { return m_bEnabled; }
+
+	// Called once at the start of each RenderOpaqueFaces pass.
+	void BeginPass( void );
+
+	// Starts a batch of faces sharing a material and render mode. Returns false
+	// if the batch can't be cached; the caller should then use the dynamic path.
+	bool BeginBatch( IEditorTexture *pTexture, int nRenderMode, bool bWireframe );
+
+	// Queues a face into the batch, storing or updating it in its material's
+	// chunks. Returns false if the face can't be cached, in which case the
+	// caller draws it.
+	bool AddFace( CMapFace *pFace, const Color &color );
+
+	// Uploads the chunks whose faces changed and draws the queued faces.
+	void EndBatch( void );
+
+	void Purge( void );
+
+	int GetChunkCount( void ) const { return m_nChunkCount; }
+
+protected:
+
+	static unsigned int ComputeKey( IEditorTexture *pTexture, int nRenderMode, bool bWireframe );
+
+	FaceMeshMaterial_t *FindMaterial( IEditorTexture *pTexture, int nRenderMode, bool bWireframe );
+	void AddMaterial( FaceMeshMaterial_t *pMaterial );
+	void RemoveMaterial( FaceMeshMaterial_t *pMaterial );
+	void DestroyMaterial( FaceMeshMaterial_t *pMaterial );
+
+	FaceMeshStaticChunk_t *FindChunkWithRoom( FaceMeshMaterial_t *pMaterial, int nPoints );
+	void CompactChunk( FaceMeshMaterial_t *pMaterial, FaceMeshStaticChunk_t *pChunk );
+	void DestroyChunk( FaceMeshStaticChunk_t *pChunk );
+	void UploadChunk( FaceMeshStaticChunk_t *pChunk );
+	void DrawChunk( FaceMeshStaticChunk_t *pChunk );
+	void EvictUnusedFaces( void );
+
+	bool m_bEnabled;
+	unsigned int m_nPass;
+	unsigned int m_nBatch;
+	int m_nChunkCount;
+
+	// The batch being queued.
+	FaceMeshMaterial_t *m_pBatchMaterial;
+	IMaterial *m_pBatchRenderMaterial;
+	CUtlVector<FaceMeshStaticChunk_t *> m_BatchChunks;
+	CUtlVector<FaceMeshRange_t> m_Ranges;
+
+	CUtlHashtable<unsigned int, FaceMeshMaterial_t *> m_Materials;
+};
+
+extern CFaceMeshCache g_FaceMeshCache;
+
+#endif // FACEMESHCACHE_H
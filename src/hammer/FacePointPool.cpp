@@ -0,0 +1,15 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The face point pool for faces that aren't in a world. The pool
+//			itself is in FacePointPool.h.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "MapFace.h"
+#include "FacePointPool.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+CFacePointPool g_FacePointPool( CMapFace::OnPointsMoved );
@@ -0,0 +1,515 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Slab allocator for the point data of brush faces. A face's
+//			points, texture coordinates and lightmap coordinates live in one
+//			block, and blocks for the same point count are carved out of
+//			shared slabs, so building and carving solids doesn't go to the
+//			heap for every face.
+//
+//			Each world has its own pool, and faces that aren't in a world use
+//			g_FacePointPool. Pools are only used from the main thread, so
+//			they take no locks. Every block knows its pool and its owner, so
+//			a block can be freed without naming its pool, and Compact can
+//			move blocks out of partly used slabs, telling each owner where
+//			its data went.
+//
+//			Kept free of editor dependencies so it can be tested standalone:
+//
+//			g++ -O2 FacePointPool_test.cpp -o FacePointPool_test && ./FacePointPool_test
+//
+//=============================================================================//
+
+#ifndef FACEPOINTPOOL_H
+#define FACEPOINTPOOL_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Bytes of point data per face point: the point (a Vector), its texture
+// coordinates and its lightmap coordinates (a Vector2D each).
+//
+#define FACEPOINT_SIZE				( 7 * sizeof( float ) )
+
+//
+// Faces with more points than this get their block straight from the heap.
+//
+#define FACEPOINTPOOL_MAX_POINTS	64
+
+//
+// Slabs are at least this big, or 16 blocks for large point counts.
+//
+#define FACEPOINTPOOL_SLAB_SIZE		( 16 * 1024 )
+
+class CFacePointPool;
+
+//
+// Called when Compact or Adopt moves a block, with the owner given to Alloc
+// and the block's new data.
+//
+typedef void (*FacePointMoveFunc_t)( void *pOwner, void *pNewData );
+
+//
+// Counters for measuring a pool.
+//
+struct FacePointPoolStats_t
+{
+	int m_nBlocks;					// Blocks in use.
+	int m_nSlabs;					// Slabs held.
+	int m_nLargeBlocks;				// Blocks in use that came straight from the heap.
+	size_t m_nBytesReserved;		// Slabs plus large blocks.
+	int m_nHeapAllocs;				// Heap allocations made since the pool was created.
+	int m_nBlocksMoved;				// Blocks moved by Compact and Adopt.
+};
+
+//
+// Header of a slab; its blocks follow.
+//
+struct FacePointSlab_t
+{
+	FacePointSlab_t *m_pNext;
+	int m_nPoints;
+	int m_nUsed;					// Blocks in use.
+};
+
+//
+// Header of a block; the point data follows.
+//
+struct FacePointBlock_t
+{
+	CFacePointPool *m_pPool;
+	FacePointSlab_t *m_pSlab;		// NULL for blocks that came straight from the heap.
+	void *m_pOwner;					// NULL while the block is free.
+	int m_nPoints;
+};
+
+//
+// Headers are padded so the data that follows stays aligned.
+//
+#define FACEPOINTPOOL_ALIGN( n )	( ( (n) + 15 ) & ~(size_t)15 )
+#define FACEPOINT_SLAB_HEADER_SIZE	FACEPOINTPOOL_ALIGN( sizeof( FacePointSlab_t ) )
+#define FACEPOINT_BLOCK_HEADER_SIZE	FACEPOINTPOOL_ALIGN( sizeof( FacePointBlock_t ) )
+
+class CFacePointPool
+{
+public:
+
+	CFacePointPool( FacePointMoveFunc_t pfnMove );
+	~CFacePointPool( void );
+
+	// Returns a block with room for nPoints * FACEPOINT_SIZE bytes, owned by
+	// pOwner until it's freed.
+	void *Alloc( int nPoints, void *pOwner );
+
+	// Returns a block to the pool it came from.
+	static void Free( void *pData );
+
+	static CFacePointPool *GetPool( const void *pData );
+
+	// Moves a block from another pool into this one.
+	void Adopt( void *pData );
+
+	// Moves blocks out of the emptiest slabs into the fullest, then gives
+	// the emptied slabs back to the heap.
+	void Compact( void );
+
+	// For a pool whose owner is going away: the pool deletes itself as soon
+	// as none of its blocks are in use, which may be right away.
+	void Release( void );
+
+	void GetStats( FacePointPoolStats_t &Stats ) const;
+
+private:
+
+	struct SizeClass_t
+	{
+		FacePointSlab_t *m_pSlabs;
+		FacePointBlock_t *m_pFreeList;	// Free blocks, linked through their data.
+		int m_nSlabs;
+		int m_nUsed;
+		int m_nBlocksPerSlab;
+	};
+
+	static size_t BlockStride( int nPoints );
+	static FacePointBlock_t *GetBlock( const void *pData );
+	static void *GetData( FacePointBlock_t *pBlock );
+	static FacePointBlock_t *&NextFree( FacePointBlock_t *pBlock );
+	static FacePointBlock_t *GetSlabBlock( FacePointSlab_t *pSlab, int nBlock );
+	static int CompareSlabs( const void *pSlab1, const void *pSlab2 );
+
+	bool AddSlab( int nPoints );
+	void FreeBlock( FacePointBlock_t *pBlock );
+	void CompactClass( int nPoints );
+
+	SizeClass_t m_Classes[FACEPOINTPOOL_MAX_POINTS + 1];	// Indexed by point count.
+
+	FacePointMoveFunc_t m_pfnMove;
+
+	int m_nBlocks;
+	int m_nSlabs;
+	int m_nLargeBlocks;
+	size_t m_nBytesReserved;
+	int m_nHeapAllocs;
+	int m_nBlocksMoved;
+	bool m_bReleased;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the size of a block, header included, for a point count.
+//-----------------------------------------------------------------------------
+inline size_t CFacePointPool::BlockStride( int nPoints )
+{
+	return FACEPOINTPOOL_ALIGN( FACEPOINT_BLOCK_HEADER_SIZE + nPoints * FACEPOINT_SIZE );
+}
+
+inline FacePointBlock_t *CFacePointPool::GetBlock( const void *pData )
+{
+	return (FacePointBlock_t *)( (unsigned char *)pData - FACEPOINT_BLOCK_HEADER_SIZE );
+}
+
+inline void *CFacePointPool::GetData( FacePointBlock_t *pBlock )
+{
+	return (unsigned char *)pBlock + FACEPOINT_BLOCK_HEADER_SIZE;
+}
+
+inline FacePointBlock_t *&CFacePointPool::NextFree( FacePointBlock_t *pBlock )
+{
+	return *(FacePointBlock_t **)GetData( pBlock );
+}
+
+inline FacePointBlock_t *CFacePointPool::GetSlabBlock( FacePointSlab_t *pSlab, int nBlock )
+{
+	return (FacePointBlock_t *)( (unsigned char *)pSlab + FACEPOINT_SLAB_HEADER_SIZE + nBlock * BlockStride( pSlab->m_nPoints ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+// Input  : pfnMove - Tells owners where Compact and Adopt moved their blocks.
+//-----------------------------------------------------------------------------
+inline CFacePointPool::CFacePointPool( FacePointMoveFunc_t pfnMove )
+{
+	for ( int i = 0; i <= FACEPOINTPOOL_MAX_POINTS; i++ )
+	{
+		int nBlocksPerSlab = (int)( FACEPOINTPOOL_SLAB_SIZE / BlockStride( i ) );
+
+		m_Classes[i].m_pSlabs = NULL;
+		m_Classes[i].m_pFreeList = NULL;
+		m_Classes[i].m_nSlabs = 0;
+		m_Classes[i].m_nUsed = 0;
+		m_Classes[i].m_nBlocksPerSlab = ( nBlocksPerSlab > 16 ) ? nBlocksPerSlab : 16;
+	}
+
+	m_pfnMove = pfnMove;
+	m_nBlocks = 0;
+	m_nSlabs = 0;
+	m_nLargeBlocks = 0;
+	m_nBytesReserved = 0;
+	m_nHeapAllocs = 0;
+	m_nBlocksMoved = 0;
+	m_bReleased = false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor. Gives the slabs back only if no block is in use: the
+//			faces of g_FacePointPool can be freed by other globals after it
+//			is destroyed at exit, so their slabs are left for the process to
+//			release.
+//-----------------------------------------------------------------------------
+inline CFacePointPool::~CFacePointPool( void )
+{
+	if ( m_nBlocks != 0 )
+		return;
+
+	for ( int i = 1; i <= FACEPOINTPOOL_MAX_POINTS; i++ )
+	{
+		FacePointSlab_t *pSlab = m_Classes[i].m_pSlabs;
+		while ( pSlab )
+		{
+			FacePointSlab_t *pNext = pSlab->m_pNext;
+			free( pSlab );
+			pSlab = pNext;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a slab to a point count's class and puts its blocks on the
+//			free list.
+//-----------------------------------------------------------------------------
+inline bool CFacePointPool::AddSlab( int nPoints )
+{
+	SizeClass_t &Class = m_Classes[nPoints];
+	size_t nSize = FACEPOINT_SLAB_HEADER_SIZE + BlockStride( nPoints ) * Class.m_nBlocksPerSlab;
+
+	FacePointSlab_t *pSlab = (FacePointSlab_t *)malloc( nSize );
+	if ( !pSlab )
+		return false;
+
+	pSlab->m_nPoints = nPoints;
+	pSlab->m_nUsed = 0;
+	pSlab->m_pNext = Class.m_pSlabs;
+	Class.m_pSlabs = pSlab;
+	Class.m_nSlabs++;
+
+	// Chain the blocks in address order.
+	for ( int i = Class.m_nBlocksPerSlab - 1; i >= 0; i-- )
+	{
+		FacePointBlock_t *pBlock = GetSlabBlock( pSlab, i );
+		pBlock->m_pPool = this;
+		pBlock->m_pSlab = pSlab;
+		pBlock->m_pOwner = NULL;
+		pBlock->m_nPoints = nPoints;
+
+		NextFree( pBlock ) = Class.m_pFreeList;
+		Class.m_pFreeList = pBlock;
+	}
+
+	m_nSlabs++;
+	m_nBytesReserved += nSize;
+	m_nHeapAllocs++;
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a block for a face's points, texture coordinates and
+//			lightmap coordinates, in that order.
+// Input  : nPoints - Number of face points; must be positive.
+//			pOwner - Passed to the move function if the block is moved.
+//-----------------------------------------------------------------------------
+inline void *CFacePointPool::Alloc( int nPoints, void *pOwner )
+{
+	FacePointBlock_t *pBlock;
+	if ( nPoints > FACEPOINTPOOL_MAX_POINTS )
+	{
+		pBlock = (FacePointBlock_t *)malloc( BlockStride( nPoints ) );
+		if ( !pBlock )
+			return NULL;
+
+		pBlock->m_pPool = this;
+		pBlock->m_pSlab = NULL;
+		pBlock->m_nPoints = nPoints;
+
+		m_nLargeBlocks++;
+		m_nBytesReserved += BlockStride( nPoints );
+		m_nHeapAllocs++;
+	}
+	else
+	{
+		SizeClass_t &Class = m_Classes[nPoints];
+		if ( !Class.m_pFreeList && !AddSlab( nPoints ) )
+			return NULL;
+
+		pBlock = Class.m_pFreeList;
+		Class.m_pFreeList = NextFree( pBlock );
+		pBlock->m_pSlab->m_nUsed++;
+		Class.m_nUsed++;
+	}
+
+	pBlock->m_pOwner = pOwner;
+	m_nBlocks++;
+	return GetData( pBlock );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a block to its slab, or a large block to the heap.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::FreeBlock( FacePointBlock_t *pBlock )
+{
+	m_nBlocks--;
+
+	if ( !pBlock->m_pSlab )
+	{
+		m_nLargeBlocks--;
+		m_nBytesReserved -= BlockStride( pBlock->m_nPoints );
+		free( pBlock );
+		return;
+	}
+
+	SizeClass_t &Class = m_Classes[pBlock->m_nPoints];
+	pBlock->m_pSlab->m_nUsed--;
+	Class.m_nUsed--;
+
+	pBlock->m_pOwner = NULL;
+	NextFree( pBlock ) = Class.m_pFreeList;
+	Class.m_pFreeList = pBlock;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a block to the pool it came from, deleting a released
+//			pool once its last block is freed.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::Free( void *pData )
+{
+	if ( !pData )
+		return;
+
+	CFacePointPool *pPool = GetPool( pData );
+	pPool->FreeBlock( GetBlock( pData ) );
+
+	if ( pPool->m_bReleased && ( pPool->m_nBlocks == 0 ) )
+	{
+		delete pPool;
+	}
+}
+
+inline CFacePointPool *CFacePointPool::GetPool( const void *pData )
+{
+	return GetBlock( pData )->m_pPool;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Copies a block from another pool into this one, frees the old
+//			block and tells the owner where its data went.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::Adopt( void *pData )
+{
+	if ( !pData || ( GetPool( pData ) == this ) )
+		return;
+
+	FacePointBlock_t *pBlock = GetBlock( pData );
+	void *pOwner = pBlock->m_pOwner;
+
+	void *pNewData = Alloc( pBlock->m_nPoints, pOwner );
+	if ( !pNewData )
+		return;
+
+	memcpy( pNewData, pData, pBlock->m_nPoints * FACEPOINT_SIZE );
+	Free( pData );
+
+	m_nBlocksMoved++;
+	m_pfnMove( pOwner, pNewData );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Orders slabs fullest first.
+//-----------------------------------------------------------------------------
+inline int CFacePointPool::CompareSlabs( const void *pSlab1, const void *pSlab2 )
+{
+	int nUsed1 = ( *(FacePointSlab_t * const *)pSlab1 )->m_nUsed;
+	int nUsed2 = ( *(FacePointSlab_t * const *)pSlab2 )->m_nUsed;
+	return ( nUsed1 > nUsed2 ) ? -1 : ( nUsed1 < nUsed2 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Packs one point count's blocks into as few slabs as will hold
+//			them. The fullest slabs are kept; blocks in use in the others are
+//			copied into the kept slabs' free blocks, and the others are freed.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::CompactClass( int nPoints )
+{
+	SizeClass_t &Class = m_Classes[nPoints];
+
+	int nKeep = ( Class.m_nUsed + Class.m_nBlocksPerSlab - 1 ) / Class.m_nBlocksPerSlab;
+	if ( nKeep == Class.m_nSlabs )
+		return;
+
+	FacePointSlab_t **ppSlabs = (FacePointSlab_t **)malloc( Class.m_nSlabs * sizeof( FacePointSlab_t * ) );
+	if ( !ppSlabs )
+		return;
+
+	int nSlabs = 0;
+	for ( FacePointSlab_t *pSlab = Class.m_pSlabs; pSlab; pSlab = pSlab->m_pNext )
+	{
+		ppSlabs[nSlabs++] = pSlab;
+	}
+	qsort( ppSlabs, nSlabs, sizeof( FacePointSlab_t * ), CompareSlabs );
+
+	// Relink the kept slabs, and their free blocks in address order.
+	Class.m_pSlabs = NULL;
+	Class.m_pFreeList = NULL;
+	for ( int i = nKeep - 1; i >= 0; i-- )
+	{
+		FacePointSlab_t *pSlab = ppSlabs[i];
+		pSlab->m_pNext = Class.m_pSlabs;
+		Class.m_pSlabs = pSlab;
+
+		for ( int j = Class.m_nBlocksPerSlab - 1; j >= 0; j-- )
+		{
+			FacePointBlock_t *pBlock = GetSlabBlock( pSlab, j );
+			if ( !pBlock->m_pOwner )
+			{
+				NextFree( pBlock ) = Class.m_pFreeList;
+				Class.m_pFreeList = pBlock;
+			}
+		}
+	}
+
+	// Move the blocks in use out of the rest; the kept slabs have room for
+	// all of them.
+	size_t nSlabSize = FACEPOINT_SLAB_HEADER_SIZE + BlockStride( nPoints ) * Class.m_nBlocksPerSlab;
+	for ( int i = nKeep; i < nSlabs; i++ )
+	{
+		FacePointSlab_t *pSlab = ppSlabs[i];
+		for ( int j = 0; ( j < Class.m_nBlocksPerSlab ) && ( pSlab->m_nUsed > 0 ); j++ )
+		{
+			FacePointBlock_t *pBlock = GetSlabBlock( pSlab, j );
+			if ( !pBlock->m_pOwner )
+				continue;
+
+			FacePointBlock_t *pNewBlock = Class.m_pFreeList;
+			Class.m_pFreeList = NextFree( pNewBlock );
+
+			pNewBlock->m_pOwner = pBlock->m_pOwner;
+			pNewBlock->m_pSlab->m_nUsed++;
+			pSlab->m_nUsed--;
+			memcpy( GetData( pNewBlock ), GetData( pBlock ), nPoints * FACEPOINT_SIZE );
+
+			m_nBlocksMoved++;
+			m_pfnMove( pNewBlock->m_pOwner, GetData( pNewBlock ) );
+		}
+
+		free( pSlab );
+		m_nSlabs--;
+		m_nBytesReserved -= nSlabSize;
+	}
+
+	Class.m_nSlabs = nKeep;
+	free( ppSlabs );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Packs every point count's blocks into as few slabs as will hold
+//			them and frees the rest. Runs in time linear in the number of
+//			blocks in the pool.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::Compact( void )
+{
+	for ( int i = 1; i <= FACEPOINTPOOL_MAX_POINTS; i++ )
+	{
+		CompactClass( i );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Deletes the pool now if no blocks are in use, or else when the
+//			last one is freed.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::Release( void )
+{
+	m_bReleased = true;
+	if ( m_nBlocks == 0 )
+	{
+		delete this;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the pool's counters.
+//-----------------------------------------------------------------------------
+inline void CFacePointPool::GetStats( FacePointPoolStats_t &Stats ) const
+{
+	Stats.m_nBlocks = m_nBlocks;
+	Stats.m_nSlabs = m_nSlabs;
+	Stats.m_nLargeBlocks = m_nLargeBlocks;
+	Stats.m_nBytesReserved = m_nBytesReserved;
+	Stats.m_nHeapAllocs = m_nHeapAllocs;
+	Stats.m_nBlocksMoved = m_nBlocksMoved;
+}
+
+extern CFacePointPool g_FacePointPool;
+
+#endif // FACEPOINTPOOL_H
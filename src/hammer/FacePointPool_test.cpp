@@ -0,0 +1,406 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test and benchmark of the face point pool. Checks that
+//			blocks keep their data and owners through Compact and Adopt, that
+//			Compact packs partly used slabs, and that a released pool goes
+//			once its last block is freed. Then compares the heap allocations
+//			and time of building and churning a million faces against the
+//			three new[] arrays per face that CMapFace used before:
+//
+//			g++ -O2 FacePointPool_test.cpp -o FacePointPool_test && ./FacePointPool_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include "FacePointPool.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+//
+// Stands in for CMapFace: owns one block and is told when it moves.
+//
+struct TestFace_t
+{
+	float *m_pData;
+	int m_nPoints;
+	int m_nTag;
+};
+
+static void OnTestPointsMoved( void *pOwner, void *pNewData )
+{
+	( (TestFace_t *)pOwner )->m_pData = (float *)pNewData;
+}
+
+static void FillFace( TestFace_t &Face, int nTag )
+{
+	Face.m_nTag = nTag;
+	for ( int i = 0; i < Face.m_nPoints * 7; i++ )
+	{
+		Face.m_pData[i] = (float)( nTag * 31 + i );
+	}
+}
+
+static bool CheckFace( const TestFace_t &Face )
+{
+	for ( int i = 0; i < Face.m_nPoints * 7; i++ )
+	{
+		if ( Face.m_pData[i] != (float)( Face.m_nTag * 31 + i ) )
+			return false;
+	}
+	return true;
+}
+
+static void AllocFace( CFacePointPool &Pool, TestFace_t &Face, int nPoints, int nTag )
+{
+	Face.m_nPoints = nPoints;
+	Face.m_pData = (float *)Pool.Alloc( nPoints, &Face );
+	FillFace( Face, nTag );
+}
+
+static void FreeFace( TestFace_t &Face )
+{
+	CFacePointPool::Free( Face.m_pData );
+	Face.m_pData = NULL;
+}
+
+static int RandomPointCount( void )
+{
+	// mostly quads, some larger faces, and now and then one too big for a slab
+	int nRoll = RandomInt( 0, 99 );
+	if ( nRoll < 70 )
+		return 4;
+	if ( nRoll < 99 )
+		return RandomInt( 3, 12 );
+	return RandomInt( FACEPOINTPOOL_MAX_POINTS + 1, FACEPOINTPOOL_MAX_POINTS + 40 );
+}
+
+//-----------------------------------------------------------------------------
+// Random allocs and frees, then Compact: every face keeps its data, and each
+// point count ends up in as few slabs as will hold its blocks.
+//-----------------------------------------------------------------------------
+static void TestCompact( void )
+{
+	CFacePointPool Pool( OnTestPointsMoved );
+
+	std::vector<TestFace_t> Faces( 20000 );
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		AllocFace( Pool, Faces[i], RandomPointCount(), (int)i );
+	}
+
+	// free most of them, leaving every slab partly used
+	int nLive = 0;
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		if ( RandomInt( 0, 9 ) < 8 )
+		{
+			FreeFace( Faces[i] );
+		}
+		else
+		{
+			nLive++;
+		}
+	}
+
+	FacePointPoolStats_t Before;
+	Pool.GetStats( Before );
+	CHECK( Before.m_nBlocks == nLive );
+
+	Pool.Compact();
+
+	FacePointPoolStats_t After;
+	Pool.GetStats( After );
+	CHECK( After.m_nBlocks == nLive );
+	CHECK( After.m_nSlabs < Before.m_nSlabs );
+	CHECK( After.m_nBytesReserved < Before.m_nBytesReserved );
+	CHECK( After.m_nBlocksMoved > 0 );
+
+	// count the blocks each slab class needs
+	int nUsed[FACEPOINTPOOL_MAX_POINTS + 1] = { 0 };
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		if ( !Faces[i].m_pData )
+			continue;
+
+		CHECK( CheckFace( Faces[i] ) );
+		CHECK( CFacePointPool::GetPool( Faces[i].m_pData ) == &Pool );
+		if ( Faces[i].m_nPoints <= FACEPOINTPOOL_MAX_POINTS )
+		{
+			nUsed[Faces[i].m_nPoints]++;
+		}
+	}
+
+	int nExpectedSlabs = 0;
+	size_t nExpectedBytes = 0;
+	for ( int nPoints = 1; nPoints <= FACEPOINTPOOL_MAX_POINTS; nPoints++ )
+	{
+		size_t nStride = FACEPOINTPOOL_ALIGN( FACEPOINT_BLOCK_HEADER_SIZE + nPoints * FACEPOINT_SIZE );
+		int nPerSlab = (int)( FACEPOINTPOOL_SLAB_SIZE / nStride );
+		nPerSlab = ( nPerSlab > 16 ) ? nPerSlab : 16;
+
+		int nSlabs = ( nUsed[nPoints] + nPerSlab - 1 ) / nPerSlab;
+		nExpectedSlabs += nSlabs;
+		nExpectedBytes += nSlabs * ( FACEPOINT_SLAB_HEADER_SIZE + nStride * nPerSlab );
+	}
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		if ( Faces[i].m_pData && Faces[i].m_nPoints > FACEPOINTPOOL_MAX_POINTS )
+		{
+			nExpectedBytes += FACEPOINTPOOL_ALIGN( FACEPOINT_BLOCK_HEADER_SIZE + Faces[i].m_nPoints * FACEPOINT_SIZE );
+		}
+	}
+	CHECK( After.m_nSlabs == nExpectedSlabs );
+	CHECK( After.m_nBytesReserved == nExpectedBytes );
+
+	// the packed pool still hands out and takes back blocks
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		if ( !Faces[i].m_pData )
+		{
+			AllocFace( Pool, Faces[i], RandomPointCount(), (int)i + 100000 );
+		}
+	}
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		CHECK( CheckFace( Faces[i] ) );
+		FreeFace( Faces[i] );
+	}
+
+	Pool.Compact();
+	Pool.GetStats( After );
+	CHECK( After.m_nBlocks == 0 );
+	CHECK( After.m_nSlabs == 0 );
+	CHECK( After.m_nBytesReserved == 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Faces built outside a world move into its pool, and the world's pool,
+// released with the world, lasts until the last of its faces is freed.
+//-----------------------------------------------------------------------------
+static void TestAdoptAndRelease( void )
+{
+	CFacePointPool Detached( OnTestPointsMoved );
+	CFacePointPool *pWorldPool = new CFacePointPool( OnTestPointsMoved );
+
+	std::vector<TestFace_t> Faces( 1000 );
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		AllocFace( Detached, Faces[i], RandomPointCount(), (int)i );
+	}
+
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		pWorldPool->Adopt( Faces[i].m_pData );
+		CHECK( CFacePointPool::GetPool( Faces[i].m_pData ) == pWorldPool );
+		CHECK( CheckFace( Faces[i] ) );
+
+		// adopting a block already in the pool leaves it be
+		float *pData = Faces[i].m_pData;
+		pWorldPool->Adopt( pData );
+		CHECK( Faces[i].m_pData == pData );
+	}
+
+	FacePointPoolStats_t Stats;
+	Detached.GetStats( Stats );
+	CHECK( Stats.m_nBlocks == 0 );
+	pWorldPool->GetStats( Stats );
+	CHECK( Stats.m_nBlocks == (int)Faces.size() );
+	CHECK( Stats.m_nBlocksMoved == (int)Faces.size() );
+
+	// the world goes; the faces, as if kept for undo, still work and are
+	// freed later, the last of them taking the pool with it
+	pWorldPool->Release();
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		CHECK( CheckFace( Faces[i] ) );
+		FreeFace( Faces[i] );
+	}
+
+	// a released pool with nothing in use goes right away
+	CFacePointPool *pEmptyPool = new CFacePointPool( OnTestPointsMoved );
+	pEmptyPool->Release();
+}
+
+//-----------------------------------------------------------------------------
+// The old CMapFace::AllocatePoints: three arrays per face.
+//-----------------------------------------------------------------------------
+static long long s_nOldHeapAllocs = 0;
+
+struct OldFace_t
+{
+	float *m_pPoints;
+	float *m_pTextureCoords;
+	float *m_pLightmapCoords;
+};
+
+static void OldAlloc( OldFace_t &Face, int nPoints )
+{
+	Face.m_pPoints = new float[nPoints * 3];
+	Face.m_pTextureCoords = new float[nPoints * 2];
+	Face.m_pLightmapCoords = new float[nPoints * 2];
+	s_nOldHeapAllocs += 3;
+
+	for ( int i = 0; i < nPoints * 3; i++ )
+	{
+		Face.m_pPoints[i] = (float)i;
+	}
+	for ( int i = 0; i < nPoints * 2; i++ )
+	{
+		Face.m_pTextureCoords[i] = Face.m_pLightmapCoords[i] = (float)i;
+	}
+}
+
+static void OldFree( OldFace_t &Face )
+{
+	delete [] Face.m_pPoints;
+	delete [] Face.m_pTextureCoords;
+	delete [] Face.m_pLightmapCoords;
+}
+
+static void NewAlloc( CFacePointPool &Pool, TestFace_t &Face, int nPoints )
+{
+	Face.m_nPoints = nPoints;
+	Face.m_pData = (float *)Pool.Alloc( nPoints, &Face );
+	for ( int i = 0; i < nPoints * 7; i++ )
+	{
+		Face.m_pData[i] = (float)i;
+	}
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+//-----------------------------------------------------------------------------
+// A million faces loaded, a million rebuilt one at a time as carving and
+// clipping do, then packed after half are deleted, as on save.
+//-----------------------------------------------------------------------------
+static void Benchmark( void )
+{
+	const int nFaces = 1000000;
+
+	std::vector<int> PointCounts( nFaces * 2 );
+	std::vector<int> Victims( nFaces );
+	for ( size_t i = 0; i < PointCounts.size(); i++ )
+	{
+		PointCounts[i] = RandomPointCount();
+	}
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		Victims[i] = RandomInt( 0, nFaces - 1 );
+	}
+
+	std::chrono::steady_clock::time_point Start;
+
+	// before
+	std::vector<OldFace_t> OldFaces( nFaces );
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		OldAlloc( OldFaces[i], PointCounts[i] );
+	}
+	double flOldLoad = MS( Start );
+	long long nOldLoadAllocs = s_nOldHeapAllocs;
+
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		OldFree( OldFaces[Victims[i]] );
+		OldAlloc( OldFaces[Victims[i]], PointCounts[nFaces + i] );
+	}
+	double flOldChurn = MS( Start );
+	long long nOldChurnAllocs = s_nOldHeapAllocs - nOldLoadAllocs;
+
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		OldFree( OldFaces[i] );
+	}
+	double flOldFree = MS( Start );
+
+	// after
+	CFacePointPool *pPool = new CFacePointPool( OnTestPointsMoved );
+	std::vector<TestFace_t> NewFaces( nFaces );
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		NewAlloc( *pPool, NewFaces[i], PointCounts[i] );
+	}
+	double flNewLoad = MS( Start );
+
+	FacePointPoolStats_t Stats;
+	pPool->GetStats( Stats );
+	int nNewLoadAllocs = Stats.m_nHeapAllocs;
+
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		CFacePointPool::Free( NewFaces[Victims[i]].m_pData );
+		NewAlloc( *pPool, NewFaces[Victims[i]], PointCounts[nFaces + i] );
+	}
+	double flNewChurn = MS( Start );
+	pPool->GetStats( Stats );
+	int nNewChurnAllocs = Stats.m_nHeapAllocs - nNewLoadAllocs;
+
+	// delete every other face, then pack
+	for ( int i = 0; i < nFaces; i += 2 )
+	{
+		CFacePointPool::Free( NewFaces[i].m_pData );
+		NewFaces[i].m_pData = NULL;
+	}
+	FacePointPoolStats_t Before;
+	pPool->GetStats( Before );
+	Start = std::chrono::steady_clock::now();
+	pPool->Compact();
+	double flCompact = MS( Start );
+	FacePointPoolStats_t After;
+	pPool->GetStats( After );
+
+	Start = std::chrono::steady_clock::now();
+	pPool->Release();
+	for ( int i = 1; i < nFaces; i += 2 )
+	{
+		CFacePointPool::Free( NewFaces[i].m_pData );
+	}
+	double flNewFree = MS( Start );
+
+	printf( "1M faces (70%% quads)        heap allocs          ms\n" );
+	printf( "load,  3 new[] per face   %12lld %11.1f\n", nOldLoadAllocs, flOldLoad );
+	printf( "load,  pool               %12d %11.1f\n", nNewLoadAllocs, flNewLoad );
+	printf( "churn, 3 new[] per face   %12lld %11.1f\n", nOldChurnAllocs, flOldChurn );
+	printf( "churn, pool               %12d %11.1f\n", nNewChurnAllocs, flNewChurn );
+	printf( "free,  3 new[] per face   %12s %11.1f\n", "", flOldFree );
+	printf( "free,  pool (half freed)  %12s %11.1f\n", "", flNewFree );
+	printf( "compact after deleting half: %d -> %d slabs, %.1f -> %.1f MB, %d blocks moved, %.1f ms\n",
+		Before.m_nSlabs, After.m_nSlabs, Before.m_nBytesReserved / 1048576.0, After.m_nBytesReserved / 1048576.0,
+		After.m_nBlocksMoved - Before.m_nBlocksMoved, flCompact );
+}
+
+int main( void )
+{
+	TestCompact();
+	TestAdoptAndRelease();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All face point pool tests passed\n" );
+	Benchmark();
+	return 0;
+}
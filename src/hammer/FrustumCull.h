@@ -0,0 +1,277 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Batched frustum culling of axis-aligned boxes. Boxes are stored
+//			in SoA form so that four of them are tested against each plane
+//			at once with SSE ops. The one-box test that CRender3D::IsBoxVisible
+//			uses lives here too, so the two can be checked against each other
+//			standalone:
+//
+//			g++ -O2 FrustumCull_test.cpp -o FrustumCull_test && ./FrustumCull_test
+//
+//=============================================================================//
+
+#ifndef FRUSTUMCULL_H
+#define FRUSTUMCULL_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdlib.h>
+#include <new>
+#include <xmmintrin.h>
+
+//
+// Number of boxes in one batch. Must be a multiple of four and no greater
+// than the number of bits in the result masks.
+//
+#define FRUSTUMCULL_BATCH_SIZE		64
+#define FRUSTUMCULL_BATCH_BLOCKS	( FRUSTUMCULL_BATCH_SIZE / 4 )
+
+enum FrustumCullResult_t
+{
+	FRUSTUMCULL_OUTSIDE = 0,		// Entirely outside at least one plane.
+	FRUSTUMCULL_PARTIAL,			// Crosses at least one plane.
+	FRUSTUMCULL_INSIDE				// Inside every plane.
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Tests one box against a set of planes. A box is outside a plane if
+//			the dot product of its nearest corner with the plane normal is >=
+//			the plane distance.
+// Input  : pPlanes - nPlanes planes of four floats: the outward facing normal,
+//				then the distance.
+//			pMins, pMaxs - The box's corners, three floats each.
+//-----------------------------------------------------------------------------
+inline FrustumCullResult_t FrustumCull_TestBox( const float *pPlanes, int nPlanes, const float *pMins, const float *pMaxs )
+{
+	int nInPlanes = 0;
+	for ( int i = 0; i < nPlanes; i++ )
+	{
+		const float *pPlane = pPlanes + i * 4;
+
+		//
+		// Build the near and far vertices based on the octant of the plane normal.
+		//
+		float NearVertex[3];
+		float FarVertex[3];
+		for ( int j = 0; j < 3; j++ )
+		{
+			NearVertex[j] = ( pPlane[j] > 0 ) ? pMins[j] : pMaxs[j];
+			FarVertex[j] = ( pPlane[j] > 0 ) ? pMaxs[j] : pMins[j];
+		}
+
+		if ( pPlane[0] * NearVertex[0] + pPlane[1] * NearVertex[1] + pPlane[2] * NearVertex[2] >= pPlane[3] )
+			return FRUSTUMCULL_OUTSIDE;
+
+		if ( pPlane[0] * FarVertex[0] + pPlane[1] * FarVertex[1] + pPlane[2] * FarVertex[2] < pPlane[3] )
+		{
+			nInPlanes++;
+		}
+	}
+
+	return ( nInPlanes == nPlanes ) ? FRUSTUMCULL_INSIDE : FRUSTUMCULL_PARTIAL;
+}
+
+class CFrustumCullBatch
+{
+public:
+
+	CFrustumCullBatch( void ) : m_nCount( 0 ) {}
+
+	inline void Reset( void ) { m_nCount = 0; }
+	inline int Count( void ) const { return m_nCount; }
+	inline bool IsFull( void ) const { return m_nCount == FRUSTUMCULL_BATCH_SIZE; }
+
+	// Adds a box, and optionally what it bounds. Returns the box's index,
+	// which is also its bit in the masks returned by Test.
+	int AddBox( const float *pMins, const float *pMaxs, void *pObject = NULL );
+	void GetBox( int nIndex, float *pMins, float *pMaxs ) const;
+	inline void *GetBoxObject( int nIndex ) const { return m_pObjects[nIndex]; }
+
+	// Tests every box against the given planes, as FrustumCull_TestBox does.
+	// Bit i of nVisibleMask is set if box i is at least partially inside, and
+	// bit i of nTotalMask if it is inside.
+	void Test( const float *pPlanes, int nPlanes, unsigned long long &nVisibleMask, unsigned long long &nTotalMask ) const;
+
+private:
+
+	static inline float &Lane( __m128 &Block, int nLane ) { return ( (float *)&Block )[nLane]; }
+	static inline float Lane( const __m128 &Block, int nLane ) { return ( (const float *)&Block )[nLane]; }
+
+	__m128 m_MinX[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 m_MinY[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 m_MinZ[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 m_MaxX[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 m_MaxY[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 m_MaxZ[FRUSTUMCULL_BATCH_BLOCKS];
+	void *m_pObjects[FRUSTUMCULL_BATCH_SIZE];
+
+	int m_nCount;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a box to the batch.
+//-----------------------------------------------------------------------------
+inline int CFrustumCullBatch::AddBox( const float *pMins, const float *pMaxs, void *pObject )
+{
+	int nIndex = m_nCount++;
+	int nBlock = nIndex >> 2;
+	int nLane = nIndex & 3;
+
+	Lane( m_MinX[nBlock], nLane ) = pMins[0];
+	Lane( m_MinY[nBlock], nLane ) = pMins[1];
+	Lane( m_MinZ[nBlock], nLane ) = pMins[2];
+	Lane( m_MaxX[nBlock], nLane ) = pMaxs[0];
+	Lane( m_MaxY[nBlock], nLane ) = pMaxs[1];
+	Lane( m_MaxZ[nBlock], nLane ) = pMaxs[2];
+	m_pObjects[nIndex] = pObject;
+
+	return nIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a box that was previously added to the batch.
+//-----------------------------------------------------------------------------
+inline void CFrustumCullBatch::GetBox( int nIndex, float *pMins, float *pMaxs ) const
+{
+	int nBlock = nIndex >> 2;
+	int nLane = nIndex & 3;
+
+	pMins[0] = Lane( m_MinX[nBlock], nLane );
+	pMins[1] = Lane( m_MinY[nBlock], nLane );
+	pMins[2] = Lane( m_MinZ[nBlock], nLane );
+	pMaxs[0] = Lane( m_MaxX[nBlock], nLane );
+	pMaxs[1] = Lane( m_MaxY[nBlock], nLane );
+	pMaxs[2] = Lane( m_MaxZ[nBlock], nLane );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Tests all boxes in the batch against a set of planes.
+// Input  : pPlanes - nPlanes planes of four floats: the outward facing normal,
+//				then the distance.
+// Output : nVisibleMask - Bit set for each box that is at least partially inside.
+//			nTotalMask - Bit set for each box that is entirely inside.
+//-----------------------------------------------------------------------------
+inline void CFrustumCullBatch::Test( const float *pPlanes, int nPlanes, unsigned long long &nVisibleMask, unsigned long long &nTotalMask ) const
+{
+	nVisibleMask = 0;
+	nTotalMask = 0;
+
+	int nBlocks = ( m_nCount + 3 ) >> 2;
+	if ( nBlocks == 0 )
+	{
+		return;
+	}
+
+	__m128 Outside[FRUSTUMCULL_BATCH_BLOCKS];
+	__m128 Crossing[FRUSTUMCULL_BATCH_BLOCKS];
+	for ( int nBlock = 0; nBlock < nBlocks; nBlock++ )
+	{
+		Outside[nBlock] = _mm_setzero_ps();
+		Crossing[nBlock] = _mm_setzero_ps();
+	}
+
+	for ( int i = 0; i < nPlanes; i++ )
+	{
+		const float *pPlane = pPlanes + i * 4;
+
+		//
+		// The near and far corners only depend on the signs of the plane normal,
+		// so pick the source arrays once per plane rather than once per box.
+		//
+		const __m128 *pNearX = ( pPlane[0] > 0 ) ? m_MinX : m_MaxX;
+		const __m128 *pFarX = ( pPlane[0] > 0 ) ? m_MaxX : m_MinX;
+		const __m128 *pNearY = ( pPlane[1] > 0 ) ? m_MinY : m_MaxY;
+		const __m128 *pFarY = ( pPlane[1] > 0 ) ? m_MaxY : m_MinY;
+		const __m128 *pNearZ = ( pPlane[2] > 0 ) ? m_MinZ : m_MaxZ;
+		const __m128 *pFarZ = ( pPlane[2] > 0 ) ? m_MaxZ : m_MinZ;
+
+		__m128 NormalX = _mm_set1_ps( pPlane[0] );
+		__m128 NormalY = _mm_set1_ps( pPlane[1] );
+		__m128 NormalZ = _mm_set1_ps( pPlane[2] );
+		__m128 Dist = _mm_set1_ps( pPlane[3] );
+
+		for ( int nBlock = 0; nBlock < nBlocks; nBlock++ )
+		{
+			// Same summation order as FrustumCull_TestBox so results match.
+			__m128 NearDot = _mm_add_ps( _mm_add_ps( _mm_mul_ps( NormalX, pNearX[nBlock] ), _mm_mul_ps( NormalY, pNearY[nBlock] ) ), _mm_mul_ps( NormalZ, pNearZ[nBlock] ) );
+			__m128 FarDot = _mm_add_ps( _mm_add_ps( _mm_mul_ps( NormalX, pFarX[nBlock] ), _mm_mul_ps( NormalY, pFarY[nBlock] ) ), _mm_mul_ps( NormalZ, pFarZ[nBlock] ) );
+
+			Outside[nBlock] = _mm_or_ps( Outside[nBlock], _mm_cmpge_ps( NearDot, Dist ) );
+			Crossing[nBlock] = _mm_or_ps( Crossing[nBlock], _mm_cmpge_ps( FarDot, Dist ) );
+		}
+	}
+
+	for ( int nBlock = 0; nBlock < nBlocks; nBlock++ )
+	{
+		unsigned long long nOutside = (unsigned long long)_mm_movemask_ps( Outside[nBlock] );
+		unsigned long long nCrossing = (unsigned long long)_mm_movemask_ps( Crossing[nBlock] );
+
+		nVisibleMask |= ( ~nOutside & 0xf ) << ( nBlock * 4 );
+		nTotalMask |= ( ~( nOutside | nCrossing ) & 0xf ) << ( nBlock * 4 );
+	}
+
+	// Drop the unused lanes of the last block.
+	if ( m_nCount < FRUSTUMCULL_BATCH_SIZE )
+	{
+		unsigned long long nValidMask = ( 1ull << m_nCount ) - 1;
+		nVisibleMask &= nValidMask;
+		nTotalMask &= nValidMask;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Batches for culling while recursing, one per level, kept off the stack.
+// Each level's batch stays in place while deeper levels use theirs.
+//-----------------------------------------------------------------------------
+class CFrustumCullBatchStack
+{
+public:
+
+	CFrustumCullBatchStack( void ) : m_ppBatches( NULL ), m_nAllocated( 0 ), m_nDepth( 0 ) {}
+
+	~CFrustumCullBatchStack( void )
+	{
+		for ( int i = 0; i < m_nAllocated; i++ )
+		{
+			_mm_free( m_ppBatches[i] );
+		}
+		free( m_ppBatches );
+	}
+
+	// Returns an empty batch for the next level down, or NULL if out of memory.
+	CFrustumCullBatch *Push( void )
+	{
+		if ( m_nDepth == m_nAllocated )
+		{
+			CFrustumCullBatch **ppBatches = (CFrustumCullBatch **)realloc( m_ppBatches, ( m_nAllocated + 1 ) * sizeof( CFrustumCullBatch * ) );
+			if ( !ppBatches )
+				return NULL;
+			m_ppBatches = ppBatches;
+
+			void *pMemory = _mm_malloc( sizeof( CFrustumCullBatch ), 16 );
+			if ( !pMemory )
+				return NULL;
+			m_ppBatches[m_nAllocated++] = new ( pMemory ) CFrustumCullBatch;
+		}
+
+		CFrustumCullBatch *pBatch = m_ppBatches[m_nDepth++];
+		pBatch->Reset();
+		return pBatch;
+	}
+
+	void Pop( void )
+	{
+		m_nDepth--;
+	}
+
+	inline int GetDepth( void ) const { return m_nDepth; }
+
+private:
+
+	CFrustumCullBatch **m_ppBatches;
+	int m_nAllocated;
+	int m_nDepth;
+};
+
+#endif // FRUSTUMCULL_H
@@ -0,0 +1,448 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the batched frustum culling. Checks that the
+//			SSE batch test gives exactly the answers of the one-box test that
+//			CRender3D::IsBoxVisible uses, for random frusta and boxes and for
+//			boxes that touch planes exactly, and times both on a million boxes:
+//
+//			g++ -O2 FrustumCull_test.cpp -o FrustumCull_test && ./FrustumCull_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "FrustumCull.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( RandomInt( 0, 1000000 ) / 1000000.0f );
+}
+
+static float Dot( const float *a, const float *b )
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Normalize( float *v )
+{
+	float flLength = sqrtf( Dot( v, v ) );
+	v[0] /= flLength;
+	v[1] /= flLength;
+	v[2] /= flLength;
+}
+
+static void Cross( const float *a, const float *b, float *pOut )
+{
+	pOut[0] = a[1] * b[2] - a[2] * b[1];
+	pOut[1] = a[2] * b[0] - a[0] * b[2];
+	pOut[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+//-----------------------------------------------------------------------------
+// Builds the six planes of a random perspective frustum the way the 3D view
+// does: outward facing normals, inside where the dot product is less than the
+// distance.
+//-----------------------------------------------------------------------------
+static void RandomFrustum( float *pPlanes )
+{
+	float Origin[3] = { RandomFloat( -8192, 8192 ), RandomFloat( -8192, 8192 ), RandomFloat( -8192, 8192 ) };
+
+	float Forward[3] = { RandomFloat( -1, 1 ), RandomFloat( -1, 1 ), RandomFloat( -1, 1 ) };
+	if ( Dot( Forward, Forward ) < 0.01f )
+	{
+		Forward[0] = 1;
+	}
+	Normalize( Forward );
+
+	float Up[3] = { 0, 0, 1 };
+	float Right[3];
+	Cross( Forward, Up, Right );
+	if ( Dot( Right, Right ) < 0.01f )
+	{
+		Right[0] = 0;
+		Right[1] = 1;
+		Right[2] = 0;
+	}
+	Normalize( Right );
+	Cross( Right, Forward, Up );
+
+	float flTanX = tanf( RandomFloat( 0.3f, 1.2f ) );
+	float flTanY = flTanX * RandomFloat( 0.5f, 1.0f );
+	float flNear = RandomFloat( 1, 16 );
+	float flFar = RandomFloat( 1024, 16384 );
+
+	float *pPlane = pPlanes;
+
+	// Near and far.
+	for ( int j = 0; j < 3; j++ )
+	{
+		pPlane[j] = -Forward[j];
+	}
+	pPlane[3] = -Dot( Forward, Origin ) - flNear;
+	pPlane += 4;
+
+	for ( int j = 0; j < 3; j++ )
+	{
+		pPlane[j] = Forward[j];
+	}
+	pPlane[3] = Dot( Forward, Origin ) + flFar;
+	pPlane += 4;
+
+	// Left, right, bottom, top.
+	for ( int nSide = 0; nSide < 4; nSide++ )
+	{
+		const float *pAxis = ( nSide < 2 ) ? Right : Up;
+		float flSign = ( nSide & 1 ) ? -1.0f : 1.0f;
+		float flTan = ( nSide < 2 ) ? flTanX : flTanY;
+
+		for ( int j = 0; j < 3; j++ )
+		{
+			pPlane[j] = flSign * pAxis[j] - flTan * Forward[j];
+		}
+		Normalize( pPlane );
+		pPlane[3] = Dot( pPlane, Origin );
+		pPlane += 4;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Six axial planes bounding [-n, n] on each axis, with integer distances so
+// that boxes with integer corners land exactly on them.
+//-----------------------------------------------------------------------------
+static void AxialFrustum( float *pPlanes, int n )
+{
+	for ( int i = 0; i < 6; i++ )
+	{
+		float *pPlane = pPlanes + i * 4;
+		pPlane[0] = pPlane[1] = pPlane[2] = 0;
+		pPlane[i >> 1] = ( i & 1 ) ? -1.0f : 1.0f;
+		pPlane[3] = (float)n;
+	}
+}
+
+static void RandomBox( float *pMins, float *pMaxs, float flRange, float flMaxSize )
+{
+	for ( int j = 0; j < 3; j++ )
+	{
+		pMins[j] = RandomFloat( -flRange, flRange );
+		pMaxs[j] = pMins[j] + ( RandomInt( 0, 9 ) == 0 ? 0.0f : RandomFloat( 0, flMaxSize ) );
+	}
+}
+
+//
+// Integer boxes around [-n, n]: many touch or share a face with the planes,
+// and some are flat or a single point.
+//
+static void IntegerBox( float *pMins, float *pMaxs, int n )
+{
+	for ( int j = 0; j < 3; j++ )
+	{
+		int nMin = RandomInt( -n - 2, n + 2 );
+		pMins[j] = (float)nMin;
+		pMaxs[j] = (float)( nMin + RandomInt( 0, 3 ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Checks a batch's masks against the one-box test for each of its boxes.
+//-----------------------------------------------------------------------------
+static bool BatchMatchesScalar( const CFrustumCullBatch &Batch, const float *pPlanes, int nPlanes )
+{
+	unsigned long long nVisibleMask;
+	unsigned long long nTotalMask;
+	Batch.Test( pPlanes, nPlanes, nVisibleMask, nTotalMask );
+
+	for ( int i = 0; i < FRUSTUMCULL_BATCH_SIZE; i++ )
+	{
+		unsigned long long nBit = 1ull << i;
+		bool bVisible = ( nVisibleMask & nBit ) != 0;
+		bool bTotal = ( nTotalMask & nBit ) != 0;
+
+		if ( i >= Batch.Count() )
+		{
+			if ( bVisible || bTotal )
+				return false;
+			continue;
+		}
+
+		float Mins[3];
+		float Maxs[3];
+		Batch.GetBox( i, Mins, Maxs );
+
+		FrustumCullResult_t eResult = FrustumCull_TestBox( pPlanes, nPlanes, Mins, Maxs );
+		if ( bVisible != ( eResult != FRUSTUMCULL_OUTSIDE ) || bTotal != ( eResult == FRUSTUMCULL_INSIDE ) )
+			return false;
+	}
+
+	return true;
+}
+
+static void TestRandomBatches( void )
+{
+	CFrustumCullBatch *pBatch = (CFrustumCullBatch *)_mm_malloc( sizeof( CFrustumCullBatch ), 16 );
+	new ( pBatch ) CFrustumCullBatch;
+
+	int nResults[3] = { 0, 0, 0 };
+
+	for ( int nFrustum = 0; nFrustum < 2000; nFrustum++ )
+	{
+		float Planes[6 * 4];
+		RandomFrustum( Planes );
+
+		// Every batch size, including empty and full.
+		int nCount = nFrustum % ( FRUSTUMCULL_BATCH_SIZE + 1 );
+
+		pBatch->Reset();
+		for ( int i = 0; i < nCount; i++ )
+		{
+			//
+			// Boxes over the same range as the frustum origins, so all three results come up.
+			//
+			float Mins[3];
+			float Maxs[3];
+			RandomBox( Mins, Maxs, 8192, 4096 );
+			CHECK( pBatch->AddBox( Mins, Maxs, &nResults[0] + ( i % 3 ) ) == i );
+			nResults[FrustumCull_TestBox( Planes, 6, Mins, Maxs )]++;
+		}
+
+		CHECK( pBatch->Count() == nCount );
+		CHECK( pBatch->IsFull() == ( nCount == FRUSTUMCULL_BATCH_SIZE ) );
+		CHECK( BatchMatchesScalar( *pBatch, Planes, 6 ) );
+
+		for ( int i = 0; i < nCount; i++ )
+		{
+			CHECK( pBatch->GetBoxObject( i ) == &nResults[0] + ( i % 3 ) );
+		}
+
+		// Fewer planes, as for a partial frustum.
+		CHECK( BatchMatchesScalar( *pBatch, Planes, nFrustum % 7 ) );
+	}
+
+	// The random boxes should have hit every case.
+	CHECK( nResults[FRUSTUMCULL_OUTSIDE] > 0 );
+	CHECK( nResults[FRUSTUMCULL_PARTIAL] > 0 );
+	CHECK( nResults[FRUSTUMCULL_INSIDE] > 0 );
+
+	pBatch->~CFrustumCullBatch();
+	_mm_free( pBatch );
+}
+
+static void TestTouchingBoxes( void )
+{
+	CFrustumCullBatch *pBatch = (CFrustumCullBatch *)_mm_malloc( sizeof( CFrustumCullBatch ), 16 );
+	new ( pBatch ) CFrustumCullBatch;
+
+	float Planes[6 * 4];
+	AxialFrustum( Planes, 4 );
+
+	//
+	// A box whose face lies on a plane is outside it from the outside and not
+	// entirely inside from the inside.
+	//
+	float Mins[3] = { 4, -1, -1 };
+	float Maxs[3] = { 6, 1, 1 };
+	CHECK( FrustumCull_TestBox( Planes, 6, Mins, Maxs ) == FRUSTUMCULL_OUTSIDE );
+
+	Mins[0] = 2;
+	Maxs[0] = 4;
+	CHECK( FrustumCull_TestBox( Planes, 6, Mins, Maxs ) == FRUSTUMCULL_PARTIAL );
+
+	Maxs[0] = 3;
+	CHECK( FrustumCull_TestBox( Planes, 6, Mins, Maxs ) == FRUSTUMCULL_INSIDE );
+
+	// A point on a plane, and one just inside it.
+	float Point[3] = { 0, -4, 0 };
+	CHECK( FrustumCull_TestBox( Planes, 6, Point, Point ) == FRUSTUMCULL_OUTSIDE );
+	Point[1] = -3;
+	CHECK( FrustumCull_TestBox( Planes, 6, Point, Point ) == FRUSTUMCULL_INSIDE );
+
+	int nResults[3] = { 0, 0, 0 };
+	for ( int nPass = 0; nPass < 5000; nPass++ )
+	{
+		pBatch->Reset();
+		int nCount = RandomInt( 1, FRUSTUMCULL_BATCH_SIZE );
+		for ( int i = 0; i < nCount; i++ )
+		{
+			IntegerBox( Mins, Maxs, 4 );
+			pBatch->AddBox( Mins, Maxs );
+			nResults[FrustumCull_TestBox( Planes, 6, Mins, Maxs )]++;
+		}
+
+		CHECK( BatchMatchesScalar( *pBatch, Planes, 6 ) );
+	}
+
+	CHECK( nResults[FRUSTUMCULL_OUTSIDE] > 0 );
+	CHECK( nResults[FRUSTUMCULL_PARTIAL] > 0 );
+	CHECK( nResults[FRUSTUMCULL_INSIDE] > 0 );
+
+	pBatch->~CFrustumCullBatch();
+	_mm_free( pBatch );
+}
+
+//-----------------------------------------------------------------------------
+// Recursing renderers keep a batch per level: a level's batch must keep its
+// boxes while deeper levels push, fill and pop theirs.
+//-----------------------------------------------------------------------------
+static void TestBatchStack( void )
+{
+	CFrustumCullBatchStack Stack;
+	CHECK( Stack.GetDepth() == 0 );
+
+	const int nLevels = 40;
+	CFrustumCullBatch *pLevels[nLevels];
+
+	for ( int nPass = 0; nPass < 3; nPass++ )
+	{
+		// Go part of the way down and back first, so that later passes reuse batches.
+		int nDepth = ( nPass == 0 ) ? nLevels / 2 : nLevels;
+
+		for ( int nLevel = 0; nLevel < nDepth; nLevel++ )
+		{
+			CFrustumCullBatch *pBatch = Stack.Push();
+			CHECK( pBatch != NULL );
+			CHECK( ( (size_t)pBatch & 15 ) == 0 );
+			CHECK( pBatch->Count() == 0 );
+			CHECK( Stack.GetDepth() == nLevel + 1 );
+
+			for ( int nAbove = 0; nAbove < nLevel; nAbove++ )
+			{
+				CHECK( pLevels[nAbove] != pBatch );
+			}
+
+			if ( nPass > 0 && nLevel < nLevels / 2 )
+			{
+				// Reused, not reallocated.
+				CHECK( pLevels[nLevel] == pBatch );
+			}
+			pLevels[nLevel] = pBatch;
+
+			for ( int i = 0; i < nLevel % FRUSTUMCULL_BATCH_SIZE + 1; i++ )
+			{
+				float Mins[3] = { (float)nLevel, (float)i, 0 };
+				float Maxs[3] = { (float)nLevel + 1, (float)i + 1, 1 };
+				pBatch->AddBox( Mins, Maxs, &pLevels[nLevel] );
+			}
+		}
+
+		for ( int nLevel = nDepth - 1; nLevel >= 0; nLevel-- )
+		{
+			CFrustumCullBatch *pBatch = pLevels[nLevel];
+			CHECK( pBatch->Count() == nLevel % FRUSTUMCULL_BATCH_SIZE + 1 );
+			for ( int i = 0; i < pBatch->Count(); i++ )
+			{
+				float Mins[3];
+				float Maxs[3];
+				pBatch->GetBox( i, Mins, Maxs );
+				CHECK( Mins[0] == (float)nLevel && Mins[1] == (float)i && Maxs[0] == (float)nLevel + 1 );
+				CHECK( pBatch->GetBoxObject( i ) == &pLevels[nLevel] );
+			}
+
+			Stack.Pop();
+			CHECK( Stack.GetDepth() == nLevel );
+		}
+	}
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+//-----------------------------------------------------------------------------
+// A million boxes tested against one frustum, one at a time as IsBoxVisible
+// does and a batch at a time.
+//-----------------------------------------------------------------------------
+static void Benchmark( void )
+{
+	const int nBoxes = 1000000;
+	const int nBatches = nBoxes / FRUSTUMCULL_BATCH_SIZE;
+	const int nRuns = 10;
+
+	float Planes[6 * 4];
+	RandomFrustum( Planes );
+
+	std::vector<float> Boxes( nBoxes * 6 );
+	for ( int i = 0; i < nBoxes; i++ )
+	{
+		RandomBox( &Boxes[i * 6], &Boxes[i * 6 + 3], 8192, 512 );
+	}
+
+	CFrustumCullBatchStack Stack;
+	std::vector<CFrustumCullBatch *> Batches( nBatches );
+	for ( int nBatch = 0; nBatch < nBatches; nBatch++ )
+	{
+		Batches[nBatch] = Stack.Push();
+		for ( int i = 0; i < FRUSTUMCULL_BATCH_SIZE; i++ )
+		{
+			const float *pBox = &Boxes[( nBatch * FRUSTUMCULL_BATCH_SIZE + i ) * 6];
+			Batches[nBatch]->AddBox( pBox, pBox + 3 );
+		}
+	}
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	int nScalarVisible = 0;
+	for ( int nRun = 0; nRun < nRuns; nRun++ )
+	{
+		for ( int i = 0; i < nBoxes; i++ )
+		{
+			nScalarVisible += ( FrustumCull_TestBox( Planes, 6, &Boxes[i * 6], &Boxes[i * 6 + 3] ) != FRUSTUMCULL_OUTSIDE );
+		}
+	}
+	double flScalar = MS( Start ) / nRuns;
+
+	Start = std::chrono::steady_clock::now();
+	int nBatchVisible = 0;
+	for ( int nRun = 0; nRun < nRuns; nRun++ )
+	{
+		for ( int nBatch = 0; nBatch < nBatches; nBatch++ )
+		{
+			unsigned long long nVisibleMask;
+			unsigned long long nTotalMask;
+			Batches[nBatch]->Test( Planes, 6, nVisibleMask, nTotalMask );
+			for ( ; nVisibleMask; nVisibleMask &= nVisibleMask - 1 )
+			{
+				nBatchVisible++;
+			}
+		}
+	}
+	double flBatch = MS( Start ) / nRuns;
+
+	CHECK( nScalarVisible == nBatchVisible );
+
+	printf( "%d boxes, %d visible         ms\n", nBatches * FRUSTUMCULL_BATCH_SIZE, nBatchVisible / nRuns );
+	printf( "one at a time (IsBoxVisible)   %8.2f\n", flScalar );
+	printf( "batches of %d (SSE)            %8.2f\n", FRUSTUMCULL_BATCH_SIZE, flBatch );
+	printf( "batch size: %d bytes, now held by the renderer rather than each recursive call\n", (int)sizeof( CFrustumCullBatch ) );
+}
+
+int main( void )
+{
+	TestRandomBatches();
+	TestTouchingBoxes();
+	TestBatchStack();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All frustum cull tests passed\n" );
+	Benchmark();
+	return g_nFailures != 0;
+}
@@ -0,0 +1,218 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Picks the level the pixel conversion kernels in
+//			ImageConvertKernels.h run at, from the CPU the first time a
+//			kernel runs, and pools the buffers they work on.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "ImageConvert.h"
+#include "tier0/platform.h"
+#include <intrin.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+CImageBufferPool g_ImageBufferPool;
+
+static bool s_bLevelSet = false;
+static ImageConvertLevel_t s_eLevel = IMAGECONVERT_SCALAR;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the CPU and OS support AVX2.
+//-----------------------------------------------------------------------------
+static bool CPUSupportsAVX2( void )
+{
+	int Regs[4];
+	__cpuid( Regs, 0 );
+	if ( Regs[0] < 7 )
+	{
+		return false;
+	}
+
+	// The OS must save the YMM registers.
+	__cpuid( Regs, 1 );
+	const int nOSXSAVE = ( 1 << 27 );
+	const int nAVX = ( 1 << 28 );
+	if ( ( Regs[2] & ( nOSXSAVE | nAVX ) ) != ( nOSXSAVE | nAVX ) )
+	{
+		return false;
+	}
+
+	if ( ( _xgetbv( 0 ) & 6 ) != 6 )
+	{
+		return false;
+	}
+
+	__cpuidex( Regs, 7, 0 );
+	return ( Regs[1] & ( 1 << 5 ) ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the highest level this CPU supports.
+//-----------------------------------------------------------------------------
+ImageConvertLevel_t ImageConvert_GetSupportedLevel( void )
+{
+	static int s_nSupported = -1;
+	if ( s_nSupported < 0 )
+	{
+		if ( CPUSupportsAVX2() )
+		{
+			s_nSupported = IMAGECONVERT_AVX2;
+		}
+		else if ( GetCPUInformation()->m_bSSE2 )
+		{
+			s_nSupported = IMAGECONVERT_SSE2;
+		}
+		else
+		{
+			s_nSupported = IMAGECONVERT_SCALAR;
+		}
+	}
+
+	return (ImageConvertLevel_t)s_nSupported;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+ImageConvertLevel_t ImageConvert_GetLevel( void )
+{
+	if ( !s_bLevelSet )
+	{
+		ImageConvert_SetLevel( IMAGECONVERT_AVX2 );
+	}
+
+	return s_eLevel;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Sets the level the kernels run at, clamped to what the CPU supports.
+//-----------------------------------------------------------------------------
+void ImageConvert_SetLevel( ImageConvertLevel_t eLevel )
+{
+	s_eLevel = min( eLevel, ImageConvert_GetSupportedLevel() );
+	s_bLevelSet = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void ImageConvert_PremultiplyAlpha( unsigned char *pPixels, int nPixels )
+{
+	ImageConvert_PremultiplyAlphaAtLevel( pPixels, nPixels, ImageConvert_GetLevel() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void ImageConvert_SwapRB( const unsigned char *pSrc, unsigned char *pDest, int nPixels )
+{
+	ImageConvert_SwapRBAtLevel( pSrc, pDest, nPixels, ImageConvert_GetLevel() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void ImageConvert_HalveBox( const unsigned char *pSrc, int nWidth, int nHeight, int nBytesPerPixel, unsigned char *pDest )
+{
+	Assert( ( nBytesPerPixel == 3 ) || ( nBytesPerPixel == 4 ) );
+
+	ImageConvert_HalveBoxAtLevel( pSrc, nWidth, nHeight, nBytesPerPixel, pDest, ImageConvert_GetLevel() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Pooled buffers carry a header with their size class in front of the data.
+// It is as large as the alignment so the data stays aligned for the kernels.
+//-----------------------------------------------------------------------------
+#define IMAGEBUFFERPOOL_ALIGN		32
+#define IMAGEBUFFERPOOL_UNPOOLED	( IMAGEBUFFERPOOL_MAX_SHIFT - IMAGEBUFFERPOOL_MIN_SHIFT + 1 )
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CImageBufferPool::~CImageBufferPool( void )
+{
+	Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a buffer of at least nSize bytes, reusing a free one of
+//			the same size class if there is one.
+//-----------------------------------------------------------------------------
+void *CImageBufferPool::Alloc( int nSize )
+{
+	int nClass = 0;
+	while ( ( nClass < IMAGEBUFFERPOOL_UNPOOLED ) && ( ( 1 << ( nClass + IMAGEBUFFERPOOL_MIN_SHIFT ) ) < nSize ) )
+	{
+		nClass++;
+	}
+
+	unsigned char *pBlock;
+	CUtlVector<void *> &FreeBuffers = m_FreeBuffers[nClass];
+	if ( FreeBuffers.Count() > 0 )
+	{
+		pBlock = (unsigned char *)FreeBuffers.Tail();
+		FreeBuffers.RemoveMultipleFromTail( 1 );
+	}
+	else
+	{
+		int nBlockSize = ( nClass < IMAGEBUFFERPOOL_UNPOOLED ) ? ( 1 << ( nClass + IMAGEBUFFERPOOL_MIN_SHIFT ) ) : nSize;
+		pBlock = (unsigned char *)MemAlloc_AllocAligned( nBlockSize + IMAGEBUFFERPOOL_ALIGN, IMAGEBUFFERPOOL_ALIGN );
+		*(int *)pBlock = nClass;
+	}
+
+	return pBlock + IMAGEBUFFERPOOL_ALIGN;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Gives a buffer from Alloc back to the pool.
+//-----------------------------------------------------------------------------
+void CImageBufferPool::Free( void *pBuffer )
+{
+	if ( pBuffer == NULL )
+	{
+		return;
+	}
+
+	unsigned char *pBlock = (unsigned char *)pBuffer - IMAGEBUFFERPOOL_ALIGN;
+	int nClass = *(int *)pBlock;
+	Assert( ( nClass >= 0 ) && ( nClass <= IMAGEBUFFERPOOL_UNPOOLED ) );
+
+	if ( ( nClass < IMAGEBUFFERPOOL_UNPOOLED ) && ( m_FreeBuffers[nClass].Count() < IMAGEBUFFERPOOL_MAX_FREE ) )
+	{
+		m_FreeBuffers[nClass].AddToTail( pBlock );
+	}
+	else
+	{
+		MemAlloc_FreeAligned( pBlock );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CImageBufferPool::Purge( void )
+{
+	for ( int nClass = 0; nClass < ARRAYSIZE( m_FreeBuffers ); nClass++ )
+	{
+		for ( int i = 0; i < m_FreeBuffers[nClass].Count(); i++ )
+		{
+			MemAlloc_FreeAligned( m_FreeBuffers[nClass][i] );
+		}
+		m_FreeBuffers[nClass].Purge();
+	}
+}
@@ -0,0 +1,67 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Pixel conversion kernels for material previews, with SSE2 and
+//			AVX2 versions picked at runtime, and a pool for the image
+//			buffers they work on. Every kernel gives the same bytes as its
+//			scalar version.
+//
+//=============================================================================//
+
+#ifndef IMAGECONVERT_H
+#define IMAGECONVERT_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "ImageConvertKernels.h"
+
+// Highest level this CPU supports.
+ImageConvertLevel_t ImageConvert_GetSupportedLevel( void );
+
+// Level the kernels currently run at. Setting a level above the supported one
+// clamps it, so forcing IMAGECONVERT_SCALAR is the way to compare results.
+ImageConvertLevel_t ImageConvert_GetLevel( void );
+void ImageConvert_SetLevel( ImageConvertLevel_t eLevel );
+
+// Multiplies the first three bytes of each 4 byte pixel by the fourth:
+// c = c * a / 255, rounded down.
+void ImageConvert_PremultiplyAlpha( unsigned char *pPixels, int nPixels );
+
+// Swaps the first and third bytes of each 4 byte pixel, turning RGBA into
+// BGRA and back. pSrc and pDest may be the same buffer.
+void ImageConvert_SwapRB( const unsigned char *pSrc, unsigned char *pDest, int nPixels );
+
+// Halves an image with a 2x2 box filter, rounding to nearest. The result is
+// max( nWidth / 2, 1 ) by max( nHeight / 2, 1 ); an odd last row or column
+// is dropped. nBytesPerPixel is 3 or 4.
+void ImageConvert_HalveBox( const unsigned char *pSrc, int nWidth, int nHeight, int nBytesPerPixel, unsigned char *pDest );
+
+//
+// Keeps freed image buffers for reuse. Buffers are rounded up to a power of
+// two, so a preview of the same size class never goes back to the heap.
+//
+#define IMAGEBUFFERPOOL_MIN_SHIFT		12		// 4 KB
+#define IMAGEBUFFERPOOL_MAX_SHIFT		26		// 64 MB; larger buffers are not pooled.
+#define IMAGEBUFFERPOOL_MAX_FREE		16		// Free buffers kept per size class.
+
+class CImageBufferPool
+{
+public:
+
+	~CImageBufferPool( void );
+
+	void *Alloc( int nSize );
+	void Free( void *pBuffer );
+
+	// Returns every free buffer to the heap.
+	void Purge( void );
+
+private:
+
+	CUtlVector<void *> m_FreeBuffers[IMAGEBUFFERPOOL_MAX_SHIFT - IMAGEBUFFERPOOL_MIN_SHIFT + 2];
+};
+
+extern CImageBufferPool g_ImageBufferPool;
+
+#endif // IMAGECONVERT_H
@@ -0,0 +1,357 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Pixel conversion kernels for material previews.
+//
+//			Each operation has a scalar version, which defines the result,
+//			and SSE2 and AVX2 versions that must match it byte for byte.
+//			The vector versions work through whole vectors and hand the
+//			remaining pixels to the scalar version. ImageConvert.cpp picks
+//			the level from the CPU.
+//
+//			Kept free of editor dependencies so the kernels can be tested
+//			standalone:
+//
+//			g++ -O2 ImageConvert_test.cpp -o ImageConvert_test && ./ImageConvert_test
+//
+//=============================================================================//
+
+#ifndef IMAGECONVERTKERNELS_H
+#define IMAGECONVERTKERNELS_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+enum ImageConvertLevel_t
+{
+	IMAGECONVERT_SCALAR = 0,
+	IMAGECONVERT_SSE2,
+	IMAGECONVERT_AVX2,
+};
+
+// GCC only emits AVX2 instructions in functions built for it; MSVC emits
+// them anywhere.
+#ifdef __GNUC__
+#define IMAGECONVERT_AVX2_TARGET	__attribute__(( target( "avx2" ) ))
+#else
+#define IMAGECONVERT_AVX2_TARGET
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Integer c * a / 255 rounded down, exact for c, a in [0, 255].
+//			The vector kernels use the same form on 16 bit lanes.
+//-----------------------------------------------------------------------------
+static inline unsigned int MulDiv255( unsigned int c, unsigned int a )
+{
+	unsigned int x = c * a;
+	return ( x + 1 + ( x >> 8 ) ) >> 8;
+}
+
+
+//-----------------------------------------------------------------------------
+// Scalar kernels.
+//-----------------------------------------------------------------------------
+static void PremultiplyAlpha_Scalar( unsigned char *pPixels, int nPixels )
+{
+	for ( int i = 0; i < nPixels; i++, pPixels += 4 )
+	{
+		unsigned int a = pPixels[3];
+		pPixels[0] = MulDiv255( pPixels[0], a );
+		pPixels[1] = MulDiv255( pPixels[1], a );
+		pPixels[2] = MulDiv255( pPixels[2], a );
+	}
+}
+
+static void SwapRB_Scalar( const unsigned char *pSrc, unsigned char *pDest, int nPixels )
+{
+	for ( int i = 0; i < nPixels; i++, pSrc += 4, pDest += 4 )
+	{
+		unsigned char c0 = pSrc[0];
+		unsigned char c2 = pSrc[2];
+		pDest[0] = c2;
+		pDest[1] = pSrc[1];
+		pDest[2] = c0;
+		pDest[3] = pSrc[3];
+	}
+}
+
+// Box filters one output row from two input rows. nDestWidth pixels are
+// written; the input rows hold at least 2 * nDestWidth pixels.
+static void HalveRow_Scalar( const unsigned char *pRow0, const unsigned char *pRow1, unsigned char *pDest, int nDestWidth, int nBytesPerPixel )
+{
+	for ( int x = 0; x < nDestWidth; x++ )
+	{
+		for ( int c = 0; c < nBytesPerPixel; c++ )
+		{
+			unsigned int nSum = pRow0[c] + pRow0[nBytesPerPixel + c] + pRow1[c] + pRow1[nBytesPerPixel + c];
+			pDest[c] = ( nSum + 2 ) >> 2;
+		}
+
+		pRow0 += nBytesPerPixel * 2;
+		pRow1 += nBytesPerPixel * 2;
+		pDest += nBytesPerPixel;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// SSE2 kernels.
+//-----------------------------------------------------------------------------
+static inline __m128i PremultiplyHalf_SSE2( __m128i Pixels, __m128i ColorMask, __m128i AlphaOne )
+{
+	// Alpha of each pixel in all four lanes, with 255 in the alpha lane so alpha is kept.
+	__m128i Alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( Pixels, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	Alpha = _mm_or_si128( _mm_and_si128( Alpha, ColorMask ), AlphaOne );
+
+	__m128i x = _mm_mullo_epi16( Pixels, Alpha );
+	x = _mm_add_epi16( x, _mm_add_epi16( _mm_set1_epi16( 1 ), _mm_srli_epi16( x, 8 ) ) );
+	return _mm_srli_epi16( x, 8 );
+}
+
+static void PremultiplyAlpha_SSE2( unsigned char *pPixels, int nPixels )
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i ColorMask = _mm_set_epi16( 0, -1, -1, -1, 0, -1, -1, -1 );
+	const __m128i AlphaOne = _mm_set_epi16( 255, 0, 0, 0, 255, 0, 0, 0 );
+
+	int i = 0;
+	for ( ; i + 4 <= nPixels; i += 4, pPixels += 16 )
+	{
+		__m128i Pixels = _mm_loadu_si128( (const __m128i *)pPixels );
+		__m128i Lo = PremultiplyHalf_SSE2( _mm_unpacklo_epi8( Pixels, Zero ), ColorMask, AlphaOne );
+		__m128i Hi = PremultiplyHalf_SSE2( _mm_unpackhi_epi8( Pixels, Zero ), ColorMask, AlphaOne );
+		_mm_storeu_si128( (__m128i *)pPixels, _mm_packus_epi16( Lo, Hi ) );
+	}
+
+	PremultiplyAlpha_Scalar( pPixels, nPixels - i );
+}
+
+static void SwapRB_SSE2( const unsigned char *pSrc, unsigned char *pDest, int nPixels )
+{
+	const __m128i KeepMask = _mm_set1_epi32( 0xFF00FF00 );
+	const __m128i LowMask = _mm_set1_epi32( 0x000000FF );
+
+	int i = 0;
+	for ( ; i + 4 <= nPixels; i += 4, pSrc += 16, pDest += 16 )
+	{
+		__m128i Pixels = _mm_loadu_si128( (const __m128i *)pSrc );
+		__m128i Keep = _mm_and_si128( Pixels, KeepMask );
+		__m128i Byte0 = _mm_slli_epi32( _mm_and_si128( Pixels, LowMask ), 16 );
+		__m128i Byte2 = _mm_and_si128( _mm_srli_epi32( Pixels, 16 ), LowMask );
+		_mm_storeu_si128( (__m128i *)pDest, _mm_or_si128( Keep, _mm_or_si128( Byte0, Byte2 ) ) );
+	}
+
+	SwapRB_Scalar( pSrc, pDest, nPixels - i );
+}
+
+// Sums two horizontally adjacent 4 byte pixels held as 16 bit lanes; the
+// result is in the low four lanes.
+static inline __m128i SumPairs_SSE2( __m128i Sum )
+{
+	return _mm_add_epi16( Sum, _mm_srli_si128( Sum, 8 ) );
+}
+
+static void HalveRow4_SSE2( const unsigned char *pRow0, const unsigned char *pRow1, unsigned char *pDest, int nDestWidth )
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Round = _mm_set1_epi16( 2 );
+
+	int x = 0;
+	for ( ; x + 4 <= nDestWidth; x += 4, pRow0 += 32, pRow1 += 32, pDest += 16 )
+	{
+		__m128i A0 = _mm_loadu_si128( (const __m128i *)pRow0 );
+		__m128i A1 = _mm_loadu_si128( (const __m128i *)( pRow0 + 16 ) );
+		__m128i B0 = _mm_loadu_si128( (const __m128i *)pRow1 );
+		__m128i B1 = _mm_loadu_si128( (const __m128i *)( pRow1 + 16 ) );
+
+		// Vertical sums of source pixels 0-1, 2-3, 4-5 and 6-7.
+		__m128i S01 = _mm_add_epi16( _mm_unpacklo_epi8( A0, Zero ), _mm_unpacklo_epi8( B0, Zero ) );
+		__m128i S23 = _mm_add_epi16( _mm_unpackhi_epi8( A0, Zero ), _mm_unpackhi_epi8( B0, Zero ) );
+		__m128i S45 = _mm_add_epi16( _mm_unpacklo_epi8( A1, Zero ), _mm_unpacklo_epi8( B1, Zero ) );
+		__m128i S67 = _mm_add_epi16( _mm_unpackhi_epi8( A1, Zero ), _mm_unpackhi_epi8( B1, Zero ) );
+
+		__m128i D01 = _mm_unpacklo_epi64( SumPairs_SSE2( S01 ), SumPairs_SSE2( S23 ) );
+		__m128i D23 = _mm_unpacklo_epi64( SumPairs_SSE2( S45 ), SumPairs_SSE2( S67 ) );
+		D01 = _mm_srli_epi16( _mm_add_epi16( D01, Round ), 2 );
+		D23 = _mm_srli_epi16( _mm_add_epi16( D23, Round ), 2 );
+
+		_mm_storeu_si128( (__m128i *)pDest, _mm_packus_epi16( D01, D23 ) );
+	}
+
+	HalveRow_Scalar( pRow0, pRow1, pDest, nDestWidth - x, 4 );
+}
+
+
+//-----------------------------------------------------------------------------
+// AVX2 kernels. 256 bit unpacks and packs work within each 128 bit half,
+// so the same sequences as SSE2 keep pixels in order.
+//-----------------------------------------------------------------------------
+static IMAGECONVERT_AVX2_TARGET void PremultiplyAlpha_AVX2( unsigned char *pPixels, int nPixels )
+{
+	const __m256i Zero = _mm256_setzero_si256();
+	const __m256i One = _mm256_set1_epi16( 1 );
+	const __m256i ColorMask = _mm256_set_epi16( 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1 );
+	const __m256i AlphaOne = _mm256_set_epi16( 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0 );
+
+	int i = 0;
+	for ( ; i + 8 <= nPixels; i += 8, pPixels += 32 )
+	{
+		__m256i Pixels = _mm256_loadu_si256( (const __m256i *)pPixels );
+		__m256i Halves[2] = { _mm256_unpacklo_epi8( Pixels, Zero ), _mm256_unpackhi_epi8( Pixels, Zero ) };
+
+		for ( int h = 0; h < 2; h++ )
+		{
+			__m256i Alpha = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( Halves[h], _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 3, 3, 3, 3 ) );
+			Alpha = _mm256_or_si256( _mm256_and_si256( Alpha, ColorMask ), AlphaOne );
+
+			__m256i x = _mm256_mullo_epi16( Halves[h], Alpha );
+			x = _mm256_add_epi16( x, _mm256_add_epi16( One, _mm256_srli_epi16( x, 8 ) ) );
+			Halves[h] = _mm256_srli_epi16( x, 8 );
+		}
+
+		_mm256_storeu_si256( (__m256i *)pPixels, _mm256_packus_epi16( Halves[0], Halves[1] ) );
+	}
+	_mm256_zeroupper();
+
+	PremultiplyAlpha_SSE2( pPixels, nPixels - i );
+}
+
+static IMAGECONVERT_AVX2_TARGET void SwapRB_AVX2( const unsigned char *pSrc, unsigned char *pDest, int nPixels )
+{
+	const __m256i Shuffle = _mm256_setr_epi8( 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+											  2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+
+	int i = 0;
+	for ( ; i + 8 <= nPixels; i += 8, pSrc += 32, pDest += 32 )
+	{
+		__m256i Pixels = _mm256_loadu_si256( (const __m256i *)pSrc );
+		_mm256_storeu_si256( (__m256i *)pDest, _mm256_shuffle_epi8( Pixels, Shuffle ) );
+	}
+	_mm256_zeroupper();
+
+	SwapRB_SSE2( pSrc, pDest, nPixels - i );
+}
+
+static IMAGECONVERT_AVX2_TARGET void HalveRow4_AVX2( const unsigned char *pRow0, const unsigned char *pRow1, unsigned char *pDest, int nDestWidth )
+{
+	const __m256i Zero = _mm256_setzero_si256();
+	const __m256i Round = _mm256_set1_epi16( 2 );
+
+	int x = 0;
+	for ( ; x + 4 <= nDestWidth; x += 4, pRow0 += 32, pRow1 += 32, pDest += 16 )
+	{
+		__m256i A = _mm256_loadu_si256( (const __m256i *)pRow0 );
+		__m256i B = _mm256_loadu_si256( (const __m256i *)pRow1 );
+
+		// Vertical sums of source pixels 0-1 | 4-5 and 2-3 | 6-7.
+		__m256i SLo = _mm256_add_epi16( _mm256_unpacklo_epi8( A, Zero ), _mm256_unpacklo_epi8( B, Zero ) );
+		__m256i SHi = _mm256_add_epi16( _mm256_unpackhi_epi8( A, Zero ), _mm256_unpackhi_epi8( B, Zero ) );
+		SLo = _mm256_add_epi16( SLo, _mm256_srli_si256( SLo, 8 ) );
+		SHi = _mm256_add_epi16( SHi, _mm256_srli_si256( SHi, 8 ) );
+
+		// Output pixels 0, 1 | 2, 3.
+		__m256i D = _mm256_unpacklo_epi64( SLo, SHi );
+		D = _mm256_srli_epi16( _mm256_add_epi16( D, Round ), 2 );
+		D = _mm256_packus_epi16( D, D );
+		D = _mm256_permute4x64_epi64( D, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+
+		_mm_storeu_si128( (__m128i *)pDest, _mm256_castsi256_si128( D ) );
+	}
+	_mm256_zeroupper();
+
+	HalveRow_Scalar( pRow0, pRow1, pDest, nDestWidth - x, 4 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the kernels at the given level, which the CPU must support.
+//-----------------------------------------------------------------------------
+static inline void ImageConvert_PremultiplyAlphaAtLevel( unsigned char *pPixels, int nPixels, ImageConvertLevel_t eLevel )
+{
+	switch ( eLevel )
+	{
+		case IMAGECONVERT_AVX2:
+			PremultiplyAlpha_AVX2( pPixels, nPixels );
+			break;
+
+		case IMAGECONVERT_SSE2:
+			PremultiplyAlpha_SSE2( pPixels, nPixels );
+			break;
+
+		default:
+			PremultiplyAlpha_Scalar( pPixels, nPixels );
+			break;
+	}
+}
+
+static inline void ImageConvert_SwapRBAtLevel( const unsigned char *pSrc, unsigned char *pDest, int nPixels, ImageConvertLevel_t eLevel )
+{
+	switch ( eLevel )
+	{
+		case IMAGECONVERT_AVX2:
+			SwapRB_AVX2( pSrc, pDest, nPixels );
+			break;
+
+		case IMAGECONVERT_SSE2:
+			SwapRB_SSE2( pSrc, pDest, nPixels );
+			break;
+
+		default:
+			SwapRB_Scalar( pSrc, pDest, nPixels );
+			break;
+	}
+}
+
+static inline void ImageConvert_HalveBoxAtLevel( const unsigned char *pSrc, int nWidth, int nHeight, int nBytesPerPixel, unsigned char *pDest, ImageConvertLevel_t eLevel )
+{
+	int nDestWidth = ( nWidth > 1 ) ? ( nWidth / 2 ) : 1;
+	int nDestHeight = ( nHeight > 1 ) ? ( nHeight / 2 ) : 1;
+
+	// A single row or column is filtered against itself in that direction.
+	int nSrcStride = nWidth * nBytesPerPixel;
+	int nRowStep = ( nHeight > 1 ) ? nSrcStride : 0;
+	int nPixelStep = ( nWidth > 1 ) ? nBytesPerPixel : 0;
+
+	if ( ( nBytesPerPixel != 4 ) || ( nPixelStep == 0 ) )
+	{
+		eLevel = IMAGECONVERT_SCALAR;
+	}
+
+	for ( int y = 0; y < nDestHeight; y++ )
+	{
+		const unsigned char *pRow0 = pSrc + y * 2 * nSrcStride;
+		const unsigned char *pRow1 = pRow0 + nRowStep;
+		unsigned char *pDestRow = pDest + y * nDestWidth * nBytesPerPixel;
+
+		switch ( eLevel )
+		{
+			case IMAGECONVERT_AVX2:
+				HalveRow4_AVX2( pRow0, pRow1, pDestRow, nDestWidth );
+				break;
+
+			case IMAGECONVERT_SSE2:
+				HalveRow4_SSE2( pRow0, pRow1, pDestRow, nDestWidth );
+				break;
+
+			default:
+				if ( nPixelStep != 0 )
+				{
+					HalveRow_Scalar( pRow0, pRow1, pDestRow, nDestWidth, nBytesPerPixel );
+				}
+				else
+				{
+					// One pixel wide: average the two rows only.
+					for ( int c = 0; c < nBytesPerPixel; c++ )
+					{
+						pDestRow[c] = ( pRow0[c] + pRow1[c] + 1 ) >> 1;
+					}
+				}
+				break;
+		}
+	}
+}
+
+#endif // IMAGECONVERTKERNELS_H
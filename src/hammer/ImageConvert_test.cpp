@@ -0,0 +1,234 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test and benchmark of the pixel conversion kernels.
+//			Checks the SSE2 and AVX2 kernels byte for byte against the
+//			scalar ones, and the scalar premultiply against the old
+//			( c * a ) / 255 loop, then times each level on a 4096x4096 image:
+//
+//			g++ -O2 ImageConvert_test.cpp -o ImageConvert_test && ./ImageConvert_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include "ImageConvertKernels.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static void RandomFill( std::vector<unsigned char> &Data )
+{
+	for ( size_t i = 0; i < Data.size(); i++ )
+	{
+		Data[i] = (unsigned char)RandomInt( 0, 255 );
+	}
+}
+
+static const char *s_pszLevelNames[] = { "scalar", "SSE2", "AVX2" };
+
+static ImageConvertLevel_t GetSupportedLevel( void )
+{
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) )
+		return IMAGECONVERT_AVX2;
+
+	return __builtin_cpu_supports( "sse2" ) ? IMAGECONVERT_SSE2 : IMAGECONVERT_SCALAR;
+}
+
+//-----------------------------------------------------------------------------
+// The loop the material preview code used before the kernels.
+//-----------------------------------------------------------------------------
+static void PremultiplyAlpha_Old( unsigned char *pPixels, int nPixels )
+{
+	for ( int i = 0; i < nPixels; i++, pPixels += 4 )
+	{
+		int a = pPixels[3];
+		pPixels[0] = ( pPixels[0] * a ) / 255;
+		pPixels[1] = ( pPixels[1] * a ) / 255;
+		pPixels[2] = ( pPixels[2] * a ) / 255;
+	}
+}
+
+static void TestPremultiplyAllPairs( ImageConvertLevel_t eMaxLevel )
+{
+	// every ( c, a ) pair, laid out so each lands in every lane position
+	std::vector<unsigned char> Source( 256 * 256 * 4 );
+	for ( int a = 0; a < 256; a++ )
+	{
+		for ( int c = 0; c < 256; c++ )
+		{
+			unsigned char *pPixel = &Source[( a * 256 + c ) * 4];
+			pPixel[0] = (unsigned char)c;
+			pPixel[1] = (unsigned char)( 255 - c );
+			pPixel[2] = (unsigned char)( c ^ 0x5a );
+			pPixel[3] = (unsigned char)a;
+		}
+	}
+
+	std::vector<unsigned char> Expected = Source;
+	PremultiplyAlpha_Old( &Expected[0], 256 * 256 );
+
+	for ( int nLevel = IMAGECONVERT_SCALAR; nLevel <= eMaxLevel; nLevel++ )
+	{
+		std::vector<unsigned char> Result = Source;
+		ImageConvert_PremultiplyAlphaAtLevel( &Result[0], 256 * 256, (ImageConvertLevel_t)nLevel );
+		CHECK( Result == Expected );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Random sizes, including the odd widths and heights that leave pixels for
+// the scalar tail and drop the last row or column when halving.
+//-----------------------------------------------------------------------------
+static void TestRandomImages( ImageConvertLevel_t eMaxLevel )
+{
+	for ( int nTest = 0; nTest < 2000; nTest++ )
+	{
+		int nWidth = RandomInt( 1, 70 );
+		int nHeight = RandomInt( 1, 9 );
+		int nBytesPerPixel = RandomInt( 3, 4 );
+		int nPixels = nWidth * nHeight;
+
+		std::vector<unsigned char> Source( nPixels * 4 );
+		RandomFill( Source );
+
+		std::vector<unsigned char> ExpectedPremul = Source;
+		ImageConvert_PremultiplyAlphaAtLevel( &ExpectedPremul[0], nPixels, IMAGECONVERT_SCALAR );
+
+		std::vector<unsigned char> ExpectedSwap( nPixels * 4 );
+		ImageConvert_SwapRBAtLevel( &Source[0], &ExpectedSwap[0], nPixels, IMAGECONVERT_SCALAR );
+
+		int nDestSize = ( ( nWidth > 1 ) ? nWidth / 2 : 1 ) * ( ( nHeight > 1 ) ? nHeight / 2 : 1 ) * nBytesPerPixel;
+		std::vector<unsigned char> ExpectedHalf( nDestSize );
+		ImageConvert_HalveBoxAtLevel( &Source[0], nWidth, nHeight, nBytesPerPixel, &ExpectedHalf[0], IMAGECONVERT_SCALAR );
+
+		for ( int nLevel = IMAGECONVERT_SSE2; nLevel <= eMaxLevel; nLevel++ )
+		{
+			ImageConvertLevel_t eLevel = (ImageConvertLevel_t)nLevel;
+
+			std::vector<unsigned char> Result = Source;
+			ImageConvert_PremultiplyAlphaAtLevel( &Result[0], nPixels, eLevel );
+			CHECK( Result == ExpectedPremul );
+
+			// out of place, then in place
+			std::vector<unsigned char> Swapped( nPixels * 4 );
+			ImageConvert_SwapRBAtLevel( &Source[0], &Swapped[0], nPixels, eLevel );
+			CHECK( Swapped == ExpectedSwap );
+			Result = Source;
+			ImageConvert_SwapRBAtLevel( &Result[0], &Result[0], nPixels, eLevel );
+			CHECK( Result == ExpectedSwap );
+
+			std::vector<unsigned char> Half( nDestSize );
+			ImageConvert_HalveBoxAtLevel( &Source[0], nWidth, nHeight, nBytesPerPixel, &Half[0], eLevel );
+			CHECK( Half == ExpectedHalf );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The scalar box filter against a direct average of each 2x2 block.
+//-----------------------------------------------------------------------------
+static void TestHalveReference( void )
+{
+	const int nWidth = 10, nHeight = 6;
+	std::vector<unsigned char> Source( nWidth * nHeight * 4 );
+	RandomFill( Source );
+
+	std::vector<unsigned char> Half( ( nWidth / 2 ) * ( nHeight / 2 ) * 4 );
+	ImageConvert_HalveBoxAtLevel( &Source[0], nWidth, nHeight, 4, &Half[0], IMAGECONVERT_SCALAR );
+
+	for ( int y = 0; y < nHeight / 2; y++ )
+	{
+		for ( int x = 0; x < nWidth / 2; x++ )
+		{
+			for ( int c = 0; c < 4; c++ )
+			{
+				int nSum = 0;
+				for ( int dy = 0; dy < 2; dy++ )
+				{
+					for ( int dx = 0; dx < 2; dx++ )
+					{
+						nSum += Source[( ( y * 2 + dy ) * nWidth + x * 2 + dx ) * 4 + c];
+					}
+				}
+				CHECK( Half[( y * ( nWidth / 2 ) + x ) * 4 + c] == ( nSum + 2 ) / 4 );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Times each kernel at each level on a 4096x4096 RGBA image, best of 5.
+//-----------------------------------------------------------------------------
+template <class KERNEL>
+static double TimeKernel( KERNEL Kernel )
+{
+	double flBest = 1e30;
+	for ( int nRun = 0; nRun < 5; nRun++ )
+	{
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		Kernel();
+		double flMS = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+		flBest = ( flMS < flBest ) ? flMS : flBest;
+	}
+
+	return flBest;
+}
+
+static void Benchmark( ImageConvertLevel_t eMaxLevel )
+{
+	const int nSize = 4096;
+	const int nPixels = nSize * nSize;
+
+	std::vector<unsigned char> Source( nPixels * 4 );
+	RandomFill( Source );
+	std::vector<unsigned char> Work( nPixels * 4 );
+	std::vector<unsigned char> Half( nPixels );
+
+	printf( "4096x4096 RGBA, best of 5 (ms):\n" );
+	printf( "%-8s %12s %12s %12s\n", "level", "premultiply", "swizzle", "halve" );
+
+	for ( int nLevel = IMAGECONVERT_SCALAR; nLevel <= eMaxLevel; nLevel++ )
+	{
+		ImageConvertLevel_t eLevel = (ImageConvertLevel_t)nLevel;
+
+		// premultiply works in place; its cost doesn't depend on the pixels
+		memcpy( &Work[0], &Source[0], Source.size() );
+		double flPremultiply = TimeKernel( [&]() { ImageConvert_PremultiplyAlphaAtLevel( &Work[0], nPixels, eLevel ); } );
+		double flSwizzle = TimeKernel( [&]() { ImageConvert_SwapRBAtLevel( &Source[0], &Work[0], nPixels, eLevel ); } );
+		double flHalve = TimeKernel( [&]() { ImageConvert_HalveBoxAtLevel( &Source[0], nSize, nSize, 4, &Half[0], eLevel ); } );
+
+		printf( "%-8s %12.2f %12.2f %12.2f\n", s_pszLevelNames[nLevel], flPremultiply, flSwizzle, flHalve );
+	}
+}
+
+int main( void )
+{
+	ImageConvertLevel_t eMaxLevel = GetSupportedLevel();
+	printf( "Testing up to %s\n", s_pszLevelNames[eMaxLevel] );
+
+	TestPremultiplyAllPairs( eMaxLevel );
+	TestRandomImages( eMaxLevel );
+	TestHalveReference();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All image conversion tests passed\n" );
+	Benchmark( eMaxLevel );
+	return 0;
+}
@@ -0,0 +1,405 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Shared templates for func_instance.
+//
+//			Every placement of an instance used to go through
+//			CHammer::OpenDocumentFile, which checks the file, matches the path
+//			against every open document and activates the frame of the one it
+//			finds. The cache keeps the document of each instance VMF keyed by
+//			its full path, so placements after the first just take a reference.
+//			A hidden template whose file changed on disk since it was opened is
+//			taken off its path and the file is opened again; placements made
+//			before keep the old document until they release it.
+//
+//			Documents can only be built on the main thread, so the parallel
+//			part is the reading: when a map starts loading, worker threads read
+//			its instance files, and the instance files those use, so the main
+//			thread parses them from the OS cache.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "hammer.h"
+#include "InstanceCache.h"
+#include "MapDoc.h"
+#include "MapInstance.h"
+#include "filesystem.h"
+#include "tier1/strtools.h"
+#include "tier1/utlbuffer.h"
+#include "vstdlib/jobthread.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+CInstanceCache g_InstanceCache;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+//-----------------------------------------------------------------------------
+CInstanceCache::CInstanceCache( void )
+{
+	m_nLoadDepth = 0;
+	m_nPrefetchJobs = 0;
+	m_bCancelPrefetch = false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CInstanceCache::~CInstanceCache( void )
+{
+	Assert( m_nPrefetchJobs == 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the document for an instance VMF.
+// Input  : pszFileName - Full path of the VMF, as found by DeterminePath.
+// Output : Returns the document, or NULL if it could not be opened.
+//-----------------------------------------------------------------------------
+CMapDoc *CInstanceCache::OpenInstance( const char *pszFileName )
+{
+	long nFileTime = g_pFullFileSystem->GetFileTime( pszFileName );
+
+	InstanceTemplate_t Template;
+	if ( m_Templates.Find( pszFileName, Template ) )
+	{
+		// Unsaved edits in the editor win over the file, as they always have,
+		// and so does a copy the user has open.
+		if ( ( Template.m_nFileTime == nFileTime ) || Template.m_pDoc->IsModified() || Template.m_pDoc->IsVisible() )
+		{
+			return Template.m_pDoc;
+		}
+
+		//
+		// The file changed on disk. Take the stale document off the path so
+		// the open below loads a fresh one; it closes when the placements that
+		// still use it release it.
+		//
+		Forget( Template.m_pDoc );
+		if ( Template.m_pDoc->GetReferenceCount() > 0 )
+		{
+			Template.m_pDoc->DetachFromFile();
+		}
+		else
+		{
+			Template.m_pDoc->OnCloseDocument();
+		}
+	}
+
+	//
+	// Open it the way it always has been, which also picks up a document the
+	// user already has open.
+	//
+	CMapDoc *pDoc = ( CMapDoc * )APP()->OpenDocumentFile( pszFileName );
+	if ( pDoc != NULL )
+	{
+		if ( m_TemplateFiles.Find( pDoc ) != m_TemplateFiles.InvalidHandle() )
+		{
+			// Already a template under another spelling of the path.
+			return pDoc;
+		}
+
+		Template.m_pDoc = pDoc;
+		Template.m_nFileTime = nFileTime;
+		m_Templates.Insert( pszFileName, Template );
+		m_TemplateFiles.Insert( pDoc, CUtlString( pszFileName ) );
+	}
+
+	return pDoc;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds the full path of an instance. Results are kept until the
+//			outermost load ends, so a map that places the same instance many
+//			times checks the disk once.
+//-----------------------------------------------------------------------------
+bool CInstanceCache::ResolvePath( const char *pszBaseFileName, const char *pszInstanceFileName, char *pszOutFileName )
+{
+	if ( m_nLoadDepth == 0 )
+	{
+		return CMapInstance::DeterminePath( pszBaseFileName, pszInstanceFileName, pszOutFileName );
+	}
+
+	// DeterminePath only looks at the directory of the base file.
+	char szBaseDir[ MAX_PATH ];
+	V_strcpy_safe( szBaseDir, pszBaseFileName );
+	V_StripFilename( szBaseDir );
+
+	char szKey[ MAX_PATH * 2 ];
+	V_snprintf( szKey, sizeof( szKey ), "%s|%s", szBaseDir, pszInstanceFileName );
+
+	CUtlString Resolved;
+	if ( m_ResolvedPaths.Find( szKey, Resolved ) )
+	{
+		V_strncpy( pszOutFileName, Resolved.Get(), MAX_PATH );
+		return ( pszOutFileName[ 0 ] != 0 );
+	}
+
+	bool bFound = CMapInstance::DeterminePath( pszBaseFileName, pszInstanceFileName, pszOutFileName );
+	m_ResolvedPaths.Insert( szKey, CUtlString( pszOutFileName ) );
+
+	return bFound;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called when a VMF starts loading.
+//-----------------------------------------------------------------------------
+void CInstanceCache::BeginLoad( const char *pszFileName )
+{
+	if ( m_nLoadDepth++ > 0 )
+	{
+		return;
+	}
+
+	m_bCancelPrefetch = false;
+	if ( g_pThreadPool->NumThreads() > 0 )
+	{
+		QueuePrefetch( pszFileName );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called when a VMF is done loading. The outermost call waits for the
+//			read aheads that are still running and forgets the resolved paths.
+//-----------------------------------------------------------------------------
+void CInstanceCache::EndLoad( void )
+{
+	Assert( m_nLoadDepth > 0 );
+	if ( --m_nLoadDepth > 0 )
+	{
+		return;
+	}
+
+	m_bCancelPrefetch = true;
+	while ( m_nPrefetchJobs > 0 )
+	{
+		ThreadSleep( 1 );
+	}
+
+	m_PrefetchedFiles.Purge();
+	m_ResolvedPaths.Purge();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a file to the read ahead of the current load.
+//-----------------------------------------------------------------------------
+void CInstanceCache::ReadAhead( const char *pszFileName )
+{
+	Assert( m_nLoadDepth > 0 );
+	if ( ( m_nLoadDepth > 0 ) && !m_bCancelPrefetch && ( g_pThreadPool->NumThreads() > 0 ) )
+	{
+		QueuePrefetch( pszFileName );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: A template saved from the editor is the file on disk, so it is
+//			not stale. Saved under another name it is no longer the template.
+//-----------------------------------------------------------------------------
+void CInstanceCache::OnDocumentSaved( CMapDoc *pDoc, const char *pszFileName )
+{
+	UtlHashHandle_t h = m_TemplateFiles.Find( pDoc );
+	if ( h == m_TemplateFiles.InvalidHandle() )
+	{
+		return;
+	}
+
+	char szSaved[ MAX_PATH ];
+	char szTemplate[ MAX_PATH ];
+	NormalizeTextureName( pszFileName, szSaved, sizeof( szSaved ) );
+	NormalizeTextureName( m_TemplateFiles[ h ].Get(), szTemplate, sizeof( szTemplate ) );
+
+	if ( V_strcmp( szSaved, szTemplate ) != 0 )
+	{
+		Forget( pDoc );
+		return;
+	}
+
+	InstanceTemplate_t Template;
+	Template.m_pDoc = pDoc;
+	Template.m_nFileTime = g_pFullFileSystem->GetFileTime( pszFileName );
+	m_Templates.Replace( pszFileName, Template );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drops a document that is being destroyed.
+//-----------------------------------------------------------------------------
+void CInstanceCache::OnDocumentClosed( CMapDoc *pDoc )
+{
+	Forget( pDoc );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes a document from the templates, if it is one.
+//-----------------------------------------------------------------------------
+void CInstanceCache::Forget( CMapDoc *pDoc )
+{
+	UtlHashHandle_t h = m_TemplateFiles.Find( pDoc );
+	if ( h == m_TemplateFiles.InvalidHandle() )
+	{
+		return;
+	}
+
+	m_Templates.Remove( m_TemplateFiles[ h ].Get() );
+	m_TemplateFiles.Remove( pDoc );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts reading a file on a worker thread unless this load has
+//			already read it.
+//-----------------------------------------------------------------------------
+void CInstanceCache::QueuePrefetch( const char *pszFileName )
+{
+	{
+		AUTO_LOCK( m_PrefetchMutex );
+
+		bool bQueued;
+		if ( m_PrefetchedFiles.Find( pszFileName, bQueued ) )
+		{
+			return;
+		}
+		m_PrefetchedFiles.Insert( pszFileName, true );
+	}
+
+	// The job owns the copy.
+	int nLen = V_strlen( pszFileName ) + 1;
+	char *pszCopy = new char[ nLen ];
+	V_strncpy( pszCopy, pszFileName, nLen );
+
+	++m_nPrefetchJobs;
+	CJob *pJob = g_pThreadPool->QueueCall( this, &CInstanceCache::PrefetchFile, pszCopy );
+	pJob->Release();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Worker thread. Reads a VMF, which leaves it in the OS cache for
+//			the main thread, and queues the instance files it uses.
+//-----------------------------------------------------------------------------
+void CInstanceCache::PrefetchFile( char *pszFileName )
+{
+	if ( !m_bCancelPrefetch )
+	{
+		CUtlBuffer Buffer( 0, 0, CUtlBuffer::TEXT_BUFFER );
+		if ( g_pFullFileSystem->ReadFile( pszFileName, NULL, Buffer ) )
+		{
+			CUtlVector<CUtlString> InstanceFiles;
+			FindInstanceFiles( Buffer, InstanceFiles );
+
+			for ( int i = 0; ( i < InstanceFiles.Count() ) && !m_bCancelPrefetch; i++ )
+			{
+				char szInstanceFile[ MAX_PATH ];
+				if ( CMapInstance::DeterminePath( pszFileName, InstanceFiles[ i ].Get(), szInstanceFile ) )
+				{
+					QueuePrefetch( szInstanceFile );
+				}
+			}
+		}
+	}
+
+	delete [] pszFileName;
+	--m_nPrefetchJobs;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Pulls the "file" keys of the func_instance entities out of VMF
+//			text. Only top level keys of top level entity chunks are looked at,
+//			the same ones CMapEntity would read.
+//-----------------------------------------------------------------------------
+void CInstanceCache::FindInstanceFiles( CUtlBuffer &Buffer, CUtlVector<CUtlString> &FileNames )
+{
+	const char *pszText = ( const char * )Buffer.Base();
+	const char *pszEnd = pszText + Buffer.TellPut();
+
+	int nDepth = 0;
+	bool bInEntity = false;
+	bool bIsInstance = false;
+	char szFile[ MAX_PATH ] = "";
+
+	while ( pszText < pszEnd )
+	{
+		const char *pszLineEnd = pszText;
+		while ( ( pszLineEnd < pszEnd ) && ( *pszLineEnd != '\n' ) )
+		{
+			pszLineEnd++;
+		}
+
+		const char *pszLine = pszText;
+		while ( ( pszLine < pszLineEnd ) && ( ( *pszLine == ' ' ) || ( *pszLine == '\t' ) ) )
+		{
+			pszLine++;
+		}
+
+		pszText = pszLineEnd + 1;
+
+		if ( pszLine == pszLineEnd )
+		{
+			continue;
+		}
+
+		if ( *pszLine == '{' )
+		{
+			nDepth++;
+		}
+		else if ( *pszLine == '}' )
+		{
+			if ( ( --nDepth == 0 ) && bInEntity )
+			{
+				if ( bIsInstance && szFile[ 0 ] )
+				{
+					FileNames.AddToTail( CUtlString( szFile ) );
+				}
+
+				bInEntity = false;
+			}
+		}
+		else if ( nDepth == 0 )
+		{
+			bInEntity = !V_strnicmp( pszLine, "entity", 6 );
+			bIsInstance = false;
+			szFile[ 0 ] = '\0';
+		}
+		else if ( ( nDepth == 1 ) && bInEntity && ( *pszLine == '"' ) )
+		{
+			//
+			// "key" "value"
+			//
+			const char *pszKey = pszLine + 1;
+			const char *pszKeyEnd = pszKey;
+			while ( ( pszKeyEnd < pszLineEnd ) && ( *pszKeyEnd != '"' ) )
+			{
+				pszKeyEnd++;
+			}
+
+			const char *pszValue = pszKeyEnd + 1;
+			while ( ( pszValue < pszLineEnd ) && ( *pszValue != '"' ) )
+			{
+				pszValue++;
+			}
+			pszValue++;
+
+			const char *pszValueEnd = pszValue;
+			while ( ( pszValueEnd < pszLineEnd ) && ( *pszValueEnd != '"' ) )
+			{
+				pszValueEnd++;
+			}
+
+			if ( pszValueEnd >= pszLineEnd )
+			{
+				continue;
+			}
+
+			int nKeyLen = pszKeyEnd - pszKey;
+			int nValueLen = pszValueEnd - pszValue;
+
+			if ( ( nKeyLen == 9 ) && !V_strnicmp( pszKey, "classname", 9 ) )
+			{
+				bIsInstance = ( nValueLen == 13 ) && !V_strnicmp( pszValue, "func_instance", 13 );
+			}
+			else if ( ( nKeyLen == 4 ) && !V_strnicmp( pszKey, "file", 4 ) )
+			{
+				V_strncpy( szFile, pszValue, min( nValueLen + 1, ( int )sizeof( szFile ) ) );
+			}
+		}
+	}
+}
@@ -0,0 +1,82 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Shared templates for func_instance. Each instance VMF is opened
+//			once and every placement of it references the same document,
+//			until the file changes on disk. While a map loads, the instance
+//			files it uses are read ahead on worker threads.
+//
+//=============================================================================//
+
+#ifndef INSTANCECACHE_H
+#define INSTANCECACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlstring.h"
+#include "tier1/utlhashtable.h"
+#include "tier0/threadtools.h"
+#include "TextureNameMap.h"
+
+class CMapDoc;
+class CUtlBuffer;
+
+//
+// An opened instance file.
+//
+struct InstanceTemplate_t
+{
+	CMapDoc *m_pDoc;
+	long m_nFileTime;				// Modification time of the VMF when it was opened or last saved.
+};
+
+class CInstanceCache
+{
+public:
+
+	CInstanceCache( void );
+	~CInstanceCache( void );
+
+	// Returns the document for an instance VMF, opening it if no placement
+	// has yet, or if the file changed on disk since it was opened. The
+	// caller adds its own reference.
+	CMapDoc *OpenInstance( const char *pszFileName );
+
+	// CMapInstance::DeterminePath, remembered for the rest of the current load.
+	bool ResolvePath( const char *pszBaseFileName, const char *pszInstanceFileName, char *pszOutFileName );
+
+	// Called by CMapDoc::LoadVMF around each load; calls nest. The outermost
+	// call starts reading ahead the instance files that pszFileName uses.
+	void BeginLoad( const char *pszFileName );
+	void EndLoad( void );
+
+	// Reads another VMF, and the instance files it uses, ahead during the
+	// current load. Used for the submaps of a manifest.
+	void ReadAhead( const char *pszFileName );
+
+	void OnDocumentSaved( CMapDoc *pDoc, const char *pszFileName );
+	void OnDocumentClosed( CMapDoc *pDoc );
+
+private:
+
+	void Forget( CMapDoc *pDoc );
+
+	void QueuePrefetch( const char *pszFileName );
+	void PrefetchFile( char *pszFileName );
+	static void FindInstanceFiles( CUtlBuffer &Buffer, CUtlVector<CUtlString> &FileNames );
+
+	CTextureNameMap<InstanceTemplate_t> m_Templates;	// Keyed by full path of the VMF.
+	CUtlHashtable<CMapDoc *, CUtlString> m_TemplateFiles;	// Key of each document in m_Templates.
+
+	int m_nLoadDepth;
+	CTextureNameMap<CUtlString> m_ResolvedPaths;		// "<base dir>|<instance name>" -> full path, for the current load.
+
+	CThreadFastMutex m_PrefetchMutex;
+	CTextureNameMap<bool> m_PrefetchedFiles;			// Files read ahead during the current load; guarded by m_PrefetchMutex.
+	CInterlockedInt m_nPrefetchJobs;
+	volatile bool m_bCancelPrefetch;
+};
+
+extern CInstanceCache g_InstanceCache;
+
+#endif // INSTANCECACHE_H
@@ -19,6 +19,10 @@
 #include "History.h"
 #include "HelperFactory.h"
 #include "SaveInfo.h"
+#include "InstanceCache.h"
+#include "StudioModel.h"
+#include "filesystem.h"
+#include "tier1/utlbuffer.h"
 #include "tier2/tier2.h"
 #include "p4lib/ip4.h"
 
@@ -336,6 +340,62 @@ ChunkFileResult_t CManifest::LoadManifestCordoningPrefsCallback( CChunkFile *pFi
 	return( eResult );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Lists the "File" keys of the VMF chunks of a manifest, in order,
+//			without going through the chunk reader.
+// Input  : pszFileName - the manifest file name
+//			FileNames - receives the submap files, relative to the manifest directory
+//-----------------------------------------------------------------------------
+void CManifest::FindSubmapFiles( const char *pszFileName, CUtlVector<CUtlString> &FileNames )
+{
+	CUtlBuffer Buffer( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	if ( !g_pFullFileSystem->ReadFile( pszFileName, NULL, Buffer ) )
+	{
+		return;
+	}
+
+	const char *pszText = ( const char * )Buffer.Base();
+	const char *pszEnd = pszText + Buffer.TellPut();
+	int nDepth = 0;
+
+	while ( pszText < pszEnd )
+	{
+		const char *pszLineEnd = pszText;
+		while ( ( pszLineEnd < pszEnd ) && ( *pszLineEnd != '\n' ) )
+		{
+			pszLineEnd++;
+		}
+
+		char szLine[ MAX_PATH * 2 ];
+		V_strncpy( szLine, pszText, min( ( int )( pszLineEnd - pszText ) + 1, ( int )sizeof( szLine ) ) );
+		pszText = pszLineEnd + 1;
+
+		const char *pszLine = szLine;
+		while ( ( *pszLine == ' ' ) || ( *pszLine == '\t' ) )
+		{
+			pszLine++;
+		}
+
+		if ( *pszLine == '{' )
+		{
+			nDepth++;
+		}
+		else if ( *pszLine == '}' )
+		{
+			nDepth--;
+		}
+		else if ( nDepth == 2 )
+		{
+			// "Maps" { "VMF" { "File" "<name>" } }
+			char szKey[ MAX_PATH ], szValue[ MAX_PATH ];
+			if ( ( sscanf( pszLine, "\"%259[^\"]\" \"%259[^\"]\"", szKey, szValue ) == 2 ) && !stricmp( szKey, "File" ) )
+			{
+				FileNames.AddToTail( CUtlString( szValue ) );
+			}
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: This function will load in a vmf manifest
 // Input  : pszFileName - the file name of the manifest to load
@@ -352,6 +412,25 @@ bool CManifest::LoadVMFManifest( const char *pszFileName )
 	V_StripExtension( pszFileName, m_ManifestDir, sizeof( m_ManifestDir ) );
 	strcat( m_ManifestDir, "\\" );
 
+	//
+	// Start reading every submap, and the instances they use, on worker
+	// threads; the submaps are then parsed here in manifest order, each one
+	// finding its file already in memory. Models queue across all of them.
+	//
+	CUtlVector<CUtlString> SubmapFiles;
+	FindSubmapFiles( pszFileName, SubmapFiles );
+
+	CStudioModelCache::BeginQueuedLoad();
+	g_InstanceCache.BeginLoad( pszFileName );
+	for ( int i = 0; i < SubmapFiles.Count(); i++ )
+	{
+		char szSubmapFile[ MAX_PATH ];
+		V_snprintf( szSubmapFile, sizeof( szSubmapFile ), "%s%s", m_ManifestDir, SubmapFiles[ i ].Get() );
+		g_InstanceCache.ReadAhead( szSubmapFile );
+	}
+
+	CMapDoc::BeginBatchLoad( SubmapFiles.Count() );
+
 	CChunkFile File;
 	ChunkFileResult_t eResult = File.Open( pszFileName, ChunkFile_Read );
 
@@ -383,6 +462,10 @@ bool CManifest::LoadVMFManifest( const char *pszFileName )
 		File.PopHandlers();
 	}
 
+	CMapDoc::EndBatchLoad();
+	g_InstanceCache.EndLoad();
+	CStudioModelCache::EndQueuedLoad();
+
 	if (eResult == ChunkFile_Ok)
 	{
 	}
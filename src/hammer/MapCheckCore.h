@@ -0,0 +1,277 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The map checks that only look at the map's own data. They are kept
+//			free of editor dependencies so the Map Problems dialog and a
+//			command line runner share them. The runner loads VMF files, times
+//			each check and compares its results with the checks as they were
+//			before the map check passes were fused:
+//
+//			g++ -O2 MapCheckCore_test.cpp -o MapCheckCore_test && ./MapCheckCore_test [map.vmf | dir ...]
+//
+//			The checks are templates. The types they are used with provide:
+//
+//			SOLID	- int GetFaceCount(), FACE *GetFace(int)
+//			FACE	- int GetFaceID(), a texture.texture string and a
+//					  plane.normal that compares with ==
+//			ENTITY	- IsNodeClass(), int GetNodeID(), IsPlaceholder() and
+//					  IsClass(const char *)
+//
+//			A FILTER is called with each object and returns false to leave it
+//			out of the check. A REPORT is called with each object found.
+//
+//=============================================================================//
+
+#ifndef MAPCHECKCORE_H
+#define MAPCHECKCORE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdlib.h>
+
+struct MapCheckID_t
+{
+	int nID;
+	int nIndex;		// Where the ID is in the list being counted.
+};
+
+inline int MapCheck_CompareIDs( const void *pLeft, const void *pRight )
+{
+	const MapCheckID_t *pA = (const MapCheckID_t *)pLeft;
+	const MapCheckID_t *pB = (const MapCheckID_t *)pRight;
+
+	if ( pA->nID != pB->nID )
+		return ( pA->nID < pB->nID ) ? -1 : 1;
+
+	return pA->nIndex - pB->nIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Counts how many times each of a list of IDs is used, by sorting
+//			rather than by searching the list once per entry.
+// Input  : pIDs - nCount IDs.
+// Output : pnEarlier - If not NULL, gets how many earlier entries have the same
+//				ID as each entry.
+//			pnTotal - If not NULL, gets how many entries in all have the same ID
+//				as each entry.
+//			Returns false if out of memory.
+//-----------------------------------------------------------------------------
+inline bool MapCheck_CountIDs( const int *pIDs, int nCount, int *pnEarlier, int *pnTotal )
+{
+	if ( nCount == 0 )
+		return true;
+
+	MapCheckID_t *pSorted = (MapCheckID_t *)malloc( nCount * sizeof( MapCheckID_t ) );
+	if ( !pSorted )
+		return false;
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		pSorted[i].nID = pIDs[i];
+		pSorted[i].nIndex = i;
+	}
+
+	qsort( pSorted, nCount, sizeof( MapCheckID_t ), MapCheck_CompareIDs );
+
+	int nFirst = 0;
+	while ( nFirst < nCount )
+	{
+		int nEnd = nFirst + 1;
+		while ( ( nEnd < nCount ) && ( pSorted[nEnd].nID == pSorted[nFirst].nID ) )
+		{
+			nEnd++;
+		}
+
+		for ( int i = nFirst; i < nEnd; i++ )
+		{
+			if ( pnEarlier )
+			{
+				pnEarlier[pSorted[i].nIndex] = i - nFirst;
+			}
+
+			if ( pnTotal )
+			{
+				pnTotal[pSorted[i].nIndex] = nEnd - nFirst;
+			}
+		}
+
+		nFirst = nEnd;
+	}
+
+	free( pSorted );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if there is a placeholder entity of the given class.
+//-----------------------------------------------------------------------------
+template <class ENTITY, class FILTER>
+bool MapCheck_HasPlaceholder( ENTITY *const *ppEntities, int nEntities, FILTER &IsChecked, const char *pszClass )
+{
+	for ( int i = 0; i < nEntities; i++ )
+	{
+		ENTITY *pEntity = ppEntities[i];
+		if ( IsChecked( pEntity ) && pEntity->IsPlaceholder() && pEntity->IsClass( pszClass ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if a solid has both liquid ('*') and normal textures.
+//-----------------------------------------------------------------------------
+template <class SOLID>
+bool MapCheck_HasMixedFaces( SOLID *pSolid )
+{
+	int nFaces = pSolid->GetFaceCount();
+	for ( int i = 1; i < nFaces; i++ )
+	{
+		if ( ( pSolid->GetFace( i )->texture.texture[0] == '*' ) != ( pSolid->GetFace( 0 )->texture.texture[0] == '*' ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if two faces of a solid have identical normals.
+//-----------------------------------------------------------------------------
+template <class SOLID>
+bool MapCheck_HasDuplicatePlanes( SOLID *pSolid )
+{
+	int nFaces = pSolid->GetFaceCount();
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		for ( int j = i + 1; j < nFaces; j++ )
+		{
+			if ( pSolid->GetFace( i )->plane.normal == pSolid->GetFace( j )->plane.normal )
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds each face ID used by more than one face, and reports it once,
+//			on the second face that uses it.
+// Input  : ppSolids - nSolids solids, in the order to visit their faces.
+//			Report - Called as Report( pSolid, pFace ).
+// Output : Returns false if out of memory.
+//-----------------------------------------------------------------------------
+template <class SOLID, class FILTER, class REPORT>
+bool MapCheck_DuplicateFaceIDs( SOLID *const *ppSolids, int nSolids, FILTER &IsChecked, REPORT &Report )
+{
+	int nFaces = 0;
+	for ( int i = 0; i < nSolids; i++ )
+	{
+		if ( IsChecked( ppSolids[i] ) )
+		{
+			nFaces += ppSolids[i]->GetFaceCount();
+		}
+	}
+
+	int *pIDs = (int *)malloc( ( nFaces + 1 ) * sizeof( int ) );
+	int *pnEarlier = (int *)malloc( ( nFaces + 1 ) * sizeof( int ) );
+	bool bOK = ( pIDs && pnEarlier );
+
+	if ( bOK )
+	{
+		int nFace = 0;
+		for ( int i = 0; i < nSolids; i++ )
+		{
+			if ( !IsChecked( ppSolids[i] ) )
+				continue;
+
+			for ( int j = 0; j < ppSolids[i]->GetFaceCount(); j++ )
+			{
+				pIDs[nFace++] = ppSolids[i]->GetFace( j )->GetFaceID();
+			}
+		}
+
+		bOK = MapCheck_CountIDs( pIDs, nFaces, pnEarlier, NULL );
+	}
+
+	if ( bOK )
+	{
+		int nFace = 0;
+		for ( int i = 0; i < nSolids; i++ )
+		{
+			if ( !IsChecked( ppSolids[i] ) )
+				continue;
+
+			for ( int j = 0; j < ppSolids[i]->GetFaceCount(); j++, nFace++ )
+			{
+				if ( pnEarlier[nFace] == 1 )
+				{
+					Report( ppSolids[i], ppSolids[i]->GetFace( j ) );
+				}
+			}
+		}
+	}
+
+	free( pIDs );
+	free( pnEarlier );
+	return bOK;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds every node entity whose nonzero node ID another node entity
+//			also uses.
+// Input  : Report - Called as Report( pEntity ).
+// Output : Returns false if out of memory.
+//-----------------------------------------------------------------------------
+template <class ENTITY, class FILTER, class REPORT>
+bool MapCheck_DuplicateNodeIDs( ENTITY *const *ppEntities, int nEntities, FILTER &IsChecked, REPORT &Report )
+{
+	int *pIDs = (int *)malloc( ( nEntities + 1 ) * sizeof( int ) );
+	int *pnIndex = (int *)malloc( ( nEntities + 1 ) * sizeof( int ) );
+	int *pnTotal = (int *)malloc( ( nEntities + 1 ) * sizeof( int ) );
+	bool bOK = ( pIDs && pnIndex && pnTotal );
+
+	int nNodes = 0;
+	if ( bOK )
+	{
+		for ( int i = 0; i < nEntities; i++ )
+		{
+			ENTITY *pEntity = ppEntities[i];
+			if ( !pEntity->IsNodeClass() || !IsChecked( pEntity ) )
+				continue;
+
+			int nNodeID = pEntity->GetNodeID();
+			if ( nNodeID != 0 )
+			{
+				pIDs[nNodes] = nNodeID;
+				pnIndex[nNodes] = i;
+				nNodes++;
+			}
+		}
+
+		bOK = MapCheck_CountIDs( pIDs, nNodes, NULL, pnTotal );
+	}
+
+	if ( bOK )
+	{
+		for ( int i = 0; i < nNodes; i++ )
+		{
+			if ( pnTotal[i] > 1 )
+			{
+				Report( ppEntities[pnIndex[i]] );
+			}
+		}
+	}
+
+	free( pIDs );
+	free( pnIndex );
+	free( pnTotal );
+	return bOK;
+}
+
+#endif // MAPCHECKCORE_H
@@ -0,0 +1,1204 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test and command line runner for the map checks in
+//			MapCheckCore.h. Models the map hierarchy, runs the checks the way
+//			RunMapChecks does, over the gathered solids and entities, and
+//			compares the results object for object with the checks as they
+//			were before the passes were fused. Those each walked the world
+//			with EnumChildren or GetFirstDescendent and are kept here as the
+//			reference, with the inverted test of the old face ID check the
+//			right way round.
+//
+//			With no arguments it checks random maps and a small VMF, then
+//			times both versions on a generated map. Given VMF files or
+//			directories of them, it loads each one, prints how long each
+//			check took and compares the results:
+//
+//			g++ -O2 MapCheckCore_test.cpp -o MapCheckCore_test && ./MapCheckCore_test [map.vmf | dir ...]
+//
+//			VMF loading keeps only what the checks read. Entities with no
+//			solids count as placeholders, solids stay in file order rather
+//			than in their groups, and objects in hidden blocks are hidden.
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include "MapCheckCore.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+struct Vector_t
+{
+	float x, y, z;
+
+	bool operator==( const Vector_t &Other ) const { return ( x == Other.x ) && ( y == Other.y ) && ( z == Other.z ); }
+};
+
+struct Object_t;
+
+//
+// Stands in for CMapFace.
+//
+struct Face_t
+{
+	int m_nFaceID;
+	Object_t *m_pSolid;
+	struct { char texture[260]; } texture;
+	struct { Vector_t normal; } plane;
+
+	int GetFaceID( void ) { return m_nFaceID; }
+};
+
+enum ObjectType_t
+{
+	OBJECT_WORLD = 0,
+	OBJECT_GROUP,
+	OBJECT_SOLID,
+	OBJECT_ENTITY,
+	OBJECT_HELPER,
+};
+
+//
+// Stands in for CMapClass and, depending on its type, CMapSolid or CMapEntity.
+//
+struct Object_t
+{
+	ObjectType_t m_eType;
+	bool m_bVisible;
+	std::vector<Object_t *> m_Children;
+
+	std::vector<Face_t> m_Faces;
+
+	std::string m_ClassName;
+	int m_nNodeID;
+
+	int GetFaceCount( void ) { return (int)m_Faces.size(); }
+	Face_t *GetFace( int nFace ) { return &m_Faces[nFace]; }
+
+	bool IsPlaceholder( void ) const
+	{
+		for ( size_t i = 0; i < m_Children.size(); i++ )
+		{
+			if ( m_Children[i]->m_eType == OBJECT_SOLID )
+				return false;
+		}
+		return true;
+	}
+
+	bool IsClass( const char *pszClass ) const { return !strcasecmp( pszClass, m_ClassName.c_str() ); }
+
+	// As GDclass::IsNodeClass.
+	bool IsNodeClass( void ) const
+	{
+		return !strncasecmp( m_ClassName.c_str(), "info_node", 9 ) && strcasecmp( m_ClassName.c_str(), "info_node_link" );
+	}
+
+	int GetNodeID( void ) const { return m_nNodeID; }
+};
+
+struct Map_t
+{
+	std::deque<Object_t> Objects;	// Objects[0] is the world.
+
+	Map_t( void ) { NewObject( OBJECT_WORLD, NULL ); }
+
+	Object_t *GetWorld( void ) { return &Objects[0]; }
+
+	Object_t *NewObject( ObjectType_t eType, Object_t *pParent )
+	{
+		Objects.push_back( Object_t() );
+		Object_t *pObject = &Objects.back();
+		pObject->m_eType = eType;
+		pObject->m_bVisible = true;
+		pObject->m_nNodeID = 0;
+		if ( pParent )
+		{
+			pParent->m_Children.push_back( pObject );
+		}
+		return pObject;
+	}
+
+	Face_t *NewFace( Object_t *pSolid, int nFaceID, const char *pszTexture, const Vector_t &Normal )
+	{
+		pSolid->m_Faces.push_back( Face_t() );
+		Face_t *pFace = &pSolid->m_Faces.back();
+		pFace->m_nFaceID = nFaceID;
+		pFace->m_pSolid = pSolid;
+		snprintf( pFace->texture.texture, sizeof( pFace->texture.texture ), "%s", pszTexture );
+		pFace->plane.normal = Normal;
+		return pFace;
+	}
+};
+
+// As Options.general.bCheckVisibleMapErrors.
+static bool s_bCheckVisibleOnly = false;
+
+static bool IsCheckVisible( const Object_t *pObject )
+{
+	return !s_bCheckVisibleOnly || pObject->m_bVisible;
+}
+
+struct CheckVisibleFilter_t
+{
+	bool operator()( const Object_t *pObject ) const { return IsCheckVisible( pObject ); }
+};
+
+enum MapCheck_t
+{
+	MAPCHECK_REQUIREMENTS = 0,
+	MAPCHECK_MIXEDFACES,
+	MAPCHECK_DUPLICATEPLANES,
+	MAPCHECK_DUPLICATEFACEIDS,
+	MAPCHECK_DUPLICATENODEIDS,
+
+	MAPCHECK_COUNT
+};
+
+static const char *s_pszCheckNames[MAPCHECK_COUNT] = { "requirements", "mixed faces", "duplicate planes", "duplicate face IDs", "duplicate node IDs" };
+
+//
+// One error, as the MapError the dialog lists would hold it.
+//
+struct Result_t
+{
+	const Object_t *pObject;
+	const Face_t *pFace;
+
+	bool operator==( const Result_t &Other ) const { return ( pObject == Other.pObject ) && ( pFace == Other.pFace ); }
+};
+
+typedef std::vector<Result_t> ResultList_t;
+
+struct CheckRun_t
+{
+	ResultList_t Results[MAPCHECK_COUNT];
+	double flMS[MAPCHECK_COUNT];
+	double flGatherMS;
+};
+
+static void AddResult( ResultList_t &List, const Object_t *pObject, const Face_t *pFace = NULL )
+{
+	Result_t Result = { pObject, pFace };
+	List.push_back( Result );
+}
+
+//-----------------------------------------------------------------------------
+// The checks as they were: each walks the world on its own.
+//-----------------------------------------------------------------------------
+
+// As CMapClass::EnumChildren: every descendent, parents before children.
+template <class FUNC>
+static void EnumChildren( Object_t *pParent, ObjectType_t eType, FUNC &Func )
+{
+	for ( size_t i = 0; i < pParent->m_Children.size(); i++ )
+	{
+		Object_t *pChild = pParent->m_Children[i];
+		if ( pChild->m_eType == eType )
+		{
+			Func( pChild );
+		}
+		EnumChildren( pChild, eType, Func );
+	}
+}
+
+// As CMapClass::GetFirstDescendent and GetNextDescendent: only descendents
+// with no children.
+static void GetLeafDescendents( Object_t *pParent, std::vector<Object_t *> &Leaves )
+{
+	for ( size_t i = 0; i < pParent->m_Children.size(); i++ )
+	{
+		Object_t *pChild = pParent->m_Children[i];
+		if ( pChild->m_Children.empty() )
+		{
+			Leaves.push_back( pChild );
+		}
+		else
+		{
+			GetLeafDescendents( pChild, Leaves );
+		}
+	}
+}
+
+struct OldFindPlaceholder_t
+{
+	const char *pszClass;
+	bool bFound;
+
+	void operator()( Object_t *pEntity )
+	{
+		if ( IsCheckVisible( pEntity ) && pEntity->IsPlaceholder() && pEntity->IsClass( pszClass ) )
+		{
+			bFound = true;
+		}
+	}
+};
+
+static void OldCheckRequirements( Map_t &Map, ResultList_t &List )
+{
+	OldFindPlaceholder_t Find = { "info_player_start", false };
+	EnumChildren( Map.GetWorld(), OBJECT_ENTITY, Find );
+	if ( !Find.bFound )
+	{
+		AddResult( List, NULL );
+	}
+}
+
+struct OldCheckMixedFaces_t
+{
+	ResultList_t *pList;
+
+	void operator()( Object_t *pSolid )
+	{
+		if ( !IsCheckVisible( pSolid ) )
+			return;
+
+		// run thru faces..
+		int iFaces = pSolid->GetFaceCount();
+		int iSolid = 2;	// start off ambivalent
+		int i;
+		for ( i = 0; i < iFaces; i++ )
+		{
+			char ch = pSolid->GetFace( i )->texture.texture[0];
+			if ( ( ch == '*' && iSolid == 1 ) || ( ch != '*' && iSolid == 0 ) )
+			{
+				break;
+			}
+			else iSolid = ( ch == '*' ) ? 0 : 1;
+		}
+
+		if ( i != iFaces )
+		{
+			AddResult( *pList, pSolid );
+		}
+	}
+};
+
+struct OldCheckDuplicatePlanes_t
+{
+	ResultList_t *pList;
+
+	void operator()( Object_t *pSolid )
+	{
+		if ( !IsCheckVisible( pSolid ) )
+			return;
+
+		int iFaces = pSolid->GetFaceCount();
+		for ( int i = 0; i < iFaces; i++ )
+		{
+			for ( int j = 0; j < iFaces; j++ )
+			{
+				if ( ( j != i ) && ( pSolid->GetFace( i )->plane.normal == pSolid->GetFace( j )->plane.normal ) )
+				{
+					AddResult( *pList, pSolid );
+					return;
+				}
+			}
+		}
+	}
+};
+
+// As CMapFaceList::FindFaceID.
+static int FindFaceID( const std::vector<Face_t *> &List, int nFaceID )
+{
+	for ( size_t i = 0; i < List.size(); i++ )
+	{
+		if ( List[i]->GetFaceID() == nFaceID )
+			return (int)i;
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// The old face ID check only added a face to the duplicates if its ID was
+// already among them, so it never reported anything. bFixedTest runs it with
+// that test the right way round, which is what the check now does.
+//-----------------------------------------------------------------------------
+struct OldCheckDuplicateFaceIDs_t
+{
+	bool bFixedTest;
+	std::vector<Face_t *> All;
+	std::vector<Face_t *> Duplicates;
+
+	void operator()( Object_t *pSolid )
+	{
+		if ( !IsCheckVisible( pSolid ) )
+			return;
+
+		for ( int i = 0; i < pSolid->GetFaceCount(); i++ )
+		{
+			Face_t *pFace = pSolid->GetFace( i );
+			if ( FindFaceID( All, pFace->GetFaceID() ) != -1 )
+			{
+				if ( ( FindFaceID( Duplicates, pFace->GetFaceID() ) != -1 ) != bFixedTest )
+				{
+					Duplicates.push_back( pFace );
+				}
+			}
+			else
+			{
+				All.push_back( pFace );
+			}
+		}
+	}
+};
+
+static void OldCheckDuplicateFaceIDs( Map_t &Map, ResultList_t &List, bool bFixedTest )
+{
+	OldCheckDuplicateFaceIDs_t Lists;
+	Lists.bFixedTest = bFixedTest;
+	EnumChildren( Map.GetWorld(), OBJECT_SOLID, Lists );
+
+	for ( size_t i = 0; i < Lists.Duplicates.size(); i++ )
+	{
+		AddResult( List, Lists.Duplicates[i]->m_pSolid, Lists.Duplicates[i] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The old node ID check walked only entities with no children. Node entities
+// with helpers have children, so since the check moved to the gathered
+// entities it also covers those. bLeavesOnly picks the old walk.
+//-----------------------------------------------------------------------------
+static void OldCheckDuplicateNodeIDs( Map_t &Map, ResultList_t &List, bool bLeavesOnly )
+{
+	std::vector<Object_t *> Candidates;
+	if ( bLeavesOnly )
+	{
+		GetLeafDescendents( Map.GetWorld(), Candidates );
+	}
+	else
+	{
+		struct Collect_t
+		{
+			std::vector<Object_t *> *pList;
+			void operator()( Object_t *pEntity ) { pList->push_back( pEntity ); }
+		} Collect = { &Candidates };
+		EnumChildren( Map.GetWorld(), OBJECT_ENTITY, Collect );
+	}
+
+	for ( size_t i = 0; i < Candidates.size(); i++ )
+	{
+		Object_t *pNode = Candidates[i];
+		if ( ( pNode->m_eType != OBJECT_ENTITY ) || !pNode->IsNodeClass() || !IsCheckVisible( pNode ) )
+			continue;
+
+		for ( size_t j = 0; j < Candidates.size(); j++ )
+		{
+			Object_t *pEntity = Candidates[j];
+			if ( ( pEntity->m_eType == OBJECT_ENTITY ) && IsCheckVisible( pEntity ) && ( pEntity != pNode ) && pEntity->IsNodeClass() )
+			{
+				int nNodeID1 = pNode->GetNodeID();
+				int nNodeID2 = pEntity->GetNodeID();
+				if ( ( nNodeID1 != 0 ) && ( nNodeID2 != 0 ) && ( nNodeID1 == nNodeID2 ) )
+				{
+					AddResult( List, pNode );
+					break;
+				}
+			}
+		}
+	}
+}
+
+static void RunOldChecks( Map_t &Map, CheckRun_t &Run )
+{
+	Run.flGatherMS = 0;
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	OldCheckRequirements( Map, Run.Results[MAPCHECK_REQUIREMENTS] );
+	Run.flMS[MAPCHECK_REQUIREMENTS] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	OldCheckMixedFaces_t Mixed = { &Run.Results[MAPCHECK_MIXEDFACES] };
+	EnumChildren( Map.GetWorld(), OBJECT_SOLID, Mixed );
+	Run.flMS[MAPCHECK_MIXEDFACES] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	OldCheckDuplicatePlanes_t Planes = { &Run.Results[MAPCHECK_DUPLICATEPLANES] };
+	EnumChildren( Map.GetWorld(), OBJECT_SOLID, Planes );
+	Run.flMS[MAPCHECK_DUPLICATEPLANES] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	OldCheckDuplicateFaceIDs( Map, Run.Results[MAPCHECK_DUPLICATEFACEIDS], true );
+	Run.flMS[MAPCHECK_DUPLICATEFACEIDS] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	OldCheckDuplicateNodeIDs( Map, Run.Results[MAPCHECK_DUPLICATENODEIDS], true );
+	Run.flMS[MAPCHECK_DUPLICATENODEIDS] = MS( Start );
+}
+
+//-----------------------------------------------------------------------------
+// The checks as RunMapChecks runs them, over one gathered list of solids and
+// one of entities.
+//-----------------------------------------------------------------------------
+
+// As GatherCheckObjects.
+static void GatherCheckObjects( Object_t *pParent, std::vector<Object_t *> &Solids, std::vector<Object_t *> &Entities )
+{
+	for ( size_t i = 0; i < pParent->m_Children.size(); i++ )
+	{
+		Object_t *pChild = pParent->m_Children[i];
+		if ( pChild->m_eType == OBJECT_SOLID )
+		{
+			Solids.push_back( pChild );
+		}
+		else if ( pChild->m_eType == OBJECT_ENTITY )
+		{
+			Entities.push_back( pChild );
+		}
+
+		if ( !pChild->m_Children.empty() )
+		{
+			GatherCheckObjects( pChild, Solids, Entities );
+		}
+	}
+}
+
+struct ReportFace_t
+{
+	ResultList_t *pList;
+	void operator()( Object_t *pSolid, Face_t *pFace ) const { AddResult( *pList, pSolid, pFace ); }
+};
+
+struct ReportEntity_t
+{
+	ResultList_t *pList;
+	void operator()( Object_t *pEntity ) const { AddResult( *pList, pEntity ); }
+};
+
+static void RunNewChecks( Map_t &Map, CheckRun_t &Run )
+{
+	CheckVisibleFilter_t IsChecked;
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	std::vector<Object_t *> Solids;
+	std::vector<Object_t *> Entities;
+	GatherCheckObjects( Map.GetWorld(), Solids, Entities );
+	Object_t *const *ppSolids = Solids.empty() ? NULL : &Solids[0];
+	Object_t *const *ppEntities = Entities.empty() ? NULL : &Entities[0];
+	Run.flGatherMS = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	if ( !MapCheck_HasPlaceholder( ppEntities, (int)Entities.size(), IsChecked, "info_player_start" ) )
+	{
+		AddResult( Run.Results[MAPCHECK_REQUIREMENTS], NULL );
+	}
+	Run.flMS[MAPCHECK_REQUIREMENTS] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < Solids.size(); i++ )
+	{
+		if ( IsCheckVisible( Solids[i] ) && MapCheck_HasMixedFaces( Solids[i] ) )
+		{
+			AddResult( Run.Results[MAPCHECK_MIXEDFACES], Solids[i] );
+		}
+	}
+	Run.flMS[MAPCHECK_MIXEDFACES] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < Solids.size(); i++ )
+	{
+		if ( IsCheckVisible( Solids[i] ) && MapCheck_HasDuplicatePlanes( Solids[i] ) )
+		{
+			AddResult( Run.Results[MAPCHECK_DUPLICATEPLANES], Solids[i] );
+		}
+	}
+	Run.flMS[MAPCHECK_DUPLICATEPLANES] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	ReportFace_t ReportFace = { &Run.Results[MAPCHECK_DUPLICATEFACEIDS] };
+	CHECK( MapCheck_DuplicateFaceIDs( ppSolids, (int)Solids.size(), IsChecked, ReportFace ) );
+	Run.flMS[MAPCHECK_DUPLICATEFACEIDS] = MS( Start );
+
+	Start = std::chrono::steady_clock::now();
+	ReportEntity_t ReportEntity = { &Run.Results[MAPCHECK_DUPLICATENODEIDS] };
+	CHECK( MapCheck_DuplicateNodeIDs( ppEntities, (int)Entities.size(), IsChecked, ReportEntity ) );
+	Run.flMS[MAPCHECK_DUPLICATENODEIDS] = MS( Start );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compares two runs check by check. Prints the first difference of
+//			each check that differs and returns how many differ.
+//-----------------------------------------------------------------------------
+static int CompareRuns( const char *pszMap, const CheckRun_t &Old, const CheckRun_t &New )
+{
+	int nDiffering = 0;
+	for ( int nCheck = 0; nCheck < MAPCHECK_COUNT; nCheck++ )
+	{
+		const ResultList_t &OldList = Old.Results[nCheck];
+		const ResultList_t &NewList = New.Results[nCheck];
+		if ( OldList == NewList )
+			continue;
+
+		size_t i = 0;
+		while ( ( i < OldList.size() ) && ( i < NewList.size() ) && ( OldList[i] == NewList[i] ) )
+		{
+			i++;
+		}
+
+		printf( "%s: %s differ: old found %d, new found %d, first difference at result %d\n",
+			pszMap, s_pszCheckNames[nCheck], (int)OldList.size(), (int)NewList.size(), (int)i );
+		nDiffering++;
+	}
+	return nDiffering;
+}
+
+//-----------------------------------------------------------------------------
+// Random maps
+//-----------------------------------------------------------------------------
+
+static const char *s_pszClasses[] = { "info_player_start", "info_node", "info_node_air", "info_node_link", "light", "func_detail", "trigger_once" };
+
+static Vector_t RandomNormal( void )
+{
+	// Few enough normals that solids often repeat one.
+	static const Vector_t Normals[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0.6f, 0.8f, 0 }, { 0, -0.6f, 0.8f } };
+	return Normals[RandomInt( 0, 7 )];
+}
+
+static void AddRandomSolid( Map_t &Map, Object_t *pParent, int nMaxFaceID )
+{
+	Object_t *pSolid = Map.NewObject( OBJECT_SOLID, pParent );
+	pSolid->m_bVisible = ( RandomInt( 0, 7 ) != 0 );
+
+	int nFaces = RandomInt( 0, 8 );
+	bool bLiquid = ( RandomInt( 0, 3 ) == 0 );
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		bool bMixed = ( RandomInt( 0, 15 ) == 0 );
+		Map.NewFace( pSolid, RandomInt( 1, nMaxFaceID ), ( bLiquid != bMixed ) ? "*water" : "brick/brickwall001", RandomNormal() );
+	}
+}
+
+static void AddRandomChildren( Map_t &Map, Object_t *pParent, int nDepth, int nMaxFaceID )
+{
+	int nChildren = RandomInt( 0, ( nDepth == 0 ) ? 30 : 4 );
+	for ( int i = 0; i < nChildren; i++ )
+	{
+		int nKind = RandomInt( 0, 9 );
+		if ( nKind < 5 )
+		{
+			AddRandomSolid( Map, pParent, nMaxFaceID );
+		}
+		else if ( ( nKind < 7 ) && ( nDepth < 3 ) )
+		{
+			Object_t *pGroup = Map.NewObject( OBJECT_GROUP, pParent );
+			AddRandomChildren( Map, pGroup, nDepth + 1, nMaxFaceID );
+		}
+		else
+		{
+			Object_t *pEntity = Map.NewObject( OBJECT_ENTITY, pParent );
+			pEntity->m_ClassName = s_pszClasses[RandomInt( 0, 6 )];
+			pEntity->m_bVisible = ( RandomInt( 0, 7 ) != 0 );
+			pEntity->m_nNodeID = RandomInt( 0, 12 );
+
+			int nSolids = ( RandomInt( 0, 2 ) == 0 ) ? RandomInt( 1, 3 ) : 0;
+			for ( int j = 0; j < nSolids; j++ )
+			{
+				AddRandomSolid( Map, pEntity, nMaxFaceID );
+			}
+
+			if ( RandomInt( 0, 3 ) == 0 )
+			{
+				Map.NewObject( OBJECT_HELPER, pEntity );
+			}
+		}
+	}
+}
+
+static bool HasEntityWithChildren( Map_t &Map )
+{
+	for ( size_t i = 0; i < Map.Objects.size(); i++ )
+	{
+		if ( ( Map.Objects[i].m_eType == OBJECT_ENTITY ) && !Map.Objects[i].m_Children.empty() )
+			return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// VMF loading
+//-----------------------------------------------------------------------------
+
+struct KeyValues_t
+{
+	std::string Name;
+	std::string Value;
+	std::vector<KeyValues_t> Blocks;
+	std::vector<std::pair<std::string, std::string> > Keys;
+
+	const char *GetValue( const char *pszKey ) const
+	{
+		for ( size_t i = 0; i < Keys.size(); i++ )
+		{
+			if ( !strcasecmp( Keys[i].first.c_str(), pszKey ) )
+				return Keys[i].second.c_str();
+		}
+		return NULL;
+	}
+};
+
+class CVMFTokenizer
+{
+public:
+
+	CVMFTokenizer( const char *pszText ) : m_pszText( pszText ) {}
+
+	// Returns false at the end of the text.
+	bool Next( std::string &Token, bool &bQuoted )
+	{
+		for ( ;; )
+		{
+			while ( *m_pszText && ( (unsigned char)*m_pszText <= ' ' ) )
+			{
+				m_pszText++;
+			}
+
+			if ( ( m_pszText[0] == '/' ) && ( m_pszText[1] == '/' ) )
+			{
+				while ( *m_pszText && ( *m_pszText != '\n' ) )
+				{
+					m_pszText++;
+				}
+				continue;
+			}
+			break;
+		}
+
+		if ( !*m_pszText )
+			return false;
+
+		Token.clear();
+		bQuoted = ( *m_pszText == '"' );
+		if ( bQuoted )
+		{
+			m_pszText++;
+			while ( *m_pszText && ( *m_pszText != '"' ) )
+			{
+				Token += *m_pszText++;
+			}
+			if ( *m_pszText )
+			{
+				m_pszText++;
+			}
+		}
+		else if ( ( *m_pszText == '{' ) || ( *m_pszText == '}' ) )
+		{
+			Token += *m_pszText++;
+		}
+		else
+		{
+			while ( ( (unsigned char)*m_pszText > ' ' ) && ( *m_pszText != '{' ) && ( *m_pszText != '}' ) && ( *m_pszText != '"' ) )
+			{
+				Token += *m_pszText++;
+			}
+		}
+		return true;
+	}
+
+private:
+
+	const char *m_pszText;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the keys and blocks up to the closing brace of a block, or
+//			to the end of the text. Returns false on a syntax error.
+//-----------------------------------------------------------------------------
+static bool ParseBlock( CVMFTokenizer &Tokenizer, KeyValues_t &Block, bool bTopLevel )
+{
+	std::string Token;
+	bool bQuoted;
+	while ( Tokenizer.Next( Token, bQuoted ) )
+	{
+		if ( !bQuoted && ( Token == "}" ) )
+			return !bTopLevel;
+
+		if ( !bQuoted && ( Token == "{" ) )
+			return false;
+
+		std::string Name = Token;
+		if ( !Tokenizer.Next( Token, bQuoted ) )
+			return false;
+
+		if ( !bQuoted && ( Token == "{" ) )
+		{
+			Block.Blocks.push_back( KeyValues_t() );
+			Block.Blocks.back().Name = Name;
+			if ( !ParseBlock( Tokenizer, Block.Blocks.back(), false ) )
+				return false;
+		}
+		else
+		{
+			Block.Keys.push_back( std::make_pair( Name, Token ) );
+		}
+	}
+	return bTopLevel;
+}
+
+// As GetNormalFromPoints.
+static Vector_t GetNormalFromPoints( const float *p0, const float *p1, const float *p2 )
+{
+	float v1[3] = { p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2] };
+	float v2[3] = { p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2] };
+	Vector_t Normal = { v1[1] * v2[2] - v1[2] * v2[1], v1[2] * v2[0] - v1[0] * v2[2], v1[0] * v2[1] - v1[1] * v2[0] };
+
+	float flLength = sqrtf( Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z );
+	if ( flLength > 0 )
+	{
+		Normal.x /= flLength;
+		Normal.y /= flLength;
+		Normal.z /= flLength;
+	}
+	return Normal;
+}
+
+static void LoadVMFSolid( Map_t &Map, Object_t *pParent, const KeyValues_t &Block, bool bVisible )
+{
+	Object_t *pSolid = Map.NewObject( OBJECT_SOLID, pParent );
+	pSolid->m_bVisible = bVisible;
+
+	for ( size_t i = 0; i < Block.Blocks.size(); i++ )
+	{
+		const KeyValues_t &Side = Block.Blocks[i];
+		if ( strcasecmp( Side.Name.c_str(), "side" ) )
+			continue;
+
+		const char *pszID = Side.GetValue( "id" );
+		const char *pszPlane = Side.GetValue( "plane" );
+		const char *pszMaterial = Side.GetValue( "material" );
+
+		float Points[3][3] = { { 0 } };
+		if ( pszPlane )
+		{
+			sscanf( pszPlane, "(%f %f %f) (%f %f %f) (%f %f %f)",
+				&Points[0][0], &Points[0][1], &Points[0][2],
+				&Points[1][0], &Points[1][1], &Points[1][2],
+				&Points[2][0], &Points[2][1], &Points[2][2] );
+		}
+
+		Map.NewFace( pSolid, pszID ? atoi( pszID ) : 0, pszMaterial ? pszMaterial : "", GetNormalFromPoints( Points[0], Points[1], Points[2] ) );
+	}
+}
+
+static void LoadVMFSolids( Map_t &Map, Object_t *pParent, const KeyValues_t &Block, bool bVisible )
+{
+	for ( size_t i = 0; i < Block.Blocks.size(); i++ )
+	{
+		const KeyValues_t &Child = Block.Blocks[i];
+		if ( !strcasecmp( Child.Name.c_str(), "solid" ) )
+		{
+			LoadVMFSolid( Map, pParent, Child, bVisible );
+		}
+		else if ( !strcasecmp( Child.Name.c_str(), "hidden" ) )
+		{
+			LoadVMFSolids( Map, pParent, Child, false );
+		}
+	}
+}
+
+static void LoadVMFEntity( Map_t &Map, const KeyValues_t &Block, bool bVisible )
+{
+	Object_t *pEntity = Map.NewObject( OBJECT_ENTITY, Map.GetWorld() );
+	pEntity->m_bVisible = bVisible;
+
+	const char *pszClass = Block.GetValue( "classname" );
+	pEntity->m_ClassName = pszClass ? pszClass : "";
+
+	const char *pszNodeID = Block.GetValue( "nodeid" );
+	pEntity->m_nNodeID = pszNodeID ? atoi( pszNodeID ) : 0;
+
+	LoadVMFSolids( Map, pEntity, Block, bVisible );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds a map from the text of a VMF. Returns false if it doesn't
+//			parse.
+//-----------------------------------------------------------------------------
+static bool LoadVMF( const char *pszText, Map_t &Map )
+{
+	KeyValues_t Root;
+	CVMFTokenizer Tokenizer( pszText );
+	if ( !ParseBlock( Tokenizer, Root, true ) )
+		return false;
+
+	for ( size_t i = 0; i < Root.Blocks.size(); i++ )
+	{
+		const KeyValues_t &Block = Root.Blocks[i];
+		if ( !strcasecmp( Block.Name.c_str(), "world" ) )
+		{
+			LoadVMFSolids( Map, Map.GetWorld(), Block, true );
+		}
+		else if ( !strcasecmp( Block.Name.c_str(), "entity" ) )
+		{
+			LoadVMFEntity( Map, Block, true );
+		}
+		else if ( !strcasecmp( Block.Name.c_str(), "hidden" ) )
+		{
+			for ( size_t j = 0; j < Block.Blocks.size(); j++ )
+			{
+				if ( !strcasecmp( Block.Blocks[j].Name.c_str(), "entity" ) )
+				{
+					LoadVMFEntity( Map, Block.Blocks[j], false );
+				}
+			}
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+
+static void TestCountIDs( void )
+{
+	const int IDs[] = { 7, 3, 7, 0, 3, 7, -2 };
+	const int nCount = sizeof( IDs ) / sizeof( IDs[0] );
+	int nEarlier[nCount];
+	int nTotal[nCount];
+
+	CHECK( MapCheck_CountIDs( IDs, nCount, nEarlier, nTotal ) );
+
+	const int nExpectedEarlier[] = { 0, 0, 1, 0, 1, 2, 0 };
+	const int nExpectedTotal[] = { 3, 2, 3, 1, 2, 3, 1 };
+	for ( int i = 0; i < nCount; i++ )
+	{
+		CHECK( nEarlier[i] == nExpectedEarlier[i] );
+		CHECK( nTotal[i] == nExpectedTotal[i] );
+	}
+
+	CHECK( MapCheck_CountIDs( NULL, 0, NULL, NULL ) );
+}
+
+static void TestRandomMaps( void )
+{
+	int nEntityChildMaps = 0;
+	for ( int nMap = 0; nMap < 500; nMap++ )
+	{
+		Map_t Map;
+		AddRandomChildren( Map, Map.GetWorld(), 0, RandomInt( 1, 400 ) );
+		s_bCheckVisibleOnly = ( RandomInt( 0, 1 ) != 0 );
+
+		CheckRun_t Old;
+		CheckRun_t New;
+		RunOldChecks( Map, Old );
+		RunNewChecks( Map, New );
+
+		char szName[32];
+		snprintf( szName, sizeof( szName ), "random map %d", nMap );
+
+		//
+		// Where node entities have helpers, the node ID check now finds what
+		// the old one would have if it had looked at them.
+		//
+		if ( HasEntityWithChildren( Map ) )
+		{
+			nEntityChildMaps++;
+			Old.Results[MAPCHECK_DUPLICATENODEIDS].clear();
+			OldCheckDuplicateNodeIDs( Map, Old.Results[MAPCHECK_DUPLICATENODEIDS], false );
+		}
+
+		CHECK( CompareRuns( szName, Old, New ) == 0 );
+	}
+	s_bCheckVisibleOnly = false;
+
+	CHECK( nEntityChildMaps > 0 );
+}
+
+static void TestLeafOnlyNodeIDs( void )
+{
+	// Two nodes with the same ID, one with a helper. The old walk never reached it.
+	Map_t Map;
+	Object_t *pNode1 = Map.NewObject( OBJECT_ENTITY, Map.GetWorld() );
+	pNode1->m_ClassName = "info_node";
+	pNode1->m_nNodeID = 5;
+	Object_t *pNode2 = Map.NewObject( OBJECT_ENTITY, Map.GetWorld() );
+	pNode2->m_ClassName = "info_node";
+	pNode2->m_nNodeID = 5;
+	Map.NewObject( OBJECT_HELPER, pNode2 );
+
+	CheckRun_t Old;
+	CheckRun_t New;
+	RunOldChecks( Map, Old );
+	RunNewChecks( Map, New );
+
+	CHECK( Old.Results[MAPCHECK_DUPLICATENODEIDS].empty() );
+	CHECK( New.Results[MAPCHECK_DUPLICATENODEIDS].size() == 2 );
+}
+
+static const char *s_pszTestVMF =
+	"versioninfo\n{\n\t\"editorversion\" \"400\"\n}\n"
+	"world\n{\n\t\"id\" \"1\"\n\t\"classname\" \"worldspawn\"\n"
+	"\tsolid\n\t{\n\t\t\"id\" \"2\"\n"
+	"\t\tside\n\t\t{\n\t\t\t\"id\" \"10\"\n\t\t\t\"plane\" \"(0 0 64) (0 64 64) (64 64 64)\"\n\t\t\t\"material\" \"BRICK/BRICKWALL001\"\n\t\t}\n"
+	"\t\tside\n\t\t{\n\t\t\t\"id\" \"11\"\n\t\t\t\"plane\" \"(0 64 0) (0 0 0) (64 0 0)\"\n\t\t\t\"material\" \"*WATER\"\n\t\t}\n"
+	"\t\tside\n\t\t{\n\t\t\t\"id\" \"12\"\n\t\t\t\"plane\" \"(0 0 64) (0 64 64) (64 64 64)\"\n\t\t\t\"material\" \"BRICK/BRICKWALL001\"\n\t\t}\n"
+	"\t}\n"
+	"\thidden\n\t{\n\t\tsolid\n\t\t{\n\t\t\t\"id\" \"3\"\n"
+	"\t\t\tside\n\t\t\t{\n\t\t\t\t\"id\" \"10\"\n\t\t\t\t\"plane\" \"(0 0 0) (0 64 0) (64 64 0)\"\n\t\t\t\t\"material\" \"*WATER\"\n\t\t\t}\n"
+	"\t\t}\n\t}\n"
+	"}\n"
+	"// Two nodes sharing an ID.\n"
+	"entity\n{\n\t\"id\" \"20\"\n\t\"classname\" \"info_node\"\n\t\"nodeid\" \"4\"\n\t\"origin\" \"0 0 0\"\n}\n"
+	"entity\n{\n\t\"id\" \"21\"\n\t\"classname\" \"info_node\"\n\t\"nodeid\" \"4\"\n\t\"origin\" \"64 0 0\"\n}\n"
+	"hidden\n{\n\tentity\n\t{\n\t\t\"id\" \"22\"\n\t\t\"classname\" \"info_player_start\"\n\t}\n}\n"
+	"cameras\n{\n\t\"activecamera\" \"-1\"\n}\n";
+
+static void TestVMF( void )
+{
+	Map_t Map;
+	CHECK( LoadVMF( s_pszTestVMF, Map ) );
+	CHECK( !LoadVMF( "world\n{\n", Map ) );
+
+	CheckRun_t Old;
+	CheckRun_t New;
+	RunOldChecks( Map, Old );
+	RunNewChecks( Map, New );
+	CHECK( CompareRuns( "test VMF", Old, New ) == 0 );
+
+	// The player start is there, and a solid with a liquid face and a repeated plane.
+	CHECK( New.Results[MAPCHECK_REQUIREMENTS].empty() );
+	CHECK( New.Results[MAPCHECK_MIXEDFACES].size() == 1 );
+	CHECK( New.Results[MAPCHECK_DUPLICATEPLANES].size() == 1 );
+	CHECK( New.Results[MAPCHECK_DUPLICATENODEIDS].size() == 2 );
+
+	// Face ID 10 is used twice. It is reported once, on the hidden solid,
+	// where the old check never reported it.
+	CHECK( ( New.Results[MAPCHECK_DUPLICATEFACEIDS].size() == 1 ) && ( New.Results[MAPCHECK_DUPLICATEFACEIDS][0].pFace->m_nFaceID == 10 ) );
+	ResultList_t Unfixed;
+	OldCheckDuplicateFaceIDs( Map, Unfixed, false );
+	CHECK( Unfixed.empty() );
+
+	// Only hidden objects are left out when checking visible objects only.
+	s_bCheckVisibleOnly = true;
+	CheckRun_t Visible;
+	RunNewChecks( Map, Visible );
+	CHECK( Visible.Results[MAPCHECK_REQUIREMENTS].size() == 1 );
+	CHECK( Visible.Results[MAPCHECK_MIXEDFACES].size() == 1 );
+	s_bCheckVisibleOnly = false;
+}
+
+//-----------------------------------------------------------------------------
+// Runner
+//-----------------------------------------------------------------------------
+
+static void PrintRun( const char *pszMap, Map_t &Map, const CheckRun_t &Old, const CheckRun_t &New )
+{
+	int nSolids = 0;
+	int nEntities = 0;
+	int nFaces = 0;
+	for ( size_t i = 0; i < Map.Objects.size(); i++ )
+	{
+		nSolids += ( Map.Objects[i].m_eType == OBJECT_SOLID );
+		nEntities += ( Map.Objects[i].m_eType == OBJECT_ENTITY );
+		nFaces += Map.Objects[i].GetFaceCount();
+	}
+
+	printf( "%s: %d solids, %d faces, %d entities\n", pszMap, nSolids, nFaces, nEntities );
+	printf( "  %-20s %10s %10s %8s\n", "check", "old ms", "new ms", "errors" );
+	printf( "  %-20s %10s %10.2f\n", "gather objects", "", New.flGatherMS );
+	for ( int nCheck = 0; nCheck < MAPCHECK_COUNT; nCheck++ )
+	{
+		printf( "  %-20s %10.2f %10.2f %8d\n", s_pszCheckNames[nCheck], Old.flMS[nCheck], New.flMS[nCheck], (int)New.Results[nCheck].size() );
+	}
+}
+
+static bool ReadFile( const char *pszPath, std::string &Text )
+{
+	FILE *fp = fopen( pszPath, "rb" );
+	if ( !fp )
+		return false;
+
+	char Buffer[65536];
+	size_t nRead;
+	while ( ( nRead = fread( Buffer, 1, sizeof( Buffer ), fp ) ) > 0 )
+	{
+		Text.append( Buffer, nRead );
+	}
+	fclose( fp );
+	return true;
+}
+
+static void FindVMFs( const std::string &Path, std::vector<std::string> &Files )
+{
+	struct stat Info;
+	if ( stat( Path.c_str(), &Info ) != 0 )
+	{
+		printf( "%s: not found\n", Path.c_str() );
+		g_nFailures++;
+		return;
+	}
+
+	if ( !S_ISDIR( Info.st_mode ) )
+	{
+		Files.push_back( Path );
+		return;
+	}
+
+	DIR *pDir = opendir( Path.c_str() );
+	if ( !pDir )
+		return;
+
+	std::vector<std::string> Names;
+	while ( struct dirent *pEntry = readdir( pDir ) )
+	{
+		Names.push_back( pEntry->d_name );
+	}
+	closedir( pDir );
+
+	std::sort( Names.begin(), Names.end() );
+	for ( size_t i = 0; i < Names.size(); i++ )
+	{
+		const std::string &Name = Names[i];
+		if ( ( Name == "." ) || ( Name == ".." ) )
+			continue;
+
+		std::string Child = Path + "/" + Name;
+		if ( ( stat( Child.c_str(), &Info ) == 0 ) && S_ISDIR( Info.st_mode ) )
+		{
+			FindVMFs( Child, Files );
+		}
+		else if ( ( Name.size() > 4 ) && !strcasecmp( Name.c_str() + Name.size() - 4, ".vmf" ) )
+		{
+			Files.push_back( Child );
+		}
+	}
+}
+
+static int RunCorpus( int nPaths, char **ppszPaths )
+{
+	std::vector<std::string> Files;
+	for ( int i = 0; i < nPaths; i++ )
+	{
+		FindVMFs( ppszPaths[i], Files );
+	}
+
+	double flOldTotal[MAPCHECK_COUNT] = { 0 };
+	double flNewTotal[MAPCHECK_COUNT] = { 0 };
+	double flGatherTotal = 0;
+	int nDiffering = 0;
+
+	for ( size_t i = 0; i < Files.size(); i++ )
+	{
+		const char *pszFile = Files[i].c_str();
+
+		std::string Text;
+		Map_t Map;
+		if ( !ReadFile( pszFile, Text ) || !LoadVMF( Text.c_str(), Map ) )
+		{
+			printf( "%s: could not load\n", pszFile );
+			g_nFailures++;
+			continue;
+		}
+
+		CheckRun_t Old;
+		CheckRun_t New;
+		RunOldChecks( Map, Old );
+		RunNewChecks( Map, New );
+		PrintRun( pszFile, Map, Old, New );
+		nDiffering += CompareRuns( pszFile, Old, New );
+
+		for ( int nCheck = 0; nCheck < MAPCHECK_COUNT; nCheck++ )
+		{
+			flOldTotal[nCheck] += Old.flMS[nCheck];
+			flNewTotal[nCheck] += New.flMS[nCheck];
+		}
+		flGatherTotal += New.flGatherMS;
+	}
+
+	printf( "%d maps\n", (int)Files.size() );
+	printf( "  %-20s %10s %10s\n", "total", "old ms", "new ms" );
+	printf( "  %-20s %10s %10.2f\n", "gather objects", "", flGatherTotal );
+	for ( int nCheck = 0; nCheck < MAPCHECK_COUNT; nCheck++ )
+	{
+		printf( "  %-20s %10.2f %10.2f\n", s_pszCheckNames[nCheck], flOldTotal[nCheck], flNewTotal[nCheck] );
+	}
+
+	if ( nDiffering != 0 )
+	{
+		printf( "%d check result(s) differ from the old checks\n", nDiffering );
+	}
+	return ( nDiffering != 0 ) || ( g_nFailures != 0 );
+}
+
+static void Benchmark( void )
+{
+	//
+	// 5,000 six sided solids, 1,000 entities of which 250 are nodes, and a
+	// few repeated face and node IDs.
+	//
+	Map_t Map;
+	int nFaceID = 1;
+	for ( int i = 0; i < 5000; i++ )
+	{
+		Object_t *pSolid = Map.NewObject( OBJECT_SOLID, Map.GetWorld() );
+		static const Vector_t Normals[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		for ( int j = 0; j < 6; j++ )
+		{
+			Map.NewFace( pSolid, ( RandomInt( 0, 999 ) == 0 ) ? 1 : nFaceID++, "brick/brickwall001", Normals[j] );
+		}
+	}
+
+	for ( int i = 0; i < 1000; i++ )
+	{
+		Object_t *pEntity = Map.NewObject( OBJECT_ENTITY, Map.GetWorld() );
+		pEntity->m_ClassName = ( i < 250 ) ? "info_node" : "light";
+		pEntity->m_nNodeID = ( i < 250 ) ? ( ( RandomInt( 0, 99 ) == 0 ) ? 1 : i + 1 ) : 0;
+	}
+
+	CheckRun_t Old;
+	CheckRun_t New;
+	RunOldChecks( Map, Old );
+	RunNewChecks( Map, New );
+	PrintRun( "generated map", Map, Old, New );
+	CHECK( CompareRuns( "generated map", Old, New ) == 0 );
+}
+
+int main( int argc, char **argv )
+{
+	if ( argc > 1 )
+	{
+		return RunCorpus( argc - 1, argv + 1 );
+	}
+
+	TestCountIDs();
+	TestRandomMaps();
+	TestLeafOnlyNodeIDs();
+	TestVMF();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All map check tests passed\n" );
+	Benchmark();
+	return g_nFailures != 0;
+}
@@ -20,6 +20,10 @@
 #include "hammer.h"
 #include "MapOverlay.h"
 #include "Selection.h"
+#include "EditorProfiler.h"
+#include "MapCheckCore.h"
+#include "tier1/utlhashtable.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -119,6 +123,8 @@ struct MapError
 	FIXCODE Fix;
 };
 
+typedef CUtlVector<MapError *> MapErrorList;
+
 //
 // Fix functions.
 //
@@ -168,6 +174,14 @@ inline bool IsCheckVisible( CMapClass *pClass )
 	return (Options.general.bCheckVisibleMapErrors == FALSE) || pClass->IsVisible();
 }
 
+//
+// Filter for the checks in MapCheckCore.h.
+//
+struct CheckVisibleFilter_t
+{
+	bool operator()(CMapClass *pClass) const { return IsCheckVisible( pClass ); }
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -660,13 +674,14 @@ static void AddErrorToListBox(CListBox *pList, MapError *pError)
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: 
+// Purpose: Adds an error to a result list. Safe to call from the check workers,
+//			as long as each one has its own list.
 // Input  : pList - 
 //			Type - 
 //			dwExtra - 
 //			... - 
 //-----------------------------------------------------------------------------
-static void AddError(CListBox *pList, MapErrorType Type, DWORD dwExtra, ...)
+static void AddError(MapErrorList *pList, MapErrorType Type, DWORD dwExtra, ...)
 {
 	MapError *pError = new MapError;
 	memset(pError, 0, sizeof(MapError));
@@ -770,62 +785,67 @@ static void AddError(CListBox *pList, MapErrorType Type, DWORD dwExtra, ...)
 
 	va_end(vl);
 
-	AddErrorToListBox(pList, pError);
+	pList->AddToTail(pError);
 }
 
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : pObject - 
-//			DWORD - 
-// Output : 
-//-----------------------------------------------------------------------------
-static BOOL FindPlayer(CMapEntity *pObject, DWORD)
+//
+// The objects the checks look at, gathered in one pass over the world so the
+// checks don't each walk it again.
+//
+struct MapCheckObjects_t
 {
-	if ( !IsCheckVisible( pObject ) )
-		return TRUE;
+	CUtlVector<CMapSolid *> Solids;			// In EnumChildren order.
+	CUtlVector<CMapEntity *> Entities;		// In EnumChildren order.
+};
 
-	if (pObject->IsPlaceholder() && pObject->IsClass("info_player_start"))
-	{
-		return(FALSE);
-	}
-	return(TRUE);
-}
-#ifdef SLE
 //-----------------------------------------------------------------------------
-//// SLE NEW - new 'Map Problems' types 
+// Purpose: Collects the descendents of an object in the order EnumChildren
+//			would visit them.
 //-----------------------------------------------------------------------------
-static BOOL FindTonemapController(CMapEntity *pObject, DWORD)
+static void GatherCheckObjects(CMapClass *pParent, MapCheckObjects_t &Objects)
 {
-	if (!IsCheckVisible(pObject))
-		return TRUE;
+	const CMapObjectList *pChildren = pParent->GetChildren();
 
-	if (pObject->IsPlaceholder() && pObject->IsClass("env_tonemap_controller"))
+	FOR_EACH_OBJ( *pChildren, pos )
 	{
-		return(FALSE);
+		CMapClass *pChild = pChildren->Element(pos);
+		if (!pChild)
+			continue;
+
+		if (pChild->IsMapClass(MAPCLASS_TYPE(CMapSolid)))
+		{
+			Objects.Solids.AddToTail((CMapSolid *)pChild);
+		}
+		else if (pChild->IsMapClass(MAPCLASS_TYPE(CMapEntity)))
+		{
+			Objects.Entities.AddToTail((CMapEntity *)pChild);
+		}
+
+		if (pChild->GetChildCount())
+		{
+			GatherCheckObjects(pChild, Objects);
+		}
 	}
-	return(TRUE);
 }
-#endif
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : pList - 
-//			pWorld - 
+//			Objects - 
 //-----------------------------------------------------------------------------
-static void CheckRequirements(CListBox *pList, CMapWorld *pWorld)
+static void CheckRequirements(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
+	CheckVisibleFilter_t IsChecked;
+
 	// ensure there's a player start .. 
-	if (pWorld->EnumChildren((ENUMMAPCHILDRENPROC)FindPlayer, 0, MAPCLASS_TYPE(CMapEntity)))
+	if (!MapCheck_HasPlaceholder(Objects.Entities.Base(), Objects.Entities.Count(), IsChecked, "info_player_start"))
 	{
-		// if rvl is !0, it was not stopped prematurely.. which means there is 
-		// NO player start.
 		AddError(pList, ErrorNoPlayerStart, 0);
 	}
 #ifdef SLE
 	// and a tonemap controller 
-	if (pWorld->EnumChildren((ENUMMAPCHILDRENPROC)FindTonemapController, 0, MAPCLASS_TYPE(CMapEntity)))
+	if (!MapCheck_HasPlaceholder(Objects.Entities.Base(), Objects.Entities.Count(), IsChecked, "env_tonemap_controller"))
 	{
-		// if rvl is !0, it was not stopped prematurely.. which means there is 
-		// NO player start.
 		AddError(pList, ErrorNoTonemapController, 0);
 	}
 #endif
@@ -837,92 +857,41 @@ static void CheckRequirements(CListBox *pList, CMapWorld *pWorld)
 //			pList - 
 // Output : 
 //-----------------------------------------------------------------------------
-static BOOL _CheckMixedFaces(CMapSolid *pSolid, CListBox *pList)
+static BOOL _CheckMixedFaces(CMapSolid *pSolid, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pSolid ) )
 		return TRUE;
 
-	// run thru faces..
-	int iFaces = pSolid->GetFaceCount();
-	int iSolid = 2;	// start off ambivalent
-	int i;
-	for(i = 0; i < iFaces; i++)
+	if (MapCheck_HasMixedFaces(pSolid))
 	{
-		CMapFace *pFace = pSolid->GetFace(i);
-
-		char ch = pFace->texture.texture[0];
-		if((ch == '*' && iSolid == 1) || (ch != '*' && iSolid == 0))
-		{
-			break;
-		}
-		else iSolid = (ch == '*') ? 0 : 1;
+		AddError(pList, ErrorMixedFace, 0, pSolid);
 	}
 
-	if(i == iFaces)	// all ok
-		return TRUE;
-
-	// NOT ok
-	AddError(pList, ErrorMixedFace, 0, pSolid);
-
 	return TRUE;
 }
 
-static void CheckMixedFaces(CListBox *pList, CMapWorld *pWorld)
+struct ReportDuplicateNodeID_t
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckMixedFaces, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
-}
+	MapErrorList *pList;
+	CMapWorld *pWorld;
 
-//-----------------------------------------------------------------------------
-// Purpose: Returns true if there is another node entity in the world with the
-//			same node ID as the given entity.
-// Input  : pNode - 
-//			pWorld - 
-//-----------------------------------------------------------------------------
-bool FindDuplicateNodeID(CMapEntity *pNode, CMapWorld *pWorld)
-{
-	if ( !IsCheckVisible( pNode ) )
-		return false;
-
-	EnumChildrenPos_t pos;
-	CMapClass *pChild = pWorld->GetFirstDescendent(pos);
-	while (pChild != NULL)
+	void operator()(CMapEntity *pEntity) const
 	{
-		CMapEntity *pEntity = dynamic_cast<CMapEntity *>(pChild);
-		if (pEntity && IsCheckVisible( pEntity ) && (pEntity != pNode) && pEntity->IsNodeClass())
-		{
-			int nNodeID1 = pNode->GetNodeID();
-			int nNodeID2 = pEntity->GetNodeID();
-			if ((nNodeID1 != 0) && (nNodeID2 != 0) && (nNodeID1 == nNodeID2))
-			{
-				return true;
-			}
-		}
-		
-		pChild = pWorld->GetNextDescendent(pos);
+		AddError(pList, ErrorDuplicateNodeIDs, (DWORD)pWorld, pEntity);
 	}
-
-	return false;
-}
+};
 
 //-----------------------------------------------------------------------------
 // Purpose: Checks for node entities with the same node ID.
 //-----------------------------------------------------------------------------
-static void CheckDuplicateNodeIDs(CListBox *pList, CMapWorld *pWorld)
+static void CheckDuplicateNodeIDs(MapErrorList *pList, const MapCheckObjects_t &Objects, CMapWorld *pWorld)
 {
-	EnumChildrenPos_t pos;
-	CMapClass *pChild = pWorld->GetFirstDescendent(pos);
-	while (pChild != NULL)
+	CheckVisibleFilter_t IsChecked;
+	ReportDuplicateNodeID_t Report = { pList, pWorld };
+
+	if (!MapCheck_DuplicateNodeIDs(Objects.Entities.Base(), Objects.Entities.Count(), IsChecked, Report))
 	{
-		CMapEntity *pEntity = dynamic_cast<CMapEntity *>(pChild);
-		if (pEntity && pEntity->IsNodeClass())
-		{
-			if (FindDuplicateNodeID(pEntity, pWorld))
-			{
-				AddError(pList, ErrorDuplicateNodeIDs, (DWORD)pWorld, pEntity);
-			}
-		}
-		
-		pChild = pWorld->GetNextDescendent(pos);
+		Warning("Map check: out of memory checking node IDs.\n");
 	}
 }
 
@@ -934,31 +903,7 @@ static void CheckDuplicateNodeIDs(CListBox *pList, CMapWorld *pWorld)
 //-----------------------------------------------------------------------------
 BOOL DoesContainDuplicates(CMapSolid *pSolid)
 {
-	int iFaces = pSolid->GetFaceCount();
-	for (int i = 0; i < iFaces; i++)
-	{
-		CMapFace *pFace = pSolid->GetFace(i);
-		Vector& pts1 = pFace->plane.normal;
-
-		for (int j = 0; j < iFaces; j++)
-		{
-			// Don't check self.
-			if (j == i)
-			{
-				continue;
-			}
-
-			CMapFace *pFace2 = pSolid->GetFace(j);
-			Vector& pts2 = pFace2->plane.normal;
-
-			if (pts1 == pts2)
-			{
-				return(TRUE);
-			}
-		}
-	}
-	
-	return(FALSE);
+	return MapCheck_HasDuplicatePlanes(pSolid) ? TRUE : FALSE;
 }
 
 //-----------------------------------------------------------------------------
@@ -967,7 +912,7 @@ BOOL DoesContainDuplicates(CMapSolid *pSolid)
 //			pList - 
 // Output : 
 //-----------------------------------------------------------------------------
-static BOOL _CheckDuplicatePlanes(CMapSolid *pSolid, CListBox *pList)
+static BOOL _CheckDuplicatePlanes(CMapSolid *pSolid, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pSolid ) )
 		return TRUE;
@@ -980,72 +925,42 @@ static BOOL _CheckDuplicatePlanes(CMapSolid *pSolid, CListBox *pList)
 	return(TRUE);
 }
 
-static void CheckDuplicatePlanes(CListBox *pList, CMapWorld *pWorld)
+static void CheckDuplicatePlanes(MapErrorList *pList, CMapWorld *pWorld)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckDuplicatePlanes, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
+	pWorld->EnumObjectsOfType(_CheckDuplicatePlanes, pList);
 }
 
-struct FindDuplicateFaceIDs_t
-{
-	CMapFaceList All;					// Collects all the face IDs in this map.
-	CMapFaceList Duplicates;			// Collects the duplicate face IDs in this map.
-};
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : pSolid - 
-//			pData - 
-// Output : Returns TRUE to continue enumerating.
-//-----------------------------------------------------------------------------
-static BOOL _CheckDuplicateFaceIDs(CMapSolid *pSolid, FindDuplicateFaceIDs_t *pData)
+struct ReportDuplicateFaceID_t
 {
-	if ( !IsCheckVisible( pSolid ) )
-		return TRUE;
+	MapErrorList *pList;
 
-	int nFaceCount = pSolid->GetFaceCount();
-	for (int i = 0; i < nFaceCount; i++)
+	void operator()(CMapSolid *pSolid, CMapFace *pFace) const
 	{
-		CMapFace *pFace = pSolid->GetFace(i);
-		if (pData->All.FindFaceID(pFace->GetFaceID()) != -1)
-		{
-			if (pData->Duplicates.FindFaceID(pFace->GetFaceID()) != -1)
-			{
-				pData->Duplicates.AddToTail(pFace);
-			}
-		}
-		else
-		{
-			pData->All.AddToTail(pFace);
-		}
+		AddError(pList, ErrorDuplicateFaceIDs, (DWORD)pFace, pSolid);
 	}
-
-	return(TRUE);
-}
+};
 
 //-----------------------------------------------------------------------------
-// Purpose: Reports errors for all faces with duplicate face IDs.
+// Purpose: Reports one error for each face ID used by more than one face, on
+//			the second face that uses it.
 // Input  : pList - 
-//			pWorld -  
+//			Objects -  
 //-----------------------------------------------------------------------------
-static void CheckDuplicateFaceIDs(CListBox *pList, CMapWorld *pWorld)
+static void CheckDuplicateFaceIDs(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
-	FindDuplicateFaceIDs_t Lists;
-	Lists.All.SetGrowSize(128);
-	Lists.Duplicates.SetGrowSize(128);
+	CheckVisibleFilter_t IsChecked;
+	ReportDuplicateFaceID_t Report = { pList };
 
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckDuplicateFaceIDs, (DWORD)&Lists, MAPCLASS_TYPE(CMapSolid));
-
-	for (int i = 0; i < Lists.Duplicates.Count(); i++)
+	if (!MapCheck_DuplicateFaceIDs(Objects.Solids.Base(), Objects.Solids.Count(), IsChecked, Report))
 	{
-		CMapFace *pFace = Lists.Duplicates.Element(i);
-		AddError(pList, ErrorDuplicateFaceIDs, (DWORD)pFace, (CMapSolid *)pFace->GetParent());
+		Warning("Map check: out of memory checking face IDs.\n");
 	}
 }
 
 //-----------------------------------------------------------------------------
 // Checks if a particular target is valid.
 //-----------------------------------------------------------------------------
-static void CheckValidTarget(CMapEntity *pEntity, const char *pFieldName, const char *pTargetName, CListBox *pList, bool bCheckClassNames)
+static void CheckValidTarget(CMapEntity *pEntity, const char *pFieldName, const char *pTargetName, MapErrorList *pList, bool bCheckClassNames)
 {
 	if (!pTargetName)
 		return;
@@ -1082,7 +997,7 @@ static void CheckValidTarget(CMapEntity *pEntity, const char *pFieldName, const
 //			pList - 
 // Output : Returns TRUE to keep enumerating.
 //-----------------------------------------------------------------------------
-static BOOL _CheckMissingTargets(CMapEntity *pEntity, CListBox *pList)
+static BOOL _CheckMissingTargets(CMapEntity *pEntity, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pEntity ) )
 		return TRUE;
@@ -1112,22 +1027,21 @@ static BOOL _CheckMissingTargets(CMapEntity *pEntity, CListBox *pList)
 	return TRUE;
 }
 
-static void CheckMissingTargets(CListBox *pList, CMapWorld *pWorld)
+static void CheckMissingTargets(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckMissingTargets, (DWORD)pList, MAPCLASS_TYPE(CMapEntity));
+	for (int i = 0; i < Objects.Entities.Count(); i++)
+	{
+		_CheckMissingTargets(Objects.Entities[i], pList);
+	}
 }
 
 //-----------------------------------------------------------------------------
 // Purpose: Determines whether a solid is good or bad.
 // Input  : pSolid - Solid to check.
-//			pList - List box into which to place errors.
-// Output : Always returns TRUE to continue enumerating.
+// Output : Returns true if every face of the solid is good.
 //-----------------------------------------------------------------------------
-static BOOL _CheckSolidIntegrity(CMapSolid *pSolid, CListBox *pList)
+static bool IsSolidValid(CMapSolid *pSolid)
 {
-	if ( !IsCheckVisible( pSolid ) )
-		return TRUE;
-
 	CCheckFaceInfo cfi;
 	int nFaces = pSolid->GetFaceCount();
 	for (int i = 0; i < nFaces; i++)
@@ -1144,18 +1058,53 @@ static BOOL _CheckSolidIntegrity(CMapSolid *pSolid, CListBox *pList)
 		//
 		if (!pFace->CheckFace(&cfi))
 		{
-			AddError(pList, ErrorSolidStructure, 0, pSolid);
-			pSolid->SetRenderColor(255, 100, 25);
-			break;
+			return false;
 		}
 	}
 
-	return(TRUE);
+	return true;
 }
 
-static void CheckSolidIntegrity(CListBox *pList, CMapWorld *pWorld)
+//
+// The result of the integrity check for each solid checked by the last run,
+// with the geometry revisions its faces had. A solid whose faces still have
+// those revisions is not checked again.
+//
+struct SolidIntegrity_t
+{
+	int nFirstRevision;			// Into s_IntegrityRevisions.
+	int nFaces;
+	bool bValid;
+};
+
+static CUtlHashtable<CMapSolid *, SolidIntegrity_t> s_IntegrityCache;
+static CUtlVector<unsigned int> s_IntegrityRevisions;
+
+//-----------------------------------------------------------------------------
+// Purpose: Looks up the integrity of a solid that hasn't changed since the
+//			last run. Only reads the cache, so the check workers can call it.
+// Output : Returns true if the cached result still applies.
+//-----------------------------------------------------------------------------
+static bool FindCachedIntegrity(CMapSolid *pSolid, bool &bValid)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckSolidIntegrity, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
+	UtlHashHandle_t h = s_IntegrityCache.Find(pSolid);
+	if (h == s_IntegrityCache.InvalidHandle())
+		return false;
+
+	const SolidIntegrity_t &Entry = s_IntegrityCache[h];
+
+	int nFaces = pSolid->GetFaceCount();
+	if (Entry.nFaces != nFaces)
+		return false;
+
+	for (int i = 0; i < nFaces; i++)
+	{
+		if (s_IntegrityRevisions[Entry.nFirstRevision + i] != pSolid->GetFace(i)->GetRevision())
+			return false;
+	}
+
+	bValid = Entry.bValid;
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1165,7 +1114,7 @@ static void CheckSolidIntegrity(CListBox *pList, CMapWorld *pWorld)
 // Output : 
 //-----------------------------------------------------------------------------
 #ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
-static BOOL _CheckSolidContents(CMapSolid *pSolid, CListBox *pList)
+static BOOL _CheckSolidContents(CMapSolid *pSolid, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pSolid ) )
 		return TRUE;
@@ -1189,13 +1138,6 @@ static BOOL _CheckSolidContents(CMapSolid *pSolid, CListBox *pList)
 	return TRUE;
 }
 
-static void CheckSolidContents(CListBox *pList, CMapWorld *pWorld)
-{
-	if (CMapDoc::GetActiveMapDoc() && CMapDoc::GetActiveMapDoc()->GetGame())
-	{
-		pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckSolidContents, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
-	}
-}
 #endif
 //-----------------------------------------------------------------------------
 // Purpose: Determines if there are any invalid textures or texture axes on any
@@ -1205,7 +1147,7 @@ static void CheckSolidContents(CListBox *pList, CMapWorld *pWorld)
 //			pList - Pointer to the error list box.
 // Output : Returns TRUE.
 //-----------------------------------------------------------------------------
-static BOOL _CheckInvalidTextures(CMapSolid *pSolid, CListBox *pList)
+static BOOL _CheckInvalidTextures(CMapSolid *pSolid, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pSolid ) )
 		return TRUE;
@@ -1252,10 +1194,6 @@ static BOOL _CheckInvalidTextures(CMapSolid *pSolid, CListBox *pList)
 	return(TRUE);
 }
 
-static void CheckInvalidTextures(CListBox *pList, CMapWorld *pWorld)
-{
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckInvalidTextures, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
-}
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -1263,7 +1201,7 @@ static void CheckInvalidTextures(CListBox *pList, CMapWorld *pWorld)
 //			pList - 
 // Output : 
 //-----------------------------------------------------------------------------
-static BOOL _CheckUnusedKeyvalues(CMapEntity *pEntity, CListBox *pList)
+static BOOL _CheckUnusedKeyvalues(CMapEntity *pEntity, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pEntity ) )
 		return TRUE;
@@ -1287,9 +1225,12 @@ static BOOL _CheckUnusedKeyvalues(CMapEntity *pEntity, CListBox *pList)
 	return(TRUE);
 }
 
-static void CheckUnusedKeyvalues(CListBox *pList, CMapWorld *pWorld)
+static void CheckUnusedKeyvalues(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckUnusedKeyvalues, (DWORD)pList, MAPCLASS_TYPE(CMapEntity));
+	for (int i = 0; i < Objects.Entities.Count(); i++)
+	{
+		_CheckUnusedKeyvalues(Objects.Entities[i], pList);
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -1298,7 +1239,7 @@ static void CheckUnusedKeyvalues(CListBox *pList, CMapWorld *pWorld)
 //			pList - 
 // Output : 
 //-----------------------------------------------------------------------------
-static BOOL _CheckEmptyEntities(CMapEntity *pEntity, CListBox *pList)
+static BOOL _CheckEmptyEntities(CMapEntity *pEntity, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pEntity ) )
 		return TRUE;
@@ -1311,9 +1252,12 @@ static BOOL _CheckEmptyEntities(CMapEntity *pEntity, CListBox *pList)
 	return(TRUE);
 }
 
-static void CheckEmptyEntities(CListBox *pList, CMapWorld *pWorld)
+static void CheckEmptyEntities(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckEmptyEntities, (DWORD)pList, MAPCLASS_TYPE(CMapEntity));
+	for (int i = 0; i < Objects.Entities.Count(); i++)
+	{
+		_CheckEmptyEntities(Objects.Entities[i], pList);
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -1322,7 +1266,7 @@ static void CheckEmptyEntities(CListBox *pList, CMapWorld *pWorld)
 //			pList - list box that tracks the errors
 // Output : Returns TRUE to keep enumerating.
 //-----------------------------------------------------------------------------
-static BOOL _CheckBadConnections(CMapEntity *pEntity, CListBox *pList)
+static BOOL _CheckBadConnections(CMapEntity *pEntity, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pEntity ) )
 		return TRUE;
@@ -1346,9 +1290,12 @@ static BOOL _CheckBadConnections(CMapEntity *pEntity, CListBox *pList)
 	return TRUE;
 }
 
-static void CheckBadConnections(CListBox *pList, CMapWorld *pWorld)
+static void CheckBadConnections(MapErrorList *pList, const MapCheckObjects_t &Objects)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckBadConnections, (DWORD)pList, MAPCLASS_TYPE(CMapEntity));
+	for (int i = 0; i < Objects.Entities.Count(); i++)
+	{
+		_CheckBadConnections(Objects.Entities[i], pList);
+	}
 }
 
 static bool HasVisGroupHiddenChildren(CMapClass *pObject)
@@ -1379,7 +1326,7 @@ static bool HasVisGroupShownChildren(CMapClass *pObject)
 //-----------------------------------------------------------------------------
 // Purpose: Makes sure that the visgroup assignments are valid.
 //-----------------------------------------------------------------------------
-static BOOL _CheckVisGroups(CMapClass *pObject, CListBox *pList)
+static BOOL _CheckVisGroups(CMapClass *pObject, MapErrorList *pList)
 {
 	CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
 
@@ -1435,7 +1382,7 @@ static BOOL _CheckVisGroups(CMapClass *pObject, CListBox *pList)
 	return TRUE;
 }
 
-static void CheckVisGroups(CListBox *pList, CMapWorld *pWorld)
+static void CheckVisGroups(MapErrorList *pList, CMapWorld *pWorld)
 {
 	pWorld->EnumChildrenRecurseGroupsOnly((ENUMMAPCHILDRENPROC)_CheckVisGroups, (DWORD)pList);
 }
@@ -1443,7 +1390,7 @@ static void CheckVisGroups(CListBox *pList, CMapWorld *pWorld)
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-static BOOL _CheckOverlayFaceList( CMapEntity *pEntity, CListBox *pList )
+static BOOL _CheckOverlayFaceList( CMapEntity *pEntity, MapErrorList *pList )
 {
 	if ( !IsCheckVisible( pEntity ) )
 		return TRUE;
@@ -1470,15 +1417,18 @@ static BOOL _CheckOverlayFaceList( CMapEntity *pEntity, CListBox *pList )
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-static void CheckOverlayFaceList( CListBox *pList, CMapWorld *pWorld )
+static void CheckOverlayFaceList( MapErrorList *pList, const MapCheckObjects_t &Objects )
 {
-	pWorld->EnumChildren( ( ENUMMAPCHILDRENPROC )_CheckOverlayFaceList, ( DWORD )pList, MAPCLASS_TYPE( CMapEntity ));
+	for ( int i = 0; i < Objects.Entities.Count(); i++ )
+	{
+		_CheckOverlayFaceList( Objects.Entities[i], pList );
+	}
 }
 #ifdef SLE
 //-----------------------------------------------------------------------------
 //// SLE NEW - new 'Map Problems' types  
 //-----------------------------------------------------------------------------
-static BOOL _CheckDisplacementsTiedToEntity(CMapEntity *pObject, CListBox *pList)
+static BOOL _CheckDisplacementsTiedToEntity(CMapEntity *pObject, MapErrorList *pList)
 {
 	const CMapObjectList *pChildren = pObject->GetChildren();
 
@@ -1495,12 +1445,12 @@ static BOOL _CheckDisplacementsTiedToEntity(CMapEntity *pObject, CListBox *pList
 	return(TRUE);
 }
 
-static void CheckDisplacementsTiedToEntity(CListBox *pList, CMapWorld *pWorld)
+static void CheckDisplacementsTiedToEntity(MapErrorList *pList, CMapWorld *pWorld)
 {
-	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckDisplacementsTiedToEntity, (DWORD)pList, MAPCLASS_TYPE(CMapEntity));
+	pWorld->EnumObjectsOfType(_CheckDisplacementsTiedToEntity, pList);
 }
 
-static BOOL _CheckDisplacementsNodraw(CMapSolid *pSolid, CListBox *pList)
+static BOOL _CheckDisplacementsNodraw(CMapSolid *pSolid, MapErrorList *pList)
 {
 	if ( !IsCheckVisible( pSolid ) )
 		return TRUE;
@@ -1521,11 +1471,210 @@ static BOOL _CheckDisplacementsNodraw(CMapSolid *pSolid, CListBox *pList)
 	return(TRUE);
 }
 
-static void CheckDisplacementsNodraw(CListBox *pList, CMapWorld *pWorld)
+static void CheckDisplacementsNodraw(MapErrorList *pList, CMapWorld *pWorld)
 {
 //	pWorld->EnumChildren((ENUMMAPCHILDRENPROC)_CheckDisplacementsNodraw, (DWORD)pList, MAPCLASS_TYPE(CMapSolid));
 }
 #endif
+
+//
+// The per-solid checks, which only read the solid they are given, run
+// together on the worker threads. Each check of each solid fills its own
+// list, and the lists are joined in solid order, so the errors come out the
+// same as when the checks ran one after another.
+//
+enum
+{
+	SOLIDCHECK_MIXEDFACES = 0,
+	SOLIDCHECK_INTEGRITY,
+#ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
+	SOLIDCHECK_CONTENTS,
+#endif
+	SOLIDCHECK_TEXTURES,
+
+	SOLIDCHECK_COUNT
+};
+
+struct SolidCheck_t
+{
+	CMapSolid *pSolid;
+	bool bCheckContents;
+	bool bIntegrityChecked;
+	bool bValid;
+	MapErrorList Errors[SOLIDCHECK_COUNT];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs every per-solid check on one solid. Called on worker threads.
+//-----------------------------------------------------------------------------
+static void RunSolidChecks(SolidCheck_t &Check)
+{
+	EDITOR_PROFILE_SCOPE( "RunSolidChecks" );
+
+	CMapSolid *pSolid = Check.pSolid;
+
+	_CheckMixedFaces(pSolid, &Check.Errors[SOLIDCHECK_MIXEDFACES]);
+
+	if ( IsCheckVisible( pSolid ) )
+	{
+		Check.bIntegrityChecked = true;
+		if (!FindCachedIntegrity(pSolid, Check.bValid))
+		{
+			Check.bValid = IsSolidValid(pSolid);
+		}
+
+		if (!Check.bValid)
+		{
+			AddError(&Check.Errors[SOLIDCHECK_INTEGRITY], ErrorSolidStructure, 0, pSolid);
+		}
+	}
+
+#ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
+	if (Check.bCheckContents)
+	{
+		_CheckSolidContents(pSolid, &Check.Errors[SOLIDCHECK_CONTENTS]);
+	}
+#endif
+
+	_CheckInvalidTextures(pSolid, &Check.Errors[SOLIDCHECK_TEXTURES]);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Moves the errors of one per-solid check to the result list.
+//-----------------------------------------------------------------------------
+static void AddSolidCheckErrors(MapErrorList *pList, CUtlVector<SolidCheck_t> &Checks, int nCheck)
+{
+	for (int i = 0; i < Checks.Count(); i++)
+	{
+		pList->AddVectorToTail(Checks[i].Errors[nCheck]);
+		Checks[i].Errors[nCheck].Purge();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Remembers the integrity results of this run for the next one.
+//-----------------------------------------------------------------------------
+static void UpdateIntegrityCache(const CUtlVector<SolidCheck_t> &Checks)
+{
+	s_IntegrityCache.RemoveAll();
+	s_IntegrityRevisions.RemoveAll();
+
+	for (int i = 0; i < Checks.Count(); i++)
+	{
+		if (!Checks[i].bIntegrityChecked)
+			continue;
+
+		CMapSolid *pSolid = Checks[i].pSolid;
+
+		SolidIntegrity_t Entry;
+		Entry.nFirstRevision = s_IntegrityRevisions.Count();
+		Entry.nFaces = pSolid->GetFaceCount();
+		Entry.bValid = Checks[i].bValid;
+
+		for (int nFace = 0; nFace < Entry.nFaces; nFace++)
+		{
+			s_IntegrityRevisions.AddToTail(pSolid->GetFace(nFace)->GetRevision());
+		}
+
+		s_IntegrityCache.Insert(pSolid, Entry);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Prints how long a check took when developer output is on, and
+//			starts timing the next one.
+//-----------------------------------------------------------------------------
+static void ReportCheckTime(const char *pszCheck, double &flStart)
+{
+	double flNow = Plat_FloatTime();
+	DevMsg("Map check: %-24s %8.2f ms\n", pszCheck, (flNow - flStart) * 1000.0);
+	flStart = flNow;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs every map check on a world and returns the errors found, in
+//			the order the dialog lists them. The caller owns the errors.
+//-----------------------------------------------------------------------------
+static void RunMapChecks(CMapWorld *pWorld, MapErrorList &Errors)
+{
+	EDITOR_PROFILE_SCOPE( "RunMapChecks" );
+
+	double flStart = Plat_FloatTime();
+	double flCheckStart = flStart;
+
+	MapCheckObjects_t Objects;
+	GatherCheckObjects(pWorld, Objects);
+	ReportCheckTime("gather objects", flCheckStart);
+
+	// Map validation
+	CheckRequirements(&Errors, Objects);
+	ReportCheckTime("requirements", flCheckStart);
+
+	// Solid validation
+	bool bCheckContents = false;
+#ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
+	bCheckContents = CMapDoc::GetActiveMapDoc() && CMapDoc::GetActiveMapDoc()->GetGame();
+#endif
+
+	CUtlVector<SolidCheck_t> SolidChecks;
+	SolidChecks.SetCount(Objects.Solids.Count());
+	for (int i = 0; i < SolidChecks.Count(); i++)
+	{
+		SolidChecks[i].pSolid = Objects.Solids[i];
+		SolidChecks[i].bCheckContents = bCheckContents;
+		SolidChecks[i].bIntegrityChecked = false;
+		SolidChecks[i].bValid = true;
+	}
+
+	ParallelProcess( "RunSolidChecks", SolidChecks.Base(), SolidChecks.Count(), &RunSolidChecks );
+	ReportCheckTime("solids (parallel)", flCheckStart);
+
+	AddSolidCheckErrors(&Errors, SolidChecks, SOLIDCHECK_MIXEDFACES);
+//	CheckDuplicatePlanes(&Errors, pWorld);
+	CheckDuplicateFaceIDs(&Errors, Objects);
+	ReportCheckTime("duplicate face IDs", flCheckStart);
+	CheckDuplicateNodeIDs(&Errors, Objects, pWorld);
+	ReportCheckTime("duplicate node IDs", flCheckStart);
+
+	for (int i = 0; i < SolidChecks.Count(); i++)
+	{
+		if (SolidChecks[i].Errors[SOLIDCHECK_INTEGRITY].Count())
+		{
+			SolidChecks[i].pSolid->SetRenderColor(255, 100, 25);
+		}
+	}
+	AddSolidCheckErrors(&Errors, SolidChecks, SOLIDCHECK_INTEGRITY);
+	UpdateIntegrityCache(SolidChecks);
+#ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
+	AddSolidCheckErrors(&Errors, SolidChecks, SOLIDCHECK_CONTENTS);
+#endif
+	AddSolidCheckErrors(&Errors, SolidChecks, SOLIDCHECK_TEXTURES);
+
+	// Entity validation
+	CheckUnusedKeyvalues(&Errors, Objects);
+	ReportCheckTime("unused keyvalues", flCheckStart);
+	CheckEmptyEntities(&Errors, Objects);
+	ReportCheckTime("empty entities", flCheckStart);
+	CheckMissingTargets(&Errors, Objects);
+	ReportCheckTime("missing targets", flCheckStart);
+	CheckBadConnections(&Errors, Objects);
+	ReportCheckTime("bad connections", flCheckStart);
+
+	CheckVisGroups(&Errors, pWorld);
+	ReportCheckTime("visgroups", flCheckStart);
+
+	CheckOverlayFaceList(&Errors, Objects);
+	ReportCheckTime("overlay face lists", flCheckStart);
+
+#ifdef SLE	//// SLE NEW - new 'Map Problems' types 
+//	CheckDisplacementsTiedToEntity(&Errors, pWorld);
+	CheckDisplacementsNodraw(&Errors, pWorld);
+#endif
+
+	DevMsg("Map check: %d solids, %d entities, %d errors in %.2f ms\n",
+		Objects.Solids.Count(), Objects.Entities.Count(), Errors.Count(), (Plat_FloatTime() - flStart) * 1000.0);
+}
+
 //
 // ** FIX FUNCTIONS
 //
@@ -1840,34 +1989,14 @@ bool CMapCheckDlg::DoCheck(void)
 	// Clear error list
 	KillErrorList();
 
-	// Map validation
-	CheckRequirements(&m_Errors, pWorld);
-
-	// Solid validation
-	CheckMixedFaces(&m_Errors, pWorld);
-//	CheckDuplicatePlanes(&m_Errors, pWorld);
-	CheckDuplicateFaceIDs(&m_Errors, pWorld);
-	CheckDuplicateNodeIDs(&m_Errors, pWorld);
-	CheckSolidIntegrity(&m_Errors, pWorld);
-#ifndef SLE //// SLE REMOVE - unused Quake 2, might return later if Quake modding becomes a goal
-	CheckSolidContents(&m_Errors, pWorld);
-#endif
-	CheckInvalidTextures(&m_Errors, pWorld);
-
-	// Entity validation
-	CheckUnusedKeyvalues(&m_Errors, pWorld);
-	CheckEmptyEntities(&m_Errors, pWorld);
-	CheckMissingTargets(&m_Errors, pWorld);
-	CheckBadConnections(&m_Errors, pWorld);
+	MapErrorList Errors;
+	RunMapChecks(pWorld, Errors);
 
-	CheckVisGroups(&m_Errors, pWorld);
+	for (int i = 0; i < Errors.Count(); i++)
+	{
+		AddErrorToListBox(&m_Errors, Errors[i]);
+	}
 
-	CheckOverlayFaceList(&m_Errors, pWorld);
-	
-#ifdef SLE	//// SLE NEW - new 'Map Problems' types 
-//	CheckDisplacementsTiedToEntity(&m_Errors, pWorld);
-	CheckDisplacementsNodraw(&m_Errors, pWorld);
-#endif
 	if (!m_Errors.GetCount())
 	{
 		AfxMessageBox("No errors were found.");
@@ -1878,6 +2007,24 @@ bool CMapCheckDlg::DoCheck(void)
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Runs every map check on a world without the dialog, for batch runs.
+// Output : Returns the number of problems found.
+//-----------------------------------------------------------------------------
+int CMapCheckDlg::CountProblems(CMapWorld *pWorld)
+{
+	if (!pWorld)
+		return 0;
+
+	MapErrorList Errors;
+	RunMapChecks(pWorld, Errors);
+
+	int nCount = Errors.Count();
+	Errors.PurgeAndDeleteElements();
+
+	return nCount;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
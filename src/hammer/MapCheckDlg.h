@@ -16,12 +16,17 @@
 #endif
 struct MapError;
 class CMapClass;
+class CMapWorld;
 
 class CMapCheckDlg : public CDialog
 {
 public:
 	static void CheckForProblems(CWnd *pwndParent);
 
+	// Runs the same checks without showing the dialog and returns how many
+	// problems were found.
+	static int CountProblems(CMapWorld *pWorld);
+
 private:
 	CMapCheckDlg(CWnd *pParent = NULL);
 	enum { IDD = IDD_MAPCHECK };
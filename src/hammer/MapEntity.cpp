@@ -50,27 +50,6 @@ bool CMapEntity::s_bShowEntityNames = true;
 bool CMapEntity::s_bShowEntityConnections = false;
 bool CMapEntity::s_bShowUnconnectedEntities = true;
 
-static CMapObjectList FoundEntities;
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : pEntity - 
-//			pKV - 
-// Output : 
-//-----------------------------------------------------------------------------
-static BOOL FindKeyValue(CMapEntity *pEntity, MDkeyvalue *pKV)
-{
-	LPCTSTR pszValue = pEntity->GetKeyValue(pKV->szKey);
-	if (!pszValue || strcmpi(pszValue, pKV->szValue))
-	{
-		return TRUE;
-	}
-
-	FoundEntities.AddToTail(pEntity);
-
-	return TRUE;
-}
-
 //-----------------------------------------------------------------------------
 // Purpose: Compares two entity names, allowing wildcards in EITHER string.
 //			Assumes that the wildcard character '*' marks the end of comparison,
@@ -810,11 +789,16 @@ void CMapEntity::SetOrigin(Vector& o)
 //-----------------------------------------------------------------------------
 void CMapEntity::RemoveHelpers(bool bRemoveSolids)
 {
+	CMapWorld *pWorld = GetWorldObject(this);
 	for( int pos=m_Children.Count()-1; pos>=0; pos-- )
 	{
 		CMapClass *pChild = m_Children[pos];
 		if (bRemoveSolids || ((dynamic_cast <CMapSolid *> (pChild)) == NULL))
 		{
+			if (pWorld != NULL)
+			{
+				pWorld->TypeList_RemoveTree(pChild);
+			}
 			m_Children.FastRemove(pos);
 		}
 		// LEAKLEAK: need to KeepForDestruction to avoid undo crashes, but how? where?
@@ -822,6 +806,36 @@ void CMapEntity::RemoveHelpers(bool bRemoveSolids)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Removes a helper that turned out to have nothing to draw, such as a
+//			studio model whose queued load failed, and adds the bounding box
+//			that AddHelpersForClass adds when it creates no visible helpers.
+// Input  : pHelper - The helper to remove.
+//-----------------------------------------------------------------------------
+void CMapEntity::RemoveFailedHelper(CMapClass *pHelper)
+{
+	// LEAKLEAK: not deleted, as in RemoveHelpers.
+	RemoveChild(pHelper, false);
+
+	//
+	// Solid children count as visual elements, as in AddHelpersForClass.
+	//
+	if (!IsPlaceholder())
+	{
+		return;
+	}
+
+	FOR_EACH_OBJ( m_Children, pos )
+	{
+		if (m_Children[pos]->IsVisualElement())
+		{
+			return;
+		}
+	}
+
+	AddBoundBoxForClass(GetClass(), false);
+}
+
 //-----------------------------------------------------------------------------
 // Building targetnames which deal with *
 //-----------------------------------------------------------------------------
@@ -1592,6 +1606,7 @@ void CMapEntity::OnKeyValueChanged(const char *pszKey, const char *pszOldValue,
 	//
 	else if (!stricmp(pszKey, "targetname") && (stricmp(pszOldValue, pszValue) != 0))
 	{
+		CEntityConnectionGraph::OnEntityChanged( this );
 		UpdateAllDependencies(this); //// SLE todo: fix how goddamn slow this is.
 	}
 #ifdef SLE_CACHE_FOG_PARAMS
@@ -2335,21 +2350,20 @@ void CMapEntity::Render2D(CRender2D *pRender)
 	{
 		LPCTSTR pszTarget = GetKeyValue("target");
 		
-		if (pszTarget != NULL)
+		CMapWorld *pWorld = GetWorldObject(this);
+		if ((pszTarget != NULL) && (pWorld != NULL))
 		{
-			CMapWorld *pWorld = GetWorldObject(this);
-			MDkeyvalue kv("targetname", pszTarget);
-
-			CMapObjectList FoundEntitiesTarget;
-			FoundEntitiesTarget.RemoveAll();
-			pWorld->EnumChildren((ENUMMAPCHILDRENPROC)FindKeyValue, (DWORD)&kv, MAPCLASS_TYPE(CMapEntity));
+			// Look the targets up in the world's name index rather than
+			// visiting every entity each frame.
+			CMapEntityList FoundEntitiesTarget;
+			pWorld->FindEntitiesByName(FoundEntitiesTarget, pszTarget, false);
 
 			Vector vCenter1,vCenter2;
 			GetBoundsCenter( vCenter1 );
 			
 			FOR_EACH_OBJ( FoundEntitiesTarget, p )
 			{
-				CMapClass *pEntity = (CMapEntity *)FoundEntitiesTarget.Element(p);
+				CMapEntity *pEntity = FoundEntitiesTarget.Element(p);
 				pEntity->GetBoundsCenter(vCenter2);
 				pRender->DrawLine( vCenter1, vCenter2 );
 			}
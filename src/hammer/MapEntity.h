@@ -278,6 +278,7 @@ private:
 	void AddHelper(CMapClass *pHelper, bool bLoading);
 	void AddHelpersForClass(GDclass *pClass, bool bLoading);
 	void RemoveHelpers(bool bRemoveSolids);
+	void RemoveFailedHelper(CMapClass *pHelper);
 	void UpdateHelpers(bool bLoading);
 
 	// Safely sets the move parent. Will assert and not set it if pEnt is equal to this ent,
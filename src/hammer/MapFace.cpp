@@ -25,6 +25,8 @@
 #include "camera.h"
 #include "options.h"
 #include "hammer.h"
+#include "FaceMeshCache.h"
+#include "FacePointPool.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -57,6 +59,10 @@ LPCTSTR GetDefaultTextureName();
 // Static member data initialization.
 //
 bool CMapFace::m_bShowFaceSelection = true;
+CInterlockedUInt CMapFace::s_nNextRevision;
+CFacePointPool *CMapFace::s_pLoadPointPool = NULL;
+
+COMPILE_TIME_ASSERT( FACEPOINT_SIZE == sizeof(Vector) + sizeof(Vector2D) + sizeof(Vector2D) );
 IEditorTexture *CMapFace::m_pLightmapGrid = NULL;
 
 //-----------------------------------------------------------------------------
@@ -100,7 +106,7 @@ CMapFace::CMapFace(void)
 	m_bIgnoreLighting = false;
 	m_fSmoothingGroups = SMOOTHING_GROUP_DEFAULT;
 	UpdateFaceFlags();
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 }
 
 //-----------------------------------------------------------------------------
@@ -109,14 +115,7 @@ CMapFace::CMapFace(void)
 CMapFace::~CMapFace(void)
 {
 	SignalUpdate( EVTYPE_FACE_CHANGED );
-	delete [] Points;
-	Points = NULL;
-
-	delete [] m_pTextureCoords;
-	m_pTextureCoords = NULL;
-
-	delete [] m_pLightmapCoords;
-	m_pLightmapCoords = NULL;
+	FreePoints();
 
 	delete m_pDetailObjects;
 	m_pDetailObjects = NULL;
@@ -219,7 +218,7 @@ void CMapFace::UpdateFaceFlags( void )
 //-----------------------------------------------------------------------------
 CMapFace *CMapFace::CopyFrom(const CMapFace *pObject, DWORD dwFlags, bool bUpdateDependencies)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	const CMapFace *pFrom = dynamic_cast<const CMapFace *>(pObject);
 	Assert(pFrom != NULL);
 
@@ -228,28 +227,9 @@ CMapFace *CMapFace::CopyFrom(const CMapFace *pObject, DWORD dwFlags, bool bUpdat
 		//
 		// Free our points first.
 		//
-		if (Points != NULL)
-		{
-			delete [] Points;
-			Points = NULL;
-		}
-
-		if (m_pTextureCoords != NULL)
-		{
-			delete [] m_pTextureCoords;
-			m_pTextureCoords = NULL;
-		}
-
-		if (m_pLightmapCoords != NULL)
-		{
-			delete [] m_pLightmapCoords;
-			m_pLightmapCoords = NULL;
-		}
-
+		FreePoints();
 		FreeTangentSpaceAxes();
 
-		nPoints = 0;
-
 		//
 		// Copy the member data.
 		//
@@ -359,6 +339,8 @@ void CMapFace::OnUndoRedo()
 	{
 		m_eSelectionState = SELECT_NONE;
 	}
+
+	BumpRevision();
 }
 
 //-----------------------------------------------------------------------------
@@ -368,7 +350,7 @@ void CMapFace::OnUndoRedo()
 //-----------------------------------------------------------------------------
 void CMapFace::CreateFace(Vector *pPoints, int _nPoints, bool bIsCordonFace)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	if (_nPoints > 0)
 	{
 		AllocatePoints(_nPoints);
@@ -1286,6 +1268,7 @@ void CMapFace::CalcPlane(void)
 	//
 	plane.normal = GetNormalFromPoints(plane.planepts[0], plane.planepts[1], plane.planepts[2]);
 	plane.dist = DotProduct(plane.planepts[0], plane.normal);
+	BumpRevision();
 }
 
 //-----------------------------------------------------------------------------
@@ -1355,7 +1338,7 @@ void CMapFace::DebugPoints(void)
 //-----------------------------------------------------------------------------
 void CMapFace::CreateFace(winding_t *w, int nFlags)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	AllocatePoints(w->numpoints);
 	for (int i = 0; i < nPoints; i++)
 	{
@@ -1433,6 +1416,8 @@ void CMapFace::CreateFace(winding_t *w, int nFlags)
 //-----------------------------------------------------------------------------
 size_t CMapFace::AllocatePoints(int _nPoints)
 {
+	BumpRevision();
+
 	//
 	// If we have already allocated this many points, do nothing.
 	//
@@ -1446,14 +1431,7 @@ size_t CMapFace::AllocatePoints(int _nPoints)
 	//
 	if (Points != NULL)
 	{
-		delete [] Points;
-		Points = NULL;
-
-		delete [] m_pTextureCoords;
-		m_pTextureCoords = NULL;
-
-		delete [] m_pLightmapCoords;
-		m_pLightmapCoords = NULL;
+		FreePoints();
 	}
 
 	Assert( nPoints == 0 || nPoints > 2 );
@@ -1466,18 +1444,87 @@ size_t CMapFace::AllocatePoints(int _nPoints)
 	}
 	
 	//
-	// Allocate the correct number of points, texture coords, and lightmap coords.
+	// Allocate the points, texture coords, and lightmap coords as one block
+	// from the face point pool.
 	//
-	Points = new Vector[nPoints];
-	m_pTextureCoords = new Vector2D[nPoints];
-	m_pLightmapCoords = new Vector2D[nPoints];
+	void *pData = GetPointPool()->Alloc(nPoints, this);
 
 	// dvs: check for failure here and report an out of memory error
-	Assert(Points != NULL);
-	Assert(m_pTextureCoords != NULL);
-	Assert(m_pLightmapCoords != NULL);
+	Assert(pData != NULL);
+
+	SetPointData(pData);
+
+	return(nPoints * FACEPOINT_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the pool to allocate our points from: our world's, the one
+//			being loaded into, or the one for faces that aren't in a world.
+//			Pools take no locks, so this is for the main thread only.
+//-----------------------------------------------------------------------------
+CFacePointPool *CMapFace::GetPointPool(void)
+{
+	Assert( ThreadInMainThread() );
+
+	CMapWorld *pWorld = CMapClass::GetWorldObject(m_pParent);
+	if (pWorld != NULL)
+	{
+		return pWorld->GetFacePointPool();
+	}
+
+	if (s_pLoadPointPool != NULL)
+	{
+		return s_pLoadPointPool;
+	}
 
-	return(nPoints * (sizeof(Vector) + sizeof(Vector2D) + sizeof(Vector2D)));
+	return &g_FacePointPool;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Points our points, texture coords and lightmap coords into a block
+//			from the face point pool.
+//-----------------------------------------------------------------------------
+void CMapFace::SetPointData(void *pData)
+{
+	byte *pBytes = (byte *)pData;
+
+	Points = (Vector *)pBytes;
+	m_pTextureCoords = (Vector2D *)(pBytes + nPoints * sizeof(Vector));
+	m_pLightmapCoords = m_pTextureCoords + nPoints;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called by a face point pool that moved a face's block.
+//-----------------------------------------------------------------------------
+void CMapFace::OnPointsMoved(void *pFace, void *pNewData)
+{
+	((CMapFace *)pFace)->SetPointData(pNewData);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sets the pool that faces of solids not yet in a world allocate
+//			from, for the length of a map load.
+// Output : Returns the pool that was set before.
+//-----------------------------------------------------------------------------
+CFacePointPool *CMapFace::SetLoadPointPool(CFacePointPool *pPool)
+{
+	CFacePointPool *pOldPool = s_pLoadPointPool;
+	s_pLoadPointPool = pPool;
+	return pOldPool;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees the points and the texture and lightmap coordinates, which
+//			share one block.
+//-----------------------------------------------------------------------------
+void CMapFace::FreePoints(void)
+{
+	CFacePointPool::Free(Points);
+
+	Points = NULL;
+	m_pTextureCoords = NULL;
+	m_pLightmapCoords = NULL;
+	nPoints = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -1486,7 +1533,7 @@ size_t CMapFace::AllocatePoints(int _nPoints)
 //-----------------------------------------------------------------------------
 void CMapFace::SetTexture(IEditorTexture *pTexture, bool bRescaleTextureCoordinates)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	if ( m_pTexture && pTexture && bRescaleTextureCoordinates )
 	{
 		float flXFactor = (float)m_pTexture->GetWidth() / pTexture->GetWidth();
@@ -1540,7 +1587,7 @@ void CMapFace::SetTexture(IEditorTexture *pTexture, bool bRescaleTextureCoordina
 //-----------------------------------------------------------------------------
 void CMapFace::SetTexture(const char *pszNewTex, bool bRescaleTextureCoordinates)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	IEditorTexture *pTexture = g_Textures.FindActiveTexture(pszNewTex);
 	SetTexture(pTexture, bRescaleTextureCoordinates);
 }
@@ -1589,6 +1636,8 @@ void CMapFace::CalcTextureCoords(void)
 	float s, t;
 	int i;
 
+	BumpRevision();
+
 	if (m_pTexture == NULL)
 	{
 		return;
@@ -2161,51 +2210,62 @@ void CMapFace::RenderGridsIfCloseEnough( CRender3D* pRender, int nCount, CMapFac
 	Render3DGrids( pRender, nFinalCount, ppFinalList );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Describes this face's vertices for FaceMesh_AddVertices.
+// Input  : face - Receives pointers into this face and color, which must
+//				outlive it.
+//			pPoints - Points to use instead of the face's own, or NULL.
+//-----------------------------------------------------------------------------
+void CMapFace::GetMeshFace( FaceMeshFace_t &face, const Color &color, const Vector *pPoints ) const
+{
+	COMPILE_TIME_ASSERT( sizeof( Vector ) == 3 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( Vector2D ) == 2 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( TangentSpaceAxes_t ) == 6 * sizeof( float ) );
+
+	face.m_nPoints = nPoints;
+	face.m_pPoints = (const float *)( pPoints ? pPoints : Points );
+	face.m_pNormal = plane.normal.Base();
+	face.m_pColor = (const unsigned char *)&color;
+	face.m_pTexCoords = (const float *)m_pTextureCoords;
+	face.m_pLightmapCoords = (const float *)m_pLightmapCoords;
+	face.m_pTangentAxes = (const float *)m_pTangentAxes;
+}
+
 //-----------------------------------------------------------------------------
 // Adds a face's vertices to the meshbuilder
 //-----------------------------------------------------------------------------
 void CMapFace::AddFaceVertices( CMeshBuilder &meshBuilder, CRender3D* pRender, bool bRenderSelected, SelectionState_t faceSelectionState)
 {
-	Vector point;
 	VMatrix frame;
 	Color color;
 
 	bool bHasParent = GetTransformMatrix( frame );
 	ComputeColor( pRender, bRenderSelected, faceSelectionState, m_bIgnoreLighting, color );
 
-	for ( int nPoint = 0; nPoint < nPoints; nPoint++ )
+	Vector *pPoints = NULL;
+	if ( bHasParent )
 	{
-		if ( bHasParent )
-		{
-			// transform into absolute space
-			VectorTransform( Points[nPoint], frame.As3x4(), point );
-			meshBuilder.Position3fv( point.Base() );
-		}
-		else
+		// transform into absolute space
+		pPoints = (Vector *)_alloca( nPoints * sizeof( Vector ) );
+		for ( int nPoint = 0; nPoint < nPoints; nPoint++ )
 		{
-			meshBuilder.Position3fv( Points[nPoint].Base() );
+			VectorTransform( Points[nPoint], frame.As3x4(), pPoints[nPoint] );
 		}
-
-		meshBuilder.Normal3fv( plane.normal.Base() );
-		meshBuilder.Color4ubv( (byte*)&color );
-
-		meshBuilder.TexCoord2fv( 0, m_pTextureCoords[nPoint].Base() );
-		meshBuilder.TexCoord2fv( 1, m_pLightmapCoords[nPoint].Base() );
-		meshBuilder.TangentS3fv( m_pTangentAxes[nPoint].tangent.Base() );
-		meshBuilder.TangentT3fv( m_pTangentAxes[nPoint].binormal.Base() );
-
-		meshBuilder.AdvanceVertex();
 	}
+
+	FaceMeshFace_t face;
+	GetMeshFace( face, color, pPoints );
+	FaceMesh_AddVertices( meshBuilder, face );
 }
 
-struct MapFaceRender_t
+//-----------------------------------------------------------------------------
+// Purpose: Bumps this face's revision and signals EVTYPE_FACE_CHANGED.
+//-----------------------------------------------------------------------------
+void CMapFace::SignalFaceChanged( void )
 {
-	bool m_RenderSelected;
-	EditorRenderMode_t m_RenderMode;
-	IEditorTexture* m_pTexture;
-	CMapFace* m_pMapFace;
-	SelectionState_t m_FaceSelectionState;
-};
+	BumpRevision();
+	SignalUpdate( EVTYPE_FACE_CHANGED );
+}
 
 typedef CUtlRBTree<MapFaceRender_t, int>	FaceQueue_t;
 
@@ -2267,33 +2327,56 @@ void CMapFace::RenderFacesBatch( CMeshBuilder &meshBuilder, IMesh* pMesh, CRende
 		pMapFace->AddFaceVertices( meshBuilder,	pRender, ppFaces[i]->m_RenderSelected, ppFaces[i]->m_FaceSelectionState );
 
 		int nPoints = pMapFace->GetPointCount();
+		FaceMesh_AddIndices( meshBuilder, nFirstVertex, nPoints, bWireframe );
+
+		nFirstVertex += nPoints;
+	}
+	
+	meshBuilder.End();
+	pMesh->Draw();
+}
+
+#if SLE_STATIC_FACE_MESH
+//-----------------------------------------------------------------------------
+// Draws a list of faces from the static face mesh cache.
+// Faces that can't be cached (parented faces move without changing revision)
+// are copied to ppUncachedFaces and their count returned.
+//-----------------------------------------------------------------------------
+int CMapFace::RenderCachedFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces, MapFaceRender_t **ppUncachedFaces, bool bWireframe )
+{
+	int nUncached = 0;
 
-		if ( bWireframe )
+	if ( !g_FaceMeshCache.BeginBatch( ppFaces[0]->m_pTexture, ppFaces[0]->m_RenderMode, bWireframe ) )
+	{
+		for ( int i = 0; i < nCount; ++i )
 		{
-			meshBuilder.FastIndex( nFirstVertex );
-			for ( int j = 1; j < nPoints; ++j )
-			{
-				meshBuilder.FastIndex( nFirstVertex + j );
-				meshBuilder.FastIndex( nFirstVertex + j );
-			}
-			meshBuilder.FastIndex( nFirstVertex );
+			ppUncachedFaces[ nUncached++ ] = ppFaces[i];
 		}
-		else
+
+		return nUncached;
+	}
+
+	VMatrix frame;
+	Color color;
+
+	for ( int i = 0; i < nCount; ++i )
+	{
+		CMapFace *pMapFace = ppFaces[i]->m_pMapFace;
+		if ( !pMapFace->GetTransformMatrix( frame ) && pMapFace->m_pTangentAxes )
 		{
-			for ( int j = 2; j < nPoints; ++j )
-			{
-				meshBuilder.FastIndex( nFirstVertex );
-				meshBuilder.FastIndex( nFirstVertex + j - 1 );
-				meshBuilder.FastIndex( nFirstVertex + j );
-			}
+			pMapFace->ComputeColor( pRender, ppFaces[i]->m_RenderSelected, ppFaces[i]->m_FaceSelectionState, pMapFace->m_bIgnoreLighting, color );
+			if ( g_FaceMeshCache.AddFace( pMapFace, color ) )
+				continue;
 		}
 
-		nFirstVertex += nPoints;
+		ppUncachedFaces[ nUncached++ ] = ppFaces[i];
 	}
-	
-	meshBuilder.End();
-	pMesh->Draw();
+
+	g_FaceMeshCache.EndBatch();
+
+	return nUncached;
 }
+#endif
 
 //-----------------------------------------------------------------------------
 // Draws a list of faces, breaking them up into batches if necessary.
@@ -2314,6 +2397,32 @@ void CMapFace::RenderFaces( CRender3D* pRender, int nCount, MapFaceRender_t **pp
 
 	pRender->PushRenderMode( ppFaces[0]->m_RenderMode );
 
+#if SLE_STATIC_FACE_MESH
+	MapFaceRender_t **ppUncachedFaces = (MapFaceRender_t**)_alloca( nCount * sizeof( MapFaceRender_t* ) );
+	int nUncached = RenderCachedFaces( pRender, nCount, ppFaces, ppUncachedFaces, bWireframe );
+	if ( nUncached )
+	{
+		RenderDynamicFaces( pRender, nUncached, ppUncachedFaces, bWireframe );
+	}
+#else
+	RenderDynamicFaces( pRender, nCount, ppFaces, bWireframe );
+#endif
+
+	//render additional wireframe stuff
+	if ( bWireframe )
+	{
+		RenderWireframeFaces( pRender, nCount, ppFaces );
+	}
+
+	pRender->PopRenderMode();
+}
+
+//-----------------------------------------------------------------------------
+// Draws a list of faces through the dynamic mesh, breaking them up into
+// batches if necessary.
+//-----------------------------------------------------------------------------
+void CMapFace::RenderDynamicFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces, bool bWireframe )
+{
 	int nBatchStart = 0;
 	int nIndexCount = 0;
 	int nVertexCount = 0;
@@ -2372,14 +2481,6 @@ void CMapFace::RenderFaces( CRender3D* pRender, int nCount, MapFaceRender_t **pp
 
 	// Render whatever is left over.
 	RenderFacesBatch( meshBuilder, pMesh, pRender, &ppFaces[nBatchStart], nCount - nBatchStart, nVertexCount, nIndexCount, bWireframe );
-	
-	//render additional wireframe stuff
-	if ( bWireframe )
-	{
-		RenderWireframeFaces( pRender, nCount, ppFaces );
-	}
-
-	pRender->PopRenderMode();
 }
 
 //-----------------------------------------------------------------------------
@@ -2527,6 +2628,10 @@ void CMapFace::RenderOpaqueFaces( CRender3D* pRender )
 #endif
 	CMatRenderContextPtr pRenderContext( MaterialSystemInterface() );
 
+#if SLE_STATIC_FACE_MESH
+	g_FaceMeshCache.BeginPass();
+#endif
+
 	MapFaceRender_t **ppMapFaces = (MapFaceRender_t**)_alloca( g_CurrentOpaqueFaces->Count() * sizeof( MapFaceRender_t* ) );
 	int nFaceCount = 0;
 
@@ -2897,7 +3002,7 @@ void CMapFace::Render3DGrid(CRender3D *pRender)
 //-----------------------------------------------------------------------------
 ChunkFileResult_t CMapFace::LoadDispInfoCallback(CChunkFile *pFile, CMapFace *pFace)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	// allocate a displacement (for the face)
 	EditDispHandle_t dispHandle = EditDispMgr()->Create();
 	CMapDisp *pDisp = EditDispMgr()->GetDisp( dispHandle );	
@@ -2933,7 +3038,7 @@ ChunkFileResult_t CMapFace::LoadDispInfoCallback(CChunkFile *pFile, CMapFace *pF
 //-----------------------------------------------------------------------------
 ChunkFileResult_t CMapFace::LoadKeyCallback(const char *szKey, const char *szValue, LoadFace_t *pLoadFace)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	CMapFace *pFace = pLoadFace->pFace;
 
 	if (!stricmp(szKey, "id"))
@@ -3002,7 +3107,7 @@ ChunkFileResult_t CMapFace::LoadKeyCallback(const char *szKey, const char *szVal
 //-----------------------------------------------------------------------------
 ChunkFileResult_t CMapFace::LoadVMF(CChunkFile *pFile)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	//
 	// Set up handlers for the subchunks that we are interested in.
 	//
@@ -3039,7 +3144,11 @@ ChunkFileResult_t CMapFace::LoadVMF(CChunkFile *pFile)
 //-----------------------------------------------------------------------------
 void CMapFace::OnAddToWorld(CMapWorld *pWorld)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
+
+	// Faces built outside the world move their points into the world's pool.
+	pWorld->GetFacePointPool()->Adopt(Points);
+
 	if (HasDisp())
 	{
 		//
@@ -3061,7 +3170,7 @@ void CMapFace::OnAddToWorld(CMapWorld *pWorld)
 //-----------------------------------------------------------------------------
 void CMapFace::OnRemoveFromWorld(void)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	if (HasDisp())
 	{
 		//
@@ -3194,6 +3303,7 @@ void CMapFace::SetTextureCoords(int nPoint, float u, float v)
 	{
 		m_pTextureCoords[nPoint][0] = u;
 		m_pTextureCoords[nPoint][1] = v;
+		BumpRevision();
 	}
 }
 
@@ -3393,6 +3503,8 @@ bool CMapFace::TraceLineInside( Vector &HitPos, Vector &HitNormal,
 //-----------------------------------------------------------------------------
 void CMapFace::CalcTangentSpaceAxes( void )
 {
+	BumpRevision();
+
 	// destroy old axes if need be
 	FreeTangentSpaceAxes();
 
@@ -3619,7 +3731,7 @@ void CMapFaceIDList::Intersect(CMapFaceIDList &IntersectWith, CMapFaceIDList &In
 
 void CMapFace::DoTransform(const VMatrix &matrix)
 {
-	SignalUpdate( EVTYPE_FACE_CHANGED );
+	SignalFaceChanged();
 	if( nPoints < 3 )
 	{
 		Assert( nPoints > 2 );
@@ -20,6 +20,7 @@
 #include "DispManager.h"
 #include "mathlib/Vector4d.h"
 #include "utlvector.h"
+#include "tier0/threadtools.h"
 #include "Color.h"
 #include "smoothinggroupmgr.h"
 #include "detailobjects.h"
@@ -32,9 +33,12 @@ class CChunkFile;
 class CSaveInfo;
 class IMaterial;
 class CMapWorld;
+class CMapFace;
+class CFacePointPool;
 struct MapFaceRender_t;
 class CMeshBuilder;
 class IMesh;
+struct FaceMeshFace_t;
 
 struct LoadFace_t;
 
@@ -213,6 +217,24 @@ struct TEXTURE
 #define FACE_FLAGS_NOSHADOW 1
 #define FACE_FLAGS_NODRAW_IN_LPREVIEW 2
 
+//
+// When set, queued opaque faces are drawn from persistent per-material static
+// meshes (see FaceMeshCache.h) instead of being rebuilt every frame.
+//
+#define SLE_STATIC_FACE_MESH 1
+
+//
+// An entry in the sorted opaque face queue.
+//
+struct MapFaceRender_t
+{
+	bool m_RenderSelected;
+	EditorRenderMode_t m_RenderMode;
+	IEditorTexture* m_pTexture;
+	CMapFace* m_pMapFace;
+	SelectionState_t m_FaceSelectionState;
+};
+
 class CMapFace : public CMapAtom
 {
 public:
@@ -286,6 +308,7 @@ public:
 	void CreateFace(winding_t *w, int nFlags = 0);
 	CMapFace *CopyFrom(const CMapFace *pFrom, DWORD dwFlags = COPY_FACE_POINTS, bool bUpdateDependencies = true );
 	size_t AllocatePoints(int nPoints);
+	void FreePoints(void);
 
 	void OnUndoRedo();
 
@@ -316,6 +339,13 @@ public:
 
 	static void SetShowSelection(bool bShowSelection);
 
+	// Faces allocate their points from their world's pool, or from this one
+	// while their solid is being loaded into a world. Returns the old one.
+	static CFacePointPool *SetLoadPointPool(CFacePointPool *pPool);
+
+	// Tells a face that its pool moved its points.
+	static void OnPointsMoved(void *pFace, void *pNewData);
+
 	inline void SetRenderAlpha(unsigned char uchAlpha) { m_uchAlpha = uchAlpha; } // HACK: should be in CMapAtom
 
 	inline void GetFaceNormal( Vector& normal );
@@ -345,6 +375,15 @@ public:
 	// Indicates this guy should be unlit
 	void RenderUnlit( bool enable );
 
+	// Geometry revision, bumped whenever anything that ends up in the face's
+	// vertices changes. Revisions are unique across all faces.
+	inline unsigned int GetRevision( void ) const { return m_nRevision; }
+	void SignalFaceChanged( void );
+
+	// Describes this face's vertices with the given color, in object space
+	// unless other points are passed.
+	void GetMeshFace( FaceMeshFace_t &face, const Color &color, const Vector *pPoints = NULL ) const;
+
 	// (begin serialized information
 	TEXTURE texture;					// Texture info.
 	Vector *Points;						// Array of face points, dynamically allocated.
@@ -383,6 +422,10 @@ protected:
 	static void RenderWireframeFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces );
 	static void RenderFacesBatch( CMeshBuilder &MeshBuilder, IMesh* pMesh, CRender3D* pRender, MapFaceRender_t **ppFaces, int nFaceCount, int nVertexCount, int nIndexCount, bool bWireframe );
 	static void RenderFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces );
+	static void RenderDynamicFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces, bool bWireframe );
+#if SLE_STATIC_FACE_MESH
+	static int RenderCachedFaces( CRender3D* pRender, int nCount, MapFaceRender_t **ppFaces, MapFaceRender_t **ppUncachedFaces, bool bWireframe );
+#endif
 #ifdef SLE
 	void RenderFace3D( CRender3D* pRender, Vector& viewPoint, EditorRenderMode_t renderMode, bool renderSelected, SelectionState_t faceSelectionState );
 #else
@@ -416,6 +459,16 @@ protected:
 
 	unsigned int		m_fSmoothingGroups;		// 32-bits representing 32 smoothing groups
 
+	unsigned int		m_nRevision;			// Geometry revision, see GetRevision.
+	static CInterlockedUInt	s_nNextRevision;	// Faces can be changed from worker threads.
+
+	static CFacePointPool *s_pLoadPointPool;	// See SetLoadPointPool.
+
+	CFacePointPool *GetPointPool(void);
+	void SetPointData(void *pData);
+
+	inline void BumpRevision( void ) { m_nRevision = ++s_nNextRevision; }
+
 	void UpdateFaceFlags( void );							// sniff face flags from texture
 #ifdef SLE //// SLE NEW - functions to get adjacent/neighbouring faces of this face
 public:
@@ -455,6 +508,7 @@ inline void CMapFace::SetLightmapCoord( const Vector2D &LightmapCoord, int nInde
 	Assert( nIndex < nPoints );
 	m_pLightmapCoords[nIndex][0] = LightmapCoord[0];
 	m_pLightmapCoords[nIndex][1] = LightmapCoord[1];
+	BumpRevision();
 }
 
 //-----------------------------------------------------------------------------
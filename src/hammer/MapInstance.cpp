@@ -28,6 +28,7 @@
 #include "camera.h"
 #include "MapWorld.h"
 #include "mapview.h"
+#include "InstanceCache.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -160,7 +161,7 @@ CMapInstance::CMapInstance( const char *pszBaseFileName, const char *pszInstance
 {
 	Initialize();
 
-	if ( pszInstanceFileName[ 0 ] && DeterminePath( pszBaseFileName, pszInstanceFileName, m_FileName ) )
+	if ( pszInstanceFileName[ 0 ] && g_InstanceCache.ResolvePath( pszBaseFileName, pszInstanceFileName, m_FileName ) )
 	{
 		bool	bSaveVisible = CHammer::IsNewDocumentVisible();
 		CMapDoc	*activeDoc = CMapDoc::GetActiveMapDoc();
@@ -170,7 +171,7 @@ CMapInstance::CMapInstance( const char *pszBaseFileName, const char *pszInstance
 		if ( Options.general.bEnableInstancesLoading )
 #endif
 		{
-			m_pInstancedMap = ( CMapDoc * )APP()->OpenDocumentFile(m_FileName);
+			m_pInstancedMap = g_InstanceCache.OpenInstance( m_FileName );
 		}
 		if ( m_pInstancedMap )
 		{
@@ -334,7 +335,7 @@ bool CMapInstance::OnApply( void )
 
 			CHammer::SetIsNewDocumentVisible( false );
 			strcpy( m_FileName, FileName );
-			m_pInstancedMap = ( CMapDoc * )APP()->OpenDocumentFile( m_FileName );
+			m_pInstancedMap = g_InstanceCache.OpenInstance( m_FileName );
 
 			CHammer::SetIsNewDocumentVisible( bSaveVisible );
 		}
@@ -25,6 +25,7 @@
 #include "ChunkFile.h"
 #include "mapview.h"
 #include "options.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -43,6 +44,8 @@ IMPLEMENT_MAPCLASS( CMapOverlay )
 #define OVERLAY_DISPSPACE_EPSILON		0.000001f
 #define OVERLAY_BARYCENTRIC_EPSILON		0.001f
 
+#define OVERLAY_PARALLEL_CLIP_FACES		8			// Clip this many faces or more on worker threads.
+
 #define OVERLAY_BLENDTYPE_VERT			0
 #define OVERLAY_BLENDTYPE_EDGE			1
 #define OVERLAY_BLENDTYPE_BARY			2
@@ -1308,6 +1311,7 @@ CMapOverlay::CMapOverlay() : CMapSideList( "sides" )
 
 	m_bLoaded = false;
 	m_pOverlayFace = NULL;
+	m_bClipKeyValid = false;
 	m_uiFlags = 0;
 }
 
@@ -1317,7 +1321,8 @@ CMapOverlay::CMapOverlay() : CMapSideList( "sides" )
 CMapOverlay::~CMapOverlay()
 {
 	ClipFace_Destroy( &m_pOverlayFace );
-	m_aRenderFaces.PurgeAndDeleteElements();
+	m_aRenderFaces.Purge();
+	m_FaceClips.Purge();
 }
 
 //-----------------------------------------------------------------------------
@@ -1885,6 +1890,12 @@ void CMapOverlay::Render3D( CRender3D *pRender )
 //-----------------------------------------------------------------------------
 // Purpose: Clip the overlay "face" to all of the faces in the overlay sidelist.
 //          The sidelist defines all faces affected by the "overlay."
+//
+//          The clip against each face is cached with the face's geometry
+//          revision. While the overlay itself is unchanged, only faces that
+//          were modified (or are new to the sidelist) are clipped again.
+//          Faces that have or had a displacement are always clipped again,
+//          since sculpting, adding or removing one does not change the face.
 //-----------------------------------------------------------------------------
 void CMapOverlay::DoClip( void )
 {
@@ -1893,20 +1904,108 @@ void CMapOverlay::DoClip( void )
 	if( nFaceCount == 0 )
 		return;
 
-	// Destroy the render face cache.
-	m_aRenderFaces.Purge();
+	PreClip();
+	if ( !m_pOverlayFace )
+		return;
 
-	// clip the overlay against all faces in the sidelist
-	for ( int iFace = 0; iFace < nFaceCount; iFace++ )
+	// Clips made with a different overlay quad are of no use.
+	ClipKey_t key;
+	ClipKey_Build( key );
+	if ( !m_bClipKeyValid || !ClipKey_Equal( key, m_ClipKey ) )
 	{
-		CMapFace *pFace = m_Faces.Element( iFace );
-		if ( pFace )
+		m_FaceClips.Purge();
+		m_ClipKey = key;
+		m_bClipKeyValid = true;
+	}
+
+	// Match every sidelist face with its clip, and clip the faces whose clips are stale.
+	m_FaceClips.Match( m_Faces );
+
+	CUtlVector<FaceClipJob_t> aJobs;
+	for ( int iFaceClip = 0; iFaceClip < m_FaceClips.Count(); iFaceClip++ )
+	{
+		FaceClip_t *pFaceClip = m_FaceClips.Element( iFaceClip );
+		if ( !pFaceClip->m_bStale )
+			continue;
+
+		// Displacement clipping uses the displacement manager; keep it on this thread.
+		if ( pFaceClip->m_pFace->HasDisp() )
+		{
+			DoClipFace( pFaceClip->m_pFace, pFaceClip->m_aFaces );
+		}
+		else
 		{
-			PreClip();
-			DoClipFace( pFace );
-			PostClip();
+			int iJob = aJobs.AddToTail();
+			aJobs[iJob].m_pOverlay = this;
+			aJobs[iJob].m_pFaceClip = pFaceClip;
 		}
 	}
+
+	// The faces clip independently of each other.
+	if ( aJobs.Count() >= OVERLAY_PARALLEL_CLIP_FACES )
+	{
+		ParallelProcess( "CMapOverlay::FaceClips_ClipJob", aJobs.Base(), aJobs.Count(), &CMapOverlay::FaceClips_ClipJob );
+	}
+	else
+	{
+		for ( int iJob = 0; iJob < aJobs.Count(); iJob++ )
+		{
+			FaceClips_ClipJob( aJobs[iJob] );
+		}
+	}
+
+	PostClip();
+
+	// Rebuild the render face list.
+	m_FaceClips.GetRenderFaces( m_aRenderFaces );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Clips the overlay to one non-displacement face. Called on worker
+//          threads; only reads the overlay and the face.
+//-----------------------------------------------------------------------------
+void CMapOverlay::FaceClips_ClipJob( FaceClipJob_t &job )
+{
+	CMapFace *pFace = job.m_pFaceClip->m_pFace;
+	ClipFace_t *pClippedFace = job.m_pOverlay->ClipOverlayToFace( pFace );
+	if ( pClippedFace )
+	{
+		pClippedFace->m_pBuildFace = pFace;
+		job.m_pFaceClip->m_aFaces.AddToTail( pClippedFace );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Records everything about the overlay that a clip depends on: the
+//          overlay quad, its texture coordinates and its projection.
+//-----------------------------------------------------------------------------
+void CMapOverlay::ClipKey_Build( ClipKey_t &key )
+{
+	key.m_vecOrigin = m_Basis.m_vecOrigin;
+	key.m_vecNormal = m_Basis.m_vecAxes[OVERLAY_BASIS_NORMAL];
+
+	for ( int iPoint = 0; iPoint < OVERLAY_HANDLES_COUNT; iPoint++ )
+	{
+		key.m_vecPoints[iPoint] = m_pOverlayFace->m_aPoints[iPoint];
+		key.m_vecTexCoords[iPoint] = m_pOverlayFace->m_aTexCoords[0][iPoint];
+	}
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool CMapOverlay::ClipKey_Equal( const ClipKey_t &key0, const ClipKey_t &key1 )
+{
+	if ( ( key0.m_vecOrigin != key1.m_vecOrigin ) || ( key0.m_vecNormal != key1.m_vecNormal ) )
+		return false;
+
+	for ( int iPoint = 0; iPoint < OVERLAY_HANDLES_COUNT; iPoint++ )
+	{
+		if ( ( key0.m_vecPoints[iPoint] != key1.m_vecPoints[iPoint] ) ||
+			 ( key0.m_vecTexCoords[iPoint] != key1.m_vecTexCoords[iPoint] ) )
+			return false;
+	}
+
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1968,17 +2067,43 @@ void CMapOverlay::PostClip( void )
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
-void CMapOverlay::DoClipFace( CMapFace *pFace )
+void CMapOverlay::DoClipFace( CMapFace *pFace, ClipFaces_t &aClipFaces )
 {
 	// Valid face?
 	Assert( pFace != NULL );
 	if( !pFace )
 		return;
 
+	ClipFace_t *pClippedFace = ClipOverlayToFace( pFace );
+	if ( !pClippedFace )
+		return;
+
+	//
+	// If the face has a displacement map -- continue clipping.
+	//
+	if( pFace->HasDisp() )
+	{
+		DoClipDisp( pFace, pClippedFace, aClipFaces );
+	}
+	// Done - save it!
+	else
+	{
+		pClippedFace->m_pBuildFace = pFace;
+		aClipFaces.AddToTail( pClippedFace );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Clips the overlay to the edges of a face and moves what is left
+//          onto the face plane. Returns NULL if nothing is left. Only reads
+//          the overlay and the face.
+//-----------------------------------------------------------------------------
+CMapOverlay::ClipFace_t *CMapOverlay::ClipOverlayToFace( CMapFace *pFace )
+{
 	// Copy the original overlay to the "clipped" overlay.
 	ClipFace_t *pClippedFace = ClipFace_Copy( m_pOverlayFace );
 	if ( !pClippedFace )
-		return;
+		return NULL;
 
 	//
 	// Project all face points into the overlay plane.
@@ -1991,7 +2116,8 @@ void CMapOverlay::DoClipFace( CMapFace *pFace )
 	{
 		delete [] pPoints;
 		delete [] pEdgePlanes;
-		return;
+		ClipFace_Destroy( &pClippedFace );
+		return NULL;
 	}
 
 	for ( int iPoint = 0; iPoint < nPointCount; iPoint++ )
@@ -2042,7 +2168,7 @@ void CMapOverlay::DoClipFace( CMapFace *pFace )
 	// the base face plane.
 	//
 	if ( !pClippedFace )
-		return;
+		return NULL;
 
 	for ( int iPoint = 0; iPoint < pClippedFace->m_nPointCount; iPoint++ )
 	{
@@ -2066,19 +2192,7 @@ void CMapOverlay::DoClipFace( CMapFace *pFace )
 		}
 	}
 
-	//
-	// If the face has a displacement map -- continue clipping.
-	//
-	if( pFace->HasDisp() )
-	{
-		DoClipDisp( pFace, pClippedFace );
-	}
-	// Done - save it!
-	else
-	{
-		pClippedFace->m_pBuildFace = pFace;
-		m_aRenderFaces.AddToTail( pClippedFace );
-	}
+	return pClippedFace;
 }
 
 //-----------------------------------------------------------------------------
@@ -2187,7 +2301,7 @@ void CMapOverlay::Disp_DoClip( CMapDisp *pDisp, ClipFaces_t &aDispFragments,
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
-void CMapOverlay::DoClipDisp( CMapFace *pFace, ClipFace_t *pClippedFace )
+void CMapOverlay::DoClipDisp( CMapFace *pFace, ClipFace_t *pClippedFace, ClipFaces_t &aClipFaces )
 {
 	// Get the displacement data.
 	EditDispHandle_t handle = pFace->GetDisp();
@@ -2213,7 +2327,7 @@ void CMapOverlay::DoClipDisp( CMapFace *pFace, ClipFace_t *pClippedFace )
 		{
 			// Save for re-building later!
 			pClipFace->m_pBuildFace = pFace;
-			m_aRenderFaces.AddToTail( aCurrentFaces[iFace] );
+			aClipFaces.AddToTail( aCurrentFaces[iFace] );
 			ClipFace_BuildFacesFromBlendedData( pClipFace );
 		}
 	}
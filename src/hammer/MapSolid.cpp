@@ -7,6 +7,7 @@
 #include "stdafx.h"
 #include "Box3D.h"
 #include "BrushOps.h"
+#include "CarveCull.h"
 #include "GlobalFunctions.h"
 #include "MapDefs.h"		// dvs: For COORD_NOTINIT
 #include "MapView2D.h" // dvs FIXME: For HitTest2D implementation
@@ -20,6 +21,7 @@
 #include "MapDisp.h"
 #include "camera.h"
 #include "ssolid.h"
+#include "VMFBatch.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -193,6 +195,17 @@ bool CMapSolid::Carve(CMapObjectList *pInside, CMapObjectList *pOutside, CMapSol
 	return(true);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Cheap test for whether Carve could find this solid intersecting
+//			the carver. Returns false only where Carve would return false.
+//			Reads only, so it is safe to call on worker threads.
+// Input  : pCarver - The solid that would be subtracted from us.
+//-----------------------------------------------------------------------------
+bool CMapSolid::MayIntersect(CMapSolid *pCarver)
+{
+	return CarveCull_MayIntersect<Vector>(this, pCarver);
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Clips the given solid by the given face, returning the results.
 // Input  : pSolid - Solid to clip.
@@ -768,7 +781,7 @@ LPCTSTR CMapSolid::GetTexture(int iFace)
 int CMapSolid::CreateFromPlanes( DWORD dwFlags )
 {
 	int i, j, k;
-	BOOL useplane[MAPSOLID_MAX_FACES];
+	bool useplane[MAPSOLID_MAX_FACES];
 
 	m_Render2DBox.SetBounds(Vector(COORD_NOTINIT, COORD_NOTINIT, COORD_NOTINIT), 
 							Vector(-COORD_NOTINIT, -COORD_NOTINIT, -COORD_NOTINIT));
@@ -796,48 +809,16 @@ int CMapSolid::CreateFromPlanes( DWORD dwFlags )
 	// it is unique. We mark each plane that we intend to keep with a TRUE in the
 	// 'useplane' array.
 	//
-	for (i = 0; i < nFaces; i++)
-	{
-		CMapFace *pFace = GetFace(i);
-		PLANE *f = &pFace->plane;
-
-		//
-		// Don't use this plane if it has a zero-length normal.
-		//
-		if (VectorCompare(f->normal, vec3_origin))
-		{
-			useplane[i] = FALSE;
-			continue;
-		}
-		
-		//
-		// If the plane duplicates another plane, don't use it (assume it is a brush
-		// being edited that will be fixed).
-		//
-		useplane[i] = TRUE;
-		for (j = 0; j < i; j++)
-		{
-			CMapFace *pFaceCheck = GetFace(j);
-
-			Vector& f1 = f->normal;
-			Vector& f2 = pFaceCheck->plane.normal;
-
-			//
-			// Check for duplicate plane within some tolerance.
-			//
-			if ((DotProduct(f1, f2) > 0.999) && (fabs(f->dist - pFaceCheck->plane.dist) < 0.01))
-			{
-				useplane[j] = FALSE;
-				break;
-			}
-		}
-	}
+	SolidFromPlanesDist_t sorted[MAPSOLID_MAX_FACES];
+	int rank[MAPSOLID_MAX_FACES];
+	SolidFromPlanes_ChoosePlanes(this, useplane, sorted, rank);
 
 	//
 	// Now we have a set of planes, indicated by TRUE values in the 'useplanes' array,
 	// from which we will build a solid.
 	//
 	BOOL bGotFaces = FALSE;
+	CWindingClipper Clipper;
 
 	for (i = 0; i < nFaces; i++)
 	{
@@ -850,8 +831,9 @@ int CMapSolid::CreateFromPlanes( DWORD dwFlags )
 		// Create a huge winding from this face's plane, then clip it by all other
 		// face planes.
 		//
-		winding_t *w = CreateWindingFromPlane(&pFace->plane);
-		for (j = 0; j < nFaces && w; j++)
+		InitWindingClipper(Clipper, &pFace->plane);
+		bool bClippedAway = false;
+		for (j = 0; j < nFaces && !bClippedAway; j++)
 		{
 			CMapFace *pFaceClip = GetFace(j);
 
@@ -865,16 +847,28 @@ int CMapSolid::CreateFromPlanes( DWORD dwFlags )
 				VectorSubtract(vec3_origin, pFaceClip->plane.normal, plane.normal);
 				plane.dist = -pFaceClip->plane.dist;
 
-				w = ClipWinding(w, &plane);
+				bClippedAway = !Clipper.Clip(&plane);
 			}
 		}
 
+		if (Clipper.IsOverflowed())
+		{
+			Msg(mwError, "ClipWinding: too many points");
+		}
+
 		//
 		// If we still have a winding after all that clipping, build a face from
 		// the winding.
 		//
-		if (w != NULL)
+		if (!bClippedAway)
 		{
+			Vector points[WINDING_CLIPPER_MAX_POINTS];
+			winding_t Winding;
+			winding_t *w = &Winding;
+			w->numpoints = Clipper.GetPointCount();
+			w->p = points;
+			Clipper.GetPoints(points);
+
 			//
 			// Round all points in the winding that are within ROUND_VERTEX_EPSILON of
 			// integer values.
@@ -911,11 +905,6 @@ int CMapSolid::CreateFromPlanes( DWORD dwFlags )
 			{
 				pFace->CreateFace(w, CREATE_FACE_PRESERVE_PLANE);
 			}
-			
-			//
-			// Done with the winding, we can free it now.
-			//
-			FreeWinding(w);
 		}
 	}
 
@@ -1030,7 +1019,14 @@ ChunkFileResult_t CMapSolid::LoadSideCallback(CChunkFile *pFile, CMapSolid *pSol
 	else
 	{
 		// UNDONE: need a better solution for user errors.
-		AfxMessageBox("Out of memory loading solid.");
+		if (CVMFBatch::IsRunning())
+		{
+			Warning("Out of memory loading solid.\n");
+		}
+		else
+		{
+			AfxMessageBox("Out of memory loading solid.");
+		}
 		eResult = ChunkFile_OutOfMemory;
 	}
 
@@ -1099,9 +1095,16 @@ ChunkFileResult_t CMapSolid::LoadVMF(CChunkFile *pFile, bool &bValid)
 		else
 		{
 #ifdef SLE //// SLE NEW - print out bad solid ids
-			CString str;
-			str.Format("Solid %i failed to load from the chunk.\nThis is safe to ignore.\nThe solid will be removed on next save.", this->GetID());
-			AfxMessageBox(str, MB_OK | MB_ICONEXCLAMATION);
+			if (CVMFBatch::IsRunning())
+			{
+				Warning("Solid %i failed to load from the chunk. The solid will be removed on next save.\n", this->GetID());
+			}
+			else
+			{
+				CString str;
+				str.Format("Solid %i failed to load from the chunk.\nThis is safe to ignore.\nThe solid will be removed on next save.", this->GetID());
+				AfxMessageBox(str, MB_OK | MB_ICONEXCLAMATION);
+			}
 #endif
 			g_nBadSolidCount++;
 		}
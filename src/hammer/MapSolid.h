@@ -79,6 +79,7 @@ public:
 	virtual CMapClass *CopyFrom(CMapClass *pFrom, bool bUpdateDependencies);
 	int Split(PLANE *pPlane, CMapSolid **pFront = NULL, CMapSolid **pBack = NULL);
 	bool Subtract(CMapObjectList *pInside, CMapObjectList *pOutside, CMapClass *pSubtractWith);
+	bool MayIntersect(CMapSolid *pCarver);
 
 	virtual bool ShouldAppearInLightingPreview(void);
 	virtual bool ShouldAppearInRaytracedLightingPreview(void);
@@ -11,9 +11,7 @@
 #include "MapDoc.h"
 #include "MapEntity.h"
 #include "MapStudioModel.h"
-#ifdef SLE //// needed for the sky camera access
-#include "mapworld.h"
-#endif
+#include "MapWorld.h"
 #include "Render2D.h"
 #include "Render3D.h"
 #include "ViewerSettings.h"
@@ -125,6 +123,127 @@ void CMapStudioModel::AdvanceAnimation(float flInterval)
 	}
 }
 
+//
+// The models in one document whose queued loads have finished.
+//
+struct QueuedModelUpdate_t
+{
+	CUtlVector<CMapStudioModel *> Resident;	// Loaded, but still using placeholder bounds.
+	CUtlVector<CMapStudioModel *> Failed;		// Failed to load.
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Sorts the models whose queued loads have finished by outcome. The
+//			objects are changed after the enumeration, since a failed model
+//			changes the tree.
+//-----------------------------------------------------------------------------
+static BOOL FindFinishedModels(CMapStudioModel *pModel, QueuedModelUpdate_t *pUpdate)
+{
+	if (pModel->OnModelResident())
+	{
+		pUpdate->Resident.AddToTail(pModel);
+	}
+	else if (pModel->HasFailedModel())
+	{
+		pUpdate->Failed.AddToTail(pModel);
+	}
+
+	return(TRUE);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the ancestor of an object that is a direct child of the
+//			world, which is what the world links into its culling tree.
+//-----------------------------------------------------------------------------
+static CMapClass *GetWorldChild(CMapClass *pObject, CMapWorld *pWorld)
+{
+	while ((pObject->GetParent() != NULL) && (pObject->GetParent() != pWorld))
+	{
+		pObject = pObject->GetParent();
+	}
+
+	return(pObject);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called when queued studio models have loaded. Updates the objects
+//			in every document that were still using placeholder bounds, and
+//			gives the entities whose models failed to load the helpers they
+//			would have had if the model had been loaded synchronously. Each
+//			document is notified directly, as it need not be the active one.
+//-----------------------------------------------------------------------------
+void CMapStudioModel::UpdateQueuedModels(void)
+{
+	for (int i = 0; i < CMapDoc::GetDocumentCount(); i++)
+	{
+		CMapDoc *pDoc = CMapDoc::GetDocument(i);
+		CMapWorld *pWorld = pDoc->GetMapWorld();
+		if (pWorld == NULL)
+		{
+			continue;
+		}
+
+		QueuedModelUpdate_t Update;
+		pWorld->EnumObjectsOfType(FindFinishedModels, &Update);
+
+		for (int j = 0; j < Update.Resident.Count(); j++)
+		{
+			pWorld->UpdateChildInDocument(GetWorldChild(Update.Resident[j], pWorld), pDoc);
+		}
+
+		for (int j = 0; j < Update.Failed.Count(); j++)
+		{
+			CMapEntity *pEntity = dynamic_cast<CMapEntity *>(Update.Failed[j]->GetParent());
+			if (pEntity != NULL)
+			{
+				pEntity->RemoveFailedHelper(Update.Failed[j]);
+				pWorld->UpdateChildInDocument(GetWorldChild(pEntity, pWorld), pDoc);
+			}
+		}
+
+		pDoc->UpdateAllViews(MAPVIEW_UPDATE_OBJECTS);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Prepares a model whose bounds were computed while it was still
+//			waiting in the load queue for its real bounds. Only the bounds
+//			change, so the document is not modified.
+// Output : Returns true if the model has loaded and the caller should update
+//			the object's bounds.
+//-----------------------------------------------------------------------------
+bool CMapStudioModel::OnModelResident(void)
+{
+	if (!m_bPlaceholderBounds || !m_pStudioModel->IsResident())
+	{
+		return(false);
+	}
+
+#ifdef SLE //// SLE NEW: preview default prop dynamic anim
+	// The sequence names were not known when the key was read.
+	CMapEntity *pEntity = dynamic_cast<CMapEntity *>(GetParent());
+	if (pEntity != NULL)
+	{
+		const char *pszAnim = pEntity->GetKeyValue("defaultanim");
+		if (pszAnim != NULL)
+		{
+			OnParentKeyChanged("defaultanim", pszAnim);
+		}
+	}
+#endif
+
+	return(true);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the model was queued and failed to load, so this
+//			helper will never draw anything but its placeholder box.
+//-----------------------------------------------------------------------------
+bool CMapStudioModel::HasFailedModel(void)
+{
+	return(m_bPlaceholderBounds && m_pStudioModel->HasLoadFailed());
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : bFullUpdate - 
@@ -136,7 +255,10 @@ void CMapStudioModel::CalcBounds(BOOL bFullUpdate)
 	Vector Mins(0, 0, 0);
 	Vector Maxs(0, 0, 0);
 
-	if (m_pStudioModel != NULL)
+	// Until a queued model loads, it gets the default box below.
+	m_bPlaceholderBounds = (m_pStudioModel != NULL) && !m_pStudioModel->IsResident();
+
+	if ((m_pStudioModel != NULL) && !m_bPlaceholderBounds)
 	{
 		//
 		// The 3D bounds are the bounds of the oriented model's first sequence, so that
@@ -224,6 +346,7 @@ CMapClass *CMapStudioModel::CopyFrom(CMapClass *pObject, bool bUpdateDependencie
 	m_Skin = pFrom->m_Skin;
 
 	m_bOrientedBounds = pFrom->m_bOrientedBounds;
+	m_bPlaceholderBounds = pFrom->m_bPlaceholderBounds;
 	m_bReversePitch = pFrom->m_bReversePitch;
 	m_bPitchSet = pFrom->m_bPitchSet;
 	m_flPitch = pFrom->m_flPitch;
@@ -287,6 +410,7 @@ void CMapStudioModel::Initialize(void)
 	m_flPitch = 0;
 	m_bReversePitch = false;
 	m_pStudioModel = NULL;
+	m_bPlaceholderBounds = false;
 	m_Skin = 0;
 
 	m_bScreenSpaceFade = false;
@@ -529,6 +653,12 @@ void CMapStudioModel::Render2D(CRender2D *pRender)
 	bool bDrawAsModel = (Options.view2d.bDrawModels && ((sizeX+sizeY) > 50)) ||	
 						IsSelected() ||	( pRender->IsInLocalTransformMode() && !pRender->GetInstanceRendering() );
 #endif
+	// Models waiting in the load queue draw as their box.
+	if ( !m_pStudioModel->IsResident() )
+	{
+		bDrawAsModel = false;
+	}
+
 	if ( !bDrawAsModel || IsSelected() )
 	{
 		// Draw the bounding box.
@@ -826,8 +956,9 @@ void CMapStudioModel::Render3D(CRender3D *pRender)
 
 	//
 	// If we have a model, render it if it is close enough to the camera.
+	// Models waiting in the load queue render as a bounding box.
 	//
-	if (m_pStudioModel != NULL)
+	if ((m_pStudioModel != NULL) && m_pStudioModel->IsResident())
 	{
 		Vector ViewPoint;
 		pRender->GetCamera()->GetViewPoint(ViewPoint);
@@ -31,6 +31,7 @@ class CMapStudioModel : public CMapHelper
 		static CMapStudioModel *CreateMapStudioModel(const char *pszModelPath, bool bOrientedBBox, bool bReversePitch);
 
 		static void AdvanceAnimation(float flInterval);
+		static void UpdateQueuedModels(void);
 
 		//
 		// Construction/destruction:
@@ -74,6 +75,8 @@ class CMapStudioModel : public CMapHelper
 		void SetAngles(QAngle& fAngles);
 
 		void OnParentKeyChanged(const char* szKey, const char* szValue);
+		bool OnModelResident(void);
+		bool HasFailedModel(void);
 
 		bool RenderPreload(CRender3D *pRender, bool bNewContext);
 
@@ -139,6 +142,7 @@ class CMapStudioModel : public CMapHelper
 		bool m_bOrientedBounds;				// Whether the bounding box should consider the orientation of the model.
 											// Note that this is not a true oriented bounding box, but an axial box
 											// indicating the extents of the oriented model.
+		bool m_bPlaceholderBounds;			// Whether the bounds were computed before the model finished loading.
 
 		bool m_bReversePitch;				// Lights negate pitch, so models representing light sources in Hammer
 											// must do so as well.
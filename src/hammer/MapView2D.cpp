@@ -28,6 +28,9 @@ extern bool g_bUpdateBones2D;
 
 static DrawType_t __eNextViewType = VIEW2D_XY;
 
+// Whether render lists are gathered through the world's culling tree.
+static bool g_bUseCullTree2D = true;
+
 IMPLEMENT_DYNCREATE(CMapView2D, CMapView2DBase)
 
 BEGIN_MESSAGE_MAP(CMapView2D, CMapView2DBase)
@@ -169,22 +172,20 @@ void CMapView2D::OnRenderListDirty()
 }
 	
 //-----------------------------------------------------------------------------
-// Purpose: Sorts the object to be rendered into one of two groups: normal objects
-//			and selected objects, so that selected objects can be rendered last.
+// Purpose: Adds a single object to the render list if it is visible in this view.
 // Input  : pObject - 
-//			pRenderList - 
-// Output : Returns TRUE on success, FALSE on failure.
+// Output : Returns false if the object's children should be skipped as well.
 //-----------------------------------------------------------------------------
-void CMapView2D::AddToRenderLists(CMapClass *pObject)
+bool CMapView2D::AddToRenderList(CMapClass *pObject)
 {
 	if ( !pObject->IsVisible() )
-		return;
+		return false;
 	
 	// Don't render groups, render their children instead.
 	if ( !pObject->IsGroup() )
 	{
 		if ( !pObject->IsVisible2D() )
-			return;
+			return false;
 
 		Vector vecMins, vecMaxs;
 		pObject->GetCullBox( vecMins, vecMaxs );
@@ -193,12 +194,24 @@ void CMapView2D::AddToRenderLists(CMapClass *pObject)
 		{
 			// Make sure the object is in the update region.
 			if ( !IsInClientView(vecMins, vecMaxs) )
-				return; 
+				return false; 
 		}
 		       	
 		m_RenderList.AddToTail(pObject);
 	}
 
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds an object and all of its visible descendents to the render list.
+// Input  : pObject - 
+//-----------------------------------------------------------------------------
+void CMapView2D::AddToRenderLists(CMapClass *pObject)
+{
+	if ( !AddToRenderList( pObject ) )
+		return;
+
 	// Recurse into children and add them.
 	const CMapObjectList *pChildren = pObject->GetChildren();
 	FOR_EACH_OBJ( *pChildren, pos )
@@ -207,6 +220,41 @@ void CMapView2D::AddToRenderLists(CMapClass *pObject)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Fills the render list from the world. Only the root level objects
+//			the culling tree reports inside the view rectangle, and those
+//			without a valid cull box, are visited, so the cost follows what is
+//			on screen rather than the size of the map. The world returns them
+//			in world order, so objects draw in the same order as without the tree.
+// Input  : pWorld - 
+//-----------------------------------------------------------------------------
+void CMapView2D::AddWorldToRenderLists(CMapWorld *pWorld)
+{
+	if ( !g_bUseCullTree2D )
+	{
+		AddToRenderLists( pWorld );
+		return;
+	}
+
+	if ( !AddToRenderList( pWorld ) )
+		return;
+
+	if ( !pWorld->CullTree_GetObjectsToRender( m_ViewMin, m_ViewMax, m_CullTreeObjects, m_CullTreeVisited ) )
+	{
+		const CMapObjectList *pChildren = pWorld->GetChildren();
+		FOR_EACH_OBJ( *pChildren, pos )
+		{
+			AddToRenderLists( pChildren->Element( pos ) );
+		}
+		return;
+	}
+
+	FOR_EACH_OBJ( m_CullTreeObjects, pos )
+	{
+		AddToRenderLists( m_CullTreeObjects.Element( pos ) );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : rectUpdate - 
@@ -268,7 +316,7 @@ void CMapView2D::Render()
 		m_RenderList.RemoveAll();
 		
 		// fill render lists with visible objects
-		AddToRenderLists( pWorld );
+		AddWorldToRenderLists( pWorld );
 
 		g_bUpdateBones2D = true;
 	}
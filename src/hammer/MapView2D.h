@@ -14,8 +14,10 @@
 
 #include "MapView2DBase.h"
 #include "tier1/utlvector.h"
+#include "tier1/utlhashtable.h"
 
 class CMapInstance;
+class CMapWorld;
 
 class CMapView2D : public CMapView2DBase
 {
@@ -31,7 +33,9 @@ protected:
 
 private:
 	void DrawPointFile( CRender2D *pRender );
+	bool AddToRenderList( CMapClass *pObject );
 	void AddToRenderLists( CMapClass *pObject );
+	void AddWorldToRenderLists( CMapWorld *pWorld );
 	void Render();
 	void SetDrawType( DrawType_t drawType );
 	virtual void ActivateView( bool bActivate );
@@ -43,6 +47,8 @@ private:
 	// general variables:	
 	bool m_bLastActiveView;					// is this the last active view?
 	CUtlVector<CMapClass *> m_RenderList;	// list of current rendered objects
+	CMapObjectList m_CullTreeObjects;			// root level objects to render, from the culling tree
+	CUtlHashtable<CMapClass *> m_CullTreeVisited;	// scratch set for culling tree queries
 	bool m_bUpdateRenderObjects;			// if true, update render list on next draw
 
 // Overrides
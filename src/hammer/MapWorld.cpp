@@ -22,6 +22,10 @@
 #include "Worldsize.h"
 #include "MapOverlay.h"
 #include "Manifest.h"
+#include "EditorProfiler.h"
+#include "VMFBatch.h"
+#include "WorldOrder.h"
+#include "FacePointPool.h"
 #ifdef SLE //// SLE NEW - count decal textures as used textures in addition to face/overlay materials
 #include "MapDecal.h"
 #endif
@@ -192,6 +196,8 @@ CMapWorld::CMapWorld( void )
 								// create the world displacement manager
 	m_pWorldDispMgr = CreateWorldEditDispMgr();
 #endif
+	m_bTypeListsBuilt = false;
+	m_pFacePointPool = new CFacePointPool( CMapFace::OnPointsMoved );
 }
 
 //-----------------------------------------------------------------------------
@@ -218,6 +224,8 @@ CMapWorld::CMapWorld( CMapDoc *pOwningDocument )
 	m_pWorldDispMgr = CreateWorldEditDispMgr();
 #endif
 	m_pOwningDocument = pOwningDocument;
+	m_bTypeListsBuilt = false;
+	m_pFacePointPool = new CFacePointPool( CMapFace::OnPointsMoved );
 }
 
 //-----------------------------------------------------------------------------
@@ -235,17 +243,27 @@ CMapWorld::~CMapWorld(void)
 
 	// destroy the world displacement manager
 	DestroyWorldEditDispMgr( &m_pWorldDispMgr );
+
+	// The pool goes once our solids, deleted after this, and any faces held
+	// elsewhere have freed their points.
+	m_pFacePointPool->Release();
 }
 
 //-----------------------------------------------------------------------------
 // Purpose: Overridden to maintain the culling tree. Root level children of the
-//			world are kept in the culling tree.
+//			world are kept in the culling tree, and stamped with their place in
+//			the world's children.
 // Input  : pChild - object to add as a child.
 //-----------------------------------------------------------------------------
 void CMapWorld::AddChild(CMapClass *pChild)
 {
 	CMapClass::AddChild(pChild);
 
+	if ((m_Children.Count() > 0) && (m_Children.Tail() == pChild))
+	{
+		pChild->SetWorldOrder(m_Children.Count() - 1);
+	}
+
 	//
 	// Add the object to the culling tree.
 	//
@@ -253,6 +271,8 @@ void CMapWorld::AddChild(CMapClass *pChild)
 	{
 		m_pCullTree->AddCullTreeObjectRecurse(pChild);
 	}
+
+	CullTree_UpdateInvalidBox(pChild);
 }
 
 //-----------------------------------------------------------------------------
@@ -416,6 +436,7 @@ void CMapWorld::AddEntity( CMapEntity *pEntity )
 
 	// Add it to the flat list.
 	m_EntityList.AddToTail( pEntity );
+	m_ConnectionGraph.AddEntity( pEntity );
 	
 	// If it has a name, add it to the list of entities hashed by name checksum.
 	const char *pszName = pEntity->GetKeyValue( "targetname" );
@@ -474,6 +495,7 @@ void CMapWorld::EntityList_Remove(CMapClass *pObject, bool bRemoveChildren)
 		{
 			m_EntityList.FastRemove( nIndex );
 		}
+		m_ConnectionGraph.RemoveEntity( pEntity );
 
 		// Remove the entity from the hashed list.
 		int nOldBucket = FindEntityBucket( pEntity, &nIndex );
@@ -498,6 +520,7 @@ void CMapWorld::EntityList_Remove(CMapClass *pObject, bool bRemoveChildren)
 			if (pEntity != NULL)
 			{
 				m_EntityList.FindAndRemove(pEntity);
+				m_ConnectionGraph.RemoveEntity(pEntity);
 			}
 			pChild = pObject->GetNextDescendent(pos);
 		}
@@ -511,8 +534,28 @@ void CMapWorld::EntityList_Remove(CMapClass *pObject, bool bRemoveChildren)
 //-----------------------------------------------------------------------------
 void CMapWorld::RemoveChild(CMapClass *pChild, bool bUpdateBounds)
 {
+	int nIndex = pChild->GetWorldOrder();
+	bool bOrderCurrent = WorldOrder_IsCurrent(m_Children, pChild);
+
 	CMapClass::RemoveChild(pChild, bUpdateBounds);
 
+	//
+	// Restamp the children that moved. A stale stamp is caught when the
+	// objects are next sorted, at the cost of renumbering them all.
+	//
+	if (bOrderCurrent)
+	{
+#ifdef SLE
+		// The last child was moved into the removed child's place.
+		if (nIndex < m_Children.Count())
+		{
+			m_Children[nIndex]->SetWorldOrder(nIndex);
+		}
+#else
+		WorldOrder_Renumber(m_Children, nIndex);
+#endif
+	}
+
 	//
 	// Remove the object from the culling tree because it is no longer a root-level child.
 	//
@@ -520,6 +563,8 @@ void CMapWorld::RemoveChild(CMapClass *pChild, bool bUpdateBounds)
 	{
 		m_pCullTree->RemoveCullTreeObjectRecurse(pChild);
 	}
+
+	m_InvalidCullBoxObjects.Remove(pChild);
 }
 
 //-----------------------------------------------------------------------------
@@ -584,6 +629,18 @@ void CMapWorld::RemoveObjectFromWorld(CMapClass *pObject, bool bRemoveChildren)
 // Input  : pChild - 
 //-----------------------------------------------------------------------------
 void CMapWorld::UpdateChild(CMapClass *pChild)
+{
+	UpdateChildInDocument(pChild, CMapDoc::GetActiveMapDoc());
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same as UpdateChild, but notifies the given document rather than
+//			the active one. Used for changes that are not made by editing, such
+//			as models finishing loading, which can happen in any open document.
+// Input  : pChild - 
+//			pDoc - Document to notify.
+//-----------------------------------------------------------------------------
+void CMapWorld::UpdateChildInDocument(CMapClass *pChild, CMapDoc *pDoc)
 {
 	if ( CMapClass::s_bLoadingVMF )
 		return;
@@ -602,12 +659,13 @@ void CMapWorld::UpdateChild(CMapClass *pChild)
 		m_pCullTree->UpdateCullTreeObjectRecurse(pChild);
 	}
 
+	CullTree_UpdateInvalidBox(pChild);
+
 	//
 	// Notify the document that an object in the world has changed.
 	//
 	if (!IsTemporary()) // HACK: check to avoid prefab objects ending up in the doc's update list
 	{
-		CMapDoc *pDoc = CMapDoc::GetActiveMapDoc();
 		if (pDoc != NULL)
 		{
 			pDoc->UpdateObject(pChild);
@@ -639,10 +697,10 @@ void CMapWorld::OnUndoRedo()
 void CMapWorld::GetUsedTextures(CUsedTextureList &List)
 {
 	List.RemoveAll();
-	EnumChildren((ENUMMAPCHILDRENPROC)AddUsedTextures, (DWORD)&List, MAPCLASS_TYPE(CMapSolid));
-	EnumChildren((ENUMMAPCHILDRENPROC)AddOverlayTextures, (DWORD)&List, MAPCLASS_TYPE(CMapOverlay));
+	EnumObjectsOfType(AddUsedTextures, &List);
+	EnumObjectsOfType(AddOverlayTextures, &List);
 #ifdef SLE //// SLE NEW - count decal textures as used textures in addition to face/overlay materials
-	EnumChildren(( ENUMMAPCHILDRENPROC )AddDecalTextures, ( DWORD )&List, MAPCLASS_TYPE(CMapDecal));
+	EnumObjectsOfType(AddDecalTextures, &List);
 #endif
 }
 
@@ -846,6 +904,8 @@ void CMapWorld::CullTree_DumpNode(CCullTreeNode *pNode, int nDepth)
 //-----------------------------------------------------------------------------
 void CMapWorld::CullTree_Build(void)
 {
+	EDITOR_PROFILE_SCOPE( "CMapWorld::CullTree_Build" );
+
 	CullTree_Free();
 	m_pCullTree = new CCullTreeNode;
 
@@ -859,12 +919,16 @@ void CMapWorld::CullTree_Build(void)
 	//
 	// Populate the top level node with the contents of the world.
 	//
+	m_InvalidCullBoxObjects.RemoveAll();
 	FOR_EACH_OBJ( m_Children, pos )
 	{
 		CMapClass *pObject = m_Children.Element(pos);
 		m_pCullTree->AddCullTreeObject(pObject);
+		CullTree_UpdateInvalidBox(pObject);
 	}
 
+	WorldOrder_Renumber(m_Children);
+
 	//
 	// Recursively split this node into children and populate them.
 	//
@@ -874,6 +938,84 @@ void CMapWorld::CullTree_Build(void)
 	//OutputDebugString("\n");
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the root level children of the world whose cull boxes
+//			intersect the given box, using the culling tree if there is one.
+// Input  : vecMins, vecMaxs - Box to query.
+//			Objects - Receives the objects. Not cleared first.
+//-----------------------------------------------------------------------------
+void CMapWorld::CullTree_GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects)
+{
+	if (m_pCullTree != NULL)
+	{
+		m_pCullTree->GetObjectsInBox(vecMins, vecMaxs, Objects);
+		return;
+	}
+
+	FOR_EACH_OBJ( m_Children, pos )
+	{
+		CMapClass *pObject = m_Children.Element(pos);
+
+		Vector ObjMins;
+		Vector ObjMaxs;
+		pObject->GetCullBox(ObjMins, ObjMaxs);
+		if (BoxesIntersect(vecMins, vecMaxs, ObjMins, ObjMaxs))
+		{
+			Objects.AddToTail(pObject);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the root level children of the world that a view of the
+//			given box draws: those the culling tree finds in the box and those
+//			without a valid cull box, in the order of the world's children.
+//			Costs what the view holds rather than what the world holds.
+// Input  : vecMins, vecMaxs - Box to query.
+//			Objects - Receives the objects. Cleared first.
+//			Visited - Scratch set kept by the caller between queries.
+// Output : Returns false if there is no culling tree to query.
+//-----------------------------------------------------------------------------
+bool CMapWorld::CullTree_GetObjectsToRender(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects, CUtlHashtable<CMapClass *> &Visited)
+{
+	Objects.RemoveAll();
+	if (m_pCullTree == NULL)
+	{
+		return false;
+	}
+
+	Visited.RemoveAll();
+	m_pCullTree->GetObjectsInBox(vecMins, vecMaxs, Objects, Visited);
+
+	FOR_EACH_HASHTABLE( m_InvalidCullBoxObjects, i )
+	{
+		Objects.AddToTail(m_InvalidCullBoxObjects.Key(i));
+	}
+
+	WorldOrder_Sort(m_Children, Objects.Base(), Objects.Count());
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Tracks whether a root level child has a valid cull box. Children
+//			without one are never found by the culling tree.
+// Input  : pChild - Root level child whose cull box may have changed.
+//-----------------------------------------------------------------------------
+void CMapWorld::CullTree_UpdateInvalidBox(CMapClass *pChild)
+{
+	Vector vecMins;
+	Vector vecMaxs;
+	pChild->GetCullBox(vecMins, vecMaxs);
+	if (IsValidBox(vecMins, vecMaxs))
+	{
+		m_InvalidCullBoxObjects.Remove(pChild);
+	}
+	else
+	{
+		m_InvalidCullBoxObjects.Insert(pChild);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Returns a list of all the groups in the world.
 //-----------------------------------------------------------------------------
@@ -942,6 +1084,8 @@ void CMapWorld::PostloadWorld(void)
 			m_pCullTree->UpdateCullTreeObjectRecurse(pChild);
 		}
 
+		CullTree_UpdateInvalidBox(pChild);
+
 		pChild->PostUpdate(Notify_Changed);
 		pChild->SignalChanged();
 	}
@@ -1733,7 +1877,14 @@ void CMapWorld::PostloadVisGroups()
 		pDoc->VisGroups_CreateNamedVisGroup( orphans, "_orphaned hidden", true, true );
 #else
 		pDoc->VisGroups_CreateNamedVisGroup( orphans, "_orphaned hidden", true, false );
-		GetMainWnd()->MessageBox( "Orphaned objects were found and placed into the \"_orphaned hidden\" visgroup.", "Orphaned Objects Found", MB_OK | MB_ICONEXCLAMATION);
+		if ( CVMFBatch::IsRunning() )
+		{
+			Warning( "Orphaned objects were found and placed into the \"_orphaned hidden\" visgroup.\n" );
+		}
+		else
+		{
+			GetMainWnd()->MessageBox( "Orphaned objects were found and placed into the \"_orphaned hidden\" visgroup.", "Orphaned Objects Found", MB_OK | MB_ICONEXCLAMATION);
+		}
 #endif
 	}
 
@@ -1864,6 +2015,140 @@ bool CMapWorld::FindEntitiesByClassName(CMapEntityList &Found, const char *pszCl
 	return( Found.Count() != 0 );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the index of this world's entity names and connections,
+//			rebuilding it first if any entity name or connection has changed.
+//-----------------------------------------------------------------------------
+CEntityConnectionGraph *CMapWorld::GetConnectionGraph( void )
+{
+	m_ConnectionGraph.Update( &m_EntityList );
+	return &m_ConnectionGraph;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the list of every object of exactly the given type in this
+//			world, building the lists the first time.
+//-----------------------------------------------------------------------------
+const CMapObjectList *CMapWorld::TypeList_Get(MAPCLASSTYPE Type)
+{
+	if (!m_bTypeListsBuilt)
+	{
+		TypeList_Build();
+	}
+
+	UtlHashHandle_t h = m_TypeListIndex.Find(Type);
+	if (h == m_TypeListIndex.InvalidHandle())
+	{
+		return NULL;
+	}
+
+	return &m_TypeLists[m_TypeListIndex[h]];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Fills the per-type lists from the tree. From then on objects are
+//			added and removed as they join and leave the tree.
+//-----------------------------------------------------------------------------
+void CMapWorld::TypeList_Build(void)
+{
+	EDITOR_PROFILE_SCOPE("CMapWorld::TypeList_Build");
+
+	m_bTypeListsBuilt = true;
+
+	const CMapObjectList *pChildren = GetChildren();
+	FOR_EACH_OBJ(*pChildren, pos)
+	{
+		TypeList_AddTree(pChildren->Element(pos));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the object is in this world's per-type lists. Its
+//			slot may be stale, left over from another world.
+//-----------------------------------------------------------------------------
+bool CMapWorld::TypeList_Contains(CMapClass *pObject)
+{
+	int nList = pObject->GetTypeList();
+	int nPos = pObject->GetTypeListPos();
+
+	return (nList >= 0) && (nList < m_TypeLists.Count()) &&
+		(nPos >= 0) && (nPos < m_TypeLists[nList].Count()) &&
+		(m_TypeLists[nList][nPos] == pObject);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds an object to the end of the list for its type.
+//-----------------------------------------------------------------------------
+void CMapWorld::TypeList_Add(CMapClass *pObject)
+{
+	if (TypeList_Contains(pObject))
+		return;
+
+	MAPCLASSTYPE Type = pObject->GetType();
+	UtlHashHandle_t h = m_TypeListIndex.Find(Type);
+	if (h == m_TypeListIndex.InvalidHandle())
+	{
+		h = m_TypeListIndex.Insert(Type, m_TypeLists.AddToTail());
+	}
+
+	int nList = m_TypeListIndex[h];
+	pObject->SetTypeListSlot(nList, m_TypeLists[nList].AddToTail(pObject));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds an object that joined this world's tree, and its descendants.
+//-----------------------------------------------------------------------------
+void CMapWorld::TypeList_AddTree(CMapClass *pObject)
+{
+	if (!m_bTypeListsBuilt || !pObject)
+		return;
+
+	TypeList_Add(pObject);
+
+	const CMapObjectList *pChildren = pObject->GetChildren();
+	FOR_EACH_OBJ(*pChildren, pos)
+	{
+		TypeList_AddTree(pChildren->Element(pos));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes one object from its list. The last object in the list
+//			takes its place, so this doesn't depend on the size of the list.
+//-----------------------------------------------------------------------------
+void CMapWorld::TypeList_Remove(CMapClass *pObject)
+{
+	if (!m_bTypeListsBuilt || !TypeList_Contains(pObject))
+		return;
+
+	CMapObjectList &List = m_TypeLists[pObject->GetTypeList()];
+	int nPos = pObject->GetTypeListPos();
+
+	CMapClass *pLast = List.Tail();
+	List[nPos] = pLast;
+	pLast->SetTypeListSlot(pObject->GetTypeList(), nPos);
+	List.RemoveMultipleFromTail(1);
+
+	pObject->SetTypeListSlot(-1, -1);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes an object that left this world's tree, and its descendants.
+//-----------------------------------------------------------------------------
+void CMapWorld::TypeList_RemoveTree(CMapClass *pObject)
+{
+	if (!m_bTypeListsBuilt || !pObject)
+		return;
+
+	TypeList_Remove(pObject);
+
+	const CMapObjectList *pChildren = pObject->GetChildren();
+	FOR_EACH_OBJ(*pChildren, pos)
+	{
+		TypeList_RemoveTree(pChildren->Element(pos));
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : pFound - 
@@ -1972,6 +2257,8 @@ void CMapWorld::UpdateAllDependencies( CMapClass *pObject )
 	CMapEntity *pEntity = dynamic_cast<CMapEntity *>(pObject);
 	if ( pEntity )
 	{
+		CEntityConnectionGraph::OnEntityChanged( pEntity );
+
 		int nNewBucket = -1;
 		const char *pszName = pEntity->GetKeyValue( "targetname" );
 		if ( pszName )
@@ -14,6 +14,8 @@
 #include "EditGameClass.h"
 #include "MapClass.h"
 #include "MapPath.h"
+#include "EntityConnectionGraph.h"
+#include "tier1/utlhashtable.h"
 
 // Flags for SaveVMF.
 #define SAVEFLAGS_LIGHTSONLY	(1<<0)
@@ -36,6 +38,7 @@ class IEditorTexture;
 class CMapGroup;
 class CMapDoc;
 class CMapInstance;
+class CFacePointPool;
 
 struct SaveLists_t;
 
@@ -66,6 +69,26 @@ public:
 };
 
 
+//
+// Typed view of one of the world's per-type object lists. Every object in the
+// list is exactly of type T.
+//
+template <class T>
+class CMapTypeList
+{
+public:
+
+	inline CMapTypeList(const CMapObjectList *pList) : m_pList(pList) {}
+
+	inline int Count(void) const { return m_pList ? m_pList->Count() : 0; }
+	inline T *operator[](int nIndex) const { return static_cast<T *>(m_pList->Element(nIndex)); }
+
+private:
+
+	const CMapObjectList *m_pList;
+};
+
+
 class CMapWorld : public CMapClass, public CEditGameClass
 {
 #ifdef HAMMER2013_MAPWORLD_FIXES
@@ -86,6 +109,8 @@ class CMapWorld : public CMapClass, public CEditGameClass
 		//
 		void CullTree_Build(void);
 		inline CCullTreeNode *CullTree_GetCullTree(void) { return(m_pCullTree); }
+		void CullTree_GetObjectsInBox(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects);
+		bool CullTree_GetObjectsToRender(const Vector &vecMins, const Vector &vecMaxs, CMapObjectList &Objects, CUtlHashtable<CMapClass *> &Visited);
 
 		//
 		// CMapClass virtual overrides.
@@ -127,6 +152,7 @@ class CMapWorld : public CMapClass, public CEditGameClass
 		virtual int SerializeCommentaryTXT(std::fstream &file, BOOL fIsStoring);
 #endif
 		virtual void UpdateChild(CMapClass *pChild);
+		void UpdateChildInDocument(CMapClass *pChild, CMapDoc *pDoc);
 #ifdef HAMMER2013_MAPWORLD_FIXES
 		virtual void OnUndoRedo();
 #endif
@@ -157,6 +183,30 @@ class CMapWorld : public CMapClass, public CEditGameClass
 		bool FindEntitiesByKeyValue(CMapEntityList &Found, const char *szKey, const char *szValue, bool bVisiblesOnly);
 		bool FindEntitiesByName(CMapEntityList &Found, const char *szName, bool bVisiblesOnly);
 		bool FindEntitiesByClassName(CMapEntityList &Found, const char *szClassName, bool bVisiblesOnly);
+
+		// Index of the entity names and connections in this world, brought up to date.
+		CEntityConnectionGraph *GetConnectionGraph( void );
+
+		// Where the faces of this world's solids keep their points.
+		inline CFacePointPool *GetFacePointPool( void ) { return m_pFacePointPool; }
+
+		// Every object of exactly the given type in this world, in no particular
+		// order. NULL if there are none. Built on first use, then kept up to date
+		// as objects join and leave this world's tree.
+		const CMapObjectList *TypeList_Get(MAPCLASSTYPE Type);
+
+		// Called by CMapClass as objects join and leave this world's tree.
+		void TypeList_AddTree(CMapClass *pObject);
+		void TypeList_RemoveTree(CMapClass *pObject);
+		void TypeList_Remove(CMapClass *pObject);
+
+		template <class T>
+		inline CMapTypeList<T> GetObjectsOfType(void) { return CMapTypeList<T>(TypeList_Get(MAPCLASS_TYPE(T))); }
+
+		// Like EnumChildren with a type, but visits only the objects of that
+		// type, in no particular order. The callback must not add or delete objects.
+		template <class T, class P>
+		BOOL EnumObjectsOfType(BOOL (*pfn)(T *, P), P Param);
 		bool FindEntitiesByNameOrClassName(CMapEntityList &Found, const char *pszName, bool bVisiblesOnly);
 #ifdef SLE  //// SLE NEW - 3d skybox preview
 		Vector m_vecSkyCameraDelta;
@@ -242,14 +292,30 @@ class CMapWorld : public CMapClass, public CEditGameClass
 		void CullTree_DumpNode(CCullTreeNode *pNode, int nDepth);
 		void CullTree_FreeNode(CCullTreeNode *pNode);
 		void CullTree_Free(void);
+		void CullTree_UpdateInvalidBox(CMapClass *pChild);
+
+		//
+		// Per-type object lists.
+		//
+		void TypeList_Build(void);
+		void TypeList_Add(CMapClass *pObject);
+		bool TypeList_Contains(CMapClass *pObject);
 
 		CCullTreeNode *m_pCullTree;		// This world's objects stored in a spatial hierarchy for culling.
+		CUtlHashtable<CMapClass *> m_InvalidCullBoxObjects;	// Root level objects the culling tree can't find because their cull box is invalid.
 		
 		CMapEntityList m_EntityList;									// A flat list of all the entities in this world.
 		CMapEntityList m_EntityListByName[NUM_HASHED_ENTITY_BUCKETS];	// A list of all the entities in the world, hashed by name checksum.
+		CEntityConnectionGraph m_ConnectionGraph;						// Built from m_EntityList on first use, then kept up to date.
+
+		CUtlVector<CMapObjectList> m_TypeLists;				// The objects in this world, one list per type. Each object knows its place.
+		CUtlHashtable<const void *, int> m_TypeListIndex;	// Type to index into m_TypeLists.
+		bool m_bTypeListsBuilt;								// False until first used; until then nothing is tracked.
 
 		int m_nNextFaceID;						// Used for assigning unique IDs to every solid face in this world.
 
+		CFacePointPool *m_pFacePointPool;		// Released, not deleted, with the world: faces kept for undo may outlive it.
+
 		IWorldEditDispMgr	*m_pWorldDispMgr;	// world editable displacement manager
 
 		CMapDoc				*m_pOwningDocument;
@@ -287,4 +353,25 @@ inline CMapEntity *CMapWorld::EntityList_GetEntity( int nIndex )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Calls an enumerating function for each object of type T in this
+//			world.
+// Output : Returns FALSE if the enumeration was terminated early, TRUE if it completed.
+//-----------------------------------------------------------------------------
+template <class T, class P>
+BOOL CMapWorld::EnumObjectsOfType(BOOL (*pfn)(T *, P), P Param)
+{
+	CMapTypeList<T> List = GetObjectsOfType<T>();
+	for (int i = 0; i < List.Count(); i++)
+	{
+		if (!(*pfn)(List[i], Param))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
 #endif // MAPWORLD_H
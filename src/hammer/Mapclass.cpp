@@ -108,6 +108,9 @@ CMapClass::CMapClass(void)
 	r = g = b = 220;
 	m_pParent = NULL;
 	m_nRenderFrame = 0;
+	m_nWorldOrder = -1;
+	m_nTypeList = -1;
+	m_nTypeListPos = -1;
 	m_pEditorKeys = NULL;
 	m_Dependents.Purge();
 #ifdef SLE //// SLE NEW - ported from 2015
@@ -120,6 +123,14 @@ CMapClass::CMapClass(void)
 //-----------------------------------------------------------------------------
 CMapClass::~CMapClass(void)
 {
+	// Leave our world's per-type lists if we are still in a world. Our
+	// children, deleted below, leave it the same way.
+	CMapWorld *pWorld = GetWorldObject(m_pParent);
+	if (pWorld != NULL)
+	{
+		pWorld->TypeList_Remove(this);
+	}
+
 	// Delete all of our children.
 	m_Children.PurgeAndDeleteElements();
 
@@ -682,6 +693,12 @@ void CMapClass::AddChild(CMapClass *pChild)
 	m_Children.AddToTail(pChild);
 	pChild->m_pParent = this;
 
+	CMapWorld *pWorld = GetWorldObject(this);
+	if (pWorld != NULL)
+	{
+		pWorld->TypeList_AddTree(pChild);
+	}
+
 	//
 	// Update our bounds with the child's bounds.
 	//
@@ -711,8 +728,13 @@ void CMapClass::RemoveAllChildren(void)
 	//
 	// Detach the children from us. They are no longer in our world heirarchy.
 	//
+	CMapWorld *pWorld = GetWorldObject(this);
 	FOR_EACH_OBJ( m_Children, pos )
 	{	
+		if (pWorld != NULL)
+		{
+			pWorld->TypeList_RemoveTree(m_Children[pos]);
+		}
 		m_Children[pos]->m_pParent = NULL;
 	}	
 
@@ -737,6 +759,12 @@ void CMapClass::RemoveChild(CMapClass *pChild, bool bUpdateBounds)
 		return;
 	}
 	
+	CMapWorld *pWorld = GetWorldObject(this);
+	if (pWorld != NULL)
+	{
+		pWorld->TypeList_RemoveTree(pChild);
+	}
+
 #ifdef SLE //// supposedly better?
 	m_Children.FastRemove(index);
 #else
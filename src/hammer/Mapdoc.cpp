@@ -21,6 +21,7 @@
 #include "GotoBrushDlg.h"
 #include "hammer.h"
 #include "History.h"
+#include "InstanceCache.h"
 #include "ibsplighting.h"
 #include "MainFrm.h"
 #include "Manifest.h"
@@ -53,6 +54,9 @@
 #include "RunMap.h"
 #include "RunMapExpertDlg.h"
 #include "SaveInfo.h"
+#include "EditorProfiler.h"
+#include "VMFBatch.h"
+#include "FacePointPool.h"
 #include "SelectEntityDlg.h"
 #include "Shell.h"
 #include "StatusBarIDs.h"
@@ -67,6 +71,8 @@
 #include "ToolVertexEdit.h"
 #include "TransformDlg.h"
 #include "VisGroup.h"
+#include "tier1/utlhashtable.h"
+#include "vstdlib/jobthread.h"
 #ifdef SLE
 #ifdef SLE_2D_BACKGROUNDS
 #include "bitmap/tgaloader.h" //// SLE NEW - background images
@@ -454,6 +460,33 @@ CManifest	*CMapDoc::m_pManifest = NULL;
 int			CMapDoc::m_nInLevelLoad = 0;
 static CProgressDlg *pProgDlg;
 
+// Submaps of the batch started by CMapDoc::BeginBatchLoad, 0 outside of one.
+static int s_nBatchLoadFiles = 0;
+static int s_nBatchLoadFile = -1;
+
+#define LOADVMF_PROGRESS_RANGE	18000
+
+//-----------------------------------------------------------------------------
+// Purpose: Shows what the load is doing in the progress dialog, and which
+//			submap it is working on when a batch is loading.
+//-----------------------------------------------------------------------------
+static void SetLoadStatus( const char *pszStatus )
+{
+	if ( !pProgDlg )
+		return;
+
+	if ( ( s_nBatchLoadFiles > 0 ) && ( s_nBatchLoadFile >= 0 ) )
+	{
+		char szStatus[ 256 ];
+		V_snprintf( szStatus, sizeof( szStatus ), "Submap %d of %d: %s", s_nBatchLoadFile + 1, s_nBatchLoadFiles, pszStatus );
+		pProgDlg->SetWindowText( szStatus );
+	}
+	else
+	{
+		pProgDlg->SetWindowText( pszStatus );
+	}
+}
+
 #ifdef SLE_2D_BACKGROUNDS
 //// SLE NEW - background images
 class CBackgroundXYRegenerator : public ITextureRegenerator
@@ -746,6 +779,7 @@ CMapDoc::~CMapDoc(void)
 	// Remove this doc from the list of active docs.
 	//
 	s_ActiveDocs.FindAndRemove(this);
+	g_InstanceCache.OnDocumentClosed(this);
 	
 	if (this == GetActiveMapDoc())
 	{
@@ -1300,29 +1334,24 @@ void CMapDoc::EndShellSession(void)
 // Output : Returns FALSE if this is the object that we are looking for, TRUE
 //			to continue iterating.
 //-----------------------------------------------------------------------------
-BOOL CMapDoc::FindEntityCallback(CMapClass *pObject, FindEntity_t *pFindInfo)
+BOOL CMapDoc::FindEntityCallback(CMapEntity *pEntity, FindEntity_t *pFindInfo)
 {
-	CMapEntity *pEntity = dynamic_cast<CMapEntity *>(pObject);
-
-	if (pEntity != NULL)
-	{
-		Vector Pos;
-		pEntity->GetOrigin(Pos);
+	Vector Pos;
+	pEntity->GetOrigin(Pos);
 
-		// HACK: Round to origin integers since entity origins are rounded when
-		//       saving to MAP file. This makes finding entities from the engine
-		//       in the editor work.
-		Pos[0] = V_rint(Pos[0]);
-		Pos[1] = V_rint(Pos[1]);
-		Pos[2] = V_rint(Pos[2]);
+	// HACK: Round to origin integers since entity origins are rounded when
+	//       saving to MAP file. This makes finding entities from the engine
+	//       in the editor work.
+	Pos[0] = V_rint(Pos[0]);
+	Pos[1] = V_rint(Pos[1]);
+	Pos[2] = V_rint(Pos[2]);
 
-		if (VectorCompare(Pos, pFindInfo->Pos))
+	if (VectorCompare(Pos, pFindInfo->Pos))
+	{
+		if (stricmp(pEntity->GetClassName(), pFindInfo->szClassName) == 0)
 		{
-			if (stricmp(pEntity->GetClassName(), pFindInfo->szClassName) == 0)
-			{
-				pFindInfo->pEntityFound = pEntity;
-				return(FALSE);
-			}
+			pFindInfo->pEntityFound = pEntity;
+			return(FALSE);
 		}
 	}
 	
@@ -1353,7 +1382,7 @@ CMapEntity *CMapDoc::FindEntity(const char *pszClassName, float x, float y, floa
 		FindInfo.Pos[1] = V_rint(y);
 		FindInfo.Pos[2] = V_rint(z);
 
-		m_pWorld->EnumChildren((ENUMMAPCHILDRENPROC)FindEntityCallback, (DWORD)&FindInfo, MAPCLASS_TYPE(CMapEntity));
+		m_pWorld->EnumObjectsOfType(FindEntityCallback, &FindInfo);
 
 		if (FindInfo.pEntityFound != NULL)
 		{
@@ -1712,10 +1741,20 @@ bool CMapDoc::HandleLoadError(CChunkFile *pFile, const char *szChunkName, ChunkF
 //-----------------------------------------------------------------------------
 bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 {
-	bool			CreateProgressDlg = m_nInLevelLoad == 0;
+	EDITOR_PROFILE_SCOPE( "CMapDoc::LoadVMF" );
+
+	// A command line batch run has no window to show progress in.
+	bool			CreateProgressDlg = ( m_nInLevelLoad == 0 ) && !CVMFBatch::IsRunning();
 
 	m_nInLevelLoad++;
 
+	// Queue studio models instead of loading them, so opening a prop-heavy
+	// map doesn't wait on every model; they load from the main loop after.
+	CStudioModelCache::BeginQueuedLoad();
+
+	// Start reading the instance files this map uses on worker threads.
+	g_InstanceCache.BeginLoad( pszFileName );
+
 	//
 	// Create a new world to hold the loaded objects.
 	//
@@ -1724,20 +1763,31 @@ bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 		m_pWorld = new CMapWorld( this );
 	}
 
+	// Solids are read before they join the world; give their faces the
+	// world's point pool from the start.
+	CFacePointPool *pOldLoadPointPool = CMapFace::SetLoadPointPool( m_pWorld->GetFacePointPool() );
+
 	// Show our progress dialog.
 	if ( CreateProgressDlg )
 	{
 		pProgDlg = new CProgressDlg;
 		pProgDlg->Create();
 
-		pProgDlg->SetRange(0,18000);
+		pProgDlg->SetRange(0,LOADVMF_PROGRESS_RANGE);
+		pProgDlg->SetStep(1000);
+	}
+	else if ( pProgDlg && ( s_nBatchLoadFiles > 0 ) && ( LoadFlags & VMF_LOAD_IS_SUBMAP ) )
+	{
+		// Each submap gets its own stretch of the batch's progress bar.
+		s_nBatchLoadFile = min( s_nBatchLoadFile + 1, s_nBatchLoadFiles - 1 );
+		pProgDlg->SetPos( s_nBatchLoadFile * LOADVMF_PROGRESS_RANGE );
 		pProgDlg->SetStep(1000);
 	}
 
 	// Set the progress dialog title
 	CString caption;
 	caption.LoadString(IDS_LOADINGFILE);
-	pProgDlg->SetWindowText(caption);
+	SetLoadStatus(caption);
 
 	g_nFileFormatVersion = 0;
 
@@ -1748,7 +1798,10 @@ bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 	//
 	CChunkFile File;
 	ChunkFileResult_t eResult = File.Open(pszFileName, ChunkFile_Read);
-	pProgDlg->StepIt();
+	if ( pProgDlg )
+	{
+		pProgDlg->StepIt();
+	}
 
 	//
 	// Read the file.
@@ -1791,13 +1844,16 @@ bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 		// key value callback to ReadChunk.
 		//
 
-		pProgDlg->SetWindowText( "Reading Chunks..." );
+		SetLoadStatus( "Reading Chunks..." );
 		while (eResult == ChunkFile_Ok)
 		{
 			eResult = File.ReadChunk();
 		}
-		pProgDlg->SetStep(5000);
-		pProgDlg->StepIt();
+		if ( pProgDlg )
+		{
+			pProgDlg->SetStep(5000);
+			pProgDlg->StepIt();
+		}
 		
 		if (eResult == ChunkFile_EOF)
 		{
@@ -1810,12 +1866,19 @@ bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 
 	if (eResult == ChunkFile_Ok)
 	{
-		pProgDlg->SetWindowText( "Postload Processing..." );
+		SetLoadStatus( "Postload Processing..." );
 		Postload( pszFileName );
 
-		pProgDlg->StepIt();
+		if ( pProgDlg )
+		{
+			pProgDlg->StepIt();
+		}
 		m_bLoading = false;
 	}
+	else if ( CVMFBatch::IsRunning() )
+	{
+		Warning( "Error loading %s: %s\n", pszFileName, File.GetErrorText(eResult) );
+	}
 	else
 	{
 		GetMainWnd()->MessageBox(File.GetErrorText(eResult), "Error loading file", MB_OK | MB_ICONEXCLAMATION);
@@ -1841,13 +1904,66 @@ bool CMapDoc::LoadVMF( const char *pszFileName, int LoadFlags )
 		APP()->SetForceRenderNextFrame();
 	}
 
+	g_InstanceCache.EndLoad();
+	CStudioModelCache::EndQueuedLoad();
+
+	CMapFace::SetLoadPointPool( pOldLoadPointPool );
+
 	m_nInLevelLoad--;
 
 	return(eResult == ChunkFile_Ok);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Starts loading a run of submaps, such as the maps of a manifest.
+//			The submaps share one progress dialog that says which of them is
+//			loading, instead of each opening and closing its own.
+// Input  : nFiles - Number of LoadVMF calls with VMF_LOAD_IS_SUBMAP to come.
+//-----------------------------------------------------------------------------
+void CMapDoc::BeginBatchLoad( int nFiles )
+{
+	Assert( s_nBatchLoadFiles == 0 );
+
+	if ( m_nInLevelLoad++ == 0 )
+	{
+		pProgDlg = new CProgressDlg;
+		pProgDlg->Create();
+	}
+
+	s_nBatchLoadFiles = max( nFiles, 1 );
+	s_nBatchLoadFile = -1;
+
+	pProgDlg->SetRange( 0, s_nBatchLoadFiles * LOADVMF_PROGRESS_RANGE );
+	pProgDlg->SetPos( 0 );
+	pProgDlg->SetStep( 1000 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Ends a run of submap loads started with BeginBatchLoad.
+//-----------------------------------------------------------------------------
+void CMapDoc::EndBatchLoad( void )
+{
+	Assert( s_nBatchLoadFiles > 0 );
+
+	s_nBatchLoadFiles = 0;
+	s_nBatchLoadFile = -1;
+
+	if ( --m_nInLevelLoad == 0 && pProgDlg )
+	{
+		pProgDlg->DestroyWindow();
+		delete pProgDlg;
+		pProgDlg = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds the detail objects of every face in the world in one batch,
+//			so the faces are placed in parallel.
+//-----------------------------------------------------------------------------
 void CMapDoc::BuildAllDetailObjects()
 {
+	CUtlVector<CMapFace *> Faces;
+
 	EnumChildrenPos_t pos;
 	CMapClass *pChild = m_pWorld->GetFirstDescendent(pos);
 	while (pChild != NULL)
@@ -1860,12 +1976,14 @@ void CMapDoc::BuildAllDetailObjects()
 			{
 				CMapFace *pFace = pSolid->GetFace( i );
 				if ( pFace )
-					DetailObjects::BuildAnyDetailObjects( pFace );
+					Faces.AddToTail( pFace );
 			}
 		}
 
 		pChild = m_pWorld->GetNextDescendent(pos);
 	}
+
+	DetailObjects::BuildDetailObjects( Faces.Base(), Faces.Count() );
 }
 
 //-----------------------------------------------------------------------------
@@ -2166,7 +2284,8 @@ void CMapDoc::Postload(const char *pszFileName)
 	if ( pszFileName[ 0 ] ) 
 	{	// this path needs to be set early so that instances may properly find their base path
 #ifdef SLE //// SLE CHANGE - add to MRU right away, else a crash or process termination will not leave the map in it
-		SetPathName( pszFileName, TRUE);
+		// Maps loaded by a batch run are not the user's, so keep them out of it.
+		SetPathName( pszFileName, !CVMFBatch::IsRunning() );
 #else
 		SetPathName( pszFileName, FALSE );
 #endif
@@ -2180,7 +2299,11 @@ void CMapDoc::Postload(const char *pszFileName)
 		char szError[ 1024 ];
 
 		V_sprintf_safe( szError, "For your information, %d solid(s) were not loaded due to errors in the file. Would you like to Re-Save your map with the invalid solids removed?", CMapSolid::GetBadSolidCount() );
-		if ( GetMainWnd()->MessageBox(szError, "Warning", MB_YESNO | MB_ICONQUESTION) == IDYES )
+		if ( CVMFBatch::IsRunning() )
+		{
+			Warning( "%d solid(s) in %s were not loaded due to errors in the file.\n", CMapSolid::GetBadSolidCount(), pszFileName );
+		}
+		else if ( GetMainWnd()->MessageBox(szError, "Warning", MB_YESNO | MB_ICONQUESTION) == IDYES )
 		{
 			OnFileSave();
 		}
@@ -2209,7 +2332,7 @@ void CMapDoc::Postload(const char *pszFileName)
 
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Assigning to groups..." );
+		SetLoadStatus( "Assigning to groups..." );
 	}
 	AssignToGroups();
 	AssignToVisGroups();
@@ -2220,7 +2343,7 @@ void CMapDoc::Postload(const char *pszFileName)
 
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Postprocessing VisGroups..." );
+		SetLoadStatus( "Postprocessing VisGroups..." );
 	}
 	m_pWorld->PostloadVisGroups();
 	if ( pProgDlg )
@@ -2232,7 +2355,7 @@ void CMapDoc::Postload(const char *pszFileName)
 	// and until AssignToVisGroups is called all the visgroups are empty!
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Updating Visibility..." );
+		SetLoadStatus( "Updating Visibility..." );
 	}
 	RemoveEmptyGroups();
 	UpdateVisibilityAll();
@@ -2244,7 +2367,7 @@ void CMapDoc::Postload(const char *pszFileName)
 	// update displacement neighbors
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Updating Displacements..." );
+		SetLoadStatus( "Updating Displacements..." );
 	}
 	IWorldEditDispMgr *pDispMgr = GetActiveWorldEditDispManager();
 	if( pDispMgr )
@@ -2270,7 +2393,7 @@ void CMapDoc::Postload(const char *pszFileName)
 	//
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Updating Texture Names..." );
+		SetLoadStatus( "Updating Texture Names..." );
 	}
 
 	char translationFilename[MAX_PATH];
@@ -2289,7 +2412,7 @@ void CMapDoc::Postload(const char *pszFileName)
 
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Building Cull Tree..." );
+		SetLoadStatus( "Building Cull Tree..." );
 	}
 	m_pWorld->CullTree_Build();
 	if ( pProgDlg )
@@ -2301,7 +2424,7 @@ void CMapDoc::Postload(const char *pszFileName)
 	// Now generate the ones that need to be generated.
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Building Detail Objects..." );
+		SetLoadStatus( "Building Detail Objects..." );
 	}
 	DetailObjects::EnableBuildDetailObjects( true );
 #ifdef SLE //// SLE CHANGE - load the detail file here so it can be changed during runtime
@@ -2311,10 +2434,16 @@ void CMapDoc::Postload(const char *pszFileName)
 
 	if ( pProgDlg )
 	{
-		pProgDlg->SetWindowText( "Finished Loading!" );
+		SetLoadStatus( "Finished Loading!" );
 	}
 #ifdef SLE_2D_BACKGROUNDS
 	//// SLE NEW - background images
+	// A batch run has no views to draw them in.
+	if ( CVMFBatch::IsRunning() )
+	{
+		return;
+	}
+
 	// read the keyvalues file at the editor config location,
 	// see if the current map doc has bg images associated with it
 	// todo - plug it into the above system that reports things on the loading bar, 
@@ -3936,6 +4065,7 @@ BOOL CMapDoc::OnSaveDocument(LPCTSTR lpszPathName)
 		{
 			bSaved = TRUE;
 			SetModifiedFlag(FALSE);
+			g_InstanceCache.OnDocumentSaved(this, lpszPathName);
 		}
 		EndWaitCursor();
 
@@ -4120,7 +4250,7 @@ void CMapDoc::UpdateAllViews(int nFlags, UpdateBox *ub )
 //-----------------------------------------------------------------------------
 // Purpose: used during iteration, tells an map entity to 
 //-----------------------------------------------------------------------------
-static BOOL _UpdateAnimation( CMapClass *mapClass, float animTime )
+static BOOL _UpdateAnimation( CMapAnimator *mapClass, float animTime )
 {
 	mapClass->UpdateAnimation( animTime );
 	return TRUE;
@@ -4145,15 +4275,10 @@ void CMapDoc::UpdateAnimation( void )
 	}
 
 	// get current animation time from animation toolbar
-	union {
-		float fl;
-		DWORD dw;
-	} animTime;
-	
-	animTime.fl = GetAnimationTime();
+	float animTime = GetAnimationTime();
 
-	// iterate through all CMapEntity object and update their animation frame matrix
-	m_pWorld->EnumChildren( ENUMMAPCHILDRENPROC(_UpdateAnimation), animTime.dw, MAPCLASS_TYPE(CMapAnimator) );
+	// iterate through all CMapAnimator objects and update their animation frame matrix
+	m_pWorld->EnumObjectsOfType( _UpdateAnimation, animTime );
 }
 
 //-----------------------------------------------------------------------------
@@ -5476,6 +5601,36 @@ void CMapDoc::OnEditUnfreeze(void)
 	EditFreeze(false, false);
 }
 #endif
+//
+// A world solid that the carve may change, and whether any of the carving
+// solids may intersect it.
+//
+struct CarveCandidate_t
+{
+	CMapSolid *pSolid;
+	const CMapObjectList *pCarvers;
+	bool bMayIntersect;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Tests one world solid against every carving solid. Called on
+//			worker threads; only reads the solids.
+//-----------------------------------------------------------------------------
+static void TestCarveCandidate(CarveCandidate_t &Candidate)
+{
+	Candidate.bMayIntersect = false;
+
+	FOR_EACH_OBJ( *Candidate.pCarvers, i )
+	{
+		CMapSolid *pCarver = (CMapSolid *)Candidate.pCarvers->Element(i);
+		if (Candidate.pSolid->MayIntersect(pCarver))
+		{
+			Candidate.bMayIntersect = true;
+			return;
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Subtracts the first object in the selection set (by index) from
 //			all solids in the world.
@@ -5502,35 +5657,115 @@ void CMapDoc::OnToolsSubtractselection(void)
 	GetHistory()->Keep(pSelList);
 
 	//
-	// Build a list of every solid in the world.
+	// Build the list of solids we are subtracting with, as CMapSolid::Subtract does,
+	// and the box around them.
 	//
-	CMapObjectList WorldSolids;
+	CMapObjectList Carvers;
+	if (pSubtractWith->IsMapClass(MAPCLASS_TYPE(CMapSolid)))
+	{
+		Carvers.AddToTail(pSubtractWith);
+	}
+
 	EnumChildrenPos_t pos;
-	CMapClass *pChild = m_pWorld->GetFirstDescendent(pos);
+	CMapClass *pChild = pSubtractWith->GetFirstDescendent(pos);
 	while (pChild != NULL)
 	{
 		CMapSolid *pSolid = dynamic_cast <CMapSolid *> (pChild);
 		if (pSolid != NULL)
 		{
-			WorldSolids.AddToTail(pSolid);
+			Carvers.AddToTail(pSolid);
 		}
 
-		pChild = m_pWorld->GetNextDescendent(pos);
+		pChild = pSubtractWith->GetNextDescendent(pos);
 	}
 
-	if (WorldSolids.Count() == 0)
+	if (Carvers.Count() == 0)
 	{
 		return;
 	}
 
+	BoundBox CarveBox;
+	FOR_EACH_OBJ( Carvers, p )
+	{
+		Vector vecMins, vecMaxs;
+		Carvers.Element(p)->GetRender2DBox(vecMins, vecMaxs);
+		CarveBox.UpdateBounds(vecMins, vecMaxs);
+	}
+
+	//
+	// Only root level objects whose bounds touch the carvers can hold solids that
+	// intersect them. Gather the solids in those in the same order as walking the
+	// whole world, so the results are added in the same order as before.
+	//
+	CMapObjectList NearObjects;
+	m_pWorld->CullTree_GetObjectsInBox(CarveBox.bmins, CarveBox.bmaxs, NearObjects);
+
+	CUtlHashtable<CMapClass *> NearSet;
+	FOR_EACH_OBJ( NearObjects, p )
+	{
+		NearSet.Insert(NearObjects.Element(p));
+	}
+
+	CMapObjectList NearSolids;
+	const CMapObjectList *pRootObjects = m_pWorld->GetChildren();
+	FOR_EACH_OBJ( *pRootObjects, p )
+	{
+		CMapClass *pRoot = pRootObjects->Element(p);
+		if (NearSet.Find(pRoot) == NearSet.InvalidHandle())
+		{
+			continue;
+		}
+
+		if (dynamic_cast <CMapSolid *> (pRoot) != NULL)
+		{
+			NearSolids.AddToTail(pRoot);
+		}
+
+		pChild = pRoot->GetFirstDescendent(pos);
+		while (pChild != NULL)
+		{
+			CMapSolid *pSolid = dynamic_cast <CMapSolid *> (pChild);
+			if (pSolid != NULL)
+			{
+				NearSolids.AddToTail(pSolid);
+			}
+
+			pChild = pRoot->GetNextDescendent(pos);
+		}
+	}
+
+	CUtlVector<CarveCandidate_t> Candidates;
+	Candidates.SetCount(NearSolids.Count());
+	FOR_EACH_OBJ( NearSolids, p )
+	{
+		Candidates[p].pSolid = (CMapSolid *)NearSolids.Element(p);
+		Candidates[p].pCarvers = &Carvers;
+		Candidates[p].bMayIntersect = false;
+	}
+
+	if (Candidates.Count() == 0)
+	{
+		return;
+	}
+
+	//
+	// Reject the solids that are clearly apart from every carver.
+	//
+	ParallelProcess( "TestCarveCandidate", Candidates.Base(), Candidates.Count(), &TestCarveCandidate );
+
 	bool bLocked = VisGroups_LockUpdates( true );
 
 	//
-	// Subtract the 'subtract with' object from every solid in the world.
+	// Subtract the 'subtract with' object from every solid that may intersect it.
 	//
-	FOR_EACH_OBJ( WorldSolids, p )
+	FOR_EACH_VEC( Candidates, i )
 	{
-		CMapSolid *pSubtractFrom = (CMapSolid *)WorldSolids.Element(p);
+		if (!Candidates[i].bMayIntersect)
+		{
+			continue;
+		}
+
+		CMapSolid *pSubtractFrom = Candidates[i].pSolid;
 		CMapClass *pDestParent = pSubtractFrom->GetParent();
 
 		//
@@ -5572,6 +5807,11 @@ void CMapDoc::OnToolsSubtractselection(void)
 				GetHistory()->KeepNew(pResult);
 			}
 		}
+		else
+		{
+			// The copies of the untouched solid are not needed.
+			Outside.PurgeAndDeleteElements();
+		}
 	}
 
 	if ( bLocked )
@@ -10262,7 +10502,7 @@ void CMapDoc::ReplaceTextures(LPCTSTR pszFind, LPCTSTR pszReplace, BOOL bEveryth
 			SelectObject(NULL, scClear);
 		}
 
-		m_pWorld->EnumChildren((ENUMMAPCHILDRENPROC)ReplaceTexFunc, (DWORD)&info, MAPCLASS_TYPE(CMapSolid));
+		m_pWorld->EnumObjectsOfType(ReplaceTexFunc, &info);
 	}
 	else
 	{
@@ -10326,14 +10566,12 @@ void CMapDoc::ReplaceTextures(LPCTSTR pszFind, LPCTSTR pszReplace, BOOL bEveryth
 //			pInfo - Pointer to the structure with info about how to do the find/replace.
 // Output : 
 //-----------------------------------------------------------------------------
-static BOOL BatchReplaceTextureCallback( CMapClass *pObject, BatchReplaceTextures_t *pInfo )
+static BOOL BatchReplaceTextureCallback( CMapSolid *solid, BatchReplaceTextures_t *pInfo )
 { 
-	CMapSolid *solid;
 	int numFaces, i;
 	CMapFace *face;
 	char szCurrentTexture[MAX_PATH];
 
-	solid = ( CMapSolid * )pObject;
 	numFaces = solid->GetFaceCount();
 	for( i = 0; i < numFaces; i++ )
 	{
@@ -10420,7 +10658,7 @@ void CMapDoc::BatchReplaceTextures( FileHandle_t fp )
 		}
 
 		// Search and replace all key textures with val.
-		m_pWorld->EnumChildren( ( ENUMMAPCHILDRENPROC )BatchReplaceTextureCallback, ( DWORD )&Info, MAPCLASS_TYPE( CMapSolid ) ); 
+		m_pWorld->EnumObjectsOfType( BatchReplaceTextureCallback, &Info );
 next_line:;
 	}
 }
@@ -11704,7 +11942,7 @@ void CMapDoc::OnFileExportDXF(void)
 	info.pWorld = m_pWorld;
 	info.fp = fp;
 
-	m_pWorld->EnumChildren(ENUMMAPCHILDRENPROC(SaveDXF), DWORD(&info), MAPCLASS_TYPE(CMapSolid));
+	m_pWorld->EnumObjectsOfType(SaveDXF, &info);
 
 	EndWaitCursor();
 
@@ -11756,7 +11994,7 @@ void CMapDoc::OnFileExportSMD(void)
 	info.pWorld = m_pWorld;
 	info.fp = fp;
 
-	m_pWorld->EnumChildren(ENUMMAPCHILDRENPROC(SaveSMD), DWORD(&info), MAPCLASS_TYPE(CMapSolid));
+	m_pWorld->EnumObjectsOfType(SaveSMD, &info);
 
 	EndWaitCursor();
 
@@ -13184,6 +13422,8 @@ ChunkFileResult_t CMapDoc::CordonSaveVMF(CChunkFile *pFile, CSaveInfo *pSaveInfo
 //-----------------------------------------------------------------------------
 bool CMapDoc::SaveVMF(const char *pszFileName, int saveFlags )
 {
+	EDITOR_PROFILE_SCOPE( "CMapDoc::SaveVMF" );
+
 	CChunkFile File;	
 
 	ChunkFileResult_t eResult = File.Open(pszFileName, ChunkFile_Write);
@@ -13326,6 +13566,11 @@ bool CMapDoc::SaveVMF(const char *pszFileName, int saveFlags )
 		File.Close();
 	}
 
+	// Saving is a natural pause; pack the face points that editing spread
+	// over partly used slabs since the last save, and give back the rest.
+	m_pWorld->GetFacePointPool()->Compact();
+	g_FacePointPool.Compact();
+
 	// Restore the main window's title.
 	GetMainWnd()->OnUpdateFrameTitle( true );
 
@@ -13498,6 +13743,19 @@ void CMapDoc::RemoveReference( void )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Clears the path of a hidden instance document whose file has
+//			changed on disk, so opening the file again loads a new document
+//			instead of finding this one. The instances that still reference
+//			it keep it until they release it.
+//-----------------------------------------------------------------------------
+void CMapDoc::DetachFromFile( void )
+{
+	Assert( !IsVisible() );
+	m_strPathName.Empty();
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : bActive - 
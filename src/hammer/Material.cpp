@@ -20,19 +20,24 @@
 #include "materialsystem/MaterialSystemUtil.h"
 #include "materialsystem/imaterial.h"
 #include "materialsystem/imaterialvar.h"
+#include "materialsystem/itexture.h"
 #include "bitmap/imageformat.h" // hack : don't want to include this just for ImageFormat
 #include "filesystem.h"
 #include "tier1/strtools.h"
 #include "tier0/dbg.h"
 #include "TextureSystem.h"
+#include "MaterialIndex.h"
+#include "ThumbnailCache.h"
+#include "MaterialPreviewSize.h"
+#include "ImageConvert.h"
 #include "materialproxyfactory_wc.h"
+#include "vtffile.h"
+#include "tier1/fmtstr.h"
 #ifdef HAMMER2013_PORT_TBROWSER_TRANSPARENCY
 #include "pixelwriter.h"
 #endif
 #ifdef HAMMER2013_PORT_TBROWSER_NEWCACHE
-#include "vtffile.h"
 #include "stb_image_resize.h"
-#include "tier1/fmtstr.h"
 #include "texturesystem.h"
 #endif
 
@@ -120,7 +125,7 @@ public:
 		if (name.IsEmpty())
 			return MATERIAL_NO_PREVIEW_IMAGE;
 		FileHandle_t file;
-		if (file = g_pFullFileSystem->Open(name, "rb"))
+		if (!(file = g_pFullFileSystem->Open(name, "rb")))
 			return MATERIAL_PREVIEW_IMAGE_BAD;
 
 		CVTFFile tex;
@@ -162,6 +167,7 @@ public:
 		CVTFFile::Convert(tex.GetData(), pData, width, height, tex.GetFormat(), imageFormat);
 		return MATERIAL_PREVIEW_IMAGE_OK;
 	}
+#endif // HAMMER2013_PORT_TBROWSER_NEWCACHE
 
 	static CUtlString GetPreviewImageFileName(IMaterial* pMaterial)
 	{
@@ -188,12 +194,14 @@ private:
 		{
 			if (tex->GetType() == MATERIAL_VAR_TYPE_STRING)
 				return tex->GetStringValue();
-		//	if (tex->GetType() == MATERIAL_VAR_TYPE_TEXTURE)
-		//		return tex->GetTextureValue()->GetName();
+			// Once the material is loaded the variable holds the texture itself.
+			if (tex->GetType() == MATERIAL_VAR_TYPE_TEXTURE && tex->GetTextureValue() && !tex->GetTextureValue()->IsError())
+				return tex->GetTextureValue()->GetName();
 		}
 		return pMaterial->GetName();
 	}
 
+#ifdef HAMMER2013_PORT_TBROWSER_NEWCACHE
 	static PreviewImageRetVal_t GetPreviewImagePropertiesInternal(IMaterial* pMaterial, int& width, int& height, ImageFormat& imageFormat, bool& isTranslucent)
 	{
 		const auto name = GetPreviewImageFileName(pMaterial);
@@ -206,7 +214,7 @@ private:
 		}
 
 		FileHandle_t file;
-		if (file = g_pFullFileSystem->Open(name, "rb"))
+		if (!(file = g_pFullFileSystem->Open(name, "rb")))
 			return MATERIAL_PREVIEW_IMAGE_BAD;
 
 		CVTFFile tex;
@@ -252,6 +260,7 @@ public:
 	CMaterialImageCache(int maxNumGraphicsLoaded);
 	~CMaterialImageCache(void);
 	void EnCache( CMaterial *pMaterial );
+	void Flush( void );
 
 protected:
 
@@ -315,8 +324,26 @@ void CMaterialImageCache::EnCache( CMaterial *pMaterial )
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Frees the image data of every material in the cache.
+//-----------------------------------------------------------------------------
+void CMaterialImageCache::Flush( void )
+{
+	for (int i = 0; i < cacheSize; i++)
+	{
+		if ((pool[i]) && (pool[i]->HasData()))
+		{
+			pool[i]->FreeData();
+		}
+		pool[i] = NULL;
+	}
+	currentID = 0;
+}
+
 static CMaterialImageCache *g_pMaterialImageCache = NULL;
 
+int CMaterial::s_nPreviewSize = 512;
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -324,6 +351,7 @@ CMaterialCache::CMaterialCache(void)
 {
 	m_pCache = NULL;
 	m_nMaxEntries = 0;
+	m_nEntries = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -427,6 +455,7 @@ void CMaterialCache::AddMaterial(CMaterial *pMaterial)
 		{
 			m_pCache[m_nEntries].pMaterial = pMaterial;
 			m_pCache[m_nEntries].nRefCount = 1;
+			m_EntryIndex.Insert(pMaterial->GetName(), m_nEntries);
 			m_nEntries++;
 		}
 	}
@@ -440,14 +469,11 @@ void CMaterialCache::AddMaterial(CMaterial *pMaterial)
 //-----------------------------------------------------------------------------
 void CMaterialCache::AddRef(CMaterial *pMaterial)
 {
-	for (int i = 0; i < m_nEntries; i++)
+	int i;
+	if ((pMaterial != NULL) && m_EntryIndex.Find(pMaterial->GetName(), i) && (m_pCache[i].pMaterial == pMaterial))
 	{
-		if (m_pCache[i].pMaterial == pMaterial)
-		{
-			m_pCache[i].nRefCount++;
-			return;
-		}
-	}	
+		m_pCache[i].nRefCount++;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -457,15 +483,10 @@ void CMaterialCache::AddRef(CMaterial *pMaterial)
 //-----------------------------------------------------------------------------
 CMaterial *CMaterialCache::FindMaterial(const char *pszMaterialName)
 {
-	if (pszMaterialName != NULL)
+	int i;
+	if ((pszMaterialName != NULL) && m_EntryIndex.Find(pszMaterialName, i))
 	{
-		for (int i = 0; i < m_nEntries; i++)
-		{
-			if (!stricmp(m_pCache[i].pMaterial->GetName(), pszMaterialName))
-			{
-				return(m_pCache[i].pMaterial);
-			}
-		}
+		return(m_pCache[i].pMaterial);
 	}
 
 	return(NULL);
@@ -478,24 +499,24 @@ CMaterial *CMaterialCache::FindMaterial(const char *pszMaterialName)
 //-----------------------------------------------------------------------------
 void CMaterialCache::Release(CMaterial *pMaterial)
 {
-	if (pMaterial != NULL)
+	int i;
+	if ((pMaterial != NULL) && m_EntryIndex.Find(pMaterial->GetName(), i) && (m_pCache[i].pMaterial == pMaterial))
 	{
-		for (int i = 0; i < m_nEntries; i++)
+		m_pCache[i].nRefCount--;
+		if (m_pCache[i].nRefCount == 0)
 		{
-			if (m_pCache[i].pMaterial == pMaterial)
-			{
-				m_pCache[i].nRefCount--;
-				if (m_pCache[i].nRefCount == 0)
-				{
-					delete m_pCache[i].pMaterial;
+			m_EntryIndex.Remove(pMaterial->GetName());
+			delete m_pCache[i].pMaterial;
 
-					m_nEntries--;
-					m_pCache[i] = m_pCache[m_nEntries];
+			m_nEntries--;
+			m_pCache[i] = m_pCache[m_nEntries];
 
-					memset(&m_pCache[m_nEntries], 0, sizeof(m_pCache[0]));
-				}
-	
-				break;
+			memset(&m_pCache[m_nEntries], 0, sizeof(m_pCache[0]));
+
+			// The last entry moved into the hole.
+			if (i < m_nEntries)
+			{
+				m_EntryIndex.Replace(m_pCache[i].pMaterial->GetName(), i);
 			}
 		}
 	}
@@ -514,6 +535,8 @@ CMaterial::CMaterial(void)
 	m_nHeight = 0;
 	m_nTextureID = 0;
 	m_pData = NULL;
+	m_nPreviewWidth = 0;
+	m_nPreviewHeight = 0;
 	m_bLoaded = false;
 	m_pMaterial = NULL;
 	m_TranslucentBaseTexture = false;
@@ -529,7 +552,7 @@ CMaterial::~CMaterial(void)
 	//
 	if (m_pData != NULL)
 	{
-		free(m_pData);
+		g_ImageBufferPool.Free(m_pData);
 		m_pData = NULL;
 	}
 
@@ -542,7 +565,6 @@ CMaterial::~CMaterial(void)
 	*/
 }
 
-#define MATERIAL_PREFIX_LEN	10
 //-----------------------------------------------------------------------------
 // Finds all .VMT files in a particular directory
 //-----------------------------------------------------------------------------
@@ -652,6 +674,12 @@ bool CMaterial::InitDirectoryRecursive( char const* pDirectoryName,
 //-----------------------------------------------------------------------------
 void CMaterial::EnumerateMaterials( IMaterialEnumerator *pEnum, const char *szRoot, int nContext, int nFlags )
 {
+	if ( g_MaterialIndex.IsEnabled() )
+	{
+		g_MaterialIndex.EnumerateMaterials( pEnum, szRoot, nContext, nFlags );
+		return;
+	}
+
 	InitDirectoryRecursive( szRoot, pEnum, nContext, nFlags );
 }
 
@@ -886,10 +914,10 @@ void CMaterial::DrawIcon( CDC *pDC, CMaterial* pIcon, RECT& dstRect )
 	g_pMaterialImageCache->EnCache(pIcon);
 
 	RECT rect, dst;
-	rect.left = 0; rect.right = pIcon->GetWidth();
+	rect.left = 0; rect.right = pIcon->m_nPreviewWidth;
 
 	// FIXME: Workaround the fact that materials must be power of 2, I want 12 bite
-	rect.top = 2; rect.bottom = pIcon->GetHeight() - 2;
+	rect.top = 2; rect.bottom = pIcon->m_nPreviewHeight - 2;
 
 	dst = dstRect;
 	float dstHeight = dstRect.bottom - dstRect.top;
@@ -1015,7 +1043,7 @@ void CMaterial::DrawBitmap( CDC *pDC, RECT& srcRect, RECT& dstRect )
 
 #ifdef HAMMER2013_PORT_TBROWSER_TRANSPARENCY
 	bmih.biBitCount = m_TranslucentBaseTexture ? 32 : 24;
-	bmih.biSizeImage = m_nWidth * m_nHeight * (m_TranslucentBaseTexture ? 4 : 3);
+	bmih.biSizeImage = m_nPreviewWidth * m_nPreviewHeight * (m_TranslucentBaseTexture ? 4 : 3);
 #else
 	bmih.biBitCount = 24;
 #endif
@@ -1041,14 +1069,14 @@ void CMaterial::DrawBitmap( CDC *pDC, RECT& srcRect, RECT& dstRect )
 		auto hdc = CreateCompatibleDC(pDC->m_hDC);
 		auto bitmap = CreateDIBSection(hdc, (BITMAPINFO*)&bmi, DIB_RGB_COLORS, &data, NULL, 0x0);
 		CPixelWriter writer;
-		writer.SetPixelMemory(IMAGE_FORMAT_BGRA8888, data, m_nWidth * 4);
+		writer.SetPixelMemory(IMAGE_FORMAT_BGRA8888, data, m_nPreviewWidth * 4);
 
 		const int boxSize = 32; // size of the grid of the transparent background
 		
-		for (int y = 0; y < m_nHeight; ++y)
+		for (int y = 0; y < m_nPreviewHeight; ++y)
 		{
 			writer.Seek(0, y);
-			for (int x = 0; x < m_nWidth; ++x)
+			for (int x = 0; x < m_nPreviewWidth; ++x)
 			{
 				if ((x & boxSize) ^ (y & boxSize))
 					writer.WritePixel(204, 204, 204, 255); // colours of the transparent background
@@ -1058,7 +1086,8 @@ void CMaterial::DrawBitmap( CDC *pDC, RECT& srcRect, RECT& dstRect )
 		}
 
 		SelectObject(hdc, bitmap);
-		BitBlt(pDC->m_hDC, dstRect.left, dstRect.top, dest_width, dest_height, hdc, srcRect.left, -srcRect.top, SRCCOPY);
+		SetStretchBltMode(pDC->m_hDC, COLORONCOLOR);
+		StretchBlt(pDC->m_hDC, dstRect.left, dstRect.top, dest_width, dest_height, hdc, srcRect.left, -srcRect.top, srcWidth, srcHeight, SRCCOPY);
 		DeleteObject(bitmap);
 
 		bitmap = CreateBitmap(srcWidth, srcHeight, 1, 32, m_pData);
@@ -1135,8 +1164,8 @@ NoData:
 	RECT srcRect, dstRect;
 	srcRect.left = 0;
 	srcRect.top = 0;
-	srcRect.right = m_nWidth;
-	srcRect.bottom = m_nHeight;
+	srcRect.right = m_nPreviewWidth;
+	srcRect.bottom = m_nPreviewHeight;
 	dstRect = rect;
 
 	if (DrawTexData.nFlags & drawCaption)
@@ -1258,7 +1287,7 @@ NoData:
 //-----------------------------------------------------------------------------
 void CMaterial::FreeData( void )
 {
-	free( m_pData );
+	g_ImageBufferPool.Free( m_pData );
 	m_pData = NULL;
 }
 
@@ -1270,6 +1299,21 @@ void CMaterial::FreeData( void )
 //-----------------------------------------------------------------------------
 int CMaterial::GetKeywords(char *pszKeywords) const
 {
+	// The material index knows the keywords of materials that aren't loaded yet.
+	if (!m_bLoaded)
+	{
+		const MaterialIndexFile_t *pIndexed = g_MaterialIndex.FindMaterial(m_szName);
+		if (pIndexed != NULL)
+		{
+			if (pszKeywords != NULL)
+			{
+				V_strncpy(pszKeywords, pIndexed->m_Keywords, MAX_PATH);
+			}
+
+			return(pIndexed->m_Keywords.Length());
+		}
+	}
+
 	// To access keywords, we have to have the header loaded
 	const_cast<CMaterial*>(this)->Load();
 	if (pszKeywords != NULL)
@@ -1405,30 +1449,29 @@ int CMaterial::GetImageDataRGB( void *pImageRGB )
 {
 	Assert( m_nWidth > 0 );
 
-	if ( pImageRGB != NULL )
+	// The cached texel data is sized by the preview, which is what gets copied.
+	Load();
+	g_pMaterialImageCache->EnCache( this );
+	if (!this->HasData())
 	{
-		Load();
-
-		g_pMaterialImageCache->EnCache( this );
-		if (!this->HasData())
-		{
-			return(NULL);
-		}
+		return(NULL);
+	}
 
+	int nPixels = m_nPreviewWidth * m_nPreviewHeight;
+	if ( pImageRGB != NULL )
+	{
 		unsigned char *src, *dst;
 		src = ( unsigned char * )m_pData;
 		dst = (unsigned char *)pImageRGB;
-		for( ; src < ( unsigned char * )m_pData + m_nWidth * m_nHeight * 3; src += 3, dst += 3 )
+		for( ; src < ( unsigned char * )m_pData + nPixels * 3; src += 3, dst += 3 )
 		{
 			dst[0] = src[2];
 			dst[1] = src[1];
 			dst[2] = src[0];
 		}
-
-		return(	m_nWidth * m_nHeight * 3 );
 	}
 
-	return(	m_nWidth * m_nHeight * 3 );
+	return(	nPixels * 3 );
 }
 
 //-----------------------------------------------------------------------------
@@ -1442,33 +1485,34 @@ int CMaterial::GetImageDataRGBA(void *pImageRGBA)
 {
 	Assert( m_nWidth > 0 );
 
-	if (pImageRGBA != NULL)
+	Load();
+	g_pMaterialImageCache->EnCache(this);
+	if (!this->HasData())
 	{
-		Load();
-
-		g_pMaterialImageCache->EnCache(this);
-		if (!this->HasData())
-		{
-			return(NULL);
-		}
+		return(NULL);
+	}
 
+	int nPixels = m_nPreviewWidth * m_nPreviewHeight;
+	if (pImageRGBA != NULL)
+	{
+		// The cached texel data is BGR888 in this configuration.
 		unsigned char *src, *dst;
 		src = (unsigned char *)m_pData;
 		dst = (unsigned char *)pImageRGBA;
 
-		while (src < (unsigned char *)m_pData + m_nWidth * m_nHeight * 4);	
+		while (src < (unsigned char *)m_pData + nPixels * 3)
 		{
 			dst[0] = src[2];
 			dst[1] = src[1];
 			dst[2] = src[0];
 			dst[3] = 0;
 
-			src += 4;
+			src += 3;
 			dst += 4;
 		}
 	}
 
-	return(m_nWidth * m_nHeight * 4);
+	return(nPixels * 4);
 }
 #endif
 //-----------------------------------------------------------------------------
@@ -1539,6 +1583,82 @@ float CMaterial::GetDecalScale(void) const
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Sets the largest size materials are shown at in the texture
+//			browser. Previews loaded for another size are thrown away.
+//-----------------------------------------------------------------------------
+void CMaterial::SetPreviewSize( int nSize )
+{
+	if (nSize == s_nPreviewSize)
+		return;
+
+	s_nPreviewSize = nSize;
+
+	if (g_pMaterialImageCache)
+	{
+		g_pMaterialImageCache->Flush();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads the preview of a material that is larger than the preview
+//			size straight from its VTF, reading only the smallest mip that
+//			still covers the preview size.
+// Output : Returns false if the preview should come from the material system
+//			at full size instead.
+//-----------------------------------------------------------------------------
+bool CMaterial::LoadPreviewImage( ImageFormat imageFormat )
+{
+	if ((m_nWidth <= s_nPreviewSize) && (m_nHeight <= s_nPreviewSize))
+		return false;
+
+	CUtlString fileName = CPreviewImagePropertiesCache::GetPreviewImageFileName(m_pMaterial);
+	if (fileName.IsEmpty())
+		return false;
+
+	int nMinWidth, nMinHeight;
+	MaterialPreview_GetMinSize(m_nWidth, m_nHeight, s_nPreviewSize, nMinWidth, nMinHeight);
+
+	ThumbnailImage_t image;
+	if (!g_ThumbnailCache.GetThumbnail(fileName, nMinWidth, nMinHeight, image))
+		return false;
+
+	m_pData = g_ImageBufferPool.Alloc(image.m_nWidth * image.m_nHeight * (m_TranslucentBaseTexture ? 4 : 3));
+	Assert(m_pData);
+
+	if (!CVTFFile::Convert(image.m_Data.Base(), (unsigned char*)m_pData, image.m_nWidth, image.m_nHeight, image.m_Format, imageFormat))
+	{
+		g_ImageBufferPool.Free(m_pData);
+		m_pData = NULL;
+		return false;
+	}
+
+	m_nPreviewWidth = image.m_nWidth;
+	m_nPreviewHeight = image.m_nHeight;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Box filters a full size preview down by halves while it stays at
+//			least as large as the preview size.
+//-----------------------------------------------------------------------------
+void CMaterial::ShrinkToPreviewSize( int nBytesPerPixel )
+{
+	while (MaterialPreview_ShouldHalve(m_nPreviewWidth, m_nPreviewHeight, s_nPreviewSize))
+	{
+		int nWidth = max(m_nPreviewWidth / 2, 1);
+		int nHeight = max(m_nPreviewHeight / 2, 1);
+
+		void *pData = g_ImageBufferPool.Alloc(nWidth * nHeight * nBytesPerPixel);
+		ImageConvert_HalveBox((unsigned char*)m_pData, m_nPreviewWidth, m_nPreviewHeight, nBytesPerPixel, (unsigned char*)pData);
+		g_ImageBufferPool.Free(m_pData);
+
+		m_pData = pData;
+		m_nPreviewWidth = nWidth;
+		m_nPreviewHeight = nHeight;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Output : Returns true on success, false on failure.
@@ -1551,37 +1671,51 @@ bool CMaterial::LoadMaterialImage( void )
 		return(false);
 	
 #ifdef HAMMER2013_PORT_TBROWSER_TRANSPARENCY // premultiply alpha for the material
-//	const auto maxWidth = Min(m_nWidth, 512);
-//	const auto maxHeight = Min(m_nHeight, 512);
-	const auto size = m_nWidth * m_nHeight * (m_TranslucentBaseTexture ? 4 : 3);
-	m_pData = malloc(size);
-	Assert(m_pData);
-	memset(m_pData, 0, size);
-
 	ImageFormat imageFormat = m_TranslucentBaseTexture ? IMAGE_FORMAT_BGRA8888 : IMAGE_FORMAT_BGR888;
 
+	PreviewImageRetVal_t retVal;
+	if (LoadPreviewImage(imageFormat))
+	{
+		// VTF mips hold straight alpha, so they can only be premultiplied
+		// once filtered.
+		retVal = MATERIAL_PREVIEW_IMAGE_OK;
+		if (m_TranslucentBaseTexture)
+		{
+			ImageConvert_PremultiplyAlpha((unsigned char*)m_pData, m_nPreviewWidth * m_nPreviewHeight);
+		}
+	}
+	else
+	{
+		m_nPreviewWidth = m_nWidth;
+		m_nPreviewHeight = m_nHeight;
+
+		const auto size = m_nWidth * m_nHeight * (m_TranslucentBaseTexture ? 4 : 3);
+		m_pData = g_ImageBufferPool.Alloc(size);
+		Assert(m_pData);
+		memset(m_pData, 0, size);
+
 #ifdef HAMMER2013_PORT_TBROWSER_NEWCACHE
-	PreviewImageRetVal_t retVal = CPreviewImagePropertiesCache::GetPreviewImage(m_pMaterial, (unsigned char*)m_pData, maxWdith, maxHeight, imageFormat);
+		retVal = CPreviewImagePropertiesCache::GetPreviewImage(m_pMaterial, (unsigned char*)m_pData, m_nWidth, m_nHeight, imageFormat);
 #else
-	PreviewImageRetVal_t retVal;
-	retVal = m_pMaterial->GetPreviewImage((unsigned char*)m_pData, m_nWidth, m_nHeight, imageFormat);
+		retVal = m_pMaterial->GetPreviewImage((unsigned char*)m_pData, m_nWidth, m_nHeight, imageFormat);
 #endif
-	if (retVal == MATERIAL_PREVIEW_IMAGE_OK && m_TranslucentBaseTexture)
-	{
-		auto data = (unsigned char*)m_pData;
-		auto size = m_nWidth * size_t(m_nHeight) * 4;
-		for (size_t i = 0; i < size; i += 4)
+		if (retVal == MATERIAL_PREVIEW_IMAGE_OK)
 		{
-			auto a = data[i + 3];
-			data[i + 0] = (data[i + 0] * a) / 255;
-			data[i + 1] = (data[i + 1] * a) / 255;
-			data[i + 2] = (data[i + 2] * a) / 255;
+			// Premultiply first so transparent texels don't bleed their
+			// color into the filtered preview.
+			if (m_TranslucentBaseTexture)
+			{
+				ImageConvert_PremultiplyAlpha((unsigned char*)m_pData, m_nWidth * m_nHeight);
+			}
+			ShrinkToPreviewSize(m_TranslucentBaseTexture ? 4 : 3);
 		}
 	}
 	return retVal != MATERIAL_PREVIEW_IMAGE_BAD;
 #else
-	m_pData = malloc(m_nWidth * m_nHeight * 3);
+	m_pData = g_ImageBufferPool.Alloc(m_nWidth * m_nHeight * 3);
 	Assert(m_pData);
+	m_nPreviewWidth = m_nWidth;
+	m_nPreviewHeight = m_nHeight;
 
 	ImageFormat imageFormat;
 
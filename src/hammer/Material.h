@@ -12,6 +12,7 @@
 #include "IEditorTexture.h"
 #include "materialsystem/imaterialvar.h"
 #include "materialsystem/imaterial.h"
+#include "TextureNameMap.h"
 
 class IMaterial;
 class CMaterialCache;
@@ -20,6 +21,8 @@ class IMaterialSystemHardwareConfig;
 struct MaterialSystem_Config_t;
 struct MaterialCacheEntry_t;
 
+#define MATERIAL_PREFIX_LEN			10	// strlen( "materials/" )
+
 #define INCLUDE_MODEL_MATERIALS		0x01
 #define INCLUDE_WORLD_MATERIALS		0x02
 #define INCLUDE_ALL_MATERIALS		0xFFFFFFFF
@@ -138,6 +141,10 @@ public:
 
 	bool IsWater( void ) const;
 
+	// Largest size the texture browser shows a material at. Previews of
+	// bigger materials are loaded from a smaller mip.
+	static void SetPreviewSize( int nSize );
+
 #ifdef SLE //// SLE NEW - lets us filter face textures by their vmt variable
 	bool HasVariable(const char* var) const;
 	bool HasVariableWithValue(const char* var, const char* val) const;
@@ -163,6 +170,8 @@ protected:
 	CMaterial(void);
 	bool LoadMaterialHeader(IMaterial *material);
 	bool LoadMaterialImage();
+	bool LoadPreviewImage( ImageFormat imageFormat );
+	void ShrinkToPreviewSize( int nBytesPerPixel );
 
 	static bool IsIgnoredMaterial( const char *pName );
 
@@ -182,12 +191,17 @@ protected:
 	bool m_bLoaded;				// We don't load these immediately; only when needed..
 
 	void *m_pData;				// Loaded texel data (NULL if not loaded).
+	int m_nPreviewWidth;		// Size of the loaded texel data, which may be a smaller mip than the texture.
+	int m_nPreviewHeight;
+
+	static int s_nPreviewSize;
 #ifdef SLE
 public:
 #endif
 	IMaterial *m_pMaterial;
 
 	friend class CMaterialImageCache;
+	friend class CMaterialIndex;
 };
 
 typedef CMaterial *CMaterialPtr;
@@ -217,6 +231,8 @@ class CMaterialCache
 		MaterialCacheEntry_t *m_pCache;
 		int m_nMaxEntries;
 		int m_nEntries;
+
+		CTextureNameMap<int> m_EntryIndex;	// Maps material names to indices into m_pCache.
 };
 
 //-----------------------------------------------------------------------------
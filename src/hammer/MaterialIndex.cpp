@@ -0,0 +1,710 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent on-disk index of the materials directory tree.
+//
+//			The index stores, for every directory under materials/, the .vmt
+//			files and subdirectories in the order the file system listed them,
+//			plus a stamp built from the directory's modification time in each
+//			loose search path. On startup the stamps are recomputed in parallel
+//			and only directories whose stamp changed are listed again. Editing
+//			a file does not change the time of its directory, so every loose
+//			.vmt is also stat'ed once, in the search path it was found in, and
+//			only the files that changed are read again. Pack files cannot be
+//			checked per directory or per file, so their sizes and times are
+//			folded into a signature that invalidates the whole index.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include <sys/stat.h>
+#include "hammer.h"
+#include "Material.h"
+#include "MaterialIndex.h"
+#include "filesystem.h"
+#include "tier1/KeyValues.h"
+#include "tier1/strtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/checksum_crc.h"
+#include "vstdlib/jobthread.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+#define MATERIALINDEX_MAGIC			MAKEID( 'M', 'I', 'D', 'X' )
+
+CMaterialIndex g_MaterialIndex;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+//-----------------------------------------------------------------------------
+CMaterialIndex::CMaterialIndex( void )
+{
+	m_bEnabled = true;
+	m_bLoaded = false;
+	m_bDirty = false;
+	m_nSignature = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CMaterialIndex::~CMaterialIndex( void )
+{
+	Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees all directory entries.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::Purge( void )
+{
+	m_Lookup.Purge();
+	m_Dirs.PurgeAndDeleteElements();
+	m_LooseRoots.Purge();
+	m_LooseRootNames.Purge();
+	m_bLoaded = false;
+	m_bDirty = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a directory path with the leading "materials/" removed.
+//-----------------------------------------------------------------------------
+const char *CMaterialIndex::GetRelativePath( const char *pszPath )
+{
+	int nLen = Q_strlen( pszPath );
+	return pszPath + min( nLen, MATERIAL_PREFIX_LEN );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds a material name from a directory and a .vmt file name the
+//			same way CMaterial::LoadMaterialsInDirectory does.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::BuildMaterialName( const char *pszDirectory, const char *pszFileName, char *pszName, int nNameSize )
+{
+	// Strip off the 'materials/' part of the material name.
+	Q_snprintf( pszName, nNameSize, "%s/%s", GetRelativePath( pszDirectory ), pszFileName );
+	Q_strnlwr( pszName, nNameSize );
+
+	// Strip off the extension...
+	char *pExt = Q_strrchr( pszName, '.' );
+	if ( pExt )
+		*pExt = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the full path of the index file for the active mod.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::GetIndexFileName( char *pszFileName, int nSize ) const
+{
+	char szProgramDir[MAX_PATH];
+	APP()->GetDirectory( DIR_PROGRAM, szProgramDir );
+
+	char szModDir[MAX_PATH];
+	APP()->GetDirectory( DIR_MOD, szModDir );
+	Q_strlower( szModDir );
+	CRC32_t nModCRC = CRC32_ProcessSingleBuffer( szModDir, Q_strlen( szModDir ) );
+
+	char szName[MAX_PATH];
+	Q_snprintf( szName, sizeof( szName ), "materialindex_%08x.dat", nModCRC );
+	Q_ComposeFileName( szProgramDir, szName, pszFileName, nSize );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Combines the search path list and the size and time of every pack
+//			file into one value. Also collects the loose search directories.
+//-----------------------------------------------------------------------------
+unsigned int CMaterialIndex::ComputeSignature( void )
+{
+	m_LooseRoots.RemoveAll();
+
+	CRC32_t nCRC;
+	CRC32_Init( &nCRC );
+
+	int nVersion = MATERIALINDEX_VERSION;
+	CRC32_ProcessBuffer( &nCRC, &nVersion, sizeof( nVersion ) );
+
+	int nLen = g_pFullFileSystem->GetSearchPath( "GAME", true, NULL, 0 );
+	char *pszSearchPaths = (char *)stackalloc( nLen + 1 );
+	g_pFullFileSystem->GetSearchPath( "GAME", true, pszSearchPaths, nLen + 1 );
+
+	CUtlVector<char *> SearchPaths;
+	V_SplitString( pszSearchPaths, ";", SearchPaths );
+	for ( int i = 0; i < SearchPaths.Count(); i++ )
+	{
+		char szPath[MAX_PATH];
+		V_strcpy_safe( szPath, SearchPaths[i] );
+		V_StripTrailingSlash( szPath );
+		Q_strlower( szPath );
+
+		CRC32_ProcessBuffer( &nCRC, szPath, Q_strlen( szPath ) );
+
+		struct _stat64 FileInfo;
+		if ( _stat64( szPath, &FileInfo ) != 0 )
+		{
+			continue;
+		}
+
+		if ( FileInfo.st_mode & _S_IFDIR )
+		{
+			m_LooseRoots.AddToTail( szPath );
+		}
+		else
+		{
+			CRC32_ProcessBuffer( &nCRC, &FileInfo.st_size, sizeof( FileInfo.st_size ) );
+			CRC32_ProcessBuffer( &nCRC, &FileInfo.st_mtime, sizeof( FileInfo.st_mtime ) );
+		}
+	}
+	SearchPaths.PurgeAndDeleteElements();
+
+	m_LooseRootNames.RemoveAll();
+	for ( int i = 0; i < m_LooseRoots.Count(); i++ )
+	{
+		m_LooseRootNames.AddToTail( m_LooseRoots[i].Get() );
+	}
+
+	CRC32_Final( &nCRC );
+	return nCRC;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Combines the modification times of a directory in every loose
+//			search path. Adding, removing or renaming an entry changes it.
+//			Safe to call from worker threads.
+//-----------------------------------------------------------------------------
+unsigned int CMaterialIndex::ComputeDirectoryStamp( const char *pszPath ) const
+{
+	CRC32_t nCRC;
+	CRC32_Init( &nCRC );
+
+	for ( int i = 0; i < m_LooseRoots.Count(); i++ )
+	{
+		char szFullPath[MAX_PATH];
+		Q_ComposeFileName( m_LooseRoots[i], pszPath, szFullPath, sizeof( szFullPath ) );
+
+		__int64 nTime = -1;
+		struct _stat64 FileInfo;
+		if ( _stat64( szFullPath, &FileInfo ) == 0 )
+		{
+			nTime = FileInfo.st_mtime;
+		}
+
+		CRC32_ProcessBuffer( &nCRC, &nTime, sizeof( nTime ) );
+	}
+
+	CRC32_Final( &nCRC );
+	return nCRC;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Worker callback. Recomputes the stamp of a cached directory.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::StampDirectory( MaterialIndexDir_t *&pDir )
+{
+	pDir->m_nNewStamp = g_MaterialIndex.ComputeDirectoryStamp( pDir->m_Path );
+	pDir->m_bStamped = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the size and time of a file in a loose search path.
+//			Safe to call from worker threads.
+//-----------------------------------------------------------------------------
+bool CMaterialIndex::StatLooseFile( const char *pszFullPath, long &nFileTime, unsigned int &nFileSize )
+{
+	struct _stat64 FileInfo;
+	if ( ( _stat64( pszFullPath, &FileInfo ) != 0 ) || ( FileInfo.st_mode & _S_IFDIR ) )
+	{
+		return false;
+	}
+
+	nFileTime = (long)FileInfo.st_mtime;
+	nFileSize = (unsigned int)FileInfo.st_size;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Worker callback. Updates the size and time of a .vmt file and, if
+//			either changed, reads the VMT parameters the index keeps.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::RefreshFile( MaterialIndexRefresh_t &Refresh )
+{
+	MaterialIndexFile_t *pFile = Refresh.m_pFile;
+
+	char szFileName[MAX_PATH];
+	Q_snprintf( szFileName, sizeof( szFileName ), "%s/%s", Refresh.m_pDir->m_Path.Get(), pFile->m_FileName.Get() );
+
+	const CUtlVector<const char *> &Roots = g_MaterialIndex.m_LooseRootNames;
+	MaterialIndexCheck_t eCheck = MaterialIndex_CheckFile( Roots.Base(), Roots.Count(), szFileName, Refresh.m_bResolve,
+		pFile->m_nRoot, pFile->m_nFileTime, pFile->m_nFileSize, StatLooseFile );
+
+	if ( eCheck == MATERIALINDEX_FILE_PACKED )
+	{
+		// Only reached when the directory was listed again.
+		long nFileTime = g_pFullFileSystem->GetFileTime( szFileName, "GAME" );
+		unsigned int nFileSize = g_pFullFileSystem->Size( szFileName, "GAME" );
+
+		eCheck = ( ( nFileTime != pFile->m_nFileTime ) || ( nFileSize != pFile->m_nFileSize ) ) ? MATERIALINDEX_FILE_CHANGED : MATERIALINDEX_FILE_UNCHANGED;
+		pFile->m_nFileTime = nFileTime;
+		pFile->m_nFileSize = nFileSize;
+	}
+
+	if ( eCheck == MATERIALINDEX_FILE_UNCHANGED )
+	{
+		pFile->m_bChanged = false;
+		return;
+	}
+
+	pFile->m_Keywords.Clear();
+
+	KeyValues *pKeyValues = new KeyValues( "vmt" );
+	if ( pKeyValues->LoadFromFile( g_pFullFileSystem, szFileName, "GAME" ) )
+	{
+		pFile->m_Keywords = pKeyValues->GetString( "%keywords" );
+	}
+	pKeyValues->deleteThis();
+
+	pFile->m_bChanged = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the cached entry for a directory, NULL if there is none.
+//-----------------------------------------------------------------------------
+MaterialIndexDir_t *CMaterialIndex::FindDir( const char *pszPath ) const
+{
+	int nIndex = m_Dirs.Find( pszPath );
+	if ( nIndex == m_Dirs.InvalidIndex() )
+	{
+		return NULL;
+	}
+
+	return m_Dirs[nIndex];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Creates an empty entry for a directory.
+//-----------------------------------------------------------------------------
+MaterialIndexDir_t *CMaterialIndex::AddDir( const char *pszPath )
+{
+	Assert( FindDir( pszPath ) == NULL );
+
+	MaterialIndexDir_t *pDir = new MaterialIndexDir_t;
+	pDir->m_Path = pszPath;
+	m_Dirs.Insert( pszPath, pDir );
+	return pDir;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Gathers every cached directory reachable from the given one, so
+//			that their stamps can be computed in parallel.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::CollectDirs( const char *pszPath, int nFlags, CUtlVector<MaterialIndexDir_t *> &Dirs )
+{
+	if ( CMaterial::ShouldSkipMaterial( GetRelativePath( pszPath ), nFlags ) )
+		return;
+
+	MaterialIndexDir_t *pDir = FindDir( pszPath );
+	if ( pDir == NULL )
+		return;
+
+	pDir->m_bStamped = false;
+	Dirs.AddToTail( pDir );
+
+	for ( int i = 0; i < pDir->m_SubDirs.Count(); i++ )
+	{
+		CollectDirs( pDir->m_SubDirs[i], nFlags, Dirs );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Lists a directory through the file system, the same way
+//			CMaterial::InitDirectoryRecursive does. File info that is still
+//			valid is carried over from the previous listing.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::ScanDir( MaterialIndexDir_t *pDir )
+{
+	CUtlVector<MaterialIndexFile_t> OldFiles;
+	OldFiles.Swap( pDir->m_Files );
+	pDir->m_SubDirs.RemoveAll();
+
+	char szWildCard[MAX_PATH];
+	FileFindHandle_t findHandle;
+
+	Q_snprintf( szWildCard, sizeof( szWildCard ), "%s/*.vmt", pDir->m_Path.Get() );
+	const char *pFileName = g_pFullFileSystem->FindFirstEx( szWildCard, "GAME", &findHandle );
+	while ( pFileName )
+	{
+		if ( !CMaterial::IsIgnoredMaterial( pFileName ) && !g_pFullFileSystem->FindIsDirectory( findHandle ) )
+		{
+			int nFile = pDir->m_Files.AddToTail();
+			MaterialIndexFile_t &File = pDir->m_Files[nFile];
+			File.m_FileName = pFileName;
+
+			for ( int i = 0; i < OldFiles.Count(); i++ )
+			{
+				if ( !Q_stricmp( OldFiles[i].m_FileName, pFileName ) )
+				{
+					File = OldFiles[i];
+					break;
+				}
+			}
+		}
+		pFileName = g_pFullFileSystem->FindNext( findHandle );
+	}
+	g_pFullFileSystem->FindClose( findHandle );
+
+	Q_snprintf( szWildCard, sizeof( szWildCard ), "%s/*.*", pDir->m_Path.Get() );
+	pFileName = g_pFullFileSystem->FindFirstEx( szWildCard, "GAME", &findHandle );
+	while ( pFileName )
+	{
+		if ( !CMaterial::IsIgnoredMaterial( pFileName ) )
+		{
+			if ( ( pFileName[0] != '.' ) || ( pFileName[1] != '.' && pFileName[1] != 0 ) )
+			{
+				if ( g_pFullFileSystem->FindIsDirectory( findHandle ) )
+				{
+					char szSubDir[MAX_PATH];
+					Q_snprintf( szSubDir, sizeof( szSubDir ), "%s/%s", pDir->m_Path.Get(), pFileName );
+					pDir->m_SubDirs.AddToTail( szSubDir );
+				}
+			}
+		}
+		pFileName = g_pFullFileSystem->FindNext( findHandle );
+	}
+	g_pFullFileSystem->FindClose( findHandle );
+
+	m_bDirty = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Walks the tree from the given directory, listing again every
+//			directory that is new or whose stamp changed.
+// Input  : RefreshFiles - Receives every file in the tree, to be checked
+//				for changes.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::UpdateDir( const char *pszPath, int nFlags, CUtlVector<MaterialIndexRefresh_t> &RefreshFiles )
+{
+	// Make sure this is an ok directory, otherwise don't bother
+	if ( CMaterial::ShouldSkipMaterial( GetRelativePath( pszPath ), nFlags ) )
+		return;
+
+	bool bRescan = false;
+
+	MaterialIndexDir_t *pDir = FindDir( pszPath );
+	if ( pDir == NULL )
+	{
+		pDir = AddDir( pszPath );
+		bRescan = true;
+	}
+
+	// Directories that were not in the index when stamps were computed.
+	if ( !pDir->m_bStamped )
+	{
+		pDir->m_nNewStamp = ComputeDirectoryStamp( pszPath );
+		pDir->m_bStamped = true;
+	}
+
+	if ( pDir->m_nNewStamp != pDir->m_nStamp )
+	{
+		bRescan = true;
+	}
+
+	if ( bRescan )
+	{
+		ScanDir( pDir );
+		pDir->m_nStamp = pDir->m_nNewStamp;
+	}
+
+	for ( int i = 0; i < pDir->m_Files.Count(); i++ )
+	{
+		MaterialIndexRefresh_t Refresh;
+		Refresh.m_pDir = pDir;
+		Refresh.m_pFile = &pDir->m_Files[i];
+		Refresh.m_bResolve = bRescan;
+		RefreshFiles.AddToTail( Refresh );
+	}
+
+	pDir->m_bVisited = true;
+
+	for ( int i = 0; i < pDir->m_SubDirs.Count(); i++ )
+	{
+		UpdateDir( pDir->m_SubDirs[i], nFlags, RefreshFiles );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Enumerates the indexed materials under a directory in the same
+//			order as CMaterial::InitDirectoryRecursive.
+//-----------------------------------------------------------------------------
+bool CMaterialIndex::ReplayDir( const char *pszPath, IMaterialEnumerator *pEnum, int nContext, int nFlags )
+{
+	if ( CMaterial::ShouldSkipMaterial( GetRelativePath( pszPath ), nFlags ) )
+		return true;
+
+	MaterialIndexDir_t *pDir = FindDir( pszPath );
+	if ( pDir == NULL )
+		return true;
+
+	for ( int i = 0; i < pDir->m_Files.Count(); i++ )
+	{
+		char szMaterialName[MAX_PATH];
+		BuildMaterialName( pszPath, pDir->m_Files[i].m_FileName, szMaterialName, sizeof( szMaterialName ) );
+
+		if ( !pEnum->EnumMaterial( szMaterialName, nContext ) )
+			return false;
+	}
+
+	for ( int i = 0; i < pDir->m_SubDirs.Count(); i++ )
+	{
+		if ( !ReplayDir( pDir->m_SubDirs[i], pEnum, nContext, nFlags ) )
+			return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuilds the material name to file info map.
+//-----------------------------------------------------------------------------
+void CMaterialIndex::RebuildLookup( void )
+{
+	m_Lookup.RemoveAll();
+
+	for ( int nDir = m_Dirs.First(); nDir != m_Dirs.InvalidIndex(); nDir = m_Dirs.Next( nDir ) )
+	{
+		MaterialIndexDir_t *pDir = m_Dirs[nDir];
+		for ( int i = 0; i < pDir->m_Files.Count(); i++ )
+		{
+			char szMaterialName[MAX_PATH];
+			BuildMaterialName( pDir->m_Path, pDir->m_Files[i].m_FileName, szMaterialName, sizeof( szMaterialName ) );
+			if ( m_Lookup.Find( szMaterialName ) == m_Lookup.InvalidIndex() )
+			{
+				m_Lookup.Insert( szMaterialName, &pDir->m_Files[i] );
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the indexed info for a material, NULL if it is not indexed.
+//-----------------------------------------------------------------------------
+const MaterialIndexFile_t *CMaterialIndex::FindMaterial( const char *pszMaterialName ) const
+{
+	int nIndex = m_Lookup.Find( pszMaterialName );
+	if ( nIndex == m_Lookup.InvalidIndex() )
+	{
+		return NULL;
+	}
+
+	return m_Lookup[nIndex];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the index file. Leaves the index empty if the file is
+//			missing, from another version, or was built for other search paths.
+//-----------------------------------------------------------------------------
+bool CMaterialIndex::Load( void )
+{
+	char szFileName[MAX_PATH];
+	GetIndexFileName( szFileName, sizeof( szFileName ) );
+
+	CUtlBuffer buf;
+	if ( !g_pFullFileSystem->ReadFile( szFileName, NULL, buf ) )
+	{
+		return false;
+	}
+
+	if ( ( buf.GetInt() != MATERIALINDEX_MAGIC ) || ( buf.GetInt() != MATERIALINDEX_VERSION ) || ( buf.GetUnsignedInt() != m_nSignature ) )
+	{
+		return false;
+	}
+
+	char szString[MAX_PATH];
+
+	int nDirs = buf.GetInt();
+	for ( int nDir = 0; ( nDir < nDirs ) && buf.IsValid(); nDir++ )
+	{
+		buf.GetString( szString, sizeof( szString ) );
+		if ( FindDir( szString ) != NULL )
+		{
+			break;
+		}
+
+		MaterialIndexDir_t *pDir = AddDir( szString );
+		pDir->m_nStamp = buf.GetUnsignedInt();
+
+		int nFiles = buf.GetInt();
+		for ( int i = 0; ( i < nFiles ) && buf.IsValid(); i++ )
+		{
+			MaterialIndexFile_t &File = pDir->m_Files[pDir->m_Files.AddToTail()];
+
+			buf.GetString( szString, sizeof( szString ) );
+			File.m_FileName = szString;
+			File.m_nRoot = buf.GetInt();
+			File.m_nFileTime = buf.GetInt();
+			File.m_nFileSize = buf.GetUnsignedInt();
+			buf.GetString( szString, sizeof( szString ) );
+			File.m_Keywords = szString;
+		}
+
+		int nSubDirs = buf.GetInt();
+		for ( int i = 0; ( i < nSubDirs ) && buf.IsValid(); i++ )
+		{
+			buf.GetString( szString, sizeof( szString ) );
+			pDir->m_SubDirs.AddToTail( szString );
+		}
+	}
+
+	if ( !buf.IsValid() || ( (int)m_Dirs.Count() != nDirs ) )
+	{
+		// Truncated or corrupt; start over with a full scan.
+		m_Dirs.PurgeAndDeleteElements();
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the index file.
+//-----------------------------------------------------------------------------
+bool CMaterialIndex::Save( void )
+{
+	CUtlBuffer buf;
+	buf.PutInt( MATERIALINDEX_MAGIC );
+	buf.PutInt( MATERIALINDEX_VERSION );
+	buf.PutUnsignedInt( m_nSignature );
+
+	buf.PutInt( m_Dirs.Count() );
+	for ( int nDir = m_Dirs.First(); nDir != m_Dirs.InvalidIndex(); nDir = m_Dirs.Next( nDir ) )
+	{
+		MaterialIndexDir_t *pDir = m_Dirs[nDir];
+		buf.PutString( pDir->m_Path );
+		buf.PutUnsignedInt( pDir->m_nStamp );
+
+		buf.PutInt( pDir->m_Files.Count() );
+		for ( int i = 0; i < pDir->m_Files.Count(); i++ )
+		{
+			const MaterialIndexFile_t &File = pDir->m_Files[i];
+			buf.PutString( File.m_FileName );
+			buf.PutInt( File.m_nRoot );
+			buf.PutInt( File.m_nFileTime );
+			buf.PutUnsignedInt( File.m_nFileSize );
+			buf.PutString( File.m_Keywords );
+		}
+
+		buf.PutInt( pDir->m_SubDirs.Count() );
+		for ( int i = 0; i < pDir->m_SubDirs.Count(); i++ )
+		{
+			buf.PutString( pDir->m_SubDirs[i] );
+		}
+	}
+
+	char szFileName[MAX_PATH];
+	GetIndexFileName( szFileName, sizeof( szFileName ) );
+	return g_pFullFileSystem->WriteFile( szFileName, NULL, buf );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Brings the index up to date and enumerates every material in it.
+// Input  : pEnum - Receives each material name.
+//			szRoot - Root directory, normally "materials".
+// Output : Returns false if the enumerator stopped the enumeration.
+//-----------------------------------------------------------------------------
+bool CMaterialIndex::EnumerateMaterials( IMaterialEnumerator *pEnum, const char *szRoot, int nContext, int nFlags )
+{
+	m_Lookup.RemoveAll();
+
+	unsigned int nSignature = ComputeSignature();
+	if ( !m_bLoaded || ( nSignature != m_nSignature ) )
+	{
+		m_Dirs.PurgeAndDeleteElements();
+		m_nSignature = nSignature;
+		m_bLoaded = true;
+
+		if ( !Load() )
+		{
+			m_bDirty = true;
+		}
+	}
+
+	//
+	// Recompute the stamps of every known directory in parallel.
+	//
+	CUtlVector<MaterialIndexDir_t *> Dirs;
+	CollectDirs( szRoot, nFlags, Dirs );
+	ParallelProcess( "CMaterialIndex::StampDirectory", Dirs.Base(), Dirs.Count(), &CMaterialIndex::StampDirectory );
+
+	//
+	// List the directories that changed. The file system find API is not
+	// thread safe, so this part runs on the main thread.
+	//
+	for ( int nDir = m_Dirs.First(); nDir != m_Dirs.InvalidIndex(); nDir = m_Dirs.Next( nDir ) )
+	{
+		m_Dirs[nDir]->m_bVisited = false;
+	}
+
+	CUtlVector<MaterialIndexRefresh_t> RefreshFiles;
+	UpdateDir( szRoot, nFlags, RefreshFiles );
+
+	//
+	// Check every file for changes, and rebuild the info of the ones that
+	// changed, in parallel.
+	//
+	ParallelProcess( "CMaterialIndex::RefreshFile", RefreshFiles.Base(), RefreshFiles.Count(), &CMaterialIndex::RefreshFile );
+
+	for ( int i = 0; i < RefreshFiles.Count(); i++ )
+	{
+		if ( RefreshFiles[i].m_pFile->m_bChanged )
+		{
+			m_bDirty = true;
+			break;
+		}
+	}
+
+	//
+	// Drop directories that no longer exist under this root.
+	//
+	int nDir = m_Dirs.First();
+	while ( nDir != m_Dirs.InvalidIndex() )
+	{
+		int nNext = m_Dirs.Next( nDir );
+		MaterialIndexDir_t *pDir = m_Dirs[nDir];
+		if ( !pDir->m_bVisited && !Q_strnicmp( pDir->m_Path, szRoot, Q_strlen( szRoot ) ) && !CMaterial::ShouldSkipMaterial( GetRelativePath( pDir->m_Path ), nFlags ) )
+		{
+			delete pDir;
+			m_Dirs.RemoveAt( nDir );
+			m_bDirty = true;
+		}
+		nDir = nNext;
+	}
+
+	RebuildLookup();
+
+	if ( m_bDirty && Save() )
+	{
+		m_bDirty = false;
+	}
+
+	return ReplayDir( szRoot, pEnum, nContext, nFlags );
+}
@@ -0,0 +1,136 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent on-disk index of the materials directory tree. Lets
+//			startup enumerate materials without walking every directory
+//			through the file system; only directories whose modification
+//			time changed since the last run are listed again, and only .vmt
+//			files whose size or time changed are read again. See
+//			MaterialIndexStat.h for how files are checked.
+//
+//=============================================================================//
+
+#ifndef MATERIALINDEX_H
+#define MATERIALINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "tier1/utlstring.h"
+#include "tier1/utldict.h"
+#include "MaterialIndexStat.h"
+
+class IMaterialEnumerator;
+class CUtlBuffer;
+
+//
+// Bump this whenever the layout of the index file changes.
+//
+#define MATERIALINDEX_VERSION		3
+
+//
+// One .vmt file, with the VMT parameters the editor needs before the
+// material itself is loaded.
+//
+struct MaterialIndexFile_t
+{
+	MaterialIndexFile_t() : m_nRoot( MATERIALINDEX_ROOT_UNKNOWN ), m_nFileTime( 0 ), m_nFileSize( 0 ), m_bChanged( false ) {}
+
+	CUtlString m_FileName;			// As returned by FindFirst, including the extension.
+	int m_nRoot;					// Loose search path the file was found in, or MATERIALINDEX_ROOT_PACKED.
+	long m_nFileTime;
+	unsigned int m_nFileSize;
+
+	CUtlString m_Keywords;			// %keywords
+
+	bool m_bChanged;				// Not saved; set when the file info was rebuilt.
+};
+
+//
+// One directory under materials/, in the order the file system listed it.
+//
+struct MaterialIndexDir_t
+{
+	MaterialIndexDir_t() : m_nStamp( 0 ), m_nNewStamp( 0 ), m_bStamped( false ), m_bVisited( false ) {}
+
+	CUtlString m_Path;				// Ex: "materials/brick"
+	unsigned int m_nStamp;			// Combined modification times of this directory in all loose search paths.
+
+	CUtlVector<MaterialIndexFile_t> m_Files;
+	CUtlVector<CUtlString> m_SubDirs;
+
+	// Not saved; used while validating.
+	unsigned int m_nNewStamp;
+	bool m_bStamped;
+	bool m_bVisited;
+};
+
+//
+// A file whose size and time are checked, and whose info is rebuilt if
+// either changed, on a worker thread.
+//
+struct MaterialIndexRefresh_t
+{
+	const MaterialIndexDir_t *m_pDir;
+	MaterialIndexFile_t *m_pFile;
+	bool m_bResolve;				// The directory was listed again, so look the file up in search order.
+};
+
+class CMaterialIndex
+{
+public:
+
+	CMaterialIndex( void );
+	~CMaterialIndex( void );
+
+	inline void SetEnabled( bool bEnabled ) { m_bEnabled = bEnabled; }
+	inline bool IsEnabled( void ) const { return m_bEnabled; }
+
+	// Brings the index up to date with the directory tree under szRoot and
+	// enumerates it in the same order as a full directory walk would.
+	bool EnumerateMaterials( IMaterialEnumerator *pEnum, const char *szRoot, int nContext, int nFlags );
+
+	// Returns the indexed info for a material name such as "brick/brickfloor01".
+	const MaterialIndexFile_t *FindMaterial( const char *pszMaterialName ) const;
+
+	void Purge( void );
+
+protected:
+
+	static const char *GetRelativePath( const char *pszPath );
+	static void BuildMaterialName( const char *pszDirectory, const char *pszFileName, char *pszName, int nNameSize );
+
+	static void StampDirectory( MaterialIndexDir_t *&pDir );
+	static bool StatLooseFile( const char *pszFullPath, long &nFileTime, unsigned int &nFileSize );
+	static void RefreshFile( MaterialIndexRefresh_t &Refresh );
+
+	void GetIndexFileName( char *pszFileName, int nSize ) const;
+	bool Load( void );
+	bool Save( void );
+
+	unsigned int ComputeSignature( void );
+	unsigned int ComputeDirectoryStamp( const char *pszPath ) const;
+
+	MaterialIndexDir_t *FindDir( const char *pszPath ) const;
+	MaterialIndexDir_t *AddDir( const char *pszPath );
+
+	void CollectDirs( const char *pszPath, int nFlags, CUtlVector<MaterialIndexDir_t *> &Dirs );
+	void UpdateDir( const char *pszPath, int nFlags, CUtlVector<MaterialIndexRefresh_t> &RefreshFiles );
+	void ScanDir( MaterialIndexDir_t *pDir );
+	bool ReplayDir( const char *pszPath, IMaterialEnumerator *pEnum, int nContext, int nFlags );
+	void RebuildLookup( void );
+
+	bool m_bEnabled;
+	bool m_bLoaded;
+	bool m_bDirty;
+	unsigned int m_nSignature;
+
+	CUtlVector<CUtlString> m_LooseRoots;			// Search path directories, in search order.
+	CUtlVector<const char *> m_LooseRootNames;		// The same, as strings for MaterialIndex_CheckFile.
+	CUtlDict<MaterialIndexDir_t *, int> m_Dirs;		// Keyed by directory path.
+	CUtlDict<MaterialIndexFile_t *, int> m_Lookup;	// Keyed by material name.
+};
+
+extern CMaterialIndex g_MaterialIndex;
+
+#endif // MATERIALINDEX_H
@@ -0,0 +1,115 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Checks a .vmt in the material index for changes. A file in a loose
+//			search path remembers which one it was found in, so an unchanged
+//			file costs one stat of that path instead of a size and a time
+//			lookup through every search path. The file is looked up in search
+//			order again only when its directory was listed again, which a new
+//			file shadowing it would cause. Files in pack files are not checked
+//			at all; the index signature covers the pack files.
+//
+//			Kept free of editor dependencies so it can be tested standalone:
+//
+//			g++ -O2 MaterialIndexStat_test.cpp -o MaterialIndexStat_test && ./MaterialIndexStat_test
+//
+//=============================================================================//
+
+#ifndef MATERIALINDEXSTAT_H
+#define MATERIALINDEXSTAT_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <string.h>
+
+//
+// Where a file was found.
+//
+#define MATERIALINDEX_ROOT_UNKNOWN		( -2 )		// Not looked up yet.
+#define MATERIALINDEX_ROOT_PACKED		( -1 )		// Not in any loose search path.
+
+//
+// Results of MaterialIndex_CheckFile.
+//
+enum MaterialIndexCheck_t
+{
+	MATERIALINDEX_FILE_UNCHANGED = 0,
+	MATERIALINDEX_FILE_CHANGED,
+	MATERIALINDEX_FILE_PACKED,		// Found in no loose search path; the caller asks the file system.
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Stats a file in one loose search path.
+//-----------------------------------------------------------------------------
+template <class STAT>
+inline bool MaterialIndex_StatFile( const char *pszRoot, const char *pszRelativePath, STAT &Stat, long &nFileTime, unsigned int &nFileSize )
+{
+	char szFullPath[1024];
+	size_t nRootLen = strlen( pszRoot );
+	size_t nPathLen = strlen( pszRelativePath );
+	if ( nRootLen + 1 + nPathLen >= sizeof( szFullPath ) )
+		return false;
+
+	memcpy( szFullPath, pszRoot, nRootLen );
+	szFullPath[nRootLen] = '/';
+	memcpy( szFullPath + nRootLen + 1, pszRelativePath, nPathLen + 1 );
+
+	return Stat( szFullPath, nFileTime, nFileSize );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Brings the size and time of an indexed file up to date.
+// Input  : ppRoots, nRoots - Loose search paths, in search order.
+//			pszRelativePath - Ex: "materials/brick/brickfloor01.vmt".
+//			bResolve - True if the file's directory was listed again, so it
+//				must be looked up in search order.
+//			nRoot - Where the file was found; updated.
+//			nFileTime, nFileSize - Indexed size and time; updated.
+//			Stat - bool Stat( const char *pszFullPath, long &nFileTime,
+//				unsigned int &nFileSize ), false if there is no such file.
+// Output : Whether the file changed, or MATERIALINDEX_FILE_PACKED if it must
+//			be checked through the file system.
+//-----------------------------------------------------------------------------
+template <class STAT>
+MaterialIndexCheck_t MaterialIndex_CheckFile( const char * const *ppRoots, int nRoots, const char *pszRelativePath, bool bResolve,
+	int &nRoot, long &nFileTime, unsigned int &nFileSize, STAT &Stat )
+{
+	long nNewTime = 0;
+	unsigned int nNewSize = 0;
+
+	if ( !bResolve )
+	{
+		if ( nRoot == MATERIALINDEX_ROOT_PACKED )
+			return MATERIALINDEX_FILE_UNCHANGED;
+
+		if ( ( nRoot < 0 ) || ( nRoot >= nRoots ) || !MaterialIndex_StatFile( ppRoots[nRoot], pszRelativePath, Stat, nNewTime, nNewSize ) )
+		{
+			bResolve = true;
+		}
+	}
+
+	if ( bResolve )
+	{
+		nRoot = MATERIALINDEX_ROOT_PACKED;
+		for ( int i = 0; i < nRoots; i++ )
+		{
+			if ( MaterialIndex_StatFile( ppRoots[i], pszRelativePath, Stat, nNewTime, nNewSize ) )
+			{
+				nRoot = i;
+				break;
+			}
+		}
+
+		if ( nRoot == MATERIALINDEX_ROOT_PACKED )
+			return MATERIALINDEX_FILE_PACKED;
+	}
+
+	if ( ( nNewTime == nFileTime ) && ( nNewSize == nFileSize ) )
+		return MATERIALINDEX_FILE_UNCHANGED;
+
+	nFileTime = nNewTime;
+	nFileSize = nNewSize;
+	return MATERIALINDEX_FILE_CHANGED;
+}
+
+#endif // MATERIALINDEXSTAT_H
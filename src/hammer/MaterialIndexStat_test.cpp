@@ -0,0 +1,443 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the material index file checks. A tree of
+//			.vmt files spread over several loose search paths and a pack file
+//			is changed at random, and after every change an index brought up
+//			to date from the previous run is compared with one scanned from
+//			nothing. Needs nothing but a C++ compiler:
+//
+//			g++ -O2 MaterialIndexStat_test.cpp -o MaterialIndexStat_test && ./MaterialIndexStat_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iterator>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include "MaterialIndexStat.h"
+
+#define TEST_ROOTS			3
+#define TEST_DIRS			12
+#define TEST_NAMES			40
+#define TEST_STEPS			3000
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int g_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	g_nSeed = g_nSeed * 1664525 + 1013904223;
+	return nMin + (int)( ( g_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+//
+// A file on disk or in the pack.
+//
+struct TestFile_t
+{
+	long m_nTime;
+	unsigned int m_nSize;
+	int m_nContents;				// Stands in for the keywords read from the file.
+};
+
+static const char *s_pszRoots[TEST_ROOTS] = { "/game/custom", "/game/mod", "/game/base" };
+
+//
+// The loose search paths, the pack file behind them, and the directory times.
+//
+class CTestFileSystem
+{
+public:
+
+	CTestFileSystem() : m_nClock( 1000 ), m_nStats( 0 ), m_nLookups( 0 ) {}
+
+	// Stat of one full path, as _stat64 would.
+	bool Stat( const char *pszFullPath, long &nTime, unsigned int &nSize )
+	{
+		m_nStats++;
+		std::map<std::string, TestFile_t>::const_iterator it = m_Loose.find( pszFullPath );
+		if ( it == m_Loose.end() )
+			return false;
+
+		nTime = it->second.m_nTime;
+		nSize = it->second.m_nSize;
+		return true;
+	}
+
+	bool operator()( const char *pszFullPath, long &nTime, unsigned int &nSize ) { return Stat( pszFullPath, nTime, nSize ); }
+
+	// Lookup through the search paths and then the pack, as the file system does.
+	const TestFile_t *Find( const std::string &relPath )
+	{
+		m_nLookups++;
+		for ( int i = 0; i < TEST_ROOTS; i++ )
+		{
+			std::map<std::string, TestFile_t>::const_iterator it = m_Loose.find( FullPath( i, relPath ) );
+			if ( it != m_Loose.end() )
+				return &it->second;
+		}
+
+		std::map<std::string, TestFile_t>::const_iterator it = m_Pack.find( relPath );
+		return ( it != m_Pack.end() ) ? &it->second : NULL;
+	}
+
+	// The .vmt names in a directory across every search path and the pack.
+	void List( const std::string &dir, std::vector<std::string> &Names ) const
+	{
+		std::set<std::string> names;
+		std::string prefix = dir + "/";
+		for ( std::map<std::string, TestFile_t>::const_iterator it = m_Pack.begin(); it != m_Pack.end(); ++it )
+		{
+			if ( !it->first.compare( 0, prefix.size(), prefix ) )
+				names.insert( it->first.substr( prefix.size() ) );
+		}
+		for ( int i = 0; i < TEST_ROOTS; i++ )
+		{
+			std::string rootPrefix = FullPath( i, prefix );
+			for ( std::map<std::string, TestFile_t>::const_iterator it = m_Loose.begin(); it != m_Loose.end(); ++it )
+			{
+				if ( !it->first.compare( 0, rootPrefix.size(), rootPrefix ) )
+					names.insert( it->first.substr( rootPrefix.size() ) );
+			}
+		}
+		Names.assign( names.begin(), names.end() );
+	}
+
+	// Directory times in every search path, combined as ComputeDirectoryStamp does.
+	std::string DirStamp( const std::string &dir )
+	{
+		char szStamp[256] = "";
+		for ( int i = 0; i < TEST_ROOTS; i++ )
+		{
+			char szTime[32];
+			std::map<std::string, long>::const_iterator it = m_DirTimes.find( FullPath( i, dir ) );
+			snprintf( szTime, sizeof( szTime ), "%ld,", ( it != m_DirTimes.end() ) ? it->second : -1 );
+			strcat( szStamp, szTime );
+		}
+		return szStamp;
+	}
+
+	static std::string FullPath( int nRoot, const std::string &relPath ) { return std::string( s_pszRoots[nRoot] ) + "/" + relPath; }
+
+	void Write( int nRoot, const std::string &relPath, bool bSameSize )
+	{
+		std::string fullPath = FullPath( nRoot, relPath );
+		bool bNew = !m_Loose.count( fullPath );
+
+		TestFile_t &File = m_Loose[fullPath];
+		File.m_nTime = ++m_nClock;
+		if ( bNew || !bSameSize )
+			File.m_nSize = RandomInt( 100, 400 );
+		File.m_nContents = RandomInt( 0, 1 << 30 );
+
+		// Only adding an entry changes the directory's time.
+		if ( bNew )
+			TouchDir( fullPath );
+	}
+
+	void Delete( int nRoot, const std::string &relPath )
+	{
+		std::string fullPath = FullPath( nRoot, relPath );
+		if ( m_Loose.erase( fullPath ) )
+			TouchDir( fullPath );
+	}
+
+	void WritePack( const std::string &relPath )
+	{
+		TestFile_t &File = m_Pack[relPath];
+		File.m_nTime = ++m_nClock;
+		File.m_nSize = RandomInt( 100, 400 );
+		File.m_nContents = RandomInt( 0, 1 << 30 );
+	}
+
+	std::map<std::string, TestFile_t> m_Loose;
+	std::map<std::string, TestFile_t> m_Pack;
+	std::map<std::string, long> m_DirTimes;
+	long m_nClock;
+	int m_nStats;
+	int m_nLookups;
+
+private:
+
+	void TouchDir( const std::string &fullPath )
+	{
+		m_DirTimes[fullPath.substr( 0, fullPath.rfind( '/' ) )] = ++m_nClock;
+	}
+};
+
+//
+// An indexed file, as MaterialIndexFile_t stores it.
+//
+struct TestIndexFile_t
+{
+	TestIndexFile_t() : m_nRoot( MATERIALINDEX_ROOT_UNKNOWN ), m_nTime( 0 ), m_nSize( 0 ), m_nContents( -1 ) {}
+
+	std::string m_Name;
+	int m_nRoot;
+	long m_nTime;
+	unsigned int m_nSize;
+	int m_nContents;
+};
+
+struct TestIndexDir_t
+{
+	std::string m_Stamp;
+	std::vector<TestIndexFile_t> m_Files;
+};
+
+//
+// The index, updated the way CMaterialIndex::EnumerateMaterials does.
+//
+class CTestIndex
+{
+public:
+
+	CTestIndex() : m_nReads( 0 ) {}
+
+	void Update( CTestFileSystem &FileSystem, const std::vector<std::string> &Dirs )
+	{
+		for ( size_t nDir = 0; nDir < Dirs.size(); nDir++ )
+		{
+			const std::string &dir = Dirs[nDir];
+			std::string stamp = FileSystem.DirStamp( dir );
+
+			bool bRescan = !m_Dirs.count( dir ) || ( m_Dirs[dir].m_Stamp != stamp );
+			TestIndexDir_t &Dir = m_Dirs[dir];
+
+			if ( bRescan )
+			{
+				// ScanDir: list again, carrying over what was known.
+				std::vector<std::string> names;
+				FileSystem.List( dir, names );
+
+				std::vector<TestIndexFile_t> files( names.size() );
+				for ( size_t i = 0; i < names.size(); i++ )
+				{
+					files[i].m_Name = names[i];
+					for ( size_t j = 0; j < Dir.m_Files.size(); j++ )
+					{
+						if ( Dir.m_Files[j].m_Name == names[i] )
+						{
+							files[i] = Dir.m_Files[j];
+							break;
+						}
+					}
+				}
+				Dir.m_Files.swap( files );
+				Dir.m_Stamp = stamp;
+			}
+
+			// RefreshFile.
+			for ( size_t i = 0; i < Dir.m_Files.size(); i++ )
+			{
+				TestIndexFile_t &File = Dir.m_Files[i];
+				std::string relPath = dir + "/" + File.m_Name;
+
+				MaterialIndexCheck_t eCheck = MaterialIndex_CheckFile( s_pszRoots, TEST_ROOTS, relPath.c_str(), bRescan,
+					File.m_nRoot, File.m_nTime, File.m_nSize, FileSystem );
+
+				if ( eCheck == MATERIALINDEX_FILE_PACKED )
+				{
+					const TestFile_t *pFound = FileSystem.Find( relPath );
+					long nTime = pFound ? pFound->m_nTime : 0;
+					unsigned int nSize = pFound ? pFound->m_nSize : 0;
+					eCheck = ( ( nTime != File.m_nTime ) || ( nSize != File.m_nSize ) ) ? MATERIALINDEX_FILE_CHANGED : MATERIALINDEX_FILE_UNCHANGED;
+					File.m_nTime = nTime;
+					File.m_nSize = nSize;
+				}
+
+				if ( eCheck == MATERIALINDEX_FILE_CHANGED )
+				{
+					const TestFile_t *pFound = FileSystem.Find( relPath );
+					File.m_nContents = pFound ? pFound->m_nContents : -1;
+					m_nReads++;
+				}
+			}
+		}
+	}
+
+	bool operator==( const CTestIndex &Other ) const
+	{
+		if ( m_Dirs.size() != Other.m_Dirs.size() )
+			return false;
+
+		for ( std::map<std::string, TestIndexDir_t>::const_iterator it = m_Dirs.begin(); it != m_Dirs.end(); ++it )
+		{
+			std::map<std::string, TestIndexDir_t>::const_iterator other = Other.m_Dirs.find( it->first );
+			if ( other == Other.m_Dirs.end() )
+				return false;
+
+			const std::vector<TestIndexFile_t> &a = it->second.m_Files;
+			const std::vector<TestIndexFile_t> &b = other->second.m_Files;
+			if ( a.size() != b.size() )
+				return false;
+
+			for ( size_t i = 0; i < a.size(); i++ )
+			{
+				if ( ( a[i].m_Name != b[i].m_Name ) || ( a[i].m_nRoot != b[i].m_nRoot ) ||
+					 ( a[i].m_nTime != b[i].m_nTime ) || ( a[i].m_nSize != b[i].m_nSize ) ||
+					 ( a[i].m_nContents != b[i].m_nContents ) )
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::map<std::string, TestIndexDir_t> m_Dirs;
+	int m_nReads;
+};
+
+static std::string RandomDir( void )
+{
+	char szDir[64];
+	snprintf( szDir, sizeof( szDir ), "materials/dir%02d", RandomInt( 0, TEST_DIRS - 1 ) );
+	return szDir;
+}
+
+static std::string RandomFile( void )
+{
+	char szName[64];
+	snprintf( szName, sizeof( szName ), "/mat%02d.vmt", RandomInt( 0, TEST_NAMES - 1 ) );
+	return RandomDir() + szName;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Changes the tree at random and compares a warm index with a cold one.
+//-----------------------------------------------------------------------------
+static void TestWarmMatchesCold( void )
+{
+	CTestFileSystem FileSystem;
+
+	std::vector<std::string> dirs;
+	for ( int i = 0; i < TEST_DIRS; i++ )
+	{
+		char szDir[64];
+		snprintf( szDir, sizeof( szDir ), "materials/dir%02d", i );
+		dirs.push_back( szDir );
+	}
+
+	for ( int i = 0; i < 300; i++ )
+	{
+		if ( RandomInt( 0, 2 ) )
+			FileSystem.WritePack( RandomFile() );
+		else
+			FileSystem.Write( RandomInt( 0, TEST_ROOTS - 1 ), RandomFile(), false );
+	}
+
+	CTestIndex warm;
+	warm.Update( FileSystem, dirs );
+
+	int nStaleReads = 0;
+	for ( int nStep = 0; nStep < TEST_STEPS; nStep++ )
+	{
+		int nChanges = RandomInt( 0, 3 );
+		for ( int nChange = 0; nChange < nChanges; nChange++ )
+		{
+			int nOp = RandomInt( 0, 9 );
+			int nRoot = RandomInt( 0, TEST_ROOTS - 1 );
+			std::string file = RandomFile();
+
+			if ( nOp < 4 )
+			{
+				// Edit a file in place, which leaves its directory's time alone.
+				std::map<std::string, TestFile_t>::iterator it = FileSystem.m_Loose.begin();
+				std::advance( it, RandomInt( 0, (int)FileSystem.m_Loose.size() - 1 ) );
+				std::string fullPath = it->first;
+				for ( int i = 0; i < TEST_ROOTS; i++ )
+				{
+					std::string prefix = std::string( s_pszRoots[i] ) + "/";
+					if ( !fullPath.compare( 0, prefix.size(), prefix ) )
+					{
+						FileSystem.Write( i, fullPath.substr( prefix.size() ), RandomInt( 0, 1 ) != 0 );
+						break;
+					}
+				}
+			}
+			else if ( nOp < 7 )
+			{
+				// Add a file, possibly shadowing one in a later search path or the pack.
+				FileSystem.Write( nRoot, file, false );
+			}
+			else
+			{
+				FileSystem.Delete( nRoot, file );
+			}
+		}
+
+		int nReads = warm.m_nReads;
+		warm.Update( FileSystem, dirs );
+
+		CTestIndex cold;
+		cold.Update( FileSystem, dirs );
+
+		CHECK( warm == cold );
+		if ( !nChanges && ( warm.m_nReads != nReads ) )
+			nStaleReads++;
+	}
+
+	CHECK( nStaleReads == 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: An unchanged tree costs one stat per loose file and no file
+//			system lookups.
+//-----------------------------------------------------------------------------
+static void TestWarmCost( void )
+{
+	CTestFileSystem FileSystem;
+	std::vector<std::string> dirs;
+	dirs.push_back( "materials/dir00" );
+	dirs.push_back( "materials/dir01" );
+
+	int nLoose = 0;
+	for ( int i = 0; i < TEST_NAMES; i++ )
+	{
+		char szName[64];
+		snprintf( szName, sizeof( szName ), "%s/mat%02d.vmt", dirs[i & 1].c_str(), i );
+		if ( i % 3 )
+		{
+			FileSystem.Write( i % TEST_ROOTS, szName, false );
+			nLoose++;
+		}
+		else
+		{
+			FileSystem.WritePack( szName );
+		}
+	}
+
+	CTestIndex index;
+	index.Update( FileSystem, dirs );
+	CHECK( index.m_nReads == TEST_NAMES );
+
+	FileSystem.m_nStats = 0;
+	FileSystem.m_nLookups = 0;
+	index.m_nReads = 0;
+	index.Update( FileSystem, dirs );
+
+	CHECK( FileSystem.m_nStats == nLoose );
+	CHECK( FileSystem.m_nLookups == 0 );
+	CHECK( index.m_nReads == 0 );
+}
+
+int main( void )
+{
+	TestWarmCost();
+	TestWarmMatchesCold();
+
+	if ( g_nFailures )
+	{
+		printf( "%d failures\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All material index tests passed.\n" );
+	return 0;
+}
@@ -0,0 +1,92 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Sizes of texture browser previews. A material larger than the
+//			preview size is shown from the smallest VTF mip that covers it,
+//			or from its full size image halved while it still covers it;
+//			both come out the same size. Kept free of editor dependencies
+//			so it can be tested standalone:
+//
+//			g++ -O2 MaterialPreviewSize_test.cpp -o MaterialPreviewSize_test && ./MaterialPreviewSize_test
+//
+//=============================================================================//
+
+#ifndef MATERIALPREVIEWSIZE_H
+#define MATERIALPREVIEWSIZE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the smallest size a preview of a nWidth x nHeight material
+//			must have: the shape of the texture, with the longer side at the
+//			preview size.
+//-----------------------------------------------------------------------------
+inline void MaterialPreview_GetMinSize( int nWidth, int nHeight, int nPreviewSize, int &nMinWidth, int &nMinHeight )
+{
+	if ( nWidth >= nHeight )
+	{
+		nMinWidth = nPreviewSize;
+		nMinHeight = nHeight * nPreviewSize / nWidth;
+	}
+	else
+	{
+		nMinWidth = nWidth * nPreviewSize / nHeight;
+		nMinHeight = nPreviewSize;
+	}
+
+	if ( nMinWidth < 1 )
+	{
+		nMinWidth = 1;
+	}
+	if ( nMinHeight < 1 )
+	{
+		nMinHeight = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the size of mip level nLevel of a nWidth x nHeight image.
+//-----------------------------------------------------------------------------
+inline void MaterialPreview_GetMipSize( int nWidth, int nHeight, int nLevel, int &nMipWidth, int &nMipHeight )
+{
+	nMipWidth = nWidth >> nLevel;
+	nMipHeight = nHeight >> nLevel;
+
+	if ( nMipWidth < 1 )
+	{
+		nMipWidth = 1;
+	}
+	if ( nMipHeight < 1 )
+	{
+		nMipHeight = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the smallest of nMipCount mip levels that is at least
+//			nMinWidth x nMinHeight, or level 0 if none is.
+//-----------------------------------------------------------------------------
+inline int MaterialPreview_SelectMip( int nWidth, int nHeight, int nMipCount, int nMinWidth, int nMinHeight )
+{
+	for ( int nLevel = nMipCount - 1; nLevel > 0; nLevel-- )
+	{
+		int nMipWidth, nMipHeight;
+		MaterialPreview_GetMipSize( nWidth, nHeight, nLevel, nMipWidth, nMipHeight );
+		if ( ( nMipWidth >= nMinWidth ) && ( nMipHeight >= nMinHeight ) )
+			return nLevel;
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if a full size preview should be halved again to get
+//			down to the preview size.
+//-----------------------------------------------------------------------------
+inline bool MaterialPreview_ShouldHalve( int nWidth, int nHeight, int nPreviewSize )
+{
+	int nLonger = ( nWidth > nHeight ) ? nWidth : nHeight;
+	return ( nLonger / 2 ) >= nPreviewSize;
+}
+
+#endif // MATERIALPREVIEWSIZE_H
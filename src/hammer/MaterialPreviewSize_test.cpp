@@ -0,0 +1,244 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test that a texture browser preview read from the
+//			smallest fitting VTF mip matches the one made from the full size
+//			image, which is how every preview was made before:
+//
+//			g++ -O2 MaterialPreviewSize_test.cpp -o MaterialPreviewSize_test && ./MaterialPreviewSize_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "MaterialPreviewSize.h"
+#include "ImageConvertKernels.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static int FullMipCount( int nWidth, int nHeight )
+{
+	int nCount = 1;
+	while ( ( nWidth >> nCount ) > 0 || ( nHeight >> nCount ) > 0 )
+	{
+		nCount++;
+	}
+	return nCount;
+}
+
+struct PreviewImage_t
+{
+	int nWidth;
+	int nHeight;
+	std::vector<unsigned char> Data;
+};
+
+static void Halve( PreviewImage_t &Image, int nBytesPerPixel )
+{
+	PreviewImage_t Half;
+	Half.nWidth = ( Image.nWidth > 1 ) ? Image.nWidth / 2 : 1;
+	Half.nHeight = ( Image.nHeight > 1 ) ? Image.nHeight / 2 : 1;
+	Half.Data.resize( Half.nWidth * Half.nHeight * nBytesPerPixel );
+	ImageConvert_HalveBoxAtLevel( &Image.Data[0], Image.nWidth, Image.nHeight, nBytesPerPixel, &Half.Data[0], IMAGECONVERT_SCALAR );
+	Image = Half;
+}
+
+static void Premultiply( PreviewImage_t &Image )
+{
+	ImageConvert_PremultiplyAlphaAtLevel( &Image.Data[0], Image.nWidth * Image.nHeight, IMAGECONVERT_SCALAR );
+}
+
+//-----------------------------------------------------------------------------
+// CMaterial::LoadMaterialImage from the full size image: optionally
+// premultiply, then ShrinkToPreviewSize.
+//-----------------------------------------------------------------------------
+static PreviewImage_t FullSizePreview( const PreviewImage_t &Full, int nBytesPerPixel, int nPreviewSize, bool bPremultiplyFirst )
+{
+	PreviewImage_t Image = Full;
+	if ( bPremultiplyFirst )
+	{
+		Premultiply( Image );
+	}
+
+	while ( MaterialPreview_ShouldHalve( Image.nWidth, Image.nHeight, nPreviewSize ) )
+	{
+		Halve( Image, nBytesPerPixel );
+	}
+	return Image;
+}
+
+//-----------------------------------------------------------------------------
+// CMaterial::LoadPreviewImage: the smallest fitting level of a mip chain
+// box filtered from the full size image, as vtex builds it.
+//-----------------------------------------------------------------------------
+static PreviewImage_t MipPreview( const PreviewImage_t &Full, int nBytesPerPixel, int nPreviewSize )
+{
+	int nMinWidth, nMinHeight;
+	MaterialPreview_GetMinSize( Full.nWidth, Full.nHeight, nPreviewSize, nMinWidth, nMinHeight );
+	int nLevel = MaterialPreview_SelectMip( Full.nWidth, Full.nHeight, FullMipCount( Full.nWidth, Full.nHeight ), nMinWidth, nMinHeight );
+
+	PreviewImage_t Image = Full;
+	for ( int i = 0; i < nLevel; i++ )
+	{
+		Halve( Image, nBytesPerPixel );
+	}
+	return Image;
+}
+
+static int RandomSize( void )
+{
+	// mostly powers of two, as textures are
+	return RandomInt( 0, 3 ) ? ( 1 << RandomInt( 0, 12 ) ) : RandomInt( 1, 4096 );
+}
+
+//-----------------------------------------------------------------------------
+// Both paths must come out the same size for every material that is bigger
+// than the preview size.
+//-----------------------------------------------------------------------------
+static void TestSizes( void )
+{
+	static const int s_PreviewSizes[] = { 32, 64, 128, 256, 512 };
+	for ( int nTest = 0; nTest < 200000; nTest++ )
+	{
+		int nWidth = RandomSize();
+		int nHeight = RandomSize();
+		int nPreviewSize = s_PreviewSizes[RandomInt( 0, 4 )];
+		if ( nWidth <= nPreviewSize && nHeight <= nPreviewSize )
+			continue;
+
+		int nMinWidth, nMinHeight;
+		MaterialPreview_GetMinSize( nWidth, nHeight, nPreviewSize, nMinWidth, nMinHeight );
+		int nLevel = MaterialPreview_SelectMip( nWidth, nHeight, FullMipCount( nWidth, nHeight ), nMinWidth, nMinHeight );
+
+		int nMipWidth, nMipHeight;
+		MaterialPreview_GetMipSize( nWidth, nHeight, nLevel, nMipWidth, nMipHeight );
+
+		int nShrunkWidth = nWidth, nShrunkHeight = nHeight;
+		while ( MaterialPreview_ShouldHalve( nShrunkWidth, nShrunkHeight, nPreviewSize ) )
+		{
+			nShrunkWidth = ( nShrunkWidth > 1 ) ? nShrunkWidth / 2 : 1;
+			nShrunkHeight = ( nShrunkHeight > 1 ) ? nShrunkHeight / 2 : 1;
+		}
+
+		if ( nMipWidth != nShrunkWidth || nMipHeight != nShrunkHeight )
+		{
+			printf( "FAIL: %dx%d at %d: mip %dx%d, shrunk %dx%d\n", nWidth, nHeight, nPreviewSize, nMipWidth, nMipHeight, nShrunkWidth, nShrunkHeight );
+			g_nFailures++;
+		}
+
+		// the preview covers the preview size along the longer side
+		int nLonger = ( nMipWidth > nMipHeight ) ? nMipWidth : nMipHeight;
+		CHECK( nLonger >= nPreviewSize && nLonger < nPreviewSize * 2 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Pixels. Opaque previews are the same byte for byte. Translucent mips hold
+// straight alpha, so they match the full size path as it was before
+// premultiplying moved ahead of the filter; premultiplying first changes only
+// colors that the filter used to bleed in from transparent texels.
+//-----------------------------------------------------------------------------
+static void TestPixels( void )
+{
+	for ( int nTest = 0; nTest < 300; nTest++ )
+	{
+		PreviewImage_t Full;
+		Full.nWidth = 1 << RandomInt( 4, 9 );
+		Full.nHeight = 1 << RandomInt( 4, 9 );
+		int nPreviewSize = 1 << RandomInt( 2, 6 );
+		bool bTranslucent = ( RandomInt( 0, 1 ) != 0 );
+		int nBytesPerPixel = bTranslucent ? 4 : 3;
+
+		Full.Data.resize( Full.nWidth * Full.nHeight * nBytesPerPixel );
+		for ( size_t i = 0; i < Full.Data.size(); i++ )
+		{
+			Full.Data[i] = (unsigned char)RandomInt( 0, 255 );
+		}
+
+		if ( bTranslucent )
+		{
+			// plenty of transparent texels, so there is color to bleed
+			for ( int i = 0; i < Full.nWidth * Full.nHeight; i++ )
+			{
+				if ( RandomInt( 0, 3 ) == 0 )
+				{
+					Full.Data[i * 4 + 3] = 0;
+				}
+			}
+		}
+
+		PreviewImage_t Mip = MipPreview( Full, nBytesPerPixel, nPreviewSize );
+		if ( !bTranslucent )
+		{
+			PreviewImage_t Shrunk = FullSizePreview( Full, nBytesPerPixel, nPreviewSize, false );
+			CHECK( Mip.nWidth == Shrunk.nWidth && Mip.nHeight == Shrunk.nHeight );
+			CHECK( Mip.Data == Shrunk.Data );
+			continue;
+		}
+
+		Premultiply( Mip );
+		PreviewImage_t Before = FullSizePreview( Full, 4, nPreviewSize, false );
+		Premultiply( Before );
+		CHECK( Mip.nWidth == Before.nWidth && Mip.nHeight == Before.nHeight );
+		CHECK( Mip.Data == Before.Data );
+
+		// premultiplied first, each preview texel is the alpha weighted
+		// average of the texels it covers, give or take rounding
+		PreviewImage_t After = FullSizePreview( Full, 4, nPreviewSize, true );
+		CHECK( After.nWidth == Mip.nWidth && After.nHeight == Mip.nHeight );
+
+		int nBlockWidth = Full.nWidth / After.nWidth;
+		int nBlockHeight = Full.nHeight / After.nHeight;
+		int nLevels = FullMipCount( nBlockWidth, nBlockHeight ) - 1;
+		for ( int y = 0; y < After.nHeight; y++ )
+		{
+			for ( int x = 0; x < After.nWidth; x++ )
+			{
+				const unsigned char *pTexel = &After.Data[( y * After.nWidth + x ) * 4];
+				for ( int c = 0; c < 3; c++ )
+				{
+					double flSum = 0;
+					for ( int by = 0; by < nBlockHeight; by++ )
+					{
+						for ( int bx = 0; bx < nBlockWidth; bx++ )
+						{
+							const unsigned char *pSource = &Full.Data[( ( y * nBlockHeight + by ) * Full.nWidth + x * nBlockWidth + bx ) * 4];
+							flSum += pSource[c] * pSource[3] / 255.0;
+						}
+					}
+
+					double flError = pTexel[c] - flSum / ( nBlockWidth * nBlockHeight );
+					CHECK( flError > -1 - nLevels && flError < 1 + nLevels );
+				}
+
+				// alpha is filtered the same either way
+				CHECK( pTexel[3] == Mip.Data[( y * After.nWidth + x ) * 4 + 3] );
+			}
+		}
+	}
+}
+
+int main( void )
+{
+	TestSizes();
+	TestPixels();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All material preview tests passed\n" );
+	return 0;
+}
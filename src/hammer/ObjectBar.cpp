@@ -214,21 +214,13 @@ BOOL CObjectBar::GetPrefabBounds(BoundBox *pBox)
 			return(FALSE);
 		}
 
-		if (!pPrefab->IsLoaded())
-		{
-			pPrefab->Load();
-		}
-
-		if (!pPrefab->IsLoaded())
+		Vector mins;
+		Vector maxs;
+		if (!pPrefab->GetBounds(mins, maxs))
 		{
 			return(FALSE);
 		}
 
-		CMapWorld *pWorld = pPrefab->GetWorld();
-
-		Vector mins;
-		Vector maxs;
-		pWorld->GetRender2DBox(mins, maxs);
 		pBox->SetBounds(mins, maxs);
 
 		return(TRUE);
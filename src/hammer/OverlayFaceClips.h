@@ -0,0 +1,205 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The clipped face cache behind CMapOverlay::DoClip: the overlay
+//			clipped to each face of its sidelist, kept with the face's
+//			geometry revision so that only faces that changed are clipped
+//			again.
+//
+//			This file only needs the C runtime, so the cache can be checked
+//			against clipping every face again without the editor:
+//
+//			g++ -O2 OverlayFaceClips_test.cpp -o OverlayFaceClips_test && ./OverlayFaceClips_test
+//
+//			The cache is a template over the face and render face list
+//			types, which must provide:
+//
+//			FACE		- unsigned int GetRevision() and bool HasDisp()
+//			LIST		- a CUtlVector of owned pointers: Purge(),
+//						  PurgeAndDeleteElements() and AddVectorToTail( LIST & )
+//
+//=============================================================================//
+
+#ifndef OVERLAYFACECLIPS_H
+#define OVERLAYFACECLIPS_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stddef.h>
+
+template <class FACE, class LIST>
+class COverlayFaceClips
+{
+public:
+
+	// The render faces clipped to one face of the sidelist.
+	struct FaceClip_t
+	{
+		FACE			*m_pFace;
+		unsigned int	m_nRevision;		// Face geometry revision the clip was made at.
+		bool			m_bDisp;			// Face had a displacement when clipped.
+		bool			m_bStale;			// Set by Match when the clip must be made again.
+		LIST			m_aFaces;			// Owned render faces, in the order they were clipped.
+	};
+
+	COverlayFaceClips( void ) : m_ppClips( NULL ), m_nCount( 0 ), m_nCapacity( 0 ), m_ppMatched( NULL ), m_nMatchedCapacity( 0 ) {}
+
+	~COverlayFaceClips( void )
+	{
+		Purge();
+		delete [] m_ppClips;
+		delete [] m_ppMatched;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Frees every clip and its render faces.
+	//-----------------------------------------------------------------------------
+	void Purge( void )
+	{
+		for ( int i = 0; i < m_nCount; i++ )
+		{
+			Free( m_ppClips[i] );
+		}
+
+		m_nCount = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Matches every face of the sidelist with its clip, in sidelist
+	//			order. A clip is marked stale, and its render faces freed, if
+	//			its face is new to the sidelist, has changed since it was
+	//			clipped, or has or had a displacement: sculpting, adding or
+	//			removing one leaves the face's revision alone. Clips of faces
+	//			that have left the sidelist are freed.
+	// Input  : Faces - The sidelist; Count() and Element( int ), NULL faces
+	//				are skipped.
+	//-----------------------------------------------------------------------------
+	template <class FACELIST>
+	void Match( FACELIST &Faces )
+	{
+		int nFaceCount = Faces.Count();
+		Reserve( m_ppMatched, m_nMatchedCapacity, 0, nFaceCount );
+
+		int nMatched = 0;
+		for ( int iFace = 0; iFace < nFaceCount; iFace++ )
+		{
+			FACE *pFace = Faces.Element( iFace );
+			if ( !pFace )
+				continue;
+
+			FaceClip_t *pFaceClip = Find( pFace, iFace );
+			if ( !pFaceClip )
+			{
+				pFaceClip = new FaceClip_t;
+				pFaceClip->m_pFace = pFace;
+			}
+			else if ( !pFace->HasDisp() && !pFaceClip->m_bDisp && ( pFaceClip->m_nRevision == pFace->GetRevision() ) )
+			{
+				pFaceClip->m_bStale = false;
+				m_ppMatched[nMatched++] = pFaceClip;
+				continue;
+			}
+
+			pFaceClip->m_aFaces.PurgeAndDeleteElements();
+			pFaceClip->m_nRevision = pFace->GetRevision();
+			pFaceClip->m_bDisp = pFace->HasDisp();
+			pFaceClip->m_bStale = true;
+			m_ppMatched[nMatched++] = pFaceClip;
+		}
+
+		// Whatever was not claimed belongs to faces that have left the sidelist.
+		Purge();
+
+		FaceClip_t **ppSwap = m_ppClips;
+		m_ppClips = m_ppMatched;
+		m_ppMatched = ppSwap;
+
+		int nSwap = m_nCapacity;
+		m_nCapacity = m_nMatchedCapacity;
+		m_nMatchedCapacity = nSwap;
+
+		m_nCount = nMatched;
+	}
+
+	int Count( void ) const { return m_nCount; }
+	FaceClip_t *Element( int i ) { return m_ppClips[i]; }
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Lists the render faces of every clip, in sidelist order. The
+	//			clips keep ownership of them.
+	//-----------------------------------------------------------------------------
+	void GetRenderFaces( LIST &aRenderFaces )
+	{
+		aRenderFaces.Purge();
+		for ( int i = 0; i < m_nCount; i++ )
+		{
+			aRenderFaces.AddVectorToTail( m_ppClips[i]->m_aFaces );
+		}
+	}
+
+private:
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Finds the clip for a face and takes it out of the list.
+	// Input  : iHint - Where the face's clip most likely is (its sidelist index).
+	//-----------------------------------------------------------------------------
+	FaceClip_t *Find( FACE *pFace, int iHint )
+	{
+		for ( int i = 0; i < m_nCount; i++ )
+		{
+			int iTest = ( iHint + i ) % m_nCount;
+			FaceClip_t *pFaceClip = m_ppClips[iTest];
+			if ( pFaceClip && ( pFaceClip->m_pFace == pFace ) )
+			{
+				m_ppClips[iTest] = NULL;
+				return pFaceClip;
+			}
+		}
+
+		return NULL;
+	}
+
+	static void Free( FaceClip_t *pFaceClip )
+	{
+		if ( pFaceClip )
+		{
+			pFaceClip->m_aFaces.PurgeAndDeleteElements();
+			delete pFaceClip;
+		}
+	}
+
+	template <class T>
+	static void Reserve( T *&pData, int &nCapacity, int nCount, int nNeeded )
+	{
+		if ( nNeeded <= nCapacity )
+			return;
+
+		int nNewCapacity = nCapacity ? nCapacity * 2 : 64;
+		while ( nNewCapacity < nNeeded )
+		{
+			nNewCapacity *= 2;
+		}
+
+		T *pNewData = new T[ nNewCapacity ];
+		for ( int i = 0; i < nCount; i++ )
+		{
+			pNewData[i] = pData[i];
+		}
+
+		delete [] pData;
+		pData = pNewData;
+		nCapacity = nNewCapacity;
+	}
+
+	COverlayFaceClips( const COverlayFaceClips & );
+	COverlayFaceClips &operator=( const COverlayFaceClips & );
+
+	FaceClip_t **m_ppClips;			// One per sidelist face, in sidelist order.
+	int m_nCount;
+	int m_nCapacity;
+
+	FaceClip_t **m_ppMatched;		// Scratch for Match, swapped with m_ppClips.
+	int m_nMatchedCapacity;
+};
+
+#endif // OVERLAYFACECLIPS_H
@@ -0,0 +1,622 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test for OverlayFaceClips.h. Runs CMapOverlay::DoClip
+//			two ways over random edits to an overlay and its sidelist:
+//
+//			- as it was, clipping the overlay to every face again;
+//			- as it is now, clipping only the faces whose cached clips
+//			  COverlayFaceClips marks stale.
+//
+//			The render faces must match point for point, in the same order.
+//			The faces are convex polygons under the overlay plane, and the
+//			clip cuts the overlay quad to each one as ClipOverlayToFace does.
+//			Displacement faces are cut again into strips, which take their
+//			height from the displacement; sculpting, adding or removing a
+//			displacement leaves the face's revision alone, as in the editor.
+//			Then both are timed on an overlay over 500 faces:
+//
+//			g++ -O2 OverlayFaceClips_test.cpp -o OverlayFaceClips_test && ./OverlayFaceClips_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "OverlayFaceClips.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( RandomInt( 0, 1 << 20 ) / (float)( 1 << 20 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+#define OVERLAY_WORLDSPACE_EPSILON		0.03125f
+#define DISP_STRIP_WIDTH				32.0f
+
+struct Vector2D_t
+{
+	float x, y;
+};
+
+struct Vector_t
+{
+	float x, y, z;
+};
+
+static unsigned int s_nNextRevision = 0;
+
+//
+// Stands in for CMapFace: a convex polygon, counterclockwise, at a height
+// under the overlay plane.
+//
+struct Face_t
+{
+	std::vector<Vector2D_t> m_Points;
+	float m_flHeight;
+	unsigned int m_nRevision;
+	bool m_bDisp;
+	int m_nSculpt;			// The displacement's shape; not part of the revision.
+
+	unsigned int GetRevision( void ) { return m_nRevision; }
+	bool HasDisp( void ) { return m_bDisp; }
+	void BumpRevision( void ) { m_nRevision = ++s_nNextRevision; }
+};
+
+//
+// Stands in for ClipFace_t.
+//
+static int s_nRenderFaces = 0;
+
+struct RenderFace_t
+{
+	Face_t *m_pBuildFace;
+	std::vector<Vector_t> m_Points;
+	std::vector<Vector2D_t> m_TexCoords;
+
+	RenderFace_t( void ) : m_pBuildFace( NULL ) { s_nRenderFaces++; }
+	~RenderFace_t( void ) { s_nRenderFaces--; }
+};
+
+//
+// The parts of CUtlVector<ClipFace_t*> the cache uses.
+//
+struct List_t
+{
+	std::vector<RenderFace_t *> m_Data;
+
+	int Count( void ) const { return (int)m_Data.size(); }
+	RenderFace_t *operator[]( int i ) const { return m_Data[i]; }
+	void AddToTail( RenderFace_t *pFace ) { m_Data.push_back( pFace ); }
+	void AddVectorToTail( const List_t &List ) { m_Data.insert( m_Data.end(), List.m_Data.begin(), List.m_Data.end() ); }
+	void Purge( void ) { m_Data.clear(); }
+
+	void PurgeAndDeleteElements( void )
+	{
+		for ( size_t i = 0; i < m_Data.size(); i++ )
+		{
+			delete m_Data[i];
+		}
+		m_Data.clear();
+	}
+};
+
+//
+// Stands in for CMapFaceList; may hold NULL faces.
+//
+struct SideList_t
+{
+	std::vector<Face_t *> m_Faces;
+
+	int Count( void ) { return (int)m_Faces.size(); }
+	Face_t *Element( int i ) { return m_Faces[i]; }
+};
+
+//
+// The overlay quad in the overlay plane, with its texture coordinates. This
+// is all a clip depends on besides the face, so it is also the clip key.
+//
+struct Overlay_t
+{
+	Vector2D_t m_Points[4];
+	Vector2D_t m_TexCoords[4];
+};
+
+typedef COverlayFaceClips<Face_t, List_t> FaceClips_t;
+
+//-----------------------------------------------------------------------------
+// Purpose: Keeps the part of a polygon behind the line (flA, flB) . p = flDist,
+//			interpolating texture coordinates at the cuts.
+//-----------------------------------------------------------------------------
+static void ClipPolygon( std::vector<Vector2D_t> &Points, std::vector<Vector2D_t> &TexCoords, float flA, float flB, float flDist )
+{
+	std::vector<Vector2D_t> NewPoints;
+	std::vector<Vector2D_t> NewTexCoords;
+
+	size_t nPoints = Points.size();
+	for ( size_t i = 0; i < nPoints; i++ )
+	{
+		size_t j = ( i + 1 ) % nPoints;
+		float flDist0 = flA * Points[i].x + flB * Points[i].y - flDist;
+		float flDist1 = flA * Points[j].x + flB * Points[j].y - flDist;
+
+		if ( flDist0 <= OVERLAY_WORLDSPACE_EPSILON )
+		{
+			NewPoints.push_back( Points[i] );
+			NewTexCoords.push_back( TexCoords[i] );
+		}
+
+		if ( ( ( flDist0 > OVERLAY_WORLDSPACE_EPSILON ) && ( flDist1 < -OVERLAY_WORLDSPACE_EPSILON ) ) ||
+			 ( ( flDist0 < -OVERLAY_WORLDSPACE_EPSILON ) && ( flDist1 > OVERLAY_WORLDSPACE_EPSILON ) ) )
+		{
+			float flFraction = flDist0 / ( flDist0 - flDist1 );
+			Vector2D_t Point = { Points[i].x + ( Points[j].x - Points[i].x ) * flFraction, Points[i].y + ( Points[j].y - Points[i].y ) * flFraction };
+			Vector2D_t TexCoord = { TexCoords[i].x + ( TexCoords[j].x - TexCoords[i].x ) * flFraction, TexCoords[i].y + ( TexCoords[j].y - TexCoords[i].y ) * flFraction };
+			NewPoints.push_back( Point );
+			NewTexCoords.push_back( TexCoord );
+		}
+	}
+
+	Points.swap( NewPoints );
+	TexCoords.swap( NewTexCoords );
+}
+
+static RenderFace_t *MakeRenderFace( Face_t *pFace, std::vector<Vector2D_t> &Points, std::vector<Vector2D_t> &TexCoords, float flHeight )
+{
+	if ( Points.size() < 3 )
+		return NULL;
+
+	RenderFace_t *pRenderFace = new RenderFace_t;
+	pRenderFace->m_pBuildFace = pFace;
+	for ( size_t i = 0; i < Points.size(); i++ )
+	{
+		Vector_t Point = { Points[i].x, Points[i].y, flHeight };
+		pRenderFace->m_Points.push_back( Point );
+	}
+	pRenderFace->m_TexCoords = TexCoords;
+	return pRenderFace;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CMapOverlay::DoClipFace: the overlay cut to the edges of the face,
+//			then for a displacement cut into strips that follow it.
+//-----------------------------------------------------------------------------
+static void DoClipFace( Overlay_t &Overlay, Face_t *pFace, List_t &aClipFaces )
+{
+	std::vector<Vector2D_t> Points( Overlay.m_Points, Overlay.m_Points + 4 );
+	std::vector<Vector2D_t> TexCoords( Overlay.m_TexCoords, Overlay.m_TexCoords + 4 );
+
+	size_t nEdges = pFace->m_Points.size();
+	for ( size_t i = 0; ( i < nEdges ) && !Points.empty(); i++ )
+	{
+		Vector2D_t &Start = pFace->m_Points[i];
+		Vector2D_t &End = pFace->m_Points[( i + 1 ) % nEdges];
+
+		// Outward normal of a counterclockwise edge.
+		float flA = End.y - Start.y;
+		float flB = Start.x - End.x;
+		ClipPolygon( Points, TexCoords, flA, flB, flA * Start.x + flB * Start.y );
+	}
+
+	if ( !pFace->HasDisp() )
+	{
+		RenderFace_t *pRenderFace = MakeRenderFace( pFace, Points, TexCoords, pFace->m_flHeight );
+		if ( pRenderFace )
+		{
+			aClipFaces.AddToTail( pRenderFace );
+		}
+		return;
+	}
+
+	for ( int iStrip = -16; iStrip < 16; iStrip++ )
+	{
+		std::vector<Vector2D_t> StripPoints = Points;
+		std::vector<Vector2D_t> StripTexCoords = TexCoords;
+		ClipPolygon( StripPoints, StripTexCoords, 1, 0, ( iStrip + 1 ) * DISP_STRIP_WIDTH );
+		ClipPolygon( StripPoints, StripTexCoords, -1, 0, -iStrip * DISP_STRIP_WIDTH );
+
+		RenderFace_t *pRenderFace = MakeRenderFace( pFace, StripPoints, StripTexCoords, pFace->m_flHeight + pFace->m_nSculpt * ( iStrip & 3 ) );
+		if ( pRenderFace )
+		{
+			aClipFaces.AddToTail( pRenderFace );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: DoClip as it was: every face clipped again.
+//-----------------------------------------------------------------------------
+static void DoClipAll( Overlay_t &Overlay, SideList_t &SideList, List_t &aRenderFaces )
+{
+	aRenderFaces.PurgeAndDeleteElements();
+	for ( int iFace = 0; iFace < SideList.Count(); iFace++ )
+	{
+		Face_t *pFace = SideList.Element( iFace );
+		if ( pFace )
+		{
+			DoClipFace( Overlay, pFace, aRenderFaces );
+		}
+	}
+}
+
+//
+// DoClip as it is now, with the members of CMapOverlay it uses.
+//
+struct CachedOverlay_t
+{
+	Overlay_t m_ClipKey;
+	bool m_bClipKeyValid;
+	FaceClips_t m_FaceClips;
+	List_t m_aRenderFaces;
+	int m_nClipped;
+
+	CachedOverlay_t( void ) : m_bClipKeyValid( false ), m_nClipped( 0 ) {}
+
+	void DoClip( Overlay_t &Overlay, SideList_t &SideList )
+	{
+		if ( !m_bClipKeyValid || memcmp( &Overlay, &m_ClipKey, sizeof( Overlay_t ) ) )
+		{
+			m_FaceClips.Purge();
+			m_ClipKey = Overlay;
+			m_bClipKeyValid = true;
+		}
+
+		m_FaceClips.Match( SideList );
+
+		for ( int iFaceClip = 0; iFaceClip < m_FaceClips.Count(); iFaceClip++ )
+		{
+			FaceClips_t::FaceClip_t *pFaceClip = m_FaceClips.Element( iFaceClip );
+			if ( pFaceClip->m_bStale )
+			{
+				DoClipFace( Overlay, pFaceClip->m_pFace, pFaceClip->m_aFaces );
+				m_nClipped++;
+			}
+		}
+
+		m_FaceClips.GetRenderFaces( m_aRenderFaces );
+	}
+};
+
+static bool SameRenderFaces( List_t &aRenderFaces1, List_t &aRenderFaces2 )
+{
+	if ( aRenderFaces1.Count() != aRenderFaces2.Count() )
+		return false;
+
+	for ( int i = 0; i < aRenderFaces1.Count(); i++ )
+	{
+		RenderFace_t *pFace1 = aRenderFaces1[i];
+		RenderFace_t *pFace2 = aRenderFaces2[i];
+		if ( ( pFace1->m_pBuildFace != pFace2->m_pBuildFace ) || ( pFace1->m_Points.size() != pFace2->m_Points.size() ) )
+			return false;
+
+		if ( memcmp( &pFace1->m_Points[0], &pFace2->m_Points[0], pFace1->m_Points.size() * sizeof( Vector_t ) ) ||
+			 memcmp( &pFace1->m_TexCoords[0], &pFace2->m_TexCoords[0], pFace1->m_TexCoords.size() * sizeof( Vector2D_t ) ) )
+			return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Random overlays and faces.
+//-----------------------------------------------------------------------------
+static void MakeFace( Face_t &Face, float flRange )
+{
+	float flCenterX = RandomFloat( -flRange, flRange );
+	float flCenterY = RandomFloat( -flRange, flRange );
+	float flRadius = RandomFloat( 16, 160 );
+
+	// Points on a circle in increasing angle make a convex counterclockwise polygon.
+	int nPoints = RandomInt( 3, 8 );
+	std::vector<float> Angles;
+	for ( int i = 0; i < nPoints; i++ )
+	{
+		Angles.push_back( ( i + RandomFloat( 0.1f, 0.9f ) ) * 6.2831853f / nPoints );
+	}
+
+	Face.m_Points.clear();
+	for ( int i = 0; i < nPoints; i++ )
+	{
+		Vector2D_t Point = { flCenterX + flRadius * cosf( Angles[i] ), flCenterY + flRadius * sinf( Angles[i] ) };
+		Face.m_Points.push_back( Point );
+	}
+
+	Face.m_flHeight = (float)RandomInt( -64, 0 );
+	Face.BumpRevision();
+}
+
+static void MakeOverlay( Overlay_t &Overlay, float flRange )
+{
+	float flMinX = RandomFloat( -flRange, 0 );
+	float flMinY = RandomFloat( -flRange, 0 );
+	float flMaxX = RandomFloat( 16, flRange );
+	float flMaxY = RandomFloat( 16, flRange );
+
+	Vector2D_t Points[4] = { { flMinX, flMinY }, { flMinX, flMaxY }, { flMaxX, flMaxY }, { flMaxX, flMinY } };
+	Vector2D_t TexCoords[4] = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 } };
+	for ( int i = 0; i < 4; i++ )
+	{
+		Overlay.m_Points[i] = Points[i];
+		Overlay.m_TexCoords[i] = TexCoords[i];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Makes one edit of the kind the editor makes between clips.
+//-----------------------------------------------------------------------------
+static void RandomEdit( Overlay_t &Overlay, std::vector<Face_t> &Faces, SideList_t &SideList )
+{
+	Face_t &Face = Faces[RandomInt( 0, (int)Faces.size() - 1 )];
+
+	switch ( RandomInt( 0, 11 ) )
+	{
+		case 0:
+		{
+			// Reshape a face.
+			MakeFace( Face, 256 );
+			break;
+		}
+		case 1:
+		{
+			// Move a face; the editor bumps the revision for any change to its points.
+			for ( size_t i = 0; i < Face.m_Points.size(); i++ )
+			{
+				Face.m_Points[i].x += 8;
+			}
+			Face.BumpRevision();
+			break;
+		}
+		case 2:
+		{
+			Face.m_flHeight += 1;
+			Face.BumpRevision();
+			break;
+		}
+		case 3:
+		{
+			// Sculpt, add or remove a displacement; none of these touch the revision.
+			Face.m_nSculpt = RandomInt( 0, 8 );
+			break;
+		}
+		case 4:
+		{
+			Face.m_bDisp = !Face.m_bDisp;
+			break;
+		}
+		case 5:
+		{
+			SideList.m_Faces.push_back( &Face );
+			break;
+		}
+		case 6:
+		{
+			if ( !SideList.m_Faces.empty() )
+			{
+				SideList.m_Faces.erase( SideList.m_Faces.begin() + RandomInt( 0, (int)SideList.m_Faces.size() - 1 ) );
+			}
+			break;
+		}
+		case 7:
+		{
+			if ( SideList.m_Faces.size() >= 2 )
+			{
+				int i = RandomInt( 0, (int)SideList.m_Faces.size() - 1 );
+				int j = RandomInt( 0, (int)SideList.m_Faces.size() - 1 );
+				Face_t *pSwap = SideList.m_Faces[i];
+				SideList.m_Faces[i] = SideList.m_Faces[j];
+				SideList.m_Faces[j] = pSwap;
+			}
+			break;
+		}
+		case 8:
+		{
+			// Faces of deleted solids stay in the list as NULL.
+			if ( !SideList.m_Faces.empty() )
+			{
+				SideList.m_Faces[RandomInt( 0, (int)SideList.m_Faces.size() - 1 )] = NULL;
+			}
+			break;
+		}
+		case 9:
+		{
+			// Drag a handle.
+			int iPoint = RandomInt( 0, 3 );
+			Overlay.m_Points[iPoint].x += RandomFloat( -16, 16 );
+			Overlay.m_Points[iPoint].y += RandomFloat( -16, 16 );
+			break;
+		}
+		case 10:
+		{
+			Overlay.m_TexCoords[RandomInt( 0, 3 )].x += 0.25f;
+			break;
+		}
+		default:
+		{
+			// Notifications that change nothing the clip reads.
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Tests.
+//-----------------------------------------------------------------------------
+static void TestRandomEdits( void )
+{
+	int nDifferences = 0;
+	int nClips = 0;
+	int nClipped = 0;
+	int nRenderFaces = 0;
+
+	for ( int n = 0; n < 200; n++ )
+	{
+		std::vector<Face_t> Faces( RandomInt( 1, 40 ) );
+		for ( size_t i = 0; i < Faces.size(); i++ )
+		{
+			MakeFace( Faces[i], 256 );
+			Faces[i].m_bDisp = ( RandomInt( 0, 4 ) == 0 );
+			Faces[i].m_nSculpt = RandomInt( 0, 8 );
+		}
+
+		SideList_t SideList;
+		for ( size_t i = 0; i < Faces.size(); i++ )
+		{
+			if ( RandomInt( 0, 3 ) != 0 )
+			{
+				SideList.m_Faces.push_back( &Faces[i] );
+			}
+		}
+
+		Overlay_t Overlay;
+		MakeOverlay( Overlay, 256 );
+
+		CachedOverlay_t Cached;
+		List_t aRenderFaces;
+		for ( int nEdit = 0; nEdit < 100; nEdit++ )
+		{
+			for ( int i = RandomInt( 0, 3 ); i > 0; i-- )
+			{
+				RandomEdit( Overlay, Faces, SideList );
+			}
+
+			// DoClip does nothing with an empty sidelist.
+			if ( SideList.Count() == 0 )
+				continue;
+
+			DoClipAll( Overlay, SideList, aRenderFaces );
+			Cached.DoClip( Overlay, SideList );
+
+			if ( !SameRenderFaces( aRenderFaces, Cached.m_aRenderFaces ) )
+			{
+				nDifferences++;
+			}
+
+			nClips += SideList.Count();
+			nRenderFaces += aRenderFaces.Count();
+		}
+
+		nClipped += Cached.m_nClipped;
+		aRenderFaces.PurgeAndDeleteElements();
+	}
+
+	CHECK( nDifferences == 0 );
+	CHECK( nRenderFaces > 10000 );
+
+	// Most faces were served from the cache.
+	CHECK( nClipped < nClips / 2 );
+
+	// Nothing was leaked or freed twice.
+	CHECK( s_nRenderFaces == 0 );
+}
+
+static void TestDispRemoved( void )
+{
+	// Removing a displacement leaves the revision alone, but the clip made
+	// while it was there is no longer any good.
+	std::vector<Face_t> Faces( 1 );
+	Vector2D_t Points[4] = { { -64, -64 }, { 64, -64 }, { 64, 64 }, { -64, 64 } };
+	Faces[0].m_Points.assign( Points, Points + 4 );
+	Faces[0].m_flHeight = 0;
+	Faces[0].m_bDisp = true;
+	Faces[0].m_nSculpt = 4;
+	Faces[0].BumpRevision();
+
+	SideList_t SideList;
+	SideList.m_Faces.push_back( &Faces[0] );
+
+	Overlay_t Overlay;
+	MakeOverlay( Overlay, 128 );
+
+	CachedOverlay_t Cached;
+	Cached.DoClip( Overlay, SideList );
+	CHECK( Cached.m_aRenderFaces.Count() > 1 );
+
+	Faces[0].m_bDisp = false;
+	Cached.DoClip( Overlay, SideList );
+	CHECK( Cached.m_aRenderFaces.Count() == 1 );
+	CHECK( Cached.m_nClipped == 2 );
+
+	// Unchanged now, so it comes from the cache.
+	Cached.DoClip( Overlay, SideList );
+	CHECK( Cached.m_nClipped == 2 );
+}
+
+static void Benchmark( void )
+{
+	std::vector<Face_t> Faces( 500 );
+	SideList_t SideList;
+	for ( size_t i = 0; i < Faces.size(); i++ )
+	{
+		MakeFace( Faces[i], 1024 );
+		Faces[i].m_bDisp = ( RandomInt( 0, 19 ) == 0 );
+		Faces[i].m_nSculpt = 0;
+		SideList.m_Faces.push_back( &Faces[i] );
+	}
+
+	Overlay_t Overlay;
+	MakeOverlay( Overlay, 1024 );
+
+	// Drag one face about, clipping after every move.
+	const int nMoves = 1000;
+	List_t aRenderFaces;
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nMoves; i++ )
+	{
+		Faces[0].m_flHeight = (float)( i & 15 );
+		Faces[0].BumpRevision();
+		DoClipAll( Overlay, SideList, aRenderFaces );
+	}
+	double flAllMS = MS( Start );
+
+	CachedOverlay_t Cached;
+	Start = std::chrono::steady_clock::now();
+	for ( int i = 0; i < nMoves; i++ )
+	{
+		Faces[0].m_flHeight = (float)( i & 15 );
+		Faces[0].BumpRevision();
+		Cached.DoClip( Overlay, SideList );
+	}
+	double flCachedMS = MS( Start );
+
+	CHECK( SameRenderFaces( aRenderFaces, Cached.m_aRenderFaces ) );
+
+	printf( "Clipping an overlay to %d faces (%d render faces), %d times:\n", (int)Faces.size(), aRenderFaces.Count(), nMoves );
+	printf( "  every face:     %8.1f ms\n", flAllMS );
+	printf( "  stale faces:    %8.1f ms (%d faces clipped)\n", flCachedMS, Cached.m_nClipped );
+
+	aRenderFaces.PurgeAndDeleteElements();
+}
+
+int main( void )
+{
+	TestDispRemoved();
+	TestRandomEdits();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All overlay face clip tests passed\n" );
+
+	Benchmark();
+	return ( g_nFailures != 0 ) ? 1 : 0;
+}
@@ -44,6 +44,49 @@ void CPrefab3D::FreeData()
 	m_pWorld = NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the number of map objects in the loaded prefab, used to
+//			budget the prefab cache.
+//-----------------------------------------------------------------------------
+int CPrefab3D::GetObjectCount(void)
+{
+	if (m_pWorld == NULL)
+	{
+		return 0;
+	}
+
+	int nObjects = 0;
+	EnumChildrenPos_t pos;
+	CMapClass *pChild = m_pWorld->GetFirstDescendent(pos);
+	while (pChild != NULL)
+	{
+		nObjects++;
+		pChild = m_pWorld->GetNextDescendent(pos);
+	}
+
+	return nObjects;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Gets the 2D render bounds of the prefab, loading it if need be.
+// Output : Returns true on success, false if the prefab couldn't be loaded.
+//-----------------------------------------------------------------------------
+bool CPrefab3D::GetBounds(Vector &mins, Vector &maxs)
+{
+	if (!IsLoaded())
+	{
+		Load();
+	}
+
+	if (!IsLoaded())
+	{
+		return false;
+	}
+
+	m_pWorld->GetRender2DBox(mins, maxs);
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -250,8 +293,6 @@ int CPrefabRMF::DoLoad(std::fstream& file, DWORD dwFlags)
 
 	GetHistory()->Pause();
 
-	AddMRU(this);
-
 	if(m_pWorld)
 		delete m_pWorld;
 	m_pWorld = new CMapWorld( NULL );
@@ -262,6 +303,9 @@ int CPrefabRMF::DoLoad(std::fstream& file, DWORD dwFlags)
 	else
 		iRvl = m_pWorld->SerializeRMF(file, FALSE);
 
+	// cache it now that its size is known
+	AddMRU(this);
+
 	// error?
 	if(iRvl == -1)
 	{
@@ -390,6 +434,8 @@ int CPrefabRMF::Save(std::fstream& file, DWORD dwFlags)
 //-----------------------------------------------------------------------------
 CPrefabVMF::CPrefabVMF()
 {
+	m_bIndexed = false;
+	m_nIndexFileTime = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -425,6 +471,27 @@ bool CPrefabVMF::IsLoaded(void)
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Gets the 2D render bounds of the prefab. While the prefab isn't
+//			loaded, the library index answers if it is still current.
+// Output : Returns true on success, false if the prefab couldn't be loaded.
+//-----------------------------------------------------------------------------
+bool CPrefabVMF::GetBounds(Vector &mins, Vector &maxs)
+{
+	if (m_bIndexed && !IsLoaded())
+	{
+		struct _stat info;
+		if ((_stat(m_szFilename, &info) == 0) && (info.st_mtime == m_nIndexFileTime))
+		{
+			mins = m_IndexMins;
+			maxs = m_IndexMaxs;
+			return true;
+		}
+	}
+
+	return CPrefab3D::GetBounds(mins, maxs);
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : dwFlags - 
@@ -498,7 +565,28 @@ int CPrefabVMF::Load(DWORD dwFlags)
 		if (_stat(m_szFilename, &info) == 0)
 		{
 			m_nFileTime = info.st_mtime;
+
+			//
+			// Refresh this prefab's entry in the library index.
+			//
+			Vector mins, maxs;
+			m_pWorld->GetRender2DBox(mins, maxs);
+			if (!m_bIndexed || (m_nIndexFileTime != m_nFileTime) || (mins != m_IndexMins) || (maxs != m_IndexMaxs))
+			{
+				m_bIndexed = true;
+				m_nIndexFileTime = m_nFileTime;
+				m_IndexMins = mins;
+				m_IndexMaxs = maxs;
+
+				CPrefabLibraryVMF *pLibrary = dynamic_cast<CPrefabLibraryVMF *>(CPrefabLibrary::FindID(dwLibID));
+				if (pLibrary != NULL)
+				{
+					pLibrary->m_bIndexModified = true;
+				}
+			}
 		}
+
+		AddMRU(this);
 	}
 	else
 	{
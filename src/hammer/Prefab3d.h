@@ -25,6 +25,10 @@ class CPrefab3D : public CPrefab
 
 		virtual bool IsLoaded(void);
 		void FreeData();
+		int GetObjectCount(void);
+
+		// 2D render bounds, loading the prefab if need be.
+		virtual bool GetBounds(Vector &mins, Vector &maxs);
 
 		void CenterOnZero();
 
@@ -87,6 +91,7 @@ class CPrefabVMF : public CPrefab3D
 		int Save(LPCTSTR pszFilename, DWORD = 0);
 
 		virtual bool IsLoaded(void);
+		virtual bool GetBounds(Vector &mins, Vector &maxs);
 
 		void SetFilename(const char *szFilename);
 
@@ -96,6 +101,14 @@ class CPrefabVMF : public CPrefab3D
 
 		char m_szFilename[MAX_PATH];	// Full path of the prefab VMF.
 		int m_nFileTime;				// File modification time of the last loaded version of the prefab.
+
+		// Library index entry, so the bounds are known without loading the prefab.
+		bool m_bIndexed;
+		int m_nIndexFileTime;			// File modification time the entry was made from.
+		Vector m_IndexMins;
+		Vector m_IndexMaxs;
+
+	friend class CPrefabLibraryVMF;
 }; 
 
 #endif // PREFAB3D_H
\ No newline at end of file
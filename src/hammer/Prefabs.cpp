@@ -19,14 +19,18 @@
 #include "hammer.h"
 #include <io.h>
 #include <fcntl.h>
+#include "tier1/utldict.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
 
 BOOL CPrefab::bCacheEnabled = TRUE;
-CPrefabList CPrefab::PrefabList;
+CUtlHashtable<DWORD, CPrefab *> CPrefab::PrefabsByID;
 CPrefabList CPrefab::MRU;
 CPrefabLibraryList CPrefabLibrary::PrefabLibraryList;
+CUtlHashtable<DWORD, CPrefabLibrary *> CPrefabLibrary::PrefabLibrariesByID;
+
+#define PREFAB_CACHE_MAX_OBJECTS	8192	// Map objects the MRU keeps loaded before uncaching prefabs.
 
 static char *pLibHeader = "Worldcraft Prefab Library\r\n\x1a";
 static float fLibVersion = 0.1f;
@@ -48,6 +52,29 @@ typedef struct
 	char szNotes[MAX_NOTES];
 } PrefabLibraryHeader;
 
+//
+// Index of a Half-Life 2 prefab folder, so that prefab bounds are known
+// without parsing the VMFs. Entries are only trusted while the file's
+// modification time matches.
+//
+static char *pIndexFilename = "prefabs.idx";
+static char *pIndexHeader = "Hammer Prefab Index\r\n\x1a";
+static DWORD dwIndexVersion = 1;
+
+typedef struct
+{
+	DWORD dwVersion;
+	DWORD dwNumEntries;
+} PrefabIndexHeader;
+
+struct PrefabIndexEntry_t
+{
+	char szFile[MAX_PATH];	// file name within the folder
+	int nFileTime;			// modification time the entry was made from
+	float Mins[3];
+	float Maxs[3];
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Creates a prefab library from a given path.
 // Input  : szFile - 
@@ -83,10 +110,12 @@ CPrefab::CPrefab()
 	static DWORD dwRunningID = 1;
 	// assign running ID
 	dwID = dwRunningID++;
-	PrefabList.AddTail(this);
+	PrefabsByID.Insert(dwID, this);
 
 	// assign blank name/notes
 	szName[0] = szNotes[0] = 0;
+
+	m_nCacheObjects = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -94,10 +123,8 @@ CPrefab::CPrefab()
 //-----------------------------------------------------------------------------
 CPrefab::~CPrefab()
 {
-	POSITION p = PrefabList.Find(this);
-	if(p)
-		PrefabList.RemoveAt(p);
-	p = MRU.Find(this);
+	PrefabsByID.Remove(dwID);
+	POSITION p = MRU.Find(this);
 	if(p)
 		MRU.RemoveAt(p);
 }
@@ -109,15 +136,11 @@ CPrefab::~CPrefab()
 //-----------------------------------------------------------------------------
 CPrefab * CPrefab::FindID(DWORD dwID)
 {
-	POSITION p = PrefabList.GetHeadPosition();
-	while(p)
-	{
-		CPrefab *pPrefab = PrefabList.GetNext(p);
-		if(pPrefab->dwID == dwID)
-			return pPrefab;
-	}
+	UtlHashHandle_t h = PrefabsByID.Find(dwID);
+	if(h == PrefabsByID.InvalidHandle())
+		return NULL;
 
-	return NULL;
+	return PrefabsByID[h];
 }
 
 //-----------------------------------------------------------------------------
@@ -130,7 +153,9 @@ void CPrefab::EnableCaching(BOOL b)
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: 
+// Purpose: Marks a prefab as just loaded or used. The least recently used
+//			prefabs are uncached until the rest hold no more than
+//			PREFAB_CACHE_MAX_OBJECTS map objects; the newest always stays.
 // Input  : *pPrefab - 
 //-----------------------------------------------------------------------------
 void CPrefab::AddMRU(CPrefab *pPrefab)
@@ -144,20 +169,25 @@ void CPrefab::AddMRU(CPrefab *pPrefab)
 		// remove there and add to head
 		MRU.RemoveAt(p);
 	}
-	else if(MRU.GetCount() == 5)
-	{
-		// uncache tail object
-		p = MRU.GetTailPosition();
-		if(p)	// might not be any yet
-		{
-			CPrefab *pUncache = MRU.GetAt(p);
-			pUncache->FreeData();
-			MRU.RemoveAt(p);
-		}
-	}
 
 	// add to head
+	pPrefab->m_nCacheObjects = pPrefab->GetObjectCount();
 	MRU.AddHead(pPrefab);
+
+	int nObjects = 0;
+	p = MRU.GetHeadPosition();
+	while(p)
+	{
+		nObjects += MRU.GetNext(p)->m_nCacheObjects;
+	}
+
+	while(nObjects > PREFAB_CACHE_MAX_OBJECTS && MRU.GetCount() > 1)
+	{
+		// uncache tail object
+		CPrefab *pUncache = MRU.RemoveTail();
+		nObjects -= pUncache->m_nCacheObjects;
+		pUncache->FreeData();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -166,11 +196,9 @@ void CPrefab::AddMRU(CPrefab *pPrefab)
 void CPrefab::FreeAllData()
 {
 	// free all prefab data memory
-	POSITION p = PrefabList.GetHeadPosition();
-	while(p)
+	FOR_EACH_HASHTABLE(PrefabsByID, h)
 	{
-		CPrefab *pPrefab = PrefabList.GetNext(p);
-		pPrefab->FreeData();
+		PrefabsByID[h]->FreeData();
 	}
 }
 
@@ -247,6 +275,16 @@ CPrefabLibrary::CPrefabLibrary()
 CPrefabLibrary::~CPrefabLibrary()
 {
 	FreePrefabs();
+
+	// don't leave the library findable once it's gone
+	if (PrefabLibrariesByID.Remove(dwID))
+	{
+		POSITION p = PrefabLibraryList.Find(this);
+		if (p != NULL)
+		{
+			PrefabLibraryList.RemoveAt(p);
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -261,6 +299,17 @@ void CPrefabLibrary::FreePrefabs()
 		CPrefab *pPrefab = Prefabs.GetNext(p);
 		delete pPrefab;
 	}
+
+	Prefabs.RemoveAll();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a library to the list of open libraries.
+//-----------------------------------------------------------------------------
+void CPrefabLibrary::AddLibrary(CPrefabLibrary *pLibrary)
+{
+	PrefabLibraryList.AddTail(pLibrary);
+	PrefabLibrariesByID.Insert(pLibrary->dwID, pLibrary);
 }
 
 //-----------------------------------------------------------------------------
@@ -347,6 +396,7 @@ void CPrefabLibrary::FreeAllLibraries(void)
 	}
 
 	PrefabLibraryList.RemoveAll();
+	PrefabLibrariesByID.RemoveAll();
 }
 
 //-----------------------------------------------------------------------------
@@ -367,7 +417,7 @@ void CPrefabLibrary::LoadAllLibraries()
 		pLibrary = CreatePrefabLibrary(szDir);
 		if (pLibrary != NULL)
 		{
-			PrefabLibraryList.AddTail(pLibrary);
+			AddLibrary(pLibrary);
 		}
 	}
 	else
@@ -398,7 +448,7 @@ void CPrefabLibrary::LoadAllLibraries()
 				pLibrary = CreatePrefabLibrary(szFile);
 				if (pLibrary != NULL)
 				{
-					PrefabLibraryList.AddTail(pLibrary);
+					AddLibrary(pLibrary);
 				}
 			}
 			else
@@ -456,15 +506,11 @@ CPrefab * CPrefabLibrary::EnumPrefabs(POSITION &p)
 //-----------------------------------------------------------------------------
 CPrefabLibrary * CPrefabLibrary::FindID(DWORD dwID)
 {
-	POSITION p = PrefabLibraryList.GetHeadPosition();
-	while(p)
-	{
-		CPrefabLibrary *pPrefabLibrary = PrefabLibraryList.GetNext(p);
-		if(pPrefabLibrary->dwID == dwID)
-			return pPrefabLibrary;
-	}
+	UtlHashHandle_t h = PrefabLibrariesByID.Find(dwID);
+	if(h == PrefabLibrariesByID.InvalidHandle())
+		return NULL;
 
-	return NULL;
+	return PrefabLibrariesByID[h];
 }
 
 //-----------------------------------------------------------------------------
@@ -840,6 +886,8 @@ int CPrefabLibraryRMF::SetName(LPCTSTR pszName)
 //-----------------------------------------------------------------------------
 CPrefabLibraryVMF::CPrefabLibraryVMF()
 {
+	m_szFolderName[0] = '\0';
+	m_bIndexModified = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -847,6 +895,7 @@ CPrefabLibraryVMF::CPrefabLibraryVMF()
 //-----------------------------------------------------------------------------
 CPrefabLibraryVMF::~CPrefabLibraryVMF()
 {
+	SaveIndex();
 }
 
 //-----------------------------------------------------------------------------
@@ -865,6 +914,7 @@ bool CPrefabLibraryVMF::IsFile(const char *szFilename)
 //-----------------------------------------------------------------------------
 int CPrefabLibraryVMF::Load(LPCTSTR pszFilename)
 {
+	SaveIndex();
 	FreePrefabs();
 
 	SetNameFromFilename(pszFilename);
@@ -891,6 +941,15 @@ int CPrefabLibraryVMF::Load(LPCTSTR pszFilename)
 
 	*strrchr(szDir, '*') = '\0';
 
+	CUtlVector<PrefabIndexEntry_t> IndexEntries;
+	LoadIndex(IndexEntries);
+
+	CUtlDict<int, int> IndexByFile;
+	for (int i = 0; i < IndexEntries.Count(); i++)
+	{
+		IndexByFile.Insert(IndexEntries[i].szFile, i);
+	}
+
 	do
 	{
 		if (fd.cFileName[0] != '.')
@@ -905,6 +964,16 @@ int CPrefabLibraryVMF::Load(LPCTSTR pszFilename)
 			CPrefabVMF *pPrefab = new CPrefabVMF;
 			pPrefab->SetFilename(szFile);
 
+			int nIndex = IndexByFile.Find(fd.cFileName);
+			if (nIndex != IndexByFile.InvalidIndex())
+			{
+				const PrefabIndexEntry_t &Entry = IndexEntries[IndexByFile[nIndex]];
+				pPrefab->m_bIndexed = true;
+				pPrefab->m_nIndexFileTime = Entry.nFileTime;
+				pPrefab->m_IndexMins.Init(Entry.Mins[0], Entry.Mins[1], Entry.Mins[2]);
+				pPrefab->m_IndexMaxs.Init(Entry.Maxs[0], Entry.Maxs[1], Entry.Maxs[2]);
+			}
+
 			Add(pPrefab);
 		}
 	} while (FindNextFile(hnd, &fd));
@@ -914,6 +983,104 @@ int CPrefabLibraryVMF::Load(LPCTSTR pszFilename)
 	return 1;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Reads the folder's prefab index. A missing or outdated index
+//			reads as empty.
+// Input  : Entries - Receives the index entries.
+//-----------------------------------------------------------------------------
+void CPrefabLibraryVMF::LoadIndex(CUtlVector<PrefabIndexEntry_t> &Entries)
+{
+	m_bIndexModified = false;
+
+	char szFile[MAX_PATH];
+	sprintf(szFile, "%s\\%s", m_szFolderName, pIndexFilename);
+
+	std::fstream file(szFile, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return;
+
+	char szBuf[128];
+	file.read(szBuf, strlen(pIndexHeader));
+	if (!file.good() || strncmp(szBuf, pIndexHeader, strlen(pIndexHeader)))
+		return;
+
+	PrefabIndexHeader pih;
+	file.read((char *)&pih, sizeof(pih));
+	if (!file.good() || pih.dwVersion != dwIndexVersion)
+		return;
+
+	// Don't trust the entry count past what's actually left in the file.
+	std::streamoff nStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff nRemaining = file.tellg() - nStart;
+	file.seekg(nStart, std::ios::beg);
+	if (!file.good() || nRemaining < 0 || (std::streamoff)pih.dwNumEntries * (std::streamoff)sizeof(PrefabIndexEntry_t) > nRemaining)
+		return;
+
+	Entries.SetCount(pih.dwNumEntries);
+	file.read((char *)Entries.Base(), pih.dwNumEntries * sizeof(PrefabIndexEntry_t));
+	if (!file.good())
+	{
+		Entries.RemoveAll();
+		return;
+	}
+
+	for (int i = 0; i < Entries.Count(); i++)
+	{
+		Entries[i].szFile[MAX_PATH - 1] = '\0';
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the folder's prefab index if any prefab's entry changed
+//			since it was read.
+//-----------------------------------------------------------------------------
+void CPrefabLibraryVMF::SaveIndex(void)
+{
+	if (!m_bIndexModified)
+		return;
+
+	m_bIndexModified = false;
+
+	CUtlVector<PrefabIndexEntry_t> Entries;
+
+	POSITION p = Prefabs.GetHeadPosition();
+	while (p != NULL)
+	{
+		CPrefabVMF *pPrefab = (CPrefabVMF *)Prefabs.GetNext(p);
+		if (!pPrefab->m_bIndexed)
+			continue;
+
+		PrefabIndexEntry_t &Entry = Entries[Entries.AddToTail()];
+		memset(&Entry, 0, sizeof(Entry));
+
+		const char *pszFile = strrchr(pPrefab->m_szFilename, '\\');
+		V_strcpy_safe(Entry.szFile, pszFile ? (pszFile + 1) : pPrefab->m_szFilename);
+		Entry.nFileTime = pPrefab->m_nIndexFileTime;
+		for (int i = 0; i < 3; i++)
+		{
+			Entry.Mins[i] = pPrefab->m_IndexMins[i];
+			Entry.Maxs[i] = pPrefab->m_IndexMaxs[i];
+		}
+	}
+
+	char szFile[MAX_PATH];
+	sprintf(szFile, "%s\\%s", m_szFolderName, pIndexFilename);
+
+	// the prefab folder may be read only; the index is only a cache.
+	std::fstream file(szFile, std::ios::out | std::ios::binary);
+	if (!file.is_open())
+		return;
+
+	file.write(pIndexHeader, strlen(pIndexHeader));
+
+	PrefabIndexHeader pih;
+	pih.dwVersion = dwIndexVersion;
+	pih.dwNumEntries = Entries.Count();
+	file.write((char *)&pih, sizeof(pih));
+	file.write((char *)Entries.Base(), Entries.Count() * sizeof(PrefabIndexEntry_t));
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Removes this prefab library from disk.
 // Output : Returns true on success, false on failure.
@@ -14,11 +14,14 @@
 #pragma warning(disable:4701 4702 4530)
 #include <fstream>
 #pragma warning(pop)
+#include "tier1/utlvector.h"
+#include "tier1/utlhashtable.h"
 
 class BoundBox;
 class CMapClass;
 class CPrefab;
 class CPrefabLibrary;
+struct PrefabIndexEntry_t;
 
 const POSITION ENUM_START = POSITION(1);
 const int MAX_NOTES = 501;
@@ -76,6 +79,7 @@ public:
 	virtual int GetType() = 0;
 	virtual void FreeData() = 0;
 	virtual bool IsLoaded() = 0;
+	virtual int GetObjectCount() = 0;	// map objects held while loaded
 
 	// filetype determination:
 	typedef enum
@@ -104,7 +108,9 @@ protected:
 	DWORD dwFileOffset;
 	DWORD dwFileSize;	// size in file - for copying purposes
 
-	static CPrefabList PrefabList;
+	int m_nCacheObjects;	// GetObjectCount() when last added to the MRU
+
+	static CUtlHashtable<DWORD, CPrefab *> PrefabsByID;
 	static CPrefabList MRU;
 	static BOOL bCacheEnabled;
 
@@ -156,7 +162,10 @@ public:
 protected:
 	void FreePrefabs();
 
+	static void AddLibrary(CPrefabLibrary *pLibrary);
+
 	static CPrefabLibraryList PrefabLibraryList;
+	static CUtlHashtable<DWORD, CPrefabLibrary *> PrefabLibrariesByID;	// libraries in PrefabLibraryList
 
 	CPrefabList Prefabs;
 	char m_szName[31];
@@ -203,9 +212,14 @@ public:
 	int SetName(const char *pszName);
 
 protected:
+	void LoadIndex(CUtlVector<PrefabIndexEntry_t> &Entries);
+	void SaveIndex(void);
+
 	char m_szFolderName[MAX_PATH];
+	bool m_bIndexModified;			// a prefab's index entry changed since the index was read
 
 friend class CPrefab;
+friend class CPrefabVMF;
 };
 
 //-----------------------------------------------------------------------------
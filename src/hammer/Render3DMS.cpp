@@ -10,6 +10,7 @@
 #include <mmsystem.h>
 #include "Camera.h"
 #include "CullTreeNode.h"
+#include "FrustumCull.h"
 #include "MapDefs.h"
 #include "MapDoc.h"
 #include "MapEntity.h"
@@ -41,6 +42,7 @@
 #include "mathlib/halton.h"
 #include "Manifest.h"
 #include "Options.h"
+#include "EditorProfiler.h"
 
 #ifdef SLE
 #include "collisionutils.h" //// used for rendering world text (point message)
@@ -80,6 +82,7 @@ static bool g_bUseCullTree = true;
 #endif
 
 static bool g_bRenderCullBoxes = false;
+static bool g_bUseSIMDCulling = true;
 
 #ifdef SLE_USE_HAMMER_LPREVIEW
 int g_nBitmapGenerationCounter = 1;
@@ -503,67 +506,49 @@ bool CRender3D::SetView( CMapView *pView )
 //-----------------------------------------------------------------------------
 Visibility_t CRender3D::IsBoxVisible(Vector const &BoxMins, Vector const &BoxMaxs)
 {
-	Vector NearVertex;
-	Vector FarVertex;
+	return (Visibility_t)FrustumCull_TestBox(m_FrustumPlanes[0].Base(), 6, BoxMins.Base(), BoxMaxs.Base());
+}
 
-	//
-	// Build the near and far vertices based on the octant of the plane normal.
-	//
-	int nInPlanes = 0;
-	for ( int i = 0; i < 6; i++ )
+//-----------------------------------------------------------------------------
+// Purpose: Determines the visibility of a batch of axis-aligned bounding boxes.
+// Input  : Batch - Bounding boxes to evaluate.
+// Output : nVisibleMask - Bit set for each box that IsBoxVisible would not
+//				report as VIS_NONE.
+//			nTotalMask - Bit set for each box that IsBoxVisible would report
+//				as VIS_TOTAL.
+//-----------------------------------------------------------------------------
+void CRender3D::AreBoxesVisible(CFrustumCullBatch const &Batch, uint64 &nVisibleMask, uint64 &nTotalMask)
+{
+	if (g_bUseSIMDCulling)
 	{
-		if (m_FrustumPlanes[i][0] > 0)
-		{
-			NearVertex[0] = BoxMins[0];
-			FarVertex[0] = BoxMaxs[0];
-		}
-		else
-		{
-			NearVertex[0] = BoxMaxs[0];
-			FarVertex[0] = BoxMins[0];
-		}
+		Batch.Test(m_FrustumPlanes[0].Base(), 6, nVisibleMask, nTotalMask);
+		return;
+	}
 
-		if (m_FrustumPlanes[i][1] > 0)
-		{
-			NearVertex[1] = BoxMins[1];
-			FarVertex[1] = BoxMaxs[1];
-		}
-		else
-		{
-			NearVertex[1] = BoxMaxs[1];
-			FarVertex[1] = BoxMins[1];
-		}
+	nVisibleMask = 0;
+	nTotalMask = 0;
 
-		if (m_FrustumPlanes[i][2] > 0)
-		{
-			NearVertex[2] = BoxMins[2];
-			FarVertex[2] = BoxMaxs[2];
-		}
-		else
-		{
-			NearVertex[2] = BoxMaxs[2];
-			FarVertex[2] = BoxMins[2];
-		}
+	int nCount = Batch.Count();
+	for (int i = 0; i < nCount; i++)
+	{
+		Vector BoxMins;
+		Vector BoxMaxs;
+		Batch.GetBox(i, BoxMins.Base(), BoxMaxs.Base());
 
-		if (DotProduct(m_FrustumPlanes[i].AsVector3D(), NearVertex) >= m_FrustumPlanes[i][3])
+		Visibility_t eVis = IsBoxVisible(BoxMins, BoxMaxs);
+		if (eVis != VIS_NONE)
 		{
-			return(VIS_NONE);
+			nVisibleMask |= (uint64)1 << i;
 		}
 
-		if (DotProduct(m_FrustumPlanes[i].AsVector3D(), FarVertex) < m_FrustumPlanes[i][3])
+		if (eVis == VIS_TOTAL)
 		{
-			nInPlanes++;
+			nTotalMask |= (uint64)1 << i;
 		}
 	}
-
-	if (nInPlanes == 6)
-	{
-		return(VIS_TOTAL);
-	}
-	
-	return(VIS_PARTIAL);
 }
 
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : eRenderState - 
@@ -3095,19 +3080,42 @@ void CRender3D::RenderMapClass(CMapClass *pMapClass)
 			// Render this object's children.
 			//
 			const CMapObjectList *pChildren = pMapClass->GetChildren();
-			
-			FOR_EACH_OBJ( *pChildren, pos )
+			int nChildren = pChildren->Count();
+
+			//
+			// Cull the children in batches, then render the visible ones in order.
+			// The batch comes from m_CullBatches rather than the stack, since
+			// this recurses once per level of the object tree.
+			//
+			CFrustumCullBatch *pBatch = (nChildren != 0) ? m_CullBatches.Push() : NULL;
+			if (pBatch != NULL)
 			{
-				Vector vecMins,vecMaxs;
-				
-				CMapClass *pChild = pChildren->Element(pos);
+				for (int nFirst = 0; nFirst < nChildren; nFirst += FRUSTUMCULL_BATCH_SIZE)
+				{
+					int nBatchCount = min(nChildren - nFirst, FRUSTUMCULL_BATCH_SIZE);
 
-				pChild->GetCullBox(vecMins, vecMaxs);
+					pBatch->Reset();
+					for (int i = 0; i < nBatchCount; i++)
+					{
+						Vector vecMins,vecMaxs;
+						pChildren->Element(nFirst + i)->GetCullBox(vecMins, vecMaxs);
+						pBatch->AddBox(vecMins.Base(), vecMaxs.Base());
+					}
 
-				if (IsBoxVisible(vecMins, vecMaxs) != VIS_NONE )
-				{
-					RenderMapClass(pChild);
+					uint64 nVisibleMask;
+					uint64 nTotalMask;
+					AreBoxesVisible(*pBatch, nVisibleMask, nTotalMask);
+
+					for (int i = 0; i < nBatchCount; i++)
+					{
+						if (nVisibleMask & ((uint64)1 << i))
+						{
+							RenderMapClass(pChildren->Element(nFirst + i));
+						}
+					}
 				}
+
+				m_CullBatches.Pop();
 			}
 		}
 
@@ -3275,44 +3283,64 @@ void CRender3D::Preload(CMapClass *pParent)
 //-----------------------------------------------------------------------------
 void CRender3D::RenderNode(CCullTreeNode *pNode, bool bForce )
 {
+	//
+	// The batch comes from m_CullBatches rather than the stack, since this
+	// recurses once per level of the cull tree.
+	//
+	CFrustumCullBatch *pBatch = m_CullBatches.Push();
+	if (pBatch == NULL)
+	{
+		return;
+	}
+
 	//
 	// Render all child nodes first.
 	//
-	CCullTreeNode *pChild;
 	int nChildren = pNode->GetChildCount();
 	if (nChildren != 0)
 	{
-		for (int nChild = 0; nChild < nChildren; nChild++)
+		int nChild = 0;
+		while (nChild < nChildren)
 		{
-			pChild = pNode->GetCullTreeChild(nChild);
-			Assert(pChild != NULL);
+			//
+			// Gather the next batch of child nodes. Only bother checking nodes
+			// with children or objects.
+			//
+			pBatch->Reset();
+			while ((nChild < nChildren) && !pBatch->IsFull())
+			{
+				CCullTreeNode *pChild = pNode->GetCullTreeChild(nChild++);
+				Assert(pChild != NULL);
 
-			if (pChild != NULL)
+				if ((pChild != NULL) && ((pChild->GetChildCount() != 0) || (pChild->GetObjectCount() != 0)))
+				{
+					Vector vecMins;
+					Vector vecMaxs;
+					pChild->GetBounds(vecMins, vecMaxs);
+					pBatch->AddBox(vecMins.Base(), vecMaxs.Base(), pChild);
+				}
+			}
+
+			int nBatchCount = pBatch->Count();
+			if (bForce)
 			{
-				//
-				// Only bother checking nodes with children or objects.
-				//
-				if ((pChild->GetChildCount() != 0) || (pChild->GetObjectCount() != 0))
+				for (int i = 0; i < nBatchCount; i++)
 				{
-					bool bForceThisChild = bForce;
-					Visibility_t eVis = VIS_NONE;
+					RenderNode((CCullTreeNode *)pBatch->GetBoxObject(i), true);
+				}
+				continue;
+			}
 
-					if (!bForceThisChild)
-					{
-						Vector vecMins;
-						Vector vecMaxs;
-						pChild->GetBounds(vecMins, vecMaxs);
-						eVis = IsBoxVisible(vecMins, vecMaxs);
-						if (eVis == VIS_TOTAL )
-						{
-							bForceThisChild = true;
-						}
-					}
+			uint64 nVisibleMask;
+			uint64 nTotalMask;
+			AreBoxesVisible(*pBatch, nVisibleMask, nTotalMask);
 
-					if ((bForceThisChild) || (eVis != VIS_NONE))
-					{
-						RenderNode(pChild, bForceThisChild);
-					}
+			for (int i = 0; i < nBatchCount; i++)
+			{
+				uint64 nBit = (uint64)1 << i;
+				if (nVisibleMask & nBit)
+				{
+					RenderNode((CCullTreeNode *)pBatch->GetBoxObject(i), (nTotalMask & nBit) != 0);
 				}
 			}
 		}
@@ -3322,22 +3350,38 @@ void CRender3D::RenderNode(CCullTreeNode *pNode, bool bForce )
 		//
 		// Now render the contents of this node.
 		//
-		CMapClass *pObject;
 		int nObjects = pNode->GetObjectCount();
-		for (int nObject = 0; nObject < nObjects; nObject++)
+		for (int nFirst = 0; nFirst < nObjects; nFirst += FRUSTUMCULL_BATCH_SIZE)
 		{
-			pObject = pNode->GetCullTreeObject(nObject);
-			Assert(pObject != NULL);
+			int nBatchCount = min(nObjects - nFirst, FRUSTUMCULL_BATCH_SIZE);
+
+			pBatch->Reset();
+			for (int i = 0; i < nBatchCount; i++)
+			{
+				CMapClass *pObject = pNode->GetCullTreeObject(nFirst + i);
+				Assert(pObject != NULL);
+
+				Vector vecMins;
+				Vector vecMaxs;
+				pObject->GetCullBox(vecMins, vecMaxs);
+				pBatch->AddBox(vecMins.Base(), vecMaxs.Base());
+			}
+
+			uint64 nVisibleMask;
+			uint64 nTotalMask;
+			AreBoxesVisible(*pBatch, nVisibleMask, nTotalMask);
 
-			Vector vecMins;
-			Vector vecMaxs;
-			pObject->GetCullBox(vecMins, vecMaxs);
-			if (IsBoxVisible(vecMins, vecMaxs) != VIS_NONE)
+			for (int i = 0; i < nBatchCount; i++)
 			{
-				RenderMapClass(pObject);
+				if (nVisibleMask & ((uint64)1 << i))
+				{
+					RenderMapClass(pNode->GetCullTreeObject(nFirst + i));
+				}
 			}
 		}
 	}
+
+	m_CullBatches.Pop();
 }
 
 void CRender3D::RenderCrossHair()
@@ -3504,6 +3548,8 @@ void CRender3D::RenderTree( CMapWorld *pWorld )
 
 		if (eVis != VIS_NONE)
 		{
+			// One zone for the whole traversal rather than one per node.
+			EDITOR_PROFILE_SCOPE( "CRender3D::RenderNode" );
 			RenderNode(pTree, eVis == VIS_TOTAL);
 		}
 	}
@@ -15,6 +15,7 @@
 #include "mapclass.h"
 #include "lpreview_thread.h"
 #include "shaderapi/ishaderapi.h"
+#include "FrustumCull.h"
 #ifdef SLE
 #include "vstdlib\random.h"
 #endif
@@ -267,6 +268,7 @@ protected:
 	// Utility functions.
 	void Preload(CMapClass *pParent);
 	Visibility_t IsBoxVisible(Vector const &BoxMins, Vector const &BoxMaxs);
+	void AreBoxesVisible(CFrustumCullBatch const &Batch, uint64 &nVisibleMask, uint64 &nTotalMask);
 
 	// Frustum methods
 	void ComputeFrustumRenderGeometry(CCamera * pCamera);
@@ -290,6 +292,7 @@ protected:
 #endif
 
 	Vector4D m_FrustumPlanes[6];		// Plane normals and constants for the current view frustum.
+	CFrustumCullBatchStack m_CullBatches;	// One cull batch per level of RenderNode/RenderMapClass recursion.
 	
 	MatWinData_t m_WinData;				// Defines our render window parameters.
 	PickInfo_t m_Pick;					// Contains information used when rendering in pick mode.
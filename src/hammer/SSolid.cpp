@@ -14,18 +14,79 @@
 
 #include "stdafx.h"
 #include "BrushOps.h"
-#include "GameConfig.h"
+#include "gameconfig.h"
 #include "MapSolid.h"
 #include "MapWorld.h"
 #include "SSolid.h"
 #include "StockSolids.h"
 #include "Options.h"
-#include "WorldSize.h"
-#include "mapdisp.h"
+#include "worldsize.h"
+#include "MapDisp.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
 
+#define VERTEX_CELL_SIZE	1.0f	// Size of the grid cells vertices are hashed by.
+#define VERTEX_CELL_PAD		0.01f	// Slack added to vertex queries against rounding.
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the vertex grid cell along one axis. Cells are centered on
+//			multiples of VERTEX_CELL_SIZE so that vertices on the grid sit in
+//			the middle of one.
+//-----------------------------------------------------------------------------
+static inline int GetVertexCell(float f)
+{
+	return (int)floor(f / VERTEX_CELL_SIZE + 0.5f);
+}
+
+static inline unsigned int HashVertexCell(int x, int y, int z)
+{
+	return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+}
+
+static inline unsigned int HashVertexCell(const Vector &pos)
+{
+	return HashVertexCell(GetVertexCell(pos[0]), GetVertexCell(pos[1]), GetVertexCell(pos[2]));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Hashes an edge by its vertices, in either order.
+//-----------------------------------------------------------------------------
+static inline unsigned int HashEdgeVertices(SSHANDLE v1, SSHANDLE v2)
+{
+	if (v1 > v2)
+	{
+		SSHANDLE tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+	}
+
+	return ((unsigned int)v1 * 2654435761u) ^ (unsigned int)v2;
+}
+
+static inline BOOL IsSameEdge(const CSSEdge &edge, SSHANDLE v1, SSHANDLE v2)
+{
+	return (edge.hvStart == v1 && edge.hvEnd == v2) ||
+		(edge.hvStart == v2 && edge.hvEnd == v1);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns whether the vertex lies within fLeniency of the point.
+//-----------------------------------------------------------------------------
+static inline BOOL IsVertexNear(const Vector &Vertex, const Vector &Point, float fLeniency)
+{
+	float fDiff = 0.0f;
+	for(int j = 0; j < 3; j++)
+	{
+		fDiff += (Point[j] - Vertex[j]) * (Point[j] - Vertex[j]);
+	}
+
+	if (fDiff > (fLeniency*fLeniency))
+		return FALSE;
+
+	return TRUE;
+}
+
 BOOL CheckFace(Vector *Points, int nPoints, Vector* pNormal, float dist, CCheckFaceInfo *pInfo)
 {
 	int		 j;
@@ -145,6 +206,12 @@ CSSolid::CSSolid()
 	m_pMapSolid = NULL;
 	m_bShowVertices = TRUE;
 	m_bShowEdges = TRUE;
+
+	m_nIndexedVertexHandles = 0;
+	m_nIndexedEdgeHandles = 0;
+	m_nIndexedFaceHandles = 0;
+	m_nIndexedEdges = 0;
+	m_nIndexedVertices = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -170,68 +237,185 @@ PVOID CSSolid::GetHandleData(SSHANDLE id)
 
 BOOL CSSolid::GetHandleInfo(SSHANDLEINFO *pInfo, SSHANDLE id)
 {
-	// try vertices .. 
-	for(int i = 0; i < m_nVertices; i++)
+	UpdateHandleIndex();
+
+	UtlHashHandle_t h = m_HandleIndex.Find(id);
+	if(h != m_HandleIndex.InvalidHandle())
 	{
-		if(m_Vertices[i].id != id)
-			continue;	// not this one
+		int i = m_HandleIndex[h].m_iIndex;
 
-		pInfo->Type = shtVertex;
-		pInfo->iIndex = i;
-		pInfo->pData = PVOID(& m_Vertices[i]);
-		pInfo->p2DHandle = & m_Vertices[i];
-		pInfo->pos = m_Vertices[i].pos;
+		switch(m_HandleIndex[h].m_Type)
+		{
+		case shtVertex:
+			pInfo->Type = shtVertex;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID(& m_Vertices[i]);
+			pInfo->p2DHandle = & m_Vertices[i];
+			pInfo->pos = m_Vertices[i].pos;
+			return TRUE;
+
+		case shtEdge:
+			pInfo->Type = shtEdge;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID(& m_Edges[i]);
+			pInfo->p2DHandle = & m_Edges[i];
+			pInfo->pos = m_Edges[i].ptCenter;
+			return TRUE;
+
+		case shtFace:
+			pInfo->Type = shtFace;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID(& m_Faces[i]);
+			pInfo->p2DHandle = & m_Faces[i];
+			pInfo->pos = m_Faces[i].ptCenter;
+			return TRUE;
+		}
+	}
+
+	pInfo->Type = shtNothing;
+	return FALSE;
+}
 
-		return TRUE;
+//-----------------------------------------------------------------------------
+// Purpose: Adds the parts appended since the last call to the id lookup.
+//-----------------------------------------------------------------------------
+void CSSolid::UpdateHandleIndex()
+{
+	// The part arrays were emptied without going through the delete functions.
+	if (m_nIndexedVertexHandles > m_nVertices || m_nIndexedEdgeHandles > m_nEdges || m_nIndexedFaceHandles > m_nFaces)
+	{
+		InvalidateHandleIndex();
 	}
 
-	// try edges .. 
-	for(int i = 0; i < m_nEdges; i++)
+	HandleIndex_t index;
+
+	index.m_Type = shtVertex;
+	for (int i = m_nIndexedVertexHandles; i < m_nVertices; i++)
 	{
-		if(m_Edges[i].id != id)
-			continue;	// not this one
+		index.m_iIndex = i;
+		m_HandleIndex.Insert(m_Vertices[i].id, index);
+	}
+	m_nIndexedVertexHandles = m_nVertices;
 
-		pInfo->Type = shtEdge;
-		pInfo->iIndex = i;
-		pInfo->pData = PVOID(& m_Edges[i]);
-		pInfo->p2DHandle = & m_Edges[i];
-		pInfo->pos = m_Edges[i].ptCenter;
+	index.m_Type = shtEdge;
+	for (int i = m_nIndexedEdgeHandles; i < m_nEdges; i++)
+	{
+		index.m_iIndex = i;
+		m_HandleIndex.Insert(m_Edges[i].id, index);
+	}
+	m_nIndexedEdgeHandles = m_nEdges;
 
-		return TRUE;
+	index.m_Type = shtFace;
+	for (int i = m_nIndexedFaceHandles; i < m_nFaces; i++)
+	{
+		index.m_iIndex = i;
+		m_HandleIndex.Insert(m_Faces[i].id, index);
 	}
+	m_nIndexedFaceHandles = m_nFaces;
+}
 
-	// try faces ..
-	for(int i = 0; i < m_nFaces; i++)
+//-----------------------------------------------------------------------------
+// Purpose: Adds the edges appended since the last call to the vertex pair
+//			lookup.
+//-----------------------------------------------------------------------------
+void CSSolid::UpdateEdgeIndex()
+{
+	if (m_nIndexedEdges > m_nEdges)
 	{
-		if(m_Faces[i].id != id)
-			continue;	// not this one
+		InvalidateEdgeIndex();
+	}
 
-		pInfo->Type = shtFace;
-		pInfo->iIndex = i;
-		pInfo->pData = PVOID(& m_Faces[i]);
-		pInfo->p2DHandle = & m_Faces[i];
-		pInfo->pos = m_Faces[i].ptCenter;
+	m_EdgeNext.SetCount(m_nEdges);
 
-		return TRUE;
+	for (int i = m_nIndexedEdges; i < m_nEdges; i++)
+	{
+		unsigned int nHash = HashEdgeVertices(m_Edges[i].hvStart, m_Edges[i].hvEnd);
+		UtlHashHandle_t h = m_EdgeHeads.Find(nHash);
+		if (h == m_EdgeHeads.InvalidHandle())
+		{
+			m_EdgeNext[i] = -1;
+			m_EdgeHeads.Insert(nHash, i);
+		}
+		else
+		{
+			m_EdgeNext[i] = m_EdgeHeads[h];
+			m_EdgeHeads[h] = i;
+		}
 	}
 
-	pInfo->Type = shtNothing;
-	return FALSE;
+	m_nIndexedEdges = m_nEdges;
 }
 
-// Find data functions ->
-int CSSolid::GetEdgeIndex(SSHANDLE v1, SSHANDLE v2)
+//-----------------------------------------------------------------------------
+// Purpose: Adds the vertices appended since the last call to the spatial hash.
+//-----------------------------------------------------------------------------
+void CSSolid::UpdateVertexIndex()
 {
-	for(int i = 0; i < m_nEdges; i++)
+	if (m_nIndexedVertices > m_nVertices)
+	{
+		InvalidateVertexIndex();
+	}
+
+	m_VertexCellNext.SetCount(m_nVertices);
+
+	for (int i = m_nIndexedVertices; i < m_nVertices; i++)
 	{
-		CSSEdge & theEdge = m_Edges[i];
-		if((theEdge.hvStart == v1 && theEdge.hvEnd == v2) ||
-			(theEdge.hvStart == v2 && theEdge.hvEnd == v1))
+		unsigned int nHash = HashVertexCell(m_Vertices[i].pos);
+		UtlHashHandle_t h = m_VertexCellHeads.Find(nHash);
+		if (h == m_VertexCellHeads.InvalidHandle())
 		{
-			return i;
+			m_VertexCellNext[i] = -1;
+			m_VertexCellHeads.Insert(nHash, i);
+		}
+		else
+		{
+			m_VertexCellNext[i] = m_VertexCellHeads[h];
+			m_VertexCellHeads[h] = i;
 		}
 	}
-	return -1;
+
+	m_nIndexedVertices = m_nVertices;
+}
+
+void CSSolid::InvalidateHandleIndex()
+{
+	m_HandleIndex.RemoveAll();
+	m_nIndexedVertexHandles = 0;
+	m_nIndexedEdgeHandles = 0;
+	m_nIndexedFaceHandles = 0;
+}
+
+void CSSolid::InvalidateEdgeIndex()
+{
+	m_EdgeHeads.RemoveAll();
+	m_EdgeNext.RemoveAll();
+	m_nIndexedEdges = 0;
+}
+
+void CSSolid::InvalidateVertexIndex()
+{
+	m_VertexCellHeads.RemoveAll();
+	m_VertexCellNext.RemoveAll();
+	m_nIndexedVertices = 0;
+}
+
+// Find data functions ->
+int CSSolid::GetEdgeIndex(SSHANDLE v1, SSHANDLE v2)
+{
+	UpdateEdgeIndex();
+
+	UtlHashHandle_t h = m_EdgeHeads.Find(HashEdgeVertices(v1, v2));
+	if(h == m_EdgeHeads.InvalidHandle())
+		return -1;
+
+	// the chain runs from the highest index down; keep the lowest match
+	int iFound = -1;
+	for(int i = m_EdgeHeads[h]; i != -1; i = m_EdgeNext[i])
+	{
+		if(IsSameEdge(m_Edges[i], v1, v2))
+			iFound = i;
+	}
+	return iFound;
 }
 
 //-----------------------------------------------------------------------------
@@ -265,27 +449,55 @@ int CSSolid::GetEdgeIndex(const Vector &Point, float fLeniency)
 	return -1;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Finds the lowest indexed vertex within fLeniency of the point.
+//-----------------------------------------------------------------------------
 int CSSolid::GetVertexIndex(const Vector &Point, float fLeniency)
 {
-	for(int i = 0; i < m_nVertices; i++)
+	// a wide search covers too many cells to be worth hashing
+	if (fLeniency > VERTEX_CELL_SIZE)
 	{
-		Vector Vertex = m_Vertices[i].pos;
-
-		float fDiff = 0.0f;
-		for(int j = 0; j < 3; j++)
+		for(int i = 0; i < m_nVertices; i++)
 		{
-			fDiff += (Point[j] - Vertex[j]) * (Point[j] - Vertex[j]);
+			if (IsVertexNear(m_Vertices[i].pos, Point, fLeniency))
+				return i;
 		}
 
-		if (fDiff > (fLeniency*fLeniency))
-			continue;
-			
-		// if we are here, the 3 axes compare ok.
-		return i;
+		// no vertex matches.
+		return -1;
 	}
 
-	// no vertex matches.
-	return -1;
+	UpdateVertexIndex();
+
+	float fReach = fLeniency + VERTEX_CELL_PAD;
+	int nMins[3], nMaxs[3];
+	for(int j = 0; j < 3; j++)
+	{
+		nMins[j] = GetVertexCell(Point[j] - fReach);
+		nMaxs[j] = GetVertexCell(Point[j] + fReach);
+	}
+
+	int iFound = -1;
+	for(int x = nMins[0]; x <= nMaxs[0]; x++)
+	{
+		for(int y = nMins[1]; y <= nMaxs[1]; y++)
+		{
+			for(int z = nMins[2]; z <= nMaxs[2]; z++)
+			{
+				UtlHashHandle_t h = m_VertexCellHeads.Find(HashVertexCell(x, y, z));
+				if (h == m_VertexCellHeads.InvalidHandle())
+					continue;
+
+				for(int i = m_VertexCellHeads[h]; i != -1; i = m_VertexCellNext[i])
+				{
+					if ((iFound == -1 || i < iFound) && IsVertexNear(m_Vertices[i].pos, Point, fLeniency))
+						iFound = i;
+				}
+			}
+		}
+	}
+
+	return iFound;
 }
 
 int CSSolid::GetFaceIndex(const Vector &Point, float fLeniency)
@@ -652,6 +864,10 @@ void CSSolid::FromMapSolid(CMapSolid *p, bool bSkipDisplacementFaces)
 	m_nEdges = 0;
 	m_nVertices = 0;
 
+	InvalidateHandleIndex();
+	InvalidateEdgeIndex();
+	InvalidateVertexIndex();
+
 	// Create vertices, edges, faces.
 	int nSolidFaces = pSolid->GetFaceCount();
 	for(int i = 0; i < nSolidFaces; i++)
@@ -874,11 +1090,13 @@ void CSSolid::CheckFaces()
 void CSSolid::SetVertexPosition(int iVertex, float x, float y, float z)
 {
 	m_Vertices[iVertex].pos = Vector(x, y, z);
+	InvalidateVertexIndex();
 }
 #ifdef SLE //// convenient override
 void CSSolid::SetVertexPosition(int iVertex, Vector pos)
 {
 	m_Vertices[iVertex].pos = pos;
+	InvalidateVertexIndex();
 }
 #endif
 static int GetNext(int iIndex, int iDirection, int iMax)
@@ -1017,7 +1235,7 @@ DoNextFace:
 
 		hNewEdges[nNewEdges++] = m_Edges[iEdgeIndex].id;
 
-		AssignFace(&m_Edges[iEdgeIndex], pFace->id);
+		AssignFace(&m_Edges[iEdgeIndex], pStoreFace->id);
 	}
 	// now add the middle edge
 	hNewEdges[nNewEdges++] = pNewEdge->id;
@@ -1035,7 +1253,7 @@ DoNextFace:
 		goto DoNextFace;
 	}
 
-	delete phVertexList;
+	delete[] phVertexList;
 
 	return(TRUE);
 }
@@ -1176,7 +1394,7 @@ DoNextFace:
 		goto DoNextFace;
 	}
 
-	delete phVertexList;
+	delete[] phVertexList;
 
 	// ** now regular faces **
 	for(int iFace = 0; iFace < m_nFaces; iFace++)
@@ -1212,7 +1430,7 @@ DoNextFace:
 		pUpdFace->nEdges = nNewEdges;
 		memcpy(pUpdFace->Edges, hNewEdges, sizeof(SSHANDLE) * nNewEdges);
 
-		delete phVertexList;
+		delete[] phVertexList;
 	}
 
 	SSHANDLE id1 = pEdge1->id;
@@ -1244,6 +1462,9 @@ void CSSolid::DeleteEdge(int iEdge)
 
 	memset(&m_Edges[m_nEdges], 0, sizeof(CSSEdge));
 
+	InvalidateHandleIndex();
+	InvalidateEdgeIndex();
+
 	// kill all references to this edge in faces
 	for(int f = 0; f < m_nFaces; f++)
 	{
@@ -1253,7 +1474,7 @@ void CSSolid::DeleteEdge(int iEdge)
 			if(face.Edges[e] != edgeid)
 				continue;
 
-			memcpy(&face.Edges[e], &face.Edges[e+1], (face.nEdges-e) * 
+			memmove(&face.Edges[e], &face.Edges[e+1], (face.nEdges-e) * 
 				sizeof(face.Edges[0]));
 			--face.nEdges;
 			break;	// no more in this face
@@ -1270,6 +1491,9 @@ void CSSolid::DeleteVertex(int iVertex)
 	--m_nVertices;
 
 	memset(&m_Vertices[m_nVertices], 0, sizeof(CSSVertex));
+
+	InvalidateHandleIndex();
+	InvalidateVertexIndex();
 }
 
 void CSSolid::DeleteFace(int iFace)
@@ -1292,6 +1516,8 @@ void CSSolid::DeleteFace(int iFace)
 	--m_nFaces;
 
 	m_Faces[m_nFaces].Init();
+
+	InvalidateHandleIndex();
 }
 
 SSHANDLE* CSSolid::CreateNewVertexList(CSSFace *pFace, CSSEdge *pEdge1, 
@@ -1384,70 +1610,147 @@ DoAgain:
 	return rvl;
 }
 
-// merge same vertices ->
-BOOL CSSolid::CanMergeVertices()
+//-----------------------------------------------------------------------------
+// Purpose: Finds the vertices that share their position with a later vertex.
+// Input  : NextSame - Receives, per vertex, the lowest later vertex at the
+//			same position, or -1.
+// Output : Returns the number of vertices that have one.
+//-----------------------------------------------------------------------------
+int CSSolid::FindSameVertices(CUtlVector<int> &NextSame)
 {
-	for(int v1 = 0; v1 < m_nVertices; v1++)
+	UpdateVertexIndex();
+
+	NextSame.SetCount(m_nVertices);
+
+	int nSame = 0;
+	for(int v = 0; v < m_nVertices; v++)
 	{
-		for(int v2 = 0; v2 < m_nVertices; v2++)
+		NextSame[v] = -1;
+
+		const Vector &pos = m_Vertices[v].pos;
+		UtlHashHandle_t h = m_VertexCellHeads.Find(HashVertexCell(pos));
+		Assert(h != m_VertexCellHeads.InvalidHandle());
+
+		// the chain runs from the highest index down, so the last later
+		// vertex that matches is the lowest one.
+		for(int v2 = m_VertexCellHeads[h]; v2 > v; v2 = m_VertexCellNext[v2])
 		{
-			if(v1 == v2)
-				continue;	// no!
-			if(VectorCompare(m_Vertices[v1].pos, m_Vertices[v2].pos))
-				return TRUE;	// got a match
+			if(VectorCompare(pos, m_Vertices[v2].pos))
+				NextSame[v] = v2;
 		}
+
+		if(NextSame[v] != -1)
+			++nSame;
 	}
 
-	return FALSE;
+	return nSame;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Finds the edges that join the same two vertices as a later edge.
+// Input  : NextSame - Receives, per edge, the lowest later edge between the
+//			same vertices, or -1.
+// Output : Returns the number of edges that have one.
+//-----------------------------------------------------------------------------
+int CSSolid::FindSameEdges(CUtlVector<int> &NextSame)
+{
+	UpdateEdgeIndex();
+
+	NextSame.SetCount(m_nEdges);
+
+	int nSame = 0;
+	for(int e = 0; e < m_nEdges; e++)
+	{
+		NextSame[e] = -1;
+
+		const CSSEdge &edge = m_Edges[e];
+		UtlHashHandle_t h = m_EdgeHeads.Find(HashEdgeVertices(edge.hvStart, edge.hvEnd));
+		Assert(h != m_EdgeHeads.InvalidHandle());
+
+		for(int e2 = m_EdgeHeads[h]; e2 > e; e2 = m_EdgeNext[e2])
+		{
+			if(IsSameEdge(m_Edges[e2], edge.hvStart, edge.hvEnd))
+				NextSame[e] = e2;
+		}
+
+		if(NextSame[e] != -1)
+			++nSame;
+	}
+
+	return nSame;
+}
+
+// merge same vertices ->
+BOOL CSSolid::CanMergeVertices()
+{
+	CUtlVector<int> NextSame;
+	return FindSameVertices(NextSame) != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Merges vertices at the same position, then removes the edges and
+//			faces that collapse as a result.
+// Output : Returns the ids of every deleted part, or NULL if no vertices
+//			were merged.
+//-----------------------------------------------------------------------------
 SSHANDLE * CSSolid::MergeSameVertices(int& nDeleted)
 {
-	int nMerged = 0;
 	nDeleted = 0;
 	static SSHANDLE hDeletedList[128];
 
-DoVertices:
-	for(int v1 = 0; v1 < m_nVertices; v1++)
+	CUtlVector<int> NextSame;
+	if(!FindSameVertices(NextSame))
+		return NULL;
+
+	// Every vertex sharing its position with a later one goes, and its edges
+	// move to the last vertex at that position. This is what merging the
+	// lowest matching pair, one pair at a time, ends up with.
+	CUtlHashtable<SSHANDLE, SSHANDLE> MergedInto;
+	int nKept = 0;
+	for(int v = 0; v < m_nVertices; v++)
 	{
-		for(int v2 = 0; v2 < m_nVertices; v2++)
+		if(NextSame[v] == -1)
 		{
-			if(v1 == v2)
-				continue;	// no!
-			if(!VectorCompare(m_Vertices[v1].pos, m_Vertices[v2].pos))
-			{	// no match
-				continue;
-			}
+			if(nKept != v)
+				memcpy(&m_Vertices[nKept], &m_Vertices[v], sizeof(CSSVertex));
+			++nKept;
+			continue;
+		}
 
-			++nMerged;
+		int vLast = v;
+		while(NextSame[vLast] != -1)
+			vLast = NextSame[vLast];
 
-			// same vertices - kill v1, set edge refs to use v2.
-			SSHANDLE hV1 = m_Vertices[v1].id;
-			SSHANDLE hV2 = m_Vertices[v2].id;
-			
-			hDeletedList[nDeleted++] = hV1;
-			
-			DeleteVertex(v1);
+		hDeletedList[nDeleted++] = m_Vertices[v].id;
+		MergedInto.Insert(m_Vertices[v].id, m_Vertices[vLast].id);
+	}
+
+	for(int v = nKept; v < m_nVertices; v++)
+	{
+		memset(&m_Vertices[v], 0, sizeof(CSSVertex));
+	}
+	m_nVertices = nKept;
 
-			int nAffected;
-			CSSEdge **ppEdges = FindAffectedEdges(&hV1, 1, nAffected);
+	InvalidateHandleIndex();
+	InvalidateVertexIndex();
 
-			// run through edges and change references
-			for(int e = 0; e < nAffected; e++)
-			{
-				if(ppEdges[e]->hvStart == hV1)
-					ppEdges[e]->hvStart = hV2;
-				if(ppEdges[e]->hvEnd == hV1)
-					ppEdges[e]->hvEnd = hV2;
-				CalcEdgeCenter(ppEdges[e]);
-			}
-			
-			goto DoVertices;
-		}
+	// run through edges and change references
+	for(int e = 0; e < m_nEdges; e++)
+	{
+		CSSEdge &edge = m_Edges[e];
+		UtlHashHandle_t hStart = MergedInto.Find(edge.hvStart);
+		UtlHashHandle_t hEnd = MergedInto.Find(edge.hvEnd);
+		if(hStart == MergedInto.InvalidHandle() && hEnd == MergedInto.InvalidHandle())
+			continue;
+
+		if(hStart != MergedInto.InvalidHandle())
+			edge.hvStart = MergedInto[hStart];
+		if(hEnd != MergedInto.InvalidHandle())
+			edge.hvEnd = MergedInto[hEnd];
+		CalcEdgeCenter(&edge);
 	}
 
-	if(!nMerged)
-		return NULL;
+	InvalidateEdgeIndex();
 
 	int e;
 
@@ -1465,45 +1768,60 @@ DoVertices:
 		--e;
 	}
 
-	// kill similar edges (replace in faces too)
-DoEdges:
+	// kill similar edges (replace in faces too); each edge between the
+	// same two vertices as an earlier one is folded into the first.
+	CUtlVector<int> NextSameEdge;
+	FindSameEdges(NextSameEdge);
+
+	CUtlVector<bool> IsLaterSameEdge;
+	IsLaterSameEdge.SetCount(m_nEdges);
 	for(e = 0; e < m_nEdges; e++)
 	{
-		CSSEdge &edge = m_Edges[e];
-
-		for(int e2 = 0; e2 < m_nEdges; e2++)
-		{
-			if(e == e2)
-				continue;
+		IsLaterSameEdge[e] = false;
+	}
+	for(e = 0; e < m_nEdges; e++)
+	{
+		if(NextSameEdge[e] != -1)
+			IsLaterSameEdge[NextSameEdge[e]] = true;
+	}
 
-			CSSEdge &edge2 = m_Edges[e2];
+	CUtlVector<SSHANDLE> FoldFrom, FoldInto;
+	for(e = 0; e < m_nEdges; e++)
+	{
+		if(IsLaterSameEdge[e])
+			continue;
 
-			if(!((edge2.hvStart == edge.hvStart && edge2.hvEnd == edge.hvEnd) || 
-				(edge2.hvEnd == edge.hvStart && edge2.hvStart == edge.hvEnd)))
-				continue;
+		for(int e2 = NextSameEdge[e]; e2 != -1; e2 = NextSameEdge[e2])
+		{
+			FoldFrom.AddToTail(m_Edges[e2].id);
+			FoldInto.AddToTail(m_Edges[e].id);
+		}
+	}
 
-			// we're going to delete edge2.
-			SSHANDLE id2 = edge2.id;
-			SSHANDLE id1 = edge.id;
+	for(int i = 0; i < FoldFrom.Count(); i++)
+	{
+		// we're going to delete edge2.
+		SSHANDLE id2 = FoldFrom[i];
+		SSHANDLE id1 = FoldInto[i];
 
-			for(int f = 0; f < m_nFaces; f++)
+		for(int f = 0; f < m_nFaces; f++)
+		{
+			CSSFace& face = m_Faces[f];
+			for(int ef = 0; ef < face.nEdges; ef++)
 			{
-				CSSFace& face = m_Faces[f];
-				for(int ef = 0; ef < face.nEdges; ef++)
+				if(face.Edges[ef] == id2)
 				{
-					if(face.Edges[ef] == id2)
-					{
-						face.Edges[ef] = id1;
-						break;
-					}
+					face.Edges[ef] = id1;
+					break;
 				}
 			}
+		}
 
-			hDeletedList[nDeleted++] = id2;
-			DeleteEdge(e2);
+		hDeletedList[nDeleted++] = id2;
 
-			goto DoEdges;
-		}
+		SSHANDLEINFO hi;
+		VERIFY(GetHandleInfo(&hi, id2));
+		DeleteEdge(hi.iIndex);
 	}
 
 	// delete concurrent edge references in face
@@ -1523,7 +1841,7 @@ DoConcurrentEdges:
 					continue;
 			
 				// delete this ref
-				memcpy(&face.Edges[ef2], &face.Edges[ef2+1], (face.nEdges-ef2) * 
+				memmove(&face.Edges[ef2], &face.Edges[ef2+1], (face.nEdges-ef2) * 
 					sizeof(face.Edges[0]));
 				--face.nEdges;
 
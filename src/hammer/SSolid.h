@@ -16,6 +16,8 @@
 #endif
 
 #include "MapFace.h"
+#include "tier1/utlvector.h"
+#include "tier1/utlhashtable.h"
 
 #define MAX_FACES 120
 #define MAX_EDGES 512
@@ -215,6 +217,16 @@ class CSSolid
 										   CSSVertex *pNewVertex1, CSSVertex *pNewVertex2);
 		void ShowHandles(BOOL bShowVertices, BOOL bShowEdges);
 
+		// lookup tables over the arrays below:
+		void UpdateHandleIndex();
+		void UpdateEdgeIndex();
+		void UpdateVertexIndex();
+		void InvalidateHandleIndex();
+		void InvalidateEdgeIndex();
+		void InvalidateVertexIndex();
+		int FindSameVertices(CUtlVector<int> &NextSame);
+		int FindSameEdges(CUtlVector<int> &NextSame);
+
 		int m_nVertices;	// number of unique vertices
 		BlockArray<CSSVertex, 16, 32> m_Vertices;	// vertices
 
@@ -226,6 +238,36 @@ class CSSolid
 
 		SSHANDLE m_curid;
 		BOOL m_bShowVertices, m_bShowEdges;
+
+		//
+		// Lookup tables, so finding a part costs a hash probe instead of a scan.
+		// Parts appended since a table was last used are added to it on its
+		// next use, so a new part's id, vertices or position must be set before
+		// the next lookup. Moving, rewiring or deleting parts invalidates the
+		// tables involved, and they are rebuilt on their next use.
+		//
+		struct HandleIndex_t
+		{
+			SSHANDLETYPE m_Type;
+			int m_iIndex;
+		};
+
+		CUtlHashtable<SSHANDLE, HandleIndex_t> m_HandleIndex;	// Part id -> type and index.
+		int m_nIndexedVertexHandles;
+		int m_nIndexedEdgeHandles;
+		int m_nIndexedFaceHandles;
+
+		// Edges chained by a hash of their two vertex ids. Chains run from the
+		// highest edge index down.
+		CUtlHashtable<unsigned int, int> m_EdgeHeads;
+		CUtlVector<int> m_EdgeNext;			// Next lower edge with the same hash, or -1.
+		int m_nIndexedEdges;
+
+		// Vertices chained by the grid cell they lie in. Chains run from the
+		// highest vertex index down.
+		CUtlHashtable<unsigned int, int> m_VertexCellHeads;
+		CUtlVector<int> m_VertexCellNext;	// Next lower vertex with the same cell hash, or -1.
+		int m_nIndexedVertices;
 };
 
 #endif SSOLID_H
\ No newline at end of file
@@ -0,0 +1,1685 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test for the CSSolid lookup tables. Builds SSolid.cpp
+//			against stand-ins for the editor types it uses, then edits random
+//			solids the way the vertex tool does: face splits by vertices and
+//			by edges, vertex moves, and edge deletes, which move both ends to
+//			the middle and merge them. After every edit each lookup must agree
+//			with a scan of the part arrays, and merges must leave the solid
+//			exactly as the scanning merge the tables replaced does. Solids are
+//			also taken through FromMapSolid and ToMapSolid and must come back
+//			with the same faces. Then times conversion and edge deletes on a
+//			large solid against the scans:
+//
+//			g++ -O2 -I../public SSolid_test.cpp -o SSolid_test && ./SSolid_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( RandomInt( 0, 1 << 20 ) / (float)( 1 << 20 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+//
+// SSolid.cpp is built as the editor builds it, with its editor, tier0 and
+// tier1 headers kept out by their include guards and stood in for below.
+//
+#define SLE
+#define NO_MALLOC_OVERRIDE
+#define AFX_STDAFX_H__2871A74F_7D2F_4026_9DB0_DBACAFB3B7F5__INCLUDED_
+#define DBG_H
+#define TIER0_MEMALLOC_H
+#define UTLVECTOR_H
+#define UTLHASHTABLE_H
+#define MAPFACE_H
+#define MAPSOLID_H
+#define MAPWORLD_H
+#define GAMECONFIG_H
+#define STOCKSOLIDS_H
+#define OPTIONS_H
+#define MAPDISP_H
+
+#define Assert( expr )		CHECK( expr )
+#define VERIFY( expr )		CHECK( expr )
+#define ARRAYSIZE( a )		( sizeof( a ) / sizeof( ( a )[0] ) )
+#define Q_memcpy			memcpy
+#define MAX_PATH			260
+#define TRUE				1
+#define FALSE				0
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned int DWORD;
+typedef int *PINT;
+typedef void *PVOID;
+typedef const char *LPCTSTR;
+
+struct RECT
+{
+	long left, top, right, bottom;
+};
+
+static void Error( const char *pszFormat, ... )
+{
+	va_list Args;
+	va_start( Args, pszFormat );
+	printf( "FAIL: " );
+	vprintf( pszFormat, Args );
+	printf( "\n" );
+	va_end( Args );
+	g_nFailures++;
+}
+
+// The solids here are all well formed, so any message is a failure.
+static int AfxMessageBox( const char *pszText )
+{
+	printf( "FAIL: message box \"%s\"\n", pszText );
+	g_nFailures++;
+	return 0;
+}
+
+class CString
+{
+public:
+	CString( void ) { m_szText[0] = '\0'; }
+
+	void Format( const char *pszFormat, ... )
+	{
+		va_list Args;
+		va_start( Args, pszFormat );
+		vsnprintf( m_szText, sizeof( m_szText ), pszFormat, Args );
+		va_end( Args );
+	}
+
+	operator const char *( void ) const { return m_szText; }
+
+private:
+	char m_szText[256];
+};
+
+class Vector
+{
+public:
+	Vector( void ) : x( 0 ), y( 0 ), z( 0 ) {}
+	Vector( float X, float Y, float Z ) : x( X ), y( Y ), z( Z ) {}
+
+	float &operator[]( int i ) { return ( &x )[i]; }
+	float operator[]( int i ) const { return ( &x )[i]; }
+
+	Vector operator+( const Vector &v ) const { return Vector( x + v.x, y + v.y, z + v.z ); }
+	Vector operator-( const Vector &v ) const { return Vector( x - v.x, y - v.y, z - v.z ); }
+	Vector operator*( float f ) const { return Vector( x * f, y * f, z * f ); }
+
+	float x, y, z;
+};
+
+struct Vector4D
+{
+	float x, y, z, w;
+};
+
+inline void CrossProduct( const Vector &a, const Vector &b, Vector &Result )
+{
+	Result.x = a.y * b.z - a.z * b.y;
+	Result.y = a.z * b.x - a.x * b.z;
+	Result.z = a.x * b.y - a.y * b.x;
+}
+
+inline float DotProduct( const Vector &a, const Vector &b )
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline void VectorSubtract( const Vector &a, const Vector &b, Vector &Result )
+{
+	Result = a - b;
+}
+
+inline float VectorLength( const Vector &v )
+{
+	return sqrtf( DotProduct( v, v ) );
+}
+
+inline float VectorNormalize( Vector &v )
+{
+	float flLength = VectorLength( v );
+	if ( flLength != 0 )
+	{
+		v = v * ( 1.0f / flLength );
+	}
+	return flLength;
+}
+
+inline bool VectorCompare( const Vector &a, const Vector &b )
+{
+	return ( a.x == b.x ) && ( a.y == b.y ) && ( a.z == b.z );
+}
+
+//
+// Stands in for tier1's CUtlVector.
+//
+template <class T>
+class CUtlVector
+{
+public:
+	CUtlVector( void ) : m_pData( NULL ), m_nCount( 0 ), m_nCapacity( 0 ) {}
+	~CUtlVector( void ) { delete [] m_pData; }
+
+	int Count( void ) const { return m_nCount; }
+	T &operator[]( int i ) { Assert( ( i >= 0 ) && ( i < m_nCount ) ); return m_pData[i]; }
+	T *Base( void ) { return m_pData; }
+
+	void SetCount( int nCount ) { Reserve( nCount ); m_nCount = nCount; }
+	void RemoveAll( void ) { m_nCount = 0; }
+	int AddToTail( const T &Src ) { return InsertBefore( m_nCount, Src ); }
+
+	int InsertBefore( int iElem, const T &Src )
+	{
+		Reserve( m_nCount + 1 );
+		for ( int i = m_nCount; i > iElem; i-- )
+		{
+			m_pData[i] = m_pData[i - 1];
+		}
+		m_pData[iElem] = Src;
+		m_nCount++;
+		return iElem;
+	}
+
+private:
+	void Reserve( int nNeeded )
+	{
+		if ( nNeeded <= m_nCapacity )
+			return;
+
+		int nNewCapacity = m_nCapacity ? m_nCapacity * 2 : 64;
+		while ( nNewCapacity < nNeeded )
+		{
+			nNewCapacity *= 2;
+		}
+
+		T *pNewData = new T[ nNewCapacity ];
+		for ( int i = 0; i < m_nCount; i++ )
+		{
+			pNewData[i] = m_pData[i];
+		}
+
+		delete [] m_pData;
+		m_pData = pNewData;
+		m_nCapacity = nNewCapacity;
+	}
+
+	CUtlVector( const CUtlVector & );
+	CUtlVector &operator=( const CUtlVector & );
+
+	T *m_pData;
+	int m_nCount;
+	int m_nCapacity;
+};
+
+//
+// Stands in for tier1's CUtlHashtable. Like it, Insert returns the element
+// already there rather than replacing it.
+//
+typedef unsigned int UtlHashHandle_t;
+
+template <class K, class V>
+class CUtlHashtable
+{
+public:
+	static UtlHashHandle_t InvalidHandle( void ) { return (UtlHashHandle_t)-1; }
+
+	UtlHashHandle_t Find( K Key ) const
+	{
+		typename std::unordered_map<K, UtlHashHandle_t>::const_iterator it = m_Handles.find( Key );
+		return ( it == m_Handles.end() ) ? InvalidHandle() : it->second;
+	}
+
+	UtlHashHandle_t Insert( K Key, const V &Value )
+	{
+		UtlHashHandle_t h = Find( Key );
+		if ( h != InvalidHandle() )
+			return h;
+
+		h = (UtlHashHandle_t)m_Values.size();
+		m_Values.push_back( Value );
+		m_Handles[Key] = h;
+		return h;
+	}
+
+	V &operator[]( UtlHashHandle_t h ) { return m_Values[h]; }
+
+	void RemoveAll( void )
+	{
+		m_Handles.clear();
+		m_Values.clear();
+	}
+
+private:
+	std::unordered_map<K, UtlHashHandle_t> m_Handles;
+	std::vector<V> m_Values;
+};
+
+//
+// Stand-ins for the editor types.
+//
+struct PLANE
+{
+	Vector normal;
+	float dist;
+	Vector planepts[3];
+};
+
+struct winding_t;
+
+struct TEXTURE
+{
+	char texture[MAX_PATH];
+	Vector4D UAxis;
+	Vector4D VAxis;
+	float rotate;
+	float scale[2];
+	BYTE smooth;
+	BYTE material;
+	DWORD q2surface;
+	DWORD q2contents;
+	int nLightmapScale;
+};
+
+class CCheckFaceInfo
+{
+public:
+
+	CCheckFaceInfo() { iPoint = -1; }
+	char szDescription[128];
+	int iPoint;
+};
+
+#define COPY_FACE_POINTS		0x00000002
+#define INIT_TEXTURE_FORCE		0x0001
+#define INIT_TEXTURE_AXES		0x0002
+
+enum
+{
+	Notify_Changed = 0,
+};
+
+class CMapFace;
+class CMapSolid;
+
+typedef unsigned short EditDispHandle_t;
+enum
+{
+	EDITDISPHANDLE_INVALID = ( EditDispHandle_t )~0
+};
+
+class CMapDisp
+{
+public:
+	void CopyFrom( CMapDisp *, bool ) {}
+	int GetSurfPointStartIndex( void ) { return 0; }
+	void SetSurfPointStartIndex( int ) {}
+	void InitDispSurfaceData( CMapFace *, bool ) {}
+	void Create( void ) {}
+};
+
+// None of the faces here have displacements.
+class CEditDispMgr
+{
+public:
+	EditDispHandle_t Create( void ) { Error( "displacement created" ); return EDITDISPHANDLE_INVALID; }
+	CMapDisp *GetDisp( EditDispHandle_t ) { Error( "displacement used" ); return NULL; }
+	void Destroy( EditDispHandle_t ) { Error( "displacement destroyed" ); }
+};
+
+static CEditDispMgr s_EditDispMgr;
+
+static CEditDispMgr *EditDispMgr( void )
+{
+	return &s_EditDispMgr;
+}
+
+class CGameConfig
+{
+public:
+	float GetDefaultTextureScale( void ) { return 0.25f; }
+};
+
+static CGameConfig s_GameConfig;
+static CGameConfig *g_pGameConfig = &s_GameConfig;
+
+class COptions
+{
+public:
+	int GetTextureAlignment( void ) { return 0; }
+};
+
+static COptions Options;
+
+class CMapFace
+{
+public:
+	CMapFace( void ) : nPoints( 0 ), Points( NULL ), m_nFaceID( 0 )
+	{
+		memset( &texture, 0, sizeof( texture ) );
+		plane.dist = 0;
+	}
+
+	~CMapFace( void ) { delete [] Points; }
+
+	void SetTexture( const char * ) {}
+	void SetFaceID( int nFaceID ) { m_nFaceID = nFaceID; }
+	int GetFaceID( void ) { return m_nFaceID; }
+
+	// Keeps the points; the plane is taken from the first three.
+	void CreateFace( Vector *pPoints, int nNewPoints )
+	{
+		delete [] Points;
+		Points = new Vector[ nNewPoints ];
+		memcpy( Points, pPoints, sizeof( Vector ) * nNewPoints );
+		nPoints = nNewPoints;
+
+		for ( int i = 0; i < 3; i++ )
+		{
+			plane.planepts[i] = Points[i % nPoints];
+		}
+	}
+
+	bool IsTextureAxisValid( void ) { return true; }
+	void InitializeTextureAxes( int, DWORD ) {}
+
+	bool HasDisp( void ) { return false; }
+	EditDispHandle_t GetDisp( void ) { return EDITDISPHANDLE_INVALID; }
+	void SetDisp( EditDispHandle_t ) {}
+
+	CMapFace *CopyFrom( const CMapFace *pFrom, DWORD )
+	{
+		texture = pFrom->texture;
+		plane = pFrom->plane;
+		m_nFaceID = pFrom->m_nFaceID;
+		CreateFace( pFrom->Points, pFrom->nPoints );
+		return this;
+	}
+
+	void SetRenderColor( unsigned char, unsigned char, unsigned char ) {}
+	void SetParent( CMapSolid * ) {}
+
+	TEXTURE texture;
+	PLANE plane;
+	int nPoints;
+	Vector *Points;
+
+private:
+	CMapFace( const CMapFace & );
+	CMapFace &operator=( const CMapFace & );
+
+	int m_nFaceID;
+};
+
+class CMapSolid
+{
+public:
+	~CMapSolid( void ) { SetFaceCount( 0 ); }
+
+	void SetFaceCount( int nFaces )
+	{
+		while ( (int)m_Faces.size() > nFaces )
+		{
+			delete m_Faces.back();
+			m_Faces.pop_back();
+		}
+
+		while ( (int)m_Faces.size() < nFaces )
+		{
+			m_Faces.push_back( new CMapFace );
+		}
+	}
+
+	int GetFaceCount( void ) { return (int)m_Faces.size(); }
+	CMapFace *GetFace( int i ) { return m_Faces[i]; }
+	void GetRenderColor( unsigned char &r, unsigned char &g, unsigned char &b ) { r = g = b = 255; }
+	void PostUpdate( int ) {}
+
+private:
+	std::vector<CMapFace *> m_Faces;
+};
+
+#include "BlockArray.h"
+#include "SSolid.cpp"
+
+//
+// CSSolid lets the vertex tool see its parts; the test takes its place.
+//
+class Morph3D
+{
+public:
+
+	//-----------------------------------------------------------------------------
+	// Purpose: The lookups as SSolid.cpp made them before the tables, by
+	//			scanning the part arrays.
+	//-----------------------------------------------------------------------------
+	static BOOL ScanHandleInfo( CSSolid &Solid, SSHANDLEINFO *pInfo, SSHANDLE id )
+	{
+		for ( int i = 0; i < Solid.m_nVertices; i++ )
+		{
+			if ( Solid.m_Vertices[i].id != id )
+				continue;
+
+			pInfo->Type = shtVertex;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID( &Solid.m_Vertices[i] );
+			pInfo->p2DHandle = &Solid.m_Vertices[i];
+			pInfo->pos = Solid.m_Vertices[i].pos;
+			return TRUE;
+		}
+
+		for ( int i = 0; i < Solid.m_nEdges; i++ )
+		{
+			if ( Solid.m_Edges[i].id != id )
+				continue;
+
+			pInfo->Type = shtEdge;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID( &Solid.m_Edges[i] );
+			pInfo->p2DHandle = &Solid.m_Edges[i];
+			pInfo->pos = Solid.m_Edges[i].ptCenter;
+			return TRUE;
+		}
+
+		for ( int i = 0; i < Solid.m_nFaces; i++ )
+		{
+			if ( Solid.m_Faces[i].id != id )
+				continue;
+
+			pInfo->Type = shtFace;
+			pInfo->iIndex = i;
+			pInfo->pData = PVOID( &Solid.m_Faces[i] );
+			pInfo->p2DHandle = &Solid.m_Faces[i];
+			pInfo->pos = Solid.m_Faces[i].ptCenter;
+			return TRUE;
+		}
+
+		pInfo->Type = shtNothing;
+		return FALSE;
+	}
+
+	static int ScanEdgeIndex( CSSolid &Solid, SSHANDLE v1, SSHANDLE v2 )
+	{
+		for ( int i = 0; i < Solid.m_nEdges; i++ )
+		{
+			CSSEdge &theEdge = Solid.m_Edges[i];
+			if ( ( theEdge.hvStart == v1 && theEdge.hvEnd == v2 ) ||
+				( theEdge.hvStart == v2 && theEdge.hvEnd == v1 ) )
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	static int ScanVertexIndex( CSSolid &Solid, const Vector &Point, float fLeniency )
+	{
+		for ( int i = 0; i < Solid.m_nVertices; i++ )
+		{
+			Vector Vertex = Solid.m_Vertices[i].pos;
+
+			float fDiff = 0.0f;
+			for ( int j = 0; j < 3; j++ )
+			{
+				fDiff += ( Point[j] - Vertex[j] ) * ( Point[j] - Vertex[j] );
+			}
+
+			if ( fDiff > ( fLeniency * fLeniency ) )
+				continue;
+
+			return i;
+		}
+
+		return -1;
+	}
+
+	static BOOL ScanCanMergeVertices( CSSolid &Solid )
+	{
+		for ( int v1 = 0; v1 < Solid.m_nVertices; v1++ )
+		{
+			for ( int v2 = 0; v2 < Solid.m_nVertices; v2++ )
+			{
+				if ( v1 == v2 )
+					continue;
+				if ( VectorCompare( Solid.m_Vertices[v1].pos, Solid.m_Vertices[v2].pos ) )
+					return TRUE;
+			}
+		}
+
+		return FALSE;
+	}
+
+	static void ScanCalcEdgeCenter( CSSolid &Solid, CSSEdge *pEdge )
+	{
+		SSHANDLEINFO hi;
+
+		ScanHandleInfo( Solid, &hi, pEdge->hvStart );
+		Vector &pt1 = Solid.m_Vertices[hi.iIndex].pos;
+
+		ScanHandleInfo( Solid, &hi, pEdge->hvEnd );
+		Vector &pt2 = Solid.m_Vertices[hi.iIndex].pos;
+
+		for ( int i = 0; i < 3; i++ )
+		{
+			pEdge->ptCenter[i] = ( pt1[i] + pt2[i] ) / 2.0f;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: CSSolid::FromMapSolid as it was before the tables.
+	//-----------------------------------------------------------------------------
+	static void ScanFromMapSolid( CSSolid &Solid, CMapSolid *pSolid )
+	{
+		Solid.m_nFaces = 0;
+		Solid.m_nEdges = 0;
+		Solid.m_nVertices = 0;
+
+		int nSolidFaces = pSolid->GetFaceCount();
+		for ( int i = 0; i < nSolidFaces; i++ )
+		{
+			CMapFace *pSolidFace = pSolid->GetFace( i );
+
+			CSSFace *pFace = Solid.AddFace();
+
+			memcpy( pFace->PlanePts, pSolidFace->plane.planepts, sizeof( Vector ) * 3 );
+			pFace->texture = pSolidFace->texture;
+			pFace->normal = pSolidFace->plane.normal;
+			pFace->m_nFaceID = pSolidFace->GetFaceID();
+
+			int nFacePoints = pSolidFace->nPoints;
+			Vector *pFacePoints = pSolidFace->Points;
+			SSHANDLE hLastVertex = 0;
+			SSHANDLE hThisVertex, hFirstVertex = 0;
+			for ( int pt = 0; pt <= nFacePoints; pt++ )
+			{
+				int iVertex;
+
+				if ( pt < nFacePoints )
+				{
+					iVertex = ScanVertexIndex( Solid, pFacePoints[pt], 0.1f );
+					if ( iVertex == -1 )
+					{
+						CSSVertex *pVertex = Solid.AddVertex( &iVertex );
+						pVertex->pos = pFacePoints[pt];
+					}
+
+					hThisVertex = Solid.m_Vertices[iVertex].id;
+
+					if ( pt == 0 )
+						hFirstVertex = hThisVertex;
+				}
+				else
+				{
+					hThisVertex = hFirstVertex;
+				}
+
+				if ( hLastVertex )
+				{
+					int iEdge = ScanEdgeIndex( Solid, hLastVertex, hThisVertex );
+					CSSEdge *pEdge;
+					if ( iEdge == -1 )
+					{
+						pEdge = Solid.AddEdge( &iEdge );
+						pEdge->hvStart = hLastVertex;
+						pEdge->hvEnd = hThisVertex;
+
+						ScanCalcEdgeCenter( Solid, pEdge );
+					}
+					else
+					{
+						pEdge = &Solid.m_Edges[iEdge];
+					}
+
+					pFace->Edges[pFace->nEdges++] = pEdge->id;
+
+					if ( !pEdge->Faces[0] )
+						pEdge->Faces[0] = pFace->id;
+					else if ( !pEdge->Faces[1] )
+						pEdge->Faces[1] = pFace->id;
+					else
+					{
+						pEdge->Faces[0] = pFace->id;
+						AfxMessageBox( "Edge with both face id's already filled, skipping..." );
+					}
+				}
+
+				hLastVertex = hThisVertex;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: CSSolid::MergeSameVertices as it was before the tables: merges
+	//			the lowest matching pair and starts over until none are left.
+	//-----------------------------------------------------------------------------
+	static SSHANDLE *ScanMergeSameVertices( CSSolid &Solid, int &nDeleted )
+	{
+		int nMerged = 0;
+		nDeleted = 0;
+		static SSHANDLE hDeletedList[128];
+
+	DoVertices:
+		for ( int v1 = 0; v1 < Solid.m_nVertices; v1++ )
+		{
+			for ( int v2 = 0; v2 < Solid.m_nVertices; v2++ )
+			{
+				if ( v1 == v2 )
+					continue;
+				if ( !VectorCompare( Solid.m_Vertices[v1].pos, Solid.m_Vertices[v2].pos ) )
+					continue;
+
+				++nMerged;
+
+				SSHANDLE hV1 = Solid.m_Vertices[v1].id;
+				SSHANDLE hV2 = Solid.m_Vertices[v2].id;
+
+				hDeletedList[nDeleted++] = hV1;
+
+				Solid.DeleteVertex( v1 );
+
+				int nAffected;
+				CSSEdge **ppEdges = Solid.FindAffectedEdges( &hV1, 1, nAffected );
+
+				for ( int e = 0; e < nAffected; e++ )
+				{
+					if ( ppEdges[e]->hvStart == hV1 )
+						ppEdges[e]->hvStart = hV2;
+					if ( ppEdges[e]->hvEnd == hV1 )
+						ppEdges[e]->hvEnd = hV2;
+					ScanCalcEdgeCenter( Solid, ppEdges[e] );
+				}
+
+				goto DoVertices;
+			}
+		}
+
+		if ( !nMerged )
+			return NULL;
+
+		int e;
+
+		for ( e = 0; e < Solid.m_nEdges; e++ )
+		{
+			CSSEdge &edge = Solid.m_Edges[e];
+
+			if ( edge.hvStart != edge.hvEnd )
+				continue;
+
+			hDeletedList[nDeleted++] = edge.id;
+
+			Solid.DeleteEdge( e );
+			--e;
+		}
+
+	DoEdges:
+		for ( e = 0; e < Solid.m_nEdges; e++ )
+		{
+			CSSEdge &edge = Solid.m_Edges[e];
+
+			for ( int e2 = 0; e2 < Solid.m_nEdges; e2++ )
+			{
+				if ( e == e2 )
+					continue;
+
+				CSSEdge &edge2 = Solid.m_Edges[e2];
+
+				if ( !( ( edge2.hvStart == edge.hvStart && edge2.hvEnd == edge.hvEnd ) ||
+					( edge2.hvEnd == edge.hvStart && edge2.hvStart == edge.hvEnd ) ) )
+					continue;
+
+				SSHANDLE id2 = edge2.id;
+				SSHANDLE id1 = edge.id;
+
+				for ( int f = 0; f < Solid.m_nFaces; f++ )
+				{
+					CSSFace &face = Solid.m_Faces[f];
+					for ( int ef = 0; ef < face.nEdges; ef++ )
+					{
+						if ( face.Edges[ef] == id2 )
+						{
+							face.Edges[ef] = id1;
+							break;
+						}
+					}
+				}
+
+				hDeletedList[nDeleted++] = id2;
+				Solid.DeleteEdge( e2 );
+
+				goto DoEdges;
+			}
+		}
+
+		for ( int f = 0; f < Solid.m_nFaces; f++ )
+		{
+			CSSFace &face = Solid.m_Faces[f];
+
+		DoConcurrentEdges:
+			for ( int ef1 = 0; ef1 < face.nEdges; ef1++ )
+			{
+				for ( int ef2 = 0; ef2 < face.nEdges; ef2++ )
+				{
+					if ( ef2 == ef1 )
+						continue;
+
+					if ( face.Edges[ef1] != face.Edges[ef2] )
+						continue;
+
+					memmove( &face.Edges[ef2], &face.Edges[ef2 + 1], ( face.nEdges - ef2 ) * sizeof( face.Edges[0] ) );
+					--face.nEdges;
+
+					goto DoConcurrentEdges;
+				}
+			}
+
+			if ( face.nEdges < 3 )
+			{
+				hDeletedList[nDeleted++] = face.id;
+				Solid.DeleteFace( f );
+				--f;
+			}
+		}
+
+		return hDeletedList;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Gets the vertex handles around a face by scanning, false if its
+	//			edges don't join up.
+	//-----------------------------------------------------------------------------
+	static bool ScanFaceVertices( CSSolid &Solid, CSSFace &Face, std::vector<SSHANDLE> &Vertices )
+	{
+		Vertices.clear();
+		for ( int i = 0; i < Face.nEdges; i++ )
+		{
+			SSHANDLEINFO hiCur, hiNext;
+			if ( !ScanHandleInfo( Solid, &hiCur, Face.Edges[i] ) || ( hiCur.Type != shtEdge ) ||
+				!ScanHandleInfo( Solid, &hiNext, Face.Edges[( i + 1 ) % Face.nEdges] ) || ( hiNext.Type != shtEdge ) )
+				return false;
+
+			SSHANDLE hVertex = Solid.GetConnectionVertex( (CSSEdge *)hiCur.pData, (CSSEdge *)hiNext.pData );
+			if ( !hVertex )
+				return false;
+
+			Vertices.push_back( hVertex );
+		}
+
+		return true;
+	}
+
+	static Vector ScanVertexPos( CSSolid &Solid, SSHANDLE hVertex )
+	{
+		SSHANDLEINFO hi;
+		VERIFY( ScanHandleInfo( Solid, &hi, hVertex ) && ( hi.Type == shtVertex ) );
+		return hi.pos;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns whether the solid is closed: every face a simple loop of
+	//			three or more edges, and every edge between two vertices and
+	//			used by the two faces it lists.
+	//-----------------------------------------------------------------------------
+	static bool IsClosed( CSSolid &Solid )
+	{
+		if ( Solid.m_nFaces < 4 )
+			return false;
+
+		std::unordered_map<SSHANDLE, int> EdgeUses;
+		std::vector<SSHANDLE> Vertices;
+		for ( int f = 0; f < Solid.m_nFaces; f++ )
+		{
+			CSSFace &Face = Solid.m_Faces[f];
+			if ( ( Face.nEdges < 3 ) || !ScanFaceVertices( Solid, Face, Vertices ) )
+				return false;
+
+			for ( int i = 0; i < (int)Vertices.size(); i++ )
+			{
+				for ( int j = 0; j < i; j++ )
+				{
+					if ( Vertices[i] == Vertices[j] )
+						return false;
+				}
+			}
+
+			for ( int i = 0; i < Face.nEdges; i++ )
+			{
+				SSHANDLEINFO hi;
+				ScanHandleInfo( Solid, &hi, Face.Edges[i] );
+				CSSEdge *pEdge = (CSSEdge *)hi.pData;
+				if ( ( pEdge->Faces[0] != Face.id ) && ( pEdge->Faces[1] != Face.id ) )
+					return false;
+
+				EdgeUses[Face.Edges[i]]++;
+			}
+		}
+
+		for ( int e = 0; e < Solid.m_nEdges; e++ )
+		{
+			CSSEdge &Edge = Solid.m_Edges[e];
+			SSHANDLEINFO hiStart, hiEnd;
+			if ( ( Edge.hvStart == Edge.hvEnd ) ||
+				!ScanHandleInfo( Solid, &hiStart, Edge.hvStart ) || ( hiStart.Type != shtVertex ) ||
+				!ScanHandleInfo( Solid, &hiEnd, Edge.hvEnd ) || ( hiEnd.Type != shtVertex ) )
+				return false;
+
+			if ( ( EdgeUses[Edge.id] != 2 ) || ( Edge.Faces[0] == Edge.Faces[1] ) )
+				return false;
+		}
+
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Checks every lookup against a scan of the part arrays.
+	//-----------------------------------------------------------------------------
+	static void CheckLookups( CSSolid &Solid )
+	{
+		for ( SSHANDLE id = 0; id <= Solid.m_curid + 1; id++ )
+		{
+			SSHANDLEINFO hi, hiScan;
+
+			BOOL bFound = Solid.GetHandleInfo( &hi, id );
+			CHECK( bFound == ScanHandleInfo( Solid, &hiScan, id ) );
+			CHECK( hi.Type == hiScan.Type );
+			if ( bFound )
+			{
+				CHECK( hi.iIndex == hiScan.iIndex );
+				CHECK( hi.pData == hiScan.pData );
+				CHECK( hi.p2DHandle == hiScan.p2DHandle );
+				CHECK( VectorCompare( hi.pos, hiScan.pos ) );
+			}
+
+			CHECK( Solid.GetHandleData( id ) == ( bFound ? hiScan.pData : NULL ) );
+		}
+
+		// Every pair of vertices, and a few ids that aren't vertices.
+		std::vector<SSHANDLE> Handles;
+		for ( int i = 0; i < Solid.m_nVertices; i++ )
+		{
+			Handles.push_back( Solid.m_Vertices[i].id );
+		}
+		Handles.push_back( 0 );
+		Handles.push_back( Solid.m_curid );
+		if ( Solid.m_nEdges )
+		{
+			Handles.push_back( Solid.m_Edges[0].id );
+		}
+
+		for ( int i = 0; i < (int)Handles.size(); i++ )
+		{
+			for ( int j = 0; j < (int)Handles.size(); j++ )
+			{
+				CHECK( Solid.GetEdgeIndex( Handles[i], Handles[j] ) == ScanEdgeIndex( Solid, Handles[i], Handles[j] ) );
+			}
+		}
+
+		// Each vertex, and points around it out past the neighbouring cells.
+		static const float s_Leniencies[] = { 0.0f, 0.01f, 0.1f, 0.5f, 1.0f, 1.5f };
+		for ( int i = 0; i < Solid.m_nVertices; i++ )
+		{
+			for ( int k = 0; k < 4; k++ )
+			{
+				Vector Point = Solid.m_Vertices[i].pos;
+				if ( k )
+				{
+					Point = Point + Vector( RandomFloat( -1.6f, 1.6f ), RandomFloat( -1.6f, 1.6f ), RandomFloat( -1.6f, 1.6f ) );
+				}
+
+				for ( int l = 0; l < (int)ARRAYSIZE( s_Leniencies ); l++ )
+				{
+					CHECK( Solid.GetVertexIndex( Point, s_Leniencies[l] ) == ScanVertexIndex( Solid, Point, s_Leniencies[l] ) );
+				}
+			}
+		}
+
+		CHECK( Solid.CanMergeVertices() == ScanCanMergeVertices( Solid ) );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Checks that two solids have the same parts, in the same order.
+	//-----------------------------------------------------------------------------
+	static void CheckSame( CSSolid &Solid1, CSSolid &Solid2 )
+	{
+		CHECK( Solid1.m_curid == Solid2.m_curid );
+		CHECK( Solid1.m_nVertices == Solid2.m_nVertices );
+		CHECK( Solid1.m_nEdges == Solid2.m_nEdges );
+		CHECK( Solid1.m_nFaces == Solid2.m_nFaces );
+		if ( ( Solid1.m_nVertices != Solid2.m_nVertices ) || ( Solid1.m_nEdges != Solid2.m_nEdges ) || ( Solid1.m_nFaces != Solid2.m_nFaces ) )
+			return;
+
+		for ( int i = 0; i < Solid1.m_nVertices; i++ )
+		{
+			CSSVertex &v1 = Solid1.m_Vertices[i];
+			CSSVertex &v2 = Solid2.m_Vertices[i];
+			CHECK( v1.id == v2.id );
+			CHECK( VectorCompare( v1.pos, v2.pos ) );
+		}
+
+		for ( int i = 0; i < Solid1.m_nEdges; i++ )
+		{
+			CSSEdge &e1 = Solid1.m_Edges[i];
+			CSSEdge &e2 = Solid2.m_Edges[i];
+			CHECK( e1.id == e2.id );
+			CHECK( ( e1.hvStart == e2.hvStart ) && ( e1.hvEnd == e2.hvEnd ) );
+			CHECK( ( e1.Faces[0] == e2.Faces[0] ) && ( e1.Faces[1] == e2.Faces[1] ) );
+			CHECK( VectorCompare( e1.ptCenter, e2.ptCenter ) );
+		}
+
+		for ( int i = 0; i < Solid1.m_nFaces; i++ )
+		{
+			CSSFace &f1 = Solid1.m_Faces[i];
+			CSSFace &f2 = Solid2.m_Faces[i];
+			CHECK( f1.id == f2.id );
+			CHECK( f1.m_nFaceID == f2.m_nFaceID );
+			CHECK( f1.nEdges == f2.nEdges );
+			CHECK( !memcmp( f1.Edges, f2.Edges, sizeof( SSHANDLE ) * f1.nEdges ) );
+			CHECK( !memcmp( &f1.texture, &f2.texture, sizeof( TEXTURE ) ) );
+			CHECK( VectorCompare( f1.normal, f2.normal ) );
+			for ( int j = 0; j < 3; j++ )
+			{
+				CHECK( VectorCompare( f1.PlanePts[j], f2.PlanePts[j] ) );
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns whether two loops of points are the same, starting
+	//			anywhere, with each point within flTolerance.
+	//-----------------------------------------------------------------------------
+	static bool IsSameLoop( const Vector *pPoints1, int nPoints1, const Vector *pPoints2, int nPoints2, float flTolerance )
+	{
+		if ( nPoints1 != nPoints2 )
+			return false;
+
+		for ( int nStart = 0; nStart < nPoints1; nStart++ )
+		{
+			int i;
+			for ( i = 0; i < nPoints1; i++ )
+			{
+				const Vector &p1 = pPoints1[i];
+				const Vector &p2 = pPoints2[( nStart + i ) % nPoints2];
+				if ( ( fabs( p1.x - p2.x ) > flTolerance ) || ( fabs( p1.y - p2.y ) > flTolerance ) || ( fabs( p1.z - p2.z ) > flTolerance ) )
+					break;
+			}
+
+			if ( i == nPoints1 )
+				return true;
+		}
+
+		return false;
+	}
+
+	static void GetFaceLoop( CSSolid &Solid, CSSFace &Face, std::vector<Vector> &Points )
+	{
+		std::vector<SSHANDLE> Vertices;
+		CHECK( ScanFaceVertices( Solid, Face, Vertices ) );
+
+		Points.clear();
+		for ( int i = 0; i < (int)Vertices.size(); i++ )
+		{
+			Points.push_back( ScanVertexPos( Solid, Vertices[i] ) );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Makes a prism or pyramid with an n-sided base, its vertices on
+	//			integers plus a fraction shared by the whole solid. Jittering
+	//			moves each face's copy of a vertex by a little less than the
+	//			amount FromMapSolid welds.
+	//-----------------------------------------------------------------------------
+	static void MakeSolid( CMapSolid &MapSolid, int nSides, bool bPyramid, bool bJitter )
+	{
+		static const float s_Fractions[] = { 0.0f, 0.5f, 0.25f, 0.499f, 0.501f };
+		float flFraction = ( RandomInt( 0, 4 ) == 0 ) ? RandomFloat( 0.0f, 1.0f ) : s_Fractions[RandomInt( 0, ARRAYSIZE( s_Fractions ) - 1 )];
+		Vector Center( RandomInt( -4096, 4096 ) + flFraction, RandomInt( -4096, 4096 ) + flFraction, RandomInt( -4096, 4096 ) + flFraction );
+		float flRadius = (float)RandomInt( 32, 256 );
+		float flHeight = (float)RandomInt( 8, 256 );
+		float flPhase = RandomFloat( 0.0f, 6.2831853f );
+
+		std::vector<Vector> Base, Top;
+		for ( int i = 0; i < nSides; i++ )
+		{
+			float flAngle = flPhase + 6.2831853f * i / nSides;
+			Vector Offset( floorf( cosf( flAngle ) * flRadius + 0.5f ), floorf( sinf( flAngle ) * flRadius + 0.5f ), 0.0f );
+			Base.push_back( Center + Offset );
+			Top.push_back( Center + Offset + Vector( 0.0f, 0.0f, flHeight ) );
+		}
+		Vector Apex = Center + Vector( 0.0f, 0.0f, flHeight );
+
+		std::vector< std::vector<Vector> > Faces;
+
+		Faces.push_back( std::vector<Vector>( Base.rbegin(), Base.rend() ) );
+		if ( !bPyramid )
+		{
+			Faces.push_back( Top );
+		}
+
+		for ( int i = 0; i < nSides; i++ )
+		{
+			int iNext = ( i + 1 ) % nSides;
+			std::vector<Vector> Side;
+			Side.push_back( Base[i] );
+			Side.push_back( Base[iNext] );
+			if ( bPyramid )
+			{
+				Side.push_back( Apex );
+			}
+			else
+			{
+				Side.push_back( Top[iNext] );
+				Side.push_back( Top[i] );
+			}
+			Faces.push_back( Side );
+		}
+
+		int nFirstFaceID = RandomInt( 1, 10000 );
+		MapSolid.SetFaceCount( (int)Faces.size() );
+		for ( int i = 0; i < (int)Faces.size(); i++ )
+		{
+			if ( bJitter )
+			{
+				for ( int j = 0; j < (int)Faces[i].size(); j++ )
+				{
+					Faces[i][j] = Faces[i][j] + Vector( RandomFloat( -0.025f, 0.025f ), RandomFloat( -0.025f, 0.025f ), RandomFloat( -0.025f, 0.025f ) );
+				}
+			}
+
+			CMapFace *pFace = MapSolid.GetFace( i );
+			pFace->CreateFace( &Faces[i][0], (int)Faces[i].size() );
+			pFace->SetFaceID( nFirstFaceID + i );
+			sprintf( pFace->texture.texture, "tools/face%d", i );
+			pFace->texture.scale[0] = pFace->texture.scale[1] = 0.25f;
+			pFace->plane.normal = Vector( 0.0f, 0.0f, (float)i );
+		}
+	}
+
+	static void MakeRandomSolid( CMapSolid &MapSolid, bool bJitter )
+	{
+		MakeSolid( MapSolid, RandomInt( 3, 16 ), RandomInt( 0, 2 ) == 0, bJitter );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Checks that a map solid gives back the same faces.
+	//-----------------------------------------------------------------------------
+	static void CheckSameFaces( CMapSolid &MapSolid1, CMapSolid &MapSolid2, float flTolerance )
+	{
+		CHECK( MapSolid1.GetFaceCount() == MapSolid2.GetFaceCount() );
+		if ( MapSolid1.GetFaceCount() != MapSolid2.GetFaceCount() )
+			return;
+
+		for ( int i = 0; i < MapSolid1.GetFaceCount(); i++ )
+		{
+			CMapFace *pFace1 = MapSolid1.GetFace( i );
+			CMapFace *pFace2 = MapSolid2.GetFace( i );
+			CHECK( pFace1->GetFaceID() == pFace2->GetFaceID() );
+			CHECK( !strcmp( pFace1->texture.texture, pFace2->texture.texture ) );
+			CHECK( IsSameLoop( pFace1->Points, pFace1->nPoints, pFace2->Points, pFace2->nPoints, flTolerance ) );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: FromMapSolid must build what scanning for each vertex and edge
+	//			did, and ToMapSolid must give back the faces it was built from.
+	//-----------------------------------------------------------------------------
+	static void TestFromMapSolid( void )
+	{
+		for ( int iRun = 0; iRun < 2000; iRun++ )
+		{
+			bool bJitter = ( iRun & 1 ) != 0;
+			CMapSolid MapSolid;
+			MakeRandomSolid( MapSolid, bJitter );
+
+			CSSolid Solid, Scanned;
+			Solid.Attach( &MapSolid );
+			Solid.Convert( TRUE );
+			ScanFromMapSolid( Scanned, &MapSolid );
+
+			CheckSame( Solid, Scanned );
+			CheckLookups( Solid );
+			CHECK( IsClosed( Solid ) );
+
+			CMapSolid Back;
+			Solid.ToMapSolid( &Back );
+			CheckSameFaces( MapSolid, Back, bJitter ? 0.1f : 0.0f );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Splits a face between two of its vertices that share no other
+	//			face. The face keeps the run from the first vertex to the
+	//			second and the new face gets the rest.
+	//-----------------------------------------------------------------------------
+	static bool SplitByVertices( CSSolid &Solid, CSSolid &Twin )
+	{
+		int iFace = RandomInt( 0, Solid.m_nFaces - 1 );
+		std::vector<SSHANDLE> Vertices;
+		if ( !ScanFaceVertices( Solid, Solid.m_Faces[iFace], Vertices ) || ( Vertices.size() < 4 ) )
+			return false;
+
+		int nVertices = (int)Vertices.size();
+		int i1 = RandomInt( 0, nVertices - 1 );
+		int i2 = ( i1 + RandomInt( 2, nVertices - 2 ) ) % nVertices;
+
+		int nShared = 0;
+		for ( int f = 0; f < Solid.m_nFaces; f++ )
+		{
+			std::vector<SSHANDLE> Others;
+			ScanFaceVertices( Solid, Solid.m_Faces[f], Others );
+			bool bHas1 = false, bHas2 = false;
+			for ( int i = 0; i < (int)Others.size(); i++ )
+			{
+				bHas1 |= ( Others[i] == Vertices[i1] );
+				bHas2 |= ( Others[i] == Vertices[i2] );
+			}
+			if ( bHas1 && bHas2 )
+				nShared++;
+		}
+
+		if ( nShared != 1 )
+			return false;
+
+		std::vector<Vector> Points;
+		GetFaceLoop( Solid, Solid.m_Faces[iFace], Points );
+
+		std::vector<Vector> Kept, Split;
+		for ( int i = i1; ; i = ( i + 1 ) % nVertices )
+		{
+			Kept.push_back( Points[i] );
+			if ( i == i2 )
+				break;
+		}
+		for ( int i = i2; ; i = ( i + 1 ) % nVertices )
+		{
+			Split.push_back( Points[i] );
+			if ( i == i1 )
+				break;
+		}
+
+		int nFaces = Solid.m_nFaces;
+		int nEdges = Solid.m_nEdges;
+		CHECK( Solid.SplitFace( Vertices[i1], Vertices[i2] ) );
+		CHECK( Twin.SplitFace( Vertices[i1], Vertices[i2] ) );
+		CHECK( Solid.m_nFaces == nFaces + 1 );
+		CHECK( Solid.m_nEdges == nEdges + 1 );
+
+		GetFaceLoop( Solid, Solid.m_Faces[iFace], Points );
+		CHECK( IsSameLoop( &Kept[0], (int)Kept.size(), &Points[0], (int)Points.size(), 0.0f ) );
+		GetFaceLoop( Solid, Solid.m_Faces[Solid.m_nFaces - 1], Points );
+		CHECK( IsSameLoop( &Split[0], (int)Split.size(), &Points[0], (int)Points.size(), 0.0f ) );
+
+		CHECK( IsClosed( Solid ) );
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Splits a face between the middles of two of its edges that
+	//			share no vertex and no other face.
+	//-----------------------------------------------------------------------------
+	static bool SplitByEdges( CSSolid &Solid, CSSolid &Twin )
+	{
+		CSSFace &Face = Solid.m_Faces[RandomInt( 0, Solid.m_nFaces - 1 )];
+		if ( Face.nEdges < 4 )
+			return false;
+
+		int i1 = RandomInt( 0, Face.nEdges - 1 );
+		int i2 = ( i1 + RandomInt( 2, Face.nEdges - 2 ) ) % Face.nEdges;
+
+		SSHANDLEINFO hi1, hi2;
+		ScanHandleInfo( Solid, &hi1, Face.Edges[i1] );
+		ScanHandleInfo( Solid, &hi2, Face.Edges[i2] );
+		CSSEdge *pEdge1 = (CSSEdge *)hi1.pData;
+		CSSEdge *pEdge2 = (CSSEdge *)hi2.pData;
+
+		if ( Solid.GetConnectionVertex( pEdge1, pEdge2 ) )
+			return false;
+
+		int nShared = 0;
+		for ( int i = 0; i < 2; i++ )
+		{
+			if ( ( pEdge1->Faces[i] == pEdge2->Faces[0] ) || ( pEdge1->Faces[i] == pEdge2->Faces[1] ) )
+				nShared++;
+		}
+
+		if ( nShared != 1 )
+			return false;
+
+		SSHANDLE hEdge1 = pEdge1->id;
+		SSHANDLE hEdge2 = pEdge2->id;
+		Vector Center1 = pEdge1->ptCenter;
+		Vector Center2 = pEdge2->ptCenter;
+
+		int nFaces = Solid.m_nFaces;
+		int nEdges = Solid.m_nEdges;
+		int nVertices = Solid.m_nVertices;
+		CHECK( Solid.SplitFace( hEdge1, hEdge2 ) );
+		CHECK( Twin.SplitFace( hEdge1, hEdge2 ) );
+		CHECK( Solid.m_nFaces == nFaces + 1 );
+		CHECK( Solid.m_nEdges == nEdges + 3 );
+		CHECK( Solid.m_nVertices == nVertices + 2 );
+
+		SSHANDLEINFO hi;
+		CHECK( !ScanHandleInfo( Solid, &hi, hEdge1 ) );
+		CHECK( !ScanHandleInfo( Solid, &hi, hEdge2 ) );
+		CHECK( VectorCompare( Solid.m_Vertices[nVertices].pos, Center1 ) );
+		CHECK( VectorCompare( Solid.m_Vertices[nVertices + 1].pos, Center2 ) );
+
+		CHECK( IsClosed( Solid ) );
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Merges vertices at the same position in both solids, the twin
+	//			by scanning, and checks they deleted the same parts.
+	//-----------------------------------------------------------------------------
+	static void Merge( CSSolid &Solid, CSSolid &Twin )
+	{
+		// Lookups must find the lowest of the vertices that are together.
+		CheckLookups( Solid );
+		CHECK( Solid.CanMergeVertices() == ScanCanMergeVertices( Twin ) );
+
+		int nDeleted, nTwinDeleted;
+		SSHANDLE *pDeleted = Solid.MergeSameVertices( nDeleted );
+		std::vector<SSHANDLE> Deleted;
+		if ( pDeleted )
+		{
+			Deleted.assign( pDeleted, pDeleted + nDeleted );
+		}
+
+		// The merge that scans predates the tables and doesn't keep them.
+		SSHANDLE *pTwinDeleted = ScanMergeSameVertices( Twin, nTwinDeleted );
+		Twin.InvalidateHandleIndex();
+		Twin.InvalidateEdgeIndex();
+		Twin.InvalidateVertexIndex();
+
+		CHECK( ( pDeleted == NULL ) == ( pTwinDeleted == NULL ) );
+		CHECK( nDeleted == nTwinDeleted );
+		if ( pTwinDeleted && ( nDeleted == nTwinDeleted ) )
+		{
+			CHECK( !memcmp( &Deleted[0], pTwinDeleted, sizeof( SSHANDLE ) * nDeleted ) );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Deletes an edge as the vertex tool does, by moving both its
+	//			vertices to its middle and merging them.
+	//-----------------------------------------------------------------------------
+	static void DeleteEdge( CSSolid &Solid, CSSolid &Twin )
+	{
+		int iEdge = RandomInt( 0, Solid.m_nEdges - 1 );
+		CSSEdge &Edge = Solid.m_Edges[iEdge];
+
+		Vector edgeCenter;
+		Edge.GetCenterPoint( edgeCenter );
+
+		SSHANDLEINFO hi1, hi2;
+		Solid.GetHandleInfo( &hi1, Edge.hvStart );
+		Solid.GetHandleInfo( &hi2, Edge.hvEnd );
+
+		Solid.SetVertexPosition( hi1.iIndex, edgeCenter );
+		Solid.SetVertexPosition( hi2.iIndex, edgeCenter );
+		Twin.SetVertexPosition( hi1.iIndex, edgeCenter );
+		Twin.SetVertexPosition( hi2.iIndex, edgeCenter );
+
+		Merge( Solid, Twin );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Drags a vertex onto another, usually one it shares an edge with.
+	//-----------------------------------------------------------------------------
+	static void MoveOntoVertex( CSSolid &Solid, CSSolid &Twin )
+	{
+		int iVertex, iOnto;
+		if ( RandomInt( 0, 3 ) )
+		{
+			CSSEdge &Edge = Solid.m_Edges[RandomInt( 0, Solid.m_nEdges - 1 )];
+			SSHANDLEINFO hi;
+			Solid.GetHandleInfo( &hi, Edge.hvStart );
+			iVertex = hi.iIndex;
+			Solid.GetHandleInfo( &hi, Edge.hvEnd );
+			iOnto = hi.iIndex;
+			if ( RandomInt( 0, 1 ) )
+			{
+				int iSwap = iVertex;
+				iVertex = iOnto;
+				iOnto = iSwap;
+			}
+		}
+		else
+		{
+			iVertex = RandomInt( 0, Solid.m_nVertices - 1 );
+			iOnto = RandomInt( 0, Solid.m_nVertices - 1 );
+		}
+
+		Vector pos = Solid.m_Vertices[iOnto].pos;
+		Solid.SetVertexPosition( iVertex, pos[0], pos[1], pos[2] );
+		Twin.SetVertexPosition( iVertex, pos[0], pos[1], pos[2] );
+
+		Merge( Solid, Twin );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Moves a selected vertex or edge by a delta.
+	//-----------------------------------------------------------------------------
+	static void MoveSelected( CSSolid &Solid, CSSolid &Twin )
+	{
+		bool bEdge = RandomInt( 0, 1 ) != 0;
+		int iSelect = bEdge ? RandomInt( 0, Solid.m_nEdges - 1 ) : RandomInt( 0, Solid.m_nVertices - 1 );
+		C2DHandle *pHandle = bEdge ? (C2DHandle *)&Solid.m_Edges[iSelect] : (C2DHandle *)&Solid.m_Vertices[iSelect];
+		C2DHandle *pTwinHandle = bEdge ? (C2DHandle *)&Twin.m_Edges[iSelect] : (C2DHandle *)&Twin.m_Vertices[iSelect];
+
+		Vector Delta( (float)RandomInt( -8, 8 ), (float)RandomInt( -8, 8 ), (float)RandomInt( -8, 8 ) );
+		if ( RandomInt( 0, 3 ) == 0 )
+		{
+			Delta = Delta * 0.5f;
+		}
+
+		pHandle->m_bSelected = TRUE;
+		pTwinHandle->m_bSelected = TRUE;
+		Solid.MoveSelectedHandles( Delta );
+		Twin.MoveSelectedHandles( Delta );
+		pHandle->m_bSelected = FALSE;
+		pTwinHandle->m_bSelected = FALSE;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Takes an edited solid to a map solid and back, which must give
+	//			the same face loops.
+	//-----------------------------------------------------------------------------
+	static void CheckRoundTrip( CSSolid &Solid )
+	{
+		// FromMapSolid welds vertices this close together.
+		for ( int i = 0; i < Solid.m_nVertices; i++ )
+		{
+			if ( ScanVertexIndex( Solid, Solid.m_Vertices[i].pos, 0.2f ) != i )
+				return;
+		}
+
+		CMapSolid MapSolid;
+		Solid.ToMapSolid( &MapSolid );
+
+		CSSolid Back;
+		Back.FromMapSolid( &MapSolid );
+		CheckLookups( Back );
+
+		CHECK( Back.m_nFaces == Solid.m_nFaces );
+		CHECK( Back.m_nEdges == Solid.m_nEdges );
+		CHECK( Back.m_nVertices == Solid.m_nVertices );
+		if ( Back.m_nFaces != Solid.m_nFaces )
+			return;
+
+		std::vector<Vector> Points, BackPoints;
+		for ( int i = 0; i < Solid.m_nFaces; i++ )
+		{
+			GetFaceLoop( Solid, Solid.m_Faces[i], Points );
+			GetFaceLoop( Back, Back.m_Faces[i], BackPoints );
+			CHECK( IsSameLoop( &Points[0], (int)Points.size(), &BackPoints[0], (int)BackPoints.size(), 0.0f ) );
+			CHECK( Back.m_Faces[i].m_nFaceID == Solid.m_Faces[i].m_nFaceID );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Random edits, each followed by checking every lookup, and the
+	//			solid against a twin that made the same edits but merged by
+	//			scanning.
+	//-----------------------------------------------------------------------------
+	static void TestEdits( void )
+	{
+		int nSplitsByVertices = 0, nSplitsByEdges = 0, nEdgeDeletes = 0, nMovesOnto = 0, nMoves = 0, nRoundTrips = 0;
+		for ( int iRun = 0; iRun < 1000; iRun++ )
+		{
+			CMapSolid MapSolid;
+			MakeRandomSolid( MapSolid, false );
+
+			CSSolid Solid, Twin;
+			Solid.FromMapSolid( &MapSolid );
+			ScanFromMapSolid( Twin, &MapSolid );
+
+			for ( int iEdit = 0; iEdit < 40; iEdit++ )
+			{
+				int nMaxEdges = 0;
+				for ( int i = 0; i < Solid.m_nFaces; i++ )
+				{
+					if ( Solid.m_Faces[i].nEdges > nMaxEdges )
+						nMaxEdges = Solid.m_Faces[i].nEdges;
+				}
+
+				// Splits keep a face's edges in 64 entries.
+				if ( ( nMaxEdges > 48 ) || ( Solid.m_nFaces > MAX_FACES - 10 ) )
+					break;
+
+				// Deletes and moves onto a vertex often leave the solid open,
+				// which ends the run, so they come up less.
+				switch ( RandomInt( 0, 7 ) )
+				{
+				case 0:
+				case 1:
+				case 2:
+					nSplitsByVertices += SplitByVertices( Solid, Twin );
+					break;
+				case 3:
+				case 4:
+					nSplitsByEdges += SplitByEdges( Solid, Twin );
+					break;
+				case 5:
+					DeleteEdge( Solid, Twin );
+					nEdgeDeletes++;
+					break;
+				case 6:
+					MoveOntoVertex( Solid, Twin );
+					nMovesOnto++;
+					break;
+				case 7:
+					MoveSelected( Solid, Twin );
+					nMoves++;
+					break;
+				}
+
+				CheckLookups( Solid );
+				CheckLookups( Twin );
+				CheckSame( Solid, Twin );
+
+				if ( !IsClosed( Solid ) )
+					break;
+
+				if ( ( iEdit % 8 ) == 7 )
+				{
+					CheckRoundTrip( Solid );
+					nRoundTrips++;
+				}
+			}
+
+			if ( g_nFailures )
+			{
+				printf( "FAIL: run %d\n", iRun );
+				return;
+			}
+		}
+
+		printf( "%d splits by vertices, %d by edges, %d edge deletes, %d moves onto a vertex, %d moves, %d round trips\n",
+			nSplitsByVertices, nSplitsByEdges, nEdgeDeletes, nMovesOnto, nMoves, nRoundTrips );
+		CHECK( nSplitsByVertices > 1000 );
+		CHECK( nSplitsByEdges > 500 );
+		CHECK( nRoundTrips > 500 );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Lookups must find the lowest of several matching parts, as the
+	//			scans did. Adds copies of vertices and edges, then merges them.
+	//-----------------------------------------------------------------------------
+	static void TestDuplicates( void )
+	{
+		for ( int iRun = 0; iRun < 500; iRun++ )
+		{
+			CMapSolid MapSolid;
+			MakeRandomSolid( MapSolid, false );
+
+			CSSolid Solid, Twin;
+			Solid.FromMapSolid( &MapSolid );
+			ScanFromMapSolid( Twin, &MapSolid );
+
+			int nCopies = RandomInt( 1, 4 );
+			for ( int i = 0; i < nCopies; i++ )
+			{
+				int iVertex = RandomInt( 0, Solid.m_nVertices - 1 );
+				Vector pos = Solid.m_Vertices[iVertex].pos;
+				if ( RandomInt( 0, 1 ) )
+				{
+					pos = pos + Vector( RandomFloat( -0.5f, 0.5f ), RandomFloat( -0.5f, 0.5f ), RandomFloat( -0.5f, 0.5f ) );
+				}
+
+				int iNew = -1;
+				Solid.AddVertex( &iNew )->pos = pos;
+				Twin.AddVertex()->pos = pos;
+				CHECK( Solid.GetVertexIndex( pos ) == ScanVertexIndex( Solid, pos, 0.0f ) );
+				CHECK( Solid.GetVertexIndex( pos ) <= iNew );
+
+				CSSEdge &Edge = Solid.m_Edges[RandomInt( 0, Solid.m_nEdges - 1 )];
+				SSHANDLE hvStart = Edge.hvStart;
+				SSHANDLE hvEnd = Edge.hvEnd;
+				int iEdge = Solid.GetEdgeIndex( hvStart, hvEnd );
+
+				CSSEdge *pCopy = Solid.AddEdge();
+				pCopy->hvStart = RandomInt( 0, 1 ) ? hvStart : hvEnd;
+				pCopy->hvEnd = ( pCopy->hvStart == hvStart ) ? hvEnd : hvStart;
+				Solid.CalcEdgeCenter( pCopy );
+
+				CSSEdge *pTwinCopy = Twin.AddEdge();
+				pTwinCopy->hvStart = pCopy->hvStart;
+				pTwinCopy->hvEnd = pCopy->hvEnd;
+				ScanCalcEdgeCenter( Twin, pTwinCopy );
+
+				CHECK( Solid.GetEdgeIndex( hvStart, hvEnd ) == iEdge );
+				CheckLookups( Solid );
+			}
+
+			CheckSame( Solid, Twin );
+			Merge( Solid, Twin );
+			CheckLookups( Solid );
+			CheckSame( Solid, Twin );
+			CHECK( !Solid.CanMergeVertices() );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Times converting a large solid and deleting edges from it, with
+	//			the lookup tables and by scanning.
+	//-----------------------------------------------------------------------------
+	static void Benchmark( void )
+	{
+		const int nSides = 100;
+		const int nRuns = 200;
+		const int nDeletes = 20;
+
+		CMapSolid MapSolid;
+		MakeSolid( MapSolid, nSides, false, false );
+
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		for ( int iRun = 0; iRun < nRuns; iRun++ )
+		{
+			CSSolid Solid;
+			Solid.FromMapSolid( &MapSolid );
+		}
+		double flConvertMS = MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		for ( int iRun = 0; iRun < nRuns; iRun++ )
+		{
+			CSSolid Solid;
+			ScanFromMapSolid( Solid, &MapSolid );
+		}
+		double flScanConvertMS = MS( Start );
+
+		// The same edges deleted both ways.
+		unsigned int nSeed = s_nSeed;
+		double flDeleteMS = 0, flScanDeleteMS = 0;
+		for ( int iPass = 0; iPass < 2; iPass++ )
+		{
+			s_nSeed = nSeed;
+			for ( int iRun = 0; iRun < nRuns; iRun++ )
+			{
+				CSSolid Solid;
+				Solid.FromMapSolid( &MapSolid );
+
+				Start = std::chrono::steady_clock::now();
+				for ( int i = 0; i < nDeletes; i++ )
+				{
+					CSSEdge &Edge = Solid.m_Edges[RandomInt( 0, Solid.m_nEdges - 1 )];
+					Vector edgeCenter;
+					Edge.GetCenterPoint( edgeCenter );
+
+					SSHANDLEINFO hi1, hi2;
+					int nDeleted;
+					if ( iPass == 0 )
+					{
+						Solid.GetHandleInfo( &hi1, Edge.hvStart );
+						Solid.GetHandleInfo( &hi2, Edge.hvEnd );
+						Solid.SetVertexPosition( hi1.iIndex, edgeCenter );
+						Solid.SetVertexPosition( hi2.iIndex, edgeCenter );
+						Solid.MergeSameVertices( nDeleted );
+					}
+					else
+					{
+						ScanHandleInfo( Solid, &hi1, Edge.hvStart );
+						ScanHandleInfo( Solid, &hi2, Edge.hvEnd );
+						Solid.m_Vertices[hi1.iIndex].pos = edgeCenter;
+						Solid.m_Vertices[hi2.iIndex].pos = edgeCenter;
+						ScanMergeSameVertices( Solid, nDeleted );
+					}
+				}
+				( iPass == 0 ? flDeleteMS : flScanDeleteMS ) += MS( Start );
+			}
+		}
+
+		printf( "%d-sided prism (%d faces), %d times:\n", nSides, MapSolid.GetFaceCount(), nRuns );
+		printf( "  FromMapSolid:        %8.1f ms, %8.1f ms scanning\n", flConvertMS, flScanConvertMS );
+		printf( "  %d edge deletes:     %8.1f ms, %8.1f ms scanning\n", nDeletes, flDeleteMS, flScanDeleteMS );
+	}
+};
+
+int main( void )
+{
+	Morph3D::TestFromMapSolid();
+	Morph3D::TestDuplicates();
+	Morph3D::TestEdits();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All structured solid tests passed\n" );
+
+	Morph3D::Benchmark();
+	return ( g_nFailures != 0 ) ? 1 : 0;
+}
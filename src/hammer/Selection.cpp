@@ -33,6 +33,10 @@ void CSelection::Init( CMapDoc *pDocument )
 	m_pDocument = pDocument;
 	m_eSelectMode = selectGroups;
 	m_SelectionList.Purge();
+	m_SelectionIndex.Purge();
+#ifndef SLE
+	m_SelectionIndexFixup.Reset();
+#endif
 	ClearHitList();
 
 	m_LastValidBounds.bmins = Vector(0, 0, 0);
@@ -43,7 +47,84 @@ void CSelection::Init( CMapDoc *pDocument )
 
 bool CSelection::IsSelected(CMapClass *pobj)
 {
-	return (m_SelectionList.Find(pobj) != m_SelectionList.InvalidIndex());
+	return m_SelectionIndex.HasElement(pobj);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Appends an object to the selection list and indexes it.
+//-----------------------------------------------------------------------------
+void CSelection::AddToSelectionList(CMapClass *pObject)
+{
+	Assert( !m_SelectionIndex.HasElement(pObject) );
+	m_SelectionIndex.Insert(pObject, m_SelectionList.AddToTail(pObject));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes an object from the selection list, keeping the index of
+//			every object that moves as a result up to date.
+//-----------------------------------------------------------------------------
+void CSelection::RemoveFromSelectionList(int iIndex)
+{
+	m_SelectionIndex.Remove(m_SelectionList[iIndex]);
+
+#ifdef SLE
+	m_SelectionList.FastRemove(iIndex);
+
+	// FastRemove moved the last element into the hole.
+	if (iIndex < m_SelectionList.Count())
+	{
+		m_SelectionIndex[m_SelectionIndex.Find(m_SelectionList[iIndex])] = iIndex;
+	}
+#else
+	m_SelectionList.Remove(iIndex);
+
+	//
+	// Every later object moved down one place. Their indices are fixed up
+	// lazily, see GetSelectionListIndex, and only rewritten once in a while.
+	//
+	if (m_SelectionIndexFixup.OnRemove(iIndex, m_SelectionList.Count()))
+	{
+		for (int i = m_SelectionIndexFixup.GetFirstStale(); i < m_SelectionList.Count(); i++)
+		{
+			m_SelectionIndex[m_SelectionIndex.Find(m_SelectionList[i])] = i;
+		}
+
+		m_SelectionIndexFixup.Reset();
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the position in the selection list of an indexed object.
+//-----------------------------------------------------------------------------
+int CSelection::GetSelectionListIndex(UtlHashHandle_t hIndex)
+{
+	int iIndex = m_SelectionIndex[hIndex];
+
+#ifndef SLE
+	iIndex = m_SelectionIndexFixup.Locate(m_SelectionList.Base(), m_SelectionList.Count(), m_SelectionIndex.Key(hIndex), iIndex);
+	Assert(iIndex != -1);
+#endif
+
+	return iIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuilds the object to list index map from the selection list.
+//-----------------------------------------------------------------------------
+void CSelection::RebuildSelectionIndex()
+{
+	m_SelectionIndex.RemoveAll();
+	m_SelectionIndex.Reserve(m_SelectionList.Count());
+
+	for (int i = 0; i < m_SelectionList.Count(); i++)
+	{
+		m_SelectionIndex.Insert(m_SelectionList[i], i);
+	}
+
+#ifndef SLE
+	m_SelectionIndexFixup.Reset();
+#endif
 }
 
 
@@ -365,6 +446,10 @@ bool CSelection::RemoveAll(void)
 	} 
 
 	m_SelectionList.RemoveAll();
+	m_SelectionIndex.RemoveAll();
+#ifndef SLE
+	m_SelectionIndexFixup.Reset();
+#endif
 	SetBoundsDirty();
 
 	return true;
@@ -385,6 +470,11 @@ bool CSelection::RemoveDead(void)
 		}
 	} 
 
+	if (bFoundOne)
+	{
+		RebuildSelectionIndex();
+	}
+
 	// TODO check if we do the same as in SelectObject
 	SetBoundsDirty();
 
@@ -409,6 +499,11 @@ bool CSelection::RemoveInvisibles(void)
 		}
 	} 
 
+	if (bFoundOne)
+	{
+		RebuildSelectionIndex();
+	}
+
 	SetBoundsDirty();
 
 	return bFoundOne;
@@ -520,8 +615,8 @@ bool CSelection::SelectObject(CMapClass *pObj, int cmd)
 	}
 	else // object oriented operation
 	{
-		int iIndex = m_SelectionList.Find(pObj);
-		bool bAlreadySelected = iIndex != -1;
+		UtlHashHandle_t hIndex = m_SelectionIndex.Find(pObj);
+		bool bAlreadySelected = hIndex != m_SelectionIndex.InvalidHandle();
 	
 		if ( cmd & scToggle )
 		{
@@ -546,17 +641,13 @@ bool CSelection::SelectObject(CMapClass *pObj, int cmd)
 			if ( bAlreadySelected )
 				return false;
 			
-			m_SelectionList.AddToTail(pObj);
+			AddToSelectionList(pObj);
 			pObj->SetSelectionState(SELECT_NORMAL);
 		}
 		else if ( (cmd & scUnselect) && bAlreadySelected )
 		{
 			// ok unselect an yet selected object
-#ifdef SLE
-			m_SelectionList.FastRemove(iIndex);
-#else
-			m_SelectionList.Remove(iIndex);
-#endif
+			RemoveFromSelectionList(GetSelectionListIndex(hIndex));
 			pObj->SetSelectionState(SELECT_NONE);
 		}
 		else
@@ -13,6 +13,8 @@
 #endif
 
 #include "mapclass.h"
+#include "tier1/utlhashtable.h"
+#include "SelectionIndex.h"
 
 class CMapDoc;
 
@@ -92,9 +94,18 @@ protected:
 
 	void UpdateSelectionBounds();
 
+	void AddToSelectionList(CMapClass *pObject);
+	void RemoveFromSelectionList(int iIndex);
+	int GetSelectionListIndex(UtlHashHandle_t hIndex);
+	void RebuildSelectionIndex();
+
 	CMapDoc			*m_pDocument;		// document this selection set belongs to
 	SelectMode_t	m_eSelectMode;		// Controls what gets selected based on what the user clicked on.
 	CMapObjectList	m_SelectionList;	// The list of selected objects.
+	CUtlHashtable<CMapClass *, int> m_SelectionIndex;	// Index of each selected object in m_SelectionList.
+#ifndef SLE
+	CSelectionIndexFixup m_SelectionIndexFixup;	// Which indices may be stale after removals.
+#endif
 
 	bool			m_bBoundsDirty;		// recalc bounds box with next query
 
@@ -0,0 +1,98 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Lazy upkeep of the list positions that CSelection indexes its
+//			selected objects by, for builds that keep the selection in the
+//			order it was made. Kept free of editor dependencies so it can be
+//			tested standalone:
+//
+//			g++ -O2 SelectionIndex_test.cpp -o SelectionIndex_test && ./SelectionIndex_test
+//
+//=============================================================================//
+
+#ifndef SELECTIONINDEX_H
+#define SELECTIONINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <limits.h>
+
+//-----------------------------------------------------------------------------
+// Removing an object from the middle of an ordered list moves every later
+// object down one place. Rather than rewrite all their stored positions on
+// each removal, this tracks how far they may be off. A stored position is
+// never below the true one and never more than the number of removals since
+// the last refresh above it, so a lookup scans down at most that far. Once
+// that scan could cost more than refreshing, the owner refreshes.
+//-----------------------------------------------------------------------------
+class CSelectionIndexFixup
+{
+public:
+
+	CSelectionIndexFixup( void ) { Reset(); }
+
+	// Call once every stored position is correct, e.g. after a refresh.
+	inline void Reset( void )
+	{
+		m_iFirstStale = INT_MAX;
+		m_nRemovals = 0;
+	}
+
+	// Stored positions from here on may be too high.
+	inline int GetFirstStale( void ) const { return m_iFirstStale; }
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Call after removing the object at iIndex from a list that now
+	//			holds nCount objects.
+	// Output : Returns true if the owner should now refresh the stored positions
+	//			from GetFirstStale() to the end of the list and call Reset.
+	//-----------------------------------------------------------------------------
+	inline bool OnRemove( int iIndex, int nCount )
+	{
+		if ( iIndex < m_iFirstStale )
+		{
+			m_iFirstStale = iIndex;
+		}
+		m_nRemovals++;
+
+		// Refreshing costs one write per stale position and a lookup scans at
+		// most m_nRemovals places, so refresh about every sqrt(stale) removals.
+		return ( m_nRemovals * m_nRemovals >= nCount - m_iFirstStale );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Returns the true position of an object in the list, given the
+	//			position stored for it, or -1 if it isn't where it could be.
+	//-----------------------------------------------------------------------------
+	template <class T>
+	int Locate( const T *pList, int nCount, const T &Object, int iStored ) const
+	{
+		if ( iStored < m_iFirstStale )
+		{
+			return iStored;
+		}
+
+		int iLowest = iStored - m_nRemovals;
+		if ( iLowest < m_iFirstStale )
+		{
+			iLowest = m_iFirstStale;
+		}
+
+		for ( int i = ( iStored < nCount ) ? iStored : nCount - 1; i >= iLowest; i-- )
+		{
+			if ( pList[i] == Object )
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+private:
+
+	int m_iFirstStale;
+	int m_nRemovals;	// Since the last refresh.
+};
+
+#endif // SELECTIONINDEX_H
@@ -0,0 +1,383 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the lazy selection index fixup. Drives a model
+//			of CSelection's list and index through random selects, unselects
+//			and clears and checks it against a plain ordered list, then times
+//			the selection traffic of selecting and transforming 50,000
+//			objects with each way CSelection has kept its list:
+//
+//			g++ -O2 SelectionIndex_test.cpp -o SelectionIndex_test && ./SelectionIndex_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include "SelectionIndex.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+//
+// Stands in for CMapClass.
+//
+struct Object_t
+{
+	int m_nId;
+	float m_flOrigin[3];
+};
+
+enum SelectionKind_t
+{
+	SELECTION_LINEAR = 0,	// No index: Find to test, Remove to unselect.
+	SELECTION_EAGER,		// Index, with every later index rewritten on each Remove.
+	SELECTION_LAZY,			// Index, with CSelectionIndexFixup.
+	SELECTION_SWAP,			// Index, with FastRemove, as SLE builds do. Doesn't keep order.
+};
+
+static const char *s_pszKindNames[] = { "linear Find/Remove", "index, eager fixup", "index, lazy fixup", "index, FastRemove (SLE)" };
+
+//-----------------------------------------------------------------------------
+// The list and index parts of CSelection: SelectObject with scSelect and
+// scUnselect, IsSelected and RemoveAll.
+//-----------------------------------------------------------------------------
+class CSelectionModel
+{
+public:
+
+	CSelectionModel( SelectionKind_t eKind ) : m_eKind( eKind ) {}
+
+	bool IsSelected( Object_t *pObject ) const
+	{
+		if ( m_eKind == SELECTION_LINEAR )
+			return std::find( m_List.begin(), m_List.end(), pObject ) != m_List.end();
+		return m_Index.find( pObject ) != m_Index.end();
+	}
+
+	bool Select( Object_t *pObject )
+	{
+		if ( IsSelected( pObject ) )
+			return false;
+
+		if ( m_eKind != SELECTION_LINEAR )
+		{
+			m_Index[pObject] = (int)m_List.size();
+		}
+		m_List.push_back( pObject );
+		return true;
+	}
+
+	bool Unselect( Object_t *pObject )
+	{
+		int iIndex;
+		if ( m_eKind == SELECTION_LINEAR )
+		{
+			std::vector<Object_t *>::iterator it = std::find( m_List.begin(), m_List.end(), pObject );
+			if ( it == m_List.end() )
+				return false;
+			iIndex = (int)( it - m_List.begin() );
+		}
+		else
+		{
+			std::unordered_map<Object_t *, int>::iterator it = m_Index.find( pObject );
+			if ( it == m_Index.end() )
+				return false;
+			iIndex = it->second;
+			if ( m_eKind == SELECTION_LAZY )
+			{
+				iIndex = m_Fixup.Locate( &m_List[0], (int)m_List.size(), pObject, iIndex );
+				CHECK( iIndex != -1 && m_List[iIndex] == pObject );
+			}
+			m_Index.erase( it );
+		}
+
+		if ( m_eKind == SELECTION_SWAP )
+		{
+			m_List[iIndex] = m_List.back();
+			m_List.pop_back();
+			if ( iIndex < (int)m_List.size() )
+			{
+				m_Index[m_List[iIndex]] = iIndex;
+			}
+			return true;
+		}
+
+		m_List.erase( m_List.begin() + iIndex );
+
+		if ( m_eKind == SELECTION_EAGER )
+		{
+			for ( int i = iIndex; i < (int)m_List.size(); i++ )
+			{
+				m_Index[m_List[i]] = i;
+			}
+		}
+		else if ( m_eKind == SELECTION_LAZY )
+		{
+			if ( m_Fixup.OnRemove( iIndex, (int)m_List.size() ) )
+			{
+				for ( int i = m_Fixup.GetFirstStale(); i < (int)m_List.size(); i++ )
+				{
+					m_Index[m_List[i]] = i;
+				}
+				m_Fixup.Reset();
+			}
+		}
+
+		return true;
+	}
+
+	void RemoveAll( void )
+	{
+		m_List.clear();
+		m_Index.clear();
+		m_Fixup.Reset();
+	}
+
+	const std::vector<Object_t *> &GetList( void ) const { return m_List; }
+
+	// The position the index resolves an object to, or -1.
+	int GetListIndex( Object_t *pObject ) const
+	{
+		std::unordered_map<Object_t *, int>::const_iterator it = m_Index.find( pObject );
+		if ( it == m_Index.end() )
+			return -1;
+		return m_Fixup.Locate( m_List.empty() ? NULL : &m_List[0], (int)m_List.size(), pObject, it->second );
+	}
+
+private:
+
+	SelectionKind_t m_eKind;
+	std::vector<Object_t *> m_List;
+	std::unordered_map<Object_t *, int> m_Index;
+	CSelectionIndexFixup m_Fixup;
+};
+
+//-----------------------------------------------------------------------------
+// Random selects, unselects and clears, in runs that favour one end of the
+// list or the other, checked against the linear list after every step.
+//-----------------------------------------------------------------------------
+static void TestRandomOps( void )
+{
+	const int nObjects = 500;
+	std::vector<Object_t> Objects( nObjects );
+	for ( int i = 0; i < nObjects; i++ )
+	{
+		Objects[i].m_nId = i;
+	}
+
+	CSelectionModel Reference( SELECTION_LINEAR );
+	CSelectionModel Lazy( SELECTION_LAZY );
+	CSelectionModel Swap( SELECTION_SWAP );
+
+	int nUnselects = 0;
+	for ( int nOp = 0; nOp < 200000; nOp++ )
+	{
+		int nKind = RandomInt( 0, 999 );
+		if ( nKind == 0 )
+		{
+			Reference.RemoveAll();
+			Lazy.RemoveAll();
+			Swap.RemoveAll();
+		}
+		else if ( nKind < 500 )
+		{
+			Object_t *pObject = &Objects[RandomInt( 0, nObjects - 1 )];
+			bool bChanged = Reference.Select( pObject );
+			CHECK( Lazy.Select( pObject ) == bChanged );
+			CHECK( Swap.Select( pObject ) == bChanged );
+		}
+		else
+		{
+			//
+			// Mostly unselect objects that are selected, picked from the front,
+			// the back or anywhere in the list.
+			//
+			Object_t *pObject = &Objects[RandomInt( 0, nObjects - 1 )];
+			const std::vector<Object_t *> &List = Reference.GetList();
+			if ( !List.empty() && nKind < 950 )
+			{
+				int nWhere = ( nOp / 5000 ) % 3;
+				int nCount = (int)List.size();
+				int iPick = ( nWhere == 0 ) ? RandomInt( 0, std::min( 3, nCount - 1 ) ) : ( nWhere == 1 ) ? RandomInt( std::max( 0, nCount - 4 ), nCount - 1 ) : RandomInt( 0, nCount - 1 );
+				pObject = List[iPick];
+			}
+
+			bool bChanged = Reference.Unselect( pObject );
+			CHECK( Lazy.Unselect( pObject ) == bChanged );
+			CHECK( Swap.Unselect( pObject ) == bChanged );
+			nUnselects += bChanged;
+		}
+
+		// The lazy list keeps the order; the swapped one only the members.
+		CHECK( Lazy.GetList() == Reference.GetList() );
+		CHECK( Swap.GetList().size() == Reference.GetList().size() );
+
+		if ( nOp % 97 == 0 )
+		{
+			const std::vector<Object_t *> &List = Reference.GetList();
+			for ( int i = 0; i < (int)List.size(); i++ )
+			{
+				CHECK( Lazy.GetListIndex( List[i] ) == i );
+				CHECK( Swap.IsSelected( List[i] ) );
+			}
+			for ( int i = 0; i < nObjects; i++ )
+			{
+				CHECK( Lazy.IsSelected( &Objects[i] ) == Reference.IsSelected( &Objects[i] ) );
+			}
+		}
+	}
+
+	CHECK( nUnselects > 10000 );
+}
+
+//-----------------------------------------------------------------------------
+// The fixup on its own: stale positions, refresh points and lookups.
+//-----------------------------------------------------------------------------
+static void TestFixup( void )
+{
+	CSelectionIndexFixup Fixup;
+	CHECK( Fixup.GetFirstStale() == INT_MAX );
+
+	int List[8] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+
+	// Nothing stale: stored positions are returned as they are.
+	CHECK( Fixup.Locate( List, 8, 13, 3 ) == 3 );
+
+	// Remove 12 at position 2: later objects are one place lower than stored.
+	for ( int i = 2; i < 7; i++ )
+	{
+		List[i] = List[i + 1];
+	}
+	CHECK( !Fixup.OnRemove( 2, 7 ) );
+	CHECK( Fixup.GetFirstStale() == 2 );
+	CHECK( Fixup.Locate( List, 7, 11, 1 ) == 1 );
+	CHECK( Fixup.Locate( List, 7, 13, 3 ) == 2 );
+	CHECK( Fixup.Locate( List, 7, 17, 7 ) == 6 );
+
+	// An object that isn't there isn't found.
+	CHECK( Fixup.Locate( List, 7, 12, 2 ) == -1 );
+
+	// Remove 10 at position 0: everything is stale now, off by up to two.
+	for ( int i = 0; i < 6; i++ )
+	{
+		List[i] = List[i + 1];
+	}
+	CHECK( !Fixup.OnRemove( 0, 6 ) );
+	CHECK( Fixup.GetFirstStale() == 0 );
+	CHECK( Fixup.Locate( List, 6, 11, 1 ) == 0 );
+	CHECK( Fixup.Locate( List, 6, 17, 7 ) == 5 );
+
+	// A third removal makes the scan (3) as long as the list (5): time to refresh.
+	for ( int i = 0; i < 5; i++ )
+	{
+		List[i] = List[i + 1];
+	}
+	CHECK( Fixup.OnRemove( 0, 5 ) );
+	CHECK( Fixup.Locate( List, 5, 17, 7 ) == 4 );
+
+	Fixup.Reset();
+	CHECK( Fixup.GetFirstStale() == INT_MAX );
+
+	// Removing the last object leaves nothing stale to refresh.
+	CHECK( Fixup.OnRemove( 5, 5 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+//-----------------------------------------------------------------------------
+// 50,000 objects: Edit > Select All (scClear, then SelectObject for each), a
+// transform of the selection (one pass over the list), the undo of it, which
+// restores the selection through SelectObjectList, then unselecting every
+// other object and finally the rest, front to back, as ctrl-clicking or
+// cascading unselects do.
+//-----------------------------------------------------------------------------
+static void Benchmark( void )
+{
+	const int nObjects = 50000;
+	std::vector<Object_t> Objects( nObjects );
+	for ( int i = 0; i < nObjects; i++ )
+	{
+		Objects[i].m_nId = i;
+		Objects[i].m_flOrigin[0] = Objects[i].m_flOrigin[1] = Objects[i].m_flOrigin[2] = (float)i;
+	}
+
+	printf( "50k objects (ms)           select all  transform  undo reselect  unselect half  unselect rest\n" );
+
+	for ( int nKind = 0; nKind < 4; nKind++ )
+	{
+		CSelectionModel Selection( (SelectionKind_t)nKind );
+
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		Selection.RemoveAll();
+		for ( int i = 0; i < nObjects; i++ )
+		{
+			Selection.Select( &Objects[i] );
+		}
+		double flSelect = MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		const std::vector<Object_t *> &List = Selection.GetList();
+		for ( size_t i = 0; i < List.size(); i++ )
+		{
+			List[i]->m_flOrigin[0] += 16.0f;
+		}
+		double flTransform = MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		Selection.RemoveAll();
+		for ( int i = 0; i < nObjects; i++ )
+		{
+			Selection.Select( &Objects[i] );
+		}
+		double flReselect = MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		for ( int i = 0; i < nObjects; i += 2 )
+		{
+			Selection.Unselect( &Objects[i] );
+		}
+		double flUnselectHalf = MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		for ( int i = 1; i < nObjects; i += 2 )
+		{
+			Selection.Unselect( &Objects[i] );
+		}
+		double flUnselectRest = MS( Start );
+
+		CHECK( Selection.GetList().empty() );
+
+		printf( "%-26s %10.1f %10.2f %14.1f %14.1f %14.1f\n", s_pszKindNames[nKind], flSelect, flTransform, flReselect, flUnselectHalf, flUnselectRest );
+	}
+}
+
+int main( void )
+{
+	TestFixup();
+	TestRandomOps();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All selection index tests passed\n" );
+	Benchmark();
+	return g_nFailures != 0;
+}
@@ -0,0 +1,347 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The plane work behind CMapSolid::CreateFromPlanes: choosing which
+//			planes to build faces from, and cutting each face's polygon down
+//			by the other planes. Kept free of editor dependencies so it can
+//			be fuzzed against the ClipWinding builder it replaced:
+//
+//			g++ -O2 SolidFromPlanes_test.cpp -o SolidFromPlanes_test && ./SolidFromPlanes_test
+//
+//			The types used with it provide:
+//
+//			PLANE	- a normal with x, y and z, and a dist
+//			SOLID	- int GetFaceCount(), FACE *GetFace( int )
+//			FACE	- a PLANE called plane
+//
+//=============================================================================//
+
+#ifndef SOLIDFROMPLANES_H
+#define SOLIDFROMPLANES_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#define	SPLIT_EPSILON				0.01		// Points within this many units of a clipping plane are considered on the plane.
+#define	WINDING_CLIPPER_MAX_POINTS	128			// Same limit as NewWinding.
+
+//
+// Cuts a polygon down by a series of planes, giving exactly the points that
+// ClipWinding calls would, without allocating a winding per clip. The points
+// are stored one axis per array so that each clip measures four of them at
+// a time.
+//
+class CWindingClipper
+{
+public:
+
+	CWindingClipper( void ) : m_nPoints( 0 ), m_nBuffer( 0 ), m_bOverflowed( false ) {}
+
+	inline int GetPointCount( void ) const { return m_nPoints; }
+
+	// True if a clip gave up because the polygon had too many points.
+	inline bool IsOverflowed( void ) const { return m_bOverflowed; }
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Starts from the given polygon.
+	//-----------------------------------------------------------------------------
+	template <class VECTOR>
+	void Init( const VECTOR *pPoints, int nPoints )
+	{
+		m_nBuffer = 0;
+		m_nPoints = ( nPoints < WINDING_CLIPPER_MAX_POINTS ) ? nPoints : WINDING_CLIPPER_MAX_POINTS;
+		m_bOverflowed = false;
+
+		for ( int i = 0; i < m_nPoints; i++ )
+		{
+			m_X[0][i] = pPoints[i].x;
+			m_Y[0][i] = pPoints[i].y;
+			m_Z[0][i] = pPoints[i].z;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Keeps the part of the polygon in front of the plane. The result
+	//			matches ClipWinding point for point: distances are summed in
+	//			DotProduct's order and points within SPLIT_EPSILON of the plane
+	//			are kept as they are.
+	// Output : Returns false if nothing is left in front of the plane, or if
+	//			the polygon has too many points to clip.
+	//-----------------------------------------------------------------------------
+	template <class PLANE>
+	bool Clip( const PLANE *pSplit )
+	{
+		int nPoints = m_nPoints;
+		if ( nPoints + 4 > WINDING_CLIPPER_MAX_POINTS )
+		{
+			m_bOverflowed = true;
+			m_nPoints = 0;
+			return false;
+		}
+
+		const float *pX = m_X[m_nBuffer];
+		const float *pY = m_Y[m_nBuffer];
+		const float *pZ = m_Z[m_nBuffer];
+
+		float flNormalX = pSplit->normal.x;
+		float flNormalY = pSplit->normal.y;
+		float flNormalZ = pSplit->normal.z;
+		float flDist = pSplit->dist;
+
+		// Measure four points at a time, then the rest one by one.
+		__m128 NormalX = _mm_set1_ps( flNormalX );
+		__m128 NormalY = _mm_set1_ps( flNormalY );
+		__m128 NormalZ = _mm_set1_ps( flNormalZ );
+		__m128 Dist = _mm_set1_ps( flDist );
+
+		int i = 0;
+		for ( ; i + 4 <= nPoints; i += 4 )
+		{
+			__m128 Dot = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( pX + i ), NormalX ), _mm_mul_ps( _mm_loadu_ps( pY + i ), NormalY ) );
+			Dot = _mm_add_ps( Dot, _mm_mul_ps( _mm_loadu_ps( pZ + i ), NormalZ ) );
+			_mm_storeu_ps( &m_Dists[i], _mm_sub_ps( Dot, Dist ) );
+		}
+
+		for ( ; i < nPoints; i++ )
+		{
+			float flDot = pX[i] * flNormalX + pY[i] * flNormalY + pZ[i] * flNormalZ;
+			flDot -= flDist;
+			m_Dists[i] = flDot;
+		}
+
+		int nCounts[3];
+		nCounts[0] = nCounts[1] = nCounts[2] = 0;
+
+		for ( i = 0; i < nPoints; i++ )
+		{
+			float flDot = m_Dists[i];
+			if ( flDot > SPLIT_EPSILON )
+				m_Sides[i] = CLIP_FRONT;
+			else if ( flDot < -SPLIT_EPSILON )
+				m_Sides[i] = CLIP_BACK;
+			else
+				m_Sides[i] = CLIP_ON;
+
+			nCounts[m_Sides[i]]++;
+		}
+		m_Sides[i] = m_Sides[0];
+		m_Dists[i] = m_Dists[0];
+
+		if ( !nCounts[CLIP_FRONT] && !nCounts[CLIP_BACK] )
+			return true;
+
+		if ( !nCounts[CLIP_FRONT] )
+		{
+			m_nPoints = 0;
+			return false;
+		}
+
+		if ( !nCounts[CLIP_BACK] )
+			return true;
+
+		float *pNewX = m_X[!m_nBuffer];
+		float *pNewY = m_Y[!m_nBuffer];
+		float *pNewZ = m_Z[!m_nBuffer];
+		int nNewPoints = 0;
+
+		for ( i = 0; i < nPoints; i++ )
+		{
+			if ( ( m_Sides[i] == CLIP_FRONT ) || ( m_Sides[i] == CLIP_ON ) )
+			{
+				pNewX[nNewPoints] = pX[i];
+				pNewY[nNewPoints] = pY[i];
+				pNewZ[nNewPoints] = pZ[i];
+				nNewPoints++;
+
+				if ( m_Sides[i] == CLIP_ON )
+					continue;
+			}
+
+			if ( ( m_Sides[i + 1] == CLIP_ON ) || ( m_Sides[i + 1] == m_Sides[i] ) )
+				continue;
+
+			// Generate a split point.
+			int nNext = ( i == nPoints - 1 ) ? 0 : i + 1;
+			float flFrac = m_Dists[i] / ( m_Dists[i] - m_Dists[i + 1] );
+
+			pNewX[nNewPoints] = pX[i] + flFrac * ( pX[nNext] - pX[i] );
+			pNewY[nNewPoints] = pY[i] + flFrac * ( pY[nNext] - pY[i] );
+			pNewZ[nNewPoints] = pZ[i] + flFrac * ( pZ[nNext] - pZ[i] );
+			nNewPoints++;
+		}
+
+		m_nBuffer = !m_nBuffer;
+		m_nPoints = nNewPoints;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Copies out the current points, GetPointCount() of them.
+	//-----------------------------------------------------------------------------
+	template <class VECTOR>
+	void GetPoints( VECTOR *pPoints ) const
+	{
+		for ( int i = 0; i < m_nPoints; i++ )
+		{
+			pPoints[i].x = m_X[m_nBuffer][i];
+			pPoints[i].y = m_Y[m_nBuffer][i];
+			pPoints[i].z = m_Z[m_nBuffer][i];
+		}
+	}
+
+private:
+
+	enum
+	{
+		CLIP_FRONT = 0,
+		CLIP_BACK,
+		CLIP_ON,
+	};
+
+	int m_nPoints;
+	int m_nBuffer;			// Which of the two point buffers is current.
+	bool m_bOverflowed;
+
+	// A clip adds at most one point per point it keeps.
+	float m_X[2][WINDING_CLIPPER_MAX_POINTS * 2];
+	float m_Y[2][WINDING_CLIPPER_MAX_POINTS * 2];
+	float m_Z[2][WINDING_CLIPPER_MAX_POINTS * 2];
+
+	float m_Dists[WINDING_CLIPPER_MAX_POINTS + 4];
+	int m_Sides[WINDING_CLIPPER_MAX_POINTS + 1];
+};
+
+//
+// A plane's distance, for finding duplicate planes.
+//
+struct SolidFromPlanesDist_t
+{
+	float dist;
+	int nFace;
+};
+
+inline int SolidFromPlanes_CompareDists( const void *p1, const void *p2 )
+{
+	float flDist1 = ( (const SolidFromPlanesDist_t *)p1 )->dist;
+	float flDist2 = ( (const SolidFromPlanesDist_t *)p2 )->dist;
+
+	if ( flDist1 < flDist2 )
+		return -1;
+
+	if ( flDist1 > flDist2 )
+		return 1;
+
+	return 0;
+}
+
+inline bool SolidFromPlanes_IsFinite( float f )
+{
+	unsigned int nBits;
+	memcpy( &nBits, &f, sizeof( nBits ) );
+	return ( nBits & 0x7F800000 ) != 0x7F800000;
+}
+
+template <class PLANE>
+inline bool SolidFromPlanes_IsZeroNormal( const PLANE &Plane )
+{
+	return ( Plane.normal.x == 0 ) && ( Plane.normal.y == 0 ) && ( Plane.normal.z == 0 );
+}
+
+template <class PLANE>
+inline float SolidFromPlanes_DotNormals( const PLANE &Plane1, const PLANE &Plane2 )
+{
+	return Plane1.normal.x * Plane2.normal.x + Plane1.normal.y * Plane2.normal.y + Plane1.normal.z * Plane2.normal.z;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Chooses the planes of a solid to build faces from. Planes with a
+//			zero normal are left out. Of two planes that duplicate each other
+//			within some tolerance, the earlier one is left out, and a plane
+//			leaves out only the first earlier plane it duplicates, as a scan of
+//			the earlier planes in order would.
+//
+//			Planes can only duplicate planes at nearly the same distance, so
+//			rather than comparing every pair the planes are sorted by distance
+//			and each is compared with its neighbors in that order. Planes with a
+//			non-finite distance never compare as duplicates, so they are left
+//			out of the sort.
+// Input  : pSorted, pnRank - Scratch space for one entry per face.
+// Output : pbUsePlane - Gets whether to use each face's plane.
+//-----------------------------------------------------------------------------
+template <class SOLID>
+void SolidFromPlanes_ChoosePlanes( SOLID *pSolid, bool *pbUsePlane, SolidFromPlanesDist_t *pSorted, int *pnRank )
+{
+	int nFaces = pSolid->GetFaceCount();
+	int nSorted = 0;
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		pnRank[i] = -1;
+		float flDist = pSolid->GetFace( i )->plane.dist;
+		if ( SolidFromPlanes_IsFinite( flDist ) )
+		{
+			pSorted[nSorted].dist = flDist;
+			pSorted[nSorted].nFace = i;
+			nSorted++;
+		}
+	}
+
+	qsort( pSorted, nSorted, sizeof( pSorted[0] ), SolidFromPlanes_CompareDists );
+
+	for ( int i = 0; i < nSorted; i++ )
+	{
+		pnRank[pSorted[i].nFace] = i;
+	}
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		//
+		// Don't use this plane if it has a zero-length normal.
+		//
+		if ( SolidFromPlanes_IsZeroNormal( pSolid->GetFace( i )->plane ) )
+		{
+			pbUsePlane[i] = false;
+			continue;
+		}
+
+		//
+		// If the plane duplicates another plane, don't use it (assume it is a brush
+		// being edited that will be fixed).
+		//
+		pbUsePlane[i] = true;
+		if ( pnRank[i] == -1 )
+			continue;
+
+		float flDist = pSolid->GetFace( i )->plane.dist;
+		int nFirstDuplicate = -1;
+		for ( int nDir = -1; nDir <= 1; nDir += 2 )
+		{
+			for ( int k = pnRank[i] + nDir; ( k >= 0 ) && ( k < nSorted ); k += nDir )
+			{
+				//
+				// Check for duplicate plane within some tolerance.
+				//
+				int j = pSorted[k].nFace;
+				if ( !( fabs( flDist - pSolid->GetFace( j )->plane.dist ) < 0.01 ) )
+					break;
+
+				if ( ( j < i ) && ( ( nFirstDuplicate == -1 ) || ( j < nFirstDuplicate ) ) &&
+					( SolidFromPlanes_DotNormals( pSolid->GetFace( i )->plane, pSolid->GetFace( j )->plane ) > 0.999 ) )
+				{
+					nFirstDuplicate = j;
+				}
+			}
+		}
+
+		if ( nFirstDuplicate != -1 )
+		{
+			pbUsePlane[nFirstDuplicate] = false;
+		}
+	}
+}
+
+#endif // SOLIDFROMPLANES_H
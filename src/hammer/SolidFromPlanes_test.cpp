@@ -0,0 +1,825 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone fuzz test for SolidFromPlanes.h. Builds the faces of
+//			random brushes both the way CMapSolid::CreateFromPlanes does now
+//			and the way it did before: every pair of planes compared for
+//			duplicates, and each face clipped by ClipWinding, which allocates
+//			a new winding per clip. The two must choose the same planes and
+//			give the same face points, bit for bit. Then times both over one
+//			million random convex brushes:
+//
+//			g++ -O2 SolidFromPlanes_test.cpp -o SolidFromPlanes_test && ./SolidFromPlanes_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "SolidFromPlanes.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static float RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( RandomInt( 0, 1 << 20 ) / (float)( 1 << 20 ) );
+}
+
+static double MS( std::chrono::steady_clock::time_point Start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+#define MAX_COORD_INTEGER		16384
+#define BOGUS_RANGE				( MAX_COORD_INTEGER * 4 )
+#define MAX_TRACE_LENGTH		( 1.732050807569 * 2 * MAX_COORD_INTEGER )
+#define MAX_POINTS_ON_WINDING	128
+#define MAX_FACES				512
+
+struct Vector_t
+{
+	float x, y, z;
+
+	float &operator[]( int i ) { return ( &x )[i]; }
+	float operator[]( int i ) const { return ( &x )[i]; }
+};
+
+struct Plane_t
+{
+	Vector_t normal;
+	float dist;
+};
+
+//
+// Stands in for CMapFace and CMapSolid.
+//
+struct Face_t
+{
+	Plane_t plane;
+};
+
+struct Solid_t
+{
+	std::vector<Face_t> m_Faces;
+
+	int GetFaceCount( void ) { return (int)m_Faces.size(); }
+	Face_t *GetFace( int i ) { return &m_Faces[i]; }
+};
+
+struct winding_t
+{
+	int numpoints;
+	Vector_t *p;
+};
+
+//
+// The points of one face built from a brush's planes.
+//
+struct BuiltFace_t
+{
+	int nFace;
+	std::vector<Vector_t> Points;
+};
+
+struct BuiltSolid_t
+{
+	std::vector<bool> UsePlane;
+	std::vector<BuiltFace_t> Faces;
+	bool bOverflowed;
+};
+
+static inline float DotProduct( const Vector_t &a, const Vector_t &b )
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The huge quadrilateral that CreateWindingFromPlane makes. The
+//			editor normalizes with mathlib; both builders here share this
+//			version, so only what comes after it is compared.
+//-----------------------------------------------------------------------------
+static void BasePoints( const Plane_t *pPlane, Vector_t *p )
+{
+	int x = -1;
+	float max = -BOGUS_RANGE;
+	for ( int i = 0; i < 3; i++ )
+	{
+		float v = fabs( pPlane->normal[i] );
+		if ( v > max )
+		{
+			x = i;
+			max = v;
+		}
+	}
+
+	Vector_t vup = { 0, 0, 0 };
+	if ( x == 2 )
+	{
+		vup.x = 1;
+	}
+	else
+	{
+		vup.z = 1;
+	}
+
+	float v = DotProduct( vup, pPlane->normal );
+	vup.x -= v * pPlane->normal.x;
+	vup.y -= v * pPlane->normal.y;
+	vup.z -= v * pPlane->normal.z;
+	float flLength = sqrtf( DotProduct( vup, vup ) );
+	if ( flLength != 0 )
+	{
+		vup.x /= flLength;
+		vup.y /= flLength;
+		vup.z /= flLength;
+	}
+
+	Vector_t org = { pPlane->normal.x * pPlane->dist, pPlane->normal.y * pPlane->dist, pPlane->normal.z * pPlane->dist };
+
+	Vector_t vright;
+	vright.x = vup.y * pPlane->normal.z - vup.z * pPlane->normal.y;
+	vright.y = vup.z * pPlane->normal.x - vup.x * pPlane->normal.z;
+	vright.z = vup.x * pPlane->normal.y - vup.y * pPlane->normal.x;
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		vup[i] = vup[i] * MAX_TRACE_LENGTH;
+		vright[i] = vright[i] * MAX_TRACE_LENGTH;
+	}
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		p[0][i] = org[i] - vright[i] + vup[i];
+		p[1][i] = org[i] + vright[i] + vup[i];
+		p[2][i] = org[i] + vright[i] - vup[i];
+		p[3][i] = org[i] - vright[i] - vup[i];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The old builder, from Brushops.cpp and CMapSolid::CreateFromPlanes.
+//-----------------------------------------------------------------------------
+static winding_t *NewWinding( int points )
+{
+	winding_t *w = (winding_t *)malloc( sizeof( *w ) );
+	w->numpoints = 0;
+	w->p = (Vector_t *)calloc( points, sizeof( Vector_t ) );
+	return w;
+}
+
+static void FreeWinding( winding_t *w )
+{
+	free( w->p );
+	free( w );
+}
+
+static winding_t *CreateWindingFromPlane( const Plane_t *pPlane )
+{
+	winding_t *w = NewWinding( 4 );
+	w->numpoints = 4;
+	BasePoints( pPlane, w->p );
+	return w;
+}
+
+// As in Brushops.cpp, except that a winding clipped away is freed whole
+// rather than leaking its points.
+static winding_t *ClipWinding( winding_t *in, const Plane_t *split )
+{
+	float	dists[MAX_POINTS_ON_WINDING];
+	int		sides[MAX_POINTS_ON_WINDING];
+	int		counts[3];
+	float	dot;
+	int		i, j;
+	Vector_t	*p1, *p2, *mid;
+	winding_t	*neww;
+	int		maxpts;
+
+	enum { SIDE_FRONT = 0, SIDE_BACK, SIDE_ON };
+
+	counts[0] = counts[1] = counts[2] = 0;
+
+	// determine sides for each point
+	for ( i = 0; i < in->numpoints; i++ )
+	{
+		dot = DotProduct( in->p[i], split->normal );
+		dot -= split->dist;
+		dists[i] = dot;
+		if ( dot > SPLIT_EPSILON )
+			sides[i] = SIDE_FRONT;
+		else if ( dot < -SPLIT_EPSILON )
+			sides[i] = SIDE_BACK;
+		else
+			sides[i] = SIDE_ON;
+		counts[sides[i]]++;
+	}
+	sides[i] = sides[0];
+	dists[i] = dists[0];
+
+	if ( !counts[0] && !counts[1] )
+		return in;
+
+	if ( !counts[0] )
+	{
+		FreeWinding( in );
+		return NULL;
+	}
+	if ( !counts[1] )
+		return in;
+
+	maxpts = in->numpoints + 4;
+	neww = NewWinding( maxpts );
+
+	for ( i = 0; i < in->numpoints; i++ )
+	{
+		p1 = &in->p[i];
+
+		mid = &neww->p[neww->numpoints];
+
+		if ( sides[i] == SIDE_FRONT || sides[i] == SIDE_ON )
+		{
+			*mid = *p1;
+			neww->numpoints++;
+			if ( sides[i] == SIDE_ON )
+				continue;
+			mid = &neww->p[neww->numpoints];
+		}
+
+		if ( sides[i + 1] == SIDE_ON || sides[i + 1] == sides[i] )
+			continue;
+
+		// generate a split point
+		if ( i == in->numpoints - 1 )
+			p2 = &in->p[0];
+		else
+			p2 = p1 + 1;
+
+		neww->numpoints++;
+
+		dot = dists[i] / ( dists[i] - dists[i + 1] );
+		for ( j = 0; j < 3; j++ )
+		{
+			mid[0][j] = p1[0][j] + dot * ( p2[0][j] - p1[0][j] );
+		}
+	}
+
+	FreeWinding( in );
+	return neww;
+}
+
+static void OldBuild( Solid_t &Solid, BuiltSolid_t &Built )
+{
+	int nFaces = Solid.GetFaceCount();
+	Built.UsePlane.assign( nFaces, false );
+	Built.Faces.clear();
+	Built.bOverflowed = false;
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		Plane_t *f = &Solid.GetFace( i )->plane;
+		if ( ( f->normal.x == 0 ) && ( f->normal.y == 0 ) && ( f->normal.z == 0 ) )
+		{
+			Built.UsePlane[i] = false;
+			continue;
+		}
+
+		Built.UsePlane[i] = true;
+		for ( int j = 0; j < i; j++ )
+		{
+			Plane_t *pCheck = &Solid.GetFace( j )->plane;
+			if ( ( DotProduct( f->normal, pCheck->normal ) > 0.999 ) && ( fabs( f->dist - pCheck->dist ) < 0.01 ) )
+			{
+				Built.UsePlane[j] = false;
+				break;
+			}
+		}
+	}
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		if ( !Built.UsePlane[i] )
+			continue;
+
+		winding_t *w = CreateWindingFromPlane( &Solid.GetFace( i )->plane );
+		for ( int j = 0; j < nFaces && w; j++ )
+		{
+			if ( j != i )
+			{
+				const Plane_t &Clip = Solid.GetFace( j )->plane;
+				Plane_t plane = { { 0 - Clip.normal.x, 0 - Clip.normal.y, 0 - Clip.normal.z }, -Clip.dist };
+				w = ClipWinding( w, &plane );
+			}
+		}
+
+		if ( w )
+		{
+			BuiltFace_t Face;
+			Face.nFace = i;
+			Face.Points.assign( w->p, w->p + w->numpoints );
+			Built.Faces.push_back( Face );
+			FreeWinding( w );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The new builder, as CMapSolid::CreateFromPlanes uses it.
+//-----------------------------------------------------------------------------
+static void NewBuild( Solid_t &Solid, CWindingClipper &Clipper, BuiltSolid_t &Built )
+{
+	int nFaces = Solid.GetFaceCount();
+
+	bool useplane[MAX_FACES];
+	SolidFromPlanesDist_t sorted[MAX_FACES];
+	int rank[MAX_FACES];
+	SolidFromPlanes_ChoosePlanes( &Solid, useplane, sorted, rank );
+
+	Built.UsePlane.assign( useplane, useplane + nFaces );
+	Built.Faces.clear();
+	Built.bOverflowed = false;
+
+	for ( int i = 0; i < nFaces; i++ )
+	{
+		if ( !useplane[i] )
+			continue;
+
+		Vector_t Base[4];
+		BasePoints( &Solid.GetFace( i )->plane, Base );
+		Clipper.Init( Base, 4 );
+
+		bool bClippedAway = false;
+		for ( int j = 0; j < nFaces && !bClippedAway; j++ )
+		{
+			if ( j != i )
+			{
+				const Plane_t &Clip = Solid.GetFace( j )->plane;
+				Plane_t plane = { { 0 - Clip.normal.x, 0 - Clip.normal.y, 0 - Clip.normal.z }, -Clip.dist };
+				bClippedAway = !Clipper.Clip( &plane );
+			}
+		}
+
+		Built.bOverflowed |= Clipper.IsOverflowed();
+
+		if ( !bClippedAway )
+		{
+			BuiltFace_t Face;
+			Face.nFace = i;
+			Face.Points.resize( Clipper.GetPointCount() );
+			Clipper.GetPoints( Face.Points.data() );
+			Built.Faces.push_back( Face );
+		}
+	}
+}
+
+static bool SameBuild( const BuiltSolid_t &Old, const BuiltSolid_t &New )
+{
+	if ( ( Old.UsePlane != New.UsePlane ) || ( Old.Faces.size() != New.Faces.size() ) )
+		return false;
+
+	for ( size_t i = 0; i < Old.Faces.size(); i++ )
+	{
+		const BuiltFace_t &OldFace = Old.Faces[i];
+		const BuiltFace_t &NewFace = New.Faces[i];
+		if ( ( OldFace.nFace != NewFace.nFace ) || ( OldFace.Points.size() != NewFace.Points.size() ) )
+			return false;
+
+		if ( !OldFace.Points.empty() && memcmp( &OldFace.Points[0], &NewFace.Points[0], OldFace.Points.size() * sizeof( Vector_t ) ) )
+			return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Random brushes.
+//-----------------------------------------------------------------------------
+static Vector_t RandomUnitVector( void )
+{
+	for ( ;; )
+	{
+		Vector_t v = { RandomFloat( -1, 1 ), RandomFloat( -1, 1 ), RandomFloat( -1, 1 ) };
+		float flLength = sqrtf( DotProduct( v, v ) );
+		if ( ( flLength > 0.1f ) && ( flLength <= 1 ) )
+		{
+			v.x /= flLength;
+			v.y /= flLength;
+			v.z /= flLength;
+			return v;
+		}
+	}
+}
+
+static void AddPlane( Solid_t &Solid, const Vector_t &Normal, float flDist )
+{
+	Face_t Face;
+	Face.plane.normal = Normal;
+	Face.plane.dist = flDist;
+	Solid.m_Faces.push_back( Face );
+}
+
+// Planes tangent to a sphere, like a brush cut by the clipping tool.
+static void AddRandomConvex( Solid_t &Solid, int nPlanes )
+{
+	Vector_t Center = { RandomFloat( -8192, 8192 ), RandomFloat( -8192, 8192 ), RandomFloat( -8192, 8192 ) };
+	float flRadius = RandomFloat( 1, 512 );
+	for ( int i = 0; i < nPlanes; i++ )
+	{
+		Vector_t Normal = RandomUnitVector();
+		AddPlane( Solid, Normal, DotProduct( Normal, Center ) + flRadius * RandomFloat( 0.5f, 1 ) );
+	}
+}
+
+// An axial box on the grid, like most brushes in a map.
+static void AddBox( Solid_t &Solid )
+{
+	int nMins[3];
+	int nMaxs[3];
+	for ( int i = 0; i < 3; i++ )
+	{
+		nMins[i] = RandomInt( -256, 256 ) * 16;
+		nMaxs[i] = nMins[i] + RandomInt( 1, 64 ) * ( ( RandomInt( 0, 3 ) == 0 ) ? 1 : 16 );
+	}
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		Vector_t Normal = { 0, 0, 0 };
+		Normal[i] = 1;
+		AddPlane( Solid, Normal, (float)nMaxs[i] );
+		Normal[i] = -1;
+		AddPlane( Solid, Normal, (float)-nMins[i] );
+	}
+}
+
+// A plane through three points on the grid, as the VMF loader makes them.
+static void AddGridPlane( Solid_t &Solid )
+{
+	Vector_t p[3];
+	for ( int i = 0; i < 3; i++ )
+	{
+		p[i].x = (float)( RandomInt( -64, 64 ) * 8 );
+		p[i].y = (float)( RandomInt( -64, 64 ) * 8 );
+		p[i].z = (float)( RandomInt( -64, 64 ) * 8 );
+	}
+
+	Vector_t e1 = { p[1].x - p[0].x, p[1].y - p[0].y, p[1].z - p[0].z };
+	Vector_t e2 = { p[2].x - p[0].x, p[2].y - p[0].y, p[2].z - p[0].z };
+	Vector_t Normal = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+	float flLength = sqrtf( DotProduct( Normal, Normal ) );
+	if ( flLength == 0 )
+		return;
+
+	Normal.x /= flLength;
+	Normal.y /= flLength;
+	Normal.z /= flLength;
+	AddPlane( Solid, Normal, DotProduct( Normal, p[0] ) );
+}
+
+// A prism with many sides, so that its caps have many points.
+static void AddPrism( Solid_t &Solid, int nSides )
+{
+	float flRadius = RandomFloat( 16, 1024 );
+	for ( int i = 0; i < nSides; i++ )
+	{
+		float flAngle = 2 * 3.14159265f * i / nSides;
+		Vector_t Normal = { cosf( flAngle ), sinf( flAngle ), 0 };
+		AddPlane( Solid, Normal, flRadius );
+	}
+
+	Vector_t Up = { 0, 0, 1 };
+	Vector_t Down = { 0, 0, -1 };
+	AddPlane( Solid, Up, RandomFloat( 1, 512 ) );
+	AddPlane( Solid, Down, RandomFloat( 1, 512 ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds planes that land on the edge cases: duplicates within and
+//			just outside the tolerances, opposite planes, zero normals,
+//			non-finite distances, and planes through or within SPLIT_EPSILON
+//			of another face's corner.
+//-----------------------------------------------------------------------------
+static void AddTrickyPlanes( Solid_t &Solid, int nPlanes )
+{
+	for ( int n = 0; n < nPlanes; n++ )
+	{
+		if ( Solid.m_Faces.empty() )
+			return;
+
+		Plane_t Plane = Solid.m_Faces[RandomInt( 0, (int)Solid.m_Faces.size() - 1 )].plane;
+
+		switch ( RandomInt( 0, 8 ) )
+		{
+			case 0:
+				break;
+
+			case 1:
+				Plane.dist += RandomFloat( -0.02f, 0.02f );
+				break;
+
+			case 2:
+			{
+				Vector_t Nudge = RandomUnitVector();
+				float flScale = RandomFloat( 0, 0.1f );
+				Plane.normal.x += Nudge.x * flScale;
+				Plane.normal.y += Nudge.y * flScale;
+				Plane.normal.z += Nudge.z * flScale;
+				break;
+			}
+
+			case 3:
+				Plane.normal.x = -Plane.normal.x;
+				Plane.normal.y = -Plane.normal.y;
+				Plane.normal.z = -Plane.normal.z;
+				Plane.dist = -Plane.dist + RandomFloat( -1, 1 );
+				break;
+
+			case 4:
+				Plane.normal.x = Plane.normal.y = Plane.normal.z = 0;
+				break;
+
+			case 5:
+				Plane.dist = ( RandomInt( 0, 1 ) == 0 ) ? NAN : ( ( RandomInt( 0, 1 ) == 0 ) ? INFINITY : -INFINITY );
+				break;
+
+			// Through a corner of the face built from another plane, give or
+			// take SPLIT_EPSILON.
+			default:
+			{
+				Vector_t Base[4];
+				BasePoints( &Plane, Base );
+				CWindingClipper Clipper;
+				Clipper.Init( Base, 4 );
+				for ( size_t j = 0; j < Solid.m_Faces.size(); j++ )
+				{
+					const Plane_t &Clip = Solid.m_Faces[j].plane;
+					Plane_t Flipped = { { 0 - Clip.normal.x, 0 - Clip.normal.y, 0 - Clip.normal.z }, -Clip.dist };
+					if ( ( memcmp( &Clip, &Plane, sizeof( Plane ) ) != 0 ) && !Clipper.Clip( &Flipped ) )
+						break;
+				}
+
+				if ( Clipper.GetPointCount() == 0 )
+					continue;
+
+				Vector_t Points[WINDING_CLIPPER_MAX_POINTS];
+				Clipper.GetPoints( Points );
+				Vector_t Corner = Points[RandomInt( 0, Clipper.GetPointCount() - 1 )];
+
+				Plane.normal = RandomUnitVector();
+				static const float Offsets[] = { 0, 0.009f, -0.009f, 0.01f, -0.01f, 0.011f, -0.011f };
+				Plane.dist = DotProduct( Plane.normal, Corner ) + Offsets[RandomInt( 0, 6 )];
+				break;
+			}
+		}
+
+		// Insert rather than append, so duplicates come before and after.
+		Face_t Face;
+		Face.plane = Plane;
+		Solid.m_Faces.insert( Solid.m_Faces.begin() + RandomInt( 0, (int)Solid.m_Faces.size() ), Face );
+	}
+}
+
+static void RandomBrush( Solid_t &Solid )
+{
+	Solid.m_Faces.clear();
+
+	switch ( RandomInt( 0, 4 ) )
+	{
+		case 0:
+			AddBox( Solid );
+			break;
+
+		case 1:
+			AddBox( Solid );
+			for ( int i = RandomInt( 1, 4 ); i > 0; i-- )
+			{
+				AddGridPlane( Solid );
+			}
+			break;
+
+		case 2:
+			AddRandomConvex( Solid, RandomInt( 4, 40 ) );
+			break;
+
+		case 3:
+			AddPrism( Solid, RandomInt( 3, 110 ) );
+			break;
+
+		case 4:
+			for ( int i = RandomInt( 4, 12 ); i > 0; i-- )
+			{
+				AddGridPlane( Solid );
+			}
+			break;
+	}
+
+	if ( RandomInt( 0, 1 ) == 0 )
+	{
+		AddTrickyPlanes( Solid, RandomInt( 1, 6 ) );
+	}
+
+	if ( Solid.m_Faces.size() > MAX_FACES )
+	{
+		Solid.m_Faces.resize( MAX_FACES );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Tests.
+//-----------------------------------------------------------------------------
+static void TestFuzz( void )
+{
+	CWindingClipper Clipper;
+	BuiltSolid_t Old;
+	BuiltSolid_t New;
+
+	int nDifferences = 0;
+	int nFaces = 0;
+	int nDroppedPlanes = 0;
+
+	for ( int nBrush = 0; nBrush < 100000; nBrush++ )
+	{
+		Solid_t Solid;
+		RandomBrush( Solid );
+
+		OldBuild( Solid, Old );
+		NewBuild( Solid, Clipper, New );
+
+		if ( !SameBuild( Old, New ) )
+		{
+			if ( nDifferences++ < 5 )
+			{
+				printf( "Brush %d with %d planes built differently\n", nBrush, Solid.GetFaceCount() );
+			}
+		}
+		CHECK( !New.bOverflowed );
+
+		nFaces += (int)New.Faces.size();
+		for ( size_t i = 0; i < New.UsePlane.size(); i++ )
+		{
+			nDroppedPlanes += !New.UsePlane[i];
+		}
+	}
+
+	CHECK( nDifferences == 0 );
+
+	// Make sure the fuzzing reached the cases it is meant to.
+	CHECK( nFaces > 100000 );
+	CHECK( nDroppedPlanes > 1000 );
+}
+
+static void TestClipper( void )
+{
+	// A unit square, clipped down the middle.
+	Vector_t Square[4] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+	CWindingClipper Clipper;
+	Clipper.Init( Square, 4 );
+
+	Plane_t Half = { { 1, 0, 0 }, 0.5f };
+	CHECK( Clipper.Clip( &Half ) );
+	CHECK( Clipper.GetPointCount() == 4 );
+
+	Vector_t Points[WINDING_CLIPPER_MAX_POINTS];
+	Clipper.GetPoints( Points );
+	for ( int i = 0; i < 4; i++ )
+	{
+		CHECK( Points[i].x >= 0.5f );
+	}
+
+	// Points within SPLIT_EPSILON of the plane count as on it and are kept.
+	Plane_t Edge = { { 1, 0, 0 }, 0.505f };
+	CHECK( Clipper.Clip( &Edge ) );
+	CHECK( Clipper.GetPointCount() == 4 );
+
+	// Everything behind the plane clips it all away.
+	Plane_t Beyond = { { 1, 0, 0 }, 2 };
+	CHECK( !Clipper.Clip( &Beyond ) );
+	CHECK( Clipper.GetPointCount() == 0 );
+	CHECK( !Clipper.IsOverflowed() );
+
+	// A polygon with too many points to clip is given up on, where ClipWinding
+	// would have run off the end of its arrays.
+	Vector_t Circle[WINDING_CLIPPER_MAX_POINTS];
+	for ( int i = 0; i < WINDING_CLIPPER_MAX_POINTS; i++ )
+	{
+		float flAngle = 2 * 3.14159265f * i / WINDING_CLIPPER_MAX_POINTS;
+		Circle[i].x = cosf( flAngle ) * 100;
+		Circle[i].y = sinf( flAngle ) * 100;
+		Circle[i].z = 0;
+	}
+	Clipper.Init( Circle, WINDING_CLIPPER_MAX_POINTS );
+	CHECK( !Clipper.Clip( &Half ) );
+	CHECK( Clipper.IsOverflowed() );
+}
+
+static void TestChoosePlanes( void )
+{
+	Solid_t Solid;
+	Vector_t Up = { 0, 0, 1 };
+	Vector_t Zero = { 0, 0, 0 };
+	AddPlane( Solid, Up, 64 );
+	AddPlane( Solid, Zero, 0 );
+	AddPlane( Solid, Up, 64.005f );		// Duplicates the first.
+	AddPlane( Solid, Up, 64.002f );		// Duplicates the first and third.
+	AddPlane( Solid, Up, NAN );
+
+	bool useplane[MAX_FACES];
+	SolidFromPlanesDist_t sorted[MAX_FACES];
+	int rank[MAX_FACES];
+	SolidFromPlanes_ChoosePlanes( &Solid, useplane, sorted, rank );
+
+	CHECK( !useplane[0] );
+	CHECK( !useplane[1] );
+	CHECK( useplane[2] );		// Only the first earlier duplicate is dropped.
+	CHECK( useplane[3] );
+	CHECK( useplane[4] );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds a million random convex brushes of 6 to 12 planes with
+//			each builder, in batches generated before they are timed.
+//-----------------------------------------------------------------------------
+static void Benchmark( void )
+{
+	const int nBrushes = 1000000;
+	const int nBatch = 10000;
+
+	CWindingClipper Clipper;
+	BuiltSolid_t Old;
+	BuiltSolid_t New;
+	std::vector<Solid_t> Solids( nBatch );
+
+	double flOldMS = 0;
+	double flNewMS = 0;
+	int nOldFaces = 0;
+	int nNewFaces = 0;
+
+	for ( int nDone = 0; nDone < nBrushes; nDone += nBatch )
+	{
+		for ( int i = 0; i < nBatch; i++ )
+		{
+			Solids[i].m_Faces.clear();
+			if ( RandomInt( 0, 1 ) == 0 )
+			{
+				AddBox( Solids[i] );
+				for ( int j = RandomInt( 0, 6 ); j > 0; j-- )
+				{
+					AddGridPlane( Solids[i] );
+				}
+			}
+			else
+			{
+				AddRandomConvex( Solids[i], RandomInt( 6, 12 ) );
+			}
+		}
+
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		for ( int i = 0; i < nBatch; i++ )
+		{
+			OldBuild( Solids[i], Old );
+			nOldFaces += (int)Old.Faces.size();
+		}
+		flOldMS += MS( Start );
+
+		Start = std::chrono::steady_clock::now();
+		for ( int i = 0; i < nBatch; i++ )
+		{
+			NewBuild( Solids[i], Clipper, New );
+			nNewFaces += (int)New.Faces.size();
+		}
+		flNewMS += MS( Start );
+	}
+
+	CHECK( nOldFaces == nNewFaces );
+
+	printf( "%d random convex brushes, %d faces:\n", nBrushes, nNewFaces );
+	printf( "  ClipWinding builder: %8.0f ms\n", flOldMS );
+	printf( "  CWindingClipper:     %8.0f ms\n", flNewMS );
+}
+
+int main( void )
+{
+	TestClipper();
+	TestChoosePlanes();
+	TestFuzz();
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All solid from planes tests passed\n" );
+
+	Benchmark();
+	return ( g_nFailures != 0 ) ? 1 : 0;
+}
@@ -75,33 +75,38 @@ bool			g_bUpdateBones2D = true;
 // Model meshes themselves are cached to avoid redundancy. There should never be
 // more than one copy of a given studio model in memory at once.
 //-----------------------------------------------------------------------------
-ModelCache_t CStudioModelCache::m_Cache[65536];
-int CStudioModelCache::m_nItems = 0;
+CUtlLinkedList<ModelCache_t, int> CStudioModelCache::m_Cache;
+CTextureNameMap<int> CStudioModelCache::m_PathIndex;
+CUtlHashtable<StudioModel *, int> CStudioModelCache::m_ModelIndex;
+
+CUtlVector<ModelQueueEntry_t> CStudioModelCache::m_Queue;
+int CStudioModelCache::m_nQueueHead = 0;
+int CStudioModelCache::m_nPrefetchHead = 0;
+int CStudioModelCache::m_nQueuedLoadDepth = 0;
+bool CStudioModelCache::m_bQueuedLoadEnabled = true;
+bool CStudioModelCache::m_bNotifyPending = false;
+double CStudioModelCache::m_flLastNotifyTime = 0;
 
 //-----------------------------------------------------------------------------
 // Purpose: Find a model in the cache. Returns null if it's not in the cache.
 //-----------------------------------------------------------------------------
 StudioModel *CStudioModelCache::FindModel(const char *pszModelPath)
 {
-	char testPath[MAX_PATH];
-	V_strncpy( testPath, pszModelPath, sizeof( testPath ) );
-	V_FixSlashes( testPath );
-		
 	//
 	// First look for the model in the cache. If it's there, increment the
 	// reference count and return a pointer to the cached model.
 	//
-	for (int i = 0; i < m_nItems; i++)
+	int nIndex;
+	if (m_PathIndex.Find(pszModelPath, nIndex))
 	{
-		char testPath2[MAX_PATH];
-		V_strncpy( testPath2, m_Cache[i].pszPath, sizeof( testPath2 ) );
-		V_FixSlashes( testPath2 );
-		
-		if (!stricmp(testPath, testPath2))
+		// Load it again rather than share a model whose queued load failed.
+		if (m_Cache[nIndex].pModel->HasLoadFailed())
 		{
-			m_Cache[i].nRefCount++;
-			return(m_Cache[i].pModel);
+			return NULL;
 		}
+
+		m_Cache[nIndex].nRefCount++;
+		return(m_Cache[nIndex].pModel);
 	}
 	
 	return NULL;
@@ -112,31 +117,32 @@ StudioModel *CStudioModelCache::FindModel(const char *pszModelPath)
 //-----------------------------------------------------------------------------
 void CStudioModelCache::ReloadModel(const char *pszModelPath)
 {
-	// Fix up our name to match what will be in the cache
-	char testPath[MAX_PATH];
-	V_strncpy(testPath, pszModelPath, sizeof(testPath));
-	V_FixSlashes(testPath);
-
-	// Look through all models in the cache, updating them as we find them
-	for (int i = 0; i < m_nItems; i++)
+	int nIndex;
+	if (!m_PathIndex.Find(pszModelPath, nIndex))
 	{
-		char testPath2[MAX_PATH];
-		V_strncpy(testPath2, m_Cache[i].pszPath, sizeof(testPath2));
-		V_FixSlashes(testPath2);
+		return;
+	}
 
-		// If it's a match, reload it
-		if (!stricmp(testPath, testPath2))
+	// Walk every model loaded from this path, updating them as we find them
+	for (; nIndex != -1; nIndex = m_Cache[nIndex].nNextSamePath)
+	{
+		// Models still in the load queue will read the new files when they load.
+		if (m_Cache[nIndex].nQueueSlot != -1)
 		{
-			m_Cache[i].pModel->FreeModel();
-			m_Cache[i].pModel->LoadModel(pszModelPath);
+			continue;
 		}
+
+		m_Cache[nIndex].pModel->FreeModel();
+		m_Cache[nIndex].pModel->LoadModel(pszModelPath);
 	}
 }
 #endif
 //-----------------------------------------------------------------------------
 // Purpose: Returns an instance of a particular studio model. If the model is
 //			in the cache, a pointer to that model is returned. If not, a new one
-//			is created and added to the cache.
+//			is created and added to the cache. While a document is loading the
+//			new model is only queued, and is not resident until the main loop
+//			gets to it.
 // Input  : pszModelPath - Full path of the .MDL file.
 //-----------------------------------------------------------------------------
 StudioModel *CStudioModelCache::CreateModel(const char *pszModelPath)
@@ -148,6 +154,14 @@ StudioModel *CStudioModelCache::CreateModel(const char *pszModelPath)
 	if ( pTest )
 		return pTest;
 #endif
+	if ((m_nQueuedLoadDepth > 0) && m_bQueuedLoadEnabled && (g_pStudioRender != NULL))
+	{
+		StudioModel *pModel = new StudioModel;
+		CStudioModelCache::AddModel(pModel, pszModelPath);
+		QueueModel(pModel);
+		return(pModel);
+	}
+
 	//
 	// If it isn't there, try to create one.
 	//
@@ -190,38 +204,127 @@ StudioModel *CStudioModelCache::CreateModel(const char *pszModelPath)
 //-----------------------------------------------------------------------------
 BOOL CStudioModelCache::AddModel(StudioModel *pModel, const char *pszModelPath)
 {
+	int nIndex = m_Cache.AddToTail();
+	ModelCache_t &Entry = m_Cache[nIndex];
+
 	//
 	// Copy the model pointer.
 	//
-	m_Cache[m_nItems].pModel = pModel;
+	Entry.pModel = pModel;
 
 	//
 	// Allocate space for and copy the model path.
 	//
-	m_Cache[m_nItems].pszPath = new char [strlen(pszModelPath) + 1];
-	if (m_Cache[m_nItems].pszPath != NULL)
+	Entry.pszPath = new char [strlen(pszModelPath) + 1];
+	if (Entry.pszPath != NULL)
 	{
-		strcpy(m_Cache[m_nItems].pszPath, pszModelPath);
+		strcpy(Entry.pszPath, pszModelPath);
 	}
 	else
 	{
+		m_Cache.Remove(nIndex);
 		return(FALSE);
 	}
 
-	m_Cache[m_nItems].nRefCount = 1;
+	Entry.nRefCount = 1;
+	Entry.nQueueSlot = -1;
+	Entry.nPrevSamePath = -1;
+	Entry.nNextSamePath = -1;
+
+	//
+	// Put the model at the head of the list of models with this path.
+	//
+	int nHead;
+	if (m_PathIndex.Find(pszModelPath, nHead))
+	{
+		Entry.nNextSamePath = nHead;
+		m_Cache[nHead].nPrevSamePath = nIndex;
+		m_PathIndex.Replace(pszModelPath, nIndex);
+	}
+	else
+	{
+		m_PathIndex.Insert(pszModelPath, nIndex);
+	}
 
-	m_nItems++;
+	m_ModelIndex.Insert(pModel, nIndex);
 
 	return(TRUE);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Frees a model that is no longer referenced and removes it from the
+//			cache and the load queue.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::RemoveModel(StudioModel *pModel)
+{
+	int nIndex = FindEntry(pModel);
+	if (nIndex == -1)
+	{
+		return;
+	}
+
+	ModelCache_t &Entry = m_Cache[nIndex];
+
+	if (Entry.nQueueSlot != -1)
+	{
+		ModelQueueEntry_t &QueueEntry = m_Queue[Entry.nQueueSlot];
+		FinishPrefetch(QueueEntry, true);
+		QueueEntry.pModel = NULL;
+	}
+
+	//
+	// Unlink the model from the other models with the same path.
+	//
+	if (Entry.nPrevSamePath != -1)
+	{
+		m_Cache[Entry.nPrevSamePath].nNextSamePath = Entry.nNextSamePath;
+	}
+	else if (Entry.nNextSamePath != -1)
+	{
+		m_PathIndex.Replace(Entry.pszPath, Entry.nNextSamePath);
+	}
+	else
+	{
+		m_PathIndex.Remove(Entry.pszPath);
+	}
+
+	if (Entry.nNextSamePath != -1)
+	{
+		m_Cache[Entry.nNextSamePath].nPrevSamePath = Entry.nPrevSamePath;
+	}
+
+	m_ModelIndex.Remove(pModel);
+
+	//
+	// Free the path, which was allocated by AddModel.
+	//
+	delete [] Entry.pszPath;
+	delete Entry.pModel;
+
+	m_Cache.Remove(nIndex);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the cache entry holding a model, or -1.
+//-----------------------------------------------------------------------------
+int CStudioModelCache::FindEntry(StudioModel *pModel)
+{
+	UtlHashHandle_t h = m_ModelIndex.Find(pModel);
+	if (h == m_ModelIndex.InvalidHandle())
+	{
+		return -1;
+	}
+
+	return m_ModelIndex[h];
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Advances the animation of all models in the cache for the given interval.
 // Input  : flInterval - delta time in seconds.
 //-----------------------------------------------------------------------------
 void CStudioModelCache::AdvanceAnimation(float flInterval)
 {
-	for (int i = 0; i < m_nItems; i++)
+	FOR_EACH_LL(m_Cache, i)
 	{
 		m_Cache[i].pModel->AdvanceFrame(flInterval);
 	}
@@ -235,14 +338,11 @@ void CStudioModelCache::AdvanceAnimation(float flInterval)
 //-----------------------------------------------------------------------------
 void CStudioModelCache::AddRef(StudioModel *pModel)
 {
-	for (int i = 0; i < m_nItems; i++)
+	int nIndex = FindEntry(pModel);
+	if (nIndex != -1)
 	{
-		if (m_Cache[i].pModel == pModel)
-		{
-			m_Cache[i].nRefCount++;
-			return;
-		}
-	}	
+		m_Cache[nIndex].nRefCount++;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -252,39 +352,297 @@ void CStudioModelCache::AddRef(StudioModel *pModel)
 //-----------------------------------------------------------------------------
 void CStudioModelCache::Release(StudioModel *pModel)
 {
-	for (int i = 0; i < m_nItems; i++)
+	int nIndex = FindEntry(pModel);
+	if (nIndex == -1)
+	{
+		return;
+	}
+
+	m_Cache[nIndex].nRefCount--;
+	Assert(m_Cache[nIndex].nRefCount >= 0);
+
+	//
+	// If this model is no longer referenced, free it and remove it
+	// from the cache.
+	//
+	if (m_Cache[nIndex].nRefCount <= 0)
+	{
+		RemoveModel(pModel);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts queuing the models created from here on. Called when a
+//			document starts loading; calls may nest.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::BeginQueuedLoad(void)
+{
+	m_nQueuedLoadDepth++;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Ends a BeginQueuedLoad.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::EndQueuedLoad(void)
+{
+	Assert(m_nQueuedLoadDepth > 0);
+	m_nQueuedLoadDepth--;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Turns the load queue off, so every model loads when it is created.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::SetQueuedLoadEnabled(bool bEnabled)
+{
+	m_bQueuedLoadEnabled = bEnabled;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the number of queue slots that have not been loaded yet,
+//			including models released while they waited.
+//-----------------------------------------------------------------------------
+int CStudioModelCache::GetQueuedLoadCount(void)
+{
+	return m_Queue.Count() - m_nQueueHead;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a placeholder model to the end of the load queue.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::QueueModel(StudioModel *pModel)
+{
+	int nIndex = FindEntry(pModel);
+	if (nIndex == -1)
+	{
+		return;
+	}
+
+	int nSlot = m_Queue.AddToTail();
+	ModelQueueEntry_t &QueueEntry = m_Queue[nSlot];
+	QueueEntry.pModel = pModel;
+	QueueEntry.bPrefetchStarted = false;
+	for (int i = 0; i < MODELQUEUE_PREFETCH_FILES; i++)
+	{
+		QueueEntry.hPrefetch[i] = NULL;
+	}
+
+	m_Cache[nIndex].nQueueSlot = nSlot;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the model's files on the filesystem's worker threads, so the
+//			load on the main thread finds them in the OS cache instead of
+//			waiting on the disk.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::StartPrefetch(ModelQueueEntry_t &QueueEntry, const char *pszModelPath)
+{
+	static const char *s_pszExtensions[MODELQUEUE_PREFETCH_FILES] = { ".mdl", ".vvd", ".dx90.vtx" };
+
+	char szBaseName[MAX_PATH];
+	V_StripExtension(pszModelPath, szBaseName, sizeof(szBaseName));
+
+	for (int i = 0; i < MODELQUEUE_PREFETCH_FILES; i++)
+	{
+		char szFileName[MAX_PATH];
+		V_snprintf(szFileName, sizeof(szFileName), "%s%s", szBaseName, s_pszExtensions[i]);
+
+		FileAsyncRequest_t Request;
+		Request.pszFilename = szFileName;
+		Request.pszPathID = "GAME";
+		Request.flags = FSASYNC_FLAGS_FREEDATAPTR;
+
+		if (g_pFullFileSystem->AsyncRead(Request, &QueueEntry.hPrefetch[i]) != FSASYNC_OK)
+		{
+			QueueEntry.hPrefetch[i] = NULL;
+		}
+	}
+
+	QueueEntry.bPrefetchStarted = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true once every read ahead for a queue slot has finished,
+//			whether or not the file was there.
+//-----------------------------------------------------------------------------
+bool CStudioModelCache::IsPrefetchDone(const ModelQueueEntry_t &QueueEntry)
+{
+	for (int i = 0; i < MODELQUEUE_PREFETCH_FILES; i++)
 	{
-		if (m_Cache[i].pModel == pModel)
+		if (QueueEntry.hPrefetch[i] == NULL)
 		{
-			m_Cache[i].nRefCount--;
-			Assert(m_Cache[i].nRefCount >= 0);
+			continue;
+		}
+
+		FSAsyncStatus_t eStatus = g_pFullFileSystem->AsyncStatus(QueueEntry.hPrefetch[i]);
+		if ((eStatus == FSASYNC_STATUS_PENDING) || (eStatus == FSASYNC_STATUS_INPROGRESS) || (eStatus == FSASYNC_STATUS_UNSERVICED))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Releases the read aheads of a queue slot, aborting any that are
+//			still running if bAbort is set.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::FinishPrefetch(ModelQueueEntry_t &QueueEntry, bool bAbort)
+{
+	for (int i = 0; i < MODELQUEUE_PREFETCH_FILES; i++)
+	{
+		if (QueueEntry.hPrefetch[i] != NULL)
+		{
+			if (bAbort)
+			{
+				g_pFullFileSystem->AsyncAbort(QueueEntry.hPrefetch[i]);
+			}
+
+			g_pFullFileSystem->AsyncRelease(QueueEntry.hPrefetch[i]);
+			QueueEntry.hPrefetch[i] = NULL;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads a model that was waiting in the queue.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::LoadQueuedModel(StudioModel *pModel)
+{
+	int nIndex = FindEntry(pModel);
+	if (nIndex == -1)
+	{
+		return;
+	}
+
+	ModelCache_t &Entry = m_Cache[nIndex];
+	Entry.nQueueSlot = -1;
+
+	// The file change watcher may have loaded it already.
+	if (!pModel->IsResident())
+	{
+		// PostLoadModel resets the sequence, so keep any that was set on the placeholder.
+		int nSequence = pModel->GetSequence();
 
+		bool bLoaded = pModel->LoadModel(Entry.pszPath);
+		if (bLoaded)
+		{
+			bLoaded = pModel->PostLoadModel(Entry.pszPath);
+		}
+
+		if (bLoaded)
+		{
+			pModel->SetSequence(nSequence);
+		}
+		else
+		{
+			// Stays a placeholder until CMapStudioModel::UpdateQueuedModels
+			// replaces the helpers that use it.
+			pModel->FreeModel();
+			pModel->SetLoadFailed(true);
+		}
+	}
+
+	m_bNotifyPending = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads queued models, in the order they were created, until the
+//			frame budget runs out. Called every time through the main loop.
+// Output : Returns true if models became resident since the last time this
+//			returned true; the caller should then update the documents.
+//-----------------------------------------------------------------------------
+bool CStudioModelCache::UpdateQueuedLoads(void)
+{
+	if (m_nQueueHead < m_Queue.Count())
+	{
+		double flStartTime = Plat_FloatTime();
+
+		do
+		{
 			//
-			// If this model is no longer referenced, free it and remove it
-			// from the cache.
+			// Keep the files of the next few models streaming in.
 			//
-			if (m_Cache[i].nRefCount <= 0)
+			int nPrefetchEnd = min(m_nQueueHead + MODELQUEUE_PREFETCH_COUNT, m_Queue.Count());
+			for (; m_nPrefetchHead < nPrefetchEnd; m_nPrefetchHead++)
 			{
-				//
-				// Free the path, which was allocated by AddModel.
-				//
-				delete [] m_Cache[i].pszPath;
-				delete m_Cache[i].pModel;
-
-				//
-				// Decrement the item count and copy the last element in the cache over
-				// this element.
-				//
-				m_nItems--;
-
-				m_Cache[i].pModel = m_Cache[m_nItems].pModel;
-				m_Cache[i].pszPath = m_Cache[m_nItems].pszPath;
-				m_Cache[i].nRefCount = m_Cache[m_nItems].nRefCount;
+				ModelQueueEntry_t &QueueEntry = m_Queue[m_nPrefetchHead];
+				if (QueueEntry.pModel != NULL)
+				{
+					StartPrefetch(QueueEntry, m_Cache[FindEntry(QueueEntry.pModel)].pszPath);
+				}
 			}
 
-			break;
+			//
+			// Don't block on the disk; try again next frame.
+			//
+			ModelQueueEntry_t &QueueEntry = m_Queue[m_nQueueHead];
+			if ((QueueEntry.pModel != NULL) && !IsPrefetchDone(QueueEntry))
+			{
+				break;
+			}
+
+			FinishPrefetch(QueueEntry, false);
+
+			StudioModel *pModel = QueueEntry.pModel;
+			m_nQueueHead++;
+
+			if (pModel != NULL)
+			{
+				LoadQueuedModel(pModel);
+			}
+		} while ((m_nQueueHead < m_Queue.Count()) && (Plat_FloatTime() - flStartTime < MODELQUEUE_FRAME_BUDGET));
+
+		if (m_nQueueHead == m_Queue.Count())
+		{
+			m_Queue.Purge();
+			m_nQueueHead = 0;
+			m_nPrefetchHead = 0;
 		}
-	}	
+	}
+
+	//
+	// Update the views as the models come in, but not every frame.
+	//
+	if (m_bNotifyPending)
+	{
+		double flTime = Plat_FloatTime();
+		if ((m_Queue.Count() == 0) || (flTime - m_flLastNotifyTime >= MODELQUEUE_NOTIFY_INTERVAL))
+		{
+			m_bNotifyPending = false;
+			m_flLastNotifyTime = flTime;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Empties the load queue, leaving the models in it as placeholders.
+//			Called at shutdown so no reads are left running.
+//-----------------------------------------------------------------------------
+void CStudioModelCache::CancelQueuedLoads(void)
+{
+	for (int i = m_nQueueHead; i < m_Queue.Count(); i++)
+	{
+		ModelQueueEntry_t &QueueEntry = m_Queue[i];
+		FinishPrefetch(QueueEntry, true);
+
+		if (QueueEntry.pModel != NULL)
+		{
+			int nIndex = FindEntry(QueueEntry.pModel);
+			if (nIndex != -1)
+			{
+				m_Cache[nIndex].nQueueSlot = -1;
+			}
+		}
+	}
+
+	m_Queue.Purge();
+	m_nQueueHead = 0;
+	m_nPrefetchHead = 0;
+	m_bNotifyPending = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -449,6 +807,7 @@ StudioModel::StudioModel(void) : m_pModelName(0)
 	m_pStudioHdr = NULL;
 	m_pPosePos = NULL;
 	m_pPoseAng = NULL;
+	m_bLoadFailed = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -484,6 +843,9 @@ void StudioModel::AdvanceFrame( float dt )
 		dt = 0.1f;
 
 	CStudioHdr *pStudioHdr = GetStudioHdr();
+	if (!pStudioHdr)
+		return;
+
 	float t = Studio_Duration( pStudioHdr, m_sequence, m_poseParameter );
 
 	if (t > 0)
@@ -522,6 +884,8 @@ float GetRealtimeTime(void)
 void StudioModel::SetUpBones( bool bUpdatePose, matrix3x4_t *pBoneToWorld )
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
+	if ( !pStudioHdr )
+		return;
 
 	if ( m_pPosePos == NULL )
 	{
@@ -1024,16 +1388,27 @@ bool StudioModel::IsTranslucent()
 //-----------------------------------------------------------------------------
 void StudioModel::FreeModel(void)
 {
-	/*int nRef = */g_pMDLCache->Release( m_MDLHandle );
-//	Assert( nRef == 0 );
+	if (m_MDLHandle != MDLHANDLE_INVALID)
+	{
+		/*int nRef = */g_pMDLCache->Release( m_MDLHandle );
+//		Assert( nRef == 0 );
+	}
 	m_MDLHandle = MDLHANDLE_INVALID;
 	m_pModel = NULL;
+
+	// The header points into the data that was just released.
+	delete m_pStudioHdr;
+	m_pStudioHdr = NULL;
 }
 
 CStudioHdr *StudioModel::GetStudioHdr() const
 {
 	// return g_pMDLCache->GetStudioHdr( m_MDLHandle );
 
+	// Not loaded yet.
+	if (!m_pStudioHdr)
+		return NULL;
+
 	if (m_pStudioHdr->IsValid())
 		return m_pStudioHdr;
 
@@ -1059,6 +1434,9 @@ studiohdr_t *StudioModel::GetStudioRenderHdr() const
 
 studiohwdata_t* StudioModel::GetHardwareData()
 {
+	if (!IsResident())
+		return NULL;
+
 	return g_pMDLCache->GetHardwareData( m_MDLHandle );
 }
 
@@ -1139,6 +1517,9 @@ bool StudioModel::PostLoadModel(const char *modelname)
 int StudioModel::GetSequenceCount( void )
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
+	if (!pStudioHdr)
+		return 0;
+
 	return pStudioHdr->GetNumSeq();
 }
 
@@ -1150,7 +1531,7 @@ int StudioModel::GetSequenceCount( void )
 void StudioModel::GetSequenceName( int nIndex, char *szName )
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
-	if (nIndex < pStudioHdr->GetNumSeq())
+	if (pStudioHdr && (nIndex < pStudioHdr->GetNumSeq()))
 	{
 		strcpy(szName, pStudioHdr->pSeqdesc(nIndex).pszLabel());
 	}
@@ -1170,6 +1551,14 @@ int StudioModel::GetSequence( )
 int StudioModel::SetSequence( int iSequence )
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
+
+	// Placeholders keep the sequence until they load.
+	if (!pStudioHdr)
+	{
+		m_sequence = iSequence;
+		return m_sequence;
+	}
+
 	if (iSequence > pStudioHdr->GetNumSeq())
 		return m_sequence;
 
@@ -1295,6 +1684,13 @@ void StudioModel::RotateBbox(Vector &Mins, Vector &Maxs, const QAngle &Angles)
 void StudioModel::ExtractBbox(Vector &mins, Vector &maxs)
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
+	if (!pStudioHdr)
+	{
+		mins.Init();
+		maxs.Init();
+		return;
+	}
+
 	mstudioseqdesc_t	&seqdesc = pStudioHdr->pSeqdesc( m_sequence );
 	
 	mins = seqdesc.bbmin;
@@ -1312,6 +1708,13 @@ void StudioModel::ExtractBbox(Vector &mins, Vector &maxs)
 void StudioModel::ExtractClippingBbox( Vector& mins, Vector& maxs )
 {
 	studiohdr_t *pStudioHdr = GetStudioRenderHdr();
+	if (!pStudioHdr)
+	{
+		mins.Init();
+		maxs.Init();
+		return;
+	}
+
 	mins[0] = pStudioHdr->view_bbmin[0];
 	mins[1] = pStudioHdr->view_bbmin[1];
 	mins[2] = pStudioHdr->view_bbmin[2];
@@ -1329,6 +1732,13 @@ void StudioModel::ExtractClippingBbox( Vector& mins, Vector& maxs )
 void StudioModel::ExtractMovementBbox( Vector& mins, Vector& maxs )
 {
 	studiohdr_t *pStudioHdr = GetStudioRenderHdr();
+	if (!pStudioHdr)
+	{
+		mins.Init();
+		maxs.Init();
+		return;
+	}
+
 	mins[0] = pStudioHdr->hull_min[0];
 	mins[1] = pStudioHdr->hull_min[1];
 	mins[2] = pStudioHdr->hull_min[2];
@@ -1346,7 +1756,7 @@ void StudioModel::ExtractMovementBbox( Vector& mins, Vector& maxs )
 void StudioModel::GetSequenceInfo( float *pflFrameRate, float *pflGroundSpeed )
 {
 	CStudioHdr *pStudioHdr = GetStudioHdr();
-	float t = Studio_Duration( pStudioHdr, m_sequence, m_poseParameter );
+	float t = pStudioHdr ? Studio_Duration( pStudioHdr, m_sequence, m_poseParameter ) : 0;
 
 	if (t > 0)
 	{
@@ -20,6 +20,9 @@ typedef unsigned char byte;
 #include "utlvector.h"
 #include "datacache/imdlcache.h"
 #include "FileChangeWatcher.h"
+#include "utllinkedlist.h"
+#include "filesystem.h"
+#include "TextureNameMap.h"
 
 class StudioModel;
 class CMaterial;
@@ -31,6 +34,25 @@ struct ModelCache_t
 	StudioModel *pModel;
 	char *pszPath;
 	int nRefCount;
+	int nPrevSamePath;		// Other cache entries with the same path, or -1. Only SLE
+	int nNextSamePath;		// keeps more than one model per path.
+	int nQueueSlot;			// Slot in the load queue while the model waits to load, or -1.
+};
+
+//
+// Models created while a document loads are queued and loaded from the main
+// loop a few at a time. Until then they are placeholders that draw as boxes.
+//
+#define MODELQUEUE_FRAME_BUDGET		0.010	// Seconds per frame spent loading queued models.
+#define MODELQUEUE_PREFETCH_COUNT	32		// Queued models whose files are read ahead of the load.
+#define MODELQUEUE_PREFETCH_FILES	3		// .mdl, .vvd and .dx90.vtx
+#define MODELQUEUE_NOTIFY_INTERVAL	0.5		// Seconds between view updates while models load.
+
+struct ModelQueueEntry_t
+{
+	StudioModel *pModel;								// NULL if the model was released before it loaded.
+	FSAsyncControl_t hPrefetch[MODELQUEUE_PREFETCH_FILES];	// Reads that pull the model files into the OS cache.
+	bool bPrefetchStarted;
 };
 
 //-----------------------------------------------------------------------------
@@ -48,15 +70,40 @@ class CStudioModelCache
 		static void Release(StudioModel *pModel);
 		static void AdvanceAnimation(float flInterval);
 
+		// Models created between these calls are queued rather than loaded. Nests.
+		static void BeginQueuedLoad(void);
+		static void EndQueuedLoad(void);
+		static void SetQueuedLoadEnabled(bool bEnabled);
+		static bool IsQueuedLoadEnabled(void) { return m_bQueuedLoadEnabled; }
+
+		// Loads queued models for up to MODELQUEUE_FRAME_BUDGET. Returns true
+		// when models have become resident since the views were last updated.
+		static bool UpdateQueuedLoads(void);
+		static void CancelQueuedLoads(void);
+		static int GetQueuedLoadCount(void);
+
 	protected:
 		static BOOL AddModel(StudioModel *pModel, const char *pszModelPath);
 		static void RemoveModel(StudioModel *pModel);
-#ifdef SLE
-		static ModelCache_t m_Cache[65536];
-#else
-		static ModelCache_t m_Cache[1024];
-#endif
-		static int m_nItems;
+		static int FindEntry(StudioModel *pModel);
+
+		static void QueueModel(StudioModel *pModel);
+		static void StartPrefetch(ModelQueueEntry_t &QueueEntry, const char *pszModelPath);
+		static bool IsPrefetchDone(const ModelQueueEntry_t &QueueEntry);
+		static void FinishPrefetch(ModelQueueEntry_t &QueueEntry, bool bAbort);
+		static void LoadQueuedModel(StudioModel *pModel);
+
+		static CUtlLinkedList<ModelCache_t, int> m_Cache;
+		static CTextureNameMap<int> m_PathIndex;			// First cache entry for each model path.
+		static CUtlHashtable<StudioModel *, int> m_ModelIndex;	// Cache entry of each model.
+
+		static CUtlVector<ModelQueueEntry_t> m_Queue;
+		static int m_nQueueHead;						// Next queue slot to load.
+		static int m_nPrefetchHead;						// Next queue slot to start reading ahead.
+		static int m_nQueuedLoadDepth;
+		static bool m_bQueuedLoadEnabled;
+		static bool m_bNotifyPending;
+		static double m_flLastNotifyTime;
 };
 
 // Calling these will monitor the filesystem for changes to model files and automatically 
@@ -76,6 +123,15 @@ public:
 	void FreeModel ();
 	bool LoadModel(const char *modelname);
 	bool PostLoadModel (const char *modelname);
+
+	// False while the model is a placeholder waiting in the load queue, or if
+	// it failed to load. Drawing and bounds queries do nothing until then.
+	bool IsResident(void) const { return m_pStudioHdr != NULL; }
+
+	// Set when a queued load fails. The objects using the model then get the
+	// helpers they would have had if the model had been loaded synchronously.
+	bool HasLoadFailed(void) const { return m_bLoadFailed; }
+	void SetLoadFailed(bool bFailed) { m_bLoadFailed = bFailed; }
 #ifdef SLE
 #ifdef HAMMER2013_PORT_PROXIES
 	void DrawModel3D(CRender3D *pRender, const Color &color, float flAlpha, bool bWireframe, bool bSelectionOverlay = false, CMapClass* pParent = nullptr);
@@ -224,6 +280,7 @@ private:
 #endif
 	Vector					*m_pPosePos;
 	Quaternion				*m_pPoseAng;
+	bool					m_bLoadFailed;		// A queued load of this model failed.
 
 	// internal data
 	MDLHandle_t				m_MDLHandle;
@@ -94,27 +94,20 @@ void CTextureConverter::ConvertWorldTextures( CMapWorld * pWorld )
 //-----------------------------------------------------------------------------
 void CTextureConverter::ConvertSolids( CMapWorld * pWorld )
 {
+	CMapTypeList<CMapSolid> Solids = pWorld->GetObjectsOfType<CMapSolid>();
+
 	// Count total map solids so we know how many we have to do (for progress meter).
-	pWorld->EnumChildren( ENUMMAPCHILDRENPROC( CountMapSolids ), 0, MAPCLASS_TYPE( CMapSolid ) );
+	m_nSolidCount += Solids.Count();
 
 	m_pProgDlg->SetRange( 0, m_nSolidCount );
 	m_pProgDlg->SetStep( 2 );
 	m_pProgDlg->SetWindowText( "Converting solids..." );
 
-	// Cycle through the solids again and convert as necessary.
-	pWorld->EnumChildren( ENUMMAPCHILDRENPROC( CheckSolidTextures ), 0, MAPCLASS_TYPE( CMapSolid ) );
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: Enumeration function, increment the solids counter.
-// Input  : 
-// Output : Always return true to continue enumerating.
-//-----------------------------------------------------------------------------
-bool CTextureConverter::CountMapSolids( CMapSolid *, DWORD )
-{
-	m_nSolidCount++;
-
-	return true;	// return true to continue enumerating
+	// Cycle through the solids and convert as necessary.
+	for ( int i = 0; i < Solids.Count(); i++ )
+	{
+		CheckSolidTextures( Solids[i], 0 );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -246,15 +239,23 @@ void CTextureConverter::ConvertFaceTexture( CMapFace * pFace )
 //-----------------------------------------------------------------------------
 void CTextureConverter::ConvertDecals( CMapWorld * pWorld )
 {
+	CMapTypeList<CMapEntity> Entities = pWorld->GetObjectsOfType<CMapEntity>();
+
 	// Count total map decals so we know how many we have to do (for progress meter).
-	pWorld->EnumChildren( ENUMMAPCHILDRENPROC( CountMapDecals ), 0, MAPCLASS_TYPE( CMapEntity ) );
+	for ( int i = 0; i < Entities.Count(); i++ )
+	{
+		CountMapDecals( Entities[i], 0 );
+	}
 
 	m_pProgDlg->SetRange( 0, m_nDecalCount );
 	m_pProgDlg->SetStep( 3 );
 	m_pProgDlg->SetWindowText( "Converting decals..." );
 
-	// Cycle through the solids again and convert as necessary.
-	pWorld->EnumChildren( ENUMMAPCHILDRENPROC( CheckDecalTextures ), 0, MAPCLASS_TYPE( CMapEntity ) );
+	// Cycle through the decals again and convert as necessary.
+	for ( int i = 0; i < Entities.Count(); i++ )
+	{
+		CheckDecalTextures( Entities[i], 0 );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: The lookup form of texture and material names, shared by
+//			CTextureNameMap and anything else that compares names the way
+//			it does. Kept free of tier1 so it can be tested standalone:
+//
+//			g++ -O2 TextureName_test.cpp -o TextureName_test && ./TextureName_test
+//
+//=============================================================================//
+
+#ifndef TEXTURENAME_H
+#define TEXTURENAME_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the lookup form of a name: lower case, forward slashes.
+//-----------------------------------------------------------------------------
+inline void NormalizeTextureName( const char *pszName, char *pszNormalized, int nSize )
+{
+	int i = 0;
+	for ( ; pszName[i] && ( i < nSize - 1 ); i++ )
+	{
+		char ch = pszName[i];
+		if ( ch == '\\' )
+		{
+			ch = '/';
+		}
+		else if ( ( ch >= 'A' ) && ( ch <= 'Z' ) )
+		{
+			ch = ch - 'A' + 'a';
+		}
+		pszNormalized[i] = ch;
+	}
+	pszNormalized[i] = '\0';
+}
+
+#endif // TEXTURENAME_H
@@ -0,0 +1,90 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Hash map keyed by texture or material name. Names are compared
+//			case insensitively and without regard to the kind of slash, so
+//			"Brick\BrickFloor01" and "brick/brickfloor01" find the same entry.
+//
+//=============================================================================//
+
+#ifndef TEXTURENAMEMAP_H
+#define TEXTURENAMEMAP_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlhashtable.h"
+#include "tier1/utlstring.h"
+#include "tier1/generichash.h"
+#include "tier1/strtools.h"
+#include "TextureName.h"
+
+struct TextureNameHashFunctor
+{
+	unsigned int operator()( const char *pszName ) const { return HashString( pszName ); }
+};
+
+struct TextureNameEqualFunctor
+{
+	bool operator()( const char *pszName1, const char *pszName2 ) const { return !Q_strcmp( pszName1, pszName2 ); }
+};
+
+template <class T>
+class CTextureNameMap
+{
+public:
+
+	// Returns true and fills out value if the name is in the map.
+	bool Find( const char *pszName, T &value ) const
+	{
+		char szKey[MAX_PATH];
+		NormalizeTextureName( pszName, szKey, sizeof( szKey ) );
+
+		UtlHashHandle_t h = m_Table.Find( szKey );
+		if ( h == m_Table.InvalidHandle() )
+		{
+			return false;
+		}
+
+		value = m_Table[h];
+		return true;
+	}
+
+	// Adds a name. If the name is already present the first value is kept,
+	// matching a front to back linear search.
+	void Insert( const char *pszName, const T &value )
+	{
+		char szKey[MAX_PATH];
+		NormalizeTextureName( pszName, szKey, sizeof( szKey ) );
+		m_Table.Insert( szKey, value );
+	}
+
+	// Changes the value of a name that is already in the map.
+	void Replace( const char *pszName, const T &value )
+	{
+		char szKey[MAX_PATH];
+		NormalizeTextureName( pszName, szKey, sizeof( szKey ) );
+
+		UtlHashHandle_t h = m_Table.Find( szKey );
+		if ( h != m_Table.InvalidHandle() )
+		{
+			m_Table[h] = value;
+		}
+	}
+
+	void Remove( const char *pszName )
+	{
+		char szKey[MAX_PATH];
+		NormalizeTextureName( pszName, szKey, sizeof( szKey ) );
+		m_Table.Remove( szKey );
+	}
+
+	void RemoveAll( void ) { m_Table.RemoveAll(); }
+	void Purge( void ) { m_Table.Purge(); }
+	int Count( void ) const { return m_Table.Count(); }
+
+private:
+
+	CUtlHashtable<CUtlString, T, TextureNameHashFunctor, TextureNameEqualFunctor, const char *> m_Table;
+};
+
+#endif // TEXTURENAMEMAP_H
@@ -0,0 +1,587 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of texture and material name lookups. Replays
+//			random lookups through the linear searches and case insensitive
+//			dictionary the editor used before CTextureNameMap, and through a
+//			map keyed by NormalizeTextureName as CTextureNameMap is, and
+//			checks that they resolve to the same entries. The one intended
+//			change is that slash direction no longer matters, so the old
+//			searches are also run with slashes folded, and the new lookups
+//			must match those exactly. With forward slashes only, the new
+//			lookups match the old ones except where the "textures" retry now
+//			finds a name it used to miss:
+//
+//			g++ -O2 TextureName_test.cpp -o TextureName_test && ./TextureName_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "TextureName.h"
+
+#define MAX_PATH	260
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+//-----------------------------------------------------------------------------
+// The old comparison: stricmp, optionally with slashes folded.
+//-----------------------------------------------------------------------------
+static bool OldNamesEqual( const std::string &Name1, const std::string &Name2, bool bFoldSlashes )
+{
+	if ( Name1.size() != Name2.size() )
+		return false;
+
+	for ( size_t i = 0; i < Name1.size(); i++ )
+	{
+		char ch1 = Name1[i];
+		char ch2 = Name2[i];
+		if ( ch1 >= 'A' && ch1 <= 'Z' )
+			ch1 = ch1 - 'A' + 'a';
+		if ( ch2 >= 'A' && ch2 <= 'Z' )
+			ch2 = ch2 - 'A' + 'a';
+		if ( bFoldSlashes )
+		{
+			if ( ch1 == '\\' )
+				ch1 = '/';
+			if ( ch2 == '\\' )
+				ch2 = '/';
+		}
+		if ( ch1 != ch2 )
+			return false;
+	}
+
+	return true;
+}
+
+//
+// Linear search for the first match, as the material cache and the dummy
+// texture list did, and as the group dictionary did for unique names.
+//
+static int OldFind( const std::vector<std::string> &Names, const std::string &Name, bool bFoldSlashes )
+{
+	for ( size_t i = 0; i < Names.size(); i++ )
+	{
+		if ( OldNamesEqual( Names[i], Name, bFoldSlashes ) )
+			return (int)i;
+	}
+	return -1;
+}
+
+static std::string Normalize( const std::string &Name )
+{
+	char szKey[MAX_PATH];
+	NormalizeTextureName( Name.c_str(), szKey, sizeof( szKey ) );
+	return szKey;
+}
+
+//-----------------------------------------------------------------------------
+// Stands in for CTextureNameMap: a map keyed by the normalized name, where
+// inserting a name that is already present keeps the first value.
+//-----------------------------------------------------------------------------
+class CNameMap
+{
+public:
+
+	bool Find( const std::string &Name, int &nValue ) const
+	{
+		std::map<std::string, int>::const_iterator it = m_Map.find( Normalize( Name ) );
+		if ( it == m_Map.end() )
+			return false;
+		nValue = it->second;
+		return true;
+	}
+
+	void Insert( const std::string &Name, int nValue ) { m_Map.insert( std::make_pair( Normalize( Name ), nValue ) ); }
+
+	void Replace( const std::string &Name, int nValue )
+	{
+		std::map<std::string, int>::iterator it = m_Map.find( Normalize( Name ) );
+		if ( it != m_Map.end() )
+			it->second = nValue;
+	}
+
+	void Remove( const std::string &Name ) { m_Map.erase( Normalize( Name ) ); }
+
+private:
+
+	std::map<std::string, int> m_Map;
+};
+
+static const char *s_pszParts[] = { "brick", "BrickFloor001a", "concrete", "Metal", "dev", "dev_measuregeneric01", "TOOLS", "toolsnodraw", "a", "A", "x_y" };
+
+//-----------------------------------------------------------------------------
+// A random texture path. bBackslashes allows backslash separators.
+//-----------------------------------------------------------------------------
+static std::string RandomName( bool bBackslashes )
+{
+	std::string Name;
+	int nParts = RandomInt( 1, 3 );
+	for ( int i = 0; i < nParts; i++ )
+	{
+		if ( i > 0 )
+		{
+			Name += ( bBackslashes && RandomInt( 0, 3 ) == 0 ) ? '\\' : '/';
+		}
+		Name += s_pszParts[RandomInt( 0, sizeof( s_pszParts ) / sizeof( s_pszParts[0] ) - 1 )];
+	}
+	return Name;
+}
+
+//
+// The same name as a caller might spell it: random case, and with
+// bBackslashes, random slash direction.
+//
+static std::string Respell( const std::string &Name, bool bBackslashes )
+{
+	std::string Out = Name;
+	for ( size_t i = 0; i < Out.size(); i++ )
+	{
+		char &ch = Out[i];
+		if ( RandomInt( 0, 2 ) == 0 )
+		{
+			if ( ch >= 'a' && ch <= 'z' )
+				ch = ch - 'a' + 'A';
+			else if ( ch >= 'A' && ch <= 'Z' )
+				ch = ch - 'A' + 'a';
+		}
+		if ( bBackslashes && ( ch == '/' || ch == '\\' ) && RandomInt( 0, 1 ) == 0 )
+		{
+			ch = ( ch == '/' ) ? '\\' : '/';
+		}
+	}
+	return Out;
+}
+
+//-----------------------------------------------------------------------------
+// NormalizeTextureName itself.
+//-----------------------------------------------------------------------------
+static void TestNormalize( void )
+{
+	CHECK( Normalize( "Brick\\BrickFloor01" ) == "brick/brickfloor01" );
+	CHECK( Normalize( "brick/brickfloor01" ) == "brick/brickfloor01" );
+	CHECK( Normalize( "" ) == "" );
+	CHECK( Normalize( "TOOLS\\\\ToolsNodraw" ) == "tools//toolsnodraw" );
+
+	// Only ASCII letters change case; other bytes pass through.
+	CHECK( Normalize( "A[Z]@_\xC4" ) == "a[z]@_\xC4" );
+
+	// Long names are cut to fit the buffer.
+	std::string Long( 400, 'X' );
+	CHECK( Normalize( Long ) == std::string( MAX_PATH - 1, 'x' ) );
+
+	char szSmall[4];
+	NormalizeTextureName( "ABCDEF", szSmall, sizeof( szSmall ) );
+	CHECK( !strcmp( szSmall, "abc" ) );
+}
+
+//-----------------------------------------------------------------------------
+// The texture group name lookup and the dummy texture list, driven the way
+// CTextureSystem::FindActiveTexture drives them: the name as given, with
+// forward slashes; then with a "textures" prefix; then the dummies.
+//-----------------------------------------------------------------------------
+struct FindResult_t
+{
+	int m_nGroup;	// Index into the group, or -1.
+	int m_nDummy;	// Index into the dummies, or -1.
+
+	bool operator==( const FindResult_t &Other ) const { return m_nGroup == Other.m_nGroup && m_nDummy == Other.m_nDummy; }
+};
+
+static FindResult_t OldFindActiveTexture( const std::vector<std::string> &Group, const std::vector<std::string> &Dummies, const std::string &InputName, bool bFoldSlashes )
+{
+	FindResult_t Result = { -1, -1 };
+
+	std::string Name = InputName;
+	for ( size_t i = 0; i < Name.size(); i++ )
+	{
+		if ( Name[i] == '\\' )
+			Name[i] = '/';
+	}
+
+	Result.m_nGroup = OldFind( Group, Name, bFoldSlashes );
+	if ( Result.m_nGroup != -1 )
+		return Result;
+
+	// The retry used backslashes and lower case.
+	std::string Decorated = "textures\\" + Name;
+	for ( size_t i = 0; i < Decorated.size(); i++ )
+	{
+		if ( Decorated[i] == '/' )
+			Decorated[i] = '\\';
+		else if ( Decorated[i] >= 'A' && Decorated[i] <= 'Z' )
+			Decorated[i] = Decorated[i] - 'A' + 'a';
+	}
+
+	Result.m_nGroup = OldFind( Group, Decorated, bFoldSlashes );
+	if ( Result.m_nGroup != -1 )
+		return Result;
+
+	Result.m_nDummy = OldFind( Dummies, Name, bFoldSlashes );
+	return Result;
+}
+
+static FindResult_t NewFindActiveTexture( const CNameMap &Group, const CNameMap &Dummies, const std::string &InputName )
+{
+	FindResult_t Result = { -1, -1 };
+
+	std::string Name = InputName;
+	for ( size_t i = 0; i < Name.size(); i++ )
+	{
+		if ( Name[i] == '\\' )
+			Name[i] = '/';
+	}
+
+	if ( Group.Find( Name, Result.m_nGroup ) )
+		return Result;
+
+	if ( Group.Find( "textures/" + Name, Result.m_nGroup ) )
+		return Result;
+
+	if ( !Dummies.Find( Name, Result.m_nDummy ) )
+	{
+		Result.m_nDummy = -1;
+	}
+	Result.m_nGroup = -1;
+	return Result;
+}
+
+static void TestFindActiveTexture( bool bBackslashes )
+{
+	int nFoundInGroup = 0;
+	int nFoundInDummies = 0;
+	int nChanged = 0;
+
+	for ( int nPass = 0; nPass < 200; nPass++ )
+	{
+		//
+		// Group names are unique, as they come from distinct files. Some carry
+		// the "textures" prefix that the retry looks for.
+		//
+		std::vector<std::string> GroupNames;
+		CNameMap Group;
+		int nGroupSize = RandomInt( 0, 40 );
+		while ( (int)GroupNames.size() < nGroupSize )
+		{
+			std::string Name = RandomName( bBackslashes );
+			if ( RandomInt( 0, 3 ) == 0 )
+			{
+				Name = ( bBackslashes && RandomInt( 0, 1 ) ) ? "textures\\" + Name : "textures/" + Name;
+			}
+
+			int nUnused;
+			if ( Group.Find( Name, nUnused ) )
+				continue;
+
+			Group.Insert( Name, (int)GroupNames.size() );
+			GroupNames.push_back( Name );
+		}
+
+		// Dummies can repeat; the first one wins.
+		std::vector<std::string> DummyNames;
+		CNameMap Dummies;
+		int nDummies = RandomInt( 0, 20 );
+		for ( int i = 0; i < nDummies; i++ )
+		{
+			std::string Name = ( i > 0 && RandomInt( 0, 4 ) == 0 ) ? Respell( DummyNames[RandomInt( 0, i - 1 )], bBackslashes ) : RandomName( bBackslashes );
+			Dummies.Insert( Name, i );
+			DummyNames.push_back( Name );
+		}
+
+		for ( int nQuery = 0; nQuery < 200; nQuery++ )
+		{
+			std::string Query;
+			int nKind = RandomInt( 0, 3 );
+			if ( nKind == 0 && !GroupNames.empty() )
+			{
+				Query = Respell( GroupNames[RandomInt( 0, (int)GroupNames.size() - 1 )], bBackslashes );
+			}
+			else if ( nKind == 1 && !DummyNames.empty() )
+			{
+				Query = Respell( DummyNames[RandomInt( 0, (int)DummyNames.size() - 1 )], bBackslashes );
+			}
+			else
+			{
+				Query = Respell( RandomName( bBackslashes ), bBackslashes );
+			}
+
+			FindResult_t Old = OldFindActiveTexture( GroupNames, DummyNames, Query, false );
+			FindResult_t OldFolded = OldFindActiveTexture( GroupNames, DummyNames, Query, true );
+			FindResult_t New = NewFindActiveTexture( Group, Dummies, Query );
+
+			CHECK( New == OldFolded );
+			if ( !( New == Old ) )
+			{
+				nChanged++;
+
+				//
+				// The old "textures" retry spelled the name with backslashes, so
+				// with forward slashes only it could never match. That retry is
+				// the one place that can answer differently here.
+				//
+				if ( !bBackslashes )
+				{
+					CHECK( Old.m_nGroup == -1 && New.m_nGroup != -1 );
+					CHECK( GroupNames[New.m_nGroup].compare( 0, 9, "textures/" ) == 0 );
+					CHECK( OldFind( GroupNames, Query, false ) == -1 );
+				}
+			}
+
+			nFoundInGroup += ( New.m_nGroup != -1 );
+			nFoundInDummies += ( New.m_nDummy != -1 );
+		}
+	}
+
+	CHECK( nFoundInGroup > 0 );
+	CHECK( nFoundInDummies > 0 );
+
+	// Slash folding should actually have changed some answers.
+	CHECK( nChanged > 0 );
+}
+
+//-----------------------------------------------------------------------------
+// The material cache: create (find or add), add references and release,
+// with entries swapped into the holes that releases leave.
+//-----------------------------------------------------------------------------
+struct CacheEntry_t
+{
+	int m_nMaterial;	// Stands in for the CMaterial pointer.
+	std::string m_Name;
+	int m_nRefCount;
+};
+
+class COldMaterialCache
+{
+public:
+
+	COldMaterialCache( bool bFoldSlashes ) : m_bFoldSlashes( bFoldSlashes ), m_nNextMaterial( 0 ) {}
+
+	int Create( const std::string &Name )
+	{
+		for ( size_t i = 0; i < m_Entries.size(); i++ )
+		{
+			if ( OldNamesEqual( m_Entries[i].m_Name, Name, m_bFoldSlashes ) )
+			{
+				AddRef( m_Entries[i].m_nMaterial );
+				return m_Entries[i].m_nMaterial;
+			}
+		}
+
+		CacheEntry_t Entry = { m_nNextMaterial++, Name, 1 };
+		m_Entries.push_back( Entry );
+		return Entry.m_nMaterial;
+	}
+
+	void AddRef( int nMaterial )
+	{
+		for ( size_t i = 0; i < m_Entries.size(); i++ )
+		{
+			if ( m_Entries[i].m_nMaterial == nMaterial )
+			{
+				m_Entries[i].m_nRefCount++;
+				return;
+			}
+		}
+	}
+
+	void Release( int nMaterial )
+	{
+		for ( size_t i = 0; i < m_Entries.size(); i++ )
+		{
+			if ( m_Entries[i].m_nMaterial == nMaterial )
+			{
+				if ( --m_Entries[i].m_nRefCount == 0 )
+				{
+					m_Entries[i] = m_Entries.back();
+					m_Entries.pop_back();
+				}
+				return;
+			}
+		}
+	}
+
+	std::vector<CacheEntry_t> m_Entries;
+
+private:
+
+	bool m_bFoldSlashes;
+	int m_nNextMaterial;
+};
+
+//
+// CMaterialCache as it is now: the same array, indexed by a CNameMap.
+//
+class CNewMaterialCache
+{
+public:
+
+	CNewMaterialCache( void ) : m_nNextMaterial( 0 ) {}
+
+	int Create( const std::string &Name )
+	{
+		int i;
+		if ( m_Index.Find( Name, i ) )
+		{
+			AddRef( m_Entries[i].m_nMaterial, m_Entries[i].m_Name );
+			return m_Entries[i].m_nMaterial;
+		}
+
+		CacheEntry_t Entry = { m_nNextMaterial++, Name, 1 };
+		m_Index.Insert( Name, (int)m_Entries.size() );
+		m_Entries.push_back( Entry );
+		return Entry.m_nMaterial;
+	}
+
+	void AddRef( int nMaterial, const std::string &Name )
+	{
+		int i;
+		if ( m_Index.Find( Name, i ) && m_Entries[i].m_nMaterial == nMaterial )
+		{
+			m_Entries[i].m_nRefCount++;
+		}
+	}
+
+	void Release( int nMaterial, const std::string &Name )
+	{
+		int i;
+		if ( m_Index.Find( Name, i ) && m_Entries[i].m_nMaterial == nMaterial )
+		{
+			if ( --m_Entries[i].m_nRefCount == 0 )
+			{
+				m_Index.Remove( Name );
+				m_Entries[i] = m_Entries.back();
+				m_Entries.pop_back();
+
+				if ( i < (int)m_Entries.size() )
+				{
+					m_Index.Replace( m_Entries[i].m_Name, i );
+				}
+			}
+		}
+	}
+
+	std::vector<CacheEntry_t> m_Entries;
+
+private:
+
+	CNameMap m_Index;
+	int m_nNextMaterial;
+};
+
+static bool SameEntries( const std::vector<CacheEntry_t> &Entries1, const std::vector<CacheEntry_t> &Entries2 )
+{
+	if ( Entries1.size() != Entries2.size() )
+		return false;
+
+	for ( size_t i = 0; i < Entries1.size(); i++ )
+	{
+		if ( Entries1[i].m_nMaterial != Entries2[i].m_nMaterial || Entries1[i].m_Name != Entries2[i].m_Name || Entries1[i].m_nRefCount != Entries2[i].m_nRefCount )
+			return false;
+	}
+
+	return true;
+}
+
+static void TestMaterialCache( bool bBackslashes )
+{
+	COldMaterialCache Old( false );
+	COldMaterialCache OldFolded( true );
+	CNewMaterialCache New;
+
+	int nChanged = 0;
+	int nReleased = 0;
+
+	for ( int nOp = 0; nOp < 100000; nOp++ )
+	{
+		if ( New.m_Entries.empty() || RandomInt( 0, 2 ) != 0 )
+		{
+			std::string Name = ( !New.m_Entries.empty() && RandomInt( 0, 1 ) )
+				? Respell( New.m_Entries[RandomInt( 0, (int)New.m_Entries.size() - 1 )].m_Name, bBackslashes )
+				: Respell( RandomName( bBackslashes ), bBackslashes );
+
+			int nOld = Old.Create( Name );
+			int nOldFolded = OldFolded.Create( Name );
+			int nNew = New.Create( Name );
+
+			CHECK( nNew == nOldFolded );
+			if ( !bBackslashes )
+			{
+				CHECK( nNew == nOld );
+			}
+			else if ( nNew != nOld )
+			{
+				nChanged++;
+			}
+		}
+		else
+		{
+			const CacheEntry_t &Entry = New.m_Entries[RandomInt( 0, (int)New.m_Entries.size() - 1 )];
+			int nMaterial = Entry.m_nMaterial;
+			std::string Name = Entry.m_Name;
+
+			if ( RandomInt( 0, 3 ) == 0 )
+			{
+				OldFolded.AddRef( nMaterial );
+				New.AddRef( nMaterial, Name );
+				if ( !bBackslashes )
+				{
+					Old.AddRef( nMaterial );
+				}
+			}
+			else
+			{
+				OldFolded.Release( nMaterial );
+				New.Release( nMaterial, Name );
+				if ( !bBackslashes )
+				{
+					Old.Release( nMaterial );
+				}
+				nReleased++;
+			}
+		}
+
+		CHECK( SameEntries( New.m_Entries, OldFolded.m_Entries ) );
+		if ( !bBackslashes )
+		{
+			CHECK( SameEntries( New.m_Entries, Old.m_Entries ) );
+		}
+	}
+
+	CHECK( nReleased > 0 );
+	CHECK( bBackslashes == ( nChanged > 0 ) );
+}
+
+int main( void )
+{
+	TestNormalize();
+
+	// Forward slashes only: the new lookups must match the old exactly.
+	TestFindActiveTexture( false );
+	TestMaterialCache( false );
+
+	// Mixed slashes: they must match the old lookups with slashes folded.
+	TestFindActiveTexture( true );
+	TestMaterialCache( true );
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All texture name tests passed\n" );
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include "MainFrm.h"
 #include "MapDoc.h"
 #include "Material.h"			// Specific IEditorTexture implementation
+#include "MaterialIndex.h"
 #include "Options.h"
 #include "TextureSystem.h"
 #include "WADTexture.h"			// Specific IEditorTexture implementation
@@ -173,6 +174,7 @@ void CTextureSystem::FreeAllTextures()
 			IEditorTexture *pTex = pContext->Dummies.Element(nDummy);
 			delete pTex;
 		}
+		pContext->DummyNames.Purge();
 	}
 
 	//
@@ -291,7 +293,8 @@ IEditorTexture *CTextureSystem::FindActiveTexture(LPCSTR pszInputName, int *piIn
 	// The .vmf file format gets confused if there are backslashes in material names,
 	// so make sure they're all using forward slashes here.
 	char szName[MAX_PATH];
-	Q_StrSubst( pszInputName, "\\", "/", szName, sizeof( szName ) );
+	V_strncpy( szName, pszInputName, sizeof( szName ) );
+	V_FixSlashes( szName, '/' );
 	const char *pszName = szName;
 	IEditorTexture *pTex = NULL;
 	//
@@ -326,22 +329,15 @@ IEditorTexture *CTextureSystem::FindActiveTexture(LPCSTR pszInputName, int *piIn
 	}
 
 	//
-	// Let's try again, this time with \textures\ decoration
+	// Let's try again, this time with \textures\ decoration. The name map
+	// ignores case and slash direction, so no further decoration is needed.
 	// TODO: remove this?
 	//
 	{
 		iIndex = 0;
 		char szBuf[512];
 
-		sprintf(szBuf, "textures\\%s", pszName);
-
-		for (int i = strlen(szBuf) -1; i >= 0; i--)
-		{
-			if (szBuf[i] == '/')
-				szBuf[i] = '\\';
-		}
-
-		strlwr(szBuf);
+		Q_snprintf(szBuf, sizeof(szBuf), "textures/%s", pszName);
 
 		if ( m_pActiveGroup )
 		{
@@ -374,16 +370,12 @@ IEditorTexture *CTextureSystem::FindActiveTexture(LPCSTR pszInputName, int *piIn
 	//
 	if (m_pActiveContext)
 	{
-		int nDummyCount = m_pActiveContext->Dummies.Count();
-		for (int nDummy = 0; nDummy < nDummyCount; nDummy++)
+		IEditorTexture *pTexDummy;
+		if (m_pActiveContext->DummyNames.Find(pszName, pTexDummy))
 		{
-			IEditorTexture *pTexDummy = m_pActiveContext->Dummies.Element(nDummy);
-			if (!strcmpi(pszName, pTexDummy->GetName()))
-			{
-				m_pLastTex = pTexDummy;
-				m_nLastIndex = -1;
-				return(pTexDummy);
-			}
+			m_pLastTex = pTexDummy;
+			m_nLastIndex = -1;
+			return(pTexDummy);
 		}
 
 		//
@@ -953,6 +945,7 @@ IEditorTexture *CTextureSystem::AddDummy(LPCTSTR pszName, TEXTUREFORMAT eFormat)
 
 	IEditorTexture *pTex = new CDummyTexture(pszName, eFormat);
 	m_pActiveContext->Dummies.AddToTail(pTex);
+	m_pActiveContext->DummyNames.Insert(pTex->GetName(), pTex);
 
 	return(pTex);
 }
@@ -1305,6 +1298,15 @@ bool CTextureSystem::EnumMaterial( const char *pMaterialName, int nContext )
 		{
 			m_pActiveContext->pAllGroup->AddTexture(pMaterial);
 		}
+
+#ifndef SLE_NO_TEXTURE_KEYWORDS
+		// Indexed keywords can be registered without loading the material.
+		const MaterialIndexFile_t *pIndexed = g_MaterialIndex.FindMaterial(pMaterialName);
+		if ((pIndexed != NULL) && !pIndexed->m_Keywords.IsEmpty())
+		{
+			RegisterTextureKeywords(pMaterial);
+		}
+#endif
 	}
 	return true;
 }
@@ -1465,14 +1467,14 @@ IEditorTexture *CTextureGroup::GetTexture( char const* pName )
 //-----------------------------------------------------------------------------
 IEditorTexture* CTextureGroup::FindTextureByName( const char *pName, int *piIndex, TEXTUREFORMAT eDesiredFormat )
 {
-	int iMapEntry = m_TextureNameMap.Find( pName );
-	if ( iMapEntry == m_TextureNameMap.InvalidIndex() )
+	int iTexture;
+	if ( !m_TextureNameMap.Find( pName, iTexture ) )
 	{
 		return NULL;
 	}
 	else
 	{
-		IEditorTexture *pTex = m_Textures[ m_TextureNameMap[iMapEntry] ];
+		IEditorTexture *pTex = m_Textures[ iTexture ];
 		if ((eDesiredFormat == tfNone) || (pTex->GetTextureFormat() == eDesiredFormat))
 			return pTex;
 		else
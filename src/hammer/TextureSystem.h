@@ -16,6 +16,7 @@
 #include "utlvector.h"
 #include "utldict.h"
 #include "FileChangeWatcher.h"
+#include "TextureNameMap.h"
 
 class CGameConfig;
 class CTextureSystem;
@@ -68,7 +69,7 @@ protected:
 	char m_szName[MAX_PATH];
 	TEXTUREFORMAT m_eTextureFormat;
 	CUtlVector<IEditorTexture *> m_Textures;
-	CUtlDict<int,int> m_TextureNameMap;	// Maps the texture name to an index into m_Textures (the key is IEditorTexture::GetName).
+	CTextureNameMap<int> m_TextureNameMap;	// Maps the texture name to an index into m_Textures (the key is IEditorTexture::GetName).
 
 	// Used to lazily load the textures in the group
 	int	m_nTextureToLoad;
@@ -97,6 +98,7 @@ struct TextureContext_t
 	TextureGroupList_t Groups;
 	EditorTextureList_t MRU;		// List of Most Recently Used textures, first is the most recent.
 	EditorTextureList_t Dummies;	// List of Dummy textures - textures that were created to hold the place of missing textures.
+	CTextureNameMap<IEditorTexture *> DummyNames;	// Dummies by name.
 };
 
 class CMaterialFileChangeWatcher : private CFileChangeWatcher::ICallbacks
@@ -0,0 +1,406 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent on-disk cache of texture browser previews.
+//
+//			The cache is two files in the editor directory. The data file is
+//			append only and holds the raw VTF levels. The index file lists,
+//			for every VTF path, the file time and preview size the level was
+//			picked for and where the level lives in the data file. The index
+//			is written at shutdown; a data file without a matching index is
+//			thrown away. Levels replaced by newer ones stay in the data file
+//			as dead space until it outweighs the live data, at which point
+//			the whole cache starts over.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "hammer.h"
+#include "ThumbnailCache.h"
+#include "vtffile.h"
+#include "tier1/strtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/checksum_crc.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+#define THUMBNAILCACHE_MAGIC		MAKEID( 'T', 'C', 'I', 'X' )
+
+CThumbnailCache g_ThumbnailCache;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.
+//-----------------------------------------------------------------------------
+CThumbnailCache::CThumbnailCache( void )
+{
+	m_bEnabled = true;
+	m_bLoaded = false;
+	m_bDirty = false;
+	m_nDataSize = 0;
+	m_nLiveSize = 0;
+	m_hReadFile = FILESYSTEM_INVALID_HANDLE;
+	m_hAppendFile = FILESYSTEM_INVALID_HANDLE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.
+//-----------------------------------------------------------------------------
+CThumbnailCache::~CThumbnailCache( void )
+{
+	Assert( m_hReadFile == FILESYSTEM_INVALID_HANDLE );
+	Assert( m_hAppendFile == FILESYSTEM_INVALID_HANDLE );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forgets every entry. The data file is truncated by the next write.
+//-----------------------------------------------------------------------------
+void CThumbnailCache::Clear( void )
+{
+	m_Entries.Purge();
+	m_EntryIndex.Purge();
+	m_nDataSize = 0;
+	m_nLiveSize = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CThumbnailCache::CloseFiles( void )
+{
+	if ( m_hReadFile != FILESYSTEM_INVALID_HANDLE )
+	{
+		g_pFullFileSystem->Close( m_hReadFile );
+		m_hReadFile = FILESYSTEM_INVALID_HANDLE;
+	}
+
+	if ( m_hAppendFile != FILESYSTEM_INVALID_HANDLE )
+	{
+		g_pFullFileSystem->Close( m_hAppendFile );
+		m_hAppendFile = FILESYSTEM_INVALID_HANDLE;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the full path of one of the cache files for the active mod.
+// Input  : pszExtension - "idx" for the index, "dat" for the data file.
+//-----------------------------------------------------------------------------
+void CThumbnailCache::GetCacheFileName( const char *pszExtension, char *pszFileName, int nSize ) const
+{
+	char szProgramDir[MAX_PATH];
+	APP()->GetDirectory( DIR_PROGRAM, szProgramDir );
+
+	char szModDir[MAX_PATH];
+	APP()->GetDirectory( DIR_MOD, szModDir );
+	Q_strlower( szModDir );
+	CRC32_t nModCRC = CRC32_ProcessSingleBuffer( szModDir, Q_strlen( szModDir ) );
+
+	char szName[MAX_PATH];
+	Q_snprintf( szName, sizeof( szName ), "thumbcache_%08x.%s", nModCRC, pszExtension );
+	Q_ComposeFileName( szProgramDir, szName, pszFileName, nSize );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the index file. Leaves the cache empty if the index is
+//			missing, from another version, or does not match the data file.
+//-----------------------------------------------------------------------------
+void CThumbnailCache::Load( void )
+{
+	m_bLoaded = true;
+	Clear();
+
+	char szIndexFileName[MAX_PATH];
+	GetCacheFileName( "idx", szIndexFileName, sizeof( szIndexFileName ) );
+
+	char szDataFileName[MAX_PATH];
+	GetCacheFileName( "dat", szDataFileName, sizeof( szDataFileName ) );
+
+	CUtlBuffer buf;
+	if ( !g_pFullFileSystem->ReadFile( szIndexFileName, NULL, buf ) )
+	{
+		return;
+	}
+
+	if ( ( buf.GetInt() != THUMBNAILCACHE_MAGIC ) || ( buf.GetInt() != THUMBNAILCACHE_VERSION ) )
+	{
+		return;
+	}
+
+	unsigned int nDataSize = buf.GetUnsignedInt();
+	if ( !g_pFullFileSystem->FileExists( szDataFileName ) || ( g_pFullFileSystem->Size( szDataFileName ) != nDataSize ) )
+	{
+		return;
+	}
+
+	char szFileName[MAX_PATH];
+
+	int nEntries = buf.GetInt();
+	m_Entries.EnsureCapacity( max( nEntries, 0 ) );
+	for ( int i = 0; ( i < nEntries ) && buf.IsValid(); i++ )
+	{
+		ThumbnailCacheEntry_t &Entry = m_Entries[m_Entries.AddToTail()];
+
+		buf.GetString( szFileName, sizeof( szFileName ) );
+		Entry.m_FileName = szFileName;
+		Entry.m_nFileTime = buf.GetInt();
+		Entry.m_nMinWidth = buf.GetUnsignedShort();
+		Entry.m_nMinHeight = buf.GetUnsignedShort();
+		Entry.m_nWidth = buf.GetUnsignedShort();
+		Entry.m_nHeight = buf.GetUnsignedShort();
+		Entry.m_Format = (ImageFormat)buf.GetInt();
+		Entry.m_nFlags = buf.GetUnsignedInt();
+		Entry.m_nOffset = buf.GetUnsignedInt();
+		Entry.m_nSize = buf.GetUnsignedInt();
+		Entry.m_nCRC = buf.GetUnsignedInt();
+
+		if ( Entry.m_nOffset + Entry.m_nSize > nDataSize )
+		{
+			break;
+		}
+
+		m_nLiveSize += Entry.m_nSize;
+	}
+
+	if ( !buf.IsValid() || ( m_Entries.Count() != nEntries ) )
+	{
+		// Truncated or corrupt; start over.
+		Clear();
+		return;
+	}
+
+	if ( nDataSize - m_nLiveSize > m_nLiveSize )
+	{
+		// Mostly replaced levels; starting over is cheaper than carrying them.
+		Clear();
+		m_bDirty = true;
+		return;
+	}
+
+	for ( int i = 0; i < m_Entries.Count(); i++ )
+	{
+		m_EntryIndex.Insert( m_Entries[i].m_FileName, i );
+	}
+
+	m_nDataSize = nDataSize;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the index file.
+//-----------------------------------------------------------------------------
+bool CThumbnailCache::Save( void )
+{
+	CUtlBuffer buf;
+	buf.PutInt( THUMBNAILCACHE_MAGIC );
+	buf.PutInt( THUMBNAILCACHE_VERSION );
+	buf.PutUnsignedInt( m_nDataSize );
+
+	buf.PutInt( m_Entries.Count() );
+	for ( int i = 0; i < m_Entries.Count(); i++ )
+	{
+		const ThumbnailCacheEntry_t &Entry = m_Entries[i];
+		buf.PutString( Entry.m_FileName );
+		buf.PutInt( Entry.m_nFileTime );
+		buf.PutUnsignedShort( Entry.m_nMinWidth );
+		buf.PutUnsignedShort( Entry.m_nMinHeight );
+		buf.PutUnsignedShort( Entry.m_nWidth );
+		buf.PutUnsignedShort( Entry.m_nHeight );
+		buf.PutInt( Entry.m_Format );
+		buf.PutUnsignedInt( Entry.m_nFlags );
+		buf.PutUnsignedInt( Entry.m_nOffset );
+		buf.PutUnsignedInt( Entry.m_nSize );
+		buf.PutUnsignedInt( Entry.m_nCRC );
+	}
+
+	char szFileName[MAX_PATH];
+	GetCacheFileName( "idx", szFileName, sizeof( szFileName ) );
+	return g_pFullFileSystem->WriteFile( szFileName, NULL, buf );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the index if it changed and frees all entries.
+//-----------------------------------------------------------------------------
+void CThumbnailCache::Shutdown( void )
+{
+	CloseFiles();
+
+	if ( m_bDirty && Save() )
+	{
+		m_bDirty = false;
+	}
+
+	Clear();
+	m_bLoaded = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads a cached level from the data file.
+// Output : Returns false if the level could not be read or failed its CRC.
+//-----------------------------------------------------------------------------
+bool CThumbnailCache::ReadEntry( const ThumbnailCacheEntry_t &Entry, ThumbnailImage_t &Image )
+{
+	if ( m_hReadFile == FILESYSTEM_INVALID_HANDLE )
+	{
+		char szDataFileName[MAX_PATH];
+		GetCacheFileName( "dat", szDataFileName, sizeof( szDataFileName ) );
+
+		m_hReadFile = g_pFullFileSystem->Open( szDataFileName, "rb" );
+		if ( m_hReadFile == FILESYSTEM_INVALID_HANDLE )
+		{
+			return false;
+		}
+	}
+
+	Image.m_Data.EnsureCapacity( Entry.m_nSize );
+
+	g_pFullFileSystem->Seek( m_hReadFile, Entry.m_nOffset, FILESYSTEM_SEEK_HEAD );
+	if ( g_pFullFileSystem->Read( Image.m_Data.Base(), Entry.m_nSize, m_hReadFile ) != (int)Entry.m_nSize )
+	{
+		return false;
+	}
+
+	if ( CRC32_ProcessSingleBuffer( Image.m_Data.Base(), Entry.m_nSize ) != Entry.m_nCRC )
+	{
+		return false;
+	}
+
+	Image.m_nWidth = Entry.m_nWidth;
+	Image.m_nHeight = Entry.m_nHeight;
+	Image.m_Format = Entry.m_Format;
+	Image.m_nFlags = Entry.m_nFlags;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Appends a level to the data file and points the entry for the
+//			VTF at it.
+//-----------------------------------------------------------------------------
+void CThumbnailCache::WriteEntry( const char *pszFileName, long nFileTime, unsigned int nMinWidth, unsigned int nMinHeight, const ThumbnailImage_t &Image )
+{
+	unsigned int nSize = CVTFFile::ComputeImageSize( Image.m_nWidth, Image.m_nHeight, 1, Image.m_Format );
+	if ( ( nSize == 0 ) || ( nSize > THUMBNAILCACHE_MAX_ENTRY_SIZE ) )
+	{
+		return;
+	}
+
+	if ( m_hAppendFile == FILESYSTEM_INVALID_HANDLE )
+	{
+		char szDataFileName[MAX_PATH];
+		GetCacheFileName( "dat", szDataFileName, sizeof( szDataFileName ) );
+
+		// An empty cache owns nothing in the data file, so throw the old contents away.
+		m_hAppendFile = g_pFullFileSystem->Open( szDataFileName, ( m_nDataSize == 0 ) ? "wb" : "ab" );
+		if ( m_hAppendFile == FILESYSTEM_INVALID_HANDLE )
+		{
+			return;
+		}
+	}
+
+	if ( g_pFullFileSystem->Write( Image.m_Data.Base(), nSize, m_hAppendFile ) != (int)nSize )
+	{
+		// The data file no longer matches the index; drop both.
+		CloseFiles();
+		Clear();
+		m_bDirty = true;
+		return;
+	}
+	g_pFullFileSystem->Flush( m_hAppendFile );
+
+	int nIndex;
+	if ( m_EntryIndex.Find( pszFileName, nIndex ) )
+	{
+		m_nLiveSize -= m_Entries[nIndex].m_nSize;
+	}
+	else
+	{
+		nIndex = m_Entries.AddToTail();
+		m_EntryIndex.Insert( pszFileName, nIndex );
+	}
+
+	ThumbnailCacheEntry_t &Entry = m_Entries[nIndex];
+	Entry.m_FileName = pszFileName;
+	Entry.m_nFileTime = nFileTime;
+	Entry.m_nMinWidth = nMinWidth;
+	Entry.m_nMinHeight = nMinHeight;
+	Entry.m_nWidth = Image.m_nWidth;
+	Entry.m_nHeight = Image.m_nHeight;
+	Entry.m_Format = Image.m_Format;
+	Entry.m_nFlags = Image.m_nFlags;
+	Entry.m_nOffset = m_nDataSize;
+	Entry.m_nSize = nSize;
+	Entry.m_nCRC = CRC32_ProcessSingleBuffer( Image.m_Data.Base(), nSize );
+
+	m_nDataSize += nSize;
+	m_nLiveSize += nSize;
+	m_bDirty = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Gets a preview level of a VTF.
+// Input  : pszFileName - VTF path relative to the game, ex: "materials/brick/brickfloor01.vtf".
+//			nMinWidth, nMinHeight - Smallest acceptable size of the level.
+//			Image - Receives the level in its VTF format.
+// Output : Returns false if the VTF could not be loaded.
+//-----------------------------------------------------------------------------
+bool CThumbnailCache::GetThumbnail( const char *pszFileName, unsigned int nMinWidth, unsigned int nMinHeight, ThumbnailImage_t &Image )
+{
+	long nFileTime = 0;
+	if ( m_bEnabled )
+	{
+		if ( !m_bLoaded )
+		{
+			Load();
+		}
+
+		nFileTime = g_pFullFileSystem->GetFileTime( pszFileName, "GAME" );
+
+		int nIndex;
+		if ( m_EntryIndex.Find( pszFileName, nIndex ) )
+		{
+			const ThumbnailCacheEntry_t &Entry = m_Entries[nIndex];
+			if ( ( Entry.m_nFileTime == nFileTime ) && ( Entry.m_nMinWidth == nMinWidth ) && ( Entry.m_nMinHeight == nMinHeight ) &&
+				ReadEntry( Entry, Image ) )
+			{
+				return true;
+			}
+		}
+	}
+
+	FileHandle_t hFile = g_pFullFileSystem->Open( pszFileName, "rb", "GAME" );
+	if ( hFile == FILESYSTEM_INVALID_HANDLE )
+	{
+		return false;
+	}
+
+	// LoadPreview closes the file.
+	CVTFFile VTF;
+	if ( !VTF.LoadPreview( hFile, nMinWidth, nMinHeight ) )
+	{
+		return false;
+	}
+
+	Image.m_nWidth = VTF.GetWidth();
+	Image.m_nHeight = VTF.GetHeight();
+	Image.m_Format = VTF.GetFormat();
+	Image.m_nFlags = VTF.GetFlags();
+
+	unsigned int nSize = CVTFFile::ComputeImageSize( Image.m_nWidth, Image.m_nHeight, 1, Image.m_Format );
+	Image.m_Data.EnsureCapacity( nSize );
+	memcpy( Image.m_Data.Base(), VTF.GetData(), nSize );
+
+	if ( m_bEnabled && ( nFileTime != 0 ) )
+	{
+		WriteEntry( pszFileName, nFileTime, nMinWidth, nMinHeight, Image );
+	}
+
+	return true;
+}
@@ -0,0 +1,110 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Persistent on-disk cache of texture browser previews. Each entry
+//			holds the VTF level that CVTFFile::LoadPreview picked for a
+//			preview size, so browsing textures that have not changed since
+//			the last run reads one small block instead of opening the VTF.
+//
+//=============================================================================//
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "tier1/utlstring.h"
+#include "tier1/utlmemory.h"
+#include "bitmap/imageformat.h"
+#include "filesystem.h"
+#include "TextureNameMap.h"
+
+//
+// Bump this whenever the layout of the cache files changes.
+//
+#define THUMBNAILCACHE_VERSION		1
+
+//
+// Levels larger than this are loaded from the VTF every time rather than
+// cached, which keeps the data file at a few tens of KB per texture.
+//
+#define THUMBNAILCACHE_MAX_ENTRY_SIZE	( 64 * 1024 )
+
+//
+// One cached preview.
+//
+struct ThumbnailCacheEntry_t
+{
+	CUtlString m_FileName;			// VTF path relative to the game, ex: "materials/brick/brickfloor01.vtf"
+	long m_nFileTime;				// Modification time of the VTF when the level was cached.
+	unsigned short m_nMinWidth;		// Preview size the level was picked for.
+	unsigned short m_nMinHeight;
+
+	unsigned short m_nWidth;		// The cached level.
+	unsigned short m_nHeight;
+	ImageFormat m_Format;
+	unsigned int m_nFlags;			// VTF flags of the texture.
+
+	unsigned int m_nOffset;			// Location of the level in the data file.
+	unsigned int m_nSize;
+	unsigned int m_nCRC;			// Checked on read, so a data file that went out of sync is never trusted.
+};
+
+//
+// A preview image as returned by the cache.
+//
+struct ThumbnailImage_t
+{
+	unsigned int m_nWidth;
+	unsigned int m_nHeight;
+	ImageFormat m_Format;
+	unsigned int m_nFlags;
+	CUtlMemory<unsigned char> m_Data;
+};
+
+class CThumbnailCache
+{
+public:
+
+	CThumbnailCache( void );
+	~CThumbnailCache( void );
+
+	inline void SetEnabled( bool bEnabled ) { m_bEnabled = bEnabled; }
+	inline bool IsEnabled( void ) const { return m_bEnabled; }
+
+	// Gets the smallest level of a VTF that is at least nMinWidth x nMinHeight,
+	// from the cache if the VTF has not changed since it was cached.
+	bool GetThumbnail( const char *pszFileName, unsigned int nMinWidth, unsigned int nMinHeight, ThumbnailImage_t &Image );
+
+	// Writes the index if anything was added and frees everything.
+	void Shutdown( void );
+
+protected:
+
+	void GetCacheFileName( const char *pszExtension, char *pszFileName, int nSize ) const;
+	void Load( void );
+	bool Save( void );
+	void Clear( void );
+	void CloseFiles( void );
+
+	bool ReadEntry( const ThumbnailCacheEntry_t &Entry, ThumbnailImage_t &Image );
+	void WriteEntry( const char *pszFileName, long nFileTime, unsigned int nMinWidth, unsigned int nMinHeight, const ThumbnailImage_t &Image );
+
+	bool m_bEnabled;
+	bool m_bLoaded;
+	bool m_bDirty;
+
+	CUtlVector<ThumbnailCacheEntry_t> m_Entries;
+	CTextureNameMap<int> m_EntryIndex;		// Maps VTF paths to indices into m_Entries.
+
+	unsigned int m_nDataSize;				// Bytes in the data file.
+	unsigned int m_nLiveSize;				// Bytes in the data file still referenced by an entry.
+
+	FileHandle_t m_hReadFile;				// Handles to the data file, opened on first use.
+	FileHandle_t m_hAppendFile;
+};
+
+extern CThumbnailCache g_ThumbnailCache;
+
+#endif // THUMBNAILCACHE_H
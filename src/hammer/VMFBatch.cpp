@@ -0,0 +1,296 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Batch processing of VMF files from the command line.
+//
+//			Maps are processed one after another: loading goes through
+//			CMapDoc, which keeps the active document, the load progress
+//			dialog and the visgroup state in globals. To spread a large map
+//			set over several cores, split the list and run one editor per
+//			part.
+//
+//=============================================================================//
+
+#include "stdafx.h"
+#include "VMFBatch.h"
+#include "VMFBatchArgs.h"
+#include "MapDoc.h"
+#include "MapWorld.h"
+#include "MapCheckDlg.h"
+#include "EditorProfiler.h"
+#include "FacePointPool.h"
+#include "StudioModel.h"
+#include "tier1/strtools.h"
+#include <stdio.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include <tier0/memdbgon.h>
+
+bool CVMFBatch::s_bRunning = false;
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds the list of maps to process.
+// Input  : pszInput - A VMF, or a text file with one VMF per line. Blank lines
+//				and lines starting with // are skipped; relative paths are
+//				relative to the list file.
+//-----------------------------------------------------------------------------
+bool CVMFBatch::ReadMapList( const char *pszInput, CUtlVector<CUtlString> &Maps )
+{
+	const char *pszExtension = V_GetFileExtension( pszInput );
+	if ( pszExtension && !V_stricmp( pszExtension, "vmf" ) )
+	{
+		Maps.AddToTail( CUtlString( pszInput ) );
+		return true;
+	}
+
+	FILE *fp = fopen( pszInput, "rt" );
+	if ( !fp )
+		return false;
+
+	char szListDir[MAX_PATH];
+	if ( !V_ExtractFilePath( pszInput, szListDir, sizeof( szListDir ) ) )
+	{
+		szListDir[0] = '\0';
+	}
+
+	char szLine[MAX_PATH];
+	while ( fgets( szLine, sizeof( szLine ), fp ) )
+	{
+		const char *pszLine = VMFBatch_TrimListLine( szLine );
+		if ( !pszLine )
+			continue;
+
+		if ( V_IsAbsolutePath( pszLine ) || !szListDir[0] )
+		{
+			Maps.AddToTail( CUtlString( pszLine ) );
+		}
+		else
+		{
+			char szPath[MAX_PATH];
+			V_ComposeFileName( szListDir, pszLine, szPath, sizeof( szPath ) );
+			Maps.AddToTail( CUtlString( szPath ) );
+		}
+	}
+
+	fclose( fp );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the transform arguments.
+// Input  : pszRotate - The -batchrotate value, or NULL.
+//			pszMove - The -batchmove value, or NULL.
+//-----------------------------------------------------------------------------
+bool CVMFBatch::ParseTransform( const char *pszRotate, const char *pszMove, VMFBatchTransform_t &Transform )
+{
+	Transform.m_bRotate = ( pszRotate != NULL );
+	Transform.m_angRotate.Init();
+	Transform.m_bMove = ( pszMove != NULL );
+	Transform.m_vecMove.Init();
+
+	if ( pszRotate && !VMFBatch_ParseVector( pszRotate, Transform.m_angRotate.Base() ) )
+	{
+		Warning( "Batch: -batchrotate takes three angles, not \"%s\"\n", pszRotate );
+		return false;
+	}
+
+	if ( pszMove && !VMFBatch_ParseVector( pszMove, Transform.m_vecMove.Base() ) )
+	{
+		Warning( "Batch: -batchmove takes three offsets, not \"%s\"\n", pszMove );
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Rotates and then moves every object in the world, as the Transform
+//			dialog would with everything selected, but about the world origin.
+//-----------------------------------------------------------------------------
+void CVMFBatch::TransformWorld( CMapWorld *pWorld, const VMFBatchTransform_t &Transform )
+{
+	const CMapObjectList *pChildren = pWorld->GetChildren();
+	FOR_EACH_OBJ( *pChildren, pos )
+	{
+		CMapClass *pChild = pChildren->Element( pos );
+
+		if ( Transform.m_bRotate )
+		{
+			pChild->TransRotate( vec3_origin, Transform.m_angRotate );
+		}
+
+		if ( Transform.m_bMove )
+		{
+			pChild->TransMove( Transform.m_vecMove );
+		}
+	}
+
+	// Relink everything at once rather than leaving the tree to catch up.
+	pWorld->CullTree_Build();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads, transforms, checks and optionally re-saves one map in a
+//			document of its own, which is freed before returning.
+//-----------------------------------------------------------------------------
+void CVMFBatch::ProcessMap( const char *pszFileName, const char *pszOutputDir, const VMFBatchTransform_t &Transform, VMFBatchResult_t &Result )
+{
+	EDITOR_PROFILE_SCOPE( "CVMFBatch::ProcessMap" );
+
+	Result.m_FileName = pszFileName;
+	Result.m_bLoaded = false;
+	Result.m_bSaved = false;
+	Result.m_nEntities = 0;
+	Result.m_nProblems = -1;
+	Result.m_flLoadTime = 0;
+	Result.m_flTransformTime = 0;
+	Result.m_flCheckTime = 0;
+	Result.m_flSaveTime = 0;
+
+	FacePointPoolStats_t PoolStats;
+	g_FacePointPool.GetStats( PoolStats );
+	int nHeapAllocs = PoolStats.m_nHeapAllocs;
+
+	CMapDoc *pDoc = new CMapDoc;
+
+	double flStart = Plat_FloatTime();
+	Result.m_bLoaded = pDoc->LoadVMF( pszFileName );
+	Result.m_flLoadTime = Plat_FloatTime() - flStart;
+
+	// The document's world has a pool of its own; count what the pool for
+	// faces outside any world took as well.
+	g_FacePointPool.GetStats( PoolStats );
+	Result.m_nFacePointAllocs = PoolStats.m_nHeapAllocs - nHeapAllocs;
+	Result.m_nFacePointSlabs = 0;
+
+	if ( pDoc->GetMapWorld() )
+	{
+		pDoc->GetMapWorld()->GetFacePointPool()->GetStats( PoolStats );
+		Result.m_nFacePointAllocs += PoolStats.m_nHeapAllocs;
+		Result.m_nFacePointSlabs = PoolStats.m_nSlabs;
+	}
+
+	// Run() turned model queueing off, so the checks and the save below see
+	// every model the map uses.
+	Assert( CStudioModelCache::GetQueuedLoadCount() == 0 );
+
+	CMapWorld *pWorld = pDoc->GetMapWorld();
+	if ( Result.m_bLoaded && pWorld )
+	{
+		Result.m_nEntities = pWorld->EntityList_GetCount();
+
+		if ( Transform.m_bRotate || Transform.m_bMove )
+		{
+			flStart = Plat_FloatTime();
+			TransformWorld( pWorld, Transform );
+			Result.m_flTransformTime = Plat_FloatTime() - flStart;
+		}
+
+		flStart = Plat_FloatTime();
+		Result.m_nProblems = CMapCheckDlg::CountProblems( pWorld );
+		Result.m_flCheckTime = Plat_FloatTime() - flStart;
+
+		if ( pszOutputDir && pszOutputDir[0] )
+		{
+			char szOutFile[MAX_PATH];
+			V_ComposeFileName( pszOutputDir, V_UnqualifiedFileName( pszFileName ), szOutFile, sizeof( szOutFile ) );
+
+			flStart = Plat_FloatTime();
+			Result.m_bSaved = pDoc->SaveVMF( szOutFile, 0 );
+			Result.m_flSaveTime = Plat_FloatTime() - flStart;
+		}
+	}
+
+	if ( CMapDoc::GetActiveMapDoc() == pDoc )
+	{
+		CMapDoc::SetActiveMapDoc( NULL );
+	}
+
+	delete pDoc;
+
+	// The world's pool went with the document; start the next map with
+	// nothing held for faces outside a world either.
+	g_FacePointPool.Compact();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes one line per map as comma separated values, so runs can be
+//			compared from night to night.
+//-----------------------------------------------------------------------------
+bool CVMFBatch::WriteReport( const char *pszReportFile, const CUtlVector<VMFBatchResult_t> &Results )
+{
+	FILE *fp = fopen( pszReportFile, "wt" );
+	if ( !fp )
+		return false;
+
+	fprintf( fp, "file,loaded,entities,problems,load_ms,transform_ms,check_ms,saved,save_ms,face_point_allocs,face_point_slabs\n" );
+
+	FOR_EACH_VEC( Results, i )
+	{
+		const VMFBatchResult_t &Result = Results[i];
+		fprintf( fp, "\"%s\",%d,%d,%d,%.2f,%.2f,%.2f,%d,%.2f,%d,%d\n",
+			Result.m_FileName.Get(), Result.m_bLoaded ? 1 : 0, Result.m_nEntities, Result.m_nProblems,
+			Result.m_flLoadTime * 1000.0, Result.m_flTransformTime * 1000.0, Result.m_flCheckTime * 1000.0,
+			Result.m_bSaved ? 1 : 0, Result.m_flSaveTime * 1000.0,
+			Result.m_nFacePointAllocs, Result.m_nFacePointSlabs );
+	}
+
+	bool bOK = !ferror( fp );
+	fclose( fp );
+
+	return bOK;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Processes every map named by pszInput and writes the report.
+// Input  : pszInput - A VMF, or a text file listing VMFs.
+//			pszOutputDir - Where to re-save the maps, or NULL to only load and
+//				check them.
+//			pszReportFile - Where to write the report.
+//			Transform - What to do to every map after loading it.
+// Output : Returns the number of maps that failed to load or save.
+//-----------------------------------------------------------------------------
+int CVMFBatch::Run( const char *pszInput, const char *pszOutputDir, const char *pszReportFile, const VMFBatchTransform_t &Transform )
+{
+	CUtlVector<CUtlString> Maps;
+	if ( !ReadMapList( pszInput, Maps ) )
+	{
+		Warning( "Batch: couldn't read %s\n", pszInput );
+		return 1;
+	}
+
+	s_bRunning = true;
+
+	// Models are queued while a map loads and only finish loading from the
+	// main loop, which doesn't run between maps. Load them with the map
+	// instead, so entities have their models for the checks and the save.
+	bool bQueuedLoadEnabled = CStudioModelCache::IsQueuedLoadEnabled();
+	CStudioModelCache::SetQueuedLoadEnabled( false );
+
+	CUtlVector<VMFBatchResult_t> Results;
+	Results.SetCount( Maps.Count() );
+
+	int nFailed = 0;
+	FOR_EACH_VEC( Maps, i )
+	{
+		Msg( "Batch: %s (%d/%d)\n", Maps[i].Get(), i + 1, Maps.Count() );
+
+		VMFBatchResult_t &Result = Results[i];
+		ProcessMap( Maps[i].Get(), pszOutputDir, Transform, Result );
+
+		if ( !Result.m_bLoaded || ( pszOutputDir && pszOutputDir[0] && !Result.m_bSaved ) )
+		{
+			nFailed++;
+		}
+	}
+
+	CStudioModelCache::SetQueuedLoadEnabled( bQueuedLoadEnabled );
+	s_bRunning = false;
+
+	if ( !WriteReport( pszReportFile, Results ) )
+	{
+		Warning( "Batch: couldn't write %s\n", pszReportFile );
+	}
+
+	Msg( "Batch: %d of %d maps processed, %d failed\n", Maps.Count() - nFailed, Maps.Count(), nFailed );
+	return nFailed;
+}
@@ -0,0 +1,89 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Batch processing of VMF files from the command line. Each map is
+//			loaded, optionally transformed, run through the map checks and
+//			optionally re-saved with the same code the editor uses, but
+//			without opening it in any view. The time each step took is
+//			written to a report.
+//
+//			hammer -batch <maps.txt | map.vmf> [-batchout <dir>] [-batchreport <file>]
+//				[-batchrotate "<x> <y> <z>"] [-batchmove "<x> <y> <z>"]
+//
+//			-batchrotate turns every object about the world origin by the
+//			given degrees about each axis, as the Transform dialog does, and
+//			-batchmove then moves it by the given offset.
+//
+//			The exit code is the number of maps that failed to load or save.
+//
+//=============================================================================//
+
+#ifndef VMFBATCH_H
+#define VMFBATCH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "tier1/utlstring.h"
+#include "mathlib/vector.h"
+
+class CMapWorld;
+
+//
+// What to do to every object of a map before it is checked and saved.
+//
+struct VMFBatchTransform_t
+{
+	bool m_bRotate;
+	QAngle m_angRotate;				// Degrees about the x, y and z axes, as the Transform dialog takes them.
+	bool m_bMove;
+	Vector m_vecMove;
+};
+
+//
+// What happened to one map.
+//
+struct VMFBatchResult_t
+{
+	CUtlString m_FileName;
+	bool m_bLoaded;
+	bool m_bSaved;
+	int m_nEntities;
+	int m_nProblems;				// From the map checks; -1 if the map didn't load.
+	double m_flLoadTime;			// Seconds.
+	double m_flTransformTime;
+	double m_flCheckTime;
+	double m_flSaveTime;
+
+	int m_nFacePointAllocs;			// Heap allocations made by the face point pools while loading.
+	int m_nFacePointSlabs;			// Face point slabs held by the world after loading.
+};
+
+class CVMFBatch
+{
+public:
+
+	// True while a batch is running. Loading reports errors to the console
+	// instead of message boxes then.
+	static bool IsRunning( void ) { return s_bRunning; }
+
+	// Reads the -batchrotate and -batchmove values, either of which may be
+	// NULL. Returns false if one is given but isn't three numbers.
+	static bool ParseTransform( const char *pszRotate, const char *pszMove, VMFBatchTransform_t &Transform );
+
+	// Processes every map named by pszInput, which is either a VMF or a text
+	// file listing one VMF per line. Maps are re-saved into pszOutputDir if
+	// it's given. Returns the number of maps that failed to load or save.
+	static int Run( const char *pszInput, const char *pszOutputDir, const char *pszReportFile, const VMFBatchTransform_t &Transform );
+
+private:
+
+	static bool ReadMapList( const char *pszInput, CUtlVector<CUtlString> &Maps );
+	static void ProcessMap( const char *pszFileName, const char *pszOutputDir, const VMFBatchTransform_t &Transform, VMFBatchResult_t &Result );
+	static void TransformWorld( CMapWorld *pWorld, const VMFBatchTransform_t &Transform );
+	static bool WriteReport( const char *pszReportFile, const CUtlVector<VMFBatchResult_t> &Results );
+
+	static bool s_bRunning;
+};
+
+#endif // VMFBATCH_H
@@ -0,0 +1,77 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Parsing of the -batch map lists and transform arguments. Kept free
+//			of editor dependencies so it can be tested standalone:
+//
+//			g++ -O2 VMFBatchArgs_test.cpp -o VMFBatchArgs_test && ./VMFBatchArgs_test
+//
+//=============================================================================//
+
+#ifndef VMFBATCHARGS_H
+#define VMFBATCHARGS_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: Trims a line read from a map list in place, including the newline
+//			fgets keeps.
+// Output : Returns the map named by the line, or NULL for blank lines and
+//			lines starting with //.
+//-----------------------------------------------------------------------------
+inline char *VMFBatch_TrimListLine( char *pszLine )
+{
+	while ( *pszLine == ' ' || *pszLine == '\t' )
+	{
+		pszLine++;
+	}
+
+	int nLen = (int)strlen( pszLine );
+	while ( nLen > 0 && (unsigned char)pszLine[nLen - 1] <= ' ' )
+	{
+		pszLine[--nLen] = '\0';
+	}
+
+	if ( !nLen || !strncmp( pszLine, "//", 2 ) )
+		return NULL;
+
+	return pszLine;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Parses three numbers separated by spaces or commas, as given to
+//			-batchmove and -batchrotate.
+// Output : Returns false unless there are exactly three numbers.
+//-----------------------------------------------------------------------------
+inline bool VMFBatch_ParseVector( const char *pszValue, float *pflOut )
+{
+	if ( !pszValue )
+		return false;
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		while ( *pszValue == ' ' || *pszValue == '\t' || ( i > 0 && *pszValue == ',' ) )
+		{
+			pszValue++;
+		}
+
+		char *pszEnd;
+		pflOut[i] = (float)strtod( pszValue, &pszEnd );
+		if ( pszEnd == pszValue )
+			return false;
+
+		pszValue = pszEnd;
+	}
+
+	while ( *pszValue == ' ' || *pszValue == '\t' )
+	{
+		pszValue++;
+	}
+
+	return *pszValue == '\0';
+}
+
+#endif // VMFBATCHARGS_H
@@ -0,0 +1,86 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the -batch map list and transform argument
+//			parsing. Needs nothing but a C++ compiler:
+//
+//			g++ -O2 VMFBatchArgs_test.cpp -o VMFBatchArgs_test && ./VMFBatchArgs_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include "VMFBatchArgs.h"
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static bool TrimsTo( const char *pszLine, const char *pszExpected )
+{
+	char szLine[256];
+	strcpy( szLine, pszLine );
+
+	const char *pszMap = VMFBatch_TrimListLine( szLine );
+	if ( !pszMap || !pszExpected )
+		return pszMap == pszExpected;
+
+	return !strcmp( pszMap, pszExpected );
+}
+
+static void TestListLines( void )
+{
+	CHECK( TrimsTo( "maps/a.vmf\n", "maps/a.vmf" ) );
+	CHECK( TrimsTo( "maps/a.vmf\r\n", "maps/a.vmf" ) );
+	CHECK( TrimsTo( " \tmaps/b c.vmf \t\r\n", "maps/b c.vmf" ) );
+	CHECK( TrimsTo( "c:\\maps\\d.vmf", "c:\\maps\\d.vmf" ) );
+	CHECK( TrimsTo( "\n", NULL ) );
+	CHECK( TrimsTo( "", NULL ) );
+	CHECK( TrimsTo( " \t \r\n", NULL ) );
+	CHECK( TrimsTo( "// maps/skipped.vmf\n", NULL ) );
+	CHECK( TrimsTo( "   //maps/skipped.vmf\n", NULL ) );
+	CHECK( TrimsTo( "/maps/rooted.vmf\n", "/maps/rooted.vmf" ) );
+}
+
+static bool ParsesTo( const char *pszValue, float x, float y, float z )
+{
+	float v[3];
+	return VMFBatch_ParseVector( pszValue, v ) && v[0] == x && v[1] == y && v[2] == z;
+}
+
+static bool Rejects( const char *pszValue )
+{
+	float v[3];
+	return !VMFBatch_ParseVector( pszValue, v );
+}
+
+static void TestVectors( void )
+{
+	CHECK( ParsesTo( "0 0 0", 0, 0, 0 ) );
+	CHECK( ParsesTo( "128 -64 32.5", 128, -64, 32.5f ) );
+	CHECK( ParsesTo( "  1,2, 3  ", 1, 2, 3 ) );
+	CHECK( ParsesTo( "0 90 0", 0, 90, 0 ) );
+	CHECK( ParsesTo( "1e3 -1e-1 +4", 1000, -0.1f, 4 ) );
+
+	CHECK( Rejects( NULL ) );
+	CHECK( Rejects( "" ) );
+	CHECK( Rejects( "1 2" ) );
+	CHECK( Rejects( "1 2 3 4" ) );
+	CHECK( Rejects( "1 2 x" ) );
+	CHECK( Rejects( ",1 2 3" ) );
+	CHECK( Rejects( "1 2 3," ) );
+}
+
+int main( void )
+{
+	TestListLines();
+	TestVectors();
+
+	if ( g_nFailures )
+	{
+		printf( "%d failures\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All batch argument tests passed.\n" );
+	return 0;
+}
@@ -0,0 +1,84 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Keeps the root level children of a world stamped with their
+//			position in the world's child list, so that a subset of them (such
+//			as the ones the culling tree finds in a view) can be put back in
+//			world order without walking the whole list.
+//
+//			OBJECT must provide int GetWorldOrder() const and
+//			void SetWorldOrder(int). LIST must provide Count() and an index
+//			operator returning OBJECT *, as CUtlVector does.
+//
+//			Tested standalone by WorldOrder_test.cpp:
+//
+//			g++ -O2 WorldOrder_test.cpp -o WorldOrder_test && ./WorldOrder_test
+//
+//=============================================================================//
+
+#ifndef WORLDORDER_H
+#define WORLDORDER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdlib.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: Stamps the children from the given position on with their position.
+//-----------------------------------------------------------------------------
+template <class LIST>
+inline void WorldOrder_Renumber(const LIST &Children, int nFirst = 0)
+{
+	int nCount = Children.Count();
+	for (int i = nFirst; i < nCount; i++)
+	{
+		Children[i]->SetWorldOrder(i);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the object's stamp is its position in the list.
+//-----------------------------------------------------------------------------
+template <class LIST, class OBJECT>
+inline bool WorldOrder_IsCurrent(const LIST &Children, const OBJECT *pObject)
+{
+	int nOrder = pObject->GetWorldOrder();
+	return (nOrder >= 0) && (nOrder < Children.Count()) && (Children[nOrder] == pObject);
+}
+
+template <class OBJECT>
+int WorldOrder_Compare(const void *pElem1, const void *pElem2)
+{
+	int nOrder1 = (*(OBJECT * const *)pElem1)->GetWorldOrder();
+	int nOrder2 = (*(OBJECT * const *)pElem2)->GetWorldOrder();
+	return (nOrder1 < nOrder2) ? -1 : (nOrder1 > nOrder2);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sorts some of the children into the order they have in the list.
+//			Stamps are kept current as children are added and removed, so
+//			this is normally a sort of just the given objects; if any stamp
+//			has gone stale the whole list is renumbered once first.
+// Input  : Children - The world's children.
+//			ppObjects - Distinct children of the world to sort in place.
+//			nCount - Number of objects.
+//-----------------------------------------------------------------------------
+template <class LIST, class OBJECT>
+void WorldOrder_Sort(const LIST &Children, OBJECT **ppObjects, int nCount)
+{
+	for (int i = 0; i < nCount; i++)
+	{
+		if (!WorldOrder_IsCurrent(Children, ppObjects[i]))
+		{
+			WorldOrder_Renumber(Children);
+			break;
+		}
+	}
+
+	if (nCount > 1)
+	{
+		qsort(ppObjects, nCount, sizeof(OBJECT *), WorldOrder_Compare<OBJECT>);
+	}
+}
+
+#endif // WORLDORDER_H
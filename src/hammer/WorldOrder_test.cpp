@@ -0,0 +1,380 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the 2D view's visible set. A world is edited at
+//			random while views are queried, and the root objects the 2D view
+//			draws from the culling tree result, the objects without a valid
+//			box and the world order stamps are checked against a walk of every
+//			root object in world order, as AddToRenderLists does. Needs nothing
+//			but a C++ compiler:
+//
+//			g++ -O2 WorldOrder_test.cpp -o WorldOrder_test && ./WorldOrder_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+#include <vector>
+#include "WorldOrder.h"
+
+#define TEST_OBJECTS		3000
+#define TEST_STEPS			2000
+#define TEST_GRID_CELLS		16
+#define TEST_WORLD_SIZE		16384
+
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int g_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	g_nSeed = g_nSeed * 1664525 + 1013904223;
+	return nMin + (int)( ( g_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static int g_nRenumbered = 0;
+
+//
+// A root level object with a cull box, as the 2D view sees it.
+//
+struct TestObject_t
+{
+	TestObject_t() : m_nWorldOrder( -1 ), m_bValidBox( true ) {}
+
+	int GetWorldOrder( void ) const { return m_nWorldOrder; }
+	void SetWorldOrder( int nOrder ) { m_nWorldOrder = nOrder; g_nRenumbered++; }
+
+	void Randomize( void )
+	{
+		m_bValidBox = ( RandomInt( 0, 9 ) != 0 );
+		for ( int i = 0; i < 2; i++ )
+		{
+			m_Mins[i] = RandomInt( 0, TEST_WORLD_SIZE - 1 );
+			m_Maxs[i] = m_Mins[i] + RandomInt( 0, RandomInt( 0, 9 ) ? 256 : 4096 );
+			if ( m_Maxs[i] > TEST_WORLD_SIZE - 1 )
+				m_Maxs[i] = TEST_WORLD_SIZE - 1;
+		}
+	}
+
+	bool Intersects( const int *pMins, const int *pMaxs ) const
+	{
+		return m_bValidBox &&
+			( m_Mins[0] <= pMaxs[0] ) && ( m_Maxs[0] >= pMins[0] ) &&
+			( m_Mins[1] <= pMaxs[1] ) && ( m_Maxs[1] >= pMins[1] );
+	}
+
+	int m_nWorldOrder;
+	bool m_bValidBox;
+	int m_Mins[2];
+	int m_Maxs[2];
+};
+
+//
+// The world's child list, with the same Count and index operator as CUtlVector.
+//
+struct TestList_t
+{
+	int Count( void ) const { return (int)m_Objects.size(); }
+	TestObject_t *operator[]( int i ) const { return m_Objects[i]; }
+
+	std::vector<TestObject_t *> m_Objects;
+};
+
+//
+// A world with a grid standing in for the culling tree. Like the tree, an
+// object spanning several cells is reported once, and objects without a valid
+// box are left out of it and kept in their own set.
+//
+class CTestWorld
+{
+public:
+
+	CTestWorld( bool bFastRemove ) : m_bFastRemove( bFastRemove ) {}
+
+	void AddChild( TestObject_t *pObject )
+	{
+		m_Children.m_Objects.push_back( pObject );
+		pObject->SetWorldOrder( m_Children.Count() - 1 );
+		Link( pObject );
+	}
+
+	// Matches CMapClass::RemoveChild and the fixup in CMapWorld::RemoveChild.
+	void RemoveChild( TestObject_t *pObject )
+	{
+		Unlink( pObject );
+
+		int nIndex = pObject->GetWorldOrder();
+		bool bCurrent = WorldOrder_IsCurrent( m_Children, pObject );
+		if ( !bCurrent )
+		{
+			for ( nIndex = 0; m_Children[nIndex] != pObject; nIndex++ )
+				;
+		}
+
+		std::vector<TestObject_t *> &list = m_Children.m_Objects;
+		if ( m_bFastRemove )
+		{
+			list[nIndex] = list.back();
+			list.pop_back();
+		}
+		else
+		{
+			list.erase( list.begin() + nIndex );
+		}
+
+		if ( bCurrent )
+		{
+			if ( m_bFastRemove )
+			{
+				if ( nIndex < m_Children.Count() )
+					m_Children[nIndex]->SetWorldOrder( nIndex );
+			}
+			else
+			{
+				WorldOrder_Renumber( m_Children, nIndex );
+			}
+		}
+	}
+
+	// Matches UpdateChildInDocument relinking the object.
+	void UpdateChild( TestObject_t *pObject )
+	{
+		Unlink( pObject );
+		pObject->Randomize();
+		Link( pObject );
+	}
+
+	// The objects AddWorldToRenderLists draws.
+	void GetVisible( const int *pMins, const int *pMaxs, std::vector<TestObject_t *> &Visible )
+	{
+		Visible.clear();
+		std::set<TestObject_t *> visited;
+
+		int nCellMin[2], nCellMax[2];
+		GetCells( pMins, pMaxs, nCellMin, nCellMax );
+		for ( int x = nCellMin[0]; x <= nCellMax[0]; x++ )
+		{
+			for ( int y = nCellMin[1]; y <= nCellMax[1]; y++ )
+			{
+				const std::set<TestObject_t *> &cell = m_Cells[x][y];
+				for ( std::set<TestObject_t *>::const_iterator it = cell.begin(); it != cell.end(); ++it )
+				{
+					if ( ( *it )->Intersects( pMins, pMaxs ) && visited.insert( *it ).second )
+					{
+						Visible.push_back( *it );
+					}
+				}
+			}
+		}
+
+		Visible.insert( Visible.end(), m_InvalidBoxObjects.begin(), m_InvalidBoxObjects.end() );
+		if ( !Visible.empty() )
+		{
+			WorldOrder_Sort( m_Children, &Visible[0], (int)Visible.size() );
+		}
+	}
+
+	// What AddToRenderLists( pWorld ) would draw of the root level.
+	void GetVisibleByWalk( const int *pMins, const int *pMaxs, std::vector<TestObject_t *> &Visible )
+	{
+		Visible.clear();
+		for ( int i = 0; i < m_Children.Count(); i++ )
+		{
+			TestObject_t *pObject = m_Children[i];
+			if ( !pObject->m_bValidBox || pObject->Intersects( pMins, pMaxs ) )
+			{
+				Visible.push_back( pObject );
+			}
+		}
+	}
+
+	TestList_t m_Children;
+
+private:
+
+	static void GetCells( const int *pMins, const int *pMaxs, int *pCellMin, int *pCellMax )
+	{
+		const int nCellSize = TEST_WORLD_SIZE / TEST_GRID_CELLS;
+		for ( int i = 0; i < 2; i++ )
+		{
+			pCellMin[i] = pMins[i] / nCellSize;
+			pCellMax[i] = pMaxs[i] / nCellSize;
+		}
+	}
+
+	void Link( TestObject_t *pObject )
+	{
+		if ( !pObject->m_bValidBox )
+		{
+			m_InvalidBoxObjects.insert( pObject );
+			return;
+		}
+
+		int nCellMin[2], nCellMax[2];
+		GetCells( pObject->m_Mins, pObject->m_Maxs, nCellMin, nCellMax );
+		for ( int x = nCellMin[0]; x <= nCellMax[0]; x++ )
+			for ( int y = nCellMin[1]; y <= nCellMax[1]; y++ )
+				m_Cells[x][y].insert( pObject );
+	}
+
+	void Unlink( TestObject_t *pObject )
+	{
+		m_InvalidBoxObjects.erase( pObject );
+		for ( int x = 0; x < TEST_GRID_CELLS; x++ )
+			for ( int y = 0; y < TEST_GRID_CELLS; y++ )
+				m_Cells[x][y].erase( pObject );
+	}
+
+	bool m_bFastRemove;
+	std::set<TestObject_t *> m_Cells[TEST_GRID_CELLS][TEST_GRID_CELLS];
+	std::set<TestObject_t *> m_InvalidBoxObjects;
+};
+
+static void RandomView( int *pMins, int *pMaxs )
+{
+	int nSize = RandomInt( 0, 3 ) ? RandomInt( 64, 2048 ) : TEST_WORLD_SIZE;
+	for ( int i = 0; i < 2; i++ )
+	{
+		pMins[i] = RandomInt( 0, TEST_WORLD_SIZE - 1 );
+		pMaxs[i] = pMins[i] + nSize;
+		if ( pMaxs[i] > TEST_WORLD_SIZE - 1 )
+			pMaxs[i] = TEST_WORLD_SIZE - 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Edits a world at random and checks every view against the walk.
+//-----------------------------------------------------------------------------
+static void TestVisibleSet( bool bFastRemove )
+{
+	CTestWorld world( bFastRemove );
+	std::vector<TestObject_t> objects( TEST_OBJECTS );
+	std::vector<TestObject_t *> free;
+
+	for ( int i = 0; i < TEST_OBJECTS; i++ )
+	{
+		objects[i].Randomize();
+		if ( i < TEST_OBJECTS / 2 )
+			world.AddChild( &objects[i] );
+		else
+			free.push_back( &objects[i] );
+	}
+
+	std::vector<TestObject_t *> visible, expected;
+	int nStaleViews = 0;
+
+	for ( int nStep = 0; nStep < TEST_STEPS; nStep++ )
+	{
+		int nEdits = RandomInt( 0, 4 );
+		for ( int nEdit = 0; nEdit < nEdits; nEdit++ )
+		{
+			int nOp = RandomInt( 0, 9 );
+			if ( ( nOp < 3 ) && !free.empty() )
+			{
+				int nFree = RandomInt( 0, (int)free.size() - 1 );
+				TestObject_t *pObject = free[nFree];
+				free[nFree] = free.back();
+				free.pop_back();
+
+				pObject->Randomize();
+				world.AddChild( pObject );
+			}
+			else if ( ( nOp < 6 ) && world.m_Children.Count() )
+			{
+				TestObject_t *pObject = world.m_Children[RandomInt( 0, world.m_Children.Count() - 1 )];
+				world.RemoveChild( pObject );
+				free.push_back( pObject );
+			}
+			else if ( ( nOp < 9 ) && world.m_Children.Count() )
+			{
+				world.UpdateChild( world.m_Children[RandomInt( 0, world.m_Children.Count() - 1 )] );
+			}
+			else if ( world.m_Children.Count() > 1 )
+			{
+				// Something that reorders the list without telling the world,
+				// which the sort must notice.
+				std::vector<TestObject_t *> &list = world.m_Children.m_Objects;
+				int a = RandomInt( 0, (int)list.size() - 1 );
+				int b = RandomInt( 0, (int)list.size() - 1 );
+				TestObject_t *pTemp = list[a];
+				list[a] = list[b];
+				list[b] = pTemp;
+			}
+		}
+
+		int nViews = RandomInt( 1, 3 );
+		for ( int nView = 0; nView < nViews; nView++ )
+		{
+			int vecMins[2], vecMaxs[2];
+			RandomView( vecMins, vecMaxs );
+
+			world.GetVisibleByWalk( vecMins, vecMaxs, expected );
+
+			g_nRenumbered = 0;
+			world.GetVisible( vecMins, vecMaxs, visible );
+			if ( g_nRenumbered )
+				nStaleViews++;
+
+			CHECK( visible == expected );
+		}
+	}
+
+	// Stamps go stale only after the unreported reorders; adds and removes
+	// keep them current.
+	CHECK( nStaleViews < TEST_STEPS / 2 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds and removes keep every stamp current without a renumber.
+//-----------------------------------------------------------------------------
+static void TestStampsStayCurrent( bool bFastRemove )
+{
+	CTestWorld world( bFastRemove );
+	std::vector<TestObject_t> objects( 500 );
+	for ( size_t i = 0; i < objects.size(); i++ )
+	{
+		objects[i].Randomize();
+		world.AddChild( &objects[i] );
+	}
+
+	for ( int i = 0; i < 300; i++ )
+	{
+		world.RemoveChild( world.m_Children[RandomInt( 0, world.m_Children.Count() - 1 )] );
+	}
+
+	for ( int i = 0; i < world.m_Children.Count(); i++ )
+	{
+		CHECK( world.m_Children[i]->GetWorldOrder() == i );
+	}
+
+	int vecMins[2] = { 0, 0 };
+	int vecMaxs[2] = { TEST_WORLD_SIZE - 1, TEST_WORLD_SIZE - 1 };
+	std::vector<TestObject_t *> visible, expected;
+
+	g_nRenumbered = 0;
+	world.GetVisible( vecMins, vecMaxs, visible );
+	CHECK( g_nRenumbered == 0 );
+
+	world.GetVisibleByWalk( vecMins, vecMaxs, expected );
+	CHECK( visible == expected );
+	CHECK( (int)visible.size() == world.m_Children.Count() );
+}
+
+int main( void )
+{
+	TestStampsStayCurrent( false );
+	TestStampsStayCurrent( true );
+	TestVisibleSet( false );
+	TestVisibleSet( true );
+
+	if ( g_nFailures )
+	{
+		printf( "%d failures\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All world order tests passed.\n" );
+	return 0;
+}
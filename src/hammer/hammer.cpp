@@ -38,6 +38,7 @@
 #include "ToolManager.h"
 #include "Hammer.h"
 #include "StudioModel.h"
+#include "MapStudioModel.h"
 #include "ibsplighting.h"
 #include "statusbarids.h"
 #include "tier0/icommandline.h"
@@ -54,6 +55,14 @@
 #include "utlmap.h"
 #include "progdlg.h"
 #include "MapWorld.h"
+#include "MapFace.h"
+#include "FaceMeshCache.h"
+#include "MaterialIndex.h"
+#include "ThumbnailCache.h"
+#include "EditorProfiler.h"
+#include "VMFBatch.h"
+#include "ImageConvert.h"
+#include "vstdlib/jobthread.h"
 #include "HammerVGui.h"
 #include "vgui_controls/Controls.h"
 #include "lpreview_thread.h"
@@ -75,7 +84,6 @@
 #include "tier0/minidump.h"
 #include "tier0/threadtools.h"
 #include "particles/particles.h" //// SLE NEW - particle systems
-//#include "vstdlib\jobthread.h" //// SLE NEW - threading support
 #endif
 #pragma warning(push, 1)
 #pragma warning(disable:4002)
@@ -457,6 +465,7 @@ CHammer::CHammer(void)
 	m_SuppressVideoAllocation = false;
 	m_bForceRenderNextFrame = false;
 	m_bClosing = false;
+	m_nBatchFailures = -1;
 #ifdef HAMMER2013_PORT_KEYBINDS
 	m_CmdLineInfo = new CHammerCmdLine();
 #endif
@@ -1268,16 +1277,28 @@ InitReturnVal_t CHammer::HammerInternalInit()
 
 	m_pMainWnd = pMainFrame;
 
-	CSplashWnd::ShowSplashScreen(pMainFrame);
-	
-	// try to init VGUI
-	HammerVGui()->Init( m_pMainWnd->GetSafeHwnd() );
+	// A batch run processes maps from the command line and exits. Documents
+	// still report to the main frame, so it exists, but it is never shown,
+	// and the splash screen and VGUI, which only serve the views, are not started.
+	const char *pszBatchInput = CommandLine()->ParmValue( "-batch" );
 
-	// The main window has been initialized, so show and update it.
-	//
-	m_nCmdShow = SW_SHOWMAXIMIZED;
-	pMainFrame->ShowWindow(m_nCmdShow);
-	pMainFrame->UpdateWindow();
+	if ( !pszBatchInput )
+	{
+		CSplashWnd::ShowSplashScreen(pMainFrame);
+
+		// try to init VGUI
+		HammerVGui()->Init( m_pMainWnd->GetSafeHwnd() );
+
+		// The main window has been initialized, so show and update it.
+		//
+		m_nCmdShow = SW_SHOWMAXIMIZED;
+		pMainFrame->ShowWindow(m_nCmdShow);
+		pMainFrame->UpdateWindow();
+	}
+	else
+	{
+		m_nCmdShow = SW_HIDE;
+	}
 
 	// Now that we've initialized the file system, we can parse this config's gameinfo.txt for the additional settings there.
 	g_pGameConfig->ParseGameInfo();
@@ -1290,6 +1311,20 @@ InitReturnVal_t CHammer::HammerInternalInit()
 	g_pKeyBinds->GetAccelTableFor("Document", pMapDocTemplate->m_hAccelTable);
 	g_pKeyBinds->GetAccelTableFor("Document", pManifestDocTemplate->m_hAccelTable);
 #endif
+	//
+	// Start the worker threads used by ParallelProcess.
+	//
+	if ( g_pThreadPool->NumThreads() == 0 )
+	{
+		ThreadPoolStartParams_t startParams;
+		g_pThreadPool->Start( startParams );
+	}
+
+	g_MaterialIndex.SetEnabled( !CommandLine()->FindParm( "-nomaterialindex" ) );
+	g_ThumbnailCache.SetEnabled( !CommandLine()->FindParm( "-nothumbnailcache" ) );
+	CStudioModelCache::SetQueuedLoadEnabled( !CommandLine()->FindParm( "-nomodelqueue" ) );
+	g_EditorProfiler.SetEnabled( CommandLine()->FindParm( "-profile" ) != 0 );
+
 	//
 	// Initialize the texture manager and load all textures.
 	//
@@ -1336,7 +1371,10 @@ InitReturnVal_t CHammer::HammerInternalInit()
 	UpdatePrefabs_Init();
 
 	// Indicate that we are ready to use.
-	m_pMainWnd->FlashWindow(TRUE);
+	if ( !pszBatchInput )
+	{
+		m_pMainWnd->FlashWindow(TRUE);
+	}
 
 	// Parse command line for standard shell commands, DDE, file open
 	if ( !IsRunningInEngine() )
@@ -1359,6 +1397,34 @@ InitReturnVal_t CHammer::HammerInternalInit()
 				return INIT_FAILED;
 		}
 	}
+
+	if ( pszBatchInput )
+	{
+		char szReportFile[MAX_PATH];
+		const char *pszReportFile = CommandLine()->ParmValue( "-batchreport" );
+		if ( !pszReportFile )
+		{
+			char szProgramDir[MAX_PATH];
+			APP()->GetDirectory( DIR_PROGRAM, szProgramDir );
+			Q_ComposeFileName( szProgramDir, "hammer_batch.csv", szReportFile, sizeof( szReportFile ) );
+			pszReportFile = szReportFile;
+		}
+
+		VMFBatchTransform_t Transform;
+		if ( CVMFBatch::ParseTransform( CommandLine()->ParmValue( "-batchrotate" ), CommandLine()->ParmValue( "-batchmove" ), Transform ) )
+		{
+			m_nBatchFailures = CVMFBatch::Run( pszBatchInput, CommandLine()->ParmValue( "-batchout" ), pszReportFile, Transform );
+		}
+		else
+		{
+			m_nBatchFailures = 1;
+		}
+
+		// Quit once the message loop starts.
+		m_pMainWnd->PostMessage( WM_CLOSE );
+		return INIT_OK;
+	}
+
 #ifdef SLE //// SLE NEW - option to not show map restore prompt after a crash
 	if ( !Options.general.bClosedCorrectly && Options.general.bShowMapRestorePrompt )
 #else
@@ -1502,7 +1568,7 @@ int CHammer::InternalMainLoop()
 		while (::PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE))
 		{
 			if ( msg.message == WM_QUIT )
-				return 1;
+				return ( m_nBatchFailures >= 0 ) ? m_nBatchFailures : 1;
 
 			if ( !HammerPreTranslateMessage(&msg) )
 			{
@@ -1561,12 +1627,38 @@ void CHammer::Shutdown()
 		}
 	}
 
+#if SLE_STATIC_FACE_MESH
+	g_FaceMeshCache.Purge();
+#endif
+
+	CStudioModelCache::CancelQueuedLoads();
+
+	// Write out the zones recorded with -profile, for chrome://tracing.
+	if ( g_EditorProfiler.IsEnabled() )
+	{
+		char szProgramDir[MAX_PATH];
+		APP()->GetDirectory( DIR_PROGRAM, szProgramDir );
+
+		char szTraceFile[MAX_PATH];
+		Q_ComposeFileName( szProgramDir, "hammer_trace.json", szTraceFile, sizeof( szTraceFile ) );
+		if ( !g_EditorProfiler.WriteChromeTrace( szTraceFile ) )
+		{
+			Warning( "Couldn't write the profile to %s\n", szTraceFile );
+		}
+		g_EditorProfiler.SetEnabled( false );
+	}
+
 	g_Textures.ShutDown();
+	g_MaterialIndex.Purge();
+	g_ThumbnailCache.Shutdown();
+	g_ImageBufferPool.Purge();
 
 	// Shutdown the sound system
 	g_Sounds.ShutDown();
 
 	materials->ModShutdown();
+
+	g_pThreadPool->Stop();
 	BaseClass::Shutdown();
 }
 
@@ -1638,7 +1730,10 @@ int CHammer::ExitInstance()
 
 	SaveStdProfileSettings();
 
-	return CWinApp::ExitInstance();
+	int nExitCode = CWinApp::ExitInstance();
+
+	// Scripts running a batch check the exit code for failed maps.
+	return ( m_nBatchFailures >= 0 ) ? m_nBatchFailures : nExitCode;
 }
 
 //-----------------------------------------------------------------------------
@@ -2272,6 +2367,12 @@ void CHammer::RunFrame(void)
 
 	HammerVGui()->Simulate();
 
+	// Load the studio models queued while documents were opening.
+	if ( CStudioModelCache::UpdateQueuedLoads() )
+	{
+		CMapStudioModel::UpdateQueuedModels();
+	}
+
 #ifdef SLE_USE_HAMMER_LPREVIEW
 	if ( CMapDoc::GetActiveMapDoc() && !IsClosing() || m_bForceRenderNextFrame )
 		HandleLightingPreview();
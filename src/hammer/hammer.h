@@ -208,6 +208,8 @@ protected:
 
 	bool m_bForceRenderNextFrame;
 
+	int m_nBatchFailures;				// Maps that failed in a -batch run, or -1 without one. Becomes the exit code.
+
 	char m_szAppDir[MAX_PATH];
 	char m_szAutosaveDir[MAX_PATH];
 
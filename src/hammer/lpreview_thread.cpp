@@ -11,6 +11,7 @@
 #include "hammer.h"
 #include "mainfrm.h"
 #include "lprvwindow.h"
+#include "EditorProfiler.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -721,6 +722,8 @@ void CLightingPreviewThread::CalculateForLightTask( int nLineMask, int nLineMatc
 
 void CLightingPreviewThread::CalculateForLight( CLightingPreviewLightDescription &l )
 {
+	EDITOR_PROFILE_SCOPE( "CLightingPreviewThread::CalculateForLight" );
+
 	if ( m_pRtEnv && (! m_bAccStructureBuilt ) )
 	{
 		m_bAccStructureBuilt = true;
@@ -10,6 +10,7 @@
 
 #include "KeyValues.h"
 #include "utlvector.h"
+#include "tier1/utlstring.h"
 #include "MapDoc.h"
 
 class BoundBox;
@@ -133,6 +134,7 @@ protected:
 private:
 	void			AddManifestObjectToWorld( CMapClass *pObject, CMapClass *pParent = NULL );
 	void			RemoveManifestObjectFromWorld( CMapClass *pObject, bool bRemoveChildren );
+	static void		FindSubmapFiles( const char *pszFileName, CUtlVector<CUtlString> &FileNames );
 	bool			LoadVMFManifest( const char *pszFileName );
 	bool			LoadVMFManifestUserPrefs( const char *pszFileName );
 	bool			SaveVMFManifest( const char *pszFileName );
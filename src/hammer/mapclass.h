@@ -188,6 +188,19 @@ public:
 	//
 	inline void SetTemporary(bool bTemporary) { m_bTemporary = bTemporary; }
 	inline bool IsTemporary(void) const { return m_bTemporary; }
+
+	//
+	// Position among the world's children, kept by the world (see WorldOrder.h):
+	//
+	inline int GetWorldOrder(void) const { return m_nWorldOrder; }
+	inline void SetWorldOrder(int nOrder) { m_nWorldOrder = nOrder; }
+
+	//
+	// Place in the world's per-type object lists, kept by the world:
+	//
+	inline int GetTypeList(void) const { return m_nTypeList; }
+	inline int GetTypeListPos(void) const { return m_nTypeListPos; }
+	inline void SetTypeListSlot(int nList, int nPos) { m_nTypeList = nList; m_nTypeListPos = nPos; }
 	union
 	{
 		struct
@@ -465,6 +478,9 @@ protected:
 	int m_nID;						// This object's unique ID.
 	bool m_bTemporary;				// Whether to track this object for Undo/Redo.
 	int m_nRenderFrame;				// Frame counter used to avoid rendering the same object twice in a 3D frame.
+	int m_nWorldOrder;				// Our index in the world's children when we are a root level object, -1 or stale otherwise.
+	int m_nTypeList;				// Which of the world's per-type lists we are in, and where; -1 or stale if we aren't.
+	int m_nTypeListPos;
 
 	bool m_bVisible2D : 1;			// Whether this object is visible in the 2D view. Currently only used for morphing.
 	bool m_bVisible : 1;			// Whether this object is currently visible in the 2D and 3D views based on ALL factors: visgroups, cordon, etc.
@@ -248,6 +248,10 @@ class CMapDoc : public CDocument
 		static inline CManifest *GetManifest(void);
 		static inline int GetInLevelLoad( );
 
+		// Loads a run of submaps under one progress dialog.
+		static void BeginBatchLoad( int nFiles );
+		static void EndBatchLoad( void );
+
 	private:
 
 		static CMapDoc		*m_pMapDoc;
@@ -301,6 +305,7 @@ class CMapDoc : public CDocument
 		void	AddReference( void );
 		void	RemoveReference( void );
 		int		GetReferenceCount( void ) { return m_nExternalReferenceCount; }
+		void	DetachFromFile( void );
 
 		// Used to track down a potential crash.
 		bool AnyNotificationsForObject(CMapClass *pObject);
@@ -734,7 +739,7 @@ class CMapDoc : public CDocument
 		//
 		// Search functions.
 		//
-		static BOOL FindEntityCallback(CMapClass *pObject, FindEntity_t *pFindInfo);
+		static BOOL FindEntityCallback(CMapEntity *pEntity, FindEntity_t *pFindInfo);
 		static BOOL FindGroupCallback(CMapGroup *pGroup, FindGroup_t *pFindInfo);
 
 		void AssignToVisGroups(void);
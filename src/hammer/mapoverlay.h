@@ -12,6 +12,7 @@
 #include <afxwin.h>
 #include "utlvector.h"
 #include "MapSideList.h"
+#include "OverlayFaceClips.h"
 
 class CHelperInfo;
 class CMapFace;
@@ -235,10 +236,30 @@ private:
 	//
 	// Clipping
 	//
+	// The overlay as it was last clipped. Cached clips are only reused while
+	// the overlay still projects to the same quad.
+	struct ClipKey_t
+	{
+		Vector		m_vecOrigin;
+		Vector		m_vecNormal;
+		Vector		m_vecPoints[OVERLAY_HANDLES_COUNT];
+		Vector2D	m_vecTexCoords[OVERLAY_HANDLES_COUNT];
+	};
+
+	typedef COverlayFaceClips<CMapFace, ClipFaces_t> FaceClips_t;
+	typedef FaceClips_t::FaceClip_t FaceClip_t;
+
+	struct FaceClipJob_t
+	{
+		CMapOverlay		*m_pOverlay;
+		FaceClip_t		*m_pFaceClip;
+	};
+
 	void PreClip( void );
 	void PostClip( void );
-	void DoClipFace( CMapFace *pFace );
-	void DoClipDisp( CMapFace *pFace, ClipFace_t *pClippedFace );
+	void DoClipFace( CMapFace *pFace, ClipFaces_t &aClipFaces );
+	ClipFace_t *ClipOverlayToFace( CMapFace *pFace );
+	void DoClipDisp( CMapFace *pFace, ClipFace_t *pClippedFace, ClipFaces_t &aClipFaces );
 	void DoClipDispInV( CMapDisp *pDisp, ClipFaces_t &aCurrentFaces );
 	void DoClipDispInU( CMapDisp *pDisp, ClipFaces_t &aCurrentFaces );
 	void DoClipDispInUVFromTLToBR( CMapDisp *pDisp, ClipFaces_t &aCurrentFaces );
@@ -247,6 +268,10 @@ private:
 	void Disp_ClipFragments( CMapDisp *pDisp, ClipFaces_t &aDispFragments );
 	void Disp_DoClip( CMapDisp *pDisp, ClipFaces_t &aDispFragments, cplane_t &clipPlane, float clipDistStart, int nInterval, int nLoopStart, int nLoopEnd, int nLoopInc );
 
+	void ClipKey_Build( ClipKey_t &key );
+	bool ClipKey_Equal( const ClipKey_t &key0, const ClipKey_t &key1 );
+	static void FaceClips_ClipJob( FaceClipJob_t &job );
+
 	//==========================================================================
 	//
 	// Transform
@@ -272,7 +297,11 @@ private:
 	Material_t		m_Material;			// Overlay Material
 
 	ClipFace_t		*m_pOverlayFace;	// Primary Overlay
-	ClipFaces_t		m_aRenderFaces;		// Clipped Face Cache (Render Faces)
+	ClipFaces_t		m_aRenderFaces;		// Render faces of every face clip, in sidelist order (not owned)
+
+	FaceClips_t		m_FaceClips;		// Clipped Face Cache, one per sidelist face
+	ClipKey_t		m_ClipKey;			// Overlay the face clips were made with
+	bool			m_bClipKeyValid;
 
 	unsigned short	m_uiFlags;			//
 	bool			m_bLoaded;
@@ -519,18 +519,26 @@ void CTextureBrowser::OnSelendokTexturesize()
 	// change size of textures the texture window displays
 	int iCurSel = m_cSizeList.GetCurSel();
 
+	int iSize = 0;
 	switch(iCurSel)
 	{
 	case 0:
-		m_cTextureWindow.SetDisplaySize(128);
+		iSize = 128;
 		break;
 	case 1:
-		m_cTextureWindow.SetDisplaySize(256);
+		iSize = 256;
 		break;
 	case 2:
-		m_cTextureWindow.SetDisplaySize(512);
+		iSize = 512;
 		break;
 	}
+
+	if (iSize != 0)
+	{
+		// Previews of larger materials are loaded from the mip that fits this size.
+		CMaterial::SetPreviewSize(iSize);
+		m_cTextureWindow.SetDisplaySize(iSize);
+	}
 #ifdef SLE_TEXTUREBROWSER_FAVOURITES
 	if ( m_cFavouritesWindow )
 	{
@@ -27,7 +27,6 @@ private:
 	static void			Initialize( void );
 	static void			ConvertSolids( CMapWorld * pWorld );
 	static void			ConvertDecals( CMapWorld * pWorld );
-	static bool			CountMapSolids( CMapSolid * pSolid, DWORD );
 	static bool			CountMapDecals( CMapEntity *, DWORD );
 	static bool			CheckSolidTextures( CMapSolid * pSolid, DWORD );
 	static bool			CheckDecalTextures( CMapEntity * pEnt, DWORD );
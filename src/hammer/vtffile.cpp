@@ -2,6 +2,8 @@
 
 #include "vtffile.h"
 #include "filesystem.h"
+#include "ImageConvert.h"
+#include "MaterialPreviewSize.h"
 #include <cstring>
 #include <cmath>
 
@@ -91,27 +93,23 @@ bool CVTFFile::IsLoaded() const
 	return Header != nullptr;
 }
 
-bool CVTFFile::Load( FileHandle_t Reader, bool bHeaderOnly )
+bool CVTFFile::ReadHeader( FileHandle_t Reader, unsigned int uiFileSize )
 {
-	Destroy();
-
-	unsigned int uiThumbnailBufferOffset = 0, uiImageDataOffset = 0;
-	unsigned int uiFileSize = g_pFullFileSystem->Size( Reader );
 	SVTFFileHeader FileHeader{};
 	if ( uiFileSize < sizeof( SVTFFileHeader ) )
-		goto failed;
+		return false;
 
 	if ( g_pFullFileSystem->Read( &FileHeader, sizeof( SVTFFileHeader ), Reader ) != (int)sizeof( SVTFFileHeader ) )
-		goto failed;
+		return false;
 
 	if ( memcmp( FileHeader.TypeString, "VTF\0", 4 ) != 0 )
-		goto failed;
+		return false;
 
 	if ( FileHeader.Version[0] != VTF_MAJOR_VERSION || ( FileHeader.Version[1] < 0 || FileHeader.Version[1] > VTF_MINOR_VERSION ) )
-		goto failed;
+		return false;
 
 	if ( FileHeader.HeaderSize > sizeof( SVTFHeader ) )
-		goto failed;
+		return false;
 
 	g_pFullFileSystem->Seek( Reader, 0, FILESYSTEM_SEEK_HEAD );
 
@@ -122,13 +120,25 @@ bool CVTFFile::Load( FileHandle_t Reader, bool bHeaderOnly )
 	memset( Header, 0, sizeof( SVTFHeader ) );
 
 	if ( g_pFullFileSystem->Read( Header, FileHeader.HeaderSize, Reader ) != (int)FileHeader.HeaderSize )
-		goto failed;
+		return false;
 
 	if ( Header->Version[0] < VTF_MAJOR_VERSION || ( Header->Version[0] == VTF_MAJOR_VERSION && Header->Version[1] < VTF_MINOR_VERSION_MIN_VOLUME ) )
 		Header->Depth = 1;
 
 	Header->ResourceCount = 0;
 
+	return true;
+}
+
+bool CVTFFile::Load( FileHandle_t Reader, bool bHeaderOnly )
+{
+	Destroy();
+
+	unsigned int uiThumbnailBufferOffset = 0, uiImageDataOffset = 0;
+	unsigned int uiFileSize = g_pFullFileSystem->Size( Reader );
+	if ( !ReadHeader( Reader, uiFileSize ) )
+		goto failed;
+
 	if ( bHeaderOnly )
 		return true;
 
@@ -235,6 +245,87 @@ failed:
 	return false;
 }
 
+bool CVTFFile::LoadPreview( FileHandle_t Reader, unsigned int uiMinWidth, unsigned int uiMinHeight )
+{
+	Destroy();
+
+	SVTFPreviewLevel Level{};
+	unsigned int uiFileSize = g_pFullFileSystem->Size( Reader );
+	if ( !ReadHeader( Reader, uiFileSize ) )
+		goto failed;
+
+	if ( !SelectPreviewLevel( uiMinWidth, uiMinHeight, Level ) )
+		goto failed;
+
+	if ( Level.uiOffset + Level.uiSize > uiFileSize )
+		goto failed;
+
+	uiImageBufferSize = Level.uiSize;
+	lpImageData = new unsigned char[uiImageBufferSize];
+
+	g_pFullFileSystem->Seek( Reader, Level.uiOffset, FILESYSTEM_SEEK_HEAD );
+	if ( g_pFullFileSystem->Read( lpImageData, uiImageBufferSize, Reader ) != (int)uiImageBufferSize )
+		goto failed;
+
+	// from here on the file is a single image of the loaded level
+	Header->Width = Level.uiWidth;
+	Header->Height = Level.uiHeight;
+	Header->Format = Level.Format;
+	Header->MipCount = 1; // override
+	Header->Depth = 1;    // override
+	Header->Frames = 1;   // override
+
+	g_pFullFileSystem->Close( Reader );
+	return true;
+
+failed:
+	Destroy();
+	g_pFullFileSystem->Close( Reader );
+	return false;
+}
+
+bool CVTFFile::SelectPreviewLevel( unsigned int uiMinWidth, unsigned int uiMinHeight, SVTFPreviewLevel& Level ) const
+{
+	const unsigned int TEXTUREFLAGS_ONEBITALPHA = 0x00001000;
+	const unsigned int TEXTUREFLAGS_EIGHTBITALPHA = 0x00002000;
+	if ( !IsLoaded() || Header->Format == IMAGE_FORMAT_UNKNOWN || Header->MipCount == 0 )
+		return false;
+
+	// same sequential layout Load uses: thumbnail right after the header, then the mips
+	unsigned int uiThumbnailBufferSize = 0;
+	if ( Header->LowResImageFormat != IMAGE_FORMAT_UNKNOWN )
+		uiThumbnailBufferSize = CVTFFile::ComputeImageSize( Header->LowResImageWidth, Header->LowResImageHeight, 1, Header->LowResImageFormat );
+
+	// the thumbnail has no alpha, so it only stands in for opaque textures
+	if ( uiThumbnailBufferSize != 0 &&
+		 Header->LowResImageWidth >= uiMinWidth && Header->LowResImageHeight >= uiMinHeight &&
+		 ( Header->Flags & ( TEXTUREFLAGS_ONEBITALPHA | TEXTUREFLAGS_EIGHTBITALPHA ) ) == 0 &&
+		 GetImageFormatInfo( Header->LowResImageFormat ).bIsSupported )
+	{
+		Level.bThumbnail = true;
+		Level.uiMipmapLevel = 0;
+		Level.uiWidth = Header->LowResImageWidth;
+		Level.uiHeight = Header->LowResImageHeight;
+		Level.Format = Header->LowResImageFormat;
+		Level.uiOffset = Header->HeaderSize;
+		Level.uiSize = uiThumbnailBufferSize;
+		return true;
+	}
+
+	// the smallest mip that is big enough
+	unsigned int uiMipmapLevel = MaterialPreview_SelectMip( Header->Width, Header->Height, Header->MipCount, uiMinWidth, uiMinHeight );
+
+	unsigned int uiMipmapDepth;
+	CVTFFile::ComputeMipmapDimensions( Header->Width, Header->Height, Header->Depth, uiMipmapLevel, Level.uiWidth, Level.uiHeight, uiMipmapDepth );
+
+	Level.bThumbnail = false;
+	Level.uiMipmapLevel = uiMipmapLevel;
+	Level.Format = Header->Format;
+	Level.uiOffset = Header->HeaderSize + uiThumbnailBufferSize + ComputeDataOffset( 0, 0, 0, uiMipmapLevel, Header->Format );
+	Level.uiSize = CVTFFile::ComputeMipmapSize( Header->Width, Header->Height, 1, uiMipmapLevel, Header->Format );
+	return true;
+}
+
 unsigned int CVTFFile::GetWidth() const
 {
 	if ( !IsLoaded() )
@@ -1161,6 +1252,13 @@ bool CVTFFile::Convert( const unsigned char* lpSource, unsigned char* lpDest, un
 		return true;
 	}
 
+	if ( ( SourceFormat == IMAGE_FORMAT_RGBA8888 && DestFormat == IMAGE_FORMAT_BGRA8888 ) ||
+		 ( SourceFormat == IMAGE_FORMAT_BGRA8888 && DestFormat == IMAGE_FORMAT_RGBA8888 ) )
+	{
+		ImageConvert_SwapRB( lpSource, lpDest, uiWidth * uiHeight );
+		return true;
+	}
+
 	if ( SourceFormat == IMAGE_FORMAT_RGB888 && DestFormat == IMAGE_FORMAT_RGBA8888 )
 	{
 		const unsigned char* lpLast = lpSource + CVTFFile::ComputeImageSize( uiWidth, uiHeight, 1, SourceFormat );
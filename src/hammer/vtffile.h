@@ -116,6 +116,17 @@ struct SImageFormatInfo
 };
 #pragma pack()
 
+struct SVTFPreviewLevel
+{
+	bool			bThumbnail;				//!< Level is the low res thumbnail rather than a mipmap.
+	unsigned int	uiMipmapLevel;			//!< Mipmap level, 0 for the thumbnail.
+	unsigned int	uiWidth;				//!< Width of the level.
+	unsigned int	uiHeight;				//!< Height of the level.
+	ImageFormat		Format;					//!< Format of the level.
+	unsigned int	uiOffset;				//!< Offset of the first face of the level from the start of the file.
+	unsigned int	uiSize;					//!< Size of the first face of the level.
+};
+
 class CVTFFile final
 {
 private:
@@ -135,7 +146,18 @@ public:
 	bool IsLoaded() const;
 
 	bool Load( FileHandle_t Reader, bool bHeaderOnly );
+
+	// Loads only the level picked by SelectPreviewLevel. Afterwards the file
+	// looks like a single image of that level's size and format.
+	bool LoadPreview( FileHandle_t Reader, unsigned int uiMinWidth, unsigned int uiMinHeight );
+
+	// Picks the smallest level that is at least uiMinWidth x uiMinHeight, or
+	// mip 0 if none is. Only needs the header, so it can be checked after
+	// Load( Reader, true ).
+	bool SelectPreviewLevel( unsigned int uiMinWidth, unsigned int uiMinHeight, SVTFPreviewLevel& Level ) const;
 private:
+	bool ReadHeader( FileHandle_t Reader, unsigned int uiFileSize );
+
 	static bool IsPowerOfTwo( unsigned int uiSize );
 	static unsigned int NextPowerOfTwo( unsigned int uiSize );
 
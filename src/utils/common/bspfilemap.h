@@ -0,0 +1,108 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Maps a BSP file into memory so its lumps can be read in place.
+//			Kept free of other includes so it can be tested on its own:
+//
+//			g++ -O2 bspfilemap_test.cpp -o bspfilemap_test && ./bspfilemap_test [file.bsp ...]
+//
+//=============================================================================//
+
+#ifndef BSPFILEMAP_H
+#define BSPFILEMAP_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+//	Maps a file on disk privately: pages are read as they are touched and
+//	writes (byte swapping the header) are not seen by the file. Returns NULL
+//	if the file can't be mapped, e.g. when it's only reachable through the
+//	filesystem's search paths.
+//-----------------------------------------------------------------------------
+inline void *MapBSPFile( const char *filename, int *pSize )
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFile( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	DWORD nSizeHigh = 0;
+	DWORD nSize = GetFileSize( hFile, &nSizeHigh );
+	if ( nSizeHigh != 0 || nSize == 0 || nSize > 0x7fffffff )
+	{
+		CloseHandle( hFile );
+		return NULL;
+	}
+
+	void *pData = NULL;
+	HANDLE hMapping = CreateFileMapping( hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if ( hMapping )
+	{
+		// the view keeps the file open
+		pData = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+		CloseHandle( hMapping );
+	}
+	CloseHandle( hFile );
+
+	*pSize = (int)nSize;
+	return pData;
+#else
+	int fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
+		return NULL;
+
+	struct stat info;
+	if ( fstat( fd, &info ) != 0 || info.st_size == 0 || info.st_size > 0x7fffffff )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	// the mapping keeps the file open
+	void *pData = mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( pData == MAP_FAILED )
+		return NULL;
+
+	*pSize = (int)info.st_size;
+	return pData;
+#endif
+}
+
+inline void UnmapBSPFile( void *pData, int nSize )
+{
+#ifdef _WIN32
+	UnmapViewOfFile( pData );
+#else
+	munmap( pData, nSize );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	Returns a lump of a file in memory where it lies, and the number of
+//	nElementSize elements in it, or NULL if the lump is empty. The lump must
+//	have been checked with CheckBSPLump.
+//-----------------------------------------------------------------------------
+inline const void *GetBSPLumpInPlace( const void *pFile, int nFileOfs, int nFileLen, int nElementSize, int *pCount )
+{
+	*pCount = 0;
+	if ( nFileLen <= 0 )
+		return NULL;
+
+	*pCount = nFileLen / nElementSize;
+	return (const unsigned char *)pFile + nFileOfs;
+}
+
+#endif // BSPFILEMAP_H
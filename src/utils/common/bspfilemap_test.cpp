@@ -0,0 +1,386 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of mapping BSP files and reading their lumps in
+//			place. Writes sample BSPs, maps them and checks every lump and
+//			game lump reads back as written. BSPs named on the command line
+//			are mapped and checked against a plain read of the file too:
+//
+//			g++ -O2 bspfilemap_test.cpp -o bspfilemap_test && ./bspfilemap_test [file.bsp ...]
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "bsplumpcheck.h"
+#include "bspfilemap.h"
+
+// The on-disk layout from bspfile.h and gamebspfile.h.
+#define SAMPLE_HEADER_LUMPS		64
+#define SAMPLE_LUMP_GAME_LUMP	35
+#define SAMPLE_IDBSPHEADER		( ( 'P' << 24 ) + ( 'S' << 16 ) + ( 'B' << 8 ) + 'V' )
+
+struct SampleLump_t
+{
+	int		fileofs;
+	int		filelen;
+	int		version;
+	char	fourCC[4];
+};
+
+struct SampleHeader_t
+{
+	int				ident;
+	int				version;
+	SampleLump_t	lumps[SAMPLE_HEADER_LUMPS];
+	int				mapRevision;
+};
+
+struct SampleGameLump_t
+{
+	int				id;
+	unsigned short	flags;
+	unsigned short	version;
+	int				fileofs;
+	int				filelen;
+};
+
+static const char *s_pszSampleFile = "bspfilemap_test.bsp";
+static int g_nFailures = 0;
+
+#define CHECK( expr ) do { if ( !( expr ) ) { printf( "FAIL: %s (line %d)\n", #expr, __LINE__ ); g_nFailures++; } } while ( 0 )
+
+static unsigned int s_nSeed = 12345;
+
+static int RandomInt( int nMin, int nMax )
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return nMin + (int)( ( s_nSeed >> 8 ) % (unsigned int)( nMax - nMin + 1 ) );
+}
+
+static void AppendBytes( std::vector<unsigned char> &File, int nCount )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		File.push_back( (unsigned char)RandomInt( 0, 255 ) );
+	}
+}
+
+static void AppendData( std::vector<unsigned char> &File, const void *pData, int nSize )
+{
+	File.insert( File.end(), (const unsigned char *)pData, (const unsigned char *)pData + nSize );
+}
+
+//-----------------------------------------------------------------------------
+//	Builds a BSP with random lumps, some empty, and a game lump whose entries
+//	point at data after it.
+//-----------------------------------------------------------------------------
+static std::vector<unsigned char> BuildSampleBSP( void )
+{
+	std::vector<unsigned char> File( sizeof( SampleHeader_t ) );
+	SampleHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.ident = SAMPLE_IDBSPHEADER;
+	header.version = 20;
+
+	for ( int i = 0; i < SAMPLE_HEADER_LUMPS; i++ )
+	{
+		if ( i == SAMPLE_LUMP_GAME_LUMP || RandomInt( 0, 3 ) == 0 )
+			continue;
+
+		header.lumps[i].fileofs = (int)File.size();
+		header.lumps[i].filelen = RandomInt( 1, 1000 ) * 4;
+		AppendBytes( File, header.lumps[i].filelen );
+	}
+
+	int nGameLumps = RandomInt( 0, 4 );
+	int nGameLumpOfs = (int)File.size();
+	int nDirectorySize = (int)( sizeof( int ) + nGameLumps * sizeof( SampleGameLump_t ) );
+	int nDataOfs = nGameLumpOfs + nDirectorySize;
+
+	AppendData( File, &nGameLumps, sizeof( int ) );
+	std::vector<SampleGameLump_t> Entries( nGameLumps );
+	for ( int i = 0; i < nGameLumps; i++ )
+	{
+		Entries[i].id = ( ( 's' << 24 ) + ( 'p' << 16 ) + ( 'r' << 8 ) + 'p' ) + i;
+		Entries[i].flags = 0;
+		Entries[i].version = 10;
+		Entries[i].fileofs = nDataOfs;
+		Entries[i].filelen = RandomInt( 0, 500 );
+		nDataOfs += Entries[i].filelen;
+		AppendData( File, &Entries[i], sizeof( SampleGameLump_t ) );
+	}
+	AppendBytes( File, nDataOfs - (int)File.size() );
+
+	header.lumps[SAMPLE_LUMP_GAME_LUMP].fileofs = nGameLumpOfs;
+	header.lumps[SAMPLE_LUMP_GAME_LUMP].filelen = nDataOfs - nGameLumpOfs;
+
+	memcpy( &File[0], &header, sizeof( header ) );
+	return File;
+}
+
+static bool WriteFile( const char *pszFile, const unsigned char *pData, int nSize )
+{
+	FILE *fp = fopen( pszFile, "wb" );
+	if ( !fp )
+		return false;
+
+	bool bOK = ( nSize == 0 ) || ( fwrite( pData, nSize, 1, fp ) == 1 );
+	fclose( fp );
+	return bOK;
+}
+
+static bool ReadFile( const char *pszFile, std::vector<unsigned char> &Data )
+{
+	FILE *fp = fopen( pszFile, "rb" );
+	if ( !fp )
+		return false;
+
+	fseek( fp, 0, SEEK_END );
+	Data.resize( ftell( fp ) );
+	fseek( fp, 0, SEEK_SET );
+	bool bOK = Data.empty() || ( fread( &Data[0], Data.size(), 1, fp ) == 1 );
+	fclose( fp );
+	return bOK;
+}
+
+//-----------------------------------------------------------------------------
+//	Runs the checks OpenBSPFile and ParseGameLump make on a mapped file.
+//-----------------------------------------------------------------------------
+static BSPLumpCheck_t ValidateMappedBSP( const unsigned char *pFile, int nFileSize )
+{
+	if ( nFileSize < (int)sizeof( SampleHeader_t ) )
+		return BSPLUMP_TRUNCATED;
+
+	const SampleHeader_t *pHeader = (const SampleHeader_t *)pFile;
+	for ( int i = 0; i < SAMPLE_HEADER_LUMPS; i++ )
+	{
+		BSPLumpCheck_t check = CheckBSPLump( pHeader->lumps[i].fileofs, pHeader->lumps[i].filelen, nFileSize );
+		if ( check != BSPLUMP_OK )
+			return check;
+	}
+
+	const SampleLump_t &gameLump = pHeader->lumps[SAMPLE_LUMP_GAME_LUMP];
+	if ( gameLump.filelen <= 0 )
+		return BSPLUMP_OK;
+
+	if ( gameLump.filelen < (int)sizeof( int ) )
+		return BSPLUMP_TRUNCATED;
+
+	int nCount;
+	memcpy( &nCount, pFile + gameLump.fileofs, sizeof( int ) );
+	BSPLumpCheck_t check = CheckBSPGameLumpCount( nCount, gameLump.filelen, sizeof( int ), sizeof( SampleGameLump_t ) );
+	if ( check != BSPLUMP_OK )
+		return check;
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		SampleGameLump_t entry;
+		memcpy( &entry, pFile + gameLump.fileofs + sizeof( int ) + i * sizeof( SampleGameLump_t ), sizeof( entry ) );
+		check = CheckBSPLump( entry.fileofs, entry.filelen, nFileSize );
+		if ( check != BSPLUMP_OK )
+			return check;
+	}
+
+	return BSPLUMP_OK;
+}
+
+//-----------------------------------------------------------------------------
+//	Maps a file and checks that every lump read in place matches Expected.
+//-----------------------------------------------------------------------------
+static void CheckMappedLumps( const char *pszFile, const std::vector<unsigned char> &Expected )
+{
+	int nSize = 0;
+	unsigned char *pFile = (unsigned char *)MapBSPFile( pszFile, &nSize );
+	CHECK( pFile != NULL );
+	if ( !pFile )
+		return;
+
+	CHECK( nSize == (int)Expected.size() );
+	if ( nSize != (int)Expected.size() || ValidateMappedBSP( pFile, nSize ) != BSPLUMP_OK )
+	{
+		printf( "FAIL: %s doesn't map or has a bad lump directory\n", pszFile );
+		g_nFailures++;
+		UnmapBSPFile( pFile, nSize );
+		return;
+	}
+
+	const SampleHeader_t *pHeader = (const SampleHeader_t *)pFile;
+	for ( int i = 0; i < SAMPLE_HEADER_LUMPS; i++ )
+	{
+		const SampleLump_t &lump = pHeader->lumps[i];
+
+		int nCount;
+		const void *pLump = GetBSPLumpInPlace( pFile, lump.fileofs, lump.filelen, sizeof( int ), &nCount );
+		if ( lump.filelen == 0 )
+		{
+			CHECK( pLump == NULL && nCount == 0 );
+			continue;
+		}
+
+		CHECK( pLump == pFile + lump.fileofs );
+		CHECK( nCount == lump.filelen / (int)sizeof( int ) );
+		CHECK( !memcmp( pLump, &Expected[lump.fileofs], lump.filelen ) );
+	}
+
+	// game lumps, through their directory
+	const SampleLump_t &gameLump = pHeader->lumps[SAMPLE_LUMP_GAME_LUMP];
+	int nCount = 0;
+	if ( gameLump.filelen > 0 )
+	{
+		memcpy( &nCount, pFile + gameLump.fileofs, sizeof( int ) );
+	}
+	const SampleGameLump_t *pEntries = (const SampleGameLump_t *)( pFile + gameLump.fileofs + sizeof( int ) );
+	for ( int i = 0; i < nCount; i++ )
+	{
+		int nBytes;
+		const void *pLump = GetBSPLumpInPlace( pFile, pEntries[i].fileofs, pEntries[i].filelen, 1, &nBytes );
+		CHECK( nBytes == pEntries[i].filelen );
+		CHECK( !nBytes || !memcmp( pLump, &Expected[pEntries[i].fileofs], nBytes ) );
+	}
+
+	UnmapBSPFile( pFile, nSize );
+}
+
+static void TestSampleFiles( void )
+{
+	for ( int nSample = 0; nSample < 50; nSample++ )
+	{
+		std::vector<unsigned char> File = BuildSampleBSP();
+		CHECK( WriteFile( s_pszSampleFile, &File[0], (int)File.size() ) );
+		CheckMappedLumps( s_pszSampleFile, File );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	Writes to the mapping (byte swapping) must not reach the file.
+//-----------------------------------------------------------------------------
+static void TestCopyOnWrite( void )
+{
+	std::vector<unsigned char> File = BuildSampleBSP();
+	CHECK( WriteFile( s_pszSampleFile, &File[0], (int)File.size() ) );
+
+	int nSize = 0;
+	unsigned char *pFile = (unsigned char *)MapBSPFile( s_pszSampleFile, &nSize );
+	CHECK( pFile != NULL );
+	if ( !pFile )
+		return;
+
+	for ( int i = 0; i < nSize; i++ )
+	{
+		pFile[i] ^= 0xff;
+	}
+	UnmapBSPFile( pFile, nSize );
+
+	std::vector<unsigned char> Reread;
+	CHECK( ReadFile( s_pszSampleFile, Reread ) );
+	CHECK( Reread == File );
+}
+
+//-----------------------------------------------------------------------------
+//	Truncated files and bad game lump entries are caught before anything is
+//	read from them.
+//-----------------------------------------------------------------------------
+static void TestBadFiles( void )
+{
+	// missing and empty files can't be mapped
+	int nSize = 0;
+	remove( s_pszSampleFile );
+	CHECK( MapBSPFile( s_pszSampleFile, &nSize ) == NULL );
+	CHECK( WriteFile( s_pszSampleFile, NULL, 0 ) );
+	CHECK( MapBSPFile( s_pszSampleFile, &nSize ) == NULL );
+
+	for ( int nSample = 0; nSample < 20; nSample++ )
+	{
+		std::vector<unsigned char> File = BuildSampleBSP();
+
+		// cut short anywhere past the header
+		int nCut = RandomInt( (int)sizeof( SampleHeader_t ), (int)File.size() - 1 );
+		CHECK( WriteFile( s_pszSampleFile, &File[0], nCut ) );
+
+		unsigned char *pFile = (unsigned char *)MapBSPFile( s_pszSampleFile, &nSize );
+		CHECK( pFile != NULL && nSize == nCut );
+		if ( pFile )
+		{
+			CHECK( ValidateMappedBSP( pFile, nSize ) == BSPLUMP_TRUNCATED );
+			UnmapBSPFile( pFile, nSize );
+		}
+	}
+
+	// a game lump entry pointing past the end of the file
+	std::vector<unsigned char> File;
+	int nCount = 0;
+	SampleHeader_t header;
+	while ( nCount == 0 )
+	{
+		File = BuildSampleBSP();
+		memcpy( &header, &File[0], sizeof( header ) );
+		memcpy( &nCount, &File[header.lumps[SAMPLE_LUMP_GAME_LUMP].fileofs], sizeof( int ) );
+	}
+
+	int nEntryOfs = header.lumps[SAMPLE_LUMP_GAME_LUMP].fileofs + sizeof( int ) + RandomInt( 0, nCount - 1 ) * sizeof( SampleGameLump_t );
+	SampleGameLump_t entry;
+	memcpy( &entry, &File[nEntryOfs], sizeof( entry ) );
+	entry.fileofs = (int)File.size() - entry.filelen + 1;
+	entry.filelen = entry.filelen ? entry.filelen : 1;
+	memcpy( &File[nEntryOfs], &entry, sizeof( entry ) );
+	CHECK( ValidateMappedBSP( &File[0], (int)File.size() ) == BSPLUMP_TRUNCATED );
+
+	// and a count the game lump can't hold
+	nCount = 1000;
+	memcpy( &File[header.lumps[SAMPLE_LUMP_GAME_LUMP].fileofs], &nCount, sizeof( int ) );
+	CHECK( ValidateMappedBSP( &File[0], (int)File.size() ) == BSPLUMP_TRUNCATED );
+	nCount = -1;
+	memcpy( &File[header.lumps[SAMPLE_LUMP_GAME_LUMP].fileofs], &nCount, sizeof( int ) );
+	CHECK( ValidateMappedBSP( &File[0], (int)File.size() ) == BSPLUMP_BAD_ENTRY );
+}
+
+//-----------------------------------------------------------------------------
+//	Real BSPs: the mapping must match a plain read, and every lump and game
+//	lump must pass the checks.
+//-----------------------------------------------------------------------------
+static void TestBSPFile( const char *pszFile )
+{
+	std::vector<unsigned char> Data;
+	CHECK( ReadFile( pszFile, Data ) );
+	if ( Data.size() < sizeof( SampleHeader_t ) )
+	{
+		printf( "FAIL: %s is too small to be a BSP file\n", pszFile );
+		g_nFailures++;
+		return;
+	}
+
+	const SampleHeader_t *pHeader = (const SampleHeader_t *)&Data[0];
+	CHECK( pHeader->ident == SAMPLE_IDBSPHEADER );
+	CheckMappedLumps( pszFile, Data );
+
+	int nLumps = 0;
+	for ( int i = 0; i < SAMPLE_HEADER_LUMPS; i++ )
+	{
+		nLumps += ( pHeader->lumps[i].filelen > 0 );
+	}
+	printf( "%s: %d bytes, %d lumps\n", pszFile, (int)Data.size(), nLumps );
+}
+
+int main( int argc, char **argv )
+{
+	TestSampleFiles();
+	TestCopyOnWrite();
+	TestBadFiles();
+	remove( s_pszSampleFile );
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		TestBSPFile( argv[i] );
+	}
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All BSP mapping tests passed\n" );
+	return 0;
+}
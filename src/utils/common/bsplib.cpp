@@ -25,6 +25,8 @@
 #include "physdll.h"
 #include "tier0/dbg.h"
 #include "lumpfiles.h"
+#include "bsplumpcheck.h"
+#include "bspfilemap.h"
 #include "vtf/vtf.h"
 
 //=============================================================================
@@ -703,6 +705,11 @@ template< class T > static void AddLump( int lumpnum, CUtlVector<T> &data, int v
 dheader_t		*g_pBSPHeader;
 FileHandle_t	g_hBSPFile;
 
+// Size of the file opened by OpenBSPFile, and whether g_pBSPHeader points at
+// a mapping of it rather than a copy made by LoadFile.
+static int		g_nBSPFileSize;
+static bool		g_bBSPFileMapped;
+
 struct Lump_t
 {
 	void	*pLumps[HEADER_LUMPS];
@@ -1164,11 +1171,19 @@ void CGameLump::ParseGameLump( dheader_t* pHeader )
 	if (length > 0)
 	{
 		// Read dictionary...
+		if ( length < (int)sizeof( dgamelumpheader_t ) )
+		{
+			Error( "The game lump is too small to hold its directory" );
+		}
 		dgamelumpheader_t* pGameLumpHeader = (dgamelumpheader_t*)((byte *)pHeader + ofs);
 		if ( g_bSwapOnLoad )
 		{
 			g_Swap.SwapFieldsToTargetEndian( pGameLumpHeader );
 		}
+		if ( CheckBSPGameLumpCount( pGameLumpHeader->lumpCount, length, sizeof( dgamelumpheader_t ), sizeof( dgamelump_t ) ) != BSPLUMP_OK )
+		{
+			Error( "The game lump directory has a bad count (%d)", pGameLumpHeader->lumpCount );
+		}
 		dgamelump_t* pGameLump = (dgamelump_t*)(pGameLumpHeader + 1);
 		for (int i = 0; i < pGameLumpHeader->lumpCount; ++i )
 		{
@@ -1177,6 +1192,12 @@ void CGameLump::ParseGameLump( dheader_t* pHeader )
 				g_Swap.SwapFieldsToTargetEndian( &pGameLump[i] );
 			}
 
+			// the entries point into the file, not into the game lump
+			if ( CheckBSPLump( pGameLump[i].fileofs, pGameLump[i].filelen, g_nBSPFileSize ) != BSPLUMP_OK )
+			{
+				Error( "Game lump %d runs past the end of the file", i );
+			}
+
 			int length = pGameLump[i].filelen;
 			GameLumpHandle_t lump = g_GameLumps.CreateGameLump( pGameLump[i].id, length, pGameLump[i].flags, pGameLump[i].version );
 			if ( g_bSwapOnLoad )
@@ -2117,16 +2138,49 @@ void ValidateHeader( const char *filename, const dheader_t *pHeader )
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	Makes sure every lump lies inside the file, so lumps can be read straight
+//	from it.
+//-----------------------------------------------------------------------------
+static void ValidateLumpDirectory( const char *filename, const dheader_t *pHeader, int nFileSize )
+{
+	for ( int i = 0; i < HEADER_LUMPS; i++ )
+	{
+		const lump_t &lump = pHeader->lumps[i];
+		BSPLumpCheck_t check = CheckBSPLump( lump.fileofs, lump.filelen, nFileSize );
+		if ( check == BSPLUMP_BAD_ENTRY )
+		{
+			Error( "%s has a bad directory entry for lump %d", filename, i );
+		}
+		else if ( check == BSPLUMP_TRUNCATED )
+		{
+			Error( "%s is truncated: lump %d runs past the end of the file", filename, i );
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 //	Low level BSP opener for external parsing. Parses headers, but nothing else.
+//	Lumps are read in place, straight from a mapping of the file when it can
+//	be mapped, so only the lumps that are used get read from disk.
 //	You must close the BSP, via CloseBSPFile().
 //-----------------------------------------------------------------------------
 void OpenBSPFile( const char *filename )
 {
 	Lumps_Init();
 
-	// load the file header
-	LoadFile( filename, (void **)&g_pBSPHeader );
+	g_pBSPHeader = (dheader_t *)MapBSPFile( filename, &g_nBSPFileSize );
+	g_bBSPFileMapped = ( g_pBSPHeader != NULL );
+	if ( !g_bBSPFileMapped )
+	{
+		// load the file
+		g_nBSPFileSize = LoadFile( filename, (void **)&g_pBSPHeader );
+	}
+
+	if ( g_nBSPFileSize < (int)sizeof( dheader_t ) )
+	{
+		Error( "%s is too small to be a BSP file", filename );
+	}
 
 	if ( g_bSwapOnLoad )
 	{
@@ -2135,6 +2189,7 @@ void OpenBSPFile( const char *filename )
 	}
 
 	ValidateHeader( filename, g_pBSPHeader );
+	ValidateLumpDirectory( filename, g_pBSPHeader, g_nBSPFileSize );
 
 	g_MapRevision = g_pBSPHeader->mapRevision;
 }
@@ -2144,8 +2199,36 @@ void OpenBSPFile( const char *filename )
 //-----------------------------------------------------------------------------
 void CloseBSPFile( void )
 {
-	free( g_pBSPHeader );
+	if ( g_bBSPFileMapped )
+	{
+		UnmapBSPFile( g_pBSPHeader, g_nBSPFileSize );
+	}
+	else
+	{
+		free( g_pBSPHeader );
+	}
+
 	g_pBSPHeader = NULL;
+	g_nBSPFileSize = 0;
+	g_bBSPFileMapped = false;
+}
+
+//-----------------------------------------------------------------------------
+//	Returns a lump of the BSP opened by OpenBSPFile where it lies, without
+//	copying it. Returns NULL if the lump is empty or the file is byte swapped
+//	on load; such lumps must be copied out instead. Valid until CloseBSPFile().
+//-----------------------------------------------------------------------------
+const void *GetLumpData( int lump, int nElementSize, int *pCount, int forceVersion )
+{
+	*pCount = 0;
+
+	if ( g_bSwapOnLoad || !HasLump( lump ) )
+		return NULL;
+
+	const lump_t &lumpInfo = g_pBSPHeader->lumps[lump];
+	ValidateLump( lump, lumpInfo.filelen, nElementSize, forceVersion );
+
+	return GetBSPLumpInPlace( g_pBSPHeader, lumpInfo.fileofs, lumpInfo.filelen, nElementSize, pCount );
 }
 
 //-----------------------------------------------------------------------------
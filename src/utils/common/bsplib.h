@@ -288,6 +288,15 @@ int		CompressVis (byte *vis, byte *dest);
 
 void	OpenBSPFile( const char *filename );
 void	CloseBSPFile(void);
+const void *GetLumpData( int lump, int nElementSize, int *pCount, int forceVersion = -1 );
+
+// Typed GetLumpData: GetLumpView<dplane_t>( LUMP_PLANES, &numplanes ).
+template< class T >
+inline const T *GetLumpView( int lump, int *pCount, int forceVersion = -1 )
+{
+	return (const T *)GetLumpData( lump, sizeof( T ), pCount, forceVersion );
+}
+
 void	LoadBSPFile( const char *filename );
 void	LoadBSPFile_FileSystemOnly( const char *filename );
 void	LoadBSPFileTexinfo( const char *filename );
@@ -0,0 +1,55 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Checks BSP lump and game lump directory entries against the size
+//			of the file. Kept free of other includes so it can be tested on its own.
+//
+//=============================================================================//
+
+#ifndef BSPLUMPCHECK_H
+#define BSPLUMPCHECK_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+enum BSPLumpCheck_t
+{
+	BSPLUMP_OK = 0,
+	BSPLUMP_BAD_ENTRY,			// Negative offset or length.
+	BSPLUMP_TRUNCATED,			// Runs past the end of the file.
+};
+
+//-----------------------------------------------------------------------------
+//	Returns whether a lump at nFileOfs, nFileLen bytes long, lies inside a file
+//	of nFileSize bytes. Empty lumps are always fine.
+//-----------------------------------------------------------------------------
+inline BSPLumpCheck_t CheckBSPLump( int nFileOfs, int nFileLen, int nFileSize )
+{
+	if ( nFileLen < 0 || nFileOfs < 0 )
+		return BSPLUMP_BAD_ENTRY;
+
+	// written so it can't overflow
+	if ( nFileLen > 0 && nFileOfs > nFileSize - nFileLen )
+		return BSPLUMP_TRUNCATED;
+
+	return BSPLUMP_OK;
+}
+
+//-----------------------------------------------------------------------------
+//	Returns whether the game lump, nLumpLen bytes long, holds its directory:
+//	a header of nHeaderSize bytes followed by nCount entries of nEntrySize
+//	bytes. Each entry is then checked with CheckBSPLump; they point into the
+//	file, not into the game lump.
+//-----------------------------------------------------------------------------
+inline BSPLumpCheck_t CheckBSPGameLumpCount( int nCount, int nLumpLen, int nHeaderSize, int nEntrySize )
+{
+	if ( nCount < 0 )
+		return BSPLUMP_BAD_ENTRY;
+
+	if ( nLumpLen < nHeaderSize || nCount > ( nLumpLen - nHeaderSize ) / nEntrySize )
+		return BSPLUMP_TRUNCATED;
+
+	return BSPLUMP_OK;
+}
+
+#endif // BSPLUMPCHECK_H
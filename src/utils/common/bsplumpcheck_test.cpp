@@ -0,0 +1,81 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Standalone test of the BSP lump directory check. Needs nothing
+//			but a C++ compiler:
+//
+//			g++ bsplumpcheck_test.cpp -o bsplumpcheck_test && ./bsplumpcheck_test
+//
+//=============================================================================//
+
+#include <stdio.h>
+#include <limits.h>
+#include "bsplumpcheck.h"
+
+static int g_nFailures = 0;
+
+static void Check( int nFileOfs, int nFileLen, int nFileSize, BSPLumpCheck_t expected )
+{
+	BSPLumpCheck_t result = CheckBSPLump( nFileOfs, nFileLen, nFileSize );
+	if ( result != expected )
+	{
+		printf( "FAIL: ofs %d len %d size %d: got %d, expected %d\n", nFileOfs, nFileLen, nFileSize, result, expected );
+		g_nFailures++;
+	}
+}
+
+static void CheckCount( int nCount, int nLumpLen, BSPLumpCheck_t expected )
+{
+	// dgamelumpheader_t is an int, dgamelump_t is 16 bytes
+	BSPLumpCheck_t result = CheckBSPGameLumpCount( nCount, nLumpLen, 4, 16 );
+	if ( result != expected )
+	{
+		printf( "FAIL: game lump count %d len %d: got %d, expected %d\n", nCount, nLumpLen, result, expected );
+		g_nFailures++;
+	}
+}
+
+int main( void )
+{
+	// Lumps inside the file, including one ending exactly at the end.
+	Check( 1036, 100, 2000, BSPLUMP_OK );
+	Check( 1900, 100, 2000, BSPLUMP_OK );
+
+	// Empty lumps are fine wherever they point.
+	Check( 0, 0, 2000, BSPLUMP_OK );
+	Check( 5000, 0, 2000, BSPLUMP_OK );
+
+	// Negative entries.
+	Check( -1, 100, 2000, BSPLUMP_BAD_ENTRY );
+	Check( 100, -1, 2000, BSPLUMP_BAD_ENTRY );
+
+	// Truncated files.
+	Check( 1901, 100, 2000, BSPLUMP_TRUNCATED );
+	Check( 2000, 1, 2000, BSPLUMP_TRUNCATED );
+	Check( 0, 2001, 2000, BSPLUMP_TRUNCATED );
+
+	// Offsets and lengths that would overflow if added.
+	Check( INT_MAX, INT_MAX, 2000, BSPLUMP_TRUNCATED );
+	Check( INT_MAX - 10, 100, INT_MAX, BSPLUMP_TRUNCATED );
+	Check( INT_MAX - 100, 100, INT_MAX, BSPLUMP_OK );
+
+	// Game lump directories that fit, including an empty one.
+	CheckCount( 0, 4, BSPLUMP_OK );
+	CheckCount( 2, 36, BSPLUMP_OK );
+	CheckCount( 2, 1000, BSPLUMP_OK );
+
+	// Negative counts, and counts the lump is too short for.
+	CheckCount( -1, 1000, BSPLUMP_BAD_ENTRY );
+	CheckCount( 3, 36, BSPLUMP_TRUNCATED );
+	CheckCount( 0, 3, BSPLUMP_TRUNCATED );
+	CheckCount( INT_MAX, 1000, BSPLUMP_TRUNCATED );
+	CheckCount( INT_MAX / 16 + 1, INT_MAX, BSPLUMP_TRUNCATED );
+
+	if ( g_nFailures != 0 )
+	{
+		printf( "%d check(s) failed\n", g_nFailures );
+		return 1;
+	}
+
+	printf( "All lump checks passed\n" );
+	return 0;
+}